@@ -17,6 +17,7 @@ public class CheckoutPrefetcher : BlobPrefetcher
         private readonly int checkoutThreadCount;
         private readonly bool allowIndexMetadataUpdateFromWorkingTree;
         private readonly bool forceCheckout;
+        private readonly SharedBlobCache sharedBlobCache;
 
         public CheckoutPrefetcher(
             ITracer tracer,
@@ -29,6 +30,33 @@ public class CheckoutPrefetcher : BlobPrefetcher
             int checkoutThreadCount,
             bool allowIndexMetadataUpdateFromWorkingTree,
             bool forceCheckout)
+                : this(
+                    tracer,
+                    enlistment,
+                    objectRequestor,
+                    chunkSize,
+                    searchThreadCount,
+                    downloadThreadCount,
+                    indexThreadCount,
+                    checkoutThreadCount,
+                    allowIndexMetadataUpdateFromWorkingTree,
+                    forceCheckout,
+                    sharedBlobCache: null)
+        {
+        }
+
+        public CheckoutPrefetcher(
+            ITracer tracer,
+            Enlistment enlistment,
+            GitObjectsHttpRequestor objectRequestor,
+            int chunkSize,
+            int searchThreadCount,
+            int downloadThreadCount,
+            int indexThreadCount,
+            int checkoutThreadCount,
+            bool allowIndexMetadataUpdateFromWorkingTree,
+            bool forceCheckout,
+            SharedBlobCache sharedBlobCache)
                 : base(
                     tracer,
                     enlistment,
@@ -41,6 +69,7 @@ public class CheckoutPrefetcher : BlobPrefetcher
             this.checkoutThreadCount = checkoutThreadCount;
             this.allowIndexMetadataUpdateFromWorkingTree = allowIndexMetadataUpdateFromWorkingTree;
             this.forceCheckout = forceCheckout;
+            this.sharedBlobCache = sharedBlobCache;
         }
 
         /// <param name="branchOrCommit">A specific branch to filter for, or null for all branches returned from info/refs</param>
@@ -79,9 +108,10 @@ public override void Prefetch(string branchOrCommit, bool isBranch)
                 // Configure pipeline
                 // Checkout uses DiffHelper when running checkout.Start(), which we use instead of LsTreeHelper
                 // Checkout diff output => FindBlobs => BatchDownload => IndexPack => Checkout available blobs
-                CheckoutStage checkout = new CheckoutStage(this.checkoutThreadCount, this.FolderList, commitToFetch, this.Tracer, this.Enlistment, this.forceCheckout);
+                CheckoutStage checkout = new CheckoutStage(this.checkoutThreadCount, this.FolderList, commitToFetch, this.Tracer, this.Enlistment, this.forceCheckout, this.sharedBlobCache);
                 FindBlobsStage blobFinder = new FindBlobsStage(this.SearchThreadCount, checkout.RequiredBlobs, checkout.AvailableBlobShas, this.Tracer, this.Enlistment);
                 BatchObjectDownloadStage downloader = new BatchObjectDownloadStage(this.DownloadThreadCount, this.ChunkSize, blobFinder.MissingBlobs, checkout.AvailableBlobShas, this.Tracer, this.Enlistment, this.ObjectRequestor, this.GitObjects);
+                downloader.DownloadController = this.GetDownloadController();
                 IndexPackStage packIndexer = new IndexPackStage(this.IndexThreadCount, downloader.AvailablePacks, checkout.AvailableBlobShas, this.Tracer, this.GitObjects);
 
                 // Start pipeline
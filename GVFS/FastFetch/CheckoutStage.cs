@@ -23,6 +23,7 @@ public class CheckoutStage : PrefetchPipelineStage
         private PhysicalFileSystem fileSystem;
         private string targetCommitSha;
         private bool forceCheckout;
+        private SharedBlobCache sharedBlobCache;
 
         private DiffHelper diff;
 
@@ -36,6 +37,11 @@ public class CheckoutStage : PrefetchPipelineStage
         private int maxParallel;
 
         public CheckoutStage(int maxParallel, IEnumerable<string> folderList, string targetCommitSha, ITracer tracer, Enlistment enlistment, bool forceCheckout)
+            : this(maxParallel, folderList, targetCommitSha, tracer, enlistment, forceCheckout, sharedBlobCache: null)
+        {
+        }
+
+        public CheckoutStage(int maxParallel, IEnumerable<string> folderList, string targetCommitSha, ITracer tracer, Enlistment enlistment, bool forceCheckout, SharedBlobCache sharedBlobCache)
             : base(maxParallel: 1)
         {
             this.tracer = tracer.StartActivity(AreaPath, EventLevel.Informational, Keywords.Telemetry, metadata: null);
@@ -44,6 +50,7 @@ public CheckoutStage(int maxParallel, IEnumerable<string> folderList, string tar
             this.diff = new DiffHelper(tracer, enlistment, new string[0], folderList, includeSymLinks: true);
             this.targetCommitSha = targetCommitSha;
             this.forceCheckout = forceCheckout;
+            this.sharedBlobCache = sharedBlobCache;
             this.AvailableBlobShas = new BlockingCollection<string>();
 
             // Keep track of how parallel we're expected to be later during DoWork
@@ -152,6 +159,7 @@ protected override void DoAfterWork()
             metadata.Add("FileWrites", this.fileWriteCount);
             metadata.Add("BytesWritten", this.bytesWritten);
             metadata.Add("ShasReceived", this.shasReceived);
+            this.sharedBlobCache?.AddToMetadata(metadata);
             this.tracer.Stop(metadata);
         }
 
@@ -304,6 +312,12 @@ private void HandleAllFileDeleteOperations()
                 {
                     if (File.Exists(path))
                     {
+                        if (this.sharedBlobCache != null)
+                        {
+                            // Files linked to the shared blob cache are read-only
+                            this.sharedBlobCache.ReleaseDestination(path);
+                        }
+
                         File.Delete(path);
                     }
 
@@ -340,7 +354,7 @@ private void HandleAllFileAddOperations()
                         try
                         {
                             long written;
-                            if (!repo.TryCopyBlobToFile(availableBlob, paths, out written))
+                            if (!repo.TryCopyBlobToFile(availableBlob, paths, this.sharedBlobCache, out written))
                             {
                                 // TryCopyBlobTo emits an error event.
                                 this.HasFailures = true;
@@ -16,6 +16,15 @@ public FastFetchLibGit2Repo(ITracer tracer, string repoPath)
         }
 
         public virtual bool TryCopyBlobToFile(string sha, IEnumerable<PathWithMode> destinations, out long bytesWritten)
+        {
+            return this.TryCopyBlobToFile(sha, destinations, sharedBlobCache: null, bytesWritten: out bytesWritten);
+        }
+
+        /// <param name="sharedBlobCache">
+        /// When not null, destinations are cloned from or linked to the cache copy of the blob where possible, and
+        /// <paramref name="bytesWritten"/> only counts the destinations that had to be written.
+        /// </param>
+        public virtual bool TryCopyBlobToFile(string sha, IEnumerable<PathWithMode> destinations, SharedBlobCache sharedBlobCache, out long bytesWritten)
         {
             IntPtr objHandle;
             if (Native.RevParseSingle(out objHandle, this.RepoHandle, sha) != Native.ResultCode.Success)
@@ -38,12 +47,31 @@ public virtual bool TryCopyBlobToFile(string sha, IEnumerable<PathWithMode> dest
                             byte* originalData = Native.Blob.GetRawContent(objHandle);
                             long originalSize = Native.Blob.GetRawSize(objHandle);
 
+                            if (sharedBlobCache == null)
+                            {
+                                foreach (PathWithMode destination in destinations)
+                                {
+                                    NativeMethods.WriteFile(this.Tracer, originalData, originalSize, destination.Path, destination.Mode);
+                                }
+
+                                bytesWritten = originalSize * destinations.Count();
+                                break;
+                            }
+
+                            string cachePath;
+                            bool isCached = sharedBlobCache.TryGetCachedBlob(sha, originalData, originalSize, out cachePath);
+
+                            bytesWritten = 0;
                             foreach (PathWithMode destination in destinations)
                             {
-                                NativeMethods.WriteFile(this.Tracer, originalData, originalSize, destination.Path, destination.Mode);
+                                sharedBlobCache.ReleaseDestination(destination.Path);
+                                if (!isCached || !sharedBlobCache.TryShareBlob(cachePath, originalSize, destination.Path))
+                                {
+                                    NativeMethods.WriteFile(this.Tracer, originalData, originalSize, destination.Path, destination.Mode);
+                                    bytesWritten += originalSize;
+                                }
                             }
 
-                            bytesWritten = originalSize * destinations.Count();
                             break;
                         default:
                             throw new NotSupportedException("Copying object types other than blobs is not supported.");
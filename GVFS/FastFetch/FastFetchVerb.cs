@@ -5,6 +5,7 @@
 using GVFS.Common.Tracing;
 using System;
 using System.CommandLine;
+using System.IO;
 
 namespace FastFetch
 {
@@ -48,6 +49,10 @@ public class FastFetchVerb
 
         public bool AllowIndexMetadataUpdateFromWorkingTree { get; set; }
 
+        public string SharedBlobCache { get; set; }
+
+        public bool SharedBlobCacheHardLinks { get; set; }
+
         public bool Verbose { get; set; }
 
         public string ParentActivityId { get; set; }
@@ -125,6 +130,16 @@ public static RootCommand BuildRootCommand()
             Option<bool> allowIndexMetadataOption = new Option<bool>("--allow-index-metadata-update-from-working-tree") { Description = "When specified, index metadata is updated from disk if not already in the index." };
             rootCommand.Add(allowIndexMetadataOption);
 
+            Option<string> sharedBlobCacheOption = new Option<string>("--shared-blob-cache")
+            {
+                Description = "A folder on the same volume as the working tree where checked out file contents are stored once and cloned into each enlistment that uses the same folder. Requires --checkout.",
+                DefaultValueFactory = (_) => ""
+            };
+            rootCommand.Add(sharedBlobCacheOption);
+
+            Option<bool> sharedBlobCacheHardLinksOption = new Option<bool>("--shared-blob-cache-hardlinks") { Description = "Hard link files to the --shared-blob-cache when the volume cannot clone them. Linked files are read-only and must not be edited in place." };
+            rootCommand.Add(sharedBlobCacheHardLinksOption);
+
             Option<bool> verboseOption = new Option<bool>("--verbose") { Description = "Show all outputs on the console in addition to writing them to a log file" };
             rootCommand.Add(verboseOption);
 
@@ -153,6 +168,8 @@ public static RootCommand BuildRootCommand()
                 verb.FolderList = result.GetValue(foldersOption) ?? "";
                 verb.FolderListFile = result.GetValue(foldersListOption) ?? "";
                 verb.AllowIndexMetadataUpdateFromWorkingTree = result.GetValue(allowIndexMetadataOption);
+                verb.SharedBlobCache = result.GetValue(sharedBlobCacheOption) ?? "";
+                verb.SharedBlobCacheHardLinks = result.GetValue(sharedBlobCacheHardLinksOption);
                 verb.Verbose = result.GetValue(verboseOption);
                 verb.ParentActivityId = result.GetValue(parentActivityIdOption) ?? "";
                 verb.Execute();
@@ -190,6 +207,18 @@ private int ExecuteWithExitCode()
                 return ExitFailure;
             }
 
+            if (!string.IsNullOrWhiteSpace(this.SharedBlobCache) && !this.Checkout)
+            {
+                Console.WriteLine("Cannot use --shared-blob-cache option without --checkout option.");
+                return ExitFailure;
+            }
+
+            if (this.SharedBlobCacheHardLinks && string.IsNullOrWhiteSpace(this.SharedBlobCache))
+            {
+                Console.WriteLine("Cannot use --shared-blob-cache-hardlinks option without --shared-blob-cache option.");
+                return ExitFailure;
+            }
+
             this.SearchThreadCount = this.SearchThreadCount > 0 ? this.SearchThreadCount : Environment.ProcessorCount;
             this.DownloadThreadCount = this.DownloadThreadCount > 0 ? this.DownloadThreadCount : Math.Min(Environment.ProcessorCount, MaxDefaultDownloadThreads);
             this.IndexThreadCount = this.IndexThreadCount > 0 ? this.IndexThreadCount : Environment.ProcessorCount;
@@ -257,8 +286,24 @@ private int ExecuteWithExitCode()
                     return ExitFailure;
                 }
 
+                SharedBlobCache sharedBlobCache = null;
+                if (!string.IsNullOrWhiteSpace(this.SharedBlobCache))
+                {
+                    try
+                    {
+                        sharedBlobCache = new SharedBlobCache(tracer, this.SharedBlobCache.Replace("\"", string.Empty), this.SharedBlobCacheHardLinks);
+                    }
+                    catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+                    {
+                        error = "Could not create the shared blob cache: " + e.Message;
+                        tracer.RelatedError(error);
+                        Console.WriteLine(error);
+                        return ExitFailure;
+                    }
+                }
+
                 RetryConfig retryConfig = new RetryConfig(this.MaxAttempts, TimeSpan.FromMinutes(RetryConfig.FetchAndCloneTimeoutMinutes));
-                BlobPrefetcher prefetcher = this.GetFolderPrefetcher(tracer, enlistment, cacheServer, retryConfig);
+                BlobPrefetcher prefetcher = this.GetFolderPrefetcher(tracer, enlistment, cacheServer, retryConfig, sharedBlobCache);
                 if (!BlobPrefetcher.TryLoadFolderList(enlistment, this.FolderList, this.FolderListFile, prefetcher.FolderList, readListFromStdIn: false, error: out error))
                 {
                     tracer.RelatedError(error);
@@ -320,6 +365,19 @@ private int ExecuteWithExitCode()
 
                 EventMetadata stopMetadata = new EventMetadata();
                 stopMetadata.Add("Success", isSuccess);
+                if (sharedBlobCache != null)
+                {
+                    sharedBlobCache.AddToMetadata(stopMetadata);
+                    Console.WriteLine(
+                        "Shared blob cache: {0:N0} bytes written to the cache, {1:N0} files cloned ({2:N0} bytes), {3:N0} files hard linked ({4:N0} bytes), {5:N0} bytes of disk space saved",
+                        sharedBlobCache.BytesWrittenToCache,
+                        sharedBlobCache.FilesCloned,
+                        sharedBlobCache.BytesCloned,
+                        sharedBlobCache.FilesHardLinked,
+                        sharedBlobCache.BytesHardLinked,
+                        sharedBlobCache.DiskSpaceSaved);
+                }
+
                 tracer.Stop(stopMetadata);
 
                 return isSuccess ? ExitSuccess : ExitFailure;
@@ -342,7 +400,7 @@ private string GetRemoteUrl(Enlistment enlistment)
             return enlistment.RepoUrl;
         }
 
-        private BlobPrefetcher GetFolderPrefetcher(ITracer tracer, Enlistment enlistment, CacheServerInfo cacheServer, RetryConfig retryConfig)
+        private BlobPrefetcher GetFolderPrefetcher(ITracer tracer, Enlistment enlistment, CacheServerInfo cacheServer, RetryConfig retryConfig, SharedBlobCache sharedBlobCache)
         {
             GitObjectsHttpRequestor objectRequestor = new GitObjectsHttpRequestor(tracer, enlistment, cacheServer, retryConfig);
 
@@ -358,7 +416,8 @@ private BlobPrefetcher GetFolderPrefetcher(ITracer tracer, Enlistment enlistment
                     this.IndexThreadCount,
                     this.CheckoutThreadCount,
                     this.AllowIndexMetadataUpdateFromWorkingTree,
-                    this.ForceCheckout);
+                    this.ForceCheckout,
+                    sharedBlobCache);
             }
             else
             {
@@ -5,6 +5,7 @@
 using System.IO;
 using System.IO.MemoryMappedFiles;
 using System.Runtime.InteropServices;
+using System.Text;
 
 namespace FastFetch
 {
@@ -12,6 +13,21 @@ internal static class NativeMethods
     {
         private const int AccessDeniedWin32Error = 5;
 
+        private const int InvalidFunctionWin32Error = 1;
+        private const int NotSameDeviceWin32Error = 17;
+        private const int NotSupportedWin32Error = 50;
+
+        private const uint FsctlDuplicateExtentsToFile = 0x00098344;
+        private const long MaxDuplicateExtentsByteCount = 1024L * 1024 * 1024;
+        private const long DefaultClusterSize = 4096;
+
+        private const uint DeleteAccess = 0x00010000;
+        private const int FileEndOfFileInfo = 6;
+        private const int FileDispositionInfoEx = 21;
+        private const uint FileDispositionFlagDelete = 0x1;
+        private const uint FileDispositionFlagPosixSemantics = 0x2;
+        private const uint FileDispositionFlagIgnoreReadOnlyAttribute = 0x10;
+
         public static unsafe void WriteFile(ITracer tracer, byte* originalData, long originalSize, string destination, ushort mode)
         {
             try
@@ -75,6 +91,116 @@ public static bool TryStatFileAndUpdateIndex(ITracer tracer, string path, Memory
             return false;
         }
 
+        /// <summary>
+        /// Creates <paramref name="destination"/> as a block clone of the first <paramref name="size"/> bytes of
+        /// <paramref name="source"/>.  Only volumes that support FSCTL_DUPLICATE_EXTENTS_TO_FILE (ReFS) can clone.
+        /// </summary>
+        public static unsafe bool TryCloneFile(string source, string destination, long size, long clusterSize, out int error)
+        {
+            using (SafeFileHandle sourceHandle = CreateFile(source, FileAccess.Read, FileShare.Read | FileShare.Delete, IntPtr.Zero, FileMode.Open, FileAttributes.Normal, IntPtr.Zero))
+            {
+                if (sourceHandle.IsInvalid)
+                {
+                    error = Marshal.GetLastWin32Error();
+                    return false;
+                }
+
+                using (SafeFileHandle destinationHandle = CreateFile(destination, FileAccess.ReadWrite, FileShare.None, IntPtr.Zero, FileMode.Create, FileAttributes.Normal, IntPtr.Zero))
+                {
+                    if (destinationHandle.IsInvalid)
+                    {
+                        error = Marshal.GetLastWin32Error();
+                        return false;
+                    }
+
+                    // The cloned range has to be cluster aligned, the last cluster can extend past the end of the file
+                    long endOfFile = size;
+                    if (!SetFileInformationByHandle(destinationHandle, FileEndOfFileInfo, &endOfFile, sizeof(long)))
+                    {
+                        error = Marshal.GetLastWin32Error();
+                        return false;
+                    }
+
+                    long alignedSize = (size + clusterSize - 1) / clusterSize * clusterSize;
+                    DuplicateExtentsData extents = new DuplicateExtentsData { FileHandle = sourceHandle.DangerousGetHandle() };
+                    while (extents.SourceFileOffset < alignedSize)
+                    {
+                        extents.ByteCount = Math.Min(alignedSize - extents.SourceFileOffset, MaxDuplicateExtentsByteCount);
+                        if (!DeviceIoControl(destinationHandle, FsctlDuplicateExtentsToFile, ref extents, (uint)sizeof(DuplicateExtentsData), IntPtr.Zero, 0, out uint _, IntPtr.Zero))
+                        {
+                            error = Marshal.GetLastWin32Error();
+                            return false;
+                        }
+
+                        extents.SourceFileOffset += extents.ByteCount;
+                        extents.TargetFileOffset += extents.ByteCount;
+                    }
+                }
+            }
+
+            error = 0;
+            return true;
+        }
+
+        /// <summary>
+        /// Replaces <paramref name="destination"/> with a hard link to <paramref name="existingFile"/>.
+        /// </summary>
+        public static bool TryCreateHardLink(string destination, string existingFile, out int error)
+        {
+            if (File.Exists(destination))
+            {
+                TryDeleteFileIgnoringReadOnly(destination);
+            }
+
+            if (!CreateHardLink(destination, existingFile, IntPtr.Zero))
+            {
+                error = Marshal.GetLastWin32Error();
+                return false;
+            }
+
+            error = 0;
+            return true;
+        }
+
+        /// <summary>
+        /// Returns true for the errors returned when the volume cannot clone or hard link at all, as opposed to errors
+        /// that only affect the file that was being cloned or linked.
+        /// </summary>
+        public static bool IsUnsupportedError(int error)
+        {
+            return error == InvalidFunctionWin32Error || error == NotSupportedWin32Error || error == NotSameDeviceWin32Error;
+        }
+
+        /// <summary>
+        /// Deletes a file without clearing its read-only attribute first, which for a hard link would also clear it on
+        /// every other link to the file.
+        /// </summary>
+        public static unsafe bool TryDeleteFileIgnoringReadOnly(string path)
+        {
+            using (SafeFileHandle handle = CreateFile(path, (FileAccess)DeleteAccess, FileShare.ReadWrite | FileShare.Delete, IntPtr.Zero, FileMode.Open, FileAttributes.Normal, IntPtr.Zero))
+            {
+                if (handle.IsInvalid)
+                {
+                    return false;
+                }
+
+                uint flags = FileDispositionFlagDelete | FileDispositionFlagPosixSemantics | FileDispositionFlagIgnoreReadOnlyAttribute;
+                return SetFileInformationByHandle(handle, FileDispositionInfoEx, &flags, sizeof(uint));
+            }
+        }
+
+        public static long GetClusterSize(string path)
+        {
+            StringBuilder volumePath = new StringBuilder(path.Length + 2);
+            if (GetVolumePathName(path, volumePath, (uint)volumePath.Capacity) &&
+                GetDiskFreeSpace(volumePath.ToString(), out uint sectorsPerCluster, out uint bytesPerSector, out uint _, out uint _))
+            {
+                return (long)sectorsPerCluster * bytesPerSector;
+            }
+
+            return DefaultClusterSize;
+        }
+
         private static SafeFileHandle OpenForWrite(ITracer tracer, string fileName)
         {
             SafeFileHandle handle = CreateFile(fileName, FileAccess.Write, FileShare.None, IntPtr.Zero, FileMode.Create, FileAttributes.Normal, IntPtr.Zero);
@@ -120,5 +246,51 @@ private static SafeFileHandle OpenForWrite(ITracer tracer, string fileName)
             uint numberOfBytesToWrite,
             out uint numberOfBytesWritten,
             IntPtr overlapped);
+
+        [DllImport("kernel32.dll", SetLastError = true)]
+        [return: MarshalAs(UnmanagedType.Bool)]
+        private static extern bool DeviceIoControl(
+            SafeFileHandle device,
+            uint ioControlCode,
+            ref DuplicateExtentsData inBuffer,
+            uint inBufferSize,
+            IntPtr outBuffer,
+            uint outBufferSize,
+            out uint bytesReturned,
+            IntPtr overlapped);
+
+        [DllImport("kernel32.dll", SetLastError = true)]
+        [return: MarshalAs(UnmanagedType.Bool)]
+        private static unsafe extern bool SetFileInformationByHandle(
+            SafeFileHandle file,
+            int fileInformationClass,
+            void* fileInformation,
+            uint bufferSize);
+
+        [DllImport("kernel32.dll", CharSet = CharSet.Unicode, SetLastError = true)]
+        [return: MarshalAs(UnmanagedType.Bool)]
+        private static extern bool CreateHardLink(string fileName, string existingFileName, IntPtr securityAttributes);
+
+        [DllImport("kernel32.dll", CharSet = CharSet.Unicode, SetLastError = true)]
+        [return: MarshalAs(UnmanagedType.Bool)]
+        private static extern bool GetVolumePathName(string fileName, StringBuilder volumePathName, uint bufferLength);
+
+        [DllImport("kernel32.dll", CharSet = CharSet.Unicode, SetLastError = true)]
+        [return: MarshalAs(UnmanagedType.Bool)]
+        private static extern bool GetDiskFreeSpace(
+            string rootPathName,
+            out uint sectorsPerCluster,
+            out uint bytesPerSector,
+            out uint numberOfFreeClusters,
+            out uint totalNumberOfClusters);
+
+        [StructLayout(LayoutKind.Sequential)]
+        private struct DuplicateExtentsData
+        {
+            public IntPtr FileHandle;
+            public long SourceFileOffset;
+            public long TargetFileOffset;
+            public long ByteCount;
+        }
     }
 }
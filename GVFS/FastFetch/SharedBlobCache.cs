@@ -0,0 +1,215 @@
+﻿using GVFS.Common.Tracing;
+using System;
+using System.IO;
+using System.Threading;
+
+namespace FastFetch
+{
+    /// <summary>
+    /// A content-addressed store of checked out file contents that several enlistments on the same volume can share.
+    /// Each blob is written to the cache once, and the files that checkout would otherwise write are block cloned
+    /// from the cache copy (ReFS and Dev Drive volumes) or, when the caller allows it, hard linked to it.
+    /// </summary>
+    /// <remarks>
+    /// A cloned file shares its clusters with the cache copy until either of them is written, so it behaves exactly like
+    /// a file that was written.  A hard linked file IS the cache copy, which is why hard links are opt-in: cache files are
+    /// read-only so that an edit in one working tree fails rather than changing the file in every enlistment, but tools that
+    /// clear the read-only attribute before writing defeat that.
+    /// </remarks>
+    public class SharedBlobCache
+    {
+        // Small files take up a cluster whether they are written or cloned, and cloning costs more calls than writing
+        private const long MinimumSharedSize = 4096;
+
+        private const string TempFolderName = "tmp";
+
+        private readonly ITracer tracer;
+        private readonly string cacheRoot;
+        private readonly long clusterSize;
+
+        private int cloningDisabled;
+        private int hardLinksDisabled;
+
+        private long bytesWrittenToCache;
+        private long bytesCloned;
+        private long bytesHardLinked;
+        private long filesCloned;
+        private long filesHardLinked;
+
+        public SharedBlobCache(ITracer tracer, string cacheRoot, bool allowHardLinks)
+        {
+            this.tracer = tracer;
+            this.cacheRoot = Path.GetFullPath(cacheRoot);
+            this.AllowHardLinks = allowHardLinks;
+
+            Directory.CreateDirectory(Path.Combine(this.cacheRoot, TempFolderName));
+            this.clusterSize = NativeMethods.GetClusterSize(this.cacheRoot);
+        }
+
+        public bool AllowHardLinks { get; }
+
+        public long BytesWrittenToCache => Interlocked.Read(ref this.bytesWrittenToCache);
+
+        public long BytesCloned => Interlocked.Read(ref this.bytesCloned);
+
+        public long BytesHardLinked => Interlocked.Read(ref this.bytesHardLinked);
+
+        public long FilesCloned => Interlocked.Read(ref this.filesCloned);
+
+        public long FilesHardLinked => Interlocked.Read(ref this.filesHardLinked);
+
+        /// <summary>
+        /// The bytes that did not have to be written to the working tree, less the bytes written to the cache itself.
+        /// Negative until enough files have been shared to pay for the cache copies.
+        /// </summary>
+        public long DiskSpaceSaved => this.BytesCloned + this.BytesHardLinked - this.BytesWrittenToCache;
+
+        private bool CanShare => this.cloningDisabled == 0 || (this.AllowHardLinks && this.hardLinksDisabled == 0);
+
+        /// <summary>
+        /// Returns the path of the cache copy of <paramref name="sha"/>, writing it from <paramref name="data"/> if this
+        /// is the first time it has been seen.  Returns false if the blob should be written rather than shared.
+        /// </summary>
+        public unsafe bool TryGetCachedBlob(string sha, byte* data, long size, out string cachePath)
+        {
+            cachePath = null;
+            if (size < MinimumSharedSize || !this.CanShare)
+            {
+                return false;
+            }
+
+            string path = Path.Combine(this.cacheRoot, sha.Substring(0, 2), sha.Substring(2));
+            FileInfo existing = new FileInfo(path);
+            if (existing.Exists && existing.Length == size)
+            {
+                cachePath = path;
+                return true;
+            }
+
+            // Write to a temp file and move it into place so that other enlistments never see a partial copy
+            string tempPath = Path.Combine(this.cacheRoot, TempFolderName, sha + "-" + Guid.NewGuid().ToString("N"));
+            try
+            {
+                NativeMethods.WriteFile(this.tracer, data, size, tempPath, mode: 0);
+                File.SetAttributes(tempPath, FileAttributes.ReadOnly);
+
+                Directory.CreateDirectory(Path.GetDirectoryName(path));
+                try
+                {
+                    File.Move(tempPath, path);
+                    Interlocked.Add(ref this.bytesWrittenToCache, size);
+                }
+                catch (IOException) when (File.Exists(path))
+                {
+                    // Another enlistment added the same blob first
+                    NativeMethods.TryDeleteFileIgnoringReadOnly(tempPath);
+                }
+
+                // A cache file of the wrong size was not written by this class, leave it alone and write the blob instead
+                if (new FileInfo(path).Length != size)
+                {
+                    return false;
+                }
+
+                cachePath = path;
+                return true;
+            }
+            catch (Exception e)
+            {
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("Sha", sha);
+                metadata.Add("Exception", e.ToString());
+                this.tracer.RelatedWarning(metadata, "Failed to add blob to the shared blob cache, writing it instead");
+
+                NativeMethods.TryDeleteFileIgnoringReadOnly(tempPath);
+
+                return false;
+            }
+        }
+
+        /// <summary>
+        /// Deletes <paramref name="destination"/> if it may be a hard link to a cache file, so that the file can be
+        /// replaced without clearing the read-only attribute that the cache file shares with it.
+        /// </summary>
+        public void ReleaseDestination(string destination)
+        {
+            if (this.AllowHardLinks && File.Exists(destination) && File.GetAttributes(destination).HasFlag(FileAttributes.ReadOnly))
+            {
+                NativeMethods.TryDeleteFileIgnoringReadOnly(destination);
+            }
+        }
+
+        /// <summary>
+        /// Replaces <paramref name="destination"/> with a clone of, or hard link to, <paramref name="cachePath"/>.
+        /// Returns false if neither is possible, in which case the destination has to be written.
+        /// </summary>
+        public bool TryShareBlob(string cachePath, long size, string destination)
+        {
+            if (this.cloningDisabled == 0)
+            {
+                int error;
+                if (this.TryCloneFile(cachePath, destination, size, out error))
+                {
+                    Interlocked.Add(ref this.bytesCloned, size);
+                    Interlocked.Increment(ref this.filesCloned);
+                    return true;
+                }
+
+                if (NativeMethods.IsUnsupportedError(error))
+                {
+                    this.Disable(ref this.cloningDisabled, "Block cloning", error);
+                }
+            }
+
+            if (this.AllowHardLinks && this.hardLinksDisabled == 0)
+            {
+                int error;
+                if (this.TryCreateHardLink(destination, cachePath, out error))
+                {
+                    Interlocked.Add(ref this.bytesHardLinked, size);
+                    Interlocked.Increment(ref this.filesHardLinked);
+                    return true;
+                }
+
+                // ERROR_TOO_MANY_LINKS only affects this blob, the next one will have its own cache file
+                if (NativeMethods.IsUnsupportedError(error))
+                {
+                    this.Disable(ref this.hardLinksDisabled, "Hard linking", error);
+                }
+            }
+
+            return false;
+        }
+
+        public void AddToMetadata(EventMetadata metadata)
+        {
+            metadata.Add("SharedBlobCacheBytesWritten", this.BytesWrittenToCache);
+            metadata.Add("FilesCloned", this.FilesCloned);
+            metadata.Add("BytesCloned", this.BytesCloned);
+            metadata.Add("FilesHardLinked", this.FilesHardLinked);
+            metadata.Add("BytesHardLinked", this.BytesHardLinked);
+            metadata.Add("DiskSpaceSaved", this.DiskSpaceSaved);
+        }
+
+        protected virtual bool TryCloneFile(string cachePath, string destination, long size, out int error)
+        {
+            return NativeMethods.TryCloneFile(cachePath, destination, size, this.clusterSize, out error);
+        }
+
+        protected virtual bool TryCreateHardLink(string destination, string cachePath, out int error)
+        {
+            return NativeMethods.TryCreateHardLink(destination, cachePath, out error);
+        }
+
+        private void Disable(ref int disabled, string mechanism, int error)
+        {
+            if (Interlocked.Exchange(ref disabled, 1) == 0)
+            {
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("CacheRoot", this.cacheRoot);
+                metadata.Add("Win32Error", error);
+                this.tracer.RelatedWarning(metadata, mechanism + " is not supported for the shared blob cache, falling back");
+            }
+        }
+    }
+}
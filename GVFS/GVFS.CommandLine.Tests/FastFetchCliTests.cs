@@ -99,6 +99,16 @@ public void FoldersList_DefaultsToEmptyString()
                 "FoldersList should default to empty string when not specified");
         }
 
+        [Test]
+        public void SharedBlobCache_DefaultsToEmptyString()
+        {
+            var parseResult = rootCommand.Parse(System.Array.Empty<string>());
+            var opt = FindOption<string>("--shared-blob-cache");
+            Assert.That(opt, Is.Not.Null);
+            Assert.That(parseResult.GetValue(opt), Is.EqualTo(""),
+                "SharedBlobCache should default to empty string when not specified");
+        }
+
         [Test]
         public void BooleanOptions_DefaultToFalse()
         {
@@ -108,6 +118,7 @@ public void BooleanOptions_DefaultToFalse()
             var forceCheckout = FindOption<bool>("--force-checkout");
             var verbose = FindOption<bool>("--verbose");
             var allowIndexMetadata = FindOption<bool>("--allow-index-metadata-update-from-working-tree");
+            var sharedBlobCacheHardLinks = FindOption<bool>("--shared-blob-cache-hardlinks");
 
             Assert.Multiple(() =>
             {
@@ -115,6 +126,7 @@ public void BooleanOptions_DefaultToFalse()
                 Assert.That(parseResult.GetValue(forceCheckout), Is.False, "--force-checkout should default to false");
                 Assert.That(parseResult.GetValue(verbose), Is.False, "--verbose should default to false");
                 Assert.That(parseResult.GetValue(allowIndexMetadata), Is.False, "--allow-index-metadata-update-from-working-tree should default to false");
+                Assert.That(parseResult.GetValue(sharedBlobCacheHardLinks), Is.False, "--shared-blob-cache-hardlinks should default to false");
             });
         }
 
@@ -181,7 +193,8 @@ public void AllStringOptions_ParseCorrectly()
                 "--git-path", @"C:\Program Files\Git\bin\git.exe",
                 "--folders", "src;lib",
                 "--folders-list", @"C:\folders.txt",
-                "--parent-activity-id", "12345678-1234-1234-1234-123456789012"
+                "--parent-activity-id", "12345678-1234-1234-1234-123456789012",
+                "--shared-blob-cache", @"D:\BlobCache"
             });
 
             Assert.That(parseResult.Errors, Is.Empty, "All string options should parse without errors");
@@ -209,7 +222,7 @@ public void AllExpectedOptions_Exist()
                 "--download-thread-count", "--index-thread-count", "--checkout-thread-count",
                 "--max-retries", "--git-path", "--folders", "--folders-list",
                 "--allow-index-metadata-update-from-working-tree", "--verbose",
-                "--parent-activity-id"
+                "--parent-activity-id", "--shared-blob-cache", "--shared-blob-cache-hardlinks"
             };
 
             foreach (var optName in expectedOptions)
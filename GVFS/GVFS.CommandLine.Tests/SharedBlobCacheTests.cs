@@ -0,0 +1,238 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using FastFetch;
+using GVFS.Common.Tracing;
+using NUnit.Framework;
+
+namespace GVFS.CommandLine.Tests
+{
+    /// <summary>
+    /// Tests how FastFetch's SharedBlobCache adds blobs to the cache, falls back from block cloning to hard
+    /// linking to writing the file, and accounts for the bytes it writes and saves.  Cloning and hard linking
+    /// are simulated, as they depend on the volume the tests run on.
+    /// </summary>
+    [TestFixture]
+    public class SharedBlobCacheTests
+    {
+        private const string Sha = "0123456789abcdef0123456789abcdef01234567";
+        private const int BlobSize = 8192;
+
+        private const int NotSupportedWin32Error = 50;
+        private const int AccessDeniedWin32Error = 5;
+
+        private string cacheRoot;
+
+        [SetUp]
+        public void SetUp()
+        {
+            cacheRoot = Path.Combine(Path.GetTempPath(), "SharedBlobCacheTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(cacheRoot))
+            {
+                // Cache files are read-only
+                foreach (string path in Directory.GetFiles(cacheRoot, "*", SearchOption.AllDirectories))
+                {
+                    File.SetAttributes(path, FileAttributes.Normal);
+                }
+
+                Directory.Delete(cacheRoot, recursive: true);
+            }
+        }
+
+        [Test]
+        public void CacheMiss_WritesReadOnlyCacheFile()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: false);
+            byte[] contents = CreateContents(BlobSize);
+
+            Assert.That(TryGetCachedBlob(cache, Sha, contents, out string cachePath), Is.True);
+            Assert.That(cachePath, Is.EqualTo(Path.Combine(Path.GetFullPath(cacheRoot), Sha.Substring(0, 2), Sha.Substring(2))));
+            Assert.That(File.ReadAllBytes(cachePath), Is.EqualTo(contents));
+            Assert.That(File.GetAttributes(cachePath).HasFlag(FileAttributes.ReadOnly), Is.True);
+            Assert.That(cache.BytesWrittenToCache, Is.EqualTo(BlobSize));
+        }
+
+        [Test]
+        public void CacheHit_ReusesCacheFileWithoutWritingIt()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: false);
+            byte[] contents = CreateContents(BlobSize);
+            Assert.That(TryGetCachedBlob(cache, Sha, contents, out string firstPath), Is.True);
+            DateTime firstWriteTime = File.GetLastWriteTimeUtc(firstPath);
+
+            // Another enlistment sharing the cache finds the blob that the first one added
+            var otherCache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: false);
+            Assert.That(TryGetCachedBlob(otherCache, Sha, contents, out string secondPath), Is.True);
+            Assert.That(secondPath, Is.EqualTo(firstPath));
+            Assert.That(File.GetLastWriteTimeUtc(secondPath), Is.EqualTo(firstWriteTime));
+            Assert.That(otherCache.BytesWrittenToCache, Is.EqualTo(0));
+        }
+
+        [Test]
+        public void CacheFileOfTheWrongSize_IsNotUsed()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: false);
+            string path = Path.Combine(cacheRoot, Sha.Substring(0, 2), Sha.Substring(2));
+            Directory.CreateDirectory(Path.GetDirectoryName(path));
+            File.WriteAllBytes(path, new byte[BlobSize / 2]);
+
+            Assert.That(TryGetCachedBlob(cache, Sha, CreateContents(BlobSize), out string cachePath), Is.False);
+            Assert.That(cachePath, Is.Null);
+            Assert.That(new FileInfo(path).Length, Is.EqualTo(BlobSize / 2));
+        }
+
+        [Test]
+        public void SmallBlob_IsWrittenRatherThanCached()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: true);
+
+            Assert.That(TryGetCachedBlob(cache, Sha, CreateContents(100), out string cachePath), Is.False);
+            Assert.That(cachePath, Is.Null);
+            Assert.That(cache.BytesWrittenToCache, Is.EqualTo(0));
+        }
+
+        [Test]
+        public void FallbackOrder_ClonesBeforeHardLinking()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: true);
+
+            Assert.That(cache.TryShareBlob("cache", BlobSize, "destination"), Is.True);
+            Assert.That(cache.Calls, Is.EqualTo(new[] { "clone" }));
+            Assert.That(cache.FilesCloned, Is.EqualTo(1));
+            Assert.That(cache.FilesHardLinked, Is.EqualTo(0));
+        }
+
+        [Test]
+        public void FallbackOrder_HardLinksOnceCloningIsNotSupported()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: true);
+            cache.CloneError = NotSupportedWin32Error;
+
+            Assert.That(cache.TryShareBlob("cache", BlobSize, "destination1"), Is.True);
+            Assert.That(cache.TryShareBlob("cache", BlobSize, "destination2"), Is.True);
+
+            // The volume cannot clone, so cloning is only tried once
+            Assert.That(cache.Calls, Is.EqualTo(new[] { "clone", "hardlink", "hardlink" }));
+            Assert.That(cache.FilesCloned, Is.EqualTo(0));
+            Assert.That(cache.FilesHardLinked, Is.EqualTo(2));
+            Assert.That(cache.BytesHardLinked, Is.EqualTo(2 * BlobSize));
+        }
+
+        [Test]
+        public void FallbackOrder_WritesWhenNeitherCloningNorHardLinkingIsSupported()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: true);
+            cache.CloneError = NotSupportedWin32Error;
+            cache.HardLinkError = NotSupportedWin32Error;
+
+            Assert.That(cache.TryShareBlob("cache", BlobSize, "destination"), Is.False);
+            Assert.That(cache.Calls, Is.EqualTo(new[] { "clone", "hardlink" }));
+
+            // Nothing can be shared, so blobs are no longer added to the cache
+            Assert.That(TryGetCachedBlob(cache, Sha, CreateContents(BlobSize), out _), Is.False);
+            Assert.That(cache.BytesWrittenToCache, Is.EqualTo(0));
+        }
+
+        [Test]
+        public void FallbackOrder_HardLinksAreOnlyUsedWhenAllowed()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: false);
+            cache.CloneError = NotSupportedWin32Error;
+
+            Assert.That(cache.TryShareBlob("cache", BlobSize, "destination"), Is.False);
+            Assert.That(cache.Calls, Is.EqualTo(new[] { "clone" }));
+            Assert.That(TryGetCachedBlob(cache, Sha, CreateContents(BlobSize), out _), Is.False);
+        }
+
+        [Test]
+        public void FallbackOrder_ErrorForOneFileDoesNotDisableCloning()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: false);
+            cache.CloneError = AccessDeniedWin32Error;
+            Assert.That(cache.TryShareBlob("cache", BlobSize, "destination1"), Is.False);
+
+            cache.CloneError = 0;
+            Assert.That(cache.TryShareBlob("cache", BlobSize, "destination2"), Is.True);
+            Assert.That(cache.Calls, Is.EqualTo(new[] { "clone", "clone" }));
+            Assert.That(cache.FilesCloned, Is.EqualTo(1));
+        }
+
+        [Test]
+        public void Accounting_DiskSpaceSavedIsSharedBytesLessBytesWrittenToCache()
+        {
+            var cache = new TestableSharedBlobCache(cacheRoot, allowHardLinks: true);
+            Assert.That(TryGetCachedBlob(cache, Sha, CreateContents(BlobSize), out string cachePath), Is.True);
+
+            // Until a blob has been shared twice its cache copy costs more than it saves
+            Assert.That(cache.TryShareBlob(cachePath, BlobSize, "destination1"), Is.True);
+            Assert.That(cache.DiskSpaceSaved, Is.EqualTo(0));
+
+            cache.CloneError = NotSupportedWin32Error;
+            Assert.That(cache.TryShareBlob(cachePath, BlobSize, "destination2"), Is.True);
+            Assert.That(cache.TryShareBlob(cachePath, BlobSize, "destination3"), Is.True);
+
+            Assert.That(cache.BytesWrittenToCache, Is.EqualTo(BlobSize));
+            Assert.That(cache.BytesCloned, Is.EqualTo(BlobSize));
+            Assert.That(cache.BytesHardLinked, Is.EqualTo(2 * BlobSize));
+            Assert.That(cache.DiskSpaceSaved, Is.EqualTo(2 * BlobSize));
+
+            var metadata = new EventMetadata();
+            cache.AddToMetadata(metadata);
+            Assert.That(metadata["SharedBlobCacheBytesWritten"], Is.EqualTo((long)BlobSize));
+            Assert.That(metadata["FilesCloned"], Is.EqualTo(1L));
+            Assert.That(metadata["FilesHardLinked"], Is.EqualTo(2L));
+            Assert.That(metadata["DiskSpaceSaved"], Is.EqualTo(2L * BlobSize));
+        }
+
+        private static unsafe bool TryGetCachedBlob(SharedBlobCache cache, string sha, byte[] contents, out string cachePath)
+        {
+            fixed (byte* data = contents)
+            {
+                return cache.TryGetCachedBlob(sha, data, contents.Length, out cachePath);
+            }
+        }
+
+        private static byte[] CreateContents(int size)
+        {
+            byte[] contents = new byte[size];
+            new Random(size).NextBytes(contents);
+            return contents;
+        }
+
+        /// <summary>
+        /// SharedBlobCache whose clones and hard links succeed unless they are given an error to fail with
+        /// </summary>
+        private class TestableSharedBlobCache : SharedBlobCache
+        {
+            public TestableSharedBlobCache(string cacheRoot, bool allowHardLinks)
+                : base(NullTracer.Instance, cacheRoot, allowHardLinks)
+            {
+            }
+
+            public List<string> Calls { get; } = new List<string>();
+
+            public int CloneError { get; set; }
+
+            public int HardLinkError { get; set; }
+
+            protected override bool TryCloneFile(string cachePath, string destination, long size, out int error)
+            {
+                Calls.Add("clone");
+                error = CloneError;
+                return error == 0;
+            }
+
+            protected override bool TryCreateHardLink(string destination, string cachePath, out int error)
+            {
+                Calls.Add("hardlink");
+                error = HardLinkError;
+                return error == 0;
+            }
+        }
+    }
+}
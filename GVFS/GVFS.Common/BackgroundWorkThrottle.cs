@@ -0,0 +1,110 @@
+﻿using GVFS.Common.Tracing;
+using System;
+using System.Diagnostics;
+using System.Threading;
+
+namespace GVFS.Common
+{
+    /// <summary>
+    /// Lets bulk work (blob prefetches, maintenance steps) yield to interactive work (a git command
+    /// blocked on an object download, for example) that is in progress in the same process.
+    ///
+    /// Interactive work is bracketed with <see cref="BeginInteractiveWork"/>.  Bulk work calls
+    /// <see cref="WaitForInteractiveWork"/> before each unit of work (a download batch, a maintenance
+    /// step), which waits while interactive work is in progress.  The wait is bounded so that a steady
+    /// stream of interactive work slows bulk work down rather than stopping it.
+    /// </summary>
+    public class BackgroundWorkThrottle : IHeartBeatMetadataProvider
+    {
+        private readonly ManualResetEventSlim noInteractiveWork = new ManualResetEventSlim(initialState: true);
+        private readonly Lock countLock = new Lock();
+
+        private int interactiveWorkCount;
+
+        // Reset by GetAndResetHeartBeatMetadata
+        private long waitCount;
+        private long totalWaitTicks;
+
+        public int InteractiveWorkCount
+        {
+            get { return Volatile.Read(ref this.interactiveWorkCount); }
+        }
+
+        /// <summary>
+        /// Marks the start of interactive work, which ends when the returned object is disposed.
+        /// </summary>
+        public IDisposable BeginInteractiveWork()
+        {
+            lock (this.countLock)
+            {
+                if (++this.interactiveWorkCount == 1)
+                {
+                    this.noInteractiveWork.Reset();
+                }
+            }
+
+            return new InteractiveWork(this);
+        }
+
+        /// <summary>
+        /// Waits, for at most <paramref name="maxWait"/>, until no interactive work is in progress.
+        /// </summary>
+        /// <returns>True if there was interactive work in progress, false if bulk work did not have to wait.</returns>
+        public bool WaitForInteractiveWork(TimeSpan maxWait)
+        {
+            if (this.noInteractiveWork.IsSet)
+            {
+                return false;
+            }
+
+            long startTicks = Stopwatch.GetTimestamp();
+            this.noInteractiveWork.Wait(maxWait);
+
+            Interlocked.Increment(ref this.waitCount);
+            Interlocked.Add(ref this.totalWaitTicks, Stopwatch.GetTimestamp() - startTicks);
+            return true;
+        }
+
+        public EventMetadata GetAndResetHeartBeatMetadata(out bool logToFile)
+        {
+            long waitCount = Interlocked.Exchange(ref this.waitCount, 0);
+            long totalWaitMs = Interlocked.Exchange(ref this.totalWaitTicks, 0) * 1000 / Stopwatch.Frequency;
+            logToFile = waitCount > 0;
+
+            EventMetadata metrics = new EventMetadata();
+            metrics.Add("InteractiveWorkInProgress", this.InteractiveWorkCount);
+            metrics.Add("BackgroundWaits", waitCount);
+            metrics.Add("BackgroundWaitMs", totalWaitMs);
+
+            EventMetadata metadata = new EventMetadata();
+            metadata.Add(nameof(BackgroundWorkThrottle), metrics);
+            return metadata;
+        }
+
+        private void EndInteractiveWork()
+        {
+            lock (this.countLock)
+            {
+                if (--this.interactiveWorkCount == 0)
+                {
+                    this.noInteractiveWork.Set();
+                }
+            }
+        }
+
+        private class InteractiveWork : IDisposable
+        {
+            private BackgroundWorkThrottle throttle;
+
+            public InteractiveWork(BackgroundWorkThrottle throttle)
+            {
+                this.throttle = throttle;
+            }
+
+            public void Dispose()
+            {
+                Interlocked.Exchange(ref this.throttle, null)?.EndInteractiveWork();
+            }
+        }
+    }
+}
@@ -23,6 +23,8 @@ public static partial class GVFSConstants
 
         public const string GitIsNotInstalledError = "Could not find git.exe.  Ensure that Git is installed.";
 
+        public const string ObjectLookupLibraryName = "GVFS.ObjectLookup";
+
         public static class GitConfig
         {
             public const string GVFSPrefix = "gvfs.";
@@ -58,9 +60,43 @@ public static class GitConfig
 
             public const string MaxHttpConnectionsConfig = GVFSPrefix + "max-http-connections";
 
+            /* Request HTTP/2 from the cache server and origin, negotiated with ALPN and falling back
+             * to HTTP/1.1 when the server does not offer it.  Concurrent requests are then streams
+             * multiplexed on a few connections rather than each waiting for a connection of its own,
+             * and gvfs.max-http2-streams (rather than gvfs.max-http-connections) limits how many
+             * requests are in flight at once. */
+            public const string Http2 = GVFSPrefix + "http2";
+            public const bool Http2Default = false;
+            public const string MaxHttp2StreamsConfig = GVFSPrefix + "max-http2-streams";
+
             public const string PrefetchUseIdx = GVFSPrefix + "prefetch-use-idx";
             public const bool PrefetchUseIdxDefault = false;
 
+            /* Let prefetch adjust its download batch size and the number of batches in flight from the
+             * throughput, latency and errors it sees from the cache server (see AdaptiveDownloadController),
+             * rather than always sending batches of the configured chunk size on every download thread. */
+            public const string AdaptiveDownloads = GVFSPrefix + "adaptive-downloads";
+            public const bool AdaptiveDownloadsDefault = false;
+
+            /* When a single object download from the cache server has not produced response headers
+             * within the latency most downloads see, send the same request to the origin and use
+             * whichever response arrives first (see RequestHedger).  At most a few percent of
+             * downloads are sent twice. */
+            public const string HedgedDownloads = GVFSPrefix + "hedged-downloads";
+            public const bool HedgedDownloadsDefault = false;
+
+            /* Memory, in MB, that a mount may use to keep the contents of small blobs it has hydrated
+             * (see BlobContentCache), so that a file hydrated again is copied from memory rather than
+             * inflated from its loose object or pack.  0, the default, disables the cache. */
+            public const string BlobContentCacheSizeMB = GVFSPrefix + "blob-content-cache-mb";
+            public const int BlobContentCacheSizeMBDefault = 0;
+
+            /* Size, in MB, of the file in the enlistment that also keeps the blobs added to the blob
+             * content cache (see BlobContentCacheFile), so that they are still cached after a remount.
+             * Only used when gvfs.blob-content-cache-mb is set.  0 disables the file. */
+            public const string BlobContentCacheFileSizeMB = GVFSPrefix + "blob-content-cache-file-mb";
+            public const int BlobContentCacheFileSizeMBDefault = 256;
+
             /* Gates the background (fire-and-forget) auth + /gvfs/config behavior on
              * mount when a cache server is configured locally. When false (default),
              * mount blocks on auth/config synchronously before starting virtualization.
@@ -70,6 +106,12 @@ public static class GitConfig
 
             public const string PrefetchOffload = GVFSPrefix + "prefetch-offload";
             public const bool PrefetchOffloadDefault = false;
+
+            /* Store blob sizes in a memory mapped hash file in the enlistment's .gvfs folder rather
+             * than in the BlobSizes.sql SQLite database of the shared cache.  The existing BlobSizes.sql
+             * is copied into the hash file the first time the mount starts with this enabled. */
+            public const string MemoryMappedBlobSizes = GVFSPrefix + "mmap-blob-sizes";
+            public const bool MemoryMappedBlobSizesDefault = false;
         }
 
         public static class LocalGVFSConfig
@@ -142,6 +184,8 @@ public static class Databases
                 public const string Name = "databases";
 
                 public static readonly string BackgroundFileSystemTasks = Path.Combine(Name, "BackgroundGitOperations.dat");
+                public static readonly string BlobSizes = Path.Combine(Name, "BlobSizes");
+                public static readonly string BlobContents = Path.Combine(Name, "BlobContents.dat");
                 public static readonly string PlaceholderList = Path.Combine(Name, "PlaceholderList.dat");
                 public static readonly string ModifiedPaths = Path.Combine(Name, "ModifiedPaths.dat");
                 public static readonly string RepoMetadata = Path.Combine(Name, "RepoMetadata.dat");
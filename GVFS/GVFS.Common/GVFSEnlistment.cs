@@ -266,13 +266,13 @@ public static bool WaitUntilMounted(ITracer tracer, string pipeName, string enli
 
                 while (true)
                 {
-                    string response = string.Empty;
                     try
                     {
-                        pipeClient.SendRequest(NamedPipeMessages.GetStatus.Request);
-                        response = pipeClient.ReadRawResponse();
-                        NamedPipeMessages.GetStatus.Response getStatusResponse =
-                            NamedPipeMessages.GetStatus.Response.FromJson(response);
+                        pipeClient.SendBinaryRequest(NamedPipeMessages.Binary.ResultMessage.GetStatusRequest);
+                        NamedPipeFrame response = pipeClient.ReadResponseFrame();
+                        NamedPipeMessages.GetStatus.Response getStatusResponse = response.IsBinary ?
+                            NamedPipeMessages.GetStatus.Response.FromBinary(response.Binary.Span) :
+                            NamedPipeMessages.GetStatus.Response.FromJson(response.Text);
 
                         if (getStatusResponse.MountStatus == NamedPipeMessages.GetStatus.Ready)
                         {
@@ -302,7 +302,7 @@ public static bool WaitUntilMounted(ITracer tracer, string pipeName, string enli
                         tracer.RelatedError($"{nameof(WaitUntilMounted)}: {errorMessage}");
                         return false;
                     }
-                    catch (JsonException e)
+                    catch (Exception e) when (e is JsonException || e is InvalidDataException)
                     {
                         errorMessage = string.Format("Failed to parse response from GVFS.Mount.\n {0}", e);
                         tracer.RelatedError($"{nameof(WaitUntilMounted)}: {errorMessage}");
@@ -23,9 +23,11 @@ public partial class GVFSLock
             NamedPipeMessages.LockRequest request = new NamedPipeMessages.LockRequest(pid, isElevated, checkAvailabilityOnly, fullCommand, gitCommandSessionId);
 
             NamedPipeMessages.Message requestMessage = request.CreateMessage(NamedPipeMessages.AcquireLock.AcquireRequest);
-            pipeClient.SendRequest(requestMessage);
+            NamedPipeMessages.Binary.LockRequestMessage binaryRequest = new NamedPipeMessages.Binary.LockRequestMessage(
+                NamedPipeMessages.Binary.MessageType.AcquireLockRequest,
+                request.RequestData);
 
-            NamedPipeMessages.AcquireLock.Response response = new NamedPipeMessages.AcquireLock.Response(pipeClient.ReadResponse());
+            NamedPipeMessages.AcquireLock.Response response = SendAcquireLockRequest(pipeClient, binaryRequest, requestMessage);
 
             string message = string.Empty;
             switch (response.Result)
@@ -61,8 +63,7 @@ public partial class GVFSLock
                     while (true)
                     {
                         Thread.Sleep(250);
-                        pipeClient.SendRequest(requestMessage);
-                        response = new NamedPipeMessages.AcquireLock.Response(pipeClient.ReadResponse());
+                        response = SendAcquireLockRequest(pipeClient, binaryRequest, requestMessage);
                         switch (response.Result)
                         {
                             case NamedPipeMessages.AcquireLock.AcceptResult:
@@ -113,13 +114,16 @@ public partial class GVFSLock
 
             NamedPipeMessages.Message requestMessage = request.CreateMessage(NamedPipeMessages.ReleaseLock.Request);
 
-            pipeClient.SendRequest(requestMessage);
+            pipeClient.SendBinaryRequest(new NamedPipeMessages.Binary.LockRequestMessage(NamedPipeMessages.Binary.MessageType.ReleaseLockRequest, request.RequestData));
             NamedPipeMessages.ReleaseLock.Response response = null;
 
             Func<ConsoleHelper.ActionResult> releaseLock =
                 () =>
                 {
-                    response = new NamedPipeMessages.ReleaseLock.Response(pipeClient.ReadResponse());
+                    NamedPipeFrame responseFrame = ReadLockResponse(pipeClient, requestMessage);
+                    response = responseFrame.IsBinary ?
+                        NamedPipeMessages.ReleaseLock.Response.FromBinary(responseFrame.Binary.Span) :
+                        new NamedPipeMessages.ReleaseLock.Response(NamedPipeMessages.Message.FromString(responseFrame.Text));
                     responseHandler(response);
                     return ConsoleHelper.ActionResult.Success;
                 };
@@ -140,6 +144,34 @@ public partial class GVFSLock
             }
         }
 
+        private static NamedPipeMessages.AcquireLock.Response SendAcquireLockRequest(
+            NamedPipeClient pipeClient,
+            NamedPipeMessages.Binary.LockRequestMessage binaryRequest,
+            NamedPipeMessages.Message requestMessage)
+        {
+            pipeClient.SendBinaryRequest(binaryRequest);
+            NamedPipeFrame responseFrame = ReadLockResponse(pipeClient, requestMessage);
+            return responseFrame.IsBinary ?
+                NamedPipeMessages.AcquireLock.Response.FromBinary(responseFrame.Binary.Span) :
+                new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.Message.FromString(responseFrame.Text));
+        }
+
+        /// <summary>
+        /// Reads the response to a binary lock request.  A server that does not handle binary requests replies
+        /// with a text UnknownRequest, in which case the request is sent again as <paramref name="requestMessage"/>.
+        /// </summary>
+        private static NamedPipeFrame ReadLockResponse(NamedPipeClient pipeClient, NamedPipeMessages.Message requestMessage)
+        {
+            NamedPipeFrame responseFrame = pipeClient.ReadResponseFrame();
+            if (!responseFrame.IsBinary && responseFrame.Text == NamedPipeMessages.UnknownRequest)
+            {
+                pipeClient.SendRequest(requestMessage);
+                responseFrame = pipeClient.ReadResponseFrame();
+            }
+
+            return responseFrame;
+        }
+
         private static bool CheckAcceptResponse(NamedPipeMessages.AcquireLock.Response response, bool checkAvailabilityOnly, out string message)
         {
             switch (response.Result)
@@ -301,6 +301,11 @@ public class ActiveGitCommandStats
             private int folderPlaceholdersDeleted;
             private int folderPlaceholdersPathNotFound;
             private int folderPlaceholdersShaUpdate;
+            private int filePlaceholderUpdateThreads;
+            private int filePlaceholderUpdateWorkItems;
+            private long filePlaceholderUpdateMinThreadMs;
+            private long filePlaceholderUpdateMaxThreadMs;
+            private int filePlaceholderUpdateThreadUtilization;
             private long parseGitIndexTimeMs;
             private long projectionWriteLockHeldMs;
 
@@ -331,7 +336,12 @@ public void RecordReleaseExternalLockRequested()
                 int deleteFolderPlacehoderAttempted,
                 int folderPlaceholdersDeleted,
                 int folderPlaceholdersPathNotFound,
-                int folderPlaceholdersShaUpdate)
+                int folderPlaceholdersShaUpdate,
+                int filePlaceholderUpdateThreads,
+                int filePlaceholderUpdateWorkItems,
+                long filePlaceholderUpdateMinThreadMs,
+                long filePlaceholderUpdateMaxThreadMs,
+                int filePlaceholderUpdateThreadUtilization)
             {
                 this.placeholderTotalUpdateTimeMs = durationMs;
                 this.placeholderUpdateFilesTimeMs = updateFilesMs;
@@ -341,6 +351,11 @@ public void RecordReleaseExternalLockRequested()
                 this.folderPlaceholdersDeleted = folderPlaceholdersDeleted;
                 this.folderPlaceholdersPathNotFound = folderPlaceholdersPathNotFound;
                 this.folderPlaceholdersShaUpdate = folderPlaceholdersShaUpdate;
+                this.filePlaceholderUpdateThreads = filePlaceholderUpdateThreads;
+                this.filePlaceholderUpdateWorkItems = filePlaceholderUpdateWorkItems;
+                this.filePlaceholderUpdateMinThreadMs = filePlaceholderUpdateMinThreadMs;
+                this.filePlaceholderUpdateMaxThreadMs = filePlaceholderUpdateMaxThreadMs;
+                this.filePlaceholderUpdateThreadUtilization = filePlaceholderUpdateThreadUtilization;
             }
 
             public void RecordProjectionWriteLockHeld(long durationMs)
@@ -381,6 +396,11 @@ public void AddStatsToTelemetry(EventMetadata metadata)
                 metadata.Add("UpdatePlaceholdersMS", this.placeholderTotalUpdateTimeMs);
                 metadata.Add("UpdateFilePlaceholdersMS", this.placeholderUpdateFilesTimeMs);
                 metadata.Add("UpdateFolderPlaceholdersMS", this.placeholderUpdateFoldersTimeMs);
+                metadata.Add("UpdateFilePlaceholdersThreads", this.filePlaceholderUpdateThreads);
+                metadata.Add("UpdateFilePlaceholdersWorkItems", this.filePlaceholderUpdateWorkItems);
+                metadata.Add("UpdateFilePlaceholdersMinThreadMS", this.filePlaceholderUpdateMinThreadMs);
+                metadata.Add("UpdateFilePlaceholdersMaxThreadMS", this.filePlaceholderUpdateMaxThreadMs);
+                metadata.Add("UpdateFilePlaceholdersThreadUtilizationPercent", this.filePlaceholderUpdateThreadUtilization);
                 metadata.Add("DeleteFolderPlacehoderAttempted", this.deleteFolderPlacehoderAttempted);
                 metadata.Add("FolderPlaceholdersDeleted", this.folderPlaceholdersDeleted);
                 metadata.Add("FolderPlaceholdersShaUpdate", this.folderPlaceholdersShaUpdate);
@@ -0,0 +1,354 @@
+using GVFS.Common.Tracing;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+
+namespace GVFS.Common.Git
+{
+    /// <summary>
+    /// A bounded, least recently used cache of the inflated contents of small blobs, keyed by SHA.
+    /// Files that are hydrated again and again (after their folder is dehydrated, or because many
+    /// files have the same contents) are then copied from memory rather than being inflated from
+    /// their loose object or pack each time.
+    /// </summary>
+    /// <remarks>
+    /// A blob is added by the hydration that reads it, see <see cref="AddWhenCopied"/>, and only
+    /// once all of its contents have been read.  Most blobs are only hydrated once, and so a blob
+    /// is only added (and its contents only copied) the second time that it is missed.  The memory
+    /// cap includes an estimate of the per-entry overhead so that many tiny blobs cannot exceed it.
+    ///
+    /// When it is given a <see cref="BlobContentCacheFile"/> the blobs are also added to the file,
+    /// and a blob that has been evicted from memory (or was cached by an earlier mount) is copied
+    /// from the file and added back to memory.  Thread-safe.
+    /// </remarks>
+    public class BlobContentCache : IHeartBeatMetadataProvider, IDisposable
+    {
+        public const int DefaultMaxBlobSize = 64 * 1024;
+
+        // SHA string, dictionary entry and linked list node
+        private const int EntryOverhead = 256;
+
+        private readonly Lock cacheLock = new Lock();
+        private readonly Dictionary<string, LinkedListNode<CacheEntry>> entries;
+        private readonly LinkedList<CacheEntry> lruOrder;
+        private readonly long maxCachedBytes;
+        private readonly int maxBlobSize;
+        private readonly int missedOnceCapacity;
+
+        private BlobContentCacheFile cacheFile;
+        private long cachedBytes;
+
+        // SHAs of the blobs that have been missed once.  When missedOnce is full it replaces
+        // previouslyMissedOnce, so between missedOnceCapacity and twice as many SHAs are remembered.
+        private HashSet<string> missedOnce;
+        private HashSet<string> previouslyMissedOnce;
+
+        // Reset by GetAndResetHeartBeatMetadata
+        private long hitCount;
+        private long fileHitCount;
+        private long missCount;
+        private long evictionCount;
+
+        public BlobContentCache(long maxCachedBytes, int maxBlobSize = DefaultMaxBlobSize, BlobContentCacheFile cacheFile = null)
+        {
+            this.maxCachedBytes = maxCachedBytes;
+            this.maxBlobSize = maxBlobSize;
+            this.cacheFile = cacheFile;
+            this.entries = new Dictionary<string, LinkedListNode<CacheEntry>>(StringComparer.OrdinalIgnoreCase);
+            this.lruOrder = new LinkedList<CacheEntry>();
+
+            // About as many SHAs as there are 1 KB blobs that fit in the cache
+            this.missedOnceCapacity = (int)Math.Clamp(maxCachedBytes / 1024, 1024, 1024 * 1024);
+            this.missedOnce = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+            this.previouslyMissedOnce = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+        }
+
+        public int Count
+        {
+            get
+            {
+                lock (this.cacheLock)
+                {
+                    return this.entries.Count;
+                }
+            }
+        }
+
+        public long CachedBytes
+        {
+            get { return Interlocked.Read(ref this.cachedBytes); }
+        }
+
+        /// <summary>
+        /// Calls <paramref name="writeAction"/> with the contents of the blob if it is in the cache
+        /// (in memory, or in the cache file).
+        /// </summary>
+        /// <returns>True if the blob was in the cache, false (without calling <paramref name="writeAction"/>) if it was not.</returns>
+        public bool TryCopyBlobContentStream(string sha, Action<Stream, long> writeAction)
+        {
+            byte[] contents;
+            bool isFromFile = false;
+            lock (this.cacheLock)
+            {
+                if (this.entries.TryGetValue(sha, out LinkedListNode<CacheEntry> node))
+                {
+                    ++this.hitCount;
+                    this.lruOrder.Remove(node);
+                    this.lruOrder.AddFirst(node);
+                    contents = node.Value.Contents;
+                }
+                else if (this.cacheFile != null && this.cacheFile.TryGetContents(sha, out contents))
+                {
+                    isFromFile = true;
+                }
+                else
+                {
+                    ++this.missCount;
+                    return false;
+                }
+            }
+
+            if (isFromFile)
+            {
+                // The file is not flushed as blobs are added, and so after a crash a blob's record can be stale
+                bool isValid = BlobContentCacheFile.IsBlobContents(sha, contents);
+                lock (this.cacheLock)
+                {
+                    if (!isValid)
+                    {
+                        this.cacheFile?.Remove(sha);
+                        ++this.missCount;
+                        return false;
+                    }
+
+                    ++this.hitCount;
+                    ++this.fileHitCount;
+                    this.AddToMemory(sha, contents);
+                }
+            }
+
+            using (MemoryStream stream = new MemoryStream(contents, writable: false))
+            {
+                writeAction(stream, contents.Length);
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Wraps <paramref name="writeAction"/> so that the contents it reads are added to the cache,
+        /// if the blob is small enough to be cached and <paramref name="writeAction"/> reads all of it.
+        /// </summary>
+        public Action<Stream, long> AddWhenCopied(string sha, Action<Stream, long> writeAction)
+        {
+            if (!this.IsMissedAgain(sha))
+            {
+                return writeAction;
+            }
+
+            return (stream, length) =>
+            {
+                if (length > this.maxBlobSize || length + EntryOverhead > this.maxCachedBytes)
+                {
+                    writeAction(stream, length);
+                    return;
+                }
+
+                CapturingStream capturingStream = new CapturingStream(stream, new byte[length]);
+                writeAction(capturingStream, length);
+                if (capturingStream.IsComplete)
+                {
+                    this.Add(sha, capturingStream.Contents);
+                }
+            };
+        }
+
+        public EventMetadata GetAndResetHeartBeatMetadata(out bool logToFile)
+        {
+            long hitCount;
+            long fileHitCount;
+            long missCount;
+            long evictionCount;
+            int entryCount;
+            int fileEntryCount;
+            lock (this.cacheLock)
+            {
+                hitCount = this.hitCount;
+                fileHitCount = this.fileHitCount;
+                missCount = this.missCount;
+                evictionCount = this.evictionCount;
+                entryCount = this.entries.Count;
+                fileEntryCount = this.cacheFile?.Count ?? 0;
+                this.hitCount = 0;
+                this.fileHitCount = 0;
+                this.missCount = 0;
+                this.evictionCount = 0;
+            }
+
+            logToFile = hitCount + missCount > 0;
+
+            EventMetadata metrics = new EventMetadata();
+            metrics.Add("Hits", hitCount);
+            metrics.Add("Misses", missCount);
+            metrics.Add("HitRatePercent", hitCount + missCount > 0 ? (int)(hitCount * 100 / (hitCount + missCount)) : 0);
+            metrics.Add("Evictions", evictionCount);
+            metrics.Add("Entries", entryCount);
+            metrics.Add("CachedBytes", this.CachedBytes);
+            metrics.Add("MaxCachedBytes", this.maxCachedBytes);
+            if (this.cacheFile != null)
+            {
+                metrics.Add("FileHits", fileHitCount);
+                metrics.Add("FileEntries", fileEntryCount);
+            }
+
+            EventMetadata metadata = new EventMetadata();
+            metadata.Add(nameof(BlobContentCache), metrics);
+            return metadata;
+        }
+
+        /// <summary>
+        /// Flushes and closes the cache file.  The cache must not be used once it is disposed.
+        /// </summary>
+        public void Dispose()
+        {
+            lock (this.cacheLock)
+            {
+                if (this.cacheFile != null)
+                {
+                    this.cacheFile.Flush();
+                    this.cacheFile.Dispose();
+                    this.cacheFile = null;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Remember that <paramref name="sha"/> has been missed
+        /// </summary>
+        /// <returns>True if it had already been missed, and so should be added to the cache</returns>
+        private bool IsMissedAgain(string sha)
+        {
+            lock (this.cacheLock)
+            {
+                if (this.missedOnce.Remove(sha) || this.previouslyMissedOnce.Remove(sha))
+                {
+                    return true;
+                }
+
+                if (this.missedOnce.Count >= this.missedOnceCapacity)
+                {
+                    HashSet<string> oldest = this.previouslyMissedOnce;
+                    oldest.Clear();
+                    this.previouslyMissedOnce = this.missedOnce;
+                    this.missedOnce = oldest;
+                }
+
+                this.missedOnce.Add(sha);
+                return false;
+            }
+        }
+
+        private void Add(string sha, byte[] contents)
+        {
+            lock (this.cacheLock)
+            {
+                this.cacheFile?.TryAdd(sha, contents);
+                this.AddToMemory(sha, contents);
+            }
+        }
+
+        private void AddToMemory(string sha, byte[] contents)
+        {
+            long entrySize = contents.Length + EntryOverhead;
+            if (this.entries.ContainsKey(sha))
+            {
+                // Added by a concurrent hydration of the same blob
+                return;
+            }
+
+            while (this.cachedBytes + entrySize > this.maxCachedBytes && this.lruOrder.Last != null)
+            {
+                LinkedListNode<CacheEntry> leastRecentlyUsed = this.lruOrder.Last;
+                this.lruOrder.RemoveLast();
+                this.entries.Remove(leastRecentlyUsed.Value.Sha);
+                this.cachedBytes -= leastRecentlyUsed.Value.Contents.Length + EntryOverhead;
+                ++this.evictionCount;
+            }
+
+            this.entries.Add(sha, this.lruOrder.AddFirst(new CacheEntry(sha, contents)));
+            this.cachedBytes += entrySize;
+        }
+
+        private class CacheEntry
+        {
+            public CacheEntry(string sha, byte[] contents)
+            {
+                this.Sha = sha;
+                this.Contents = contents;
+            }
+
+            public string Sha { get; }
+            public byte[] Contents { get; }
+        }
+
+        /// <summary>
+        /// Keeps a copy of the bytes read from a blob's stream, which must be no longer than the blob.
+        /// </summary>
+        private class CapturingStream : Stream
+        {
+            private readonly Stream inner;
+            private readonly byte[] contents;
+            private int position;
+            private bool overflowed;
+
+            public CapturingStream(Stream inner, byte[] contents)
+            {
+                this.inner = inner;
+                this.contents = contents;
+            }
+
+            public byte[] Contents => this.contents;
+            public bool IsComplete => this.position == this.contents.Length && !this.overflowed;
+
+            public override bool CanRead => true;
+            public override bool CanSeek => false;
+            public override bool CanWrite => false;
+            public override long Length => this.contents.Length;
+            public override long Position
+            {
+                get => this.position;
+                set => throw new NotSupportedException();
+            }
+
+            public override int Read(byte[] buffer, int offset, int count)
+            {
+                return this.Read(new Span<byte>(buffer, offset, count));
+            }
+
+            public override int Read(Span<byte> buffer)
+            {
+                int read = this.inner.Read(buffer);
+                if (read > this.contents.Length - this.position)
+                {
+                    this.overflowed = true;
+                }
+                else
+                {
+                    buffer.Slice(0, read).CopyTo(this.contents.AsSpan(this.position));
+                    this.position += read;
+                }
+
+                return read;
+            }
+
+            public override void Flush()
+            {
+            }
+
+            public override long Seek(long offset, SeekOrigin origin) => throw new NotSupportedException();
+            public override void SetLength(long value) => throw new NotSupportedException();
+            public override void Write(byte[] buffer, int offset, int count) => throw new NotSupportedException();
+        }
+    }
+}
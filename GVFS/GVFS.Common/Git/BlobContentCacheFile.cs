@@ -0,0 +1,428 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Security.Cryptography;
+using System.Text;
+
+namespace GVFS.Common.Git
+{
+    /// <summary>
+    /// Fixed size, memory mapped, circular log of the contents of small blobs.  It is the tier of
+    /// <see cref="BlobContentCache"/> that is kept in a folder of the enlistment, so that the blobs
+    /// cached by one mount are still cached after a remount.
+    /// </summary>
+    /// <remarks>
+    /// File layout:
+    ///
+    ///   Header (64 bytes): signature, version, data size, write offset
+    ///   Data: records, each 8-byte aligned
+    ///     Blob record: type (4 bytes), contents length (4 bytes), SHA (20 bytes), contents
+    ///     Skip record: type (4 bytes), length of the record (4 bytes), unused bytes
+    ///
+    /// Records are written at the write offset, and when a record does not fit before the end of
+    /// the data the write offset goes back to the start, where the oldest records are.  Any part of
+    /// an overwritten record that the new record does not cover is replaced with a skip record, so
+    /// the data is always a chain of records (followed, until the log first wraps around, by unused
+    /// zeros).  The SHA to offset index is only kept in
+    /// memory, and is rebuilt from the chain when the file is opened.
+    ///
+    /// The file is not flushed as blobs are added (the OS writes the dirty pages back on its own, and
+    /// the contents are only a cache), and so after a crash of the machine a record can be stale or
+    /// torn.  Readers must check the contents with <see cref="IsBlobContents"/> before using them.
+    ///
+    /// Not thread-safe, <see cref="BlobContentCache"/> only calls it while holding its lock.
+    /// </remarks>
+    public unsafe class BlobContentCacheFile : IDisposable
+    {
+        public const int HeaderSize = 64;
+
+        private const uint Signature = 0x43425647; // "GVBC"
+        private const uint CurrentVersion = 1;
+
+        private const int SignatureOffset = 0;
+        private const int VersionOffset = 4;
+        private const int DataSizeOffset = 8;
+        private const int WriteOffsetOffset = 16;
+
+        private const uint UnusedRecord = 0;
+        private const uint BlobRecord = 1;
+        private const uint SkipRecord = 2;
+
+        private const int RecordTypeOffset = 0;
+        private const int RecordLengthOffset = 4;
+        private const int RecordShaOffset = 8;
+        private const int ShaSize = 20;
+        private const int BlobRecordHeaderSize = RecordShaOffset + ShaSize;
+        private const int MinimumRecordSize = 8;
+
+        private readonly Dictionary<string, long> offsets;
+
+        private MemoryMappedFile mappedFile;
+        private MemoryMappedViewAccessor view;
+        private byte* headerPtr;
+        private byte* dataPtr;
+
+        private BlobContentCacheFile(string path, MemoryMappedFile mappedFile, MemoryMappedViewAccessor view)
+        {
+            this.Path = path;
+            this.mappedFile = mappedFile;
+            this.view = view;
+            this.offsets = new Dictionary<string, long>(StringComparer.OrdinalIgnoreCase);
+
+            byte* ptr = null;
+            this.view.SafeMemoryMappedViewHandle.AcquirePointer(ref ptr);
+            this.headerPtr = ptr + this.view.PointerOffset;
+            this.dataPtr = this.headerPtr + HeaderSize;
+        }
+
+        public string Path { get; }
+
+        public long DataSize { get; private set; }
+
+        public int Count
+        {
+            get { return this.offsets.Count; }
+        }
+
+        private long WriteOffset
+        {
+            get { return *(long*)(this.headerPtr + WriteOffsetOffset); }
+            set { *(long*)(this.headerPtr + WriteOffsetOffset) = value; }
+        }
+
+        public static BlobContentCacheFile Create(string path, long dataSize)
+        {
+            if (dataSize < MinimumRecordSize || dataSize % MinimumRecordSize != 0)
+            {
+                throw new ArgumentException($"Must be a multiple of {MinimumRecordSize}", nameof(dataSize));
+            }
+
+            using (FileStream stream = new FileStream(path, FileMode.Create, FileAccess.ReadWrite, FileShare.Read))
+            {
+                stream.SetLength(HeaderSize + dataSize);
+            }
+
+            BlobContentCacheFile cacheFile = OpenMapping(path);
+            *(uint*)(cacheFile.headerPtr + SignatureOffset) = Signature;
+            *(uint*)(cacheFile.headerPtr + VersionOffset) = CurrentVersion;
+            *(long*)(cacheFile.headerPtr + DataSizeOffset) = dataSize;
+            cacheFile.WriteOffset = 0;
+            cacheFile.DataSize = dataSize;
+            cacheFile.Flush();
+            return cacheFile;
+        }
+
+        /// <summary>
+        /// Open an existing file and index the blobs in it
+        /// </summary>
+        /// <exception cref="InvalidDataException">Thrown when the file is not a valid blob content cache file</exception>
+        public static BlobContentCacheFile Open(string path)
+        {
+            BlobContentCacheFile cacheFile = OpenMapping(path);
+            try
+            {
+                uint signature = *(uint*)(cacheFile.headerPtr + SignatureOffset);
+                uint version = *(uint*)(cacheFile.headerPtr + VersionOffset);
+                long dataSize = *(long*)(cacheFile.headerPtr + DataSizeOffset);
+                long writeOffset = cacheFile.WriteOffset;
+                if (signature != Signature)
+                {
+                    throw new InvalidDataException($"Invalid signature {signature:X8}");
+                }
+
+                if (version != CurrentVersion)
+                {
+                    throw new InvalidDataException($"Unsupported version {version}");
+                }
+
+                if (dataSize < MinimumRecordSize ||
+                    dataSize % MinimumRecordSize != 0 ||
+                    cacheFile.view.Capacity < HeaderSize + dataSize)
+                {
+                    throw new InvalidDataException($"Invalid data size {dataSize} for file of size {cacheFile.view.Capacity}");
+                }
+
+                if (writeOffset < 0 || writeOffset > dataSize || writeOffset % MinimumRecordSize != 0)
+                {
+                    throw new InvalidDataException($"Invalid write offset {writeOffset}");
+                }
+
+                cacheFile.DataSize = dataSize;
+
+                // The records after the write offset are older than the ones before it
+                cacheFile.IndexRecords(writeOffset, dataSize);
+                cacheFile.IndexRecords(0, writeOffset);
+                return cacheFile;
+            }
+            catch
+            {
+                cacheFile.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>
+        /// Check that <paramref name="contents"/> are the contents of the blob with SHA <paramref name="sha"/>
+        /// </summary>
+        public static bool IsBlobContents(string sha, byte[] contents)
+        {
+            using (IncrementalHash hash = IncrementalHash.CreateHash(HashAlgorithmName.SHA1)) // CodeQL [SM02196] SHA-1 is acceptable here because this is Git's hashing algorithm, not used for cryptographic purposes
+            {
+                hash.AppendData(Encoding.ASCII.GetBytes("blob " + contents.Length + "\0"));
+                hash.AppendData(contents);
+                return string.Equals(SHA1Util.HexStringFromBytes(hash.GetHashAndReset()), sha, StringComparison.OrdinalIgnoreCase);
+            }
+        }
+
+        public bool Contains(string sha)
+        {
+            return this.offsets.ContainsKey(sha);
+        }
+
+        /// <summary>
+        /// Copy the contents of a blob out of the file
+        /// </summary>
+        public bool TryGetContents(string sha, out byte[] contents)
+        {
+            if (!this.offsets.TryGetValue(sha, out long offset))
+            {
+                contents = null;
+                return false;
+            }
+
+            byte* recordPtr = this.dataPtr + offset;
+            contents = new ReadOnlySpan<byte>(recordPtr + BlobRecordHeaderSize, *(int*)(recordPtr + RecordLengthOffset)).ToArray();
+            return true;
+        }
+
+        /// <summary>
+        /// Add the contents of a blob, overwriting the oldest blobs if there is not enough room for them
+        /// </summary>
+        /// <returns>False if the blob is too large for the file</returns>
+        public bool TryAdd(string sha, byte[] contents)
+        {
+            long recordSize = AlignRecordSize(BlobRecordHeaderSize + (long)contents.Length);
+            if (recordSize > this.DataSize || !SHA1Util.IsValidShaFormat(sha))
+            {
+                return false;
+            }
+
+            if (this.offsets.ContainsKey(sha))
+            {
+                return true;
+            }
+
+            long offset = this.WriteOffset;
+            if (offset + recordSize > this.DataSize)
+            {
+                // The records left at the end are overwritten when the log next reaches them
+                offset = 0;
+            }
+
+            long recordEnd = offset + recordSize;
+            this.OverwriteRecords(offset, recordEnd);
+
+            byte* recordPtr = this.dataPtr + offset;
+            *(uint*)(recordPtr + RecordTypeOffset) = BlobRecord;
+            *(int*)(recordPtr + RecordLengthOffset) = contents.Length;
+            SHA1Util.BytesFromHexString(sha).CopyTo(new Span<byte>(recordPtr + RecordShaOffset, ShaSize));
+            contents.CopyTo(new Span<byte>(recordPtr + BlobRecordHeaderSize, contents.Length));
+
+            this.offsets[sha] = offset;
+            this.WriteOffset = recordEnd;
+            return true;
+        }
+
+        /// <summary>
+        /// Remove a blob whose contents are not valid (see <see cref="IsBlobContents"/>)
+        /// </summary>
+        public void Remove(string sha)
+        {
+            if (this.offsets.Remove(sha, out long offset))
+            {
+                byte* recordPtr = this.dataPtr + offset;
+                int recordSize = (int)AlignRecordSize(BlobRecordHeaderSize + (long)*(int*)(recordPtr + RecordLengthOffset));
+                this.WriteSkipRecord(offset, recordSize);
+            }
+        }
+
+        public void Flush()
+        {
+            this.view.Flush();
+        }
+
+        public void Dispose()
+        {
+            if (this.view != null)
+            {
+                this.view.SafeMemoryMappedViewHandle.ReleasePointer();
+                this.headerPtr = null;
+                this.dataPtr = null;
+                this.view.Dispose();
+                this.view = null;
+            }
+
+            if (this.mappedFile != null)
+            {
+                this.mappedFile.Dispose();
+                this.mappedFile = null;
+            }
+        }
+
+        private static long AlignRecordSize(long size)
+        {
+            return (size + MinimumRecordSize - 1) & ~(long)(MinimumRecordSize - 1);
+        }
+
+        private static BlobContentCacheFile OpenMapping(string path)
+        {
+            MemoryMappedFile mappedFile = null;
+            MemoryMappedViewAccessor view = null;
+            try
+            {
+                mappedFile = MemoryMappedFile.CreateFromFile(path, FileMode.Open, mapName: null, capacity: 0, access: MemoryMappedFileAccess.ReadWrite);
+                view = mappedFile.CreateViewAccessor(offset: 0, size: 0, access: MemoryMappedFileAccess.ReadWrite);
+                if (view.Capacity < HeaderSize)
+                {
+                    throw new InvalidDataException($"File is too small ({view.Capacity} bytes)");
+                }
+
+                return new BlobContentCacheFile(path, mappedFile, view);
+            }
+            catch
+            {
+                view?.Dispose();
+                mappedFile?.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>
+        /// Get the size of the record at <paramref name="offset"/>
+        /// </summary>
+        /// <returns>
+        /// The size of the record, 0 if the rest of the data is unused, or -1 if the record is not valid
+        /// </returns>
+        private long GetRecordSize(long offset, out uint recordType)
+        {
+            if (this.DataSize - offset < MinimumRecordSize)
+            {
+                recordType = UnusedRecord;
+                return -1;
+            }
+
+            byte* recordPtr = this.dataPtr + offset;
+            recordType = *(uint*)(recordPtr + RecordTypeOffset);
+            long recordSize;
+            switch (recordType)
+            {
+                case UnusedRecord:
+                    return 0;
+                case BlobRecord:
+                    recordSize = AlignRecordSize(BlobRecordHeaderSize + (long)*(int*)(recordPtr + RecordLengthOffset));
+                    break;
+                case SkipRecord:
+                    recordSize = *(int*)(recordPtr + RecordLengthOffset);
+                    break;
+                default:
+                    return -1;
+            }
+
+            if (recordSize < MinimumRecordSize || recordSize % MinimumRecordSize != 0 || recordSize > this.DataSize - offset)
+            {
+                return -1;
+            }
+
+            return recordSize;
+        }
+
+        private void IndexRecords(long start, long end)
+        {
+            long offset = start;
+            while (offset < end)
+            {
+                long recordSize = this.GetRecordSize(offset, out uint recordType);
+                if (recordSize <= 0)
+                {
+                    return;
+                }
+
+                if (recordType == BlobRecord)
+                {
+                    string sha = SHA1Util.HexStringFromBytes(new ReadOnlySpan<byte>(this.dataPtr + offset + RecordShaOffset, ShaSize).ToArray());
+                    this.offsets[sha] = offset;
+                }
+
+                offset += recordSize;
+            }
+        }
+
+        /// <summary>
+        /// Remove the blobs in the records that start in [<paramref name="start"/>, <paramref name="end"/>)
+        /// from the index, and replace any part of the last of them that extends past <paramref name="end"/>
+        /// with a skip record
+        /// </summary>
+        private void OverwriteRecords(long start, long end)
+        {
+            long offset = start;
+            while (offset < end)
+            {
+                long recordSize = this.GetRecordSize(offset, out uint recordType);
+                if (recordSize == 0)
+                {
+                    // The rest of the data has never been written
+                    return;
+                }
+
+                if (recordSize < 0)
+                {
+                    // The chain is broken (the file was torn by a crash), drop anything indexed in the range
+                    this.RemoveOffsetsInRange(offset, end);
+                    offset = end;
+                    break;
+                }
+
+                if (recordType == BlobRecord)
+                {
+                    string sha = SHA1Util.HexStringFromBytes(new ReadOnlySpan<byte>(this.dataPtr + offset + RecordShaOffset, ShaSize).ToArray());
+                    if (this.offsets.TryGetValue(sha, out long indexedOffset) && indexedOffset == offset)
+                    {
+                        this.offsets.Remove(sha);
+                    }
+                }
+
+                offset += recordSize;
+            }
+
+            if (offset > end)
+            {
+                this.WriteSkipRecord(end, offset - end);
+            }
+        }
+
+        private void RemoveOffsetsInRange(long start, long end)
+        {
+            List<string> removedShas = new List<string>();
+            foreach (KeyValuePair<string, long> entry in this.offsets)
+            {
+                if (entry.Value >= start && entry.Value < end)
+                {
+                    removedShas.Add(entry.Key);
+                }
+            }
+
+            foreach (string sha in removedShas)
+            {
+                this.offsets.Remove(sha);
+            }
+        }
+
+        private void WriteSkipRecord(long offset, long length)
+        {
+            byte* recordPtr = this.dataPtr + offset;
+            *(int*)(recordPtr + RecordLengthOffset) = (int)length;
+            *(uint*)(recordPtr + RecordTypeOffset) = SkipRecord;
+        }
+    }
+}
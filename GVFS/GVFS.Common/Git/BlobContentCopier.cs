@@ -0,0 +1,52 @@
+using System;
+using System.IO;
+
+namespace GVFS.Common.Git
+{
+    /// <summary>
+    /// Copies blob contents into unmanaged memory, such as a ProjFS write buffer, without staging
+    /// them in a managed buffer first. The blob streams from <see cref="GitRepo.TryCopyBlobContentStream"/>
+    /// read directly into a span: a loose object's DeflateStream inflates into it and a blob in
+    /// a pack (an UnmanagedMemoryStream over the libgit2 object) is copied into it with a memcpy.
+    /// </summary>
+    public static class BlobContentCopier
+    {
+        /// <summary>
+        /// Reads from <paramref name="source"/> until <paramref name="destination"/> is full or the
+        /// end of the stream is reached.
+        /// </summary>
+        /// <returns>
+        /// Number of bytes read, less than the length of <paramref name="destination"/> only if the
+        /// end of the stream was reached.
+        /// </returns>
+        /// <remarks>
+        /// Unlike <see cref="StreamUtil.TryReadGreedy"/>, exceptions from <paramref name="source"/>
+        /// are not wrapped: an IOException or InvalidDataException from a local object is not retryable.
+        /// </remarks>
+        public static int ReadBlock(Stream source, Span<byte> destination)
+        {
+            int totalRead = 0;
+            while (totalRead < destination.Length)
+            {
+                int read = source.Read(destination.Slice(totalRead));
+                if (read == 0)
+                {
+                    break;
+                }
+
+                totalRead += read;
+            }
+
+            return totalRead;
+        }
+
+        /// <summary>
+        /// Reads up to <paramref name="count"/> bytes from <paramref name="source"/> into the unmanaged
+        /// memory at <paramref name="destination"/>, see <see cref="ReadBlock(Stream, Span{byte})"/>.
+        /// </summary>
+        public static unsafe int ReadBlock(Stream source, IntPtr destination, int count)
+        {
+            return ReadBlock(source, new Span<byte>(destination.ToPointer(), count));
+        }
+    }
+}
@@ -80,6 +80,12 @@ public DownloadAttemptResult(DownloadAndSaveObjectResult result, HttpStatusCode?
             public HttpStatusCode? HttpStatusCode { get; }
         }
 
+        /// <summary>
+        /// When set, <see cref="TryCopyBlobContentStream"/> copies small blobs from this cache
+        /// when it can, and adds the small blobs that it copies from the repository to it.
+        /// </summary>
+        public BlobContentCache BlobContentCache { get; set; }
+
         protected GVFSContext Context { get; private set; }
 
         public virtual bool TryCopyBlobContentStream(
@@ -109,6 +115,18 @@ public DownloadAttemptResult(DownloadAndSaveObjectResult result, HttpStatusCode?
                 return false;
             }
 
+            BlobContentCache blobContentCache = this.BlobContentCache;
+            if (blobContentCache != null)
+            {
+                if (blobContentCache.TryCopyBlobContentStream(sha, writeAction))
+                {
+                    failureCategory = BlobHydrationFailureCategory.None;
+                    return true;
+                }
+
+                writeAction = blobContentCache.AddWhenCopied(sha, writeAction);
+            }
+
             // Track the outcome of the most recent attempt so that the terminal failure
             // telemetry can attribute the failure to a cause (network vs. object-missing vs.
             // local copy) that is otherwise collapsed into the bool return value below. The
@@ -230,9 +248,78 @@ public DownloadAndSaveObjectResult TryDownloadAndSaveObject(string objectId, Req
             return this.TryDownloadAndSaveObject(objectId, CancellationToken.None, requestSource, retryOnFailure: true).Result;
         }
 
+        /// <summary>
+        /// Get the size of a blob from the loose object, or from the pack entry header if the
+        /// blob is in a local pack
+        /// </summary>
         public bool TryGetBlobSizeLocally(string sha, out long length)
         {
-            return this.Context.Repository.TryGetBlobLength(sha, out length);
+            if (this.Context.Repository.TryGetBlobLength(sha, out length))
+            {
+                return true;
+            }
+
+            if (!SHA1Util.IsValidShaFormat(sha))
+            {
+                return false;
+            }
+
+            Sha1Id[] shas = new Sha1Id[] { new Sha1Id(sha.ToUpperInvariant()) };
+            long[] sizes = new long[1];
+            if (this.Context.Repository.TryGetPackedBlobLengths(shas, sizes) > 0)
+            {
+                length = sizes[0];
+                return true;
+            }
+
+            return false;
+        }
+
+        /// <summary>
+        /// Batch version of TryGetBlobSizeLocally, sizes[i] is set to -1 when the size of shas[i] is not available locally
+        /// </summary>
+        /// <returns>The number of SHAs whose size was found</returns>
+        /// <remarks>
+        /// Packs are checked first: after a prefetch most blobs are packed, and looking a SHA up in
+        /// the pack indexes is much cheaper than probing the loose object folders for it.
+        /// </remarks>
+        public int TryGetBlobSizesLocally(ReadOnlySpan<Sha1Id> shas, Span<long> sizes)
+        {
+            int foundCount = this.Context.Repository.TryGetPackedBlobLengths(shas, sizes);
+            if (foundCount == shas.Length)
+            {
+                return foundCount;
+            }
+
+            List<int> missingIndices = new List<int>(shas.Length - foundCount);
+            for (int i = 0; i < shas.Length; ++i)
+            {
+                if (sizes[i] < 0)
+                {
+                    missingIndices.Add(i);
+                }
+            }
+
+            Sha1Id[] missingShas = new Sha1Id[missingIndices.Count];
+            for (int i = 0; i < missingShas.Length; ++i)
+            {
+                missingShas[i] = shas[missingIndices[i]];
+            }
+
+            long[] looseSizes = new long[missingShas.Length];
+            if (this.Context.Repository.TryGetBlobLengths(missingShas, looseSizes) > 0)
+            {
+                for (int i = 0; i < looseSizes.Length; ++i)
+                {
+                    if (looseSizes[i] >= 0)
+                    {
+                        sizes[missingIndices[i]] = looseSizes[i];
+                        ++foundCount;
+                    }
+                }
+            }
+
+            return foundCount;
         }
 
         public List<GitObjectsHttpRequestor.GitObjectSize> GetFileSizes(IEnumerable<string> objectIds, CancellationToken cancellationToken)
@@ -7,6 +7,7 @@
 using System;
 using System.Collections.Generic;
 using System.ComponentModel;
+using System.Diagnostics;
 using System.IO;
 using System.Linq;
 using System.Net;
@@ -33,6 +34,8 @@ public abstract class GitObjects
         private const string TempPackFolder = "tempPacks";
         private const string TempIdxExtension = ".tempidx";
 
+        private static long packGeneration;
+
         private readonly PhysicalFileSystem fileSystem;
 
         public GitObjects(ITracer tracer, Enlistment enlistment, GitObjectsHttpRequestor objectRequestor, PhysicalFileSystem fileSystem = null)
@@ -51,6 +54,21 @@ public enum DownloadAndSaveObjectResult
             Error
         }
 
+        /// <summary>
+        /// When set, objects written by WriteLooseObject and packs indexed by IndexPackFile are added
+        /// to this filter so that existence checks that use it can find them.
+        /// </summary>
+        public ObjectExistenceFilter ExistenceFilter { get; set; }
+
+        /// <summary>
+        /// Incremented every time this process adds an idx file to a pack directory, so that readers
+        /// of the pack directories can tell when they need to reload without watching the file system.
+        /// </summary>
+        public static long PackGeneration
+        {
+            get { return Interlocked.Read(ref packGeneration); }
+        }
+
         public static bool IsLooseObjectsDirectory(string value)
         {
             return value.Length == 2 && value.All(c => Uri.IsHexDigit(c));
@@ -58,14 +76,20 @@ public static bool IsLooseObjectsDirectory(string value)
 
         public virtual bool TryDownloadCommit(string commitSha)
         {
-            const bool PreferLooseObjects = false;
-            IEnumerable<string> objectIds = new[] { commitSha };
+            return this.TryDownloadObjects(new[] { commitSha }, preferLooseObjects: false);
+        }
 
+        /// <summary>
+        /// Downloads the objects in a single request, for a commit the server also sends the commit's trees.
+        /// </summary>
+        public virtual bool TryDownloadObjects(IEnumerable<string> objectIds, bool preferLooseObjects)
+        {
             GitProcess gitProcess = new GitProcess(this.Enlistment);
-            RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.InvocationResult output = this.GitObjectRequestor.TryDownloadObjects(
-                objectIds,
-                onSuccess: (tryCount, response) => this.TrySavePackOrLooseObject(objectIds, PreferLooseObjects, response, gitProcess),
-                onFailure: (eArgs) =>
+            ResumableObjectDownload download = new ResumableObjectDownload(objectIds);
+            Func<int, GitEndPointResponseData, RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.CallbackResult> onSuccess =
+                (tryCount, response) => this.TrySavePackOrLooseObject(download, preferLooseObjects, response, gitProcess);
+            Action<RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.ErrorEventArgs> onFailure =
+                (eArgs) =>
                 {
                     EventMetadata metadata = CreateEventMetadata(eArgs.Error);
                     metadata.Add("Operation", "DownloadAndSaveObjects");
@@ -79,8 +103,13 @@ public virtual bool TryDownloadCommit(string commitSha)
                     {
                         this.Tracer.RelatedError(metadata, eArgs.Error.ToString(), Keywords.Network);
                     }
-                },
-                preferBatchedLooseObjects: PreferLooseObjects);
+                };
+
+            // Loose objects are written one at a time, so a retry only requests the objects that earlier
+            // attempts did not write.  A pack can only be used whole, a retry for one requests everything.
+            RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.InvocationResult output = preferLooseObjects
+                ? this.GitObjectRequestor.TryDownloadObjects(download.GetRemainingObjectIds, onSuccess, onFailure, preferBatchedLooseObjects: true)
+                : this.GitObjectRequestor.TryDownloadObjects(objectIds, onSuccess, onFailure, preferBatchedLooseObjects: false);
 
             return output.Succeeded && output.Result.Success;
         }
@@ -264,6 +293,7 @@ public virtual string WriteLooseObject(Stream responseStream, string sha, bool o
                 }
 
                 this.FinalizeTempFile(sha, toWrite, overwriteExistingObject);
+                this.ExistenceFilter?.TryAdd(sha);
 
                 return toWrite.ActualFile;
             }
@@ -445,21 +475,7 @@ public virtual GitProcess.Result IndexPackFile(string packfilePath, GitProcess g
                 }
                 else
                 {
-                    if (this.Enlistment.FlushFileBuffersForPacks)
-                    {
-                        Exception exception;
-                        string error;
-                        if (!this.TryFlushFileBuffers(tempIdxPath, out exception, out error))
-                        {
-                            EventMetadata metadata = CreateEventMetadata(exception);
-                            metadata.Add("packfilePath", packfilePath);
-                            metadata.Add("tempIndexPath", tempIdxPath);
-                            metadata.Add("error", error);
-                            this.Tracer.RelatedWarning(metadata, $"{nameof(this.IndexPackFile)}: Failed to flush temp idx file buffers");
-                        }
-                    }
-
-                    this.fileSystem.MoveAndOverwriteFile(tempIdxPath, idxPath);
+                    this.FinalizeTempIdx(packfilePath, tempIdxPath, idxPath);
                 }
 
                 return result;
@@ -558,6 +574,7 @@ private bool TryMovePackAndIdx(string sourcePackPath, string targetPackPath, out
                 this.fileSystem.DeleteFile(targetIdxPath);
                 this.fileSystem.MoveAndOverwriteFile(sourcePackPath, targetPackPath);
                 this.fileSystem.MoveAndOverwriteFile(sourceIdxPath, targetIdxPath);
+                Interlocked.Increment(ref packGeneration);
             }
             catch (Win32Exception e)
             {
@@ -583,6 +600,49 @@ private bool TryMovePackAndIdx(string sourcePackPath, string targetPackPath, out
             return true;
         }
 
+        private void FinalizeTempIdx(string packfilePath, string tempIdxPath, string idxPath)
+        {
+            if (this.Enlistment.FlushFileBuffersForPacks)
+            {
+                Exception exception;
+                string error;
+                if (!this.TryFlushFileBuffers(tempIdxPath, out exception, out error))
+                {
+                    EventMetadata metadata = CreateEventMetadata(exception);
+                    metadata.Add("packfilePath", packfilePath);
+                    metadata.Add("tempIndexPath", tempIdxPath);
+                    metadata.Add("error", error);
+                    this.Tracer.RelatedWarning(metadata, $"{nameof(this.FinalizeTempIdx)}: Failed to flush temp idx file buffers");
+                }
+            }
+
+            this.fileSystem.MoveAndOverwriteFile(tempIdxPath, idxPath);
+            Interlocked.Increment(ref packGeneration);
+            this.AddPackIndexToExistenceFilter(idxPath);
+        }
+
+        private void AddPackIndexToExistenceFilter(string idxPath)
+        {
+            ObjectExistenceFilter filter = this.ExistenceFilter;
+            if (filter == null)
+            {
+                return;
+            }
+
+            try
+            {
+                filter.AddPackIndex(idxPath);
+            }
+            catch (Exception e) when (e is IOException || e is InvalidDataException || e is UnauthorizedAccessException)
+            {
+                // The pack was indexed successfully, the only cost of the objects not being in the filter
+                // is that they will be treated as missing by checkers that use it
+                EventMetadata metadata = CreateEventMetadata(e);
+                metadata.Add("idxPath", idxPath);
+                this.Tracer.RelatedWarning(metadata, $"{nameof(this.AddPackIndexToExistenceFilter)}: Failed to add pack index to existence filter");
+            }
+        }
+
         private bool TryFlushFileBuffers(string path, out Exception exception, out string error)
         {
             error = null;
@@ -752,11 +812,22 @@ private LooseObjectToWrite GetLooseObjectDestination(string sha)
                     data["uniqueId"] = pack.UniqueId;
                     activity.RelatedEvent(EventLevel.Informational, "Receiving Pack/Index", data);
 
+                    // Unless we can use the server's index, the pack is indexed as it is received so that
+                    // only delta resolution is left to do once the download of the pack completes.
+                    StreamingPackIndexer packIndexer = null;
+                    Stream packSource = pack.PackStream;
+                    if (!trustPackIndexes || pack.IndexStream == null)
+                    {
+                        packIndexer = new StreamingPackIndexer(packTempPath);
+                        packSource = new SideChannelStream(from: pack.PackStream, to: packIndexer);
+                    }
+
                     // Write the pack
                     // If it fails, TryWriteTempFile cleans up the file and we retry the prefetch
                     Task packFlushTask;
-                    if (!this.TryWriteTempFile(activity, pack.PackStream, packTempPath, out packLength, out packFlushTask))
+                    if (!this.TryWriteTempFile(activity, packSource, packTempPath, out packLength, out packFlushTask))
                     {
+                        packIndexer?.Dispose();
                         bytesDownloaded += packLength;
                         allSucceeded = false;
                         break;
@@ -793,7 +864,7 @@ private LooseObjectToWrite GetLooseObjectDestination(string sha)
 
                         // Either we can't trust the index file from the server, or the server didn't provide one, so we will build our own.
                         // For performance, we run the index build in the background while we continue downloading the next pack.
-                        var indexTask = StartPackIndexAsync(activity, packTempPath);
+                        var indexTask = this.StartStreamingPackIndexAsync(activity, packIndexer, packTempPath);
                         currentOperation.ReadyTask = Task.WhenAll(currentOperation.ReadyTask, indexTask);
                         previousPackTask = AddFinalizationTasks(currentOperation, previousPackTask);
 
@@ -900,6 +971,62 @@ private Task StartPackIndexAsync(ITracer activity, string packTempPath)
             return indexTask;
         }
 
+        private Task StartStreamingPackIndexAsync(ITracer activity, StreamingPackIndexer packIndexer, string packTempPath)
+        {
+            return Task.Run(async () =>
+            {
+                bool indexed;
+                using (packIndexer)
+                {
+                    indexed = this.TryWriteStreamedPackIndex(activity, packIndexer, packTempPath);
+                }
+
+                if (!indexed)
+                {
+                    // Let git index-pack have the final say on packs the streaming indexer rejects, it also deletes the pack if it is bad
+                    await this.StartPackIndexAsync(activity, packTempPath);
+                }
+            });
+        }
+
+        private bool TryWriteStreamedPackIndex(ITracer activity, StreamingPackIndexer packIndexer, string packTempPath)
+        {
+            string tempIdxPath = Path.ChangeExtension(packTempPath, TempIdxExtension);
+            string idxPath = GetIndexForPack(packTempPath);
+
+            EventMetadata metadata = CreateEventMetadata();
+            metadata.Add("packTempPath", packTempPath);
+            metadata.Add("objectCount", packIndexer.ObjectCount);
+            metadata.Add("deltaCount", packIndexer.DeltaCount);
+
+            Stopwatch resolveTime = Stopwatch.StartNew();
+            string error;
+            if (!packIndexer.TryWriteIndex(tempIdxPath, out error))
+            {
+                metadata.Add("error", error);
+                activity.RelatedWarning(metadata, $"{nameof(this.TryWriteStreamedPackIndex)}: Falling back to git index-pack");
+
+                Exception exception;
+                this.fileSystem.TryDeleteFile(tempIdxPath, exception: out exception);
+                return false;
+            }
+
+            try
+            {
+                this.FinalizeTempIdx(packTempPath, tempIdxPath, idxPath);
+            }
+            catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+            {
+                metadata.Add("Exception", e.ToString());
+                activity.RelatedWarning(metadata, $"{nameof(this.TryWriteStreamedPackIndex)}: Failed to move index, falling back to git index-pack");
+                return false;
+            }
+
+            metadata.Add("resolveMilliseconds", resolveTime.ElapsedMilliseconds);
+            activity.RelatedEvent(EventLevel.Informational, $"{nameof(this.TryWriteStreamedPackIndex)}: Indexed pack", metadata);
+            return true;
+        }
+
         private bool WaitForPacks(List<TempPrefetchPackAndIdx> tempPacks, ref long latestTimestamp, out Exception exception)
         {
             exception = null;
@@ -1060,14 +1187,14 @@ private void ValidateTempFile(string tempFilePath, string finalFilePath)
         }
 
         private RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.CallbackResult TrySavePackOrLooseObject(
-                                                                                                IEnumerable<string> objectShas,
+                                                                                                ResumableObjectDownload download,
                                                                                                 bool unpackObjects,
                                                                                                 GitEndPointResponseData responseData,
                                                                                                 GitProcess gitProcess)
         {
             if (responseData.ContentType == GitObjectContentType.LooseObject)
             {
-                List<string> objectShaList = objectShas.Distinct().ToList();
+                List<string> objectShaList = download.GetRemainingObjectIds();
                 if (objectShaList.Count != 1)
                 {
                     return new RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.CallbackResult(new InvalidOperationException("Received loose object when multiple objects were requested."), shouldRetry: false);
@@ -1077,16 +1204,34 @@ private void ValidateTempFile(string tempFilePath, string finalFilePath)
                 byte[] bufToCopyWith = new byte[StreamUtil.DefaultCopyBufferSize];
 
                 this.WriteLooseObject(responseData.Stream, objectShaList[0], overwriteExistingObject: false, bufToCopyWith: bufToCopyWith);
+                download.MarkPersisted(objectShaList[0]);
             }
             else if (responseData.ContentType == GitObjectContentType.BatchedLooseObjects)
             {
-                // To reduce allocations, reuse the same buffer when writing objects in this batch
-                byte[] bufToCopyWith = new byte[StreamUtil.DefaultCopyBufferSize];
+                // To reduce allocations, reuse the same buffer when writing objects in this batch (one
+                // buffer per worker, the objects are written in parallel)
+                using (ThreadLocal<byte[]> bufToCopyWith = new ThreadLocal<byte[]>(() => new byte[StreamUtil.DefaultCopyBufferSize]))
+                {
+                    BatchedLooseObjectDeserializer deserializer = new BatchedLooseObjectDeserializer(
+                        responseData.Stream,
+                        (stream, sha) =>
+                        {
+                            this.WriteLooseObject(stream, sha, overwriteExistingObject: false, bufToCopyWith: bufToCopyWith.Value);
+                            download.MarkPersisted(sha);
+                        },
+                        BatchedLooseObjectDeserializer.GetDefaultWorkerCount(concurrentStreams: 1));
 
-                BatchedLooseObjectDeserializer deserializer = new BatchedLooseObjectDeserializer(
-                    responseData.Stream,
-                    (stream, sha) => this.WriteLooseObject(stream, sha, overwriteExistingObject: false, bufToCopyWith: bufToCopyWith));
-                deserializer.ProcessObjects();
+                    try
+                    {
+                        deserializer.ProcessObjects();
+                    }
+                    catch (Exception e) when (download.IsComplete)
+                    {
+                        // Every object was written before the response broke, there is nothing left to retry
+                        EventMetadata metadata = CreateEventMetadata(e);
+                        this.Tracer.RelatedWarning(metadata, "Ignoring error after all requested loose objects were written", Keywords.Network);
+                    }
+                }
             }
             else
             {
@@ -3,7 +3,7 @@
 using System;
 using System.IO;
 using System.IO.Compression;
-using System.Linq;
+using System.Threading;
 using static GVFS.Common.Git.LibGit2Repo;
 
 namespace GVFS.Common.Git
@@ -17,6 +17,7 @@ public class GitRepo : IDisposable
         private LibGit2RepoInvoker libgit2RepoInvoker;
         private Enlistment enlistment;
         private string dotGVFSRoot;
+        private PackObjectSizeReader.IndexCache packIndexCache;
 
         public GitRepo(ITracer tracer, Enlistment enlistment, PhysicalFileSystem fileSystem, Func<LibGit2Repo> repoFactory = null)
         {
@@ -178,6 +179,104 @@ public virtual bool TryGetBlobLength(string blobSha, out long size)
             return this.GetLooseBlobState(blobSha, null, out size) == LooseBlobState.Exists;
         }
 
+        /// <summary>
+        /// Try to find the sizes of a batch of blobs that exist as loose objects.
+        /// </summary>
+        /// <param name="blobShas">SHAs of the blobs to look up</param>
+        /// <param name="sizes">Receives the size of each blob, or -1 if the blob is not a loose object</param>
+        /// <returns>The number of blobs whose size was found</returns>
+        /// <remarks>
+        /// The blobs are looked up in SHA order so that all of the objects in each loose object
+        /// fan-out folder are opened together, while that folder is in the file system's cache.
+        /// </remarks>
+        public virtual int TryGetBlobLengths(ReadOnlySpan<Sha1Id> blobShas, Span<long> sizes)
+        {
+            if (sizes.Length < blobShas.Length)
+            {
+                throw new ArgumentException($"Must be at least as long as {nameof(blobShas)}", nameof(sizes));
+            }
+
+            Sha1Id[] sortedShas = blobShas.ToArray();
+            int[] sortedShaIndices = new int[blobShas.Length];
+            for (int i = 0; i < sortedShaIndices.Length; ++i)
+            {
+                sortedShaIndices[i] = i;
+            }
+
+            Array.Sort(sortedShas, sortedShaIndices);
+
+            int foundCount = 0;
+            for (int i = 0; i < sortedShas.Length; ++i)
+            {
+                long size;
+                if (i > 0 && sortedShas[i] == sortedShas[i - 1])
+                {
+                    size = sizes[sortedShaIndices[i - 1]];
+                }
+                else if (!this.TryGetBlobLength(sortedShas[i].ToString(), out size))
+                {
+                    size = -1;
+                }
+
+                sizes[sortedShaIndices[i]] = size;
+                if (size >= 0)
+                {
+                    ++foundCount;
+                }
+            }
+
+            return foundCount;
+        }
+
+        /// <summary>
+        /// Try to find the sizes of a batch of blobs that are stored in local packfiles, from
+        /// their pack entry headers (see <see cref="PackObjectSizeReader"/>).
+        /// </summary>
+        /// <param name="blobShas">SHAs of the blobs to look up</param>
+        /// <param name="sizes">Receives the size of each blob, or -1 if the blob is not in a local pack</param>
+        /// <returns>The number of blobs whose size was found</returns>
+        /// <remarks>
+        /// The pack indexes are kept open between calls and reloaded when the pack directories change.
+        /// The packs themselves are opened for each call and closed before returning, so that they do
+        /// not block maintenance from deleting them. Callers should look up sizes in batches.
+        /// </remarks>
+        public virtual int TryGetPackedBlobLengths(ReadOnlySpan<Sha1Id> blobShas, Span<long> sizes)
+        {
+            if (sizes.Length < blobShas.Length)
+            {
+                throw new ArgumentException($"Must be at least as long as {nameof(blobShas)}", nameof(sizes));
+            }
+
+            sizes.Slice(0, blobShas.Length).Fill(-1);
+            if (blobShas.Length == 0)
+            {
+                return 0;
+            }
+
+            PackObjectSizeReader.IndexCache indexCache = LazyInitializer.EnsureInitialized(
+                ref this.packIndexCache,
+                () => new PackObjectSizeReader.IndexCache(this.tracer, this.enlistment.LocalObjectsRoot, this.enlistment.GitObjectsRoot));
+
+            int foundCount = 0;
+            using (PackObjectSizeReader reader = indexCache.CreateReader())
+            {
+                if (reader.IndexCount == 0)
+                {
+                    return 0;
+                }
+
+                for (int i = 0; i < blobShas.Length; ++i)
+                {
+                    if (reader.TryGetBlobSize(blobShas[i], out sizes[i]))
+                    {
+                        ++foundCount;
+                    }
+                }
+            }
+
+            return foundCount;
+        }
+
         /// <summary>
         /// Try to find the SHAs of subtrees missing from the given tree.
         /// </summary>
@@ -222,20 +321,26 @@ public void Dispose()
                 this.libgit2RepoInvoker.Dispose();
                 this.libgit2RepoInvoker = null;
             }
+
+            if (this.packIndexCache != null)
+            {
+                this.packIndexCache.Dispose();
+                this.packIndexCache = null;
+            }
         }
 
         private static bool ReadLooseObjectHeader(Stream input, out long size)
         {
             size = 0;
 
-            byte[] buffer = new byte[5];
+            Span<byte> buffer = stackalloc byte[5];
 
             // Verify bytesRead instead of using ReadExactly: a truncated header must
             // return false (Corrupt) so the caller quarantines the file, rather than
             // throwing EndOfStreamException which would be caught as IOException
             // (Unknown) and skip quarantine.
-            int bytesRead = input.Read(buffer, 0, buffer.Length);
-            if (bytesRead < buffer.Length || !Enumerable.SequenceEqual(buffer, LooseBlobHeader))
+            int bytesRead = input.Read(buffer);
+            if (bytesRead < buffer.Length || !buffer.SequenceEqual(LooseBlobHeader))
             {
                 return false;
             }
@@ -441,6 +546,15 @@ public override int Read(byte[] buffer, int offset, int count)
                 return read;
             }
 
+            // Overridden so that a read into unmanaged memory (see BlobContentCopier) goes directly
+            // to the inner stream, the base implementation copies through a rented managed array
+            public override int Read(Span<byte> buffer)
+            {
+                int read = this.inner.Read(buffer);
+                this.bytesRead += read;
+                return read;
+            }
+
             public override int ReadByte()
             {
                 int b = this.inner.ReadByte();
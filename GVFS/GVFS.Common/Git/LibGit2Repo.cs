@@ -184,9 +184,8 @@ public virtual bool TryCopyBlob(string sha, Action<Stream, long> writeAction)
                             byte* originalData = Native.Blob.GetRawContent(objHandle);
                             long originalSize = Native.Blob.GetRawSize(objHandle);
 
-                            // TODO 938696: UnmanagedMemoryStream marshals content even for CopyTo
-                            // If GetRawContent changed to return IntPtr and ProjFS changed WriteBuffer to expose an IntPtr,
-                            // We could probably pinvoke memcpy and avoid marshalling.
+                            // Reading into a span (see BlobContentCopier) copies the content straight to its destination,
+                            // without the intermediate managed buffer that CopyTo and Read into a byte[] need
                             using (Stream mem = new UnmanagedMemoryStream(originalData, originalSize))
                             {
                                 writeAction(mem, originalSize);
@@ -17,17 +17,27 @@ public sealed class MidxReader : IDisposable
         private const uint ChunkIdPNAM = 0x504E414D; // Pack Names
         private const uint ChunkIdOIDF = 0x4F494446; // OID Fanout
         private const uint ChunkIdOIDL = 0x4F49444C; // OID Lookup
+        private const uint ChunkIdOOFF = 0x4F4F4646; // Object Offsets
+        private const uint ChunkIdLOFF = 0x4C4F4646; // Large Offsets
+
+        private const int ObjectOffsetEntrySize = 8; // pack-int-id(4) + offset(4)
+        private const uint LargeOffsetFlag = 0x80000000;
 
         private readonly MemoryMappedFile mmf;
         private readonly MemoryMappedViewAccessor accessor;
         private int hashLen;
         private long fanoutOffset;
         private long oidLookupOffset;
+        private long objectOffsetsOffset;
+        private long largeOffsetsOffset;
         private int totalObjects;
         private HashSet<string> packStems;
+        private List<string> packStemsById;
 
         public int TotalObjects => this.totalObjects;
 
+        public int HashLength => this.hashLen;
+
         public MidxReader(string path)
         {
             long fileLength = new FileInfo(path).Length;
@@ -106,6 +116,12 @@ private void InitializeFromAccessor()
                     case ChunkIdOIDL:
                         this.oidLookupOffset = chunkOffsets[i];
                         break;
+                    case ChunkIdOOFF:
+                        this.objectOffsetsOffset = chunkOffsets[i];
+                        break;
+                    case ChunkIdLOFF:
+                        this.largeOffsetsOffset = chunkOffsets[i];
+                        break;
                 }
             }
 
@@ -119,6 +135,7 @@ private void InitializeFromAccessor()
 
             // Parse pack names from PNAM chunk
             this.packStems = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+            this.packStemsById = new List<string>();
             if (pnamOffset > 0 && pnamEnd > pnamOffset)
             {
                 int pnamLen = (int)(pnamEnd - pnamOffset);
@@ -135,6 +152,9 @@ private void InitializeFromAccessor()
                     }
 
                     this.packStems.Add(stem);
+
+                    // PNAM is in pack-int-id order, which is how OOFF refers to the packs
+                    this.packStemsById.Add(stem);
                 }
             }
         }
@@ -168,6 +188,75 @@ public bool Exists(string shaHex)
         /// Thread-safe.
         /// </summary>
         public bool Exists(ReadOnlySpan<byte> oid)
+        {
+            return this.FindOidIndex(oid) >= 0;
+        }
+
+        /// <summary>
+        /// Copies binary OIDs from the sorted OID table, starting at firstIndex, into buffer.
+        /// Returns the number of OIDs copied, each OID is HashLength bytes.
+        /// </summary>
+        public int CopyOids(int firstIndex, byte[] buffer)
+        {
+            int count = Math.Min(buffer.Length / this.hashLen, this.totalObjects - firstIndex);
+            if (count <= 0)
+            {
+                return 0;
+            }
+
+            this.accessor.ReadArray(this.oidLookupOffset + ((long)firstIndex * this.hashLen), buffer, 0, count * this.hashLen);
+            return count;
+        }
+
+        /// <summary>
+        /// Find the pack (by stem, without extension) that contains the object with the given
+        /// binary OID and the offset of the object's entry in that pack.
+        /// Thread-safe.
+        /// </summary>
+        /// <returns>false if the object is not in the MIDX, or the MIDX has no object offsets</returns>
+        public bool TryGetPackOffset(ReadOnlySpan<byte> oid, out string packStem, out long offset)
+        {
+            packStem = null;
+            offset = 0;
+
+            if (this.objectOffsetsOffset == 0)
+            {
+                return false;
+            }
+
+            int index = this.FindOidIndex(oid);
+            if (index < 0)
+            {
+                return false;
+            }
+
+            long entryOffset = this.objectOffsetsOffset + ((long)index * ObjectOffsetEntrySize);
+            uint packId = this.ReadUInt32BE(entryOffset);
+            uint packOffset = this.ReadUInt32BE(entryOffset + 4);
+            if (packId >= this.packStemsById.Count)
+            {
+                throw new InvalidDataException($"MIDX object offset refers to pack {packId}, but there are only {this.packStemsById.Count} packs");
+            }
+
+            if ((packOffset & LargeOffsetFlag) != 0)
+            {
+                if (this.largeOffsetsOffset == 0)
+                {
+                    throw new InvalidDataException("MIDX object offset refers to a large offset, but there is no LOFF chunk");
+                }
+
+                offset = this.ReadInt64BE(this.largeOffsetsOffset + ((long)(packOffset & ~LargeOffsetFlag) * 8));
+            }
+            else
+            {
+                offset = packOffset;
+            }
+
+            packStem = this.packStemsById[(int)packId];
+            return true;
+        }
+
+        private int FindOidIndex(ReadOnlySpan<byte> oid)
         {
             int firstByte = oid[0];
 
@@ -176,13 +265,13 @@ public bool Exists(ReadOnlySpan<byte> oid)
 
             if (lo >= hi)
             {
-                return false;
+                return -1;
             }
 
             return this.BinarySearchOid(oid, (int)lo, (int)hi - 1);
         }
 
-        private bool BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
+        private int BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
         {
             while (lo <= hi)
             {
@@ -192,7 +281,7 @@ private bool BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
                 int cmp = this.CompareOidAtOffset(target, offset);
                 if (cmp == 0)
                 {
-                    return true;
+                    return mid;
                 }
                 else if (cmp < 0)
                 {
@@ -204,7 +293,7 @@ private bool BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
                 }
             }
 
-            return false;
+            return -1;
         }
 
         [MethodImpl(MethodImplOptions.AggressiveInlining)]
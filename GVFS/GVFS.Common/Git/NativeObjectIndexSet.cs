@@ -0,0 +1,180 @@
+using GVFS.Common.Tracing;
+using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+namespace GVFS.Common.Git
+{
+    /// <summary>
+    /// A set of pack .idx (v2) and multi-pack-index files opened with the native
+    /// GVFS.ObjectLookup library, which searches the OID tables with a fanout narrowed
+    /// interpolation search.  Every lookup probes all of the indexes in a single call,
+    /// in the order their paths were passed to TryOpen.
+    /// Thread-safe, but lookups must not race with Dispose.
+    /// </summary>
+    public sealed class NativeObjectIndexSet : IDisposable
+    {
+        private const int OidLength = 20;
+
+        private static readonly Lazy<bool> NativeLibraryLoaded = new Lazy<bool>(TryLoadNativeLibrary);
+
+        private IntPtr[] indexes;
+
+        private NativeObjectIndexSet(IntPtr[] indexes)
+        {
+            this.indexes = indexes;
+        }
+
+        private enum ObjectLookupResult
+        {
+            Success = 0,
+            InvalidArgument = 1,
+            OpenFailed = 2,
+            MapFailed = 3,
+            InvalidFormat = 4,
+            UnsupportedVersion = 5,
+        }
+
+        /// <summary>
+        /// True if the native library is deployed next to the process and could be loaded
+        /// </summary>
+        public static bool IsAvailable => NativeLibraryLoaded.Value;
+
+        public int IndexCount => this.indexes.Length;
+
+        /// <summary>
+        /// Opens every file in indexPaths.  Returns false (after closing any indexes that
+        /// were opened) if the native library is not available or any of the files cannot be
+        /// opened, callers are expected to fall back to MidxReader and PackIndexReader.
+        /// </summary>
+        public static bool TryOpen(ITracer tracer, IReadOnlyList<string> indexPaths, out NativeObjectIndexSet indexSet)
+        {
+            indexSet = null;
+            if (!IsAvailable)
+            {
+                return false;
+            }
+
+            IntPtr[] indexes = new IntPtr[indexPaths.Count];
+            for (int i = 0; i < indexPaths.Count; i++)
+            {
+                ObjectLookupResult result = (ObjectLookupResult)NativeMethods.Open(indexPaths[i], out indexes[i]);
+                if (result != ObjectLookupResult.Success)
+                {
+                    tracer.RelatedWarning("NativeObjectIndexSet: Failed to open {0}: {1}", indexPaths[i], result);
+                    CloseAll(indexes);
+                    return false;
+                }
+            }
+
+            indexSet = new NativeObjectIndexSet(indexes);
+            return true;
+        }
+
+        /// <summary>
+        /// Check if an object with the given SHA-1 hex string exists in any of the indexes
+        /// </summary>
+        public bool Exists(string shaHex)
+        {
+            if (shaHex == null || shaHex.Length < OidLength * 2)
+            {
+                return false;
+            }
+
+            Span<byte> oid = stackalloc byte[OidLength];
+            MidxReader.HexToBytes(shaHex, oid);
+            return this.Exists(oid);
+        }
+
+        /// <summary>
+        /// Check if an object with the given binary OID exists in any of the indexes
+        /// </summary>
+        public unsafe bool Exists(ReadOnlySpan<byte> oid)
+        {
+            if (oid.Length != OidLength)
+            {
+                throw new ArgumentException($"Must be length {OidLength}", nameof(oid));
+            }
+
+            fixed (IntPtr* indexesPtr = this.indexes)
+            fixed (byte* oidPtr = oid)
+            {
+                return NativeMethods.ExistsInAny(indexesPtr, (nuint)this.indexes.Length, oidPtr) != 0;
+            }
+        }
+
+        /// <summary>
+        /// Look up a batch of binary OIDs (stored back to back), results[i] is set to 1 if the
+        /// i-th OID is in any of the indexes and to 0 if it is not.  This saves a native call
+        /// per OID, but each lookup costs about as much as it does with <see cref="Exists(ReadOnlySpan{byte})"/>.
+        /// </summary>
+        /// <returns>The number of OIDs that were found</returns>
+        public unsafe int ExistsMany(ReadOnlySpan<byte> oids, Span<byte> results)
+        {
+            if (oids.Length % OidLength != 0)
+            {
+                throw new ArgumentException($"Must be a multiple of {OidLength} bytes long", nameof(oids));
+            }
+
+            int oidCount = oids.Length / OidLength;
+            if (results.Length < oidCount)
+            {
+                throw new ArgumentException($"Must have room for {oidCount} results", nameof(results));
+            }
+
+            if (oidCount == 0)
+            {
+                return 0;
+            }
+
+            fixed (IntPtr* indexesPtr = this.indexes)
+            fixed (byte* oidsPtr = oids)
+            fixed (byte* resultsPtr = results)
+            {
+                return (int)NativeMethods.ExistsMany(indexesPtr, (nuint)this.indexes.Length, oidsPtr, (nuint)oidCount, resultsPtr);
+            }
+        }
+
+        public void Dispose()
+        {
+            if (this.indexes != null)
+            {
+                CloseAll(this.indexes);
+                this.indexes = null;
+            }
+        }
+
+        private static void CloseAll(IntPtr[] indexes)
+        {
+            foreach (IntPtr index in indexes)
+            {
+                if (index != IntPtr.Zero)
+                {
+                    NativeMethods.Close(index);
+                }
+            }
+        }
+
+        private static bool TryLoadNativeLibrary()
+        {
+            // Uses the same search as the DllImports below, the library is not deployed with
+            // every tool that references GVFS.Common
+            return NativeLibrary.TryLoad(GVFSConstants.ObjectLookupLibraryName, typeof(NativeObjectIndexSet).Assembly, null, out IntPtr _);
+        }
+
+        private static class NativeMethods
+        {
+            [DllImport(GVFSConstants.ObjectLookupLibraryName, EntryPoint = "ObjectIndex_Open", CharSet = CharSet.Unicode)]
+            public static extern int Open(string path, out IntPtr index);
+
+            [DllImport(GVFSConstants.ObjectLookupLibraryName, EntryPoint = "ObjectIndex_Close")]
+            public static extern void Close(IntPtr index);
+
+            [DllImport(GVFSConstants.ObjectLookupLibraryName, EntryPoint = "ObjectIndex_ExistsInAny")]
+            public static extern unsafe int ExistsInAny(IntPtr* indexes, nuint indexCount, byte* oid);
+
+            [DllImport(GVFSConstants.ObjectLookupLibraryName, EntryPoint = "ObjectIndex_ExistsMany")]
+            public static extern unsafe nuint ExistsMany(IntPtr* indexes, nuint indexCount, byte* oids, nuint oidCount, byte* results);
+        }
+    }
+}
@@ -0,0 +1,237 @@
+using System;
+using System.Buffers;
+using System.Buffers.Binary;
+using System.IO;
+using System.Threading;
+
+namespace GVFS.Common.Git
+{
+    /// <summary>
+    /// Bloom filter over the OIDs of every object in a set of object roots (MIDX, idx files and
+    /// loose objects).  Answers "might this object exist?" without touching the file system, so that
+    /// the common case of checking for an object that is about to be downloaded needs no syscalls.
+    /// A positive answer only means that the object might exist, and the caller must still check.
+    /// </summary>
+    /// <remarks>
+    /// OIDs are already uniformly distributed, so they are used as the filter hashes directly: the first 8 bytes
+    /// choose a 512 bit block and the next 8 bytes choose the bits within that block.  Keeping all of the probes
+    /// for an OID in one block means a lookup costs a single cache miss rather than one per probe.
+    ///
+    /// Add and MightContain are thread-safe.  Objects added concurrently with a lookup might not be seen by that
+    /// lookup, which is no different than the object being added just after the lookup.
+    /// </remarks>
+    public class ObjectExistenceFilter
+    {
+        // 10 bits per entry and 7 probes gives a false positive rate of roughly 1% (slightly higher than
+        // an unblocked filter of the same size)
+        public const int BitsPerEntry = 10;
+        public const int ProbeCount = 7;
+
+        // Objects added after the filter is built (loose objects and indexed packs) are expected, leave
+        // room for them so that the false positive rate does not climb during a long prefetch
+        public const int MinimumHeadroom = 64 * 1024;
+
+        private const int WordsPerBlock = 8;
+        private const int BitsPerBlockShift = 9;
+        private const int BitInBlockMask = (1 << BitsPerBlockShift) - 1;
+
+        // OIDs are copied out of the index files this many bytes at a time
+        private const int OidBufferSize = 256 * 1024;
+
+        private readonly ulong[] bits;
+        private readonly ulong blockCount;
+        private long entryCount;
+
+        public ObjectExistenceFilter(long capacity)
+        {
+            long requestedBits = Math.Max(WordsPerBlock * 64L, capacity * BitsPerEntry);
+            this.blockCount = (ulong)((requestedBits + (WordsPerBlock * 64) - 1) / (WordsPerBlock * 64));
+            this.bits = new ulong[this.blockCount * WordsPerBlock];
+        }
+
+        public long EntryCount
+        {
+            get { return Interlocked.Read(ref this.entryCount); }
+        }
+
+        public long SizeInBytes
+        {
+            get { return (long)this.bits.Length * sizeof(ulong); }
+        }
+
+        /// <summary>
+        /// Returns the capacity to use for a filter that will initially hold objectCount objects.
+        /// </summary>
+        public static long GetCapacityWithHeadroom(long objectCount)
+        {
+            return objectCount + Math.Max(objectCount / 4, MinimumHeadroom);
+        }
+
+        /// <summary>
+        /// Adds the binary OID (at least 16 bytes) to the filter.
+        /// </summary>
+        public void Add(ReadOnlySpan<byte> oid)
+        {
+            ulong blockStart = (BinaryPrimitives.ReadUInt64LittleEndian(oid) % this.blockCount) * WordsPerBlock;
+            ulong bitHash = BinaryPrimitives.ReadUInt64LittleEndian(oid.Slice(8));
+            for (int i = 0; i < ProbeCount; i++)
+            {
+                int bitInBlock = (int)(bitHash >> (i * BitsPerBlockShift)) & BitInBlockMask;
+                ref ulong word = ref this.bits[blockStart + (ulong)(bitInBlock >> 6)];
+                ulong mask = 1UL << (bitInBlock & 63);
+                if ((Volatile.Read(ref word) & mask) == 0)
+                {
+                    Interlocked.Or(ref word, mask);
+                }
+            }
+
+            Interlocked.Increment(ref this.entryCount);
+        }
+
+        /// <summary>
+        /// Adds the object with the given SHA-1 hex string to the filter.
+        /// </summary>
+        /// <returns>false if sha is not a valid SHA-1</returns>
+        public bool TryAdd(string sha)
+        {
+            Span<byte> oid = stackalloc byte[GVFSConstants.ShaStringLength / 2];
+            if (sha == null ||
+                sha.Length != GVFSConstants.ShaStringLength ||
+                Convert.FromHexString(sha, oid, out int _, out int _) != OperationStatus.Done)
+            {
+                return false;
+            }
+
+            this.Add(oid);
+            return true;
+        }
+
+        /// <summary>
+        /// Returns false if the binary OID is definitely not in the filter, and true if it might be
+        /// </summary>
+        public bool MightContain(ReadOnlySpan<byte> oid)
+        {
+            ulong blockStart = (BinaryPrimitives.ReadUInt64LittleEndian(oid) % this.blockCount) * WordsPerBlock;
+            ulong bitHash = BinaryPrimitives.ReadUInt64LittleEndian(oid.Slice(8));
+            for (int i = 0; i < ProbeCount; i++)
+            {
+                int bitInBlock = (int)(bitHash >> (i * BitsPerBlockShift)) & BitInBlockMask;
+                if ((this.bits[blockStart + (ulong)(bitInBlock >> 6)] & (1UL << (bitInBlock & 63))) == 0)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Adds every object in the MIDX to the filter.
+        /// </summary>
+        public void AddObjects(MidxReader reader)
+        {
+            this.AddObjects(reader.TotalObjects, reader.HashLength, reader.CopyOids);
+        }
+
+        /// <summary>
+        /// Adds every object in the pack index to the filter.
+        /// </summary>
+        public void AddObjects(PackIndexReader reader)
+        {
+            this.AddObjects(reader.TotalObjects, reader.HashLength, reader.CopyOids);
+        }
+
+        /// <summary>
+        /// Adds every object in the pack index at idxPath to the filter.
+        /// </summary>
+        /// <exception cref="IOException">The idx file could not be read</exception>
+        /// <exception cref="InvalidDataException">The idx file is not a v2 pack index</exception>
+        public void AddPackIndex(string idxPath)
+        {
+            using (PackIndexReader reader = new PackIndexReader(idxPath))
+            {
+                this.AddObjects(reader);
+            }
+        }
+
+        /// <summary>
+        /// Adds count binary SHA-1 OIDs, packed one after another in oids, to the filter.
+        /// </summary>
+        public void AddObjects(byte[] oids, int count)
+        {
+            const int OidLength = GVFSConstants.ShaStringLength / 2;
+            for (int i = 0; i < count; i++)
+            {
+                this.Add(oids.AsSpan(i * OidLength, OidLength));
+            }
+        }
+
+        /// <summary>
+        /// Reads the names of the loose objects in the fanout directories (objects/xx/) of objectRoot.
+        /// Files that are not named like loose objects (e.g. temp files) are skipped.
+        /// </summary>
+        /// <returns>The binary OIDs of the loose objects, packed one after another</returns>
+        public static byte[] ReadLooseObjectIds(string objectRoot, out int count)
+        {
+            const int OidLength = GVFSConstants.ShaStringLength / 2;
+
+            count = 0;
+            byte[] oids = new byte[256 * OidLength];
+            for (int fanout = 0; fanout < 256; fanout++)
+            {
+                string fanoutDirectory = Path.Combine(objectRoot, fanout.ToString("x2"));
+                try
+                {
+                    if (!Directory.Exists(fanoutDirectory))
+                    {
+                        continue;
+                    }
+
+                    foreach (string file in Directory.EnumerateFiles(fanoutDirectory))
+                    {
+                        if ((count + 1) * OidLength > oids.Length)
+                        {
+                            Array.Resize(ref oids, oids.Length * 2);
+                        }
+
+                        Span<byte> oid = oids.AsSpan(count * OidLength, OidLength);
+                        ReadOnlySpan<char> fileName = Path.GetFileName(file.AsSpan());
+                        if (fileName.Length == GVFSConstants.ShaStringLength - 2 &&
+                            Convert.FromHexString(fileName, oid.Slice(1), out int _, out int _) == OperationStatus.Done)
+                        {
+                            oid[0] = (byte)fanout;
+                            ++count;
+                        }
+                    }
+                }
+                catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+                {
+                    // Fanout directory was deleted or could not be enumerated, skip it
+                }
+            }
+
+            return oids;
+        }
+
+        private void AddObjects(int totalObjects, int hashLength, Func<int, byte[], int> copyOids)
+        {
+            byte[] buffer = new byte[OidBufferSize];
+            int index = 0;
+            while (index < totalObjects)
+            {
+                int copied = copyOids(index, buffer);
+                if (copied == 0)
+                {
+                    break;
+                }
+
+                for (int i = 0; i < copied; i++)
+                {
+                    this.Add(buffer.AsSpan(i * hashLength, hashLength));
+                }
+
+                index += copied;
+            }
+        }
+    }
+}
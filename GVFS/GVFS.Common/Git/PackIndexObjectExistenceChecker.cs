@@ -1,22 +1,50 @@
 using GVFS.Common.Tracing;
 using System;
 using System.Collections.Generic;
+using System.Diagnostics;
 using System.IO;
 using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
 
 namespace GVFS.Common.Git
 {
     /// <summary>
-    /// Object existence checker that reads MIDX and pack .idx files directly
-    /// in managed code. Falls back to loose-object file existence checks.
+    /// Object existence checker that reads MIDX and pack .idx files directly,
+    /// with the native GVFS.ObjectLookup library when it is deployed and in
+    /// managed code otherwise. Falls back to loose-object file existence checks.
+    /// Every lookup is first checked against an <see cref="ObjectExistenceFilter"/> built from
+    /// the same indexes and a snapshot of the loose objects, so that objects which are
+    /// definitely missing are reported without probing any index or file.
     /// Thread-safe — all reads are against read-only memory-mapped files.
     /// </summary>
+    /// <remarks>
+    /// Loose objects written by other processes after the snapshot is taken are reported as
+    /// missing unless they are added to <see cref="ExistenceFilter"/>. The only cost of that is
+    /// downloading the object again, which is what happened before the snapshot was added
+    /// whenever a loose object was written just after it was checked.
+    ///
+    /// The set of indexes is reloaded when the pack directories change (as reported by a
+    /// FileSystemWatcher, or by <see cref="GitObjects.PackGeneration"/> for packs added by
+    /// this process). The reload happens in the background and the new set of readers is
+    /// swapped in with a single reference assignment, so lookups never wait for it. Lookups
+    /// hold a reference on the set of readers they are using, and the readers of a replaced
+    /// set are disposed when the last lookup using them completes.
+    /// </remarks>
     public class PackIndexObjectExistenceChecker : IObjectExistenceChecker
     {
-        private readonly MidxReader[] midxReaders;
-        private readonly PackIndexReader[] supplementalPacks;
+        private const string MidxFileName = "multi-pack-index";
+
+        private readonly ObjectExistenceFilter existenceFilter;
         private readonly string[] objectRoots;
         private readonly ITracer tracer;
+        private readonly List<FileSystemWatcher> packDirectoryWatchers = new List<FileSystemWatcher>();
+        private readonly object refreshLock = new object();
+
+        private IndexSnapshot snapshot;
+        private long watcherGeneration;
+        private int refreshQueued;
+        private bool isDisposed;
 
         /// <summary>
         /// Creates a checker that scans packs and loose objects under the given object roots.
@@ -34,9 +62,270 @@ public PackIndexObjectExistenceChecker(ITracer tracer, params string[] objectRoo
                 .Distinct(StringComparer.OrdinalIgnoreCase)
                 .ToArray();
 
+            // Start watching before loading so that no change can be missed between the two
+            this.StartWatchingPackDirectories();
+
+            this.snapshot = this.LoadSnapshot(this.GetRequestedGeneration(), previous: null, out this.existenceFilter);
+
+            tracer.RelatedInfo(
+                "PackIndexChecker: Initialized with {0} MIDX reader(s), {1} supplemental pack(s), {2} native index(es), {3} object root(s)",
+                this.snapshot.MidxReaders.Length,
+                this.snapshot.SupplementalPacks.Length,
+                this.snapshot.NativeIndexes?.IndexCount ?? 0,
+                this.objectRoots.Length);
+        }
+
+        /// <summary>
+        /// Filter of the objects known to this checker. Objects that are added to the object
+        /// roots after the checker is created must be added to the filter to be found.
+        /// </summary>
+        public ObjectExistenceFilter ExistenceFilter => this.existenceFilter;
+
+        /// <summary>
+        /// Generation of the pack directories that the current set of readers was loaded for.
+        /// </summary>
+        public long LoadedGeneration => Volatile.Read(ref this.snapshot).Generation;
+
+        public bool ObjectExists(string sha)
+        {
+            if (sha == null || sha.Length < GVFSConstants.ShaStringLength)
+            {
+                return false;
+            }
+
+            if (Volatile.Read(ref this.snapshot).Generation != this.GetRequestedGeneration())
+            {
+                this.QueueRefresh();
+            }
+
+            Span<byte> oid = stackalloc byte[GVFSConstants.ShaStringLength / 2];
+            MidxReader.HexToBytes(sha, oid);
+
+            // Most lookups are for objects that are about to be downloaded, answer those
+            // without touching the indexes or the file system
+            if (!this.existenceFilter.MightContain(oid))
+            {
+                return false;
+            }
+
+            IndexSnapshot current = this.AcquireSnapshot();
+            try
+            {
+                if (current.Exists(oid))
+                {
+                    return true;
+                }
+            }
+            finally
+            {
+                current.Release();
+            }
+
+            // Loose object fallback: check objects/<ab>/<cd...> file existence
+            string prefix = sha.Substring(0, 2);
+            string suffix = sha.Substring(2);
+            for (int i = 0; i < this.objectRoots.Length; i++)
+            {
+                string loosePath = Path.Combine(this.objectRoots[i], prefix, suffix);
+                if (File.Exists(loosePath))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /// <summary>
+        /// Reloads the MIDX and idx files now, rather than waiting for a lookup to notice that
+        /// the pack directories have changed.
+        /// </summary>
+        public void Refresh()
+        {
+            lock (this.refreshLock)
+            {
+                if (this.isDisposed)
+                {
+                    return;
+                }
+
+                // Read the generation before loading, a change made while loading will then
+                // trigger another refresh
+                long generation = this.GetRequestedGeneration();
+                IndexSnapshot previous = Volatile.Read(ref this.snapshot);
+
+                Stopwatch stopwatch = Stopwatch.StartNew();
+                IndexSnapshot refreshed = this.LoadSnapshot(generation, previous, out ObjectExistenceFilter _);
+                Volatile.Write(ref this.snapshot, refreshed);
+                previous.Release();
+
+                this.tracer.RelatedInfo(
+                    "PackIndexChecker: Reloaded generation {0} with {1} MIDX reader(s), {2} supplemental pack(s), {3} native index(es) in {4}ms",
+                    generation,
+                    refreshed.MidxReaders.Length,
+                    refreshed.SupplementalPacks.Length,
+                    refreshed.NativeIndexes?.IndexCount ?? 0,
+                    stopwatch.ElapsedMilliseconds);
+            }
+        }
+
+        public void Dispose()
+        {
+            lock (this.refreshLock)
+            {
+                if (this.isDisposed)
+                {
+                    return;
+                }
+
+                this.isDisposed = true;
+
+                foreach (FileSystemWatcher watcher in this.packDirectoryWatchers)
+                {
+                    watcher.Dispose();
+                }
+
+                // Lookups that are still running keep the readers alive until they complete
+                IndexSnapshot previous = Volatile.Read(ref this.snapshot);
+                Volatile.Write(ref this.snapshot, IndexSnapshot.CreateEmpty(previous.Generation));
+                previous.Release();
+            }
+        }
+
+        private static string GetFileVersion(string path)
+        {
+            FileInfo info = new FileInfo(path);
+            return path + "|" + info.Length + "|" + info.LastWriteTimeUtc.Ticks;
+        }
+
+        private static bool IsIndexFileName(string name)
+        {
+            return name != null &&
+                (name.EndsWith(".idx", StringComparison.OrdinalIgnoreCase) ||
+                 name.Equals(MidxFileName, StringComparison.OrdinalIgnoreCase));
+        }
+
+        private long GetRequestedGeneration()
+        {
+            return Interlocked.Read(ref this.watcherGeneration) + GitObjects.PackGeneration;
+        }
+
+        private void QueueRefresh()
+        {
+            if (Interlocked.CompareExchange(ref this.refreshQueued, 1, 0) != 0)
+            {
+                return;
+            }
+
+            Task.Run(() =>
+            {
+                try
+                {
+                    this.Refresh();
+                }
+                catch (Exception e)
+                {
+                    EventMetadata metadata = new EventMetadata();
+                    metadata.Add("Area", nameof(PackIndexObjectExistenceChecker));
+                    metadata.Add("Exception", e.ToString());
+                    this.tracer.RelatedWarning(metadata, "PackIndexChecker: Failed to reload pack indexes");
+                }
+                finally
+                {
+                    Volatile.Write(ref this.refreshQueued, 0);
+                }
+            });
+        }
+
+        private IndexSnapshot AcquireSnapshot()
+        {
+            while (true)
+            {
+                IndexSnapshot current = Volatile.Read(ref this.snapshot);
+                if (current.TryAddReference())
+                {
+                    return current;
+                }
+
+                // The snapshot was replaced and released between reading it and adding the reference,
+                // the replacement has already been published
+            }
+        }
+
+        private void StartWatchingPackDirectories()
+        {
+            foreach (string root in this.objectRoots)
+            {
+                string packDir = Path.Combine(root, "pack");
+                if (!Directory.Exists(packDir))
+                {
+                    continue;
+                }
+
+                try
+                {
+                    FileSystemWatcher watcher = new FileSystemWatcher(packDir);
+                    watcher.NotifyFilter = NotifyFilters.FileName | NotifyFilters.LastWrite | NotifyFilters.Size;
+                    watcher.Created += this.OnPackDirectoryChanged;
+                    watcher.Changed += this.OnPackDirectoryChanged;
+                    watcher.Deleted += this.OnPackDirectoryChanged;
+                    watcher.Renamed += this.OnPackDirectoryRenamed;
+                    watcher.Error += this.OnPackDirectoryWatcherError;
+                    watcher.EnableRaisingEvents = true;
+                    this.packDirectoryWatchers.Add(watcher);
+                }
+                catch (Exception e) when (e is IOException || e is ArgumentException || e is PlatformNotSupportedException)
+                {
+                    // Packs added by this process are still picked up through GitObjects.PackGeneration
+                    this.tracer.RelatedWarning("PackIndexChecker: Failed to watch {0}: {1}", packDir, e.Message);
+                }
+            }
+        }
+
+        private void OnPackDirectoryChanged(object sender, FileSystemEventArgs e)
+        {
+            if (IsIndexFileName(e.Name))
+            {
+                Interlocked.Increment(ref this.watcherGeneration);
+            }
+        }
+
+        private void OnPackDirectoryRenamed(object sender, RenamedEventArgs e)
+        {
+            if (IsIndexFileName(e.Name) || IsIndexFileName(e.OldName))
+            {
+                Interlocked.Increment(ref this.watcherGeneration);
+            }
+        }
+
+        private void OnPackDirectoryWatcherError(object sender, ErrorEventArgs e)
+        {
+            // Events were dropped (e.g. the buffer overflowed), assume that the indexes changed
+            Interlocked.Increment(ref this.watcherGeneration);
+        }
+
+        /// <summary>
+        /// Opens the MIDX and idx files of every object root. When there is no previous snapshot a new
+        /// existence filter is created, otherwise the objects of any index that was not in the previous
+        /// snapshot are added to the existing filter.
+        /// </summary>
+        private IndexSnapshot LoadSnapshot(long generation, IndexSnapshot previous, out ObjectExistenceFilter createdFilter)
+        {
+            createdFilter = null;
+
             List<MidxReader> midxList = new List<MidxReader>();
             List<PackIndexReader> supplementalList = new List<PackIndexReader>();
 
+            // Paths of the loaded MIDX and idx files, in the order they should be probed
+            List<string> midxPaths = new List<string>();
+            List<string> supplementalPaths = new List<string>();
+
+            // Versions (path, size and timestamp) of the loaded files, and the readers of the files that
+            // were not loaded by the previous snapshot
+            HashSet<string> fileVersions = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+            List<MidxReader> newMidxReaders = new List<MidxReader>();
+            List<PackIndexReader> newSupplementalReaders = new List<PackIndexReader>();
+
             foreach (string root in this.objectRoots)
             {
                 string packDir = Path.Combine(root, "pack");
@@ -46,25 +335,33 @@ public PackIndexObjectExistenceChecker(ITracer tracer, params string[] objectRoo
                 }
 
                 HashSet<string> midxPackStems = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
-                string midxPath = Path.Combine(packDir, "multi-pack-index");
+                string midxPath = Path.Combine(packDir, MidxFileName);
 
                 if (File.Exists(midxPath))
                 {
                     try
                     {
+                        string version = GetFileVersion(midxPath);
                         MidxReader reader = new MidxReader(midxPath);
                         midxList.Add(reader);
+                        midxPaths.Add(midxPath);
                         midxPackStems = reader.GetPackStems();
 
-                        tracer.RelatedInfo(
-                            "PackIndexChecker: Loaded MIDX from {0} ({1:N0} objects, {2} packs)",
-                            packDir,
-                            reader.TotalObjects,
-                            midxPackStems.Count);
+                        fileVersions.Add(version);
+                        if (previous?.FileVersions.Contains(version) != true)
+                        {
+                            newMidxReaders.Add(reader);
+
+                            this.tracer.RelatedInfo(
+                                "PackIndexChecker: Loaded MIDX from {0} ({1:N0} objects, {2} packs)",
+                                packDir,
+                                reader.TotalObjects,
+                                midxPackStems.Count);
+                        }
                     }
                     catch (Exception ex) when (ex is InvalidDataException || ex is IOException)
                     {
-                        tracer.RelatedWarning("PackIndexChecker: Failed to load MIDX at {0}: {1}", midxPath, ex.Message);
+                        this.tracer.RelatedWarning("PackIndexChecker: Failed to load MIDX at {0}: {1}", midxPath, ex.Message);
                     }
                 }
 
@@ -78,17 +375,25 @@ public PackIndexObjectExistenceChecker(ITracer tracer, params string[] objectRoo
                         {
                             try
                             {
+                                string version = GetFileVersion(idxFile);
                                 PackIndexReader reader = new PackIndexReader(idxFile);
                                 supplementalList.Add(reader);
+                                supplementalPaths.Add(idxFile);
+
+                                fileVersions.Add(version);
+                                if (previous?.FileVersions.Contains(version) != true)
+                                {
+                                    newSupplementalReaders.Add(reader);
 
-                                tracer.RelatedInfo(
-                                    "PackIndexChecker: Loaded supplemental idx {0} ({1:N0} objects)",
-                                    Path.GetFileName(idxFile),
-                                    reader.TotalObjects);
+                                    this.tracer.RelatedInfo(
+                                        "PackIndexChecker: Loaded supplemental idx {0} ({1:N0} objects)",
+                                        Path.GetFileName(idxFile),
+                                        reader.TotalObjects);
+                                }
                             }
                             catch (Exception ex) when (ex is InvalidDataException || ex is IOException)
                             {
-                                tracer.RelatedWarning(
+                                this.tracer.RelatedWarning(
                                     "PackIndexChecker: Failed to load idx {0}: {1}",
                                     idxFile,
                                     ex.Message);
@@ -102,64 +407,171 @@ public PackIndexObjectExistenceChecker(ITracer tracer, params string[] objectRoo
                 }
             }
 
-            this.midxReaders = midxList.ToArray();
-            this.supplementalPacks = supplementalList.ToArray();
+            if (previous == null)
+            {
+                createdFilter = this.BuildExistenceFilter(midxList, supplementalList);
+            }
+            else
+            {
+                // Objects are never removed from the filter, objects of packs that were deleted
+                // only add to the false positive rate
+                newMidxReaders.ForEach(reader => this.existenceFilter.AddObjects(reader));
+                newSupplementalReaders.ForEach(reader => this.existenceFilter.AddObjects(reader));
+            }
+
+            // The managed readers were needed to find which idx files the MIDX covers. When the same
+            // files can be opened natively the native library does the lookups (probing every index
+            // in one call) and the managed readers are closed so the files are only mapped once.
+            NativeObjectIndexSet nativeIndexes = null;
+            List<string> indexPaths = midxPaths.Concat(supplementalPaths).ToList();
+            if (indexPaths.Count > 0 && NativeObjectIndexSet.TryOpen(this.tracer, indexPaths, out nativeIndexes))
+            {
+                midxList.ForEach(reader => reader.Dispose());
+                supplementalList.ForEach(reader => reader.Dispose());
+                midxList.Clear();
+                supplementalList.Clear();
+            }
 
-            tracer.RelatedInfo(
-                "PackIndexChecker: Initialized with {0} MIDX reader(s), {1} supplemental pack(s), {2} object root(s)",
-                this.midxReaders.Length,
-                this.supplementalPacks.Length,
-                this.objectRoots.Length);
+            return new IndexSnapshot(generation, midxList.ToArray(), supplementalList.ToArray(), nativeIndexes, fileVersions);
         }
 
-        public bool ObjectExists(string sha)
+        private ObjectExistenceFilter BuildExistenceFilter(List<MidxReader> midxList, List<PackIndexReader> supplementalList)
         {
-            // Check MIDX readers first (covers the vast majority of objects)
-            for (int i = 0; i < this.midxReaders.Length; i++)
+            Stopwatch stopwatch = Stopwatch.StartNew();
+
+            long objectCount = midxList.Sum(reader => (long)reader.TotalObjects) + supplementalList.Sum(reader => (long)reader.TotalObjects);
+            List<KeyValuePair<byte[], int>> looseObjectIds = new List<KeyValuePair<byte[], int>>();
+            foreach (string root in this.objectRoots)
             {
-                if (this.midxReaders[i].Exists(sha))
-                {
-                    return true;
-                }
+                byte[] oids = ObjectExistenceFilter.ReadLooseObjectIds(root, out int count);
+                looseObjectIds.Add(new KeyValuePair<byte[], int>(oids, count));
+                objectCount += count;
             }
 
-            // Check supplemental pack indexes (packs not yet in MIDX)
-            for (int i = 0; i < this.supplementalPacks.Length; i++)
+            ObjectExistenceFilter filter = new ObjectExistenceFilter(ObjectExistenceFilter.GetCapacityWithHeadroom(objectCount));
+            midxList.ForEach(reader => filter.AddObjects(reader));
+            supplementalList.ForEach(reader => filter.AddObjects(reader));
+            foreach (KeyValuePair<byte[], int> oids in looseObjectIds)
             {
-                if (this.supplementalPacks[i].Exists(sha))
-                {
-                    return true;
-                }
+                filter.AddObjects(oids.Key, oids.Value);
             }
 
-            // Loose object fallback: check objects/<ab>/<cd...> file existence
-            if (sha != null && sha.Length >= GVFSConstants.ShaStringLength)
+            this.tracer.RelatedInfo(
+                "PackIndexChecker: Built existence filter with {0:N0} objects ({1:N0} loose) in {2:N0} bytes, {3}ms",
+                filter.EntryCount,
+                looseObjectIds.Sum(oids => (long)oids.Value),
+                filter.SizeInBytes,
+                stopwatch.ElapsedMilliseconds);
+
+            return filter;
+        }
+
+        /// <summary>
+        /// The readers for one generation of the pack directories. The snapshot starts with one reference,
+        /// owned by the checker while the snapshot is current, and the readers are disposed when the last
+        /// reference is released.
+        /// </summary>
+        private sealed class IndexSnapshot
+        {
+            private int referenceCount = 1;
+
+            public IndexSnapshot(
+                long generation,
+                MidxReader[] midxReaders,
+                PackIndexReader[] supplementalPacks,
+                NativeObjectIndexSet nativeIndexes,
+                HashSet<string> fileVersions)
+            {
+                this.Generation = generation;
+                this.MidxReaders = midxReaders;
+                this.SupplementalPacks = supplementalPacks;
+                this.NativeIndexes = nativeIndexes;
+                this.FileVersions = fileVersions;
+            }
+
+            public long Generation { get; }
+
+            public MidxReader[] MidxReaders { get; }
+
+            public PackIndexReader[] SupplementalPacks { get; }
+
+            public NativeObjectIndexSet NativeIndexes { get; }
+
+            public HashSet<string> FileVersions { get; }
+
+            public static IndexSnapshot CreateEmpty(long generation)
             {
-                string prefix = sha.Substring(0, 2);
-                string suffix = sha.Substring(2);
-                for (int i = 0; i < this.objectRoots.Length; i++)
+                return new IndexSnapshot(
+                    generation,
+                    Array.Empty<MidxReader>(),
+                    Array.Empty<PackIndexReader>(),
+                    nativeIndexes: null,
+                    fileVersions: new HashSet<string>());
+            }
+
+            public bool TryAddReference()
+            {
+                int count = Volatile.Read(ref this.referenceCount);
+                while (count > 0)
                 {
-                    string loosePath = Path.Combine(this.objectRoots[i], prefix, suffix);
-                    if (File.Exists(loosePath))
+                    int original = Interlocked.CompareExchange(ref this.referenceCount, count + 1, count);
+                    if (original == count)
                     {
                         return true;
                     }
+
+                    count = original;
                 }
-            }
 
-            return false;
-        }
+                return false;
+            }
 
-        public void Dispose()
-        {
-            foreach (MidxReader reader in this.midxReaders)
+            public void Release()
             {
-                reader.Dispose();
+                if (Interlocked.Decrement(ref this.referenceCount) == 0)
+                {
+                    this.NativeIndexes?.Dispose();
+
+                    foreach (MidxReader reader in this.MidxReaders)
+                    {
+                        reader.Dispose();
+                    }
+
+                    foreach (PackIndexReader reader in this.SupplementalPacks)
+                    {
+                        reader.Dispose();
+                    }
+                }
             }
 
-            foreach (PackIndexReader reader in this.supplementalPacks)
+            public bool Exists(ReadOnlySpan<byte> oid)
             {
-                reader.Dispose();
+                // Native indexes replace the managed readers when they are available (the reader
+                // arrays are empty in that case)
+                if (this.NativeIndexes != null && this.NativeIndexes.Exists(oid))
+                {
+                    return true;
+                }
+
+                // Check MIDX readers first (covers the vast majority of objects)
+                for (int i = 0; i < this.MidxReaders.Length; i++)
+                {
+                    if (this.MidxReaders[i].Exists(oid))
+                    {
+                        return true;
+                    }
+                }
+
+                // Check supplemental pack indexes (packs not yet in MIDX)
+                for (int i = 0; i < this.SupplementalPacks.Length; i++)
+                {
+                    if (this.SupplementalPacks[i].Exists(oid))
+                    {
+                        return true;
+                    }
+                }
+
+                return false;
             }
         }
     }
@@ -16,6 +16,7 @@ public sealed class PackIndexReader : IDisposable
         private const int FanoutEntries = 256;
         private const int FanoutSize = FanoutEntries * 4;
         private const int HeaderSize = 8; // magic(4) + version(4)
+        private const uint LargeOffsetFlag = 0x80000000;
 
         private readonly MemoryMappedFile mmf;
         private readonly MemoryMappedViewAccessor accessor;
@@ -26,6 +27,8 @@ public sealed class PackIndexReader : IDisposable
 
         public int TotalObjects => this.totalObjects;
 
+        public int HashLength => this.hashLen;
+
         public PackIndexReader(string idxPath)
         {
             long fileLength = new FileInfo(idxPath).Length;
@@ -88,6 +91,61 @@ public bool Exists(string shaHex)
         /// Thread-safe.
         /// </summary>
         public bool Exists(ReadOnlySpan<byte> oid)
+        {
+            return this.FindOidIndex(oid) >= 0;
+        }
+
+        /// <summary>
+        /// Copies binary OIDs from the sorted OID table, starting at firstIndex, into buffer.
+        /// Returns the number of OIDs copied, each OID is HashLength bytes.
+        /// </summary>
+        public int CopyOids(int firstIndex, byte[] buffer)
+        {
+            int count = Math.Min(buffer.Length / this.hashLen, this.totalObjects - firstIndex);
+            if (count <= 0)
+            {
+                return 0;
+            }
+
+            this.accessor.ReadArray(this.oidTableOffset + ((long)firstIndex * this.hashLen), buffer, 0, count * this.hashLen);
+            return count;
+        }
+
+        /// <summary>
+        /// Get the offset in the pack of the entry for the object with the given binary OID.
+        /// Thread-safe.
+        /// </summary>
+        public bool TryGetOffset(ReadOnlySpan<byte> oid, out long offset)
+        {
+            offset = 0;
+
+            int index = this.FindOidIndex(oid);
+            if (index < 0)
+            {
+                return false;
+            }
+
+            // The OID table is followed by a table of CRC32s and then a table of 4 byte offsets,
+            // offsets with the MSB set are an index into a table of 8 byte offsets
+            long crcTableOffset = this.oidTableOffset + ((long)this.totalObjects * this.hashLen);
+            long offsetTableOffset = crcTableOffset + ((long)this.totalObjects * 4);
+            uint packOffset = this.ReadUInt32BE(offsetTableOffset + ((long)index * 4));
+
+            if ((packOffset & LargeOffsetFlag) != 0)
+            {
+                long largeOffsetTableOffset = offsetTableOffset + ((long)this.totalObjects * 4);
+                long largeOffsetEntry = largeOffsetTableOffset + ((long)(packOffset & ~LargeOffsetFlag) * 8);
+                offset = ((long)this.ReadUInt32BE(largeOffsetEntry) << 32) | this.ReadUInt32BE(largeOffsetEntry + 4);
+            }
+            else
+            {
+                offset = packOffset;
+            }
+
+            return true;
+        }
+
+        private int FindOidIndex(ReadOnlySpan<byte> oid)
         {
             int firstByte = oid[0];
 
@@ -96,13 +154,13 @@ public bool Exists(ReadOnlySpan<byte> oid)
 
             if (lo >= hi)
             {
-                return false;
+                return -1;
             }
 
             return this.BinarySearchOid(oid, (int)lo, (int)hi - 1);
         }
 
-        private bool BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
+        private int BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
         {
             while (lo <= hi)
             {
@@ -112,7 +170,7 @@ private bool BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
                 int cmp = this.CompareOidAtOffset(target, offset);
                 if (cmp == 0)
                 {
-                    return true;
+                    return mid;
                 }
                 else if (cmp < 0)
                 {
@@ -124,7 +182,7 @@ private bool BinarySearchOid(ReadOnlySpan<byte> target, int lo, int hi)
                 }
             }
 
-            return false;
+            return -1;
         }
 
         [MethodImpl(MethodImplOptions.AggressiveInlining)]
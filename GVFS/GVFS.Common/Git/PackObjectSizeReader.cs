@@ -0,0 +1,614 @@
+using GVFS.Common.Tracing;
+using Microsoft.Win32.SafeHandles;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.Compression;
+using System.Linq;
+using System.Threading;
+
+namespace GVFS.Common.Git
+{
+    /// <summary>
+    /// Reads the size of blobs stored in local packfiles from their pack entry headers, using the
+    /// MIDX and pack .idx files to find the entries. Objects are never fully inflated: the size of
+    /// an undeltified blob is in its entry header, and for a deltified blob only the start of the
+    /// delta is inflated to read the size of the delta's result. The delta chain is then followed,
+    /// reading only entry headers, to check that the object is a blob.
+    /// </summary>
+    /// <remarks>
+    /// The reader keeps the pack files that it reads open and should be short lived (one batch of
+    /// lookups), so that maintenance can delete expired packs. Readers created by an
+    /// <see cref="IndexCache"/> share its MIDX and idx readers rather than opening and mapping every
+    /// index for each batch. Not thread-safe.
+    /// </remarks>
+    public sealed class PackObjectSizeReader : IDisposable
+    {
+        private const int ObjectTypeBlob = 3;
+        private const int ObjectTypeOfsDelta = 6;
+        private const int ObjectTypeRefDelta = 7;
+
+        // Deeper chains are not produced by git (pack.depth is capped at 4095)
+        private const int MaxDeltaChainLength = 4095;
+
+        // Longest entry header: type and size (at most 10 bytes for a 64-bit size) followed
+        // by either an OFS_DELTA offset (at most 10 bytes) or a REF_DELTA base OID (20 bytes)
+        private const int MaxEntryHeaderLength = 32;
+
+        // Compressed bytes read to inflate the two size varints at the start of a delta, enough
+        // to cover the largest dynamic Huffman block header
+        private const int DeltaHeaderReadLength = 1024;
+
+        private const int ShaLength = 20;
+
+        private readonly ITracer tracer;
+        private readonly PackIndexes indexes;
+        private readonly Dictionary<string, SafeFileHandle> openPacks;
+        private readonly byte[] oidBuffer;
+        private readonly byte[] entryHeaderBuffer;
+        private readonly byte[] deltaHeaderBuffer;
+
+        private bool isDisposed;
+
+        /// <summary>
+        /// Creates a reader for the packs under the given object roots. Multiple roots are supported
+        /// (e.g. LocalObjectsRoot and GitObjectsRoot) and are de-duplicated by normalized path.
+        /// </summary>
+        public PackObjectSizeReader(ITracer tracer, params string[] objectRoots)
+            : this(tracer, PackIndexes.Load(tracer, GetPackDirectories(objectRoots), version: null))
+        {
+        }
+
+        /// <param name="indexes">Indexes to read, this reader takes ownership of one reference on them</param>
+        private PackObjectSizeReader(ITracer tracer, PackIndexes indexes)
+        {
+            this.tracer = tracer;
+            this.indexes = indexes;
+            this.openPacks = new Dictionary<string, SafeFileHandle>(StringComparer.OrdinalIgnoreCase);
+            this.oidBuffer = new byte[ShaLength];
+            this.entryHeaderBuffer = new byte[MaxEntryHeaderLength];
+            this.deltaHeaderBuffer = new byte[DeltaHeaderReadLength];
+        }
+
+        public int IndexCount
+        {
+            get { return this.indexes.Packs.Length; }
+        }
+
+        /// <summary>
+        /// Get the size of a blob from its entry in a local pack
+        /// </summary>
+        /// <returns>
+        /// true if the object was found in a local pack and is a blob, false if it is not in a local
+        /// pack, is not a blob, or its entry could not be read
+        /// </returns>
+        public bool TryGetBlobSize(Sha1Id sha, out long size)
+        {
+            size = -1;
+            sha.ToBuffer(this.oidBuffer);
+
+            string packPath = null;
+            try
+            {
+                if (!this.TryFindEntry(this.oidBuffer, out packPath, out long offset))
+                {
+                    return false;
+                }
+
+                PackEntry entry = this.ReadEntryHeader(packPath, offset);
+                if (entry.Type == ObjectTypeBlob)
+                {
+                    size = entry.Size;
+                    return true;
+                }
+
+                if (entry.Type != ObjectTypeOfsDelta && entry.Type != ObjectTypeRefDelta)
+                {
+                    return false;
+                }
+
+                long resultSize = this.ReadDeltaResultSize(packPath, entry.DataOffset);
+
+                // The result of a delta has the same type as its base, follow the chain to
+                // the undeltified base to make sure that the object is a blob
+                for (int depth = 0; depth < MaxDeltaChainLength; ++depth)
+                {
+                    if (entry.Type == ObjectTypeOfsDelta)
+                    {
+                        offset = entry.BaseOffset;
+                    }
+                    else if (!this.TryFindEntry(entry.BaseOid, out packPath, out offset))
+                    {
+                        // The base of a REF_DELTA is always in a local pack once the pack has been indexed,
+                        // but it may have been removed by maintenance since this reader was created
+                        return false;
+                    }
+
+                    entry = this.ReadEntryHeader(packPath, offset);
+                    if (entry.Type == ObjectTypeBlob)
+                    {
+                        size = resultSize;
+                        return true;
+                    }
+
+                    if (entry.Type != ObjectTypeOfsDelta && entry.Type != ObjectTypeRefDelta)
+                    {
+                        return false;
+                    }
+                }
+
+                throw new InvalidDataException($"Delta chain is longer than {MaxDeltaChainLength}");
+            }
+            catch (Exception e) when (e is IOException || e is InvalidDataException || e is UnauthorizedAccessException)
+            {
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("Area", nameof(PackObjectSizeReader));
+                metadata.Add("sha", sha.ToString());
+                metadata.Add("packPath", packPath);
+                metadata.Add("Exception", e.ToString());
+                this.tracer.RelatedWarning(metadata, nameof(this.TryGetBlobSize) + ": Failed to read size from pack entry", Keywords.Telemetry);
+
+                size = -1;
+                return false;
+            }
+        }
+
+        public void Dispose()
+        {
+            if (this.isDisposed)
+            {
+                return;
+            }
+
+            this.isDisposed = true;
+            this.indexes.Release();
+
+            foreach (SafeFileHandle packHandle in this.openPacks.Values)
+            {
+                packHandle.Dispose();
+            }
+
+            this.openPacks.Clear();
+        }
+
+        /// <summary>
+        /// Decodes the git variable length integer used for the sizes at the start of a delta:
+        /// 7 bits per byte, least significant group first, MSB set on all but the last byte
+        /// </summary>
+        internal static bool TryReadDeltaSize(ReadOnlySpan<byte> buffer, ref int position, out long size)
+        {
+            size = 0;
+            int shift = 0;
+            while (position < buffer.Length && shift < 64)
+            {
+                byte b = buffer[position++];
+                size |= (long)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                {
+                    return true;
+                }
+
+                shift += 7;
+            }
+
+            return false;
+        }
+
+        private static string[] GetPackDirectories(string[] objectRoots)
+        {
+            return objectRoots
+                .Where(r => !string.IsNullOrEmpty(r))
+                .Select(r => Path.GetFullPath(r))
+                .Distinct(StringComparer.OrdinalIgnoreCase)
+                .Select(r => Path.Combine(r, GVFSConstants.DotGit.Objects.Pack.Name))
+                .ToArray();
+        }
+
+        private bool TryFindEntry(ReadOnlySpan<byte> oid, out string packPath, out long offset)
+        {
+            IndexedPacks[] packs = this.indexes.Packs;
+            for (int i = 0; i < packs.Length; ++i)
+            {
+                if (packs[i].TryGetPackOffset(oid, out packPath, out offset))
+                {
+                    return true;
+                }
+            }
+
+            packPath = null;
+            offset = 0;
+            return false;
+        }
+
+        private SafeFileHandle GetPackHandle(string packPath)
+        {
+            SafeFileHandle packHandle;
+            if (!this.openPacks.TryGetValue(packPath, out packHandle))
+            {
+                // Allow the pack to be deleted while it is open, e.g. by maintenance expiring it
+                packHandle = File.OpenHandle(packPath, FileMode.Open, FileAccess.Read, FileShare.Read | FileShare.Delete);
+                this.openPacks.Add(packPath, packHandle);
+            }
+
+            return packHandle;
+        }
+
+        /// <summary>
+        /// Reads the header of the pack entry at offset: the object type and size, and for
+        /// deltas the location of the base
+        /// </summary>
+        private PackEntry ReadEntryHeader(string packPath, long offset)
+        {
+            int bytesRead = RandomAccess.Read(this.GetPackHandle(packPath), this.entryHeaderBuffer, offset);
+            ReadOnlySpan<byte> header = this.entryHeaderBuffer.AsSpan(0, bytesRead);
+            if (header.Length == 0)
+            {
+                throw new InvalidDataException($"Pack entry offset {offset} is past the end of the pack");
+            }
+
+            // Type is bits 4-6 of the first byte, the size is the low 4 bits followed by 7 bits
+            // per byte (least significant group first) while the MSB is set
+            int position = 0;
+            byte b = header[position++];
+            PackEntry entry = new PackEntry();
+            entry.Type = (b >> 4) & 0x7;
+            entry.Size = b & 0xF;
+
+            int shift = 4;
+            while ((b & 0x80) != 0)
+            {
+                if (position >= header.Length || shift >= 64)
+                {
+                    throw new InvalidDataException($"Invalid pack entry header at offset {offset}");
+                }
+
+                b = header[position++];
+                entry.Size |= (long)(b & 0x7F) << shift;
+                shift += 7;
+            }
+
+            if (entry.Type == ObjectTypeOfsDelta)
+            {
+                // The distance back to the base uses a different encoding than the size: most significant
+                // group first, and 1 is added to all but the last group so that each value has one encoding
+                if (position >= header.Length)
+                {
+                    throw new InvalidDataException($"Invalid OFS_DELTA header at offset {offset}");
+                }
+
+                b = header[position++];
+                long distance = b & 0x7F;
+                while ((b & 0x80) != 0)
+                {
+                    if (position >= header.Length)
+                    {
+                        throw new InvalidDataException($"Invalid OFS_DELTA header at offset {offset}");
+                    }
+
+                    b = header[position++];
+                    distance = ((distance + 1) << 7) | (long)(b & 0x7F);
+                }
+
+                if (distance <= 0 || distance > offset)
+                {
+                    throw new InvalidDataException($"Invalid OFS_DELTA base distance {distance} at offset {offset}");
+                }
+
+                entry.BaseOffset = offset - distance;
+            }
+            else if (entry.Type == ObjectTypeRefDelta)
+            {
+                if (position + ShaLength > header.Length)
+                {
+                    throw new InvalidDataException($"Invalid REF_DELTA header at offset {offset}");
+                }
+
+                entry.BaseOid = header.Slice(position, ShaLength).ToArray();
+                position += ShaLength;
+            }
+
+            entry.DataOffset = offset + position;
+            return entry;
+        }
+
+        /// <summary>
+        /// Inflates just enough of the delta at dataOffset to read its base size and result size
+        /// </summary>
+        private long ReadDeltaResultSize(string packPath, long dataOffset)
+        {
+            int bytesRead = RandomAccess.Read(this.GetPackHandle(packPath), this.deltaHeaderBuffer, dataOffset);
+
+            // The two varints are at most 20 bytes, and a truncated read only affects output
+            // beyond them (DeflateStream returns partial data rather than throwing)
+            Span<byte> inflated = stackalloc byte[20];
+            int inflatedLength = 0;
+            using (MemoryStream compressed = new MemoryStream(this.deltaHeaderBuffer, 0, bytesRead, writable: false))
+            using (ZLibStream inflater = new ZLibStream(compressed, CompressionMode.Decompress))
+            {
+                int read;
+                while (inflatedLength < inflated.Length &&
+                    (read = inflater.Read(inflated.Slice(inflatedLength))) > 0)
+                {
+                    inflatedLength += read;
+                }
+            }
+
+            int position = 0;
+            ReadOnlySpan<byte> deltaHeader = inflated.Slice(0, inflatedLength);
+            if (!TryReadDeltaSize(deltaHeader, ref position, out long _) ||
+                !TryReadDeltaSize(deltaHeader, ref position, out long resultSize))
+            {
+                throw new InvalidDataException($"Invalid delta header at offset {dataOffset}");
+            }
+
+            return resultSize;
+        }
+
+        private struct PackEntry
+        {
+            public int Type;
+            public long Size;
+            public long DataOffset;
+            public long BaseOffset;
+            public byte[] BaseOid;
+        }
+
+        /// <summary>
+        /// Keeps the MIDX and idx files of a set of object roots open between batches of lookups, so
+        /// that each batch does not open and map every index again. Thread-safe.
+        /// </summary>
+        /// <remarks>
+        /// The indexes are reloaded by the first batch that sees a change in
+        /// <see cref="GitObjects.PackGeneration"/> (packs added by this process) or in the last write
+        /// time of a pack directory (packs added or deleted, or the multi-pack-index replaced, by other
+        /// processes such as maintenance). Every reader holds a reference on the indexes it was created
+        /// with, and indexes that were replaced are closed when the last of those readers is disposed.
+        /// </remarks>
+        public sealed class IndexCache : IDisposable
+        {
+            private readonly ITracer tracer;
+            private readonly string[] packDirs;
+            private readonly object loadLock = new object();
+
+            private PackIndexes current;
+            private bool isDisposed;
+
+            public IndexCache(ITracer tracer, params string[] objectRoots)
+            {
+                this.tracer = tracer;
+                this.packDirs = GetPackDirectories(objectRoots);
+            }
+
+            /// <summary>
+            /// Creates a reader for one batch of lookups, using the current indexes
+            /// </summary>
+            public PackObjectSizeReader CreateReader()
+            {
+                return new PackObjectSizeReader(this.tracer, this.AcquireIndexes());
+            }
+
+            public void Dispose()
+            {
+                lock (this.loadLock)
+                {
+                    if (this.isDisposed)
+                    {
+                        return;
+                    }
+
+                    this.isDisposed = true;
+
+                    // Readers that are still in use keep the indexes open until they are disposed
+                    this.current?.Release();
+                    this.current = null;
+                }
+            }
+
+            private PackIndexes AcquireIndexes()
+            {
+                string version = this.GetVersion();
+                PackIndexes indexes = Volatile.Read(ref this.current);
+                if (indexes != null && indexes.Version == version && indexes.TryAddReference())
+                {
+                    return indexes;
+                }
+
+                lock (this.loadLock)
+                {
+                    if (this.isDisposed)
+                    {
+                        throw new ObjectDisposedException(nameof(IndexCache));
+                    }
+
+                    indexes = this.current;
+                    if (indexes == null || indexes.Version != version)
+                    {
+                        // A change made while loading gives a different version, and the next
+                        // batch loads the indexes again
+                        PackIndexes loaded = PackIndexes.Load(this.tracer, this.packDirs, version);
+                        Volatile.Write(ref this.current, loaded);
+                        indexes?.Release();
+                        indexes = loaded;
+                    }
+
+                    // The current indexes hold their own reference until they are replaced,
+                    // which can only happen under loadLock
+                    indexes.TryAddReference();
+                    return indexes;
+                }
+            }
+
+            private string GetVersion()
+            {
+                string version = GitObjects.PackGeneration.ToString();
+                foreach (string packDir in this.packDirs)
+                {
+                    // Returns a fixed time (not an exception) when the directory does not exist
+                    version += "|" + Directory.GetLastWriteTimeUtc(packDir).Ticks;
+                }
+
+                return version;
+            }
+        }
+
+        /// <summary>
+        /// The MIDX and idx readers of a set of pack directories. The indexes start with one reference,
+        /// owned by whoever loaded them, and the readers are disposed when the last reference is released.
+        /// </summary>
+        private sealed class PackIndexes
+        {
+            private int referenceCount = 1;
+
+            private PackIndexes(string version, IndexedPacks[] packs)
+            {
+                this.Version = version;
+                this.Packs = packs;
+            }
+
+            public string Version { get; }
+
+            public IndexedPacks[] Packs { get; }
+
+            public static PackIndexes Load(ITracer tracer, string[] packDirs, string version)
+            {
+                List<IndexedPacks> packs = new List<IndexedPacks>();
+                foreach (string packDir in packDirs)
+                {
+                    LoadIndexes(tracer, packDir, packs);
+                }
+
+                return new PackIndexes(version, packs.ToArray());
+            }
+
+            public bool TryAddReference()
+            {
+                int count = Volatile.Read(ref this.referenceCount);
+                while (count > 0)
+                {
+                    int original = Interlocked.CompareExchange(ref this.referenceCount, count + 1, count);
+                    if (original == count)
+                    {
+                        return true;
+                    }
+
+                    count = original;
+                }
+
+                return false;
+            }
+
+            public void Release()
+            {
+                if (Interlocked.Decrement(ref this.referenceCount) == 0)
+                {
+                    foreach (IndexedPacks index in this.Packs)
+                    {
+                        index.Dispose();
+                    }
+                }
+            }
+
+            private static void LoadIndexes(ITracer tracer, string packDir, List<IndexedPacks> packs)
+            {
+                if (!Directory.Exists(packDir))
+                {
+                    return;
+                }
+
+                HashSet<string> midxPackStems = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+                string midxPath = Path.Combine(packDir, "multi-pack-index");
+                if (File.Exists(midxPath))
+                {
+                    try
+                    {
+                        MidxReader midx = new MidxReader(midxPath);
+                        packs.Add(new IndexedPacks(packDir, midx));
+                        midxPackStems = midx.GetPackStems();
+                    }
+                    catch (Exception e) when (e is InvalidDataException || e is IOException)
+                    {
+                        tracer.RelatedWarning("{0}: Failed to load MIDX at {1}: {2}", nameof(PackObjectSizeReader), midxPath, e.Message);
+                    }
+                }
+
+                try
+                {
+                    foreach (string idxPath in Directory.GetFiles(packDir, "*.idx"))
+                    {
+                        string stem = Path.GetFileNameWithoutExtension(idxPath);
+                        if (!midxPackStems.Contains(stem))
+                        {
+                            try
+                            {
+                                packs.Add(new IndexedPacks(packDir, stem, new PackIndexReader(idxPath)));
+                            }
+                            catch (Exception e) when (e is InvalidDataException || e is IOException)
+                            {
+                                tracer.RelatedWarning("{0}: Failed to load idx {1}: {2}", nameof(PackObjectSizeReader), idxPath, e.Message);
+                            }
+                        }
+                    }
+                }
+                catch (DirectoryNotFoundException)
+                {
+                    // Pack directory disappeared between check and enumeration
+                }
+            }
+        }
+
+        /// <summary>
+        /// Either a MIDX and the packs it covers, or a single pack index and its pack
+        /// </summary>
+        private sealed class IndexedPacks : IDisposable
+        {
+            private readonly string packDir;
+            private readonly string packStem;
+            private readonly MidxReader midx;
+            private readonly PackIndexReader packIndex;
+
+            public IndexedPacks(string packDir, MidxReader midx)
+            {
+                this.packDir = packDir;
+                this.midx = midx;
+            }
+
+            public IndexedPacks(string packDir, string packStem, PackIndexReader packIndex)
+            {
+                this.packDir = packDir;
+                this.packStem = packStem;
+                this.packIndex = packIndex;
+            }
+
+            public bool TryGetPackOffset(ReadOnlySpan<byte> oid, out string packPath, out long offset)
+            {
+                packPath = null;
+                string stem;
+                if (this.midx != null)
+                {
+                    if (!this.midx.TryGetPackOffset(oid, out stem, out offset))
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    if (!this.packIndex.TryGetOffset(oid, out offset))
+                    {
+                        return false;
+                    }
+
+                    stem = this.packStem;
+                }
+
+                packPath = Path.Combine(this.packDir, stem + ".pack");
+                return true;
+            }
+
+            public void Dispose()
+            {
+                this.midx?.Dispose();
+                this.packIndex?.Dispose();
+            }
+        }
+    }
+}
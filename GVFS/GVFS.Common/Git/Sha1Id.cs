@@ -1,10 +1,11 @@
 ﻿using System;
+using System.Buffers.Binary;
 using System.Runtime.InteropServices;
 
 namespace GVFS.Common.Git
 {
     [StructLayout(LayoutKind.Explicit, Size = ShaBufferLength, Pack = 1)]
-    public struct Sha1Id
+    public struct Sha1Id : IEquatable<Sha1Id>, IComparable<Sha1Id>
     {
         public static readonly Sha1Id None = new Sha1Id();
 
@@ -44,6 +45,16 @@ public Sha1Id(string sha)
             this.shaBytes17Through20 = ShaSubStringToUInt(sha.Substring(32, 8));
         }
 
+        public static bool operator ==(Sha1Id left, Sha1Id right)
+        {
+            return left.Equals(right);
+        }
+
+        public static bool operator !=(Sha1Id left, Sha1Id right)
+        {
+            return !left.Equals(right);
+        }
+
         public static bool TryParse(string sha, out Sha1Id sha1, out string error)
         {
             error = null;
@@ -102,6 +113,45 @@ public void ToBuffer(byte[] shaBuffer)
             }
         }
 
+        public bool Equals(Sha1Id other)
+        {
+            return this.shaBytes1Through8 == other.shaBytes1Through8 &&
+                this.shaBytes9Through16 == other.shaBytes9Through16 &&
+                this.shaBytes17Through20 == other.shaBytes17Through20;
+        }
+
+        /// <summary>
+        /// Compares the SHAs byte by byte, which is the same order as git (and SQLite for BLOB columns) sorts them
+        /// </summary>
+        public int CompareTo(Sha1Id other)
+        {
+            // The bytes are stored little-endian, reverse them so that the first byte of the SHA is the most significant
+            int comparison = BinaryPrimitives.ReverseEndianness(this.shaBytes1Through8).CompareTo(BinaryPrimitives.ReverseEndianness(other.shaBytes1Through8));
+            if (comparison != 0)
+            {
+                return comparison;
+            }
+
+            comparison = BinaryPrimitives.ReverseEndianness(this.shaBytes9Through16).CompareTo(BinaryPrimitives.ReverseEndianness(other.shaBytes9Through16));
+            if (comparison != 0)
+            {
+                return comparison;
+            }
+
+            return BinaryPrimitives.ReverseEndianness(this.shaBytes17Through20).CompareTo(BinaryPrimitives.ReverseEndianness(other.shaBytes17Through20));
+        }
+
+        public override bool Equals(object obj)
+        {
+            return obj is Sha1Id other && this.Equals(other);
+        }
+
+        public override int GetHashCode()
+        {
+            // The bytes of a SHA are already uniformly distributed, so the first 4 bytes make a good hash
+            return (int)this.shaBytes1Through8;
+        }
+
         public override string ToString()
         {
             char[] shaString = new char[ShaStringLength];
@@ -0,0 +1,985 @@
+using ICSharpCode.SharpZipLib;
+using ICSharpCode.SharpZipLib.Checksum;
+using ICSharpCode.SharpZipLib.Zip.Compression;
+using Microsoft.Win32.SafeHandles;
+using System;
+using System.Buffers;
+using System.Buffers.Binary;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.InteropServices;
+using System.Security.Cryptography;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.Common.Git
+{
+    /// <summary>
+    /// Builds a pack index (.idx v2) for a pack while the pack is being downloaded, so that
+    /// indexing overlaps with the download instead of starting once the pack is complete.
+    /// </summary>
+    /// <remarks>
+    /// Pack bytes are written to this stream as they arrive (e.g. through a <see cref="SideChannelStream"/>)
+    /// and the offset and CRC32 of every entry, and the id of every non-delta object, are computed as the
+    /// data goes by.  Deltas can only be hashed once their bases are known, so they are resolved by
+    /// <see cref="TryWriteIndex"/> from the completed pack file.  Writes never throw: a pack that cannot be
+    /// parsed only marks the indexer as failed, so the download is unaffected and the caller can fall back
+    /// to git index-pack.
+    /// </remarks>
+    public sealed class StreamingPackIndexer : Stream
+    {
+        private const int HashLength = 20;
+        private const int PackHeaderSize = 12;
+        private const uint PackSignature = 0x5041434B; // "PACK"
+        private const uint IdxV2Magic = 0xFF744F63;
+        private const int FanoutEntries = 256;
+        private const long MaxSmallOffset = 0x7FFFFFFF;
+        private const uint LargeOffsetFlag = 0x80000000;
+
+        // Type and size varint (at most 10 bytes for a 64-bit size) followed by either an
+        // OFS_DELTA distance varint or a REF_DELTA base id
+        private const int MaxEntryHeaderSize = 10 + HashLength;
+        private const int InflateBufferSize = 64 * 1024;
+
+        private const byte CommitType = 1;
+        private const byte TreeType = 2;
+        private const byte BlobType = 3;
+        private const byte TagType = 4;
+        private const byte OfsDeltaType = 6;
+        private const byte RefDeltaType = 7;
+
+        private readonly string packPath;
+        private readonly IncrementalHash packHash;
+        private readonly IncrementalHash objectHash;
+        private readonly Inflater inflater;
+        private readonly Crc32 entryCrc;
+        private readonly byte[] headerBuffer;
+        private readonly byte[] inflateBuffer;
+
+        private ParseState state;
+        private int headerLength;
+        private long position;
+        private long entryOffset;
+        private long trailerOffset;
+        private string error;
+
+        private PackEntry[] entries;
+        private byte[] oids;
+        private List<KeyValuePair<int, Sha1Id>> refDeltaBases;
+        private int entriesParsed;
+        private int deltaCount;
+        private long inflatedLength;
+        private byte[] packChecksum;
+
+        private int[] firstOfsChild;
+        private int[] nextOfsSibling;
+        private ConcurrentDictionary<Sha1Id, List<int>> refChildren;
+        private int resolvedDeltaCount;
+
+        /// <param name="packPath">
+        /// Path the pack is being written to, deltas are resolved by reading it back once it is complete
+        /// </param>
+        public StreamingPackIndexer(string packPath)
+        {
+            this.packPath = packPath;
+            this.packHash = IncrementalHash.CreateHash(HashAlgorithmName.SHA1); // CodeQL [SM02196] SHA-1 is acceptable here because this is Git's hashing algorithm, not used for cryptographic purposes
+            this.objectHash = IncrementalHash.CreateHash(HashAlgorithmName.SHA1); // CodeQL [SM02196] SHA-1 is acceptable here because this is Git's hashing algorithm, not used for cryptographic purposes
+            this.inflater = new Inflater();
+            this.entryCrc = new Crc32();
+            this.headerBuffer = new byte[MaxEntryHeaderSize];
+            this.inflateBuffer = new byte[InflateBufferSize];
+            this.refDeltaBases = new List<KeyValuePair<int, Sha1Id>>();
+            this.state = ParseState.PackHeader;
+        }
+
+        private enum ParseState
+        {
+            PackHeader,
+            EntryHeader,
+            EntryData,
+            Trailer,
+            Complete,
+        }
+
+        public override bool CanRead => false;
+
+        public override bool CanSeek => false;
+
+        public override bool CanWrite => true;
+
+        public override long Length => this.position;
+
+        public override long Position { get => this.position; set => throw new NotSupportedException(); }
+
+        /// <summary>
+        /// True once the whole pack, including a matching trailing checksum, has been written
+        /// </summary>
+        public bool IsComplete => this.state == ParseState.Complete && this.error == null;
+
+        /// <summary>
+        /// Why the pack could not be indexed, or null if no problem has been found
+        /// </summary>
+        public string Error => this.error;
+
+        public int ObjectCount => this.entries?.Length ?? 0;
+
+        public int DeltaCount => this.deltaCount;
+
+        public override void Flush()
+        {
+        }
+
+        public override int Read(byte[] buffer, int offset, int count)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override long Seek(long offset, SeekOrigin origin)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override void SetLength(long value)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override void Write(byte[] buffer, int offset, int count)
+        {
+            if (this.error != null)
+            {
+                this.position += count;
+                return;
+            }
+
+            try
+            {
+                while (count > 0 && this.error == null)
+                {
+                    int consumed;
+                    switch (this.state)
+                    {
+                        case ParseState.PackHeader:
+                            consumed = this.ReadPackHeader(buffer, offset, count);
+                            break;
+                        case ParseState.EntryHeader:
+                            consumed = this.ReadEntryHeader(buffer, offset, count);
+                            break;
+                        case ParseState.EntryData:
+                            consumed = this.InflateEntryData(buffer, offset, count);
+                            break;
+                        case ParseState.Trailer:
+                            consumed = this.ReadTrailer(buffer, offset, count);
+                            break;
+                        default:
+                            this.Fail("Unexpected data after the end of the pack");
+                            consumed = count;
+                            break;
+                    }
+
+                    this.position += consumed;
+                    offset += consumed;
+                    count -= consumed;
+                }
+            }
+            catch (Exception e) when (e is SharpZipBaseException || e is InvalidDataException)
+            {
+                this.Fail(e.Message);
+            }
+
+            this.position += count;
+        }
+
+        /// <summary>
+        /// Resolves the deltas in the pack and writes its index to <paramref name="idxPath"/>.  Must only
+        /// be called once all of the pack has been written to this stream and flushed to the pack file.
+        /// </summary>
+        public bool TryWriteIndex(string idxPath, out string error)
+        {
+            if (this.error != null)
+            {
+                error = this.error;
+                return false;
+            }
+
+            if (this.state != ParseState.Complete)
+            {
+                error = $"Pack is incomplete, received {this.entriesParsed} of {this.ObjectCount} objects";
+                return false;
+            }
+
+            try
+            {
+                this.ResolveDeltas();
+                this.WriteIndex(idxPath);
+            }
+            catch (Exception e) when (e is IOException || e is InvalidDataException || e is UnauthorizedAccessException || e is SharpZipBaseException)
+            {
+                error = e.Message;
+                return false;
+            }
+            catch (AggregateException e)
+            {
+                error = e.Flatten().InnerException.Message;
+                return false;
+            }
+
+            error = null;
+            return true;
+        }
+
+        /// <summary>
+        /// Applies a git delta (base size, result size, then copy and insert instructions) to <paramref name="baseData"/>
+        /// </summary>
+        internal static byte[] ApplyDelta(byte[] baseData, byte[] delta)
+        {
+            int position = 0;
+            if (!PackObjectSizeReader.TryReadDeltaSize(delta, ref position, out long baseSize) ||
+                !PackObjectSizeReader.TryReadDeltaSize(delta, ref position, out long resultSize))
+            {
+                throw new InvalidDataException("Delta header is truncated");
+            }
+
+            if (baseSize != baseData.Length)
+            {
+                throw new InvalidDataException($"Delta expects a base of {baseSize} bytes but the base is {baseData.Length} bytes");
+            }
+
+            if (resultSize > Array.MaxLength)
+            {
+                throw new InvalidDataException($"Delta result of {resultSize} bytes is too large");
+            }
+
+            byte[] result = new byte[resultSize];
+            int resultPosition = 0;
+            while (position < delta.Length)
+            {
+                byte instruction = delta[position++];
+                if ((instruction & 0x80) != 0)
+                {
+                    // Copy from the base: the low 4 bits select which offset bytes follow, the next 3 bits which size bytes follow
+                    long copyOffset = 0;
+                    int copySize = 0;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        if ((instruction & (1 << i)) != 0)
+                        {
+                            copyOffset |= (long)ReadDeltaByte(delta, ref position) << (i * 8);
+                        }
+                    }
+
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        if ((instruction & (0x10 << i)) != 0)
+                        {
+                            copySize |= ReadDeltaByte(delta, ref position) << (i * 8);
+                        }
+                    }
+
+                    if (copySize == 0)
+                    {
+                        copySize = 0x10000;
+                    }
+
+                    if (copyOffset + copySize > baseData.Length || copySize > result.Length - resultPosition)
+                    {
+                        throw new InvalidDataException("Delta copy instruction is out of range");
+                    }
+
+                    Buffer.BlockCopy(baseData, (int)copyOffset, result, resultPosition, copySize);
+                    resultPosition += copySize;
+                }
+                else if (instruction != 0)
+                {
+                    // Insert the next 'instruction' bytes of the delta
+                    if (instruction > delta.Length - position || instruction > result.Length - resultPosition)
+                    {
+                        throw new InvalidDataException("Delta insert instruction is out of range");
+                    }
+
+                    Buffer.BlockCopy(delta, position, result, resultPosition, instruction);
+                    position += instruction;
+                    resultPosition += instruction;
+                }
+                else
+                {
+                    throw new InvalidDataException("Delta contains a reserved instruction");
+                }
+            }
+
+            if (resultPosition != result.Length)
+            {
+                throw new InvalidDataException($"Delta produced {resultPosition} bytes but should have produced {result.Length}");
+            }
+
+            return result;
+        }
+
+        protected override void Dispose(bool disposing)
+        {
+            if (disposing)
+            {
+                this.packHash.Dispose();
+                this.objectHash.Dispose();
+            }
+
+            base.Dispose(disposing);
+        }
+
+        private static byte ReadDeltaByte(byte[] delta, ref int position)
+        {
+            if (position >= delta.Length)
+            {
+                throw new InvalidDataException("Delta instruction is truncated");
+            }
+
+            return delta[position++];
+        }
+
+        private static string GetTypeName(byte type)
+        {
+            switch (type)
+            {
+                case CommitType:
+                    return "commit";
+                case TreeType:
+                    return "tree";
+                case BlobType:
+                    return "blob";
+                case TagType:
+                    return "tag";
+                default:
+                    throw new InvalidDataException($"Invalid object type {type}");
+            }
+        }
+
+        private static byte[] GetObjectHeader(byte type, long size)
+        {
+            return Encoding.ASCII.GetBytes($"{GetTypeName(type)} {size}\0");
+        }
+
+        private static Sha1Id ToSha1Id(ReadOnlySpan<byte> oid)
+        {
+            return new Sha1Id(
+                MemoryMarshal.Read<ulong>(oid),
+                MemoryMarshal.Read<ulong>(oid.Slice(sizeof(ulong))),
+                MemoryMarshal.Read<uint>(oid.Slice(sizeof(ulong) * 2)));
+        }
+
+        private void Fail(string message)
+        {
+            if (this.error == null)
+            {
+                this.error = $"Failed to index pack at offset {this.position}: {message}";
+            }
+        }
+
+        private void Hash(byte[] buffer, int offset, int count)
+        {
+            this.packHash.AppendData(buffer, offset, count);
+            if (this.state == ParseState.EntryHeader || this.state == ParseState.EntryData)
+            {
+                this.entryCrc.Update(new ArraySegment<byte>(buffer, offset, count));
+            }
+        }
+
+        private int ReadPackHeader(byte[] buffer, int offset, int count)
+        {
+            int consumed = Math.Min(count, PackHeaderSize - this.headerLength);
+            Buffer.BlockCopy(buffer, offset, this.headerBuffer, this.headerLength, consumed);
+            this.headerLength += consumed;
+            this.Hash(buffer, offset, consumed);
+
+            if (this.headerLength == PackHeaderSize)
+            {
+                ReadOnlySpan<byte> header = this.headerBuffer;
+                uint signature = BinaryPrimitives.ReadUInt32BigEndian(header);
+                uint version = BinaryPrimitives.ReadUInt32BigEndian(header.Slice(4));
+                uint objectCount = BinaryPrimitives.ReadUInt32BigEndian(header.Slice(8));
+                if (signature != PackSignature || (version != 2 && version != 3))
+                {
+                    this.Fail($"Invalid pack header, signature {signature:X8} version {version}");
+                    return consumed;
+                }
+
+                if (objectCount > Array.MaxLength / HashLength)
+                {
+                    this.Fail($"Pack has too many objects to index: {objectCount}");
+                    return consumed;
+                }
+
+                this.entries = new PackEntry[objectCount];
+                this.oids = new byte[objectCount * HashLength];
+                this.headerLength = 0;
+                this.StartNextEntry();
+            }
+
+            return consumed;
+        }
+
+        private int ReadEntryHeader(byte[] buffer, int offset, int count)
+        {
+            // Entry headers are a few bytes long, so they are parsed a byte at a time to handle
+            // headers that are split across writes
+            int consumed = 0;
+            while (consumed < count && this.state == ParseState.EntryHeader && this.error == null)
+            {
+                if (this.headerLength == this.headerBuffer.Length)
+                {
+                    this.Fail("Entry header is too long");
+                    break;
+                }
+
+                if (this.headerLength == 0)
+                {
+                    this.entryOffset = this.position + consumed;
+                }
+
+                this.headerBuffer[this.headerLength++] = buffer[offset + consumed];
+                this.Hash(buffer, offset + consumed, 1);
+                ++consumed;
+
+                this.TryStartEntryData();
+            }
+
+            return consumed;
+        }
+
+        private void TryStartEntryData()
+        {
+            int index = 0;
+            byte b = this.headerBuffer[index++];
+            byte type = (byte)((b >> 4) & 0x7);
+            long size = b & 0xF;
+            int shift = 4;
+            while ((b & 0x80) != 0)
+            {
+                if (index == this.headerLength)
+                {
+                    return;
+                }
+
+                if (shift > 57)
+                {
+                    this.Fail("Entry size is too large");
+                    return;
+                }
+
+                b = this.headerBuffer[index++];
+                size |= (long)(b & 0x7F) << shift;
+                shift += 7;
+            }
+
+            long baseOffset = -1;
+            switch (type)
+            {
+                case CommitType:
+                case TreeType:
+                case BlobType:
+                case TagType:
+                    break;
+
+                case OfsDeltaType:
+                    if (index == this.headerLength)
+                    {
+                        return;
+                    }
+
+                    // Big-endian groups of 7 bits, with 1 added to each group but the last so that
+                    // there is only one encoding of each distance
+                    b = this.headerBuffer[index++];
+                    long distance = b & 0x7F;
+                    while ((b & 0x80) != 0)
+                    {
+                        if (index == this.headerLength)
+                        {
+                            return;
+                        }
+
+                        if (distance > (long.MaxValue >> 8))
+                        {
+                            this.Fail("Delta base distance is too large");
+                            return;
+                        }
+
+                        b = this.headerBuffer[index++];
+                        distance = ((distance + 1) << 7) | (long)(b & 0x7F);
+                    }
+
+                    baseOffset = this.entryOffset - distance;
+                    if (distance == 0 || baseOffset < PackHeaderSize)
+                    {
+                        this.Fail($"Delta base distance {distance} is out of range");
+                        return;
+                    }
+
+                    break;
+
+                case RefDeltaType:
+                    if (this.headerLength - index < HashLength)
+                    {
+                        return;
+                    }
+
+                    this.refDeltaBases.Add(new KeyValuePair<int, Sha1Id>(
+                        this.entriesParsed,
+                        ToSha1Id(this.headerBuffer.AsSpan(index, HashLength))));
+                    index += HashLength;
+                    break;
+
+                default:
+                    this.Fail($"Invalid object type {type}");
+                    return;
+            }
+
+            this.entries[this.entriesParsed] = new PackEntry
+            {
+                Offset = this.entryOffset,
+                Size = size,
+                BaseOffset = baseOffset,
+                Type = type,
+                HeaderLength = (byte)index,
+            };
+
+            if (type == OfsDeltaType || type == RefDeltaType)
+            {
+                ++this.deltaCount;
+            }
+            else
+            {
+                byte[] objectHeader = GetObjectHeader(type, size);
+                this.objectHash.AppendData(objectHeader);
+            }
+
+            this.headerLength = 0;
+            this.inflatedLength = 0;
+            this.inflater.Reset();
+            this.state = ParseState.EntryData;
+        }
+
+        private int InflateEntryData(byte[] buffer, int offset, int count)
+        {
+            PackEntry entry = this.entries[this.entriesParsed];
+            bool isDelta = entry.Type == OfsDeltaType || entry.Type == RefDeltaType;
+
+            this.inflater.SetInput(buffer, offset, count);
+            while (true)
+            {
+                int inflated = this.inflater.Inflate(this.inflateBuffer);
+                if (inflated > 0)
+                {
+                    this.inflatedLength += inflated;
+                    if (this.inflatedLength > entry.Size)
+                    {
+                        this.Fail($"Entry inflates to more than the {entry.Size} bytes in its header");
+                        return count;
+                    }
+
+                    if (!isDelta)
+                    {
+                        this.objectHash.AppendData(this.inflateBuffer, 0, inflated);
+                    }
+                }
+                else if (this.inflater.IsFinished || this.inflater.IsNeedingInput)
+                {
+                    break;
+                }
+                else
+                {
+                    this.Fail("Entry data is not a valid zlib stream");
+                    return count;
+                }
+            }
+
+            int consumed = count - this.inflater.RemainingInput;
+            this.Hash(buffer, offset, consumed);
+
+            if (this.inflater.IsFinished)
+            {
+                if (this.inflatedLength != entry.Size)
+                {
+                    this.Fail($"Entry inflates to {this.inflatedLength} bytes but its header says {entry.Size}");
+                    return consumed;
+                }
+
+                this.entries[this.entriesParsed].Crc = (uint)this.entryCrc.Value;
+                if (!isDelta)
+                {
+                    this.objectHash.TryGetHashAndReset(this.oids.AsSpan(this.entriesParsed * HashLength, HashLength), out int _);
+                }
+
+                ++this.entriesParsed;
+                this.StartNextEntry();
+            }
+
+            return consumed;
+        }
+
+        private void StartNextEntry()
+        {
+            this.entryCrc.Reset();
+            if (this.entriesParsed == this.entries.Length)
+            {
+                this.state = ParseState.Trailer;
+            }
+            else
+            {
+                this.state = ParseState.EntryHeader;
+            }
+        }
+
+        private int ReadTrailer(byte[] buffer, int offset, int count)
+        {
+            if (this.packChecksum == null)
+            {
+                this.trailerOffset = this.position;
+                this.packChecksum = this.packHash.GetHashAndReset();
+            }
+
+            int consumed = Math.Min(count, HashLength - this.headerLength);
+            Buffer.BlockCopy(buffer, offset, this.headerBuffer, this.headerLength, consumed);
+            this.headerLength += consumed;
+
+            if (this.headerLength == HashLength)
+            {
+                if (!this.headerBuffer.AsSpan(0, HashLength).SequenceEqual(this.packChecksum))
+                {
+                    this.Fail("Pack checksum does not match its contents");
+                    return consumed;
+                }
+
+                this.state = ParseState.Complete;
+            }
+
+            return consumed;
+        }
+
+        private void ResolveDeltas()
+        {
+            if (this.deltaCount == 0)
+            {
+                return;
+            }
+
+            int count = this.entries.Length;
+            this.firstOfsChild = new int[count];
+            this.nextOfsSibling = new int[count];
+            Array.Fill(this.firstOfsChild, -1);
+
+            for (int i = 0; i < count; ++i)
+            {
+                if (this.entries[i].Type == OfsDeltaType)
+                {
+                    int baseIndex = this.FindEntryAtOffset(this.entries[i].BaseOffset, i);
+                    if (baseIndex < 0)
+                    {
+                        throw new InvalidDataException($"Delta at offset {this.entries[i].Offset} has no entry at its base offset {this.entries[i].BaseOffset}");
+                    }
+
+                    this.nextOfsSibling[i] = this.firstOfsChild[baseIndex];
+                    this.firstOfsChild[baseIndex] = i;
+                }
+            }
+
+            this.refChildren = new ConcurrentDictionary<Sha1Id, List<int>>();
+            foreach (KeyValuePair<int, Sha1Id> refDelta in this.refDeltaBases)
+            {
+                this.refChildren.GetOrAdd(refDelta.Value, _ => new List<int>()).Add(refDelta.Key);
+            }
+
+            List<int> roots = new List<int>();
+            for (int i = 0; i < count; ++i)
+            {
+                byte type = this.entries[i].Type;
+                if (type != OfsDeltaType && type != RefDeltaType && this.HasChildren(i))
+                {
+                    roots.Add(i);
+                }
+            }
+
+            using (SafeFileHandle packHandle = File.OpenHandle(this.packPath, FileMode.Open, FileAccess.Read, FileShare.ReadWrite | FileShare.Delete))
+            {
+                // Each chain of deltas is resolved depth first on one thread, so only the chain
+                // currently being resolved has to be kept in memory
+                Parallel.ForEach(
+                    roots,
+                    new ParallelOptions { MaxDegreeOfParallelism = Environment.ProcessorCount },
+                    () => new DeltaResolver(packHandle),
+                    (root, loopState, resolver) =>
+                    {
+                        byte[] data = this.ReadEntryContent(resolver, root);
+                        this.ResolveChildren(resolver, root, this.entries[root].Type, data);
+                        return resolver;
+                    },
+                    resolver => resolver.Dispose());
+            }
+
+            if (this.resolvedDeltaCount != this.deltaCount)
+            {
+                throw new InvalidDataException($"{this.deltaCount - this.resolvedDeltaCount} of {this.deltaCount} deltas have bases that are not in the pack");
+            }
+        }
+
+        private int FindEntryAtOffset(long offset, int upperBound)
+        {
+            int low = 0;
+            int high = upperBound - 1;
+            while (low <= high)
+            {
+                int middle = low + ((high - low) / 2);
+                long middleOffset = this.entries[middle].Offset;
+                if (middleOffset == offset)
+                {
+                    return middle;
+                }
+                else if (middleOffset < offset)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle - 1;
+                }
+            }
+
+            return -1;
+        }
+
+        private bool HasChildren(int index)
+        {
+            return this.firstOfsChild[index] >= 0 || this.refChildren.ContainsKey(ToSha1Id(this.oids.AsSpan(index * HashLength, HashLength)));
+        }
+
+        private void ResolveChildren(DeltaResolver resolver, int baseIndex, byte type, byte[] baseData)
+        {
+            for (int child = this.firstOfsChild[baseIndex]; child >= 0; child = this.nextOfsSibling[child])
+            {
+                this.ResolveDelta(resolver, child, type, baseData);
+            }
+
+            // The first thread to resolve an object takes its REF_DELTA children, so that they are only
+            // resolved once even when the same object appears more than once in the pack
+            if (this.refChildren.TryRemove(ToSha1Id(this.oids.AsSpan(baseIndex * HashLength, HashLength)), out List<int> refDeltas))
+            {
+                foreach (int child in refDeltas)
+                {
+                    this.ResolveDelta(resolver, child, type, baseData);
+                }
+            }
+        }
+
+        private void ResolveDelta(DeltaResolver resolver, int index, byte type, byte[] baseData)
+        {
+            byte[] data = ApplyDelta(baseData, this.ReadEntryContent(resolver, index));
+
+            IncrementalHash hash = resolver.ObjectHash;
+            hash.AppendData(GetObjectHeader(type, data.Length));
+            hash.AppendData(data);
+            hash.TryGetHashAndReset(this.oids.AsSpan(index * HashLength, HashLength), out int _);
+            Interlocked.Increment(ref this.resolvedDeltaCount);
+
+            this.ResolveChildren(resolver, index, type, data);
+        }
+
+        /// <summary>
+        /// Reads and inflates the data of an entry from the pack file, for a delta this is the delta itself
+        /// </summary>
+        private byte[] ReadEntryContent(DeltaResolver resolver, int index)
+        {
+            PackEntry entry = this.entries[index];
+            if (entry.Size > Array.MaxLength)
+            {
+                throw new InvalidDataException($"Entry at offset {entry.Offset} is too large to resolve: {entry.Size} bytes");
+            }
+
+            long readOffset = entry.Offset + entry.HeaderLength;
+            long endOffset = index + 1 < this.entries.Length ? this.entries[index + 1].Offset : this.trailerOffset;
+
+            byte[] data = new byte[entry.Size];
+            int dataLength = 0;
+            Inflater entryInflater = resolver.Inflater;
+            entryInflater.Reset();
+            while (!entryInflater.IsFinished)
+            {
+                if (entryInflater.IsNeedingInput)
+                {
+                    int toRead = (int)Math.Min(resolver.Buffer.Length, endOffset - readOffset);
+                    int read = toRead > 0 ? RandomAccess.Read(resolver.PackHandle, resolver.Buffer.AsSpan(0, toRead), readOffset) : 0;
+                    if (read == 0)
+                    {
+                        throw new InvalidDataException($"Entry at offset {entry.Offset} is truncated");
+                    }
+
+                    readOffset += read;
+                    entryInflater.SetInput(resolver.Buffer, 0, read);
+                }
+
+                int inflated = entryInflater.Inflate(data, dataLength, data.Length - dataLength);
+                dataLength += inflated;
+                if (inflated == 0 && !entryInflater.IsNeedingInput && !entryInflater.IsFinished)
+                {
+                    throw new InvalidDataException($"Entry at offset {entry.Offset} inflates to more than {entry.Size} bytes");
+                }
+            }
+
+            if (dataLength != data.Length)
+            {
+                throw new InvalidDataException($"Entry at offset {entry.Offset} inflates to {dataLength} bytes but its header says {entry.Size}");
+            }
+
+            return data;
+        }
+
+        private void WriteIndex(string idxPath)
+        {
+            int count = this.entries.Length;
+            int[] sorted = new int[count];
+            for (int i = 0; i < count; ++i)
+            {
+                sorted[i] = i;
+            }
+
+            Array.Sort(
+                sorted,
+                (left, right) => this.oids.AsSpan(left * HashLength, HashLength).SequenceCompareTo(this.oids.AsSpan(right * HashLength, HashLength)));
+
+            using (IndexFileWriter writer = new IndexFileWriter(idxPath))
+            {
+                writer.WriteUInt32(IdxV2Magic);
+                writer.WriteUInt32(2);
+
+                int[] fanout = new int[FanoutEntries];
+                foreach (int index in sorted)
+                {
+                    ++fanout[this.oids[index * HashLength]];
+                }
+
+                uint cumulative = 0;
+                for (int i = 0; i < FanoutEntries; ++i)
+                {
+                    cumulative += (uint)fanout[i];
+                    writer.WriteUInt32(cumulative);
+                }
+
+                foreach (int index in sorted)
+                {
+                    writer.WriteBytes(this.oids.AsSpan(index * HashLength, HashLength));
+                }
+
+                foreach (int index in sorted)
+                {
+                    writer.WriteUInt32(this.entries[index].Crc);
+                }
+
+                List<long> largeOffsets = new List<long>();
+                foreach (int index in sorted)
+                {
+                    long offset = this.entries[index].Offset;
+                    if (offset > MaxSmallOffset)
+                    {
+                        writer.WriteUInt32(LargeOffsetFlag | (uint)largeOffsets.Count);
+                        largeOffsets.Add(offset);
+                    }
+                    else
+                    {
+                        writer.WriteUInt32((uint)offset);
+                    }
+                }
+
+                foreach (long offset in largeOffsets)
+                {
+                    writer.WriteUInt64((ulong)offset);
+                }
+
+                writer.WriteBytes(this.packChecksum);
+                writer.WriteChecksum();
+            }
+        }
+
+        private struct PackEntry
+        {
+            public long Offset;
+            public long Size;
+            public long BaseOffset;
+            public uint Crc;
+            public byte Type;
+            public byte HeaderLength;
+        }
+
+        /// <summary>
+        /// Per-thread state for resolving deltas from the completed pack file
+        /// </summary>
+        private sealed class DeltaResolver : IDisposable
+        {
+            public DeltaResolver(SafeFileHandle packHandle)
+            {
+                this.PackHandle = packHandle;
+                this.Inflater = new Inflater();
+                this.ObjectHash = IncrementalHash.CreateHash(HashAlgorithmName.SHA1); // CodeQL [SM02196] SHA-1 is acceptable here because this is Git's hashing algorithm, not used for cryptographic purposes
+                this.Buffer = ArrayPool<byte>.Shared.Rent(InflateBufferSize);
+            }
+
+            public SafeFileHandle PackHandle { get; }
+
+            public Inflater Inflater { get; }
+
+            public IncrementalHash ObjectHash { get; }
+
+            public byte[] Buffer { get; }
+
+            public void Dispose()
+            {
+                this.ObjectHash.Dispose();
+                ArrayPool<byte>.Shared.Return(this.Buffer);
+            }
+        }
+
+        /// <summary>
+        /// Writes the index file, keeping a running SHA-1 of its contents for the trailing checksum
+        /// </summary>
+        private sealed class IndexFileWriter : IDisposable
+        {
+            private readonly FileStream file;
+            private readonly IncrementalHash hash;
+            private readonly byte[] scratch;
+
+            public IndexFileWriter(string path)
+            {
+                this.file = new FileStream(path, FileMode.Create, FileAccess.Write, FileShare.None, InflateBufferSize);
+                this.hash = IncrementalHash.CreateHash(HashAlgorithmName.SHA1); // CodeQL [SM02196] SHA-1 is acceptable here because this is Git's hashing algorithm, not used for cryptographic purposes
+                this.scratch = new byte[sizeof(ulong)];
+            }
+
+            public void WriteBytes(ReadOnlySpan<byte> bytes)
+            {
+                this.file.Write(bytes);
+                this.hash.AppendData(bytes);
+            }
+
+            public void WriteUInt32(uint value)
+            {
+                BinaryPrimitives.WriteUInt32BigEndian(this.scratch, value);
+                this.WriteBytes(this.scratch.AsSpan(0, sizeof(uint)));
+            }
+
+            public void WriteUInt64(ulong value)
+            {
+                BinaryPrimitives.WriteUInt64BigEndian(this.scratch, value);
+                this.WriteBytes(this.scratch);
+            }
+
+            public void WriteChecksum()
+            {
+                this.file.Write(this.hash.GetHashAndReset());
+            }
+
+            public void Dispose()
+            {
+                this.hash.Dispose();
+                this.file.Dispose();
+            }
+        }
+    }
+}
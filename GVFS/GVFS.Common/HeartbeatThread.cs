@@ -1,5 +1,6 @@
 ﻿using GVFS.Common.Tracing;
 using System;
+using System.Collections.Generic;
 using System.Threading;
 
 namespace GVFS.Common
@@ -9,16 +10,16 @@ public class HeartbeatThread
         private static readonly TimeSpan HeartBeatWaitTime = TimeSpan.FromMinutes(60);
 
         private readonly ITracer tracer;
-        private readonly IHeartBeatMetadataProvider dataProvider;
+        private readonly IHeartBeatMetadataProvider[] dataProviders;
 
         private Timer timer;
         private DateTime startTime;
         private DateTime lastHeartBeatTime;
 
-        public HeartbeatThread(ITracer tracer, IHeartBeatMetadataProvider dataProvider)
+        public HeartbeatThread(ITracer tracer, params IHeartBeatMetadataProvider[] dataProviders)
         {
             this.tracer = tracer;
-            this.dataProvider = dataProvider;
+            this.dataProviders = dataProviders;
         }
 
         public void Start()
@@ -50,7 +51,26 @@ private void EmitHeartbeat(object unusedState)
         {
             try
             {
-                EventMetadata metadata = this.dataProvider.GetAndResetHeartBeatMetadata(out bool writeToLogFile) ?? new EventMetadata();
+                EventMetadata metadata = new EventMetadata();
+                bool writeToLogFile = false;
+                foreach (IHeartBeatMetadataProvider dataProvider in this.dataProviders)
+                {
+                    if (dataProvider == null)
+                    {
+                        continue;
+                    }
+
+                    EventMetadata providerMetadata = dataProvider.GetAndResetHeartBeatMetadata(out bool providerWriteToLogFile);
+                    if (providerMetadata != null)
+                    {
+                        writeToLogFile |= providerWriteToLogFile;
+                        foreach (KeyValuePair<string, object> entry in providerMetadata)
+                        {
+                            metadata[entry.Key] = entry.Value;
+                        }
+                    }
+                }
+
                 EventLevel eventLevel = writeToLogFile ? EventLevel.Informational : EventLevel.Verbose;
                 DateTime now = DateTime.Now;
                 metadata.Add("Version", ProcessHelper.GetCurrentProcessVersion());
@@ -18,6 +18,9 @@ public class GitObjectsHttpRequestor : HttpRequestor
 
         private Enlistment enlistment;
 
+        // Null unless gvfs.hedged-downloads is set and there is a cache server other than the origin to hedge
+        private RequestHedger hedger;
+
         private DateTime nextCacheServerAttemptTime = DateTime.Now;
 
         public GitObjectsHttpRequestor(ITracer tracer, Enlistment enlistment, CacheServerInfo cacheServer, RetryConfig retryConfig)
@@ -25,6 +28,14 @@ public GitObjectsHttpRequestor(ITracer tracer, Enlistment enlistment, CacheServe
         {
             this.enlistment = enlistment;
             this.CacheServer = cacheServer;
+
+            if (HedgedDownloadsEnabled &&
+                cacheServer?.ObjectsEndpointUrl != null &&
+                enlistment.RepoUrl != null &&
+                !cacheServer.IsNone(enlistment.RepoUrl))
+            {
+                this.hedger = new RequestHedger(tracer);
+            }
         }
 
         public CacheServerInfo CacheServer { get; private set; }
@@ -144,16 +155,22 @@ public virtual GitRefs QueryInfoRefs(string branch)
             metadata.Add("requestSource", requestSource);
             this.Tracer.RelatedEvent(EventLevel.Informational, "DownloadLooseObject", metadata, Keywords.Network);
 
+            Uri endPoint = new Uri(this.CacheServer.ObjectsEndpointUrl + "/" + objectId);
+            Uri hedgeEndPoint = this.hedger != null
+                ? new Uri(this.enlistment.RepoUrl + GVFSConstants.Endpoints.GVFSObjects + "/" + objectId)
+                : null;
+
             return this.TrySendProtocolRequest(
                 requestId,
                 onSuccess,
                 eArgs => this.HandleDownloadAndSaveObjectError(retryOnFailure, requestId, eArgs),
                 HttpMethod.Get,
-                new Uri(this.CacheServer.ObjectsEndpointUrl + "/" + objectId),
+                () => endPoint,
+                requestBodyGenerator: () => null,
                 cancellationToken,
-                requestBody: null,
                 acceptType: null,
-                retryOnFailure: retryOnFailure);
+                retryOnFailure: retryOnFailure,
+                hedgeEndPoint: hedgeEndPoint);
         }
 
         public virtual RetryWrapper<GitObjectTaskResult>.InvocationResult TryDownloadObjects(
@@ -265,7 +282,8 @@ public virtual GitRefs QueryInfoRefs(string branch)
             Func<string> requestBodyGenerator,
             CancellationToken cancellationToken,
             MediaTypeWithQualityHeaderValue acceptType = null,
-            bool retryOnFailure = true)
+            bool retryOnFailure = true,
+            Uri hedgeEndPoint = null)
         {
             RetryWrapper<GitObjectTaskResult> retrier = new RetryWrapper<GitObjectTaskResult>(
                 retryOnFailure ? this.RetryConfig.MaxAttempts : 1,
@@ -278,13 +296,16 @@ public virtual GitRefs QueryInfoRefs(string branch)
             return retrier.Invoke(
                 tryCount =>
                 {
-                    using (GitEndPointResponseData response = this.SendRequest(
-                        requestId,
-                        endPointGenerator(),
-                        method,
-                        requestBodyGenerator(),
-                        cancellationToken,
-                        acceptType))
+                    Uri endPoint = endPointGenerator();
+                    string requestBody = requestBodyGenerator();
+                    using (GitEndPointResponseData response = hedgeEndPoint != null && this.hedger != null
+                        ? this.hedger.Send(
+                            requestId,
+                            token => this.SendRequest(requestId, endPoint, method, requestBody, token, acceptType),
+                            token => this.SendRequest(requestId, hedgeEndPoint, method, requestBody, token, acceptType),
+                            canHedge: () => HasAvailableConnection,
+                            cancellationToken)
+                        : this.SendRequest(requestId, endPoint, method, requestBody, cancellationToken, acceptType))
                     {
                         if (response.HasErrors)
                         {
@@ -19,9 +19,14 @@ public abstract class HttpRequestor : IDisposable
         private const int ConnectionPoolWaitTimeoutMs = 30_000;
         private const int ConnectionPoolContentionThresholdMs = 100;
 
+        // With HTTP/2 the limit is on concurrent streams, which are much cheaper than connections
+        private const int Http2StreamsPerProcessor = 8;
+
         private static long requestCount = 0;
         private static SemaphoreSlim availableConnections;
         private static int connectionLimitConfigured = 0;
+        private static volatile bool useHttp2 = false;
+        private static volatile bool hedgedDownloads = false;
 
         private readonly ProductInfoHeaderValue userAgentHeader;
 
@@ -45,10 +50,12 @@ protected HttpRequestor(ITracer tracer, RetryConfig retryConfig, Enlistment enli
 
             this.Tracer = tracer;
 
-            // On first instantiation, check git config for a custom connection limit.
+            // On first instantiation, check git config for HTTP/2 and a custom connection limit.
             // This runs before any requests are made (during mount initialization).
             if (Interlocked.CompareExchange(ref connectionLimitConfigured, 1, 0) == 0)
             {
+                useHttp2 = IsEnabledInConfig(tracer, enlistment, GVFSConstants.GitConfig.Http2, GVFSConstants.GitConfig.Http2Default, "HttpRequestor_Http2Enabled");
+                hedgedDownloads = IsEnabledInConfig(tracer, enlistment, GVFSConstants.GitConfig.HedgedDownloads, GVFSConstants.GitConfig.HedgedDownloadsDefault, "HttpRequestor_HedgedDownloadsEnabled");
                 TryApplyConnectionLimitFromConfig(tracer, enlistment);
             }
 
@@ -61,21 +68,11 @@ protected HttpRequestor(ITracer tracer, RetryConfig retryConfig, Enlistment enli
             // GVFS cache servers and Azure DevOps accept PAT/OAuth tokens via the
             // "Authorization: Basic <base64>" header that SendRequest already attaches.
             // Transport-level credentials are redundant and purely wasteful.
-            SocketsHttpHandler handler = new SocketsHttpHandler()
-            {
-                MaxConnectionsPerServer = Environment.ProcessorCount,
-                PooledConnectionLifetime = Timeout.InfiniteTimeSpan,
-                PooledConnectionIdleTimeout = TimeSpan.FromMinutes(5),
-            };
+            SocketsHttpHandler handler = CreateHandler(useHttp2);
 
             this.authentication.ConfigureSocketsHandlerSslIfNeeded(this.Tracer, handler, enlistment.CreateGitProcess());
 
-            this.client = new HttpClient(handler)
-            {
-                Timeout = retryConfig.Timeout,
-                DefaultRequestVersion = HttpVersion.Version11,
-                DefaultVersionPolicy = HttpVersionPolicy.RequestVersionExact,
-            };
+            this.client = CreateHttpClient(handler, retryConfig.Timeout, useHttp2);
 
             this.userAgentHeader = new ProductInfoHeaderValue(ProcessHelper.GetEntryClassName(), ProcessHelper.GetCurrentProcessVersion());
         }
@@ -84,11 +81,60 @@ protected HttpRequestor(ITracer tracer, RetryConfig retryConfig, Enlistment enli
 
         protected ITracer Tracer { get; }
 
+        /// <summary>
+        /// True when gvfs.hedged-downloads is set, see <see cref="RequestHedger"/>.
+        /// </summary>
+        protected static bool HedgedDownloadsEnabled
+        {
+            get { return hedgedDownloads; }
+        }
+
+        /// <summary>
+        /// True when a request can be sent without waiting for another to release its connection.
+        /// </summary>
+        protected static bool HasAvailableConnection
+        {
+            get { return availableConnections.CurrentCount > 0; }
+        }
+
         public static long GetNewRequestId()
         {
             return Interlocked.Increment(ref requestCount);
         }
 
+        /// <summary>
+        /// Creates the handler for requests to the cache server or origin, see <see cref="CreateHttpClient"/>.
+        /// </summary>
+        public static SocketsHttpHandler CreateHandler(bool useHttp2)
+        {
+            return new SocketsHttpHandler()
+            {
+                MaxConnectionsPerServer = Environment.ProcessorCount,
+                PooledConnectionLifetime = Timeout.InfiniteTimeSpan,
+                PooledConnectionIdleTimeout = TimeSpan.FromMinutes(5),
+
+                // Open another HTTP/2 connection once the server's concurrent stream limit is reached
+                // on the existing ones, rather than queueing requests for a stream
+                EnableMultipleHttp2Connections = useHttp2,
+            };
+        }
+
+        /// <summary>
+        /// Creates a client that sends every request as HTTP/1.1 or, when <paramref name="useHttp2"/>
+        /// is true, that requests HTTP/2 and falls back to HTTP/1.1 when the server does not
+        /// negotiate it.  HTTP/2 is only negotiated over https, a request to an http URL uses
+        /// HTTP/1.1.
+        /// </summary>
+        public static HttpClient CreateHttpClient(HttpMessageHandler handler, TimeSpan timeout, bool useHttp2)
+        {
+            return new HttpClient(handler)
+            {
+                Timeout = timeout,
+                DefaultRequestVersion = useHttp2 ? HttpVersion.Version20 : HttpVersion.Version11,
+                DefaultVersionPolicy = useHttp2 ? HttpVersionPolicy.RequestVersionOrLower : HttpVersionPolicy.RequestVersionExact,
+            };
+        }
+
         public void Dispose()
         {
             if (this.client != null)
@@ -199,6 +245,7 @@ public void Dispose()
 
                 responseMetadata.Add("CacheName", GetSingleHeaderOrEmpty(response.Headers, "X-Cache-Name"));
                 responseMetadata.Add("StatusCode", response.StatusCode);
+                responseMetadata.Add("HttpVersion", response.Version.ToString());
 
                 if (response.StatusCode == HttpStatusCode.OK)
                 {
@@ -432,54 +479,103 @@ private static bool TryGetResponseMessageFromHttpRequestException(HttpRequestExc
 
         }
 
-        private static void TryApplyConnectionLimitFromConfig(ITracer tracer, Enlistment enlistment)
+        private static bool IsEnabledInConfig(ITracer tracer, Enlistment enlistment, string configName, bool defaultValue, string enabledEventName)
         {
             try
             {
-                GitProcess.ConfigResult result = enlistment.CreateGitProcess().GetFromConfig(GVFSConstants.GitConfig.MaxHttpConnectionsConfig);
-                string error;
-                int configuredLimit;
-                if (!result.TryParseAsInt(0, 1, out configuredLimit, out error))
+                GitProcess.ConfigResult result = enlistment.CreateGitProcess().GetFromConfig(configName);
+                bool enabled = defaultValue;
+                if (!result.TryParseAsString(out string rawValue, out string error) ||
+                    (!string.IsNullOrWhiteSpace(rawValue) && !bool.TryParse(rawValue.Trim(), out enabled)))
                 {
                     EventMetadata metadata = new EventMetadata();
                     metadata.Add("error", error);
-                    tracer.RelatedWarning(metadata, "HttpRequestor: Invalid gvfs.max-http-connections config value, using default");
-                    return;
+                    metadata.Add("value", rawValue);
+                    tracer.RelatedWarning(metadata, $"HttpRequestor: Invalid {configName} config value, using default");
+                    return defaultValue;
                 }
 
-                if (configuredLimit > 0)
+                if (enabled)
                 {
-                    int currentLimit = availableConnections.CurrentCount;
+                    tracer.RelatedEvent(EventLevel.Informational, enabledEventName, metadata: null);
+                }
 
-                    // Adjust the existing semaphore rather than replacing it, so any
-                    // in-flight waiters release permits to the correct instance.
-                    int delta = configuredLimit - currentLimit;
-                    if (delta > 0)
-                    {
-                        for (int i = 0; i < delta; i++)
-                        {
-                            availableConnections.Release();
-                        }
-                    }
-                    else if (delta < 0)
-                    {
-                        for (int i = 0; i < -delta; i++)
-                        {
-                            availableConnections.Wait();
-                        }
-                    }
+                return enabled;
+            }
+            catch (Exception e)
+            {
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("Exception", e.ToString());
+                tracer.RelatedWarning(metadata, $"HttpRequestor: Failed to read {configName} config, using default");
+                return defaultValue;
+            }
+        }
+
+        /// <summary>
+        /// Reads the limit on requests in flight: gvfs.max-http2-streams (8 per processor by default) when
+        /// <paramref name="useHttp2"/> is true, and gvfs.max-http-connections otherwise.
+        /// </summary>
+        /// <returns>The configured limit, or 0 to keep the default HTTP/1.1 connection limit</returns>
+        internal static int GetRequestLimitFromConfig(ITracer tracer, GitProcess gitProcess, bool useHttp2)
+        {
+            // With HTTP/2 the limit is on requests in flight (streams), not connections
+            string limitConfig = useHttp2 ? GVFSConstants.GitConfig.MaxHttp2StreamsConfig : GVFSConstants.GitConfig.MaxHttpConnectionsConfig;
+            int defaultLimit = useHttp2 ? Http2StreamsPerProcessor * Environment.ProcessorCount : 0;
 
+            try
+            {
+                GitProcess.ConfigResult result = gitProcess.GetFromConfig(limitConfig);
+                string error;
+                int configuredLimit;
+                if (!result.TryParseAsInt(defaultLimit, 1, out configuredLimit, out error))
+                {
                     EventMetadata metadata = new EventMetadata();
-                    metadata.Add("configuredLimit", configuredLimit);
-                    metadata.Add("previousLimit", currentLimit);
-                    tracer.RelatedEvent(EventLevel.Informational, "HttpRequestor_ConnectionLimitConfigured", metadata);
+                    metadata.Add("error", error);
+                    tracer.RelatedWarning(metadata, $"HttpRequestor: Invalid {limitConfig} config value, using default");
+                    return defaultLimit;
                 }
+
+                return configuredLimit;
             }
             catch (Exception e)
             {
                 EventMetadata metadata = new EventMetadata();
                 metadata.Add("Exception", e.ToString());
-                tracer.RelatedWarning(metadata, "HttpRequestor: Failed to read gvfs.max-http-connections config, using default");
+                tracer.RelatedWarning(metadata, $"HttpRequestor: Failed to read {limitConfig} config, using default");
+                return defaultLimit;
+            }
+        }
+
+        private static void TryApplyConnectionLimitFromConfig(ITracer tracer, Enlistment enlistment)
+        {
+            int configuredLimit = GetRequestLimitFromConfig(tracer, enlistment.CreateGitProcess(), useHttp2);
+            if (configuredLimit > 0)
+            {
+                int currentLimit = availableConnections.CurrentCount;
+
+                // Adjust the existing semaphore rather than replacing it, so any
+                // in-flight waiters release permits to the correct instance.
+                int delta = configuredLimit - currentLimit;
+                if (delta > 0)
+                {
+                    for (int i = 0; i < delta; i++)
+                    {
+                        availableConnections.Release();
+                    }
+                }
+                else if (delta < 0)
+                {
+                    for (int i = 0; i < -delta; i++)
+                    {
+                        availableConnections.Wait();
+                    }
+                }
+
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("configuredLimit", configuredLimit);
+                metadata.Add("previousLimit", currentLimit);
+                metadata.Add("config", useHttp2 ? GVFSConstants.GitConfig.MaxHttp2StreamsConfig : GVFSConstants.GitConfig.MaxHttpConnectionsConfig);
+                tracer.RelatedEvent(EventLevel.Informational, "HttpRequestor_ConnectionLimitConfigured", metadata);
             }
         }
     }
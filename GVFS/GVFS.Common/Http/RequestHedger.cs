@@ -0,0 +1,286 @@
+﻿using GVFS.Common.Tracing;
+using System;
+using System.Diagnostics;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.Common.Http
+{
+    /// <summary>
+    /// Sends a duplicate ("hedged") request to an alternate server when a request has not produced response
+    /// headers within the latency that most requests see, and uses whichever response succeeds first.  An
+    /// occasional slow response from the cache server then costs about that latency plus the alternate's,
+    /// rather than the full wait (or the retry policy's timeout).
+    ///
+    /// The hedge delay is the <see cref="LatencyPercentile"/> of recent header latencies of the primary
+    /// server, so it follows the server rather than being configured.  Until <see cref="MinLatencySamples"/>
+    /// requests have completed no request is hedged.  Duplicated load is capped with a budget that every
+    /// request adds <see cref="MaxHedgedFraction"/> to and every hedge takes 1 from, so at most that fraction
+    /// of requests (after a small burst) is ever sent twice, and no hedge is sent when the caller reports that
+    /// no connection is free.
+    ///
+    /// The primary request is sent on the caller's thread, and the hedge is started by a timer, so a request
+    /// only uses a second thread once it has actually been hedged.  When the hedge succeeds first the primary
+    /// is cancelled, which returns control to the caller.
+    /// </summary>
+    public class RequestHedger
+    {
+        public const double LatencyPercentile = 0.95;
+        public const double MaxHedgedFraction = 0.05;
+        public const int MinLatencySamples = 32;
+
+        private const int LatencySampleCount = 512;
+        private const int SamplesPerDelayUpdate = 32;
+        private const double MaxHedgeBudget = 10;
+
+        private static readonly TimeSpan MinHedgeDelay = TimeSpan.FromMilliseconds(10);
+
+        private readonly object stateLock = new object();
+        private readonly ITracer tracer;
+        private readonly long[] latencySampleTicks = new long[LatencySampleCount];
+
+        private int sampleCount;
+        private int nextSample;
+        private int samplesSinceDelayUpdate;
+        private TimeSpan hedgeDelay = Timeout.InfiniteTimeSpan;
+        private double hedgeBudget;
+
+        private long hedgeCount;
+        private long hedgeWinCount;
+
+        public RequestHedger(ITracer tracer)
+        {
+            this.tracer = tracer;
+        }
+
+        /// <summary>
+        /// How long a request waits for the primary server before it is hedged, or
+        /// <see cref="Timeout.InfiniteTimeSpan"/> while there are too few samples to tell.
+        /// </summary>
+        public TimeSpan HedgeDelay
+        {
+            get
+            {
+                lock (this.stateLock)
+                {
+                    return this.hedgeDelay;
+                }
+            }
+        }
+
+        public long HedgeCount
+        {
+            get { return Interlocked.Read(ref this.hedgeCount); }
+        }
+
+        public long HedgeWinCount
+        {
+            get { return Interlocked.Read(ref this.hedgeWinCount); }
+        }
+
+        /// <summary>
+        /// Sends a request with <paramref name="sendPrimary"/> and, if it has not returned within
+        /// <see cref="HedgeDelay"/>, the same request with <paramref name="sendHedge"/>.
+        /// </summary>
+        /// <param name="canHedge">Checked before hedging, return false when a hedge would only wait for resources.</param>
+        /// <returns>
+        /// The first successful response, or the primary's response (or exception) when neither succeeded.  The
+        /// other request is cancelled, and its response is disposed when it completes.
+        /// </returns>
+        /// <remarks>
+        /// <paramref name="sendPrimary"/> must return (or throw) promptly when its token is cancelled, that is
+        /// how the caller gets the hedge's response.  <paramref name="canHedge"/> is called on a timer thread.
+        /// </remarks>
+        public GitEndPointResponseData Send(
+            long requestId,
+            Func<CancellationToken, GitEndPointResponseData> sendPrimary,
+            Func<CancellationToken, GitEndPointResponseData> sendHedge,
+            Func<bool> canHedge,
+            CancellationToken cancellationToken)
+        {
+            TimeSpan delay;
+            lock (this.stateLock)
+            {
+                this.hedgeBudget = Math.Min(MaxHedgeBudget, this.hedgeBudget + MaxHedgedFraction);
+                delay = this.hedgeBudget >= 1 ? this.hedgeDelay : Timeout.InfiniteTimeSpan;
+            }
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            if (delay == Timeout.InfiniteTimeSpan)
+            {
+                GitEndPointResponseData response = sendPrimary(cancellationToken);
+                this.RecordLatency(stopwatch.Elapsed);
+                return response;
+            }
+
+            object hedgeLock = new object();
+            bool primaryReturned = false;
+            bool hedgeWon = false;
+            Task<GitEndPointResponseData> hedge = null;
+            CancellationTokenSource hedgeCancellation = null;
+
+            Task<GitEndPointResponseData> primary;
+            using (CancellationTokenSource primaryCancellation = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken))
+            {
+                TimerCallback startHedge = state =>
+                {
+                    Task<GitEndPointResponseData> startedHedge;
+                    lock (hedgeLock)
+                    {
+                        if (primaryReturned ||
+                            cancellationToken.IsCancellationRequested ||
+                            !canHedge() ||
+                            !this.TryTakeHedgeBudget())
+                        {
+                            return;
+                        }
+
+                        Interlocked.Increment(ref this.hedgeCount);
+                        hedgeCancellation = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken);
+                        CancellationToken hedgeToken = hedgeCancellation.Token;
+                        startedHedge = hedge = Task.Run(() => sendHedge(hedgeToken));
+                    }
+
+                    startedHedge.ContinueWith(
+                        completed =>
+                        {
+                            lock (hedgeLock)
+                            {
+                                // Stop waiting for the primary, the caller then returns the hedge's response
+                                if (!primaryReturned && Succeeded(completed))
+                                {
+                                    hedgeWon = true;
+                                    primaryCancellation.Cancel();
+                                }
+                            }
+                        },
+                        TaskContinuationOptions.ExecuteSynchronously);
+                };
+
+                using (Timer hedgeTimer = new Timer(startHedge, null, delay, Timeout.InfiniteTimeSpan))
+                {
+                    try
+                    {
+                        primary = Task.FromResult(sendPrimary(primaryCancellation.Token));
+                    }
+                    catch (Exception e)
+                    {
+                        primary = Task.FromException<GitEndPointResponseData>(e);
+                    }
+
+                    lock (hedgeLock)
+                    {
+                        primaryReturned = true;
+                    }
+                }
+            }
+
+            // A primary that lost to the hedge took at least this long, which keeps a slow server's
+            // latency in the samples
+            TimeSpan elapsed = stopwatch.Elapsed;
+            this.RecordLatency(elapsed);
+
+            if (hedge == null)
+            {
+                return primary.GetAwaiter().GetResult();
+            }
+
+            if (!hedgeWon && !Succeeded(primary))
+            {
+                WaitWithoutThrowing(hedge);
+                hedgeWon = Succeeded(hedge);
+            }
+
+            if (hedgeWon)
+            {
+                Interlocked.Increment(ref this.hedgeWinCount);
+                hedgeCancellation.Dispose();
+                if (primary.Status == TaskStatus.RanToCompletion)
+                {
+                    primary.Result?.Dispose();
+                }
+            }
+            else
+            {
+                hedgeCancellation.Cancel();
+                DisposeWhenComplete(hedge, hedgeCancellation);
+            }
+
+            EventMetadata metadata = new EventMetadata();
+            metadata.Add("RequestId", requestId);
+            metadata.Add("HedgeDelayMs", (long)delay.TotalMilliseconds);
+            metadata.Add("ElapsedMs", (long)elapsed.TotalMilliseconds);
+            metadata.Add("HedgeWon", hedgeWon);
+            this.tracer.RelatedEvent(EventLevel.Informational, "HedgedRequest", metadata, Keywords.Network);
+
+            return (hedgeWon ? hedge : primary).GetAwaiter().GetResult();
+        }
+
+        private static bool Succeeded(Task<GitEndPointResponseData> request)
+        {
+            return request.Status == TaskStatus.RanToCompletion &&
+                request.Result != null &&
+                !request.Result.HasErrors;
+        }
+
+        private static void WaitWithoutThrowing(Task request)
+        {
+            request.ContinueWith(_ => { }, TaskContinuationOptions.ExecuteSynchronously).Wait();
+        }
+
+        private static void DisposeWhenComplete(Task<GitEndPointResponseData> request, CancellationTokenSource cancellation)
+        {
+            request.ContinueWith(
+                completed =>
+                {
+                    if (completed.Status == TaskStatus.RanToCompletion)
+                    {
+                        completed.Result?.Dispose();
+                    }
+
+                    cancellation.Dispose();
+                },
+                TaskContinuationOptions.ExecuteSynchronously);
+        }
+
+        private bool TryTakeHedgeBudget()
+        {
+            lock (this.stateLock)
+            {
+                if (this.hedgeBudget < 1)
+                {
+                    return false;
+                }
+
+                this.hedgeBudget -= 1;
+                return true;
+            }
+        }
+
+        private void RecordLatency(TimeSpan latency)
+        {
+            lock (this.stateLock)
+            {
+                this.latencySampleTicks[this.nextSample] = latency.Ticks;
+                this.nextSample = (this.nextSample + 1) % LatencySampleCount;
+                this.sampleCount = Math.Min(this.sampleCount + 1, LatencySampleCount);
+                ++this.samplesSinceDelayUpdate;
+
+                // Sorting the samples for every request would cost more than it saves
+                if (this.sampleCount < MinLatencySamples || this.samplesSinceDelayUpdate < SamplesPerDelayUpdate)
+                {
+                    return;
+                }
+
+                this.samplesSinceDelayUpdate = 0;
+                long[] sorted = new long[this.sampleCount];
+                Array.Copy(this.latencySampleTicks, sorted, this.sampleCount);
+                Array.Sort(sorted);
+
+                int index = (int)Math.Ceiling(LatencyPercentile * sorted.Length) - 1;
+                TimeSpan percentile = TimeSpan.FromTicks(sorted[Math.Max(0, index)]);
+                this.hedgeDelay = percentile > MinHedgeDelay ? percentile : MinHedgeDelay;
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace GVFS.Common.Http
+{
+    /// <summary>
+    /// Tracks which of the objects requested from gvfs/objects have been written to disk.  When an
+    /// application/x-gvfs-loose-objects response breaks partway through, the retry then only requests the
+    /// objects that were not persisted, much as prefetch packs resume from the timestamp of the last pack
+    /// received, rather than downloading the whole batch again.
+    /// </summary>
+    /// <remarks>
+    /// Objects are marked persisted from the loose object deserializer's workers, so this class is thread-safe.
+    /// </remarks>
+    public class ResumableObjectDownload
+    {
+        private readonly List<string> objectIds;
+        private readonly HashSet<string> remainingObjectIds;
+
+        public ResumableObjectDownload(IEnumerable<string> objectIds)
+        {
+            this.objectIds = objectIds.Distinct(StringComparer.OrdinalIgnoreCase).ToList();
+            this.remainingObjectIds = new HashSet<string>(this.objectIds, StringComparer.OrdinalIgnoreCase);
+        }
+
+        public int ObjectCount
+        {
+            get { return this.objectIds.Count; }
+        }
+
+        public int PersistedCount
+        {
+            get
+            {
+                lock (this.remainingObjectIds)
+                {
+                    return this.objectIds.Count - this.remainingObjectIds.Count;
+                }
+            }
+        }
+
+        /// <summary>
+        /// True once every requested object has been persisted.  A response that fails after this point (while
+        /// reading its terminator, for example) does not need to be retried.
+        /// </summary>
+        public bool IsComplete
+        {
+            get { return this.PersistedCount == this.objectIds.Count; }
+        }
+
+        /// <summary>
+        /// Marks an object as written to disk, call only once the object is complete (renamed into place).
+        /// Objects that were not requested are ignored.
+        /// </summary>
+        public void MarkPersisted(string objectId)
+        {
+            lock (this.remainingObjectIds)
+            {
+                this.remainingObjectIds.Remove(objectId);
+            }
+        }
+
+        /// <summary>
+        /// Returns the objects that have not been persisted yet, in the order they were requested.
+        /// </summary>
+        public List<string> GetRemainingObjectIds()
+        {
+            lock (this.remainingObjectIds)
+            {
+                return this.objectIds.Where(objectId => this.remainingObjectIds.Contains(objectId)).ToList();
+            }
+        }
+    }
+}
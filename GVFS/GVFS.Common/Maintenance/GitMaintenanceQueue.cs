@@ -8,14 +8,19 @@ namespace GVFS.Common.Maintenance
 {
     public class GitMaintenanceQueue
     {
+        // A step cannot be paused once it has started, so it waits longer than a download batch does
+        private static readonly TimeSpan MaxWaitForInteractiveWork = TimeSpan.FromSeconds(30);
+
         private readonly Lock queueLock = new Lock();
+        private readonly BackgroundWorkThrottle backgroundWorkThrottle;
         private GVFSContext context;
         private BlockingCollection<GitMaintenanceStep> queue = new BlockingCollection<GitMaintenanceStep>();
         private GitMaintenanceStep currentStep;
 
-        public GitMaintenanceQueue(GVFSContext context)
+        public GitMaintenanceQueue(GVFSContext context, BackgroundWorkThrottle backgroundWorkThrottle = null)
         {
             this.context = context;
+            this.backgroundWorkThrottle = backgroundWorkThrottle;
             Thread worker = new Thread(() => this.RunQueue());
             worker.Name = "MaintenanceWorker";
             worker.IsBackground = true;
@@ -81,6 +86,8 @@ private void RunQueue()
                     }
                 }
 
+                this.backgroundWorkThrottle?.WaitForInteractiveWork(MaxWaitForInteractiveWork);
+
                 if (this.EnlistmentRootReady())
                 {
                     try
@@ -20,12 +20,12 @@ public class GitMaintenanceScheduler : IDisposable
         private GitObjects gitObjects;
         private GitMaintenanceQueue queue;
 
-        public GitMaintenanceScheduler(GVFSContext context, GitObjects gitObjects)
+        public GitMaintenanceScheduler(GVFSContext context, GitObjects gitObjects, BackgroundWorkThrottle backgroundWorkThrottle = null)
         {
             this.context = context;
             this.gitObjects = gitObjects;
             this.stepTimers = new List<Timer>();
-            this.queue = new GitMaintenanceQueue(context);
+            this.queue = new GitMaintenanceQueue(context, backgroundWorkThrottle);
 
             this.ScheduleRecurringSteps();
         }
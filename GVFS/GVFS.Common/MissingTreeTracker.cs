@@ -10,11 +10,24 @@ namespace GVFS.Common
     /// Tracks missing trees per commit to support batching tree downloads.
     /// Maintains LRU eviction based on commits (not individual trees).
     /// A single tree SHA may be shared across multiple commits.
+    ///
+    /// Also tracks the order in which each commit's trees are requested, so that once the
+    /// requests look like a walk of the whole commit (such as the depth-first walk done by
+    /// checkout) the sibling trees that are about to be requested can be downloaded with the
+    /// tree that was requested, instead of one round trip per tree.
     /// </summary>
     public class MissingTreeTracker
     {
         private const string EtwArea = nameof(MissingTreeTracker);
 
+        // A walk of a single path (e.g. git log -- path) only ever requests one child of each tree.
+        // Once this many trees have been requested that are siblings of a tree requested earlier,
+        // the walk is visiting whole trees and their other subtrees will be needed as well.
+        private const int SiblingRequestsToDetectWalk = 2;
+
+        private const int MinPredictedTreeBatchSize = 8;
+        private const int MaxPredictedTreeBatchSize = 128;
+
         private readonly int treeCapacity;
         private readonly ITracer tracer;
         private readonly Lock syncLock = new Lock();
@@ -29,6 +42,13 @@ public class MissingTreeTracker
         private readonly LinkedList<string> commitOrder;
         private readonly Dictionary<string, LinkedListNode<string>> commitNodes;
 
+        // Tree structure learned from AddMissingSubTrees, used to find the siblings of a requested tree
+        private readonly Dictionary<string, string> parentByTree;
+        private readonly Dictionary<string, string[]> subTreesByParent;
+
+        // How each commit's trees have been requested, removed with the commit
+        private readonly Dictionary<string, TreeWalk> walkByCommit;
+
         public MissingTreeTracker(ITracer tracer, int treeCapacity)
         {
             this.tracer = tracer;
@@ -37,6 +57,9 @@ public MissingTreeTracker(ITracer tracer, int treeCapacity)
             this.commitsByTree = new Dictionary<string, HashSet<string>>(StringComparer.OrdinalIgnoreCase);
             this.commitOrder = new LinkedList<string>();
             this.commitNodes = new Dictionary<string, LinkedListNode<string>>(StringComparer.OrdinalIgnoreCase);
+            this.parentByTree = new Dictionary<string, string>(StringComparer.OrdinalIgnoreCase);
+            this.subTreesByParent = new Dictionary<string, string[]>(StringComparer.OrdinalIgnoreCase);
+            this.walkByCommit = new Dictionary<string, TreeWalk>(StringComparer.OrdinalIgnoreCase);
         }
 
         /// <summary>
@@ -80,7 +103,86 @@ public void AddMissingSubTrees(string parentTreeSha, string[] subTreeShas)
                         this.MarkCommitAsUsed(commitSha); 
                         this.AddTreeToCommit(subTreeSha, commitSha);
                     }
+
+                    if (this.commitsByTree.ContainsKey(subTreeSha))
+                    {
+                        this.parentByTree.TryAdd(subTreeSha, parentTreeSha);
+                    }
+                }
+
+                if (this.commitsByTree.ContainsKey(parentTreeSha))
+                {
+                    this.subTreesByParent[parentTreeSha] = subTreeShas;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Records that a tracked tree is being downloaded and, if the commit's trees are being
+        /// walked, returns the sibling trees that the walk is expected to request next, in the
+        /// order they appear in their parent tree.  The caller should download the predicted
+        /// trees together with the requested one, and then report their missing sub-trees with
+        /// <see cref="AddMissingSubTrees"/> so that the next level of the walk can be predicted.
+        /// </summary>
+        public bool TryGetPredictedTrees(string treeSha, out string[] predictedTreeShas)
+        {
+            predictedTreeShas = null;
+            lock (this.syncLock)
+            {
+                if (!this.commitsByTree.TryGetValue(treeSha, out var commits))
+                {
+                    return false;
+                }
+
+                this.parentByTree.TryGetValue(treeSha, out string parentTreeSha);
+                TreeWalk predictingWalk = null;
+                foreach (string commitSha in commits)
+                {
+                    if (!this.walkByCommit.TryGetValue(commitSha, out TreeWalk walk))
+                    {
+                        walk = new TreeWalk();
+                        this.walkByCommit.Add(commitSha, walk);
+                    }
+
+                    walk.RecordRequest(treeSha, parentTreeSha);
+                    if (predictingWalk == null && walk.IsWalkDetected)
+                    {
+                        predictingWalk = walk;
+                    }
+                }
+
+                if (predictingWalk == null
+                    || parentTreeSha == null
+                    || !this.subTreesByParent.TryGetValue(parentTreeSha, out string[] siblings))
+                {
+                    return false;
+                }
+
+                // Siblings after the requested tree are the ones a walk in tree order has not reached yet.
+                // The requested tree is not among them if its parent's sub-trees were recorded again since.
+                int requestedIndex = Array.FindIndex(siblings, sha => StringComparer.OrdinalIgnoreCase.Equals(sha, treeSha));
+                if (requestedIndex < 0)
+                {
+                    return false;
+                }
+
+                List<string> predicted = new List<string>();
+                for (int i = requestedIndex + 1; i < siblings.Length && predicted.Count < predictingWalk.BatchSize; ++i)
+                {
+                    string siblingSha = siblings[i];
+                    if (predictingWalk.TryPredict(siblingSha))
+                    {
+                        predicted.Add(siblingSha);
+                    }
+                }
+
+                if (predicted.Count == 0)
+                {
+                    return false;
                 }
+
+                predictedTreeShas = predicted.ToArray();
+                return true;
             }
         }
 
@@ -147,6 +249,11 @@ public void MarkCommitComplete(string commitSha)
                 EventMetadata metadata = new EventMetadata();
                 metadata.Add("Area", EtwArea);
                 metadata.Add("CompletedCommit", commitSha);
+                if (this.walkByCommit.TryGetValue(commitSha, out TreeWalk walk))
+                {
+                    walk.AddToMetadata(metadata);
+                }
+
                 metadata.Add("RemainingCommits", this.commitNodes.Count);
                 metadata.Add("RemainingTrees", this.commitsByTree.Count);
                 this.tracer.RelatedEvent(EventLevel.Informational, nameof(this.MarkCommitComplete), metadata, Keywords.Telemetry);
@@ -245,7 +352,7 @@ private void RemoveCommitNoCache(string commitSha)
                     commits.Remove(commitSha);
                     if (commits.Count == 0)
                     {
-                        this.commitsByTree.Remove(treeSha);
+                        this.RemoveTree(treeSha);
                     }
                 }
             }
@@ -289,7 +396,7 @@ private void RemoveCommitWithCascade(string commitSha)
                     }
 
                     sharingCommits.Clear();
-                    this.commitsByTree.Remove(treeSha);
+                    this.RemoveTree(treeSha);
                 }
             }
 
@@ -307,6 +414,13 @@ private void RemoveCommitWithCascade(string commitSha)
             }
         }
 
+        private void RemoveTree(string treeSha)
+        {
+            this.commitsByTree.Remove(treeSha);
+            this.parentByTree.Remove(treeSha);
+            this.subTreesByParent.Remove(treeSha);
+        }
+
         private void RemoveFromLruOrder(string commitSha)
         {
             if (this.commitNodes.TryGetValue(commitSha, out var node))
@@ -314,6 +428,80 @@ private void RemoveFromLruOrder(string commitSha)
                 this.commitOrder.Remove(node);
                 this.commitNodes.Remove(commitSha);
             }
+
+            this.walkByCommit.Remove(commitSha);
+        }
+
+        /// <summary>
+        /// The tree requests seen for one commit.  The number of trees predicted per request
+        /// grows while the walk keeps requesting trees that were not predicted (misses), and
+        /// shrinks when a predicted tree is requested anyway because its download did not help.
+        /// A tree that is requested again says nothing about the predictions, and is not counted
+        /// as either.
+        /// </summary>
+        private class TreeWalk
+        {
+            private readonly HashSet<string> parentsWithRequestedChildren = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+            private readonly HashSet<string> requestedTrees = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+            private readonly HashSet<string> predictedTrees = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+
+            private int requestCount;
+            private int siblingRequestCount;
+            private int missCount;
+            private int predictedCount;
+            private int predictedRequestCount;
+
+            public int BatchSize { get; private set; } = MinPredictedTreeBatchSize;
+
+            public bool IsWalkDetected => this.siblingRequestCount >= SiblingRequestsToDetectWalk;
+
+            public void RecordRequest(string treeSha, string parentTreeSha)
+            {
+                this.requestCount++;
+                if (!this.requestedTrees.Add(treeSha))
+                {
+                    return;
+                }
+
+                // The first subtree requested in a tree cannot be predicted, as the tree's subtrees are
+                // only known once it has been downloaded.  A request for one of its siblings could have been.
+                bool isSiblingRequest = parentTreeSha != null && !this.parentsWithRequestedChildren.Add(parentTreeSha);
+                if (this.predictedTrees.Contains(treeSha))
+                {
+                    this.predictedRequestCount++;
+                    this.BatchSize = Math.Max(MinPredictedTreeBatchSize, this.BatchSize / 2);
+                }
+                else if (isSiblingRequest && this.IsWalkDetected)
+                {
+                    this.missCount++;
+                    this.BatchSize = Math.Min(MaxPredictedTreeBatchSize, this.BatchSize * 2);
+                }
+
+                if (isSiblingRequest)
+                {
+                    this.siblingRequestCount++;
+                }
+            }
+
+            public bool TryPredict(string treeSha)
+            {
+                // A requested tree is being downloaded, and so it should not be predicted
+                if (!this.requestedTrees.Contains(treeSha) && this.predictedTrees.Add(treeSha))
+                {
+                    this.predictedCount++;
+                    return true;
+                }
+
+                return false;
+            }
+
+            public void AddToMetadata(EventMetadata metadata)
+            {
+                metadata.Add("TreeRequests", this.requestCount);
+                metadata.Add("TreeRequestMisses", this.missCount);
+                metadata.Add("PredictedTreesRequested", this.predictedRequestCount);
+                metadata.Add("PredictedTrees", this.predictedCount);
+            }
         }
     }
 }
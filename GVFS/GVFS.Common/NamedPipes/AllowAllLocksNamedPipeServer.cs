@@ -1,4 +1,5 @@
 ﻿using GVFS.Common.Tracing;
+using System;
 
 namespace GVFS.Common.NamedPipes
 {
@@ -6,7 +7,41 @@ public class AllowAllLocksNamedPipeServer
     {
         public static NamedPipeServer Create(ITracer tracer, GVFSEnlistment enlistment)
         {
-            return NamedPipeServer.StartNewServer(enlistment.NamedPipeName, tracer, AllowAllLocksNamedPipeServer.HandleRequest);
+            return NamedPipeServer.StartNewServer(
+                enlistment.NamedPipeName,
+                tracer,
+                AllowAllLocksNamedPipeServer.HandleRequest,
+                handleBinaryRequest: AllowAllLocksNamedPipeServer.HandleBinaryRequest);
+        }
+
+        private static void HandleBinaryRequest(ITracer tracer, ReadOnlyMemory<byte> request, NamedPipeServer.Connection connection)
+        {
+            BinaryMessageReader reader = new BinaryMessageReader(request.Span);
+            NamedPipeMessages.Binary.MessageType type = NamedPipeMessages.Binary.ReadHeader(ref reader, out byte _);
+
+            switch (type)
+            {
+                case NamedPipeMessages.Binary.MessageType.AcquireLockRequest:
+                    connection.TrySendBinaryResponse(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.AcceptResult));
+                    break;
+
+                case NamedPipeMessages.Binary.MessageType.ReleaseLockRequest:
+                    connection.TrySendBinaryResponse(new NamedPipeMessages.ReleaseLock.Response(NamedPipeMessages.ReleaseLock.SuccessResult));
+                    break;
+
+                default:
+                    connection.TrySendResponse(NamedPipeMessages.UnknownRequest);
+
+                    if (tracer != null)
+                    {
+                        EventMetadata metadata = new EventMetadata();
+                        metadata.Add("Area", "AllowAllLocksNamedPipeServer");
+                        metadata.Add("MessageType", type.ToString());
+                        tracer.RelatedWarning(metadata, "HandleBinaryRequest: Unknown request", Keywords.Telemetry);
+                    }
+
+                    break;
+            }
         }
 
         private static void HandleRequest(ITracer tracer, string request, NamedPipeServer.Connection connection)
@@ -0,0 +1,136 @@
+﻿using System;
+using System.IO;
+using System.Text;
+
+namespace GVFS.Common.NamedPipes
+{
+    /// <summary>
+    /// Reads the values written by <see cref="BinaryMessageWriter"/> from a binary named pipe message,
+    /// without copying the message.
+    /// </summary>
+    /// <remarks>
+    /// A message that ends before a value is complete throws an <see cref="InvalidDataException"/>.  Bytes
+    /// left after the values that a reader knows about are ignored, which is how fields added in later
+    /// versions of the schema are skipped by older readers.
+    /// </remarks>
+    public ref struct BinaryMessageReader
+    {
+        private ReadOnlySpan<byte> remaining;
+
+        public BinaryMessageReader(ReadOnlySpan<byte> message)
+        {
+            this.remaining = message;
+        }
+
+        public bool IsAtEnd
+        {
+            get { return this.remaining.IsEmpty; }
+        }
+
+        public byte ReadByte()
+        {
+            if (this.remaining.IsEmpty)
+            {
+                throw new InvalidDataException("Binary message ended before the expected byte");
+            }
+
+            byte value = this.remaining[0];
+            this.remaining = this.remaining.Slice(1);
+            return value;
+        }
+
+        public bool ReadBoolean()
+        {
+            return this.ReadByte() != 0;
+        }
+
+        public uint ReadVarUInt32()
+        {
+            uint value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                byte b = this.ReadByte();
+                value |= (uint)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+
+            throw new InvalidDataException("Binary message contains an integer that is longer than 5 bytes");
+        }
+
+        public int ReadVarInt32()
+        {
+            uint zigzag = this.ReadVarUInt32();
+            return (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+        }
+
+        public string ReadString()
+        {
+            ReadOnlySpan<byte> bytes;
+            if (!this.TryReadStringBytes(out bytes))
+            {
+                return null;
+            }
+
+            return bytes.IsEmpty ? string.Empty : Encoding.UTF8.GetString(bytes);
+        }
+
+        /// <summary>
+        /// Reads a string that is usually one of <paramref name="knownValues"/>, returning the matching
+        /// instance from <paramref name="knownValues"/> rather than allocating a new string.
+        /// </summary>
+        public string ReadString(string[] knownValues)
+        {
+            ReadOnlySpan<byte> bytes;
+            if (!this.TryReadStringBytes(out bytes))
+            {
+                return null;
+            }
+
+            foreach (string knownValue in knownValues)
+            {
+                if (knownValue.Length == bytes.Length && IsAsciiMatch(knownValue, bytes))
+                {
+                    return knownValue;
+                }
+            }
+
+            return Encoding.UTF8.GetString(bytes);
+        }
+
+        private static bool IsAsciiMatch(string value, ReadOnlySpan<byte> bytes)
+        {
+            for (int i = 0; i < bytes.Length; ++i)
+            {
+                if (value[i] != bytes[i])
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        private bool TryReadStringBytes(out ReadOnlySpan<byte> bytes)
+        {
+            uint lengthPlusOne = this.ReadVarUInt32();
+            if (lengthPlusOne == 0)
+            {
+                bytes = default(ReadOnlySpan<byte>);
+                return false;
+            }
+
+            uint length = lengthPlusOne - 1;
+            if (length > (uint)this.remaining.Length)
+            {
+                throw new InvalidDataException($"Binary message contains a string of {length} bytes but only {this.remaining.Length} bytes remain");
+            }
+
+            bytes = this.remaining.Slice(0, (int)length);
+            this.remaining = this.remaining.Slice((int)length);
+            return true;
+        }
+    }
+}
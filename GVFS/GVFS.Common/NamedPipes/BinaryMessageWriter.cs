@@ -0,0 +1,132 @@
+﻿using System;
+using System.Buffers;
+using System.Buffers.Binary;
+using System.Text;
+
+namespace GVFS.Common.NamedPipes
+{
+    /// <summary>
+    /// Writes a binary named pipe message into a buffer rented from <see cref="ArrayPool{T}.Shared"/>.
+    /// A writer is reused for every message sent on a connection (see <see cref="Reset"/>), so writing
+    /// a message does not allocate once the buffer is large enough.
+    /// </summary>
+    /// <remarks>
+    /// A binary message is sent as a frame: <see cref="FrameMarker"/>, the length of the message as a
+    /// 32-bit little-endian integer, and then the message.  Text messages never start with
+    /// <see cref="FrameMarker"/>, which is how <see cref="NamedPipeStreamReader"/> tells the two apart.
+    /// </remarks>
+    public sealed class BinaryMessageWriter : IDisposable
+    {
+        public const byte FrameMarker = 0x2;
+        public const int FrameHeaderLength = 1 + sizeof(int);
+
+        private const int InitialBufferSize = 256;
+
+        private byte[] buffer;
+        private int position;
+
+        public BinaryMessageWriter()
+        {
+            this.buffer = ArrayPool<byte>.Shared.Rent(InitialBufferSize);
+            this.Reset();
+        }
+
+        /// <summary>
+        /// The number of message bytes written since the last <see cref="Reset"/>.
+        /// </summary>
+        public int Length
+        {
+            get { return this.position - FrameHeaderLength; }
+        }
+
+        public void Reset()
+        {
+            this.position = FrameHeaderLength;
+        }
+
+        public void WriteByte(byte value)
+        {
+            this.EnsureCapacity(1);
+            this.buffer[this.position++] = value;
+        }
+
+        public void WriteBoolean(bool value)
+        {
+            this.WriteByte(value ? (byte)1 : (byte)0);
+        }
+
+        /// <summary>
+        /// Writes <paramref name="value"/> seven bits at a time, least significant first, with the high bit
+        /// of each byte set when more bytes follow.
+        /// </summary>
+        public void WriteVarUInt32(uint value)
+        {
+            this.EnsureCapacity(5);
+            while (value >= 0x80)
+            {
+                this.buffer[this.position++] = (byte)(value | 0x80);
+                value >>= 7;
+            }
+
+            this.buffer[this.position++] = (byte)value;
+        }
+
+        /// <summary>
+        /// Writes <paramref name="value"/> zigzag encoded, so that small negative values are as short as
+        /// small positive ones.
+        /// </summary>
+        public void WriteVarInt32(int value)
+        {
+            this.WriteVarUInt32((uint)((value << 1) ^ (value >> 31)));
+        }
+
+        /// <summary>
+        /// Writes the UTF-8 length of <paramref name="value"/> plus one (zero for null), followed by the UTF-8
+        /// bytes of <paramref name="value"/>.
+        /// </summary>
+        public void WriteString(string value)
+        {
+            if (value == null)
+            {
+                this.WriteVarUInt32(0);
+                return;
+            }
+
+            int byteCount = Encoding.UTF8.GetByteCount(value);
+            this.WriteVarUInt32((uint)byteCount + 1);
+            this.EnsureCapacity(byteCount);
+            this.position += Encoding.UTF8.GetBytes(value, 0, value.Length, this.buffer, this.position);
+        }
+
+        /// <summary>
+        /// Returns the frame to write to the pipe for the message written since the last <see cref="Reset"/>.
+        /// The frame is only valid until the writer is next used.
+        /// </summary>
+        public ReadOnlySpan<byte> GetFrame()
+        {
+            this.buffer[0] = FrameMarker;
+            BinaryPrimitives.WriteInt32LittleEndian(new Span<byte>(this.buffer, 1, sizeof(int)), this.Length);
+            return new ReadOnlySpan<byte>(this.buffer, 0, this.position);
+        }
+
+        public void Dispose()
+        {
+            if (this.buffer != null)
+            {
+                ArrayPool<byte>.Shared.Return(this.buffer);
+                this.buffer = null;
+            }
+        }
+
+        private void EnsureCapacity(int count)
+        {
+            if (this.position + count > this.buffer.Length)
+            {
+                byte[] newBuffer = ArrayPool<byte>.Shared.Rent(Math.Max(this.buffer.Length * 2, this.position + count));
+                Buffer.BlockCopy(this.buffer, 0, newBuffer, 0, this.position);
+                ArrayPool<byte>.Shared.Return(this.buffer);
+                this.buffer = newBuffer;
+            }
+        }
+    }
+}
@@ -0,0 +1,156 @@
+﻿using System.IO;
+
+namespace GVFS.Common.NamedPipes
+{
+    public static partial class NamedPipeMessages
+    {
+        /// <summary>
+        /// Binary encoding of the messages sent for every git command (the lock requests of the pre- and
+        /// post-command hooks, and the status requests), which avoids building and splitting delimited
+        /// strings or JSON on both ends of the pipe.
+        /// </summary>
+        /// <remarks>
+        /// Every message starts with the schema version of its writer and a <see cref="MessageType"/>,
+        /// followed by the message's fields.  Integers are variable length (see
+        /// <see cref="BinaryMessageWriter.WriteVarUInt32"/>) and strings are length prefixed UTF-8 that can
+        /// be null.  Results are written as strings, and readers return the matching result constant
+        /// rather than allocating a new string.
+        ///
+        /// New fields are only ever added at the end of a message, and a reader ignores any bytes after the
+        /// fields it knows about.  A reader must check the version in the header before reading a field
+        /// that was added after version 1.  A change that cannot be made by appending fields needs a new
+        /// <see cref="MessageType"/>.
+        /// </remarks>
+        public static class Binary
+        {
+            public const byte SchemaVersion = 1;
+
+            private static readonly string[] KnownResults = new string[]
+            {
+                AcquireLock.AcceptResult,
+                AcquireLock.AvailableResult,
+                AcquireLock.DenyGitResult,
+                AcquireLock.DenyGVFSResult,
+                AcquireLock.MountNotReadyResult,
+                AcquireLock.UnmountInProgressResult,
+                ReleaseLock.SuccessResult,
+                ReleaseLock.FailureResult,
+                HydrationStatus.SuccessResult,
+                HydrationStatus.NotAvailableResult,
+                UnknownRequest,
+            };
+
+            public enum MessageType : byte
+            {
+                Invalid = 0,
+                AcquireLockRequest = 1,
+                AcquireLockResponse = 2,
+                ReleaseLockRequest = 3,
+                ReleaseLockResponse = 4,
+                GetStatusRequest = 5,
+                GetStatusResponse = 6,
+                HydrationStatusRequest = 7,
+                HydrationStatusResponse = 8,
+            }
+
+            public static void WriteHeader(BinaryMessageWriter writer, MessageType type)
+            {
+                writer.WriteByte(SchemaVersion);
+                writer.WriteByte((byte)type);
+            }
+
+            public static MessageType ReadHeader(ref BinaryMessageReader reader, out byte version)
+            {
+                version = reader.ReadByte();
+                if (version == 0)
+                {
+                    throw new InvalidDataException("Binary message has an invalid schema version");
+                }
+
+                return (MessageType)reader.ReadByte();
+            }
+
+            /// <summary>
+            /// Reads the header of a message that must be of type <paramref name="expectedType"/>.
+            /// </summary>
+            public static byte ReadHeader(ref BinaryMessageReader reader, MessageType expectedType)
+            {
+                MessageType type = ReadHeader(ref reader, out byte version);
+                if (type != expectedType)
+                {
+                    throw new InvalidDataException($"Expected a binary {expectedType} message, got: {type}");
+                }
+
+                return version;
+            }
+
+            public static void WriteResult(BinaryMessageWriter writer, string result)
+            {
+                writer.WriteString(result);
+            }
+
+            public static string ReadResult(ref BinaryMessageReader reader)
+            {
+                return reader.ReadString(KnownResults);
+            }
+
+            /// <summary>
+            /// A message that has no fields other than its header and an optional result.
+            /// </summary>
+            public class ResultMessage : IBinaryNamedPipeMessage
+            {
+                public static readonly ResultMessage GetStatusRequest = new ResultMessage(MessageType.GetStatusRequest, result: null);
+                public static readonly ResultMessage HydrationStatusRequest = new ResultMessage(MessageType.HydrationStatusRequest, result: null);
+
+                public ResultMessage(MessageType type, string result)
+                {
+                    this.Type = type;
+                    this.Result = result;
+                }
+
+                public MessageType Type { get; }
+
+                public string Result { get; }
+
+                public void WriteBinary(BinaryMessageWriter writer)
+                {
+                    WriteHeader(writer, this.Type);
+                    if (this.Result != null)
+                    {
+                        WriteResult(writer, this.Result);
+                    }
+                }
+            }
+
+            /// <summary>
+            /// An AcquireLock or ReleaseLock request.
+            /// </summary>
+            public class LockRequestMessage : IBinaryNamedPipeMessage
+            {
+                public LockRequestMessage(MessageType type, LockData requestData)
+                {
+                    this.Type = type;
+                    this.RequestData = requestData;
+                }
+
+                public MessageType Type { get; }
+
+                public LockData RequestData { get; }
+
+                /// <summary>
+                /// Reads the fields of a lock request, after its header has been read.
+                /// </summary>
+                public static LockData ReadRequestData(ref BinaryMessageReader reader)
+                {
+                    return LockData.ReadBinary(ref reader);
+                }
+
+                public void WriteBinary(BinaryMessageWriter writer)
+                {
+                    WriteHeader(writer, this.Type);
+                    this.RequestData.WriteBinary(writer);
+                }
+            }
+        }
+    }
+}
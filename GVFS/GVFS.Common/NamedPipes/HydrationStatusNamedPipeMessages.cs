@@ -13,7 +13,7 @@ public static class HydrationStatus
             /// <summary>
             /// Wire format: PlaceholderFileCount,PlaceholderFolderCount,ModifiedFileCount,ModifiedFolderCount,TotalFileCount,TotalFolderCount
             /// </summary>
-            public class Response
+            public class Response : IBinaryNamedPipeMessage
             {
                 public int PlaceholderFileCount { get; set; }
                 public int PlaceholderFolderCount { get; set; }
@@ -56,6 +56,47 @@ public string ToBody()
                         this.TotalFolderCount);
                 }
 
+                /// <summary>
+                /// Reads a binary HydrationStatus response, which only has counts when its result is
+                /// <see cref="SuccessResult"/>.
+                /// </summary>
+                public static bool TryReadBinary(ReadOnlySpan<byte> message, out string result, out Response response)
+                {
+                    response = null;
+                    BinaryMessageReader reader = new BinaryMessageReader(message);
+                    Binary.ReadHeader(ref reader, Binary.MessageType.HydrationStatusResponse);
+
+                    result = Binary.ReadResult(ref reader);
+                    if (result != SuccessResult)
+                    {
+                        return false;
+                    }
+
+                    response = new Response
+                    {
+                        PlaceholderFileCount = reader.ReadVarInt32(),
+                        PlaceholderFolderCount = reader.ReadVarInt32(),
+                        ModifiedFileCount = reader.ReadVarInt32(),
+                        ModifiedFolderCount = reader.ReadVarInt32(),
+                        TotalFileCount = reader.ReadVarInt32(),
+                        TotalFolderCount = reader.ReadVarInt32(),
+                    };
+
+                    return response.IsValid;
+                }
+
+                public void WriteBinary(BinaryMessageWriter writer)
+                {
+                    Binary.WriteHeader(writer, Binary.MessageType.HydrationStatusResponse);
+                    Binary.WriteResult(writer, SuccessResult);
+                    writer.WriteVarInt32(this.PlaceholderFileCount);
+                    writer.WriteVarInt32(this.PlaceholderFolderCount);
+                    writer.WriteVarInt32(this.ModifiedFileCount);
+                    writer.WriteVarInt32(this.ModifiedFolderCount);
+                    writer.WriteVarInt32(this.TotalFileCount);
+                    writer.WriteVarInt32(this.TotalFolderCount);
+                }
+
                 public static bool TryParse(string body, out Response response)
                 {
                     response = null;
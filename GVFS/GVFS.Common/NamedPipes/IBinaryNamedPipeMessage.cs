@@ -0,0 +1,13 @@
+﻿namespace GVFS.Common.NamedPipes
+{
+    /// <summary>
+    /// A message that can be sent with the binary encoding described by <see cref="NamedPipeMessages.Binary"/>.
+    /// </summary>
+    public interface IBinaryNamedPipeMessage
+    {
+        /// <summary>
+        /// Writes the message, starting with its header (<see cref="NamedPipeMessages.Binary.WriteHeader"/>).
+        /// </summary>
+        void WriteBinary(BinaryMessageWriter writer);
+    }
+}
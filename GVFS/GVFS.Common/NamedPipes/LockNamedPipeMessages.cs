@@ -26,7 +26,7 @@ public static class AcquireLock
             public const string MountNotReadyResult = "MountNotReady";
             public const string UnmountInProgressResult = "UnmountInProgress";
 
-            public class Response
+            public class Response : IBinaryNamedPipeMessage
             {
                 public Response(string result, LockData responseData = null, string denyGVFSMessage = null)
                 {
@@ -55,6 +55,17 @@ public Response(Message message)
 
                 public LockData ResponseData { get; }
 
+                public static Response FromBinary(ReadOnlySpan<byte> message)
+                {
+                    BinaryMessageReader reader = new BinaryMessageReader(message);
+                    Binary.ReadHeader(ref reader, Binary.MessageType.AcquireLockResponse);
+
+                    string result = Binary.ReadResult(ref reader);
+                    LockData responseData = reader.ReadBoolean() ? LockData.ReadBinary(ref reader) : null;
+                    string denyGVFSMessage = reader.ReadString();
+                    return new Response(result, responseData, denyGVFSMessage);
+                }
+
                 public Message CreateMessage()
                 {
                     string messageBody = null;
@@ -69,6 +80,15 @@ public Message CreateMessage()
 
                     return new Message(this.Result, messageBody);
                 }
+
+                public void WriteBinary(BinaryMessageWriter writer)
+                {
+                    Binary.WriteHeader(writer, Binary.MessageType.AcquireLockResponse);
+                    Binary.WriteResult(writer, this.Result);
+                    writer.WriteBoolean(this.ResponseData != null);
+                    this.ResponseData?.WriteBinary(writer);
+                    writer.WriteString(this.DenyGVFSMessage);
+                }
             }
         }
 
@@ -78,7 +98,7 @@ public static class ReleaseLock
             public const string SuccessResult = "LockReleased";
             public const string FailureResult = "ReleaseDenied";
 
-            public class Response
+            public class Response : IBinaryNamedPipeMessage
             {
                 public Response(string result, ReleaseLockData responseData = null)
                 {
@@ -96,6 +116,16 @@ public Response(Message message)
 
                 public ReleaseLockData ResponseData { get; }
 
+                public static Response FromBinary(ReadOnlySpan<byte> message)
+                {
+                    BinaryMessageReader reader = new BinaryMessageReader(message);
+                    Binary.ReadHeader(ref reader, Binary.MessageType.ReleaseLockResponse);
+
+                    string result = Binary.ReadResult(ref reader);
+                    ReleaseLockData responseData = reader.ReadBoolean() ? ReleaseLockData.ReadBinary(ref reader) : null;
+                    return new Response(result, responseData);
+                }
+
                 public Message CreateMessage()
                 {
                     string messageBody = null;
@@ -106,6 +136,14 @@ public Message CreateMessage()
 
                     return new Message(this.Result, messageBody);
                 }
+
+                public void WriteBinary(BinaryMessageWriter writer)
+                {
+                    Binary.WriteHeader(writer, Binary.MessageType.ReleaseLockResponse);
+                    Binary.WriteResult(writer, this.Result);
+                    writer.WriteBoolean(this.ResponseData != null);
+                    this.ResponseData?.WriteBinary(writer);
+                }
             }
 
             public class ReleaseLockData
@@ -214,6 +252,23 @@ internal static ReleaseLockData FromBody(string body)
                     return new ReleaseLockData(failedToUpdateCount: 0, failedToDeleteCount: 0, failedToUpdateFileList: null, failedToDeleteFileList: null);
                 }
 
+                internal static ReleaseLockData ReadBinary(ref BinaryMessageReader reader)
+                {
+                    int failedToUpdateCount = reader.ReadVarInt32();
+                    int failedToDeleteCount = reader.ReadVarInt32();
+                    List<string> failedToUpdateFileList = ReadBinaryList(ref reader);
+                    List<string> failedToDeleteFileList = ReadBinaryList(ref reader);
+                    return new ReleaseLockData(failedToUpdateCount, failedToDeleteCount, failedToUpdateFileList, failedToDeleteFileList);
+                }
+
+                internal void WriteBinary(BinaryMessageWriter writer)
+                {
+                    writer.WriteVarInt32(this.FailedToUpdateCount);
+                    writer.WriteVarInt32(this.FailedToDeleteCount);
+                    WriteBinaryList(writer, this.FailedToUpdateFileList);
+                    WriteBinaryList(writer, this.FailedToDeleteFileList);
+                }
+
                 internal string ToMessage()
                 {
                     return
@@ -225,6 +280,36 @@ internal string ToMessage()
                         SectionSeparator +
                         string.Join(MessageSeparator.ToString(), this.FailedToDeleteFileList);
                 }
+
+                // Empty lists are read as null, as they are by FromBody
+                private static List<string> ReadBinaryList(ref BinaryMessageReader reader)
+                {
+                    int count = (int)reader.ReadVarUInt32();
+                    if (count == 0)
+                    {
+                        return null;
+                    }
+
+                    List<string> list = new List<string>(Math.Min(count, MaxReportedFileNames));
+                    for (int i = 0; i < count; ++i)
+                    {
+                        list.Add(reader.ReadString());
+                    }
+
+                    return list;
+                }
+
+                private static void WriteBinaryList(BinaryMessageWriter writer, List<string> list)
+                {
+                    writer.WriteVarUInt32((uint)(list?.Count ?? 0));
+                    if (list != null)
+                    {
+                        foreach (string item in list)
+                        {
+                            writer.WriteString(item);
+                        }
+                    }
+                }
             }
         }
 
@@ -357,6 +442,25 @@ internal static LockData FromBody(string body)
                 return null;
             }
 
+            internal static LockData ReadBinary(ref BinaryMessageReader reader)
+            {
+                int pid = reader.ReadVarInt32();
+                bool isElevated = reader.ReadBoolean();
+                bool checkAvailabilityOnly = reader.ReadBoolean();
+                string parsedCommand = reader.ReadString();
+                string gitCommandSessionId = reader.ReadString();
+                return new LockData(pid, isElevated, checkAvailabilityOnly, parsedCommand, gitCommandSessionId);
+            }
+
+            internal void WriteBinary(BinaryMessageWriter writer)
+            {
+                writer.WriteVarInt32(this.PID);
+                writer.WriteBoolean(this.IsElevated);
+                writer.WriteBoolean(this.CheckAvailabilityOnly);
+                writer.WriteString(this.ParsedCommand);
+                writer.WriteString(this.GitCommandSessionId);
+            }
+
             internal string ToMessage()
             {
                 return string.Join(
@@ -400,6 +504,21 @@ public static Message FromString(string message)
                 return new Message(header, body);
             }
 
+            /// <summary>
+            /// The header of <paramref name="message"/>, for callers that only need to look at the header
+            /// and so do not need to allocate a Message (and the strings in it).
+            /// </summary>
+            public static ReadOnlySpan<char> GetHeader(string message)
+            {
+                if (string.IsNullOrEmpty(message))
+                {
+                    return ReadOnlySpan<char>.Empty;
+                }
+
+                int separatorIndex = message.IndexOf(NamedPipeMessages.MessageSeparator);
+                return separatorIndex < 0 ? message.AsSpan() : message.AsSpan(0, separatorIndex);
+            }
+
             public override string ToString()
             {
                 string result = string.Empty;
@@ -76,6 +76,42 @@ public void SendRequest(string message)
             }
         }
 
+        public void SendBinaryRequest(IBinaryNamedPipeMessage message)
+        {
+            this.ValidateConnection();
+
+            try
+            {
+                this.writer.WriteBinaryMessage(message);
+            }
+            catch (IOException e)
+            {
+                throw new BrokenPipeException("Unable to send binary request: " + message.GetType().Name, e);
+            }
+        }
+
+        /// <summary>
+        /// Reads a response that is either binary or text, the server replies to a binary request it
+        /// does not support with a text response.  A binary response is only valid until the next read.
+        /// </summary>
+        public NamedPipeFrame ReadResponseFrame()
+        {
+            try
+            {
+                NamedPipeFrame response = this.reader.ReadFrame();
+                if (response.IsEndOfStream)
+                {
+                    throw new BrokenPipeException("Unable to read from pipe", null);
+                }
+
+                return response;
+            }
+            catch (IOException e)
+            {
+                throw new BrokenPipeException("Unable to read from pipe", e);
+            }
+        }
+
         public string ReadRawResponse()
         {
             try
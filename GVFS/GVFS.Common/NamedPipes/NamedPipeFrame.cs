@@ -0,0 +1,42 @@
+﻿using System;
+
+namespace GVFS.Common.NamedPipes
+{
+    /// <summary>
+    /// A message read by <see cref="NamedPipeStreamReader"/>, either a text message or a binary message
+    /// (see <see cref="BinaryMessageWriter"/>).
+    /// </summary>
+    public readonly struct NamedPipeFrame
+    {
+        public NamedPipeFrame(string text)
+        {
+            this.Text = text;
+            this.Binary = ReadOnlyMemory<byte>.Empty;
+            this.IsBinary = false;
+        }
+
+        public NamedPipeFrame(ReadOnlyMemory<byte> binary)
+        {
+            this.Text = null;
+            this.Binary = binary;
+            this.IsBinary = true;
+        }
+
+        /// <summary>
+        /// The text message, null for a binary message or when the end of the stream was reached.
+        /// </summary>
+        public string Text { get; }
+
+        /// <summary>
+        /// The binary message.  It refers to the reader's buffer and so is only valid until the next read.
+        /// </summary>
+        public ReadOnlyMemory<byte> Binary { get; }
+
+        public bool IsBinary { get; }
+
+        public bool IsEndOfStream
+        {
+            get { return !this.IsBinary && this.Text == null; }
+        }
+    }
+}
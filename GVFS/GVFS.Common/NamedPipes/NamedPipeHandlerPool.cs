@@ -0,0 +1,345 @@
+﻿using GVFS.Common.Tracing;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.Common.NamedPipes
+{
+    /// <summary>
+    /// A fixed set of threads that run the request handlers of a <see cref="NamedPipeServer"/>.
+    ///
+    /// Handlers are synchronous and some of them block for a long time (downloading an object, for
+    /// example), so they run on dedicated threads rather than on the thread pool.  Requests that
+    /// arrive while every thread is busy wait in a queue rather than each getting a thread of its own.
+    ///
+    /// Queued interactive requests are always taken before queued background requests, and at most
+    /// <see cref="MaxBackgroundHandlerCount"/> threads run background requests at once.
+    /// </summary>
+    internal class NamedPipeHandlerPool : IDisposable
+    {
+        // Enough samples for a stable 99th percentile without the memory growing with the request rate
+        private const int MaxLatencySamples = 1024;
+
+        // An object rather than a Lock, as the handler threads wait on it with Monitor.Wait
+        private readonly object queueLock = new object();
+        private readonly Queue<WorkItem> interactiveQueue;
+        private readonly Queue<WorkItem> backgroundQueue;
+        private readonly Thread[] threads;
+        private readonly LatencyStats[] latencyStats;
+
+        private bool isAddingCompleted;
+        private int busyHandlerCount;
+        private int busyBackgroundHandlerCount;
+
+        // Reset by GetAndResetMetrics
+        private int maxQueueDepth;
+        private long handledCount;
+        private long totalQueueWaitTicks;
+        private long totalHandlerTicks;
+        private long maxHandlerTicks;
+
+        public NamedPipeHandlerPool(int threadCount)
+        {
+            this.interactiveQueue = new Queue<WorkItem>();
+            this.backgroundQueue = new Queue<WorkItem>();
+            this.MaxBackgroundHandlerCount = Math.Max(1, threadCount / 2);
+            this.latencyStats = new LatencyStats[]
+            {
+                new LatencyStats(NamedPipeRequestPriority.Interactive),
+                new LatencyStats(NamedPipeRequestPriority.Background),
+            };
+
+            this.threads = new Thread[threadCount];
+            for (int i = 0; i < threadCount; ++i)
+            {
+                this.threads[i] = new Thread(this.ProcessWorkItems)
+                {
+                    IsBackground = true,
+                    Name = nameof(NamedPipeHandlerPool) + i
+                };
+
+                this.threads[i].Start();
+            }
+        }
+
+        public int ThreadCount
+        {
+            get { return this.threads.Length; }
+        }
+
+        public int MaxBackgroundHandlerCount { get; }
+
+        public int QueueDepth
+        {
+            get
+            {
+                lock (this.queueLock)
+                {
+                    return this.interactiveQueue.Count + this.backgroundQueue.Count;
+                }
+            }
+        }
+
+        public int BusyHandlerCount
+        {
+            get { return Volatile.Read(ref this.busyHandlerCount); }
+        }
+
+        /// <summary>
+        /// Queues <paramref name="handler"/> to run on one of the pool's threads.  The returned task
+        /// completes (on a thread pool thread) when the handler returns, faulted if the handler threw,
+        /// or canceled if the pool was disposed before the handler could run.
+        /// </summary>
+        public Task RunAsync(Action handler, NamedPipeRequestPriority priority)
+        {
+            WorkItem workItem = new WorkItem(handler, priority);
+            lock (this.queueLock)
+            {
+                if (this.isAddingCompleted)
+                {
+                    workItem.Completion.TrySetCanceled();
+                    return workItem.Completion.Task;
+                }
+
+                if (priority == NamedPipeRequestPriority.Background)
+                {
+                    this.backgroundQueue.Enqueue(workItem);
+                }
+                else
+                {
+                    this.interactiveQueue.Enqueue(workItem);
+                }
+
+                this.maxQueueDepth = Math.Max(this.maxQueueDepth, this.interactiveQueue.Count + this.backgroundQueue.Count);
+                Monitor.Pulse(this.queueLock);
+            }
+
+            return workItem.Completion.Task;
+        }
+
+        public EventMetadata GetAndResetMetrics()
+        {
+            long handledCount = Interlocked.Exchange(ref this.handledCount, 0);
+            long totalQueueWaitTicks = Interlocked.Exchange(ref this.totalQueueWaitTicks, 0);
+            long totalHandlerTicks = Interlocked.Exchange(ref this.totalHandlerTicks, 0);
+
+            int maxQueueDepth;
+            lock (this.queueLock)
+            {
+                maxQueueDepth = this.maxQueueDepth;
+                this.maxQueueDepth = 0;
+            }
+
+            EventMetadata metrics = new EventMetadata();
+            metrics.Add("HandlerThreads", this.ThreadCount);
+            metrics.Add("BusyHandlers", this.BusyHandlerCount);
+            metrics.Add("QueueDepth", this.QueueDepth);
+            metrics.Add("MaxQueueDepth", maxQueueDepth);
+            metrics.Add("RequestsHandled", handledCount);
+            metrics.Add("AverageQueueWaitMs", handledCount == 0 ? 0 : TicksToMilliseconds(totalQueueWaitTicks / handledCount));
+            metrics.Add("AverageHandlerMs", handledCount == 0 ? 0 : TicksToMilliseconds(totalHandlerTicks / handledCount));
+            metrics.Add("MaxHandlerMs", TicksToMilliseconds(Interlocked.Exchange(ref this.maxHandlerTicks, 0)));
+
+            foreach (LatencyStats stats in this.latencyStats)
+            {
+                metrics.Add(stats.Priority.ToString(), stats.GetAndReset());
+            }
+
+            return metrics;
+        }
+
+        public void Dispose()
+        {
+            // Handlers that are already queued still run, they check whether the server is stopping
+            lock (this.queueLock)
+            {
+                this.isAddingCompleted = true;
+                Monitor.PulseAll(this.queueLock);
+            }
+        }
+
+        private static long TicksToMilliseconds(long stopwatchTicks)
+        {
+            return stopwatchTicks * 1000 / Stopwatch.Frequency;
+        }
+
+        private bool TryTakeWorkItem(out WorkItem workItem)
+        {
+            lock (this.queueLock)
+            {
+                while (true)
+                {
+                    if (this.interactiveQueue.Count > 0)
+                    {
+                        workItem = this.interactiveQueue.Dequeue();
+                        return true;
+                    }
+
+                    if (this.backgroundQueue.Count > 0 &&
+                        this.busyBackgroundHandlerCount < this.MaxBackgroundHandlerCount)
+                    {
+                        workItem = this.backgroundQueue.Dequeue();
+                        ++this.busyBackgroundHandlerCount;
+                        return true;
+                    }
+
+                    if (this.isAddingCompleted &&
+                        this.interactiveQueue.Count == 0 &&
+                        this.backgroundQueue.Count == 0)
+                    {
+                        workItem = null;
+                        return false;
+                    }
+
+                    Monitor.Wait(this.queueLock);
+                }
+            }
+        }
+
+        private void ProcessWorkItems()
+        {
+            WorkItem workItem;
+            while (this.TryTakeWorkItem(out workItem))
+            {
+                long startTicks = Stopwatch.GetTimestamp();
+                Interlocked.Increment(ref this.busyHandlerCount);
+                Exception handlerException = null;
+                try
+                {
+                    workItem.Handler();
+                }
+                catch (Exception e)
+                {
+                    handlerException = e;
+                }
+                finally
+                {
+                    Interlocked.Decrement(ref this.busyHandlerCount);
+                    if (workItem.Priority == NamedPipeRequestPriority.Background)
+                    {
+                        lock (this.queueLock)
+                        {
+                            // A queued background request may have been waiting for this slot
+                            --this.busyBackgroundHandlerCount;
+                            Monitor.Pulse(this.queueLock);
+                        }
+                    }
+
+                    long endTicks = Stopwatch.GetTimestamp();
+                    long handlerTicks = endTicks - startTicks;
+                    Interlocked.Increment(ref this.handledCount);
+                    Interlocked.Add(ref this.totalQueueWaitTicks, startTicks - workItem.QueuedTicks);
+                    Interlocked.Add(ref this.totalHandlerTicks, handlerTicks);
+                    this.latencyStats[(int)workItem.Priority].Add(endTicks - workItem.QueuedTicks);
+
+                    long maxHandlerTicks;
+                    while (handlerTicks > (maxHandlerTicks = Interlocked.Read(ref this.maxHandlerTicks))
+                        && Interlocked.CompareExchange(ref this.maxHandlerTicks, handlerTicks, maxHandlerTicks) != maxHandlerTicks)
+                    {
+                    }
+                }
+
+                // Completed once the metrics include this handler
+                if (handlerException == null)
+                {
+                    workItem.Completion.TrySetResult(true);
+                }
+                else
+                {
+                    workItem.Completion.TrySetException(handlerException);
+                }
+            }
+        }
+
+        private class WorkItem
+        {
+            public WorkItem(Action handler, NamedPipeRequestPriority priority)
+            {
+                this.Handler = handler;
+                this.Priority = priority;
+                this.QueuedTicks = Stopwatch.GetTimestamp();
+
+                // The continuation reads the connection's next request, which must not run on a handler thread
+                this.Completion = new TaskCompletionSource<bool>(TaskCreationOptions.RunContinuationsAsynchronously);
+            }
+
+            public Action Handler { get; }
+
+            public NamedPipeRequestPriority Priority { get; }
+
+            public long QueuedTicks { get; }
+
+            public TaskCompletionSource<bool> Completion { get; }
+        }
+
+        /// <summary>
+        /// Latency (queue wait plus handler time) of the requests of one priority.  Once there are
+        /// <see cref="MaxLatencySamples"/> samples, new samples replace the oldest ones, and so the
+        /// percentiles are of the most recent requests.  The maximum is of every request.
+        /// </summary>
+        private class LatencyStats
+        {
+            private readonly Lock statsLock = new Lock();
+            private readonly long[] samples = new long[MaxLatencySamples];
+            private long count;
+            private long maxLatencyTicks;
+
+            public LatencyStats(NamedPipeRequestPriority priority)
+            {
+                this.Priority = priority;
+            }
+
+            public NamedPipeRequestPriority Priority { get; }
+
+            public void Add(long latencyTicks)
+            {
+                lock (this.statsLock)
+                {
+                    this.samples[this.count % MaxLatencySamples] = latencyTicks;
+                    ++this.count;
+                    this.maxLatencyTicks = Math.Max(this.maxLatencyTicks, latencyTicks);
+                }
+            }
+
+            public EventMetadata GetAndReset()
+            {
+                long[] sorted;
+                long count;
+                long maxLatencyTicks;
+                lock (this.statsLock)
+                {
+                    count = this.count;
+                    maxLatencyTicks = this.maxLatencyTicks;
+                    sorted = this.samples.Take((int)Math.Min(count, MaxLatencySamples)).ToArray();
+                    this.count = 0;
+                    this.maxLatencyTicks = 0;
+                }
+
+                Array.Sort(sorted);
+
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("RequestsHandled", count);
+                metadata.Add("P50LatencyMs", GetPercentileMilliseconds(sorted, 50));
+                metadata.Add("P90LatencyMs", GetPercentileMilliseconds(sorted, 90));
+                metadata.Add("P99LatencyMs", GetPercentileMilliseconds(sorted, 99));
+                metadata.Add("MaxLatencyMs", TicksToMilliseconds(maxLatencyTicks));
+                return metadata;
+            }
+
+            private static long GetPercentileMilliseconds(long[] sorted, int percentile)
+            {
+                if (sorted.Length == 0)
+                {
+                    return 0;
+                }
+
+                // Nearest-rank percentile
+                int rank = (int)Math.Ceiling(percentile / 100.0 * sorted.Length);
+                return TicksToMilliseconds(sorted[Math.Max(rank, 1) - 1]);
+            }
+        }
+    }
+}
@@ -32,8 +32,10 @@ public static class GetStatus
             public const string Unmounting = "Unmounting";
             public const string MountFailed = "MountFailed";
 
-            public class Response
+            public class Response : IBinaryNamedPipeMessage
             {
+                private static readonly string[] KnownMountStatuses = new string[] { Mounting, Ready, Unmounting, MountFailed };
+
                 public string MountStatus { get; set; }
                 public string MountProgress { get; set; }
                 public string EnlistmentRoot { get; set; }
@@ -49,10 +51,43 @@ public static Response FromJson(string json)
                     return GVFSJsonOptions.Deserialize<Response>(json);
                 }
 
+                public static Response FromBinary(ReadOnlySpan<byte> message)
+                {
+                    BinaryMessageReader reader = new BinaryMessageReader(message);
+                    Binary.ReadHeader(ref reader, Binary.MessageType.GetStatusResponse);
+
+                    return new Response
+                    {
+                        MountStatus = reader.ReadString(KnownMountStatuses),
+                        MountProgress = reader.ReadString(),
+                        EnlistmentRoot = reader.ReadString(),
+                        LocalCacheRoot = reader.ReadString(),
+                        RepoUrl = reader.ReadString(),
+                        CacheServer = reader.ReadString(),
+                        BackgroundOperationCount = reader.ReadVarInt32(),
+                        LockStatus = reader.ReadString(),
+                        DiskLayoutVersion = reader.ReadString(),
+                    };
+                }
+
                 public string ToJson()
                 {
                     return GVFSJsonOptions.Serialize(this);
                 }
+
+                public void WriteBinary(BinaryMessageWriter writer)
+                {
+                    Binary.WriteHeader(writer, Binary.MessageType.GetStatusResponse);
+                    writer.WriteString(this.MountStatus);
+                    writer.WriteString(this.MountProgress);
+                    writer.WriteString(this.EnlistmentRoot);
+                    writer.WriteString(this.LocalCacheRoot);
+                    writer.WriteString(this.RepoUrl);
+                    writer.WriteString(this.CacheServer);
+                    writer.WriteVarInt32(this.BackgroundOperationCount);
+                    writer.WriteString(this.LockStatus);
+                    writer.WriteString(this.DiskLayoutVersion);
+                }
             }
         }
 
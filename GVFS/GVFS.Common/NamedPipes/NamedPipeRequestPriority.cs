@@ -0,0 +1,21 @@
+﻿namespace GVFS.Common.NamedPipes
+{
+    /// <summary>
+    /// The scheduling class of a request handled by a <see cref="NamedPipeServer"/>.
+    /// </summary>
+    public enum NamedPipeRequestPriority
+    {
+        /// <summary>
+        /// A process is blocked waiting for the response (for example a git command waiting for an
+        /// object or the GVFS lock).  Interactive requests are handled before any queued background
+        /// request.
+        /// </summary>
+        Interactive = 0,
+
+        /// <summary>
+        /// Bulk work (prefetches, maintenance jobs, dehydrate).  Background requests never occupy
+        /// more than half of the handler threads, so interactive requests always have a thread.
+        /// </summary>
+        Background = 1,
+    }
+}
@@ -3,6 +3,7 @@
 using System.IO;
 using System.IO.Pipes;
 using System.Threading;
+using System.Threading.Tasks;
 
 namespace GVFS.Common.NamedPipes
 {
@@ -19,33 +20,79 @@ namespace GVFS.Common.NamedPipes
     ///      including null and bytes that represent newline characters.
     ///   2) It would be easy to implement in multiple places, as we
     ///      have managed and native implementations.
+    ///
+    ///    The messages sent for every git command can instead be sent as binary
+    ///    frames (see <see cref="BinaryMessageWriter"/>), which start with a 0x2
+    ///    byte and so cannot be mistaken for text.  A server that has no binary
+    ///    request handler replies to a binary request with a text UnknownRequest.
+    ///
+    /// Several pipe instances wait for connections at once so that a burst of clients (such as the
+    /// git processes of a parallel build) does not queue behind a single listening instance.  A
+    /// connection holds no thread while it waits for its next request, and requests are handled on a
+    /// bounded <see cref="NamedPipeHandlerPool"/>, so the number of threads does not grow with the
+    /// number of clients.
     /// </summary>
-    public class NamedPipeServer : IDisposable
+    public class NamedPipeServer : IDisposable, IHeartBeatMetadataProvider
     {
-        private bool isStopping;
+        private const int ListeningInstanceCount = 4;
+
+        private static readonly int HandlerThreadCount = Math.Max(8, Environment.ProcessorCount * 2);
+
+        private volatile bool isStopping;
         private string pipeName;
-        private Action<Connection> handleConnection;
+        private Action<ITracer, string, Connection> handleRequest;
+        private Action<ITracer, ReadOnlyMemory<byte>, Connection> handleBinaryRequest;
+        private Func<string, NamedPipeRequestPriority> getRequestPriority;
         private ITracer tracer;
 
-        private NamedPipeServerStream listeningPipe;
+        private NamedPipeHandlerPool handlerPool;
+        private CancellationTokenSource stopListening;
 
-        private NamedPipeServer(string pipeName, ITracer tracer, Action<Connection> handleConnection)
+        private NamedPipeServer(
+            string pipeName,
+            ITracer tracer,
+            Action<ITracer, string, Connection> handleRequest,
+            Func<string, NamedPipeRequestPriority> getRequestPriority,
+            Action<ITracer, ReadOnlyMemory<byte>, Connection> handleBinaryRequest)
         {
             this.pipeName = pipeName;
             this.tracer = tracer;
-            this.handleConnection = handleConnection;
+            this.handleRequest = handleRequest;
+            this.handleBinaryRequest = handleBinaryRequest;
+            this.getRequestPriority = getRequestPriority ?? (request => NamedPipeRequestPriority.Interactive);
             this.isStopping = false;
+            this.handlerPool = new NamedPipeHandlerPool(HandlerThreadCount);
+            this.stopListening = new CancellationTokenSource();
         }
 
-        public static NamedPipeServer StartNewServer(string pipeName, ITracer tracer, Action<ITracer, string, Connection> handleRequest)
+        /// <param name="getRequestPriority">
+        /// Classifies each request before it is queued for a handler thread.  When null every request is
+        /// <see cref="NamedPipeRequestPriority.Interactive"/>.
+        /// </param>
+        /// <param name="handleBinaryRequest">
+        /// Handles binary requests, which are always <see cref="NamedPipeRequestPriority.Interactive"/>.  The
+        /// request is only valid until the handler returns.
+        /// </param>
+        public static NamedPipeServer StartNewServer(
+            string pipeName,
+            ITracer tracer,
+            Action<ITracer, string, Connection> handleRequest,
+            Func<string, NamedPipeRequestPriority> getRequestPriority = null,
+            Action<ITracer, ReadOnlyMemory<byte>, Connection> handleBinaryRequest = null)
         {
             if (pipeName.Length > GVFSPlatform.Instance.Constants.MaxPipePathLength)
             {
                 throw new PipeNameLengthException(string.Format("The pipe name ({0}) exceeds the max length allowed({1})", pipeName, GVFSPlatform.Instance.Constants.MaxPipePathLength));
             }
 
-            NamedPipeServer pipeServer = new NamedPipeServer(pipeName, tracer, connection => HandleConnection(tracer, connection, handleRequest));
-            pipeServer.OpenListeningPipe();
+            NamedPipeServer pipeServer = new NamedPipeServer(pipeName, tracer, handleRequest, getRequestPriority, handleBinaryRequest);
+
+            // The pipes are created before returning so that clients can connect as soon as the server has started
+            for (int i = 0; i < ListeningInstanceCount; ++i)
+            {
+                NamedPipeServerStream listeningPipe = pipeServer.CreateListeningPipe();
+                Task.Run(() => pipeServer.AcceptConnectionsAsync(listeningPipe));
+            }
 
             return pipeServer;
         }
@@ -53,117 +100,138 @@ public static NamedPipeServer StartNewServer(string pipeName, ITracer tracer, Ac
         public void Dispose()
         {
             this.isStopping = true;
-
-            NamedPipeServerStream pipe = Interlocked.Exchange(ref this.listeningPipe, null);
-            if (pipe != null)
-            {
-                pipe.Dispose();
-            }
+            this.stopListening.Cancel();
+            this.handlerPool.Dispose();
         }
 
-        private static void HandleConnection(ITracer tracer, Connection connection, Action<ITracer, string, Connection> handleRequest)
+        /// <summary>
+        /// The handler pool's queue depth and handler latency since the last call.
+        /// </summary>
+        public EventMetadata GetAndResetHeartBeatMetadata(out bool logToFile)
         {
-            while (connection.IsConnected)
-            {
-                string request = connection.ReadRequest();
+            EventMetadata metrics = this.handlerPool.GetAndResetMetrics();
+            logToFile = (int)metrics["MaxQueueDepth"] > 0;
 
-                if (request == null ||
-                    !connection.IsConnected)
-                {
-                    break;
-                }
-
-                handleRequest(tracer, request, connection);
-            }
+            EventMetadata metadata = new EventMetadata();
+            metadata.Add(nameof(NamedPipeServer), metrics);
+            return metadata;
         }
 
-        private void OpenListeningPipe()
+        private NamedPipeServerStream CreateListeningPipe()
         {
             try
             {
-                if (this.listeningPipe != null)
-                {
-                    throw new InvalidOperationException("There is already a pipe listening for a connection");
-                }
-
-                this.listeningPipe = GVFSPlatform.Instance.CreatePipeByName(this.pipeName);
-                this.listeningPipe.BeginWaitForConnection(this.OnNewConnection, this.listeningPipe);
+                return GVFSPlatform.Instance.CreatePipeByName(this.pipeName);
             }
             catch (Exception e)
             {
-                this.LogErrorAndExit("OpenListeningPipe caught unhandled exception, exiting process", e);
-            }
-        }
-
-        private void OnNewConnection(IAsyncResult ar)
-        {
-            if (!this.isStopping)
-            {
-                this.OnNewConnection(ar, createNewThreadIfSynchronous: true);
+                this.LogErrorAndExit("CreateListeningPipe caught unhandled exception, exiting process", e);
+                return null;
             }
         }
 
-        private void OnNewConnection(IAsyncResult ar, bool createNewThreadIfSynchronous)
+        private async Task AcceptConnectionsAsync(NamedPipeServerStream listeningPipe)
         {
-            if (createNewThreadIfSynchronous &&
-               ar.CompletedSynchronously)
+            while (!this.isStopping)
             {
-                // if this callback got called synchronously, we must not do any blocking IO on this thread
-                // or we will block the original caller. Moving to a new thread so that it will be safe
-                // to call a blocking Read on the NamedPipeServerStream
-
-                new Thread(() => this.OnNewConnection(ar, createNewThreadIfSynchronous: false)).Start();
-                return;
-            }
-
-            this.listeningPipe = null;
-            bool connectionBroken = false;
+                NamedPipeServerStream pipe = listeningPipe ?? this.CreateListeningPipe();
+                listeningPipe = null;
 
-            NamedPipeServerStream pipe = (NamedPipeServerStream)ar.AsyncState;
-            try
-            {
                 try
                 {
-                    pipe.EndWaitForConnection(ar);
+                    await pipe.WaitForConnectionAsync(this.stopListening.Token).ConfigureAwait(false);
+                }
+                catch (Exception e) when (this.isStopping && (e is OperationCanceledException || e is ObjectDisposedException))
+                {
+                    pipe.Dispose();
+                    return;
                 }
                 catch (IOException e)
                 {
-                    connectionBroken = true;
+                    pipe.Dispose();
 
                     EventMetadata metadata = new EventMetadata();
                     metadata.Add("Area", "NamedPipeServer");
                     metadata.Add("Exception", e.ToString());
                     metadata.Add(TracingConstants.MessageKey.WarningMessage, "OnNewConnection: Connection broken");
                     this.tracer.RelatedEvent(EventLevel.Warning, "OnNewConnectionn_EndWaitForConnection_IOException", metadata);
+                    continue;
                 }
                 catch (Exception e)
                 {
                     this.LogErrorAndExit("OnNewConnection caught unhandled exception, exiting process", e);
                 }
 
-                if (!this.isStopping)
+                if (this.isStopping)
                 {
-                    this.OpenListeningPipe();
+                    pipe.Dispose();
+                    return;
+                }
 
-                    if (!connectionBroken)
+                // Not awaited, this instance goes back to accepting connections while the connection is handled
+                _ = this.HandleConnectionAsync(pipe);
+            }
+        }
+
+        private async Task HandleConnectionAsync(NamedPipeServerStream pipe)
+        {
+            try
+            {
+                Connection connection = new Connection(pipe, this.tracer, () => this.isStopping);
+                while (connection.IsConnected)
+                {
+                    NamedPipeFrame request = await connection.ReadRequestFrameAsync().ConfigureAwait(false);
+
+                    if (request.IsEndOfStream ||
+                        !connection.IsConnected)
                     {
-                        try
-                        {
-                            this.handleConnection(new Connection(pipe, this.tracer, () => this.isStopping));
-                        }
-                        catch (Exception e)
-                        {
-                            this.LogErrorAndExit("Unhandled exception in connection handler", e);
-                        }
+                        break;
                     }
+
+                    // The next request is not read until the handler has run, so a binary request (which
+                    // refers to the connection's read buffer) stays valid while it is handled
+                    NamedPipeRequestPriority priority = request.IsBinary ? NamedPipeRequestPriority.Interactive : this.getRequestPriority(request.Text);
+                    await this.handlerPool.RunAsync(
+                        () =>
+                        {
+                            if (connection.IsConnected)
+                            {
+                                this.HandleRequest(request, connection);
+                            }
+                        },
+                        priority).ConfigureAwait(false);
                 }
             }
+            catch (OperationCanceledException) when (this.isStopping)
+            {
+                // The handler pool was disposed while the request was waiting for a thread
+            }
+            catch (Exception e)
+            {
+                this.LogErrorAndExit("Unhandled exception in connection handler", e);
+            }
             finally
             {
                 pipe.Dispose();
             }
         }
 
+        private void HandleRequest(NamedPipeFrame request, Connection connection)
+        {
+            if (!request.IsBinary)
+            {
+                this.handleRequest(this.tracer, request.Text, connection);
+            }
+            else if (this.handleBinaryRequest != null)
+            {
+                this.handleBinaryRequest(this.tracer, request.Binary, connection);
+            }
+            else
+            {
+                connection.TrySendResponse(NamedPipeMessages.UnknownRequest);
+            }
+        }
+
         private void LogErrorAndExit(string message, Exception e)
         {
             if (this.tracer != null)
@@ -208,6 +276,19 @@ public NamedPipeMessages.Message ReadMessage()
                 return NamedPipeMessages.Message.FromString(this.ReadRequest());
             }
 
+            public async Task<NamedPipeFrame> ReadRequestFrameAsync()
+            {
+                try
+                {
+                    return await this.reader.ReadFrameAsync(CancellationToken.None).ConfigureAwait(false);
+                }
+                catch (IOException e)
+                {
+                    this.TraceReadError(e);
+                    return default(NamedPipeFrame);
+                }
+            }
+
             public string ReadRequest()
             {
                 try
@@ -216,14 +297,7 @@ public string ReadRequest()
                 }
                 catch (IOException e)
                 {
-                    EventMetadata metadata = new EventMetadata();
-                    metadata.Add("ExceptionMessage", e.Message);
-                    metadata.Add("StackTrace", e.StackTrace);
-                    this.tracer.RelatedWarning(
-                        metadata: metadata,
-                        message: $"Error reading message from NamedPipe: {e.Message}",
-                        keywords: Keywords.Telemetry);
-
+                    this.TraceReadError(e);
                     return null;
                 }
             }
@@ -245,6 +319,30 @@ public bool TrySendResponse(NamedPipeMessages.Message message)
             {
                 return this.TrySendResponse(message.ToString());
             }
+
+            public virtual bool TrySendBinaryResponse(IBinaryNamedPipeMessage message)
+            {
+                try
+                {
+                    this.writer.WriteBinaryMessage(message);
+                    return true;
+                }
+                catch (IOException)
+                {
+                    return false;
+                }
+            }
+
+            private void TraceReadError(IOException e)
+            {
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("ExceptionMessage", e.Message);
+                metadata.Add("StackTrace", e.StackTrace);
+                this.tracer.RelatedWarning(
+                    metadata: metadata,
+                    message: $"Error reading message from NamedPipe: {e.Message}",
+                    keywords: Keywords.Telemetry);
+            }
         }
     }
 }
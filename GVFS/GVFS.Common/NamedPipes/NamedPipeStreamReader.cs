@@ -1,77 +1,227 @@
 using System;
+using System.Buffers.Binary;
 using System.Collections.Generic;
 using System.IO;
-using System.Linq;
 using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
 
 namespace GVFS.Common.NamedPipes
 {
     /// <summary>
     /// Implements the NamedPipe protocol as described in NamedPipeServer.
     /// </summary>
+    /// <remarks>
+    /// The stream is read a buffer at a time rather than a byte at a time, so bytes that follow a
+    /// message are kept for the next call to <see cref="ReadFrame"/> or <see cref="ReadFrameAsync"/>.
+    ///
+    /// A message that starts with <see cref="BinaryMessageWriter.FrameMarker"/> is a binary frame, and is
+    /// read in full into the buffer (which grows as needed) so that it can be decoded without copying.
+    /// </remarks>
     public class NamedPipeStreamReader
     {
+        public const int MaxBinaryFrameLength = 16 * 1024 * 1024;
+
         private const int InitialListSize = 1024;
+        private const int BufferSize = 4096;
         private const byte TerminatorByte = 0x3;
-        private readonly byte[] buffer;
 
         private Stream stream;
+        private byte[] buffer;
+        private int bufferOffset;
+        private int bufferCount;
 
         public NamedPipeStreamReader(Stream stream)
         {
             this.stream = stream;
-            this.buffer = new byte[1];
+            this.buffer = new byte[BufferSize];
         }
 
         /// <summary>
-        /// Read a message from the stream.
+        /// Read a text message from the stream.
         /// </summary>
         /// <returns>The message read from the stream, or null if the end of the input stream has been reached. </returns>
         public string ReadMessage()
         {
-            byte currentByte;
+            return GetText(this.ReadFrame());
+        }
+
+        /// <summary>
+        /// Read a text message from the stream without blocking a thread while waiting for it.
+        /// </summary>
+        /// <returns>The message read from the stream, or null if the end of the input stream has been reached. </returns>
+        public async Task<string> ReadMessageAsync(CancellationToken cancellationToken)
+        {
+            return GetText(await this.ReadFrameAsync(cancellationToken).ConfigureAwait(false));
+        }
+
+        /// <summary>
+        /// Read a text or binary message from the stream.
+        /// </summary>
+        /// <returns>The message read from the stream, <see cref="NamedPipeFrame.IsEndOfStream"/> if the end of the input stream has been reached.</returns>
+        public NamedPipeFrame ReadFrame()
+        {
+            List<byte> partialMessage = null;
+            NamedPipeFrame frame;
+            while (!this.TryTakeFrame(ref partialMessage, out frame))
+            {
+                int readOffset = this.bufferOffset + this.bufferCount;
+                if (!this.FillBuffer(this.stream.Read(this.buffer, readOffset, this.buffer.Length - readOffset), partialMessage))
+                {
+                    return default(NamedPipeFrame);
+                }
+            }
+
+            return frame;
+        }
+
+        /// <summary>
+        /// Read a text or binary message from the stream without blocking a thread while waiting for it.
+        /// </summary>
+        /// <returns>The message read from the stream, <see cref="NamedPipeFrame.IsEndOfStream"/> if the end of the input stream has been reached.</returns>
+        public async Task<NamedPipeFrame> ReadFrameAsync(CancellationToken cancellationToken)
+        {
+            List<byte> partialMessage = null;
+            NamedPipeFrame frame;
+            while (!this.TryTakeFrame(ref partialMessage, out frame))
+            {
+                int readOffset = this.bufferOffset + this.bufferCount;
+                int bytesRead = await this.stream.ReadAsync(this.buffer, readOffset, this.buffer.Length - readOffset, cancellationToken).ConfigureAwait(false);
+                if (!this.FillBuffer(bytesRead, partialMessage))
+                {
+                    return default(NamedPipeFrame);
+                }
+            }
+
+            return frame;
+        }
+
+        private static string GetText(NamedPipeFrame frame)
+        {
+            if (frame.IsBinary)
+            {
+                throw new IOException("Binary message read from stream when a text message was expected.");
+            }
 
-            bool streamOpen = this.TryReadByte(out currentByte);
-            if (!streamOpen)
+            return frame.Text;
+        }
+
+        /// <summary>
+        /// Takes the next message from the buffered bytes.  Returns false if they do not contain all of
+        /// the next message, in which case there is room in the buffer after the buffered bytes for more
+        /// to be read.
+        /// </summary>
+        private bool TryTakeFrame(ref List<byte> partialMessage, out NamedPipeFrame frame)
+        {
+            if (partialMessage == null &&
+                this.bufferCount > 0 &&
+                this.buffer[this.bufferOffset] == BinaryMessageWriter.FrameMarker)
             {
-                // The end of the stream has been reached - return null to indicate this.
-                return null;
+                return this.TryTakeBinaryFrame(out frame);
             }
 
-            List<byte> bytes = new List<byte>(InitialListSize);
+            string message;
+            bool tookMessage = this.TryTakeMessage(ref partialMessage, out message);
+            frame = new NamedPipeFrame(message);
+            return tookMessage;
+        }
 
-            do
+        private bool TryTakeBinaryFrame(out NamedPipeFrame frame)
+        {
+            frame = default(NamedPipeFrame);
+            int frameLength = BinaryMessageWriter.FrameHeaderLength;
+            if (this.bufferCount >= BinaryMessageWriter.FrameHeaderLength)
             {
-                bytes.Add(currentByte);
-                streamOpen = this.TryReadByte(out currentByte);
+                int messageLength = BinaryPrimitives.ReadInt32LittleEndian(new ReadOnlySpan<byte>(this.buffer, this.bufferOffset + 1, sizeof(int)));
+                if (messageLength < 0 || messageLength > MaxBinaryFrameLength)
+                {
+                    throw new IOException($"Binary message read from stream has an invalid length: {messageLength}");
+                }
 
-                if (!streamOpen)
+                frameLength += messageLength;
+                if (this.bufferCount >= frameLength)
                 {
-                    // We have read a partial message (the last byte received does not indicate that
-                    // this was the end of the message), but the stream has been closed. Throw an exception
-                    // and let upper layer deal with this condition.
+                    frame = new NamedPipeFrame(new ReadOnlyMemory<byte>(this.buffer, this.bufferOffset + BinaryMessageWriter.FrameHeaderLength, messageLength));
+                    this.bufferCount -= frameLength;
+                    this.bufferOffset = this.bufferCount == 0 ? 0 : this.bufferOffset + frameLength;
+                    return true;
+                }
+            }
 
-                    throw new IOException("Incomplete message read from stream. The end of the stream was reached without the expected terminating byte.");
+            // Move the partial frame to the start of the buffer, growing it if the frame does not fit
+            byte[] destination = this.buffer;
+            if (frameLength > this.buffer.Length)
+            {
+                destination = new byte[Math.Max(frameLength, this.buffer.Length * 2)];
+            }
+
+            Buffer.BlockCopy(this.buffer, this.bufferOffset, destination, 0, this.bufferCount);
+            this.buffer = destination;
+            this.bufferOffset = 0;
+            return false;
+        }
+
+        /// <summary>
+        /// Takes the next text message from the buffered bytes.  Returns false, with the buffered bytes
+        /// appended to <paramref name="partialMessage"/>, if they do not contain the end of a message.
+        /// </summary>
+        private bool TryTakeMessage(ref List<byte> partialMessage, out string message)
+        {
+            int terminatorIndex = Array.IndexOf(this.buffer, TerminatorByte, this.bufferOffset, this.bufferCount);
+            if (terminatorIndex < 0)
+            {
+                if (this.bufferCount > 0)
+                {
+                    partialMessage = partialMessage ?? new List<byte>(InitialListSize);
+                    partialMessage.AddRange(new ArraySegment<byte>(this.buffer, this.bufferOffset, this.bufferCount));
                 }
+
+                this.bufferOffset = 0;
+                this.bufferCount = 0;
+                message = null;
+                return false;
+            }
+
+            int length = terminatorIndex - this.bufferOffset;
+            if (partialMessage == null)
+            {
+                message = Encoding.UTF8.GetString(this.buffer, this.bufferOffset, length);
+            }
+            else
+            {
+                partialMessage.AddRange(new ArraySegment<byte>(this.buffer, this.bufferOffset, length));
+                message = Encoding.UTF8.GetString(partialMessage.ToArray());
             }
-            while (currentByte != TerminatorByte);
 
-            return Encoding.UTF8.GetString(bytes.ToArray());
+            // Skip the terminator
+            this.bufferCount -= length + 1;
+            this.bufferOffset = this.bufferCount == 0 ? 0 : terminatorIndex + 1;
+            return true;
         }
 
         /// <summary>
-        /// Read a byte from the stream.
+        /// Records the bytes read into the buffer, after the bytes already buffered.
         /// </summary>
-        /// <param name="readByte">The byte read from the stream</param>
-        /// <returns>True if byte read, false if end of stream has been reached</returns>
-        private bool TryReadByte(out byte readByte)
+        /// <returns>True if bytes were read, false if end of stream has been reached</returns>
+        private bool FillBuffer(int bytesRead, List<byte> partialMessage)
         {
-            this.buffer[0] = 0;
+            if (bytesRead == 0)
+            {
+                if (partialMessage != null || this.bufferCount > 0)
+                {
+                    // We have read a partial message (the last byte received does not indicate that
+                    // this was the end of the message), but the stream has been closed. Throw an exception
+                    // and let upper layer deal with this condition.
 
-            int numBytesRead = this.stream.Read(this.buffer, 0, 1);
-            readByte = this.buffer[0];
+                    throw new IOException("Incomplete message read from stream. The end of the stream was reached without the expected terminating byte.");
+                }
+
+                // The end of the stream has been reached - return false to indicate this.
+                return false;
+            }
 
-            return numBytesRead == 1;
+            this.bufferCount += bytesRead;
+            return true;
         }
     }
 }
@@ -9,6 +9,10 @@ public class NamedPipeStreamWriter
         private const string TerminatorByteString = "\x3";
         private Stream stream;
 
+        // Reused for every binary message, and kept for the lifetime of the writer rather than
+        // returning its buffer to the pool
+        private BinaryMessageWriter binaryWriter;
+
         public NamedPipeStreamWriter(Stream stream)
         {
             this.stream = stream;
@@ -20,5 +24,18 @@ public void WriteMessage(string message)
             this.stream.Write(byteBuffer, 0, byteBuffer.Length);
             this.stream.Flush();
         }
+
+        public void WriteBinaryMessage(IBinaryNamedPipeMessage message)
+        {
+            if (this.binaryWriter == null)
+            {
+                this.binaryWriter = new BinaryMessageWriter();
+            }
+
+            this.binaryWriter.Reset();
+            message.WriteBinary(this.binaryWriter);
+            this.stream.Write(this.binaryWriter.GetFrame());
+            this.stream.Flush();
+        }
     }
 }
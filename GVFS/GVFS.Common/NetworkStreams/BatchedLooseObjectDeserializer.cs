@@ -1,15 +1,34 @@
 ﻿using System;
+using System.Buffers;
+using System.Collections.Concurrent;
 using System.IO;
 using System.Linq;
+using System.Runtime.ExceptionServices;
 using System.Text;
+using System.Threading;
 
 namespace GVFS.Common.NetworkStreams
 {
     /// <summary>
     /// Deserializer for concatenated loose objects.
     /// </summary>
+    /// <remarks>
+    /// With more than one worker the objects are processed by a pipeline: the thread calling
+    /// <see cref="ProcessObjects"/> reads each object from the source stream into a buffer and queues it,
+    /// and the workers call <see cref="OnLooseObject"/> for the queued objects in parallel (so the callback
+    /// must be thread-safe).  The total size of the queued buffers is limited to
+    /// <see cref="MaxBufferedBytes"/>, so a slow disk pushes back on the network rather than the download
+    /// being buffered in memory.  Objects larger than <see cref="MaxBufferedObjectSize"/> are streamed to
+    /// the callback on the reading thread as they are when there is a single worker.
+    /// </remarks>
     public class BatchedLooseObjectDeserializer
     {
+        public const int MaxBufferedObjectSize = 4 * 1024 * 1024;
+        public const long MaxBufferedBytes = 64 * 1024 * 1024;
+
+        // Each worker inflates and hashes objects, beyond this the disk is the limit
+        private const int MaxDefaultWorkerCount = 8;
+
         private const int NumObjectIdBytes = 20;
         private const int NumObjectHeaderBytes = NumObjectIdBytes + sizeof(long);
         private static readonly byte[] ExpectedHeader
@@ -21,11 +40,18 @@ public class BatchedLooseObjectDeserializer
 
         private readonly Stream source;
         private readonly OnLooseObject onLooseObject;
+        private readonly int workerCount;
 
         public BatchedLooseObjectDeserializer(Stream source, OnLooseObject onLooseObject)
+            : this(source, onLooseObject, workerCount: 1)
+        {
+        }
+
+        public BatchedLooseObjectDeserializer(Stream source, OnLooseObject onLooseObject, int workerCount)
         {
             this.source = source;
             this.onLooseObject = onLooseObject;
+            this.workerCount = Math.Max(1, workerCount);
         }
 
         /// <summary>
@@ -33,6 +59,16 @@ public BatchedLooseObjectDeserializer(Stream source, OnLooseObject onLooseObject
         /// </summary>
         public delegate void OnLooseObject(Stream objectStream, string sha1);
 
+        /// <summary>
+        /// Returns the number of workers to use for each stream when concurrentStreams
+        /// streams are being deserialized at the same time.
+        /// </summary>
+        public static int GetDefaultWorkerCount(int concurrentStreams)
+        {
+            int workers = Environment.ProcessorCount / Math.Max(1, concurrentStreams);
+            return Math.Max(1, Math.Min(workers, MaxDefaultWorkerCount));
+        }
+
         /// <summary>
         /// Read all the objects from the source stream and call <see cref="OnLooseObject"/> for each.
         /// </summary>
@@ -41,6 +77,11 @@ public int ProcessObjects()
         {
             this.ValidateHeader();
 
+            if (this.workerCount > 1)
+            {
+                return this.ProcessObjectsInParallel();
+            }
+
             // Start reading objects
             int numObjectsRead = 0;
             byte[] curObjectHeader = new byte[NumObjectHeaderBytes];
@@ -74,6 +115,120 @@ public int ProcessObjects()
             return numObjectsRead;
         }
 
+        private int ProcessObjectsInParallel()
+        {
+            int numObjectsRead = 0;
+            byte[] curObjectHeader = new byte[NumObjectHeaderBytes];
+
+            BufferBudget budget = new BufferBudget(MaxBufferedBytes);
+            using (BlockingCollection<BufferedObject> queue = new BlockingCollection<BufferedObject>())
+            {
+                Thread[] workers = new Thread[this.workerCount];
+                for (int i = 0; i < workers.Length; ++i)
+                {
+                    workers[i] = new Thread(() => this.ProcessBufferedObjects(queue, budget));
+                    workers[i].Start();
+                }
+
+                try
+                {
+                    while (!budget.HasFailed && this.ShouldContinueReading(curObjectHeader))
+                    {
+                        long curLength = BitConverter.ToInt64(curObjectHeader, NumObjectIdBytes);
+                        string objectId = SHA1Util.HexStringFromBytes(curObjectHeader, NumObjectIdBytes);
+
+                        if (objectId.Equals(GVFSConstants.AllZeroSha))
+                        {
+                            throw new RetryableException("Received all-zero SHA before end of stream");
+                        }
+
+                        if (curLength < 0)
+                        {
+                            throw new RetryableException($"Received invalid length {curLength} for object {objectId}");
+                        }
+
+                        if (curLength > MaxBufferedObjectSize)
+                        {
+                            using (Stream rawObjectData = new RestrictedStream(this.source, curLength))
+                            {
+                                this.onLooseObject(rawObjectData, objectId);
+                            }
+                        }
+                        else
+                        {
+                            int length = (int)curLength;
+                            if (!budget.TryAcquire(length))
+                            {
+                                // A worker failed, its exception is thrown below
+                                break;
+                            }
+
+                            byte[] buffer = ArrayPool<byte>.Shared.Rent(length);
+                            int bytesRead = StreamUtil.TryReadGreedy(this.source, buffer, 0, length);
+                            if (bytesRead != length)
+                            {
+                                ArrayPool<byte>.Shared.Return(buffer);
+                                budget.Release(length);
+                                throw new RetryableException(
+                                    string.Format(
+                                        "Reached end of stream before the end of object {0}. Expected {1} bytes, got {2}.",
+                                        objectId,
+                                        length,
+                                        bytesRead));
+                            }
+
+                            queue.Add(new BufferedObject(objectId, buffer, length));
+                        }
+
+                        numObjectsRead++;
+                    }
+                }
+                catch (Exception e)
+                {
+                    budget.Fail(e);
+                }
+                finally
+                {
+                    queue.CompleteAdding();
+                    foreach (Thread worker in workers)
+                    {
+                        worker.Join();
+                    }
+                }
+
+                budget.ThrowIfFailed();
+            }
+
+            return numObjectsRead;
+        }
+
+        private void ProcessBufferedObjects(BlockingCollection<BufferedObject> queue, BufferBudget budget)
+        {
+            foreach (BufferedObject bufferedObject in queue.GetConsumingEnumerable())
+            {
+                try
+                {
+                    // After a failure the remaining objects are only drained so that their buffers are returned
+                    if (!budget.HasFailed)
+                    {
+                        using (MemoryStream objectStream = new MemoryStream(bufferedObject.Buffer, 0, bufferedObject.Length, writable: false))
+                        {
+                            this.onLooseObject(objectStream, bufferedObject.ObjectId);
+                        }
+                    }
+                }
+                catch (Exception e)
+                {
+                    budget.Fail(e);
+                }
+                finally
+                {
+                    ArrayPool<byte>.Shared.Return(bufferedObject.Buffer);
+                    budget.Release(bufferedObject.Length);
+                }
+            }
+        }
+
         /// <summary>
         /// Parse the current object header to check if we've reached the end.
         /// </summary>
@@ -128,5 +283,94 @@ private void ValidateHeader()
                 throw new InvalidDataException("Unexpected header: " + Encoding.UTF8.GetString(headerBuf));
             }
         }
+
+        private struct BufferedObject
+        {
+            public BufferedObject(string objectId, byte[] buffer, int length)
+            {
+                this.ObjectId = objectId;
+                this.Buffer = buffer;
+                this.Length = length;
+            }
+
+            public string ObjectId { get; }
+
+            public byte[] Buffer { get; }
+
+            public int Length { get; }
+        }
+
+        /// <summary>
+        /// Limits the total size of the queued object buffers, and records the first failure of the
+        /// pipeline so that every stage can stop.
+        /// </summary>
+        private sealed class BufferBudget
+        {
+            private readonly long maxBytes;
+            private readonly object lockObject = new object();
+            private long bytesInUse;
+            private ExceptionDispatchInfo failure;
+
+            public BufferBudget(long maxBytes)
+            {
+                this.maxBytes = maxBytes;
+            }
+
+            public bool HasFailed
+            {
+                get { return Volatile.Read(ref this.failure) != null; }
+            }
+
+            /// <summary>
+            /// Waits until count bytes can be buffered.  A single buffer larger than the budget
+            /// is allowed when nothing else is buffered.
+            /// </summary>
+            /// <returns>false if the pipeline failed while waiting</returns>
+            public bool TryAcquire(int count)
+            {
+                lock (this.lockObject)
+                {
+                    while (this.failure == null && this.bytesInUse > 0 && this.bytesInUse + count > this.maxBytes)
+                    {
+                        Monitor.Wait(this.lockObject);
+                    }
+
+                    if (this.failure != null)
+                    {
+                        return false;
+                    }
+
+                    this.bytesInUse += count;
+                    return true;
+                }
+            }
+
+            public void Release(int count)
+            {
+                lock (this.lockObject)
+                {
+                    this.bytesInUse -= count;
+                    Monitor.PulseAll(this.lockObject);
+                }
+            }
+
+            public void Fail(Exception e)
+            {
+                lock (this.lockObject)
+                {
+                    if (this.failure == null)
+                    {
+                        this.failure = ExceptionDispatchInfo.Capture(e);
+                    }
+
+                    Monitor.PulseAll(this.lockObject);
+                }
+            }
+
+            public void ThrowIfFailed()
+            {
+                this.failure?.Throw();
+            }
+        }
     }
 }
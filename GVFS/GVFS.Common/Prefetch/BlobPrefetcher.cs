@@ -88,6 +88,11 @@ public class BlobPrefetcher
 
         public bool HasFailures { get; protected set; }
 
+        /// <summary>
+        /// When set, blob downloads yield to interactive work in progress in the same process.
+        /// </summary>
+        public BackgroundWorkThrottle BackgroundWorkThrottle { get; set; }
+
         public List<string> FileList { get; }
 
         public List<string> FolderList { get; }
@@ -303,6 +308,8 @@ public virtual void Prefetch(string branchOrCommit, bool isBranch)
             //      * AvailableObjects (property): Same as availableBlobs
             //      * AvailablePacks (property): Packfiles that have completed downloading
             BatchObjectDownloadStage downloader = new BatchObjectDownloadStage(this.DownloadThreadCount, this.ChunkSize, blobFinder.MissingBlobs, availableBlobs, this.Tracer, this.Enlistment, this.ObjectRequestor, this.GitObjects);
+            downloader.BackgroundWorkThrottle = this.BackgroundWorkThrottle;
+            downloader.DownloadController = this.GetDownloadController();
 
             // packIndexer
             //  Inputs:
@@ -388,10 +395,35 @@ public virtual void Prefetch(string branchOrCommit, bool isBranch)
             }
             finally
             {
+                this.GitObjects.ExistenceFilter = null;
                 sharedCheckerOwner?.Dispose();
             }
         }
 
+        /// <summary>
+        /// Returns the adaptive download controller for the cache server when gvfs.adaptive-downloads is true,
+        /// or null to download fixed size batches on every download thread.
+        /// </summary>
+        protected AdaptiveDownloadController GetDownloadController()
+        {
+            if (!this.GetBoolFromLocalConfig(GVFSConstants.GitConfig.AdaptiveDownloads, GVFSConstants.GitConfig.AdaptiveDownloadsDefault))
+            {
+                return null;
+            }
+
+            // Aim for batches that finish well within the request timeout, so that a slow server
+            // shrinks the batches before requests start to time out
+            TimeSpan timeout = this.ObjectRequestor.RetryConfig.Timeout;
+            TimeSpan targetBatchLatency = timeout > TimeSpan.Zero ? timeout / 4 : Timeout.InfiniteTimeSpan;
+
+            this.Tracer.RelatedInfo("Prefetch: Using adaptive download batch size and parallelism");
+            return AdaptiveDownloadController.ForCacheServer(
+                this.ObjectRequestor.CacheServer.Url,
+                this.ChunkSize,
+                this.DownloadThreadCount,
+                targetBatchLatency);
+        }
+
         /// <summary>
         /// Creates a factory for object existence checkers based on git config.
         /// When gvfs.prefetch-use-idx is true, returns a factory that shares a single
@@ -404,23 +436,7 @@ private Func<IObjectExistenceChecker> CreateObjectExistenceCheckerFactory(out ID
         {
             sharedCheckerOwner = null;
 
-            bool usePackIdx = false;
-            try
-            {
-                GitProcess git = new GitProcess(this.Enlistment);
-                GitProcess.ConfigResult configResult = git.GetFromLocalConfig(GVFSConstants.GitConfig.PrefetchUseIdx);
-                if (!configResult.TryParseAsString(out string value, out string _) ||
-                    string.IsNullOrEmpty(value) ||
-                    !bool.TryParse(value, out usePackIdx))
-                {
-                    usePackIdx = GVFSConstants.GitConfig.PrefetchUseIdxDefault;
-                }
-            }
-            catch (Exception ex)
-            {
-                this.Tracer.RelatedWarning("Failed to read {0} config: {1}", GVFSConstants.GitConfig.PrefetchUseIdx, ex.Message);
-            }
-
+            bool usePackIdx = this.GetBoolFromLocalConfig(GVFSConstants.GitConfig.PrefetchUseIdx, GVFSConstants.GitConfig.PrefetchUseIdxDefault);
             if (usePackIdx)
             {
                 this.Tracer.RelatedInfo("Prefetch: Using pack-index object existence checker");
@@ -431,6 +447,9 @@ private Func<IObjectExistenceChecker> CreateObjectExistenceCheckerFactory(out ID
                         this.Enlistment.LocalObjectsRoot,
                         this.Enlistment.GitObjectsRoot);
 
+                    // Blobs downloaded by this prefetch are added to the checker's filter as they are written
+                    this.GitObjects.ExistenceFilter = sharedChecker.ExistenceFilter;
+
                     sharedCheckerOwner = sharedChecker;
                     return () => new NonDisposingCheckerWrapper(sharedChecker);
                 }
@@ -446,6 +465,33 @@ private Func<IObjectExistenceChecker> CreateObjectExistenceCheckerFactory(out ID
             return () => new LibGit2ObjectExistenceChecker(this.Tracer, this.Enlistment.WorkingDirectoryBackingRoot);
         }
 
+        /// <summary>
+        /// Reads a bool setting from the enlistment's local git config.
+        /// </summary>
+        /// <returns>
+        /// The setting, or <paramref name="defaultValue"/> when it is not set, is not a bool, or cannot be read
+        /// </returns>
+        private bool GetBoolFromLocalConfig(string settingName, bool defaultValue)
+        {
+            try
+            {
+                GitProcess git = new GitProcess(this.Enlistment);
+                GitProcess.ConfigResult configResult = git.GetFromLocalConfig(settingName);
+                if (configResult.TryParseAsString(out string value, out string _) &&
+                    !string.IsNullOrEmpty(value) &&
+                    bool.TryParse(value, out bool settingValue))
+                {
+                    return settingValue;
+                }
+            }
+            catch (Exception ex)
+            {
+                this.Tracer.RelatedWarning("Failed to read {0} config: {1}", settingName, ex.Message);
+            }
+
+            return defaultValue;
+        }
+
         /// <summary>
         /// Wrapper that delegates to a shared checker but does not dispose it.
         /// Allows shared thread-safe checkers to be used in using-blocks
@@ -0,0 +1,250 @@
+﻿using GVFS.Common.Tracing;
+using System;
+using System.Collections.Concurrent;
+using System.Threading;
+
+namespace GVFS.Common.Prefetch.Pipeline
+{
+    /// <summary>
+    /// Adjusts the size of object download batches, and how many of them are in flight at once, from the
+    /// throughput, latency and errors observed for a cache server.
+    ///
+    /// The adjustments are AIMD (additive increase, multiplicative decrease):
+    ///  - A failed batch, or one that needed retries, halves both the batch size and the parallelism.
+    ///  - A batch that took longer than the target latency halves the batch size, so that a slow server
+    ///    does not push batches toward the request timeout.
+    ///  - Once as many batches as the current parallelism have succeeded (a clean window), the batch size
+    ///    grows by a fixed increment and the parallelism grows by one, probing whether another batch in
+    ///    flight helps.  If the window's throughput dropped compared to the previous window, the probe
+    ///    made things worse, and the parallelism shrinks by one instead (and the batch size is left alone).
+    ///
+    /// Parallelism keeps probing even when the throughput stays flat, so that the limits recover after
+    /// a transient outage halved them: the controller is shared by every download from a cache server in
+    /// the process, see <see cref="ForCacheServer"/>.
+    ///
+    /// Only the batches that were in flight when a decrease was made can trigger it, so a burst of
+    /// failures from the same outage halves the limits once rather than once per batch.  Every decision
+    /// is logged as an AdaptiveDownloadAdjusted event so that the rules can be tuned.
+    /// </summary>
+    public class AdaptiveDownloadController
+    {
+        public const int MinBatchSize = 50;
+        public const int MaxBatchSizeMultiplier = 4;
+
+        private const string AdjustedEventName = "AdaptiveDownloadAdjusted";
+        // Throughput below this fraction of the previous window's means the last probe made things worse
+        private const double MaxThroughputDrop = 0.95;
+
+        private static readonly ConcurrentDictionary<string, AdaptiveDownloadController> CacheServerControllers =
+            new ConcurrentDictionary<string, AdaptiveDownloadController>(StringComparer.OrdinalIgnoreCase);
+
+        private readonly object stateLock = new object();
+        private readonly string cacheServerUrl;
+        private readonly int minBatchSize;
+        private readonly int maxBatchSize;
+        private readonly int batchSizeIncrement;
+        private readonly int maxParallel;
+        private readonly TimeSpan targetBatchLatency;
+
+        private int batchSize;
+        private int parallelism;
+        private int activeDownloads;
+
+        // Incremented on every decrease, see DownloadSlot
+        private int generation;
+
+        private int windowBatches;
+        private long windowObjects;
+        private TimeSpan windowElapsed;
+        private double previousThroughput;
+
+        /// <param name="initialBatchSize">
+        /// Batch size to start with, batches grow to at most <see cref="MaxBatchSizeMultiplier"/> times this size.
+        /// </param>
+        /// <param name="maxParallel">Parallelism to start with, and the most batches that are ever in flight at once.</param>
+        /// <param name="targetBatchLatency">
+        /// Batches that take longer than this shrink the batch size, <see cref="Timeout.InfiniteTimeSpan"/> to never
+        /// shrink batches because of their latency.
+        /// </param>
+        public AdaptiveDownloadController(string cacheServerUrl, int initialBatchSize, int maxParallel, TimeSpan targetBatchLatency)
+        {
+            this.cacheServerUrl = cacheServerUrl;
+            this.minBatchSize = Math.Max(1, Math.Min(MinBatchSize, initialBatchSize));
+            this.maxBatchSize = Math.Max(this.minBatchSize, initialBatchSize * MaxBatchSizeMultiplier);
+            this.batchSizeIncrement = Math.Max(1, initialBatchSize / 4);
+            this.maxParallel = Math.Max(1, maxParallel);
+            this.targetBatchLatency = targetBatchLatency;
+
+            this.batchSize = Math.Max(this.minBatchSize, initialBatchSize);
+            this.parallelism = this.maxParallel;
+        }
+
+        public int BatchSize
+        {
+            get { return Volatile.Read(ref this.batchSize); }
+        }
+
+        public int Parallelism
+        {
+            get { return Volatile.Read(ref this.parallelism); }
+        }
+
+        /// <summary>
+        /// Returns the controller shared by every download from <paramref name="cacheServerUrl"/> in this process,
+        /// creating it with the given limits if there is none yet.
+        /// </summary>
+        public static AdaptiveDownloadController ForCacheServer(string cacheServerUrl, int initialBatchSize, int maxParallel, TimeSpan targetBatchLatency)
+        {
+            return CacheServerControllers.GetOrAdd(
+                cacheServerUrl ?? string.Empty,
+                url => new AdaptiveDownloadController(url, initialBatchSize, maxParallel, targetBatchLatency));
+        }
+
+        /// <summary>
+        /// Waits until fewer than <see cref="Parallelism"/> batches are in flight.  The batch is in flight until
+        /// the returned slot is disposed.
+        /// </summary>
+        public DownloadSlot AcquireDownloadSlot()
+        {
+            lock (this.stateLock)
+            {
+                while (this.activeDownloads >= this.parallelism)
+                {
+                    Monitor.Wait(this.stateLock);
+                }
+
+                ++this.activeDownloads;
+                return new DownloadSlot(this, this.generation);
+            }
+        }
+
+        /// <summary>
+        /// Records the outcome of a batch downloaded in <paramref name="slot"/> and adjusts the limits.
+        /// </summary>
+        public void RecordBatch(ITracer tracer, DownloadSlot slot, int objectCount, TimeSpan elapsed, int attempts, bool succeeded)
+        {
+            lock (this.stateLock)
+            {
+                int oldBatchSize = this.batchSize;
+                int oldParallelism = this.parallelism;
+                string reason;
+                double throughput = 0;
+
+                if (!succeeded || attempts > 1)
+                {
+                    if (slot.Generation != this.generation)
+                    {
+                        // The limits were already decreased after this batch started
+                        return;
+                    }
+
+                    reason = succeeded ? "Retries" : "Failure";
+                    this.batchSize = Math.Max(this.minBatchSize, this.batchSize / 2);
+                    this.parallelism = Math.Max(1, this.parallelism / 2);
+                    ++this.generation;
+
+                    // Throughput measured before the decrease says nothing about the new limits
+                    this.StartNewWindow(previousThroughput: 0);
+                }
+                else if (this.targetBatchLatency != Timeout.InfiniteTimeSpan && elapsed > this.targetBatchLatency)
+                {
+                    if (slot.Generation != this.generation || this.batchSize == this.minBatchSize)
+                    {
+                        return;
+                    }
+
+                    reason = "Latency";
+                    this.batchSize = Math.Max(this.minBatchSize, this.batchSize / 2);
+                    ++this.generation;
+                    this.StartNewWindow(this.previousThroughput);
+                }
+                else
+                {
+                    ++this.windowBatches;
+                    this.windowObjects += objectCount;
+                    this.windowElapsed += elapsed;
+                    if (this.windowBatches < this.parallelism)
+                    {
+                        return;
+                    }
+
+                    // Objects per second of each batch, times the number of batches in flight
+                    throughput = this.windowElapsed > TimeSpan.Zero
+                        ? this.windowObjects / this.windowElapsed.TotalSeconds * this.parallelism
+                        : 0;
+
+                    if (this.previousThroughput > 0 &&
+                        throughput < this.previousThroughput * MaxThroughputDrop)
+                    {
+                        reason = "ThroughputDrop";
+                        this.parallelism = Math.Max(1, this.parallelism - 1);
+                    }
+                    else
+                    {
+                        reason = "Increase";
+                        this.batchSize = Math.Min(this.maxBatchSize, this.batchSize + this.batchSizeIncrement);
+                        this.parallelism = Math.Min(this.maxParallel, this.parallelism + 1);
+                    }
+
+                    this.StartNewWindow(throughput);
+                }
+
+                if (this.parallelism != oldParallelism)
+                {
+                    Monitor.PulseAll(this.stateLock);
+                }
+
+                if (this.batchSize != oldBatchSize || this.parallelism != oldParallelism)
+                {
+                    EventMetadata metadata = new EventMetadata();
+                    metadata.Add("CacheServerUrl", this.cacheServerUrl);
+                    metadata.Add("Reason", reason);
+                    metadata.Add("OldBatchSize", oldBatchSize);
+                    metadata.Add("NewBatchSize", this.batchSize);
+                    metadata.Add("OldParallelism", oldParallelism);
+                    metadata.Add("NewParallelism", this.parallelism);
+                    metadata.Add("BatchLatencyMs", (long)elapsed.TotalMilliseconds);
+                    metadata.Add("Attempts", attempts);
+                    metadata.Add("ObjectsPerSecond", (long)throughput);
+                    tracer.RelatedEvent(EventLevel.Informational, AdjustedEventName, metadata);
+                }
+            }
+        }
+
+        private void ReleaseDownloadSlot()
+        {
+            lock (this.stateLock)
+            {
+                --this.activeDownloads;
+                Monitor.PulseAll(this.stateLock);
+            }
+        }
+
+        private void StartNewWindow(double previousThroughput)
+        {
+            this.previousThroughput = previousThroughput;
+            this.windowBatches = 0;
+            this.windowObjects = 0;
+            this.windowElapsed = TimeSpan.Zero;
+        }
+
+        public sealed class DownloadSlot : IDisposable
+        {
+            private AdaptiveDownloadController controller;
+
+            internal DownloadSlot(AdaptiveDownloadController controller, int generation)
+            {
+                this.controller = controller;
+                this.Generation = generation;
+            }
+
+            internal int Generation { get; }
+
+            public void Dispose()
+            {
+                this.controller?.ReleaseDownloadSlot();
+                this.controller = null;
+            }
+        }
+    }
+}
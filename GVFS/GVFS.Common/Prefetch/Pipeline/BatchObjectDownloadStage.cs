@@ -6,6 +6,7 @@
 using System;
 using System.Collections.Concurrent;
 using System.Collections.Generic;
+using System.Diagnostics;
 using System.IO;
 using System.Linq;
 using System.Threading;
@@ -21,6 +22,7 @@ public class BatchObjectDownloadStage : PrefetchPipelineStage
         private const string DownloadAreaPath = "Download";
 
         private static readonly TimeSpan HeartBeatPeriod = TimeSpan.FromSeconds(20);
+        private static readonly TimeSpan MaxWaitForInteractiveWork = TimeSpan.FromSeconds(2);
 
         private readonly DownloadRequestAggregator downloadRequests;
 
@@ -33,6 +35,8 @@ public class BatchObjectDownloadStage : PrefetchPipelineStage
         private Timer heartbeat;
 
         private long bytesDownloaded = 0;
+        private int maxParallel;
+        private int chunkSize;
 
         public BatchObjectDownloadStage(
             int maxParallel,
@@ -47,12 +51,14 @@ public class BatchObjectDownloadStage : PrefetchPipelineStage
         {
             this.tracer = tracer.StartActivity(AreaPath, EventLevel.Informational, Keywords.Telemetry, metadata: null);
 
-            this.downloadRequests = new DownloadRequestAggregator(missingBlobs, chunkSize);
+            this.downloadRequests = new DownloadRequestAggregator(missingBlobs);
 
             this.enlistment = enlistment;
             this.objectRequestor = objectRequestor;
 
             this.gitObjects = gitObjects;
+            this.maxParallel = maxParallel;
+            this.chunkSize = chunkSize;
 
             this.AvailablePacks = new BlockingCollection<IndexPackRequest>();
             this.AvailableObjects = availableBlobs;
@@ -62,6 +68,19 @@ public class BatchObjectDownloadStage : PrefetchPipelineStage
 
         public BlockingCollection<string> AvailableObjects { get; }
 
+        /// <summary>
+        /// When set, each batch waits (for at most <see cref="MaxWaitForInteractiveWork"/>) for interactive
+        /// work in progress to finish before it is downloaded.
+        /// </summary>
+        public BackgroundWorkThrottle BackgroundWorkThrottle { get; set; }
+
+        /// <summary>
+        /// When set, the controller chooses the size of each batch and how many batches (up to the stage's
+        /// maxParallel) are downloaded at once.  Otherwise every batch has chunkSize objects and every
+        /// download thread is used.
+        /// </summary>
+        public AdaptiveDownloadController DownloadController { get; set; }
+
         protected override void DoBeforeWork()
         {
             this.heartbeat = new Timer(this.EmitHeartbeat, null, TimeSpan.Zero, HeartBeatPeriod);
@@ -70,41 +89,19 @@ protected override void DoBeforeWork()
 
         protected override void DoWork()
         {
-            BlobDownloadRequest request;
-            while (this.downloadRequests.TryTake(out request))
+            while (true)
             {
-                Interlocked.Increment(ref this.activeDownloadCount);
-
-                EventMetadata metadata = new EventMetadata();
-                metadata.Add("RequestId", request.RequestId);
-                metadata.Add("ActiveDownloads", this.activeDownloadCount);
-                metadata.Add("NumberOfObjects", request.ObjectIds.Count);
-
-                using (ITracer activity = this.tracer.StartActivity(DownloadAreaPath, EventLevel.Informational, Keywords.Telemetry, metadata))
+                // Take the batch before waiting for a slot, so that a thread waiting for blobs to be found
+                // does not hold a slot that another thread's batch could be downloaded in
+                BlobDownloadRequest request;
+                if (!this.downloadRequests.TryTake(this.DownloadController?.BatchSize ?? this.chunkSize, out request))
                 {
-                    try
-                    {
-                        HashSet<string> successfulDownloads = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
-                        RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.InvocationResult result = this.objectRequestor.TryDownloadObjects(
-                                () => request.ObjectIds.Except(successfulDownloads),
-                                onSuccess: (tryCount, response) => this.WriteObjectOrPack(request, tryCount, response, successfulDownloads),
-                                onFailure: RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.StandardErrorHandler(activity, request.RequestId, DownloadAreaPath),
-                                preferBatchedLooseObjects: true);
-
-                        if (!result.Succeeded)
-                        {
-                            this.HasFailures = true;
-                        }
+                    return;
+                }
 
-                        metadata.Add("Success", result.Succeeded);
-                        metadata.Add("AttemptNumber", result.Attempts);
-                        metadata["ActiveDownloads"] = this.activeDownloadCount - 1;
-                        activity.Stop(metadata);
-                    }
-                    finally
-                    {
-                        Interlocked.Decrement(ref this.activeDownloadCount);
-                    }
+                using (AdaptiveDownloadController.DownloadSlot slot = this.DownloadController?.AcquireDownloadSlot())
+                {
+                    this.DownloadBatch(request, slot);
                 }
             }
         }
@@ -121,11 +118,55 @@ protected override void DoAfterWork()
             this.tracer.Stop(metadata);
         }
 
+        private void DownloadBatch(BlobDownloadRequest request, AdaptiveDownloadController.DownloadSlot slot)
+        {
+            this.BackgroundWorkThrottle?.WaitForInteractiveWork(MaxWaitForInteractiveWork);
+
+            Interlocked.Increment(ref this.activeDownloadCount);
+
+            EventMetadata metadata = new EventMetadata();
+            metadata.Add("RequestId", request.RequestId);
+            metadata.Add("ActiveDownloads", this.activeDownloadCount);
+            metadata.Add("NumberOfObjects", request.ObjectIds.Count);
+
+            using (ITracer activity = this.tracer.StartActivity(DownloadAreaPath, EventLevel.Informational, Keywords.Telemetry, metadata))
+            {
+                try
+                {
+                    Stopwatch stopwatch = Stopwatch.StartNew();
+                    // A retry only requests the objects that earlier attempts did not write
+                    ResumableObjectDownload download = new ResumableObjectDownload(request.ObjectIds);
+                    RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.InvocationResult result = this.objectRequestor.TryDownloadObjects(
+                            download.GetRemainingObjectIds,
+                            onSuccess: (tryCount, response) => this.WriteObjectOrPack(request, tryCount, response, download),
+                            onFailure: RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.StandardErrorHandler(activity, request.RequestId, DownloadAreaPath),
+                            preferBatchedLooseObjects: true);
+
+                    this.DownloadController?.RecordBatch(activity, slot, request.ObjectIds.Count, stopwatch.Elapsed, result.Attempts, result.Succeeded);
+
+                    if (!result.Succeeded)
+                    {
+                        this.HasFailures = true;
+                    }
+
+                    metadata.Add("Success", result.Succeeded);
+                    metadata.Add("AttemptNumber", result.Attempts);
+                    metadata.Add("PersistedObjects", download.PersistedCount);
+                    metadata["ActiveDownloads"] = this.activeDownloadCount - 1;
+                    activity.Stop(metadata);
+                }
+                finally
+                {
+                    Interlocked.Decrement(ref this.activeDownloadCount);
+                }
+            }
+        }
+
         private RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.CallbackResult WriteObjectOrPack(
             BlobDownloadRequest request,
             int tryCount,
             GitEndPointResponseData response,
-            HashSet<string> successfulDownloads = null)
+            ResumableObjectDownload download)
         {
             // To reduce allocations, reuse the same buffer when writing objects in this batch
             byte[] bufToCopyWith = new byte[StreamUtil.DefaultCopyBufferSize];
@@ -134,32 +175,32 @@ protected override void DoAfterWork()
             switch (response.ContentType)
             {
                 case GitObjectContentType.LooseObject:
-                    string sha = request.ObjectIds.First();
+                    // On a retry this is the one object an earlier attempt did not write, not necessarily the first
+                    string sha = download.GetRemainingObjectIds().First();
                     fileName = this.gitObjects.WriteLooseObject(
                         response.Stream,
                         sha,
                         overwriteExistingObject: false,
                         bufToCopyWith: bufToCopyWith);
                     this.AvailableObjects.Add(sha);
+                    download.MarkPersisted(sha);
                     break;
                 case GitObjectContentType.PackFile:
                     fileName = this.gitObjects.WriteTempPackFile(response.Stream);
                     this.AvailablePacks.Add(new IndexPackRequest(fileName, request));
                     break;
                 case GitObjectContentType.BatchedLooseObjects:
+                    // The objects are written in parallel by the deserializer's workers, each needs its own buffer
+                    ThreadLocal<byte[]> workerBuffers = new ThreadLocal<byte[]>(() => new byte[StreamUtil.DefaultCopyBufferSize]);
                     BatchedLooseObjectDeserializer.OnLooseObject onLooseObject = (objectStream, sha1) =>
                     {
                         this.gitObjects.WriteLooseObject(
                             objectStream,
                             sha1,
                             overwriteExistingObject: false,
-                            bufToCopyWith: bufToCopyWith);
+                            bufToCopyWith: workerBuffers.Value);
                         this.AvailableObjects.Add(sha1);
-
-                        if (successfulDownloads != null)
-                        {
-                            successfulDownloads.Add(sha1);
-                        }
+                        download.MarkPersisted(sha1);
 
                         // This isn't strictly correct because we don't add object header bytes,
                         // just the actual compressed content length, but we expect the amount of
@@ -167,7 +208,24 @@ protected override void DoAfterWork()
                         Interlocked.Add(ref this.bytesDownloaded, objectStream.Length);
                     };
 
-                    new BatchedLooseObjectDeserializer(response.Stream, onLooseObject).ProcessObjects();
+                    // Every download thread runs its own deserializer, split the cores between them
+                    using (workerBuffers)
+                    {
+                        int workerCount = BatchedLooseObjectDeserializer.GetDefaultWorkerCount(concurrentStreams: this.maxParallel);
+                        try
+                        {
+                            new BatchedLooseObjectDeserializer(response.Stream, onLooseObject, workerCount).ProcessObjects();
+                        }
+                        catch (Exception e) when (download.IsComplete)
+                        {
+                            // Every object was written before the response broke, there is nothing left to retry
+                            EventMetadata metadata = new EventMetadata();
+                            metadata.Add("RequestId", request.RequestId);
+                            metadata.Add("Exception", e.ToString());
+                            this.tracer.RelatedWarning(metadata, "Ignoring error after all objects in the batch were written", Keywords.Network);
+                        }
+                    }
+
                     break;
             }
 
@@ -201,19 +259,17 @@ private void EmitHeartbeat(object state)
         private class DownloadRequestAggregator
         {
             private BlockingCollection<string> missingBlobs;
-            private int chunkSize;
 
-            public DownloadRequestAggregator(BlockingCollection<string> missingBlobs, int chunkSize)
+            public DownloadRequestAggregator(BlockingCollection<string> missingBlobs)
             {
                 this.missingBlobs = missingBlobs;
-                this.chunkSize = chunkSize;
             }
 
-            public bool TryTake(out BlobDownloadRequest request)
+            public bool TryTake(int chunkSize, out BlobDownloadRequest request)
             {
                 List<string> blobsInChunk = new List<string>();
 
-                for (int i = 0; i < this.chunkSize;)
+                for (int i = 0; i < chunkSize;)
                 {
                     // Only wait a short while for new work to show up, otherwise go ahead and download what we have accumulated so far
                     const int TimeoutMs = 100;
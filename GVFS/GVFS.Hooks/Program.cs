@@ -198,11 +198,13 @@ private static void TryDisplayCachedHydrationStatus()
                             return null;
                         }
 
-                        pipeClient.SendRequest(new NamedPipeMessages.Message(NamedPipeMessages.HydrationStatus.Request, null));
-                        NamedPipeMessages.Message response = pipeClient.ReadResponse();
+                        pipeClient.SendBinaryRequest(NamedPipeMessages.Binary.ResultMessage.HydrationStatusRequest);
+                        NamedPipeFrame response = pipeClient.ReadResponseFrame();
 
-                        if (response.Header == NamedPipeMessages.HydrationStatus.SuccessResult
-                            && NamedPipeMessages.HydrationStatus.Response.TryParse(response.Body, out NamedPipeMessages.HydrationStatus.Response status))
+                        // A text response is a MountNotReady or UnknownRequest, neither of which has a status
+                        NamedPipeMessages.HydrationStatus.Response status;
+                        if (response.IsBinary
+                            && NamedPipeMessages.HydrationStatus.Response.TryReadBinary(response.Binary.Span, out string _, out status))
                         {
                             return status.ToDisplayMessage();
                         }
@@ -9,6 +9,7 @@
 using GVFS.Common.Tracing;
 using GVFS.PlatformLoader;
 using GVFS.Virtualization;
+using GVFS.Virtualization.BlobSize;
 using GVFS.Virtualization.FileSystem;
 using System;
 using System.Collections.Generic;
@@ -65,9 +66,11 @@ public class InProcessMount
         // (early pipe start, HandleRequest Mounting guard, null-safe GetStatus) is unaffected.
         private bool reportMountProgress;
         private HeartbeatThread heartbeat;
+        private NamedPipeServer namedPipeServer;
         private ManualResetEvent unmountEvent;
 
         private readonly MissingTreeTracker missingTreeTracker;
+        private readonly BackgroundWorkThrottle backgroundWorkThrottle;
 
         // True if InProcessMount is calling git reset as part of processing
         // a folder dehydrate request
@@ -83,6 +86,7 @@ public InProcessMount(ITracer tracer, GVFSEnlistment enlistment, CacheServerInfo
             this.showDebugWindow = showDebugWindow;
             this.unmountEvent = new ManualResetEvent(false);
             this.missingTreeTracker = new MissingTreeTracker(tracer, TrackedTreeCapacity);
+            this.backgroundWorkThrottle = new BackgroundWorkThrottle();
         }
 
         private enum MountState
@@ -126,6 +130,26 @@ public void Mount(EventLevel verbosity, Keywords keywords)
             }
         }
 
+        /// <summary>
+        /// Requests that start bulk work are handled after any queued interactive request, and never take
+        /// more than half of the pipe server's handler threads.
+        /// </summary>
+        private static NamedPipeRequestPriority GetRequestPriority(string request)
+        {
+            // Called for every request before it is queued, so look at the header without parsing the request
+            switch (NamedPipeMessages.Message.GetHeader(request))
+            {
+                case NamedPipeMessages.PrefetchBlobs.RequestHeader:
+                case NamedPipeMessages.PrefetchCommits.Request:
+                case NamedPipeMessages.RunPostFetchJob.PostFetchJob:
+                case NamedPipeMessages.DehydrateFolders.Dehydrate:
+                    return NamedPipeRequestPriority.Background;
+
+                default:
+                    return NamedPipeRequestPriority.Interactive;
+            }
+        }
+
         private void MountWithLockAcquired(EventLevel verbosity, Keywords keywords)
         {
             // Start auth + config query immediately — these are network-bound and don't
@@ -258,6 +282,7 @@ private void MountWithLockAcquired(EventLevel verbosity, Keywords keywords)
             this.mountProgressMessage = "Authenticating and validating";
             using (NamedPipeServer pipeServer = this.StartNamedPipe())
             {
+                this.namedPipeServer = pipeServer;
                 this.tracer.RelatedEvent(
                     EventLevel.Informational,
                     $"{nameof(this.Mount)}_StartedNamedPipe",
@@ -619,7 +644,7 @@ private NamedPipeServer StartNamedPipe()
         {
             try
             {
-                return NamedPipeServer.StartNewServer(this.enlistment.NamedPipeName, this.tracer, this.HandleRequest);
+                return NamedPipeServer.StartNewServer(this.enlistment.NamedPipeName, this.tracer, this.HandleRequest, GetRequestPriority, this.HandleBinaryRequest);
             }
             catch (PipeNameLengthException)
             {
@@ -723,7 +748,12 @@ private void HandleRequest(ITracer tracer, string request, NamedPipeServer.Conne
                         break;
 
                     case NamedPipeMessages.DownloadObject.DownloadRequest:
-                        this.HandleDownloadObjectRequest(message, connection);
+                        // A git command is blocked on the download, bulk downloads wait for it to finish
+                        using (this.backgroundWorkThrottle.BeginInteractiveWork())
+                        {
+                            this.HandleDownloadObjectRequest(message, connection);
+                        }
+
                         break;
 
                     case NamedPipeMessages.ModifiedPaths.ListRequest:
@@ -779,7 +809,102 @@ private void HandleRequest(ITracer tracer, string request, NamedPipeServer.Conne
             }
         }
 
+        /// <summary>
+        /// Handles the binary encoding of the requests sent for every git command, see
+        /// <see cref="NamedPipeMessages.Binary"/>.  Each request is handled the same way as its text
+        /// equivalent in <see cref="HandleRequest"/>.
+        /// </summary>
+        private void HandleBinaryRequest(ITracer tracer, ReadOnlyMemory<byte> request, NamedPipeServer.Connection connection)
+        {
+            NamedPipeMessages.Binary.MessageType type = NamedPipeMessages.Binary.MessageType.Invalid;
+            try
+            {
+                BinaryMessageReader reader = new BinaryMessageReader(request.Span);
+                type = NamedPipeMessages.Binary.ReadHeader(ref reader, out byte _);
+
+                // Same guard as HandleRequest, the text response is understood by every binary client
+                if (type != NamedPipeMessages.Binary.MessageType.GetStatusRequest &&
+                    this.currentState == MountState.Mounting)
+                {
+                    connection.TrySendResponse(NamedPipeMessages.MountNotReadyResult);
+                    return;
+                }
+
+                switch (type)
+                {
+                    case NamedPipeMessages.Binary.MessageType.GetStatusRequest:
+                        connection.TrySendBinaryResponse(this.CreateGetStatusResponse());
+                        break;
+
+                    case NamedPipeMessages.Binary.MessageType.AcquireLockRequest:
+                        connection.TrySendBinaryResponse(this.CreateAcquireLockResponse(NamedPipeMessages.Binary.LockRequestMessage.ReadRequestData(ref reader)));
+                        break;
+
+                    case NamedPipeMessages.Binary.MessageType.ReleaseLockRequest:
+                        connection.TrySendBinaryResponse(this.ReleaseExternalLock(NamedPipeMessages.Binary.LockRequestMessage.ReadRequestData(ref reader)));
+                        break;
+
+                    case NamedPipeMessages.Binary.MessageType.HydrationStatusRequest:
+                        if (this.TryCreateHydrationStatusResponse(out NamedPipeMessages.HydrationStatus.Response hydrationResponse))
+                        {
+                            connection.TrySendBinaryResponse(hydrationResponse);
+                        }
+                        else
+                        {
+                            connection.TrySendBinaryResponse(
+                                new NamedPipeMessages.Binary.ResultMessage(
+                                    NamedPipeMessages.Binary.MessageType.HydrationStatusResponse,
+                                    NamedPipeMessages.HydrationStatus.NotAvailableResult));
+                        }
+
+                        break;
+
+                    default:
+                        EventMetadata metadata = new EventMetadata();
+                        metadata.Add("Area", "Mount");
+                        metadata.Add("MessageType", type.ToString());
+                        this.tracer.RelatedError(metadata, "HandleBinaryRequest: Unknown request");
+
+                        connection.TrySendResponse(NamedPipeMessages.UnknownRequest);
+                        break;
+                }
+            }
+            catch (InvalidDataException e)
+            {
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("Area", "Mount");
+                metadata.Add("MessageType", type.ToString());
+                metadata.Add("Exception", e.ToString());
+                this.tracer.RelatedError(metadata, "HandleBinaryRequest: Invalid request");
+
+                connection.TrySendResponse(NamedPipeMessages.UnknownRequest);
+            }
+            catch (Exception e) when (e is not OutOfMemoryException)
+            {
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("Area", "Mount");
+                metadata.Add("MessageType", type.ToString());
+                metadata.Add("Exception", e.ToString());
+                this.tracer.RelatedError(metadata, "HandleBinaryRequest: Unhandled exception in request handler");
+                throw;
+            }
+        }
+
         private void HandleGetHydrationStatusRequest(NamedPipeServer.Connection connection)
+        {
+            NamedPipeMessages.HydrationStatus.Response response;
+            if (!this.TryCreateHydrationStatusResponse(out response))
+            {
+                connection.TrySendResponse(
+                    new NamedPipeMessages.Message(NamedPipeMessages.HydrationStatus.NotAvailableResult, null));
+                return;
+            }
+
+            connection.TrySendResponse(
+                new NamedPipeMessages.Message(NamedPipeMessages.HydrationStatus.SuccessResult, response.ToBody()));
+        }
+
+        private bool TryCreateHydrationStatusResponse(out NamedPipeMessages.HydrationStatus.Response response)
         {
             EnlistmentHydrationSummary summary = this.fileSystemCallbacks?.GetCachedHydrationSummary();
             if (summary == null || !summary.IsValid)
@@ -788,12 +913,11 @@ private void HandleGetHydrationStatusRequest(NamedPipeServer.Connection connecti
                     $"{nameof(this.HandleGetHydrationStatusRequest)}: " +
                     (summary == null ? "No cached hydration summary available yet" : "Cached hydration summary is invalid"));
 
-                connection.TrySendResponse(
-                    new NamedPipeMessages.Message(NamedPipeMessages.HydrationStatus.NotAvailableResult, null));
-                return;
+                response = null;
+                return false;
             }
 
-            NamedPipeMessages.HydrationStatus.Response response = new NamedPipeMessages.HydrationStatus.Response
+            response = new NamedPipeMessages.HydrationStatus.Response
             {
                 PlaceholderFileCount = summary.PlaceholderFileCount,
                 PlaceholderFolderCount = summary.PlaceholderFolderCount,
@@ -803,8 +927,7 @@ private void HandleGetHydrationStatusRequest(NamedPipeServer.Connection connecti
                 TotalFolderCount = summary.TotalFolderCount,
             };
 
-            connection.TrySendResponse(
-                new NamedPipeMessages.Message(NamedPipeMessages.HydrationStatus.SuccessResult, response.ToBody()));
+            return true;
         }
 
         private void HandleDehydrateFolders(NamedPipeMessages.Message message, NamedPipeServer.Connection connection)
@@ -919,10 +1042,13 @@ private List<string> BackupFoldersWhileUnmounted(NamedPipeMessages.DehydrateFold
 
         private void HandleLockRequest(string messageBody, NamedPipeServer.Connection connection)
         {
-            NamedPipeMessages.AcquireLock.Response response;
-
             NamedPipeMessages.LockRequest request = new NamedPipeMessages.LockRequest(messageBody);
-            NamedPipeMessages.LockData requester = request.RequestData;
+            connection.TrySendResponse(this.CreateAcquireLockResponse(request.RequestData).CreateMessage());
+        }
+
+        private NamedPipeMessages.AcquireLock.Response CreateAcquireLockResponse(NamedPipeMessages.LockData requester)
+        {
+            NamedPipeMessages.AcquireLock.Response response;
             if (this.currentState == MountState.Unmounting)
             {
                 response = new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.UnmountInProgressResult);
@@ -970,7 +1096,7 @@ private void HandleLockRequest(string messageBody, NamedPipeServer.Connection co
                 }
             }
 
-            connection.TrySendResponse(response.CreateMessage());
+            return response;
         }
 
         private void HandleReleaseLockRequest(string messageBody, NamedPipeServer.Connection connection)
@@ -984,13 +1110,18 @@ private void HandleReleaseLockRequest(string messageBody, NamedPipeServer.Connec
                 Environment.Exit((int)ReturnCode.NullRequestData);
             }
 
-            NamedPipeMessages.ReleaseLock.Response response = this.fileSystemCallbacks.TryReleaseExternalLock(request.RequestData.PID);
+            connection.TrySendResponse(this.ReleaseExternalLock(request.RequestData).CreateMessage());
+        }
+
+        private NamedPipeMessages.ReleaseLock.Response ReleaseExternalLock(NamedPipeMessages.LockData requester)
+        {
+            NamedPipeMessages.ReleaseLock.Response response = this.fileSystemCallbacks.TryReleaseExternalLock(requester.PID);
             if (response.Result == NamedPipeMessages.ReleaseLock.SuccessResult)
             {
                 this.tracer.SetGitCommandSessionId(string.Empty);
             }
 
-            connection.TrySendResponse(response.CreateMessage());
+            return response;
         }
 
         private void HandlePostIndexChangedRequest(NamedPipeMessages.Message message, NamedPipeServer.Connection connection)
@@ -1158,6 +1289,10 @@ private NamedPipeMessages.DownloadObject.Response DownloadObject(string objectSh
                 // FUTURE: Should the stats be updated to reflect all the trees in the pack?
                 // FUTURE: Should we try to clean up duplicate trees or increase depth of the commit download?
             }
+            else if (this.TryDownloadTreeWithPredictedTrees(objectSha))
+            {
+                response = new NamedPipeMessages.DownloadObject.Response(NamedPipeMessages.DownloadObject.SuccessResult);
+            }
             else if (this.gitObjects.TryDownloadAndSaveObject(objectSha, GVFSGitObjects.RequestSource.NamedPipeMessage) == GitObjects.DownloadAndSaveObjectResult.Success)
             {
                 this.UpdateTreesForDownloadedCommits(objectSha);
@@ -1210,6 +1345,45 @@ private bool ShouldDownloadCommitPack(string objectSha, out string commitSha)
             return missingTreeCount > MissingTreeThresholdForDownloadingCommitPack;
         }
 
+        private bool TryDownloadTreeWithPredictedTrees(string objectSha)
+        {
+            /* Below the commit pack threshold every missing tree is a round trip. When the requests for a
+             * commit's trees look like a walk of the whole commit, download the siblings that the walk will
+             * request next in the same request as the tree that was asked for.
+             */
+            if (!this.missingTreeTracker.TryGetPredictedTrees(objectSha, out string[] predictedTrees))
+            {
+                return false;
+            }
+
+            List<string> treesToDownload = new List<string>(predictedTrees.Length + 1) { objectSha };
+            treesToDownload.AddRange(predictedTrees.Where(treeSha => !this.context.Repository.ObjectExists(treeSha)));
+            if (treesToDownload.Count == 1)
+            {
+                return false;
+            }
+
+            Stopwatch downloadTime = Stopwatch.StartNew();
+            if (!this.gitObjects.TryDownloadObjects(treesToDownload, preferLooseObjects: true))
+            {
+                return false;
+            }
+
+            foreach (string treeSha in treesToDownload)
+            {
+                this.UpdateTreesForDownloadedCommits(treeSha);
+            }
+
+            EventMetadata metadata = new EventMetadata();
+            metadata.Add("Area", "Mount");
+            metadata.Add("objectSha", objectSha);
+            metadata.Add("PredictedTreesDownloaded", treesToDownload.Count - 1);
+            metadata.Add("DownloadTimeMs", downloadTime.ElapsedMilliseconds);
+            this.tracer.RelatedEvent(EventLevel.Informational, nameof(this.TryDownloadTreeWithPredictedTrees), metadata);
+
+            return true;
+        }
+
         private void UpdateTreesForDownloadedCommits(string objectSha)
         {
             /* If we are downloading missing trees, we probably are missing more trees for the commit.
@@ -1388,6 +1562,7 @@ private void HandlePrefetchBlobsRequest(NamedPipeMessages.Message message, Named
                         searchThreadCount: maxThreads,
                         downloadThreadCount: downloadThreads,
                         indexThreadCount: maxThreads);
+                    blobPrefetcher.BackgroundWorkThrottle = this.backgroundWorkThrottle;
 
                     int matchedBlobCount;
                     int downloadedBlobCount;
@@ -1433,6 +1608,11 @@ private void HandlePrefetchBlobsRequest(NamedPipeMessages.Message message, Named
         }
 
         private void HandleGetStatusRequest(NamedPipeServer.Connection connection)
+        {
+            connection.TrySendResponse(this.CreateGetStatusResponse().ToJson());
+        }
+
+        private NamedPipeMessages.GetStatus.Response CreateGetStatusResponse()
         {
             NamedPipeMessages.GetStatus.Response response = new NamedPipeMessages.GetStatus.Response();
             response.EnlistmentRoot = this.enlistment.WorkingDirectoryRoot;
@@ -1471,7 +1651,7 @@ private void HandleGetStatusRequest(NamedPipeServer.Connection connection)
                     break;
             }
 
-            connection.TrySendResponse(response.ToJson());
+            return response;
         }
 
         private void HandleUnmountRequest(NamedPipeServer.Connection connection)
@@ -1508,12 +1688,132 @@ private void HandleUnmountRequest(NamedPipeServer.Connection connection)
             }
         }
 
+        /// <summary>
+        /// Create a MemoryMappedBlobSizes when it has been enabled with gvfs.mmap-blob-sizes
+        /// </summary>
+        /// <returns>
+        /// The MemoryMappedBlobSizes, or null (to use the default SQLite BlobSizes) when it is not enabled
+        /// </returns>
+        private BlobSizes CreateMemoryMappedBlobSizesIfEnabled()
+        {
+            bool enabled = GVFSConstants.GitConfig.MemoryMappedBlobSizesDefault;
+            if (this.context.Repository.TryGetConfigValue(GVFSConstants.GitConfig.MemoryMappedBlobSizes, out string rawValue) &&
+                !string.IsNullOrWhiteSpace(rawValue) &&
+                !bool.TryParse(rawValue.Trim(), out enabled))
+            {
+                this.tracer.RelatedWarning($"{nameof(this.CreateMemoryMappedBlobSizesIfEnabled)}: could not parse {GVFSConstants.GitConfig.MemoryMappedBlobSizes} value '{rawValue}' as a bool");
+                enabled = GVFSConstants.GitConfig.MemoryMappedBlobSizesDefault;
+            }
+
+            if (!enabled)
+            {
+                return null;
+            }
+
+            this.tracer.RelatedInfo("Using memory mapped blob sizes");
+            return new MemoryMappedBlobSizes(
+                this.context.Enlistment.BlobSizesRoot,
+                Path.Combine(this.context.Enlistment.DotGVFSRoot, GVFSConstants.DotGVFS.Databases.BlobSizes),
+                this.context.FileSystem,
+                this.context.Tracer);
+        }
+
+        /// <summary>
+        /// Create a BlobContentCache when it has been given memory with gvfs.blob-content-cache-mb
+        /// </summary>
+        /// <returns>
+        /// The BlobContentCache, or null when it is not enabled
+        /// </returns>
+        private BlobContentCache CreateBlobContentCacheIfEnabled()
+        {
+            int sizeMB = GVFSConstants.GitConfig.BlobContentCacheSizeMBDefault;
+            if (this.context.Repository.TryGetConfigValue(GVFSConstants.GitConfig.BlobContentCacheSizeMB, out string rawValue) &&
+                !string.IsNullOrWhiteSpace(rawValue) &&
+                (!int.TryParse(rawValue.Trim(), out sizeMB) || sizeMB < 0))
+            {
+                this.tracer.RelatedWarning($"{nameof(this.CreateBlobContentCacheIfEnabled)}: could not parse {GVFSConstants.GitConfig.BlobContentCacheSizeMB} value '{rawValue}' as a non-negative int");
+                sizeMB = GVFSConstants.GitConfig.BlobContentCacheSizeMBDefault;
+            }
+
+            if (sizeMB == 0)
+            {
+                return null;
+            }
+
+            this.tracer.RelatedInfo("Using a blob content cache of {0} MB", sizeMB);
+            return new BlobContentCache(sizeMB * 1024L * 1024L, cacheFile: this.OpenBlobContentCacheFileIfEnabled());
+        }
+
+        /// <summary>
+        /// Open (or create) the enlistment's BlobContentCacheFile when gvfs.blob-content-cache-file-mb is not 0
+        /// </summary>
+        /// <returns>
+        /// The BlobContentCacheFile, or null when it is not enabled or cannot be opened
+        /// </returns>
+        private BlobContentCacheFile OpenBlobContentCacheFileIfEnabled()
+        {
+            int sizeMB = GVFSConstants.GitConfig.BlobContentCacheFileSizeMBDefault;
+            if (this.context.Repository.TryGetConfigValue(GVFSConstants.GitConfig.BlobContentCacheFileSizeMB, out string rawValue) &&
+                !string.IsNullOrWhiteSpace(rawValue) &&
+                (!int.TryParse(rawValue.Trim(), out sizeMB) || sizeMB < 0))
+            {
+                this.tracer.RelatedWarning($"{nameof(this.OpenBlobContentCacheFileIfEnabled)}: could not parse {GVFSConstants.GitConfig.BlobContentCacheFileSizeMB} value '{rawValue}' as a non-negative int");
+                sizeMB = GVFSConstants.GitConfig.BlobContentCacheFileSizeMBDefault;
+            }
+
+            string path = Path.Combine(this.context.Enlistment.DotGVFSRoot, GVFSConstants.DotGVFS.Databases.BlobContents);
+            if (sizeMB == 0)
+            {
+                this.context.FileSystem.TryDeleteFile(path);
+                return null;
+            }
+
+            long dataSize = sizeMB * 1024L * 1024L;
+            try
+            {
+                if (this.context.FileSystem.FileExists(path))
+                {
+                    try
+                    {
+                        BlobContentCacheFile cacheFile = BlobContentCacheFile.Open(path);
+                        if (cacheFile.DataSize == dataSize)
+                        {
+                            this.tracer.RelatedInfo("Opened blob content cache file with {0} blobs", cacheFile.Count);
+                            return cacheFile;
+                        }
+
+                        cacheFile.Dispose();
+                    }
+                    catch (InvalidDataException e)
+                    {
+                        EventMetadata metadata = new EventMetadata();
+                        metadata.Add("Exception", e.ToString());
+                        metadata.Add("path", path);
+                        this.tracer.RelatedWarning(metadata, $"{nameof(this.OpenBlobContentCacheFileIfEnabled)}: blob content cache file corrupt, recreating");
+                    }
+                }
+
+                this.tracer.RelatedInfo("Creating a blob content cache file of {0} MB", sizeMB);
+                return BlobContentCacheFile.Create(path, dataSize);
+            }
+            catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+            {
+                // The file is only a cache, keep the blobs in memory rather than failing the mount
+                EventMetadata metadata = new EventMetadata();
+                metadata.Add("Exception", e.ToString());
+                metadata.Add("path", path);
+                this.tracer.RelatedWarning(metadata, $"{nameof(this.OpenBlobContentCacheFileIfEnabled)}: could not open blob content cache file");
+                return null;
+            }
+        }
+
         private void MountAndStartWorkingDirectoryCallbacks(CacheServerInfo cache, bool alreadyInitialized = false)
         {
             string error;
 
             GitObjectsHttpRequestor objectRequestor = new GitObjectsHttpRequestor(this.context.Tracer, this.context.Enlistment, cache, this.retryConfig);
             this.gitObjects = new GVFSGitObjects(this.context, objectRequestor);
+            this.gitObjects.BlobContentCache = this.CreateBlobContentCacheIfEnabled();
             FileSystemVirtualizer virtualizer = this.CreateOrReportAndExit(() => GVFSPlatformLoader.CreateFileSystemVirtualizer(this.context, this.gitObjects), "Failed to create src folder virtualizer");
 
             GitStatusCache gitStatusCache = (!this.context.Unattended && GVFSPlatform.Instance.IsGitStatusCacheSupported()) ? new GitStatusCache(this.context, this.gitStatusCacheConfig) : null;
@@ -1534,7 +1834,7 @@ private void MountAndStartWorkingDirectoryCallbacks(CacheServerInfo cache, bool
                         this.context,
                         this.gitObjects,
                         RepoMetadata.Instance,
-                        blobSizes: null,
+                        blobSizes: this.CreateMemoryMappedBlobSizesIfEnabled(),
                         gitIndexProjection: null,
                         backgroundFileSystemTaskRunner: null,
                         fileSystemVirtualizer: virtualizer,
@@ -1542,7 +1842,7 @@ private void MountAndStartWorkingDirectoryCallbacks(CacheServerInfo cache, bool
                         sparseCollection: new SparseTable(this.gvfsDatabase),
                         gitStatusCache: gitStatusCache);
                 }, "Failed to create src folder callback listener");
-            this.maintenanceScheduler = this.CreateOrReportAndExit(() => new GitMaintenanceScheduler(this.context, this.gitObjects), "Failed to start maintenance scheduler");
+            this.maintenanceScheduler = this.CreateOrReportAndExit(() => new GitMaintenanceScheduler(this.context, this.gitObjects, this.backgroundWorkThrottle), "Failed to start maintenance scheduler");
 
             if (!alreadyInitialized)
             {
@@ -1574,7 +1874,7 @@ private void MountAndStartWorkingDirectoryCallbacks(CacheServerInfo cache, bool
                 this.FailMountAndExit("Failed to initialize src folder callbacks. {0}", e.ToString());
             }
 
-            this.heartbeat = new HeartbeatThread(this.tracer, this.fileSystemCallbacks);
+            this.heartbeat = new HeartbeatThread(this.tracer, this.fileSystemCallbacks, this.namedPipeServer, this.backgroundWorkThrottle, this.gitObjects.BlobContentCache);
             this.heartbeat.Start();
         }
 
@@ -1995,6 +2295,12 @@ private void UnmountAndStopWorkingDirectoryCallbacks(bool willRemountInSameProce
                 this.fileSystemCallbacks = null;
             }
 
+            if (this.gitObjects?.BlobContentCache != null)
+            {
+                this.gitObjects.BlobContentCache.Dispose();
+                this.gitObjects.BlobContentCache = null;
+            }
+
             this.gvfsDatabase?.Dispose();
             this.gvfsDatabase = null;
 
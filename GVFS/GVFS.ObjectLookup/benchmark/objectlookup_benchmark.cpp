@@ -0,0 +1,499 @@
+// Benchmark of GVFS.ObjectLookup against the search used by the managed
+// MidxReader and PackIndexReader (GVFS.Common\Git).
+//
+// The managed readers only run on Windows, so ReferenceIndex below is a port of
+// their algorithm: fanout lookup followed by a binary search that compares the
+// ids one byte at a time through a bounds checked accessor, the same as
+// MemoryMappedViewAccessor.ReadByte.  It does not pay the managed call and
+// accessor overheads, so the speedups reported here are a lower bound.  The
+// LookupPackIndexes test in GVFS.PerfProfiling measures the real managed readers.
+//
+// The benchmark writes a MIDX and a number of supplemental pack indexes with
+// random object ids to a temporary folder, then looks up a mix of ids that are in
+// the MIDX, in the last supplemental index, and in neither.  Every index is probed
+// in order (MIDX first) the same way PackIndexObjectExistenceChecker does.
+//
+// Build and run on Linux with:
+//     make -C GVFS/GVFS.ObjectLookup/benchmark run
+
+#include "objectlookup.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    struct Oid
+    {
+        uint8_t bytes[GVFS_OID_LENGTH];
+
+        bool operator<(const Oid& other) const
+        {
+            return memcmp(this->bytes, other.bytes, GVFS_OID_LENGTH) < 0;
+        }
+
+        bool operator==(const Oid& other) const
+        {
+            return memcmp(this->bytes, other.bytes, GVFS_OID_LENGTH) == 0;
+        }
+    };
+
+    // splitmix64, deterministic so that runs are comparable
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) : state(seed)
+        {
+        }
+
+        uint64_t Next()
+        {
+            uint64_t z = (this->state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        Oid NextOid()
+        {
+            Oid oid;
+            uint64_t parts[3] = { this->Next(), this->Next(), this->Next() };
+            memcpy(oid.bytes, parts, GVFS_OID_LENGTH);
+            return oid;
+        }
+
+    private:
+        uint64_t state;
+    };
+
+    void AppendUInt32BE(std::vector<uint8_t>& buffer, uint32_t value)
+    {
+        buffer.push_back(static_cast<uint8_t>(value >> 24));
+        buffer.push_back(static_cast<uint8_t>(value >> 16));
+        buffer.push_back(static_cast<uint8_t>(value >> 8));
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    void AppendUInt64BE(std::vector<uint8_t>& buffer, uint64_t value)
+    {
+        AppendUInt32BE(buffer, static_cast<uint32_t>(value >> 32));
+        AppendUInt32BE(buffer, static_cast<uint32_t>(value));
+    }
+
+    void AppendFanout(std::vector<uint8_t>& buffer, const std::vector<Oid>& sortedOids)
+    {
+        size_t position = 0;
+        for (int i = 0; i < 256; ++i)
+        {
+            while (position < sortedOids.size() && sortedOids[position].bytes[0] <= i)
+            {
+                ++position;
+            }
+
+            AppendUInt32BE(buffer, static_cast<uint32_t>(position));
+        }
+    }
+
+    void WriteFile(const std::string& path, const std::vector<uint8_t>& contents)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr || fwrite(contents.data(), 1, contents.size(), file) != contents.size())
+        {
+            throw std::runtime_error("Failed to write " + path);
+        }
+
+        fclose(file);
+    }
+
+    void WritePackIndex(const std::string& path, const std::vector<Oid>& sortedOids)
+    {
+        std::vector<uint8_t> contents = { 0xFF, 0x74, 0x4F, 0x63, 0, 0, 0, 2 };
+        AppendFanout(contents, sortedOids);
+        for (const Oid& oid : sortedOids)
+        {
+            contents.insert(contents.end(), oid.bytes, oid.bytes + GVFS_OID_LENGTH);
+        }
+
+        // CRC32s and offsets are not read by the lookups, then the two trailing checksums
+        contents.resize(contents.size() + (sortedOids.size() * 8) + (2 * GVFS_OID_LENGTH));
+        WriteFile(path, contents);
+    }
+
+    void WriteMidx(const std::string& path, const std::vector<Oid>& sortedOids)
+    {
+        const uint32_t chunkCount = 4;
+        const std::string packNames("pack-benchmark.idx\0\0\0\0", 20);
+
+        uint64_t pnamOffset = 12 + ((chunkCount + 1) * 12);
+        uint64_t oidfOffset = pnamOffset + packNames.size();
+        uint64_t oidlOffset = oidfOffset + (256 * 4);
+        uint64_t ooffOffset = oidlOffset + (sortedOids.size() * GVFS_OID_LENGTH);
+        uint64_t endOffset = ooffOffset + (sortedOids.size() * 8);
+
+        std::vector<uint8_t> contents = { 'M', 'I', 'D', 'X', 1, 1, static_cast<uint8_t>(chunkCount), 0 };
+        AppendUInt32BE(contents, 1);
+
+        const uint32_t chunkIds[chunkCount] = { 0x504E414D, 0x4F494446, 0x4F49444C, 0x4F4F4646 };
+        const uint64_t chunkOffsets[chunkCount + 1] = { pnamOffset, oidfOffset, oidlOffset, ooffOffset, endOffset };
+        for (uint32_t i = 0; i <= chunkCount; ++i)
+        {
+            AppendUInt32BE(contents, i < chunkCount ? chunkIds[i] : 0);
+            AppendUInt64BE(contents, chunkOffsets[i]);
+        }
+
+        contents.insert(contents.end(), packNames.begin(), packNames.end());
+        AppendFanout(contents, sortedOids);
+        for (const Oid& oid : sortedOids)
+        {
+            contents.insert(contents.end(), oid.bytes, oid.bytes + GVFS_OID_LENGTH);
+        }
+
+        contents.resize(contents.size() + (sortedOids.size() * 8) + GVFS_OID_LENGTH);
+        WriteFile(path, contents);
+    }
+
+    std::vector<uint8_t> ReadFile(const std::string& path)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+
+        std::vector<uint8_t> contents;
+        uint8_t buffer[1 << 16];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            contents.insert(contents.end(), buffer, buffer + read);
+        }
+
+        fclose(file);
+        return contents;
+    }
+
+    // Port of MidxReader/PackIndexReader.FindOidIndex and BinarySearchOid
+    class ReferenceIndex
+    {
+    public:
+        ReferenceIndex(const std::string& path, bool isMidx)
+            : contents(ReadFile(path))
+        {
+            if (isMidx)
+            {
+                // Chunk order is fixed by WriteMidx: PNAM, OIDF, OIDL
+                this->fanoutOffset = this->ReadUInt64BE(12 + 12 + 4);
+                this->oidLookupOffset = this->ReadUInt64BE(12 + 24 + 4);
+            }
+            else
+            {
+                this->fanoutOffset = 8;
+                this->oidLookupOffset = 8 + (256 * 4);
+            }
+        }
+
+        bool Exists(const uint8_t* oid) const
+        {
+            int firstByte = oid[0];
+            uint32_t lo = firstByte == 0 ? 0 : this->ReadUInt32BE(this->fanoutOffset + ((firstByte - 1) * 4));
+            uint32_t hi = this->ReadUInt32BE(this->fanoutOffset + (firstByte * 4));
+            if (lo >= hi)
+            {
+                return false;
+            }
+
+            int64_t low = lo;
+            int64_t high = static_cast<int64_t>(hi) - 1;
+            while (low <= high)
+            {
+                int64_t mid = low + ((high - low) / 2);
+                int cmp = this->CompareOidAtOffset(oid, this->oidLookupOffset + (mid * GVFS_OID_LENGTH));
+                if (cmp == 0)
+                {
+                    return true;
+                }
+                else if (cmp < 0)
+                {
+                    high = mid - 1;
+                }
+                else
+                {
+                    low = mid + 1;
+                }
+            }
+
+            return false;
+        }
+
+    private:
+        std::vector<uint8_t> contents;
+        uint64_t fanoutOffset;
+        uint64_t oidLookupOffset;
+
+        uint8_t ReadByte(uint64_t offset) const
+        {
+            // MemoryMappedViewAccessor.ReadByte validates every access
+            if (offset >= this->contents.size())
+            {
+                throw std::out_of_range("offset");
+            }
+
+            return this->contents[offset];
+        }
+
+        uint32_t ReadUInt32BE(uint64_t offset) const
+        {
+            return (static_cast<uint32_t>(this->ReadByte(offset)) << 24) |
+                (static_cast<uint32_t>(this->ReadByte(offset + 1)) << 16) |
+                (static_cast<uint32_t>(this->ReadByte(offset + 2)) << 8) |
+                this->ReadByte(offset + 3);
+        }
+
+        uint64_t ReadUInt64BE(uint64_t offset) const
+        {
+            return (static_cast<uint64_t>(this->ReadUInt32BE(offset)) << 32) | this->ReadUInt32BE(offset + 4);
+        }
+
+        int CompareOidAtOffset(const uint8_t* target, uint64_t offset) const
+        {
+            for (int i = 0; i < GVFS_OID_LENGTH; ++i)
+            {
+                int diff = target[i] - this->ReadByte(offset + i);
+                if (diff != 0)
+                {
+                    return diff;
+                }
+            }
+
+            return 0;
+        }
+    };
+
+    template <typename TLookup>
+    double BestNanosecondsPerLookup(int runs, size_t lookupCount, size_t expectedFound, TLookup lookup)
+    {
+        double best = 0;
+        for (int run = 0; run < runs; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            size_t found = lookup();
+            auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (found != expectedFound)
+            {
+                fprintf(stderr, "Found %zu objects, expected %zu\n", found, expectedFound);
+                exit(1);
+            }
+
+            double perLookup = elapsed / lookupCount;
+            if (run == 0 || perLookup < best)
+            {
+                best = perLookup;
+            }
+        }
+
+        return best;
+    }
+
+    size_t ParseCount(const char* value)
+    {
+        char* end;
+        unsigned long long count = strtoull(value, &end, 10);
+        if (*end != '\0' || count == 0)
+        {
+            fprintf(stderr, "Invalid count: %s\n", value);
+            exit(1);
+        }
+
+        return static_cast<size_t>(count);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 5)
+    {
+        fprintf(stderr, "Usage: %s [midxObjects] [supplementalIndexes] [objectsPerSupplementalIndex] [lookups]\n", argv[0]);
+        return 1;
+    }
+
+    size_t midxObjectCount = argc > 1 ? ParseCount(argv[1]) : 4000000;
+    size_t supplementalCount = argc > 2 ? ParseCount(argv[2]) : 24;
+    size_t supplementalObjectCount = argc > 3 ? ParseCount(argv[3]) : 20000;
+    size_t lookupCount = argc > 4 ? ParseCount(argv[4]) : 2000000;
+    const int runs = 5;
+
+    char folderTemplate[] = "/tmp/objectlookup_benchmark_XXXXXX";
+    if (mkdtemp(folderTemplate) == nullptr)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    std::string folder(folderTemplate);
+    std::vector<std::string> paths;
+    Random random(0x5EED);
+
+    std::vector<Oid> midxOids(midxObjectCount);
+    for (Oid& oid : midxOids)
+    {
+        oid = random.NextOid();
+    }
+
+    std::sort(midxOids.begin(), midxOids.end());
+    paths.push_back(folder + "/multi-pack-index");
+    WriteMidx(paths.back(), midxOids);
+
+    std::vector<Oid> lastSupplementalOids;
+    for (size_t i = 0; i < supplementalCount; ++i)
+    {
+        std::vector<Oid> oids(supplementalObjectCount);
+        for (Oid& oid : oids)
+        {
+            oid = random.NextOid();
+        }
+
+        std::sort(oids.begin(), oids.end());
+        paths.push_back(folder + "/pack-supplemental-" + std::to_string(i) + ".idx");
+        WritePackIndex(paths.back(), oids);
+        lastSupplementalOids = oids;
+    }
+
+    // Half of the lookups are for objects in the MIDX, a quarter are in the last
+    // supplemental index (so every index is probed) and a quarter are missing
+    std::vector<Oid> lookups(lookupCount);
+    size_t expectedFound = 0;
+    for (size_t i = 0; i < lookupCount; ++i)
+    {
+        switch (i % 4)
+        {
+        case 0:
+        case 1:
+            lookups[i] = midxOids[random.Next() % midxOids.size()];
+            ++expectedFound;
+            break;
+        case 2:
+            if (!lastSupplementalOids.empty())
+            {
+                lookups[i] = lastSupplementalOids[random.Next() % lastSupplementalOids.size()];
+                ++expectedFound;
+                break;
+            }
+
+            lookups[i] = random.NextOid();
+            break;
+        default:
+            lookups[i] = random.NextOid();
+            break;
+        }
+    }
+
+    std::vector<ReferenceIndex> referenceIndexes;
+    std::vector<ObjectIndex*> nativeIndexes;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        referenceIndexes.emplace_back(paths[i], i == 0);
+
+        ObjectIndex* index;
+        int result = ObjectIndex_Open(paths[i].c_str(), &index);
+        if (result != ObjectLookup_Success)
+        {
+            fprintf(stderr, "ObjectIndex_Open(%s) failed: %d\n", paths[i].c_str(), result);
+            return 1;
+        }
+
+        nativeIndexes.push_back(index);
+    }
+
+    printf(
+        "MIDX objects: %zu, supplemental indexes: %zu x %zu objects, lookups: %zu (best of %d runs)\n",
+        midxObjectCount,
+        supplementalCount,
+        supplementalObjectCount,
+        lookupCount,
+        runs);
+
+    double reference = BestNanosecondsPerLookup(runs, lookupCount, expectedFound, [&]()
+    {
+        size_t found = 0;
+        for (const Oid& oid : lookups)
+        {
+            for (const ReferenceIndex& index : referenceIndexes)
+            {
+                if (index.Exists(oid.bytes))
+                {
+                    ++found;
+                    break;
+                }
+            }
+        }
+
+        return found;
+    });
+
+    double exists = BestNanosecondsPerLookup(runs, lookupCount, expectedFound, [&]()
+    {
+        size_t found = 0;
+        for (const Oid& oid : lookups)
+        {
+            for (const ObjectIndex* index : nativeIndexes)
+            {
+                if (ObjectIndex_Exists(index, oid.bytes))
+                {
+                    ++found;
+                    break;
+                }
+            }
+        }
+
+        return found;
+    });
+
+    double existsInAny = BestNanosecondsPerLookup(runs, lookupCount, expectedFound, [&]()
+    {
+        size_t found = 0;
+        for (const Oid& oid : lookups)
+        {
+            found += ObjectIndex_ExistsInAny(nativeIndexes.data(), nativeIndexes.size(), oid.bytes);
+        }
+
+        return found;
+    });
+
+    std::vector<uint8_t> results(lookupCount);
+    double existsMany = BestNanosecondsPerLookup(runs, lookupCount, expectedFound, [&]()
+    {
+        return ObjectIndex_ExistsMany(
+            nativeIndexes.data(),
+            nativeIndexes.size(),
+            lookups[0].bytes,
+            lookups.size(),
+            results.data());
+    });
+
+    printf("%-36s %8.1f ns/lookup\n", "Managed reader algorithm (port)", reference);
+    printf("%-36s %8.1f ns/lookup  %5.2fx\n", "ObjectIndex_Exists", exists, reference / exists);
+    printf("%-36s %8.1f ns/lookup  %5.2fx\n", "ObjectIndex_ExistsInAny", existsInAny, reference / existsInAny);
+    printf("%-36s %8.1f ns/lookup  %5.2fx\n", "ObjectIndex_ExistsMany", existsMany, reference / existsMany);
+
+    for (ObjectIndex* index : nativeIndexes)
+    {
+        ObjectIndex_Close(index);
+    }
+
+    for (const std::string& path : paths)
+    {
+        unlink(path.c_str());
+    }
+
+    rmdir(folder.c_str());
+    return 0;
+}
@@ -0,0 +1,654 @@
+// GVFS.ObjectLookup
+//
+// Existence checks of object ids against the OID tables of pack .idx (version 2)
+// and multi-pack-index files.  Both formats store a 256 entry fanout table followed
+// by the sorted 20 byte object ids, so a single search routine serves both.
+//
+// Object ids are SHA-1 hashes and so are uniformly distributed, which means the
+// position of an id within its fanout bucket can be estimated from its value.
+// Lookups interpolate on the first 8 bytes of the id (a couple of probes is
+// usually enough to land within a few entries of the target), fall back to a
+// binary search if the estimates do not converge, and finish with a linear scan
+// that compares the first 16 bytes of the id with a single 128-bit compare.
+
+#include "stdafx.h"
+#include "objectlookup.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#define OBJECTLOOKUP_SSE2
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#include <arm_neon.h>
+#define OBJECTLOOKUP_NEON
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error GVFS.ObjectLookup assumes a little-endian platform
+#endif
+
+struct ObjectIndex
+{
+    const uint8_t* mapping;
+    uint64_t mappingLength;
+
+    // 256 big-endian cumulative object counts, entry N is the number of objects
+    // whose first byte is less than or equal to N
+    const uint8_t* fanout;
+
+    // objectCount sorted object ids, GVFS_OID_LENGTH bytes each
+    const uint8_t* oids;
+    uint32_t objectCount;
+};
+
+namespace
+{
+    const uint32_t PackIndexSignature = 0xFF744F63; // "\377tOc"
+    const uint32_t PackIndexVersion = 2;
+    const uint32_t MidxSignature = 0x4D494458; // "MIDX"
+    const uint8_t MidxVersion = 1;
+    const uint8_t MidxSha1OidVersion = 1;
+    const uint32_t ChunkIdOIDF = 0x4F494446; // OID Fanout
+    const uint32_t ChunkIdOIDL = 0x4F49444C; // OID Lookup
+
+    const uint64_t PackIndexHeaderSize = 8;
+    const uint64_t MidxHeaderSize = 12;
+    const uint64_t ChunkTocEntrySize = 12;
+    const uint64_t FanoutSize = 256 * 4;
+
+    // Per object: OID, CRC32 and 4 byte offset.  Followed by the pack and index checksums.
+    const uint64_t PackIndexBytesPerObject = GVFS_OID_LENGTH + 4 + 4;
+    const uint64_t PackIndexTrailerSize = 2 * GVFS_OID_LENGTH;
+
+    // Ranges this small are scanned linearly, the entries share a handful of cache
+    // lines and a sequential scan avoids the unpredictable branches of a bisection
+    const uint32_t LinearScanThreshold = 8;
+
+    // Interpolation converges in a couple of probes for uniformly distributed object
+    // ids, this only bounds the cost of an index with a pathological distribution
+    const int MaxInterpolationProbes = 4;
+
+    // How many lookups ahead ObjectIndex_ExistsMany prefetches the first probe of, and
+    // how many entries either side of that probe are prefetched
+    const size_t PrefetchDistance = 8;
+    const uint32_t PrefetchWindow = 4;
+
+    // ObjectIndex_ExistsMany works through the ids in batches of this size, searching
+    // every index for the ids of the batch that have not been found yet
+    const size_t ExistsManyBatchSize = 256;
+
+    inline uint32_t ByteSwap32(uint32_t value)
+    {
+#ifdef _MSC_VER
+        return _byteswap_ulong(value);
+#else
+        return __builtin_bswap32(value);
+#endif
+    }
+
+    inline uint64_t ByteSwap64(uint64_t value)
+    {
+#ifdef _MSC_VER
+        return _byteswap_uint64(value);
+#else
+        return __builtin_bswap64(value);
+#endif
+    }
+
+    inline uint32_t ReadUInt32BE(const uint8_t* buffer)
+    {
+        uint32_t value;
+        memcpy(&value, buffer, sizeof(value));
+        return ByteSwap32(value);
+    }
+
+    inline uint64_t ReadUInt64BE(const uint8_t* buffer)
+    {
+        uint64_t value;
+        memcpy(&value, buffer, sizeof(value));
+        return ByteSwap64(value);
+    }
+
+    inline void Prefetch(const void* address)
+    {
+#if defined(OBJECTLOOKUP_SSE2)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+        __prefetch(address);
+#elif defined(__GNUC__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+
+    // Compares the first 16 bytes of the ids with one 128-bit compare and the
+    // remaining 4 bytes with a 32-bit compare
+    inline bool OidEquals(const uint8_t* left, const uint8_t* right)
+    {
+#if defined(OBJECTLOOKUP_SSE2)
+        __m128i leftHead = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left));
+        __m128i rightHead = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(leftHead, rightHead)) != 0xFFFF)
+        {
+            return false;
+        }
+#elif defined(OBJECTLOOKUP_NEON)
+        uint8x16_t equal = vceqq_u8(vld1q_u8(left), vld1q_u8(right));
+        if (vminvq_u8(equal) != 0xFF)
+        {
+            return false;
+        }
+#else
+        if (memcmp(left, right, 16) != 0)
+        {
+            return false;
+        }
+#endif
+
+        uint32_t leftTail;
+        uint32_t rightTail;
+        memcpy(&leftTail, left + 16, sizeof(leftTail));
+        memcpy(&rightTail, right + 16, sizeof(rightTail));
+        return leftTail == rightTail;
+    }
+
+    // Full ordering of the ids, only needed when the first 8 bytes of the ids match
+    inline int CompareOids(const uint8_t* left, const uint8_t* right)
+    {
+        uint64_t leftMiddle = ReadUInt64BE(left + 8);
+        uint64_t rightMiddle = ReadUInt64BE(right + 8);
+        if (leftMiddle != rightMiddle)
+        {
+            return leftMiddle < rightMiddle ? -1 : 1;
+        }
+
+        uint32_t leftTail = ReadUInt32BE(left + 16);
+        uint32_t rightTail = ReadUInt32BE(right + 16);
+        if (leftTail != rightTail)
+        {
+            return leftTail < rightTail ? -1 : 1;
+        }
+
+        return 0;
+    }
+
+    inline void GetFanoutRange(const ObjectIndex* index, uint8_t firstByte, uint32_t* lo, uint32_t* hi)
+    {
+        *lo = firstByte == 0 ? 0 : ReadUInt32BE(index->fanout + ((firstByte - 1) * 4));
+        *hi = ReadUInt32BE(index->fanout + (firstByte * 4));
+    }
+
+    // Estimates the position of key in [lo, hi) assuming the keys of the range are
+    // spread evenly between lowKey and highKey
+    inline uint32_t Interpolate(uint64_t key, uint64_t lowKey, uint64_t highKey, uint32_t lo, uint32_t hi)
+    {
+        double fraction = static_cast<double>(key - lowKey) / (static_cast<double>(highKey - lowKey) + 1.0);
+        uint32_t position = lo + static_cast<uint32_t>(fraction * (hi - lo));
+        return position < hi ? position : hi - 1;
+    }
+
+    bool FindOid(const ObjectIndex* index, const uint8_t* oid)
+    {
+        uint32_t lo;
+        uint32_t hi;
+        GetFanoutRange(index, oid[0], &lo, &hi);
+
+        // Every id in the fanout bucket starts with oid[0], so these are the smallest
+        // and largest keys the bucket can hold.  They are narrowed to the keys of the
+        // entries at the ends of [lo, hi) as the range shrinks.
+        uint64_t key = ReadUInt64BE(oid);
+        uint64_t lowKey = static_cast<uint64_t>(oid[0]) << 56;
+        uint64_t highKey = lowKey | 0x00FFFFFFFFFFFFFFull;
+
+        int probes = 0;
+        while (hi - lo > LinearScanThreshold)
+        {
+            uint32_t middle = probes < MaxInterpolationProbes ?
+                Interpolate(key, lowKey, highKey, lo, hi) :
+                lo + ((hi - lo) / 2);
+            ++probes;
+
+            const uint8_t* entry = index->oids + (static_cast<uint64_t>(middle) * GVFS_OID_LENGTH);
+            uint64_t entryKey = ReadUInt64BE(entry);
+
+            int comparison;
+            if (key != entryKey)
+            {
+                comparison = key < entryKey ? -1 : 1;
+            }
+            else
+            {
+                comparison = CompareOids(oid, entry);
+                if (comparison == 0)
+                {
+                    return true;
+                }
+            }
+
+            if (comparison < 0)
+            {
+                hi = middle;
+                highKey = entryKey;
+            }
+            else
+            {
+                lo = middle + 1;
+                lowKey = entryKey;
+            }
+        }
+
+        const uint8_t* entry = index->oids + (static_cast<uint64_t>(lo) * GVFS_OID_LENGTH);
+        for (uint32_t i = lo; i < hi; ++i, entry += GVFS_OID_LENGTH)
+        {
+            uint64_t entryKey = ReadUInt64BE(entry);
+            if (entryKey > key)
+            {
+                return false;
+            }
+
+            if (entryKey == key && OidEquals(entry, oid))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Prefetches the entries around the first interpolation probe FindOid will make,
+    // the target is usually within a few entries of that estimate
+    inline void PrefetchFirstProbe(const ObjectIndex* index, const uint8_t* oid)
+    {
+        uint32_t lo;
+        uint32_t hi;
+        GetFanoutRange(index, oid[0], &lo, &hi);
+        if (hi > lo)
+        {
+            uint64_t lowKey = static_cast<uint64_t>(oid[0]) << 56;
+            uint32_t position = Interpolate(ReadUInt64BE(oid), lowKey, lowKey | 0x00FFFFFFFFFFFFFFull, lo, hi);
+            uint32_t first = position - lo > PrefetchWindow ? position - PrefetchWindow : lo;
+            uint32_t last = hi - position > PrefetchWindow ? position + PrefetchWindow : hi - 1;
+            Prefetch(index->oids + (static_cast<uint64_t>(first) * GVFS_OID_LENGTH));
+            Prefetch(index->oids + (static_cast<uint64_t>(position) * GVFS_OID_LENGTH));
+            Prefetch(index->oids + (static_cast<uint64_t>(last) * GVFS_OID_LENGTH) + GVFS_OID_LENGTH - 1);
+        }
+    }
+
+    // Validates the fanout table and object id table, and checks that both are
+    // contained in the mapping
+    int SetOidTable(ObjectIndex* index, uint64_t fanoutOffset, uint64_t oidsOffset)
+    {
+        if (fanoutOffset > index->mappingLength || index->mappingLength - fanoutOffset < FanoutSize)
+        {
+            return ObjectLookup_InvalidFormat;
+        }
+
+        const uint8_t* fanout = index->mapping + fanoutOffset;
+        uint32_t previous = 0;
+        for (int i = 0; i < 256; ++i)
+        {
+            uint32_t count = ReadUInt32BE(fanout + (i * 4));
+            if (count < previous)
+            {
+                return ObjectLookup_InvalidFormat;
+            }
+
+            previous = count;
+        }
+
+        uint64_t oidsLength = static_cast<uint64_t>(previous) * GVFS_OID_LENGTH;
+        if (oidsOffset > index->mappingLength || index->mappingLength - oidsOffset < oidsLength)
+        {
+            return ObjectLookup_InvalidFormat;
+        }
+
+        index->fanout = fanout;
+        index->oids = index->mapping + oidsOffset;
+        index->objectCount = previous;
+        return ObjectLookup_Success;
+    }
+
+    int ParsePackIndex(ObjectIndex* index)
+    {
+        // Header: signature(4) version(4), followed by the fanout table and the OIDs
+        if (index->mappingLength < PackIndexHeaderSize + FanoutSize + PackIndexTrailerSize)
+        {
+            return ObjectLookup_InvalidFormat;
+        }
+
+        if (ReadUInt32BE(index->mapping + 4) != PackIndexVersion)
+        {
+            return ObjectLookup_UnsupportedVersion;
+        }
+
+        int result = SetOidTable(index, PackIndexHeaderSize, PackIndexHeaderSize + FanoutSize);
+        if (result != ObjectLookup_Success)
+        {
+            return result;
+        }
+
+        uint64_t expectedMinimumLength =
+            PackIndexHeaderSize +
+            FanoutSize +
+            (static_cast<uint64_t>(index->objectCount) * PackIndexBytesPerObject) +
+            PackIndexTrailerSize;
+
+        return index->mappingLength < expectedMinimumLength ? ObjectLookup_InvalidFormat : ObjectLookup_Success;
+    }
+
+    int ParseMidx(ObjectIndex* index)
+    {
+        // Header: MIDX(4) version(1) oidVersion(1) numChunks(1) reserved(1) numPacks(4)
+        if (index->mappingLength < MidxHeaderSize)
+        {
+            return ObjectLookup_InvalidFormat;
+        }
+
+        if (index->mapping[4] != MidxVersion || index->mapping[5] != MidxSha1OidVersion)
+        {
+            return ObjectLookup_UnsupportedVersion;
+        }
+
+        // The chunk table of contents follows the header and ends with a terminating entry
+        uint64_t chunkCount = index->mapping[6];
+        if (index->mappingLength < MidxHeaderSize + ((chunkCount + 1) * ChunkTocEntrySize))
+        {
+            return ObjectLookup_InvalidFormat;
+        }
+
+        uint64_t fanoutOffset = 0;
+        uint64_t oidsOffset = 0;
+        for (uint64_t i = 0; i < chunkCount; ++i)
+        {
+            const uint8_t* entry = index->mapping + MidxHeaderSize + (i * ChunkTocEntrySize);
+            switch (ReadUInt32BE(entry))
+            {
+            case ChunkIdOIDF:
+                fanoutOffset = ReadUInt64BE(entry + 4);
+                break;
+            case ChunkIdOIDL:
+                oidsOffset = ReadUInt64BE(entry + 4);
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (fanoutOffset == 0 || oidsOffset == 0)
+        {
+            return ObjectLookup_InvalidFormat;
+        }
+
+        return SetOidTable(index, fanoutOffset, oidsOffset);
+    }
+
+    int MapFile(const OBJECTLOOKUP_PATH_CHAR* path, ObjectIndex* index)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileW(
+            path,
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_DELETE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+            nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return ObjectLookup_OpenFailed;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            return ObjectLookup_OpenFailed;
+        }
+
+        // Empty files cannot be mapped, and are not valid indexes either
+        if (static_cast<uint64_t>(fileSize.QuadPart) < MidxHeaderSize)
+        {
+            CloseHandle(file);
+            return ObjectLookup_InvalidFormat;
+        }
+
+        // The view keeps the file mapping (and the file) open once it is created
+        HANDLE fileMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (fileMapping == nullptr)
+        {
+            return ObjectLookup_MapFailed;
+        }
+
+        void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(fileMapping);
+        if (view == nullptr)
+        {
+            return ObjectLookup_MapFailed;
+        }
+
+        index->mapping = static_cast<const uint8_t*>(view);
+        index->mappingLength = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return ObjectLookup_OpenFailed;
+        }
+
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) != 0)
+        {
+            close(fd);
+            return ObjectLookup_OpenFailed;
+        }
+
+        if (static_cast<uint64_t>(fileInfo.st_size) < MidxHeaderSize)
+        {
+            close(fd);
+            return ObjectLookup_InvalidFormat;
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED)
+        {
+            return ObjectLookup_MapFailed;
+        }
+
+        // Lookups touch a few scattered pages, read-ahead would only pollute the page cache
+        madvise(view, static_cast<size_t>(fileInfo.st_size), MADV_RANDOM);
+
+        index->mapping = static_cast<const uint8_t*>(view);
+        index->mappingLength = static_cast<uint64_t>(fileInfo.st_size);
+#endif
+
+        return ObjectLookup_Success;
+    }
+
+    void UnmapFile(ObjectIndex* index)
+    {
+        if (index->mapping != nullptr)
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(index->mapping);
+#else
+            munmap(const_cast<uint8_t*>(index->mapping), static_cast<size_t>(index->mappingLength));
+#endif
+            index->mapping = nullptr;
+        }
+    }
+}
+
+int ObjectIndex_Open(const OBJECTLOOKUP_PATH_CHAR* path, ObjectIndex** index)
+{
+    if (path == nullptr || index == nullptr)
+    {
+        return ObjectLookup_InvalidArgument;
+    }
+
+    *index = nullptr;
+
+    ObjectIndex* newIndex = static_cast<ObjectIndex*>(calloc(1, sizeof(ObjectIndex)));
+    if (newIndex == nullptr)
+    {
+        return ObjectLookup_MapFailed;
+    }
+
+    int result = MapFile(path, newIndex);
+    if (result == ObjectLookup_Success)
+    {
+        uint32_t signature = ReadUInt32BE(newIndex->mapping);
+        if (signature == PackIndexSignature)
+        {
+            result = ParsePackIndex(newIndex);
+        }
+        else if (signature == MidxSignature)
+        {
+            result = ParseMidx(newIndex);
+        }
+        else
+        {
+            // Version 1 pack indexes have no signature and are not supported
+            result = ObjectLookup_InvalidFormat;
+        }
+    }
+
+    if (result != ObjectLookup_Success)
+    {
+        ObjectIndex_Close(newIndex);
+        return result;
+    }
+
+    *index = newIndex;
+    return ObjectLookup_Success;
+}
+
+void ObjectIndex_Close(ObjectIndex* index)
+{
+    if (index != nullptr)
+    {
+        UnmapFile(index);
+        free(index);
+    }
+}
+
+uint32_t ObjectIndex_GetObjectCount(const ObjectIndex* index)
+{
+    return index == nullptr ? 0 : index->objectCount;
+}
+
+int ObjectIndex_Exists(const ObjectIndex* index, const uint8_t* oid)
+{
+    if (index == nullptr || oid == nullptr)
+    {
+        return 0;
+    }
+
+    return FindOid(index, oid) ? 1 : 0;
+}
+
+int ObjectIndex_ExistsInAny(
+    const ObjectIndex* const* indexes,
+    size_t indexCount,
+    const uint8_t* oid)
+{
+    if (indexes == nullptr || oid == nullptr)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const ObjectIndex* index = indexes[i];
+        if (index != nullptr && index->objectCount > 0 && FindOid(index, oid))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+size_t ObjectIndex_ExistsMany(
+    const ObjectIndex* const* indexes,
+    size_t indexCount,
+    const uint8_t* oids,
+    size_t oidCount,
+    uint8_t* results)
+{
+    if (indexes == nullptr || oids == nullptr || results == nullptr)
+    {
+        return 0;
+    }
+
+    memset(results, 0, oidCount);
+
+    // Searches one index for every id of a batch (rather than every index for one id),
+    // so that the first probe of upcoming searches can be prefetched while the current
+    // one runs.  The benchmark has not shown this to be reliably faster than calling
+    // ObjectIndex_ExistsInAny for each id, the batch saves the calls.
+    size_t found = 0;
+    uint16_t pending[ExistsManyBatchSize];
+    for (size_t batchStart = 0; batchStart < oidCount; batchStart += ExistsManyBatchSize)
+    {
+        const uint8_t* batchOids = oids + (batchStart * GVFS_OID_LENGTH);
+        size_t pendingCount = oidCount - batchStart < ExistsManyBatchSize ? oidCount - batchStart : ExistsManyBatchSize;
+        for (size_t i = 0; i < pendingCount; ++i)
+        {
+            pending[i] = static_cast<uint16_t>(i);
+        }
+
+        for (size_t j = 0; j < indexCount && pendingCount > 0; ++j)
+        {
+            const ObjectIndex* index = indexes[j];
+            if (index == nullptr || index->objectCount == 0)
+            {
+                continue;
+            }
+
+            for (size_t i = 0; i < PrefetchDistance && i < pendingCount; ++i)
+            {
+                PrefetchFirstProbe(index, batchOids + (pending[i] * GVFS_OID_LENGTH));
+            }
+
+            size_t stillPending = 0;
+            for (size_t i = 0; i < pendingCount; ++i)
+            {
+                if (i + PrefetchDistance < pendingCount)
+                {
+                    PrefetchFirstProbe(index, batchOids + (pending[i + PrefetchDistance] * GVFS_OID_LENGTH));
+                }
+
+                if (FindOid(index, batchOids + (pending[i] * GVFS_OID_LENGTH)))
+                {
+                    results[batchStart + pending[i]] = 1;
+                    ++found;
+                }
+                else
+                {
+                    pending[stillPending] = pending[i];
+                    ++stillPending;
+                }
+            }
+
+            pendingCount = stillPending;
+        }
+    }
+
+    return found;
+}
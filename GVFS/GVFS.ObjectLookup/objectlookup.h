@@ -0,0 +1,82 @@
+#pragma once
+
+// Read-only lookups of object ids in git pack index (.idx, version 2) and
+// multi-pack-index (MIDX) files.
+//
+// The files are memory mapped when opened and are never modified, all lookup
+// functions are safe to call concurrently on the same index.  Only SHA-1 object
+// ids (20 bytes) are supported.
+//
+// The library's only caller is GVFS.Common's NativeObjectIndexSet, through
+// P/Invoke.  The native hooks do not link it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+  #ifdef GVFS_OBJECTLOOKUP_EXPORTS
+    #define GVFS_OBJECTLOOKUP_API __declspec(dllexport)
+  #else
+    #define GVFS_OBJECTLOOKUP_API __declspec(dllimport)
+  #endif
+  typedef wchar_t OBJECTLOOKUP_PATH_CHAR;
+#else
+  #define GVFS_OBJECTLOOKUP_API __attribute__((visibility("default")))
+  typedef char OBJECTLOOKUP_PATH_CHAR;
+#endif
+
+#define GVFS_OID_LENGTH 20
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum ObjectLookupResult
+{
+    ObjectLookup_Success = 0,
+    ObjectLookup_InvalidArgument = 1,
+    ObjectLookup_OpenFailed = 2,
+    ObjectLookup_MapFailed = 3,
+    ObjectLookup_InvalidFormat = 4,
+    ObjectLookup_UnsupportedVersion = 5,
+};
+
+typedef struct ObjectIndex ObjectIndex;
+
+// Opens and maps a pack .idx or multi-pack-index file, the type of the file is
+// detected from its header.  On success *index must be released with
+// ObjectIndex_Close.
+GVFS_OBJECTLOOKUP_API int ObjectIndex_Open(const OBJECTLOOKUP_PATH_CHAR* path, ObjectIndex** index);
+
+GVFS_OBJECTLOOKUP_API void ObjectIndex_Close(ObjectIndex* index);
+
+GVFS_OBJECTLOOKUP_API uint32_t ObjectIndex_GetObjectCount(const ObjectIndex* index);
+
+// Returns 1 if the index contains the 20 byte object id, 0 otherwise
+GVFS_OBJECTLOOKUP_API int ObjectIndex_Exists(const ObjectIndex* index, const uint8_t* oid);
+
+// Returns 1 if any of the indexCount indexes contains the 20 byte object id, 0
+// otherwise.  The indexes are probed in order, so the index most likely to contain
+// the object (e.g. the MIDX) should be first.
+GVFS_OBJECTLOOKUP_API int ObjectIndex_ExistsInAny(
+    const ObjectIndex* const* indexes,
+    size_t indexCount,
+    const uint8_t* oid);
+
+// Looks up oidCount object ids (stored back to back, GVFS_OID_LENGTH bytes each)
+// in indexCount indexes.  results[i] is set to 1 when any of the indexes contains
+// the i-th object id and to 0 otherwise.  The indexes are probed in order, as in
+// ObjectIndex_ExistsInAny.  This saves a call per id for callers that already
+// have a batch of ids, but each id costs about as much as ObjectIndex_ExistsInAny.
+// Returns the number of object ids that were found.
+GVFS_OBJECTLOOKUP_API size_t ObjectIndex_ExistsMany(
+    const ObjectIndex* const* indexes,
+    size_t indexCount,
+    const uint8_t* oids,
+    size_t oidCount,
+    uint8_t* results);
+
+#ifdef __cplusplus
+}
+#endif
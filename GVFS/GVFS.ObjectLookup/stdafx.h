@@ -0,0 +1,15 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+#ifdef _WIN32
+#include "targetver.h"
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
@@ -0,0 +1,87 @@
+﻿using GVFS.Common.Git;
+using GVFS.Virtualization.BlobSize;
+using System;
+using System.Diagnostics;
+using System.IO;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Measures the lookup throughput of a <see cref="BlobSizesHashFile"/> holding a large number of sizes.
+    /// The hash file is created in the temp folder the first time the benchmark runs and deleted when the
+    /// benchmark is disposed.
+    /// </summary>
+    internal class BlobSizesLookupBenchmark : IDisposable
+    {
+        public const long DefaultEntryCount = 50_000_000;
+
+        private const int LookupsPerRun = 10_000_000;
+
+        private readonly string path;
+        private readonly long entryCount;
+        private BlobSizesHashFile hashFile;
+        private int runCount;
+
+        public BlobSizesLookupBenchmark(long entryCount)
+        {
+            this.entryCount = entryCount;
+            this.path = Path.Combine(Path.GetTempPath(), "GVFS.PerfProfiling." + Guid.NewGuid().ToString("N") + MemoryMappedBlobSizes.HashFileExtension);
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            this.hashFile = BlobSizesHashFile.Create(this.path, BlobSizesHashFile.GetSlotCountForEntries(entryCount));
+            for (long i = 0; i < entryCount; ++i)
+            {
+                this.hashFile.TryAdd(CreateSha(i), i);
+            }
+
+            this.hashFile.Flush();
+            Console.WriteLine($"Created blob sizes hash file with {this.hashFile.Count:N0} entries ({this.hashFile.SlotCount:N0} slots) in {stopwatch.ElapsedMilliseconds} ms");
+        }
+
+        /// <summary>
+        /// Look up LookupsPerRun sizes that are in the hash file and LookupsPerRun sizes that are not,
+        /// each run looks up a different set of SHAs
+        /// </summary>
+        public void LookupSizes()
+        {
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            long start = (this.runCount * (long)LookupsPerRun) % this.entryCount;
+            ++this.runCount;
+
+            long found = 0;
+            for (long i = 0; i < LookupsPerRun; ++i)
+            {
+                if (this.hashFile.TryGetSize(CreateSha((start + i) % this.entryCount), out long _))
+                {
+                    ++found;
+                }
+
+                if (this.hashFile.TryGetSize(CreateSha(this.entryCount + start + i), out long _))
+                {
+                    ++found;
+                }
+            }
+
+            stopwatch.Stop();
+            double lookupsPerSecond = (2.0 * LookupsPerRun) / stopwatch.Elapsed.TotalSeconds;
+            Console.WriteLine($"Blob size lookups: {lookupsPerSecond:N0}/s, found {found:N0} of {LookupsPerRun:N0} expected");
+        }
+
+        public void Dispose()
+        {
+            if (this.hashFile != null)
+            {
+                this.hashFile.Dispose();
+                this.hashFile = null;
+                File.Delete(this.path);
+            }
+        }
+
+        private static Sha1Id CreateSha(long seed)
+        {
+            // Spread the seed across the SHA the way a real SHA would be, the first 8 bytes are used as the hash
+            ulong value = ((ulong)seed + 1) * 0x9E3779B97F4A7C15;
+            return new Sha1Id(value, value ^ 0x5555555555555555, (uint)seed);
+        }
+    }
+}
@@ -0,0 +1,201 @@
+﻿using GVFS.Common;
+using GVFS.Common.Git;
+using GVFS.Common.Http;
+using GVFS.Common.Prefetch.Git;
+using GVFS.Common.Prefetch.Pipeline;
+using GVFS.Common.Tracing;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Measures the download paths against a <see cref="GVFSProtocolStandInServer"/>: single loose objects requested by
+    /// <see cref="GitObjectsHttpRequestor.TryDownloadLooseObject"/>, batches of blobs downloaded by
+    /// <see cref="BatchObjectDownloadStage"/>, prefetch packs downloaded by <see cref="GitObjects.TryDownloadPrefetchPacks"/>
+    /// and blob sizes queried the way GitIndexProjection's BatchPopulateMissingSizesFromRemote queries them.  Objects are
+    /// written to a scratch repo that is emptied before every run.  The request times are the stand-in server's, so
+    /// they include the time the client takes to read each response.
+    /// </summary>
+    internal class DownloadPathsBenchmark : IDisposable
+    {
+        private const int MaxBlobCount = 50_000;
+        private const int LooseObjectCount = 2000;
+
+        // The same as gvfs prefetch and GitIndexProjection
+        private const int DownloadChunkSize = 4000;
+        private const int SizesPerRequest = 2000;
+
+        private readonly GVFSProtocolStandInServer server;
+        private readonly ITracer tracer;
+        private readonly ScratchEnlistment enlistment;
+        private readonly string[] blobIds;
+
+        public DownloadPathsBenchmark(GVFSProtocolStandInServer server, string gitBinPath, ITracer tracer)
+        {
+            this.server = server;
+            this.tracer = tracer;
+            this.enlistment = ScratchEnlistment.Create(gitBinPath, server.Url);
+            this.blobIds = server.ObjectStore.GetObjectIds("blob", MaxBlobCount);
+            Console.WriteLine($"Serving {this.blobIds.Length:N0} blobs from {server.Url}");
+        }
+
+        public void DownloadLooseObjects()
+        {
+            this.Measure(GVFSProtocolStandInServer.Endpoint.LooseObject, (requestor, gitObjects) =>
+            {
+                string[] objectIds = this.blobIds.Take(LooseObjectCount).ToArray();
+                int nextObject = -1;
+                int downloaded = 0;
+                Parallel.For(
+                    0,
+                    Environment.ProcessorCount,
+                    _ =>
+                    {
+                        byte[] buffer = new byte[StreamUtil.DefaultCopyBufferSize];
+                        int index;
+                        while ((index = Interlocked.Increment(ref nextObject)) < objectIds.Length)
+                        {
+                            string objectId = objectIds[index];
+                            RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.InvocationResult result = requestor.TryDownloadLooseObject(
+                                objectId,
+                                retryOnFailure: true,
+                                cancellationToken: CancellationToken.None,
+                                requestSource: nameof(DownloadPathsBenchmark),
+                                onSuccess: (tryCount, response) =>
+                                {
+                                    gitObjects.WriteLooseObject(response.Stream, objectId, overwriteExistingObject: false, bufToCopyWith: buffer);
+                                    return new RetryWrapper<GitObjectsHttpRequestor.GitObjectTaskResult>.CallbackResult(new GitObjectsHttpRequestor.GitObjectTaskResult(true));
+                                });
+
+                            if (result.Succeeded)
+                            {
+                                Interlocked.Increment(ref downloaded);
+                            }
+                        }
+                    });
+
+                return downloaded;
+            });
+        }
+
+        public void DownloadObjectBatches()
+        {
+            this.Measure(GVFSProtocolStandInServer.Endpoint.Objects, (requestor, gitObjects) =>
+            {
+                BlockingCollection<string> missingBlobs = new BlockingCollection<string>();
+                foreach (string blobId in this.blobIds)
+                {
+                    missingBlobs.Add(blobId);
+                }
+
+                missingBlobs.CompleteAdding();
+
+                BlockingCollection<string> availableBlobs = new BlockingCollection<string>();
+                BatchObjectDownloadStage downloader = new BatchObjectDownloadStage(
+                    Environment.ProcessorCount,
+                    DownloadChunkSize,
+                    missingBlobs,
+                    availableBlobs,
+                    this.tracer,
+                    this.enlistment,
+                    requestor,
+                    gitObjects);
+                downloader.Start();
+                downloader.WaitForCompletion();
+
+                if (downloader.HasFailures)
+                {
+                    Console.WriteLine("Some of the batches failed to download");
+                }
+
+                return availableBlobs.Count;
+            });
+        }
+
+        public void DownloadPrefetchPacks()
+        {
+            this.Measure(GVFSProtocolStandInServer.Endpoint.Prefetch, (requestor, gitObjects) =>
+            {
+                GitProcess gitProcess = new GitProcess(this.enlistment);
+                if (!gitObjects.TryDownloadPrefetchPacks(gitProcess, latestTimestamp: 0, trustPackIndexes: GVFSConstants.GitConfig.TrustPackIndexesDefault, out List<string> packIndexes))
+                {
+                    Console.WriteLine("Failed to download the prefetch packs");
+                    return 0;
+                }
+
+                int objectCount = 0;
+                foreach (string packIndex in packIndexes ?? new List<string>())
+                {
+                    using (PackIndexReader reader = new PackIndexReader(Path.Combine(this.enlistment.GitPackRoot, Path.GetFileName(packIndex))))
+                    {
+                        objectCount += reader.TotalObjects;
+                    }
+                }
+
+                return objectCount;
+            });
+        }
+
+        public void QueryBlobSizes()
+        {
+            this.Measure(GVFSProtocolStandInServer.Endpoint.Sizes, (requestor, gitObjects) =>
+            {
+                int nextBatch = -1;
+                int sizesReceived = 0;
+                int batchCount = (this.blobIds.Length + SizesPerRequest - 1) / SizesPerRequest;
+                Parallel.For(
+                    0,
+                    Environment.ProcessorCount,
+                    _ =>
+                    {
+                        int batch;
+                        while ((batch = Interlocked.Increment(ref nextBatch)) < batchCount)
+                        {
+                            IEnumerable<string> objectIds = this.blobIds.Skip(batch * SizesPerRequest).Take(SizesPerRequest);
+                            Interlocked.Add(ref sizesReceived, requestor.QueryForFileSizes(objectIds, CancellationToken.None).Count);
+                        }
+                    });
+
+                return sizesReceived;
+            });
+        }
+
+        public void Dispose()
+        {
+            this.enlistment.Delete();
+        }
+
+        private void Measure(GVFSProtocolStandInServer.Endpoint endpoint, Func<GitObjectsHttpRequestor, GitObjects, int> download)
+        {
+            this.enlistment.ResetObjects();
+
+            int objectCount;
+            Stopwatch stopwatch;
+            CacheServerInfo cacheServer = new CacheServerInfo(this.server.Url, "StandIn");
+            using (GitObjectsHttpRequestor requestor = new GitObjectsHttpRequestor(this.tracer, this.enlistment, cacheServer, new RetryConfig()))
+            {
+                PrefetchGitObjects gitObjects = new PrefetchGitObjects(this.tracer, this.enlistment, requestor);
+
+                this.server.ResetStatistics();
+                stopwatch = Stopwatch.StartNew();
+                objectCount = download(requestor, gitObjects);
+                stopwatch.Stop();
+            }
+
+            GVFSProtocolStandInServer.EndpointStatistics statistics = this.server.GetStatistics(endpoint);
+            double seconds = stopwatch.Elapsed.TotalSeconds;
+            Console.WriteLine(
+                $"{endpoint}: {objectCount:N0} objects in {statistics.RequestCount:N0} requests, " +
+                $"{objectCount / seconds:N0} objects/s, {statistics.BytesSent / seconds / (1024 * 1024):N1} MB/s, " +
+                $"request time p50 {statistics.GetLatencyPercentile(0.50):N1} ms, p99 {statistics.GetLatencyPercentile(0.99):N1} ms, " +
+                $"max {statistics.GetLatencyPercentile(1):N1} ms");
+        }
+    }
+}
@@ -0,0 +1,490 @@
+﻿using GVFS.Common;
+using GVFS.Common.Http;
+using Microsoft.AspNetCore.Builder;
+using Microsoft.AspNetCore.Hosting;
+using Microsoft.AspNetCore.Hosting.Server;
+using Microsoft.AspNetCore.Hosting.Server.Features;
+using Microsoft.AspNetCore.Http;
+using Microsoft.AspNetCore.Server.Kestrel.Core;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging;
+using System;
+using System.Buffers.Binary;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
+using System.Net;
+using System.Security.Cryptography;
+using System.Security.Cryptography.X509Certificates;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// A local stand-in for a cache server that serves gvfs/objects, gvfs/prefetch, gvfs/sizes and gvfs/config (see
+    /// Protocol.md) from a bare repo, so that the download paths can be measured without a live cache server or origin.
+    /// Every response is delayed by a fixed latency, and all responses share a link of a fixed bandwidth.  The server
+    /// records the bytes sent and the time taken by every request, from when the request is received until the last
+    /// byte of the response has been written.
+    /// </summary>
+    /// <remarks>
+    /// <see cref="Url"/> serves HTTP/1.1 over http, which is what an enlistment pointed at the stand-in uses.
+    /// <see cref="HttpsUrl"/> also negotiates HTTP/2, with a self-signed certificate for localhost that clients
+    /// have to accept without validating it.
+    /// </remarks>
+    internal class GVFSProtocolStandInServer : IDisposable
+    {
+        private const string RepoPath = "/standin";
+        private const int ShapedWriteSize = 16 * 1024;
+
+        // How far the link may fall behind its schedule before the time is lost, so that delays that are longer than
+        // requested do not reduce the bandwidth
+        private static readonly TimeSpan MaxBurst = TimeSpan.FromMilliseconds(50);
+
+        private readonly WebApplication server;
+        private readonly X509Certificate2 certificate;
+        private readonly StandInObjectStore objectStore;
+        private readonly TimeSpan latency;
+        private readonly long bytesPerSecond;
+        private readonly object linkLock = new object();
+        private ConcurrentDictionary<Endpoint, EndpointStatistics> statistics = new ConcurrentDictionary<Endpoint, EndpointStatistics>();
+        private long linkFreeTimestamp;
+
+        /// <param name="latency">Added before every response</param>
+        /// <param name="bytesPerSecond">Bandwidth shared by all responses, 0 for no limit</param>
+        public GVFSProtocolStandInServer(string gitBinPath, string bareRepoPath, TimeSpan latency, long bytesPerSecond)
+        {
+            this.objectStore = new StandInObjectStore(gitBinPath, bareRepoPath);
+            this.latency = latency;
+            this.bytesPerSecond = bytesPerSecond;
+
+            this.certificate = CreateLoopbackCertificate();
+
+            WebApplicationBuilder builder = WebApplication.CreateSlimBuilder();
+            builder.Logging.ClearProviders();
+            builder.WebHost.ConfigureKestrel(options =>
+            {
+                // Responses are written synchronously, and shaped responses are expected to be slow
+                options.AllowSynchronousIO = true;
+                options.Limits.MinResponseDataRate = null;
+                options.Limits.MaxRequestBodySize = null;
+
+                options.Listen(IPAddress.Loopback, 0);
+                options.Listen(IPAddress.Loopback, 0, listenOptions =>
+                {
+                    listenOptions.Protocols = HttpProtocols.Http1AndHttp2;
+                    listenOptions.UseHttps(this.certificate);
+                });
+            });
+
+            this.server = builder.Build();
+
+            // Each request has its own thread, as shaped responses block while they wait for the link
+            this.server.Run(context => Task.Factory.StartNew(() => this.HandleRequest(context), TaskCreationOptions.LongRunning));
+            this.server.StartAsync().GetAwaiter().GetResult();
+
+            foreach (string address in this.server.Services.GetRequiredService<IServer>().Features.Get<IServerAddressesFeature>().Addresses)
+            {
+                Uri uri = new Uri(address);
+                if (uri.Scheme == Uri.UriSchemeHttps)
+                {
+                    this.HttpsUrl = $"https://localhost:{uri.Port}{RepoPath}";
+                }
+                else
+                {
+                    this.Url = $"http://localhost:{uri.Port}{RepoPath}";
+                }
+            }
+        }
+
+        public enum Endpoint
+        {
+            Config,
+            LooseObject,
+            Objects,
+            Prefetch,
+            Sizes,
+        }
+
+        /// <summary>
+        /// The repo URL, which is also the cache server URL, of the stand-in.
+        /// </summary>
+        public string Url { get; }
+
+        /// <summary>
+        /// The same repo served over https, where HTTP/2 is negotiated for clients that offer it.
+        /// </summary>
+        public string HttpsUrl { get; }
+
+        public StandInObjectStore ObjectStore
+        {
+            get { return this.objectStore; }
+        }
+
+        public EndpointStatistics GetStatistics(Endpoint endpoint)
+        {
+            return this.statistics.GetOrAdd(endpoint, _ => new EndpointStatistics());
+        }
+
+        public void ResetStatistics()
+        {
+            this.statistics = new ConcurrentDictionary<Endpoint, EndpointStatistics>();
+        }
+
+        public void Dispose()
+        {
+            this.server.StopAsync().GetAwaiter().GetResult();
+            this.server.DisposeAsync().AsTask().GetAwaiter().GetResult();
+            this.certificate.Dispose();
+            this.objectStore.Dispose();
+        }
+
+        private static X509Certificate2 CreateLoopbackCertificate()
+        {
+            using (RSA key = RSA.Create(2048))
+            {
+                CertificateRequest request = new CertificateRequest("CN=localhost", key, HashAlgorithmName.SHA256, RSASignaturePadding.Pkcs1);
+                SubjectAlternativeNameBuilder subjectAlternativeNames = new SubjectAlternativeNameBuilder();
+                subjectAlternativeNames.AddDnsName("localhost");
+                request.CertificateExtensions.Add(subjectAlternativeNames.Build());
+
+                using (X509Certificate2 certificate = request.CreateSelfSigned(DateTimeOffset.UtcNow.AddDays(-1), DateTimeOffset.UtcNow.AddDays(1)))
+                {
+                    // SslStream on Windows needs a certificate whose key is not ephemeral
+                    return X509CertificateLoader.LoadPkcs12(certificate.Export(X509ContentType.Pfx), password: null);
+                }
+            }
+        }
+
+        private static void WriteJson(HttpResponse response, Stream output, string json)
+        {
+            byte[] body = Encoding.UTF8.GetBytes(json);
+            response.ContentType = "application/json";
+            response.ContentLength = body.Length;
+            output.Write(body, 0, body.Length);
+        }
+
+        private static string ReadBody(HttpRequest request)
+        {
+            using (StreamReader reader = new StreamReader(request.Body, Encoding.UTF8))
+            {
+                return reader.ReadToEnd();
+            }
+        }
+
+        private void HandleRequest(HttpContext context)
+        {
+            long startTimestamp = Stopwatch.GetTimestamp();
+            Endpoint? endpoint = null;
+            long bytesSent = 0;
+            try
+            {
+                if (this.latency > TimeSpan.Zero)
+                {
+                    Thread.Sleep(this.latency);
+                }
+
+                using (ShapedStream output = new ShapedStream(this, context.Response.Body))
+                {
+                    endpoint = this.SendResponse(context.Request, context.Response, output);
+                    bytesSent = output.BytesWritten;
+                }
+
+                // Send the end of the response before the request is timed
+                context.Response.CompleteAsync().GetAwaiter().GetResult();
+            }
+            catch (Exception e) when (e is IOException || e is OperationCanceledException)
+            {
+                // The client closed the connection
+            }
+            catch (Exception e)
+            {
+                Console.WriteLine($"Stand-in server failed to respond to {context.Request.Method} {context.Request.Path}: {e.Message}");
+
+                // Otherwise part of the response has already been sent
+                if (!context.Response.HasStarted)
+                {
+                    context.Response.StatusCode = (int)HttpStatusCode.InternalServerError;
+                }
+            }
+            finally
+            {
+                if (endpoint.HasValue)
+                {
+                    this.GetStatistics(endpoint.Value).Record(Stopwatch.GetElapsedTime(startTimestamp), bytesSent);
+                }
+            }
+        }
+
+        private Endpoint? SendResponse(HttpRequest request, HttpResponse response, Stream output)
+        {
+            string path = request.Path.Value.Substring(RepoPath.Length);
+            string objectsPrefix = GVFSConstants.Endpoints.GVFSObjects + "/";
+
+            if (HttpMethods.IsGet(request.Method) && path == GVFSConstants.Endpoints.GVFSConfig)
+            {
+                WriteJson(response, output, GVFSJsonOptions.Serialize(new ServerGVFSConfig()));
+                return Endpoint.Config;
+            }
+
+            if (HttpMethods.IsGet(request.Method) && path.StartsWith(objectsPrefix, StringComparison.Ordinal))
+            {
+                this.SendLooseObject(path.Substring(objectsPrefix.Length), response, output);
+                return Endpoint.LooseObject;
+            }
+
+            if (HttpMethods.IsPost(request.Method) && path == GVFSConstants.Endpoints.GVFSObjects)
+            {
+                this.SendObjects(request, response, output);
+                return Endpoint.Objects;
+            }
+
+            if (HttpMethods.IsGet(request.Method) && path == GVFSConstants.Endpoints.GVFSPrefetch)
+            {
+                long.TryParse(request.Query["lastPackTimestamp"], out long lastPackTimestamp);
+                this.SendPrefetchPacks(lastPackTimestamp, response, output);
+                return Endpoint.Prefetch;
+            }
+
+            if (HttpMethods.IsPost(request.Method) && path == GVFSConstants.Endpoints.GVFSSizes)
+            {
+                List<string> objectIds = GVFSJsonOptions.Deserialize<List<string>>(ReadBody(request));
+                List<GitObjectsHttpRequestor.GitObjectSize> sizes = new List<GitObjectsHttpRequestor.GitObjectSize>(objectIds.Count);
+                foreach (string objectId in objectIds)
+                {
+                    if (this.objectStore.TryGetSize(objectId, out long size))
+                    {
+                        sizes.Add(new GitObjectsHttpRequestor.GitObjectSize(objectId, size));
+                    }
+                }
+
+                WriteJson(response, output, GVFSJsonOptions.Serialize(sizes));
+                return Endpoint.Sizes;
+            }
+
+            response.StatusCode = (int)HttpStatusCode.NotFound;
+            return null;
+        }
+
+        private void SendLooseObject(string objectId, HttpResponse response, Stream output)
+        {
+            if (!this.objectStore.TryGetLooseObject(objectId, out byte[] compressedObject))
+            {
+                response.StatusCode = (int)HttpStatusCode.NotFound;
+                return;
+            }
+
+            response.ContentType = GVFSConstants.MediaTypes.LooseObjectMediaType;
+            response.ContentLength = compressedObject.Length;
+            output.Write(compressedObject, 0, compressedObject.Length);
+        }
+
+        private void SendObjects(HttpRequest request, HttpResponse response, Stream output)
+        {
+            ObjectsRequest objectsRequest = GVFSJsonOptions.Deserialize<ObjectsRequest>(ReadBody(request));
+            bool looseObjects = request.Headers.Accept.Any(
+                accept => accept.Contains(GVFSConstants.MediaTypes.CustomLooseObjectsMediaType, StringComparison.OrdinalIgnoreCase));
+
+            // Responses without a length are chunked (HTTP/1.1) or end with the last data frame (HTTP/2)
+            if (!looseObjects)
+            {
+                response.ContentType = GVFSConstants.MediaTypes.PackFileMediaType;
+                this.objectStore.WritePack(objectsRequest.ObjectIds, objectsRequest.CommitDepth, output);
+                return;
+            }
+
+            // The loose objects format has no commit to tree expansion
+            if (objectsRequest.CommitDepth > 1)
+            {
+                response.StatusCode = (int)HttpStatusCode.BadRequest;
+                return;
+            }
+
+            response.ContentType = GVFSConstants.MediaTypes.CustomLooseObjectsMediaType;
+
+            byte[] header = new byte[] { (byte)'G', (byte)'V', (byte)'F', (byte)'S', (byte)' ', 1 };
+            output.Write(header, 0, header.Length);
+
+            byte[] objectHeader = new byte[28];
+            foreach (string objectId in objectsRequest.ObjectIds)
+            {
+                if (!this.objectStore.TryGetLooseObject(objectId, out byte[] compressedObject))
+                {
+                    continue;
+                }
+
+                Convert.FromHexString(objectId).CopyTo(objectHeader, 0);
+                BinaryPrimitives.WriteInt64LittleEndian(objectHeader.AsSpan(20), compressedObject.Length);
+                output.Write(objectHeader, 0, objectHeader.Length);
+                output.Write(compressedObject, 0, compressedObject.Length);
+            }
+
+            output.Write(new byte[20], 0, 20);
+        }
+
+        private void SendPrefetchPacks(long lastPackTimestamp, HttpResponse response, Stream output)
+        {
+            StandInObjectStore.PrefetchPack[] packs = this.objectStore.GetPrefetchPacks(lastPackTimestamp).ToArray();
+
+            response.ContentType = GVFSConstants.MediaTypes.PrefetchPackFilesAndIndexesMediaType;
+            response.ContentLength = 8 + packs.Sum(pack => 24 + new FileInfo(pack.PackPath).Length + new FileInfo(pack.IdxPath).Length);
+
+            byte[] header = new byte[8];
+            Encoding.ASCII.GetBytes("GPRE ", header);
+            header[5] = 1;
+            BinaryPrimitives.WriteUInt16LittleEndian(header.AsSpan(6), (ushort)packs.Length);
+            output.Write(header, 0, header.Length);
+
+            byte[] packHeader = new byte[24];
+            foreach (StandInObjectStore.PrefetchPack pack in packs)
+            {
+                using (FileStream packStream = File.OpenRead(pack.PackPath))
+                using (FileStream idxStream = File.OpenRead(pack.IdxPath))
+                {
+                    BinaryPrimitives.WriteInt64LittleEndian(packHeader.AsSpan(0), pack.Timestamp);
+                    BinaryPrimitives.WriteInt64LittleEndian(packHeader.AsSpan(8), packStream.Length);
+                    BinaryPrimitives.WriteInt64LittleEndian(packHeader.AsSpan(16), idxStream.Length);
+                    output.Write(packHeader, 0, packHeader.Length);
+
+                    packStream.CopyTo(output);
+                    idxStream.CopyTo(output);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Waits until the link has time to send <paramref name="byteCount"/> more bytes.
+        /// </summary>
+        private void WaitForLink(int byteCount)
+        {
+            if (this.bytesPerSecond <= 0)
+            {
+                return;
+            }
+
+            TimeSpan wait;
+            lock (this.linkLock)
+            {
+                long now = Stopwatch.GetTimestamp();
+                long earliest = now - (long)(MaxBurst.TotalSeconds * Stopwatch.Frequency);
+                this.linkFreeTimestamp = Math.Max(this.linkFreeTimestamp, earliest) + (byteCount * Stopwatch.Frequency / this.bytesPerSecond);
+                wait = Stopwatch.GetElapsedTime(now, this.linkFreeTimestamp);
+            }
+
+            if (wait > TimeSpan.Zero)
+            {
+                Thread.Sleep(wait);
+            }
+        }
+
+        public class EndpointStatistics
+        {
+            private readonly ConcurrentQueue<double> latenciesMs = new ConcurrentQueue<double>();
+            private long bytesSent;
+
+            public int RequestCount
+            {
+                get { return this.latenciesMs.Count; }
+            }
+
+            public long BytesSent
+            {
+                get { return Interlocked.Read(ref this.bytesSent); }
+            }
+
+            /// <summary>
+            /// Gets the request time, in milliseconds, that <paramref name="percentile"/> (0 to 1) of the requests took
+            /// at most.
+            /// </summary>
+            public double GetLatencyPercentile(double percentile)
+            {
+                double[] sorted = this.latenciesMs.ToArray();
+                if (sorted.Length == 0)
+                {
+                    return 0;
+                }
+
+                Array.Sort(sorted);
+                return sorted[Math.Min(sorted.Length - 1, (int)(sorted.Length * percentile))];
+            }
+
+            public void Record(TimeSpan elapsed, long bytes)
+            {
+                this.latenciesMs.Enqueue(elapsed.TotalMilliseconds);
+                Interlocked.Add(ref this.bytesSent, bytes);
+            }
+        }
+
+        private class ObjectsRequest
+        {
+            public List<string> ObjectIds { get; set; } = new List<string>();
+
+            public int CommitDepth { get; set; }
+        }
+
+        /// <summary>
+        /// Writes to a response in chunks that each wait for the server's shared link.
+        /// </summary>
+        private class ShapedStream : Stream
+        {
+            private readonly GVFSProtocolStandInServer server;
+            private readonly Stream inner;
+
+            public ShapedStream(GVFSProtocolStandInServer server, Stream inner)
+            {
+                this.server = server;
+                this.inner = inner;
+            }
+
+            public long BytesWritten { get; private set; }
+
+            public override bool CanRead => false;
+            public override bool CanSeek => false;
+            public override bool CanWrite => true;
+            public override long Length => throw new NotSupportedException();
+
+            public override long Position
+            {
+                get { throw new NotSupportedException(); }
+                set { throw new NotSupportedException(); }
+            }
+
+            public override void Write(byte[] buffer, int offset, int count)
+            {
+                while (count > 0)
+                {
+                    int chunk = Math.Min(count, ShapedWriteSize);
+                    this.server.WaitForLink(chunk);
+                    this.inner.Write(buffer, offset, chunk);
+                    this.BytesWritten += chunk;
+                    offset += chunk;
+                    count -= chunk;
+                }
+            }
+
+            public override void Flush()
+            {
+                this.inner.Flush();
+            }
+
+            public override int Read(byte[] buffer, int offset, int count)
+            {
+                throw new NotSupportedException();
+            }
+
+            public override long Seek(long offset, SeekOrigin origin)
+            {
+                throw new NotSupportedException();
+            }
+
+            public override void SetLength(long value)
+            {
+                throw new NotSupportedException();
+            }
+        }
+    }
+}
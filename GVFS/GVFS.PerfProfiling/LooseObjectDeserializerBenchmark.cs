@@ -0,0 +1,147 @@
+﻿using GVFS.Common;
+using GVFS.Common.Git;
+using GVFS.Common.NetworkStreams;
+using GVFS.Common.Prefetch.Git;
+using GVFS.Common.Tracing;
+using System;
+using System.Diagnostics;
+using System.IO;
+using System.IO.Compression;
+using System.Security.Cryptography;
+using System.Text;
+using System.Threading;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Measures how quickly an application/x-gvfs-loose-objects response is written to disk by
+    /// <see cref="BatchedLooseObjectDeserializer"/>, serially and with a pipeline of workers.
+    /// The response is read from a file so that the network is not part of the measurement, either a
+    /// response recorded from a cache server (e.g. by saving the body of a POST to gvfs/objects with
+    /// "Accept: application/x-gvfs-loose-objects") or a synthetic response created in the temp folder.
+    /// Each object is validated and written by <see cref="GitObjects.WriteLooseObject"/> into a scratch repo,
+    /// whose objects are deleted before every run and which is deleted when the benchmark is disposed.
+    /// </summary>
+    internal class LooseObjectDeserializerBenchmark : IDisposable
+    {
+        private const int SyntheticObjectCount = 20_000;
+        private const int MaxSyntheticObjectSize = 64 * 1024;
+
+        private readonly string responsePath;
+        private readonly bool deleteResponse;
+        private readonly ITracer tracer;
+        private readonly ScratchEnlistment enlistment;
+
+        public LooseObjectDeserializerBenchmark(ITracer tracer, string gitBinPath, string recordedResponsePath)
+        {
+            this.tracer = tracer;
+            this.enlistment = ScratchEnlistment.Create(gitBinPath, repoUrl: string.Empty);
+
+            if (!string.IsNullOrEmpty(recordedResponsePath))
+            {
+                this.responsePath = recordedResponsePath;
+            }
+            else
+            {
+                this.responsePath = Path.Combine(Path.GetTempPath(), "GVFS.PerfProfiling.LooseObjects." + Guid.NewGuid().ToString("N") + ".response");
+                this.deleteResponse = true;
+
+                Stopwatch stopwatch = Stopwatch.StartNew();
+                CreateSyntheticResponse(this.responsePath);
+                Console.WriteLine($"Created synthetic response with {SyntheticObjectCount:N0} objects ({new FileInfo(this.responsePath).Length:N0} bytes) in {stopwatch.ElapsedMilliseconds} ms");
+            }
+        }
+
+        public void WriteObjectsSerially()
+        {
+            this.WriteObjects(workerCount: 1);
+        }
+
+        public void WriteObjectsInParallel()
+        {
+            this.WriteObjects(BatchedLooseObjectDeserializer.GetDefaultWorkerCount(concurrentStreams: 1));
+        }
+
+        public void Dispose()
+        {
+            this.enlistment.Delete();
+            if (this.deleteResponse)
+            {
+                File.Delete(this.responsePath);
+            }
+        }
+
+        private static void CreateSyntheticResponse(string path)
+        {
+            // Text-like contents so that the objects compress about as well as source files do
+            Random random = new Random(3);
+            byte[] alphabet = Encoding.ASCII.GetBytes("abcdefghijklmnopqrstuvwxyz        {}();\n\n");
+
+            using (FileStream response = File.Create(path))
+            {
+                response.Write(new byte[] { (byte)'G', (byte)'V', (byte)'F', (byte)'S', (byte)' ', 1 });
+                for (int i = 0; i < SyntheticObjectCount; ++i)
+                {
+                    // Mostly small objects with a long tail, like the blobs of a source tree
+                    int size = (int)(MaxSyntheticObjectSize * Math.Pow(random.NextDouble(), 3));
+                    byte[] contents = new byte[size];
+                    for (int j = 0; j < size; ++j)
+                    {
+                        contents[j] = alphabet[random.Next(alphabet.Length)];
+                    }
+
+                    byte[] header = Encoding.ASCII.GetBytes($"blob {size}\0");
+                    byte[] sha;
+                    byte[] compressed;
+                    using (SHA1 hasher = SHA1.Create())
+                    using (MemoryStream compressedStream = new MemoryStream())
+                    {
+                        using (ZLibStream zlib = new ZLibStream(compressedStream, CompressionLevel.Fastest, leaveOpen: true))
+                        {
+                            zlib.Write(header);
+                            zlib.Write(contents);
+                        }
+
+                        hasher.TransformBlock(header, 0, header.Length, null, 0);
+                        hasher.TransformFinalBlock(contents, 0, contents.Length);
+                        sha = hasher.Hash;
+                        compressed = compressedStream.ToArray();
+                    }
+
+                    response.Write(sha);
+                    response.Write(BitConverter.GetBytes((long)compressed.Length));
+                    response.Write(compressed);
+                }
+
+                response.Write(new byte[20]);
+            }
+        }
+
+        private void WriteObjects(int workerCount)
+        {
+            // Every run starts without objects so that every object is written (not skipped as existing)
+            this.enlistment.ResetObjects();
+            PrefetchGitObjects gitObjects = new PrefetchGitObjects(this.tracer, this.enlistment, objectRequestor: null);
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            int objectCount;
+            long responseLength;
+            using (FileStream response = new FileStream(this.responsePath, FileMode.Open, FileAccess.Read, FileShare.Read, bufferSize: 64 * 1024))
+            using (ThreadLocal<byte[]> bufToCopyWith = new ThreadLocal<byte[]>(() => new byte[StreamUtil.DefaultCopyBufferSize]))
+            {
+                // The same as GitObjects writes a batched loose objects response
+                BatchedLooseObjectDeserializer deserializer = new BatchedLooseObjectDeserializer(
+                    response,
+                    (objectStream, sha) => gitObjects.WriteLooseObject(objectStream, sha, overwriteExistingObject: false, bufToCopyWith: bufToCopyWith.Value),
+                    workerCount);
+                objectCount = deserializer.ProcessObjects();
+                responseLength = response.Length;
+            }
+
+            stopwatch.Stop();
+            Console.WriteLine(
+                $"Wrote {objectCount:N0} objects (from {responseLength:N0} response bytes) with {workerCount} worker(s): " +
+                $"{objectCount / stopwatch.Elapsed.TotalSeconds:N0} objects/s, {responseLength / stopwatch.Elapsed.TotalSeconds / (1024 * 1024):N1} MB/s");
+        }
+    }
+}
@@ -0,0 +1,153 @@
+﻿using GVFS.Common;
+using GVFS.Common.Git;
+using GVFS.Common.Http;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
+using System.Net;
+using System.Net.Http;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Measures single object downloads (GET gvfs/objects/{id}) from a GVFS protocol server, using the handler and
+    /// client settings of <see cref="HttpRequestor"/>.  The server is expected to have every requested object.
+    /// </summary>
+    /// <remarks>
+    /// The HTTP/2 run only measures HTTP/2 against an https server that negotiates h2, such as a cache server or the
+    /// https endpoint of <see cref="GVFSProtocolStandInServer"/>.  Certificates are not validated for loopback servers,
+    /// so that a local server can use a self-signed certificate.
+    /// </remarks>
+    internal class ObjectDownloadBenchmark
+    {
+        public const int DownloadCount = 5000;
+
+        private const int OidLength = 20;
+        private const int RequestsPerProcessor = 8;
+
+        private readonly Uri objectsEndpoint;
+        private readonly string[] objectIds;
+
+        public ObjectDownloadBenchmark(string serverUrl, string[] objectIds)
+        {
+            this.objectsEndpoint = new Uri(serverUrl.TrimEnd('/') + GVFSConstants.Endpoints.GVFSObjects);
+            this.objectIds = objectIds;
+            Console.WriteLine($"Downloading {this.objectIds.Length:N0} objects from {this.objectsEndpoint}");
+        }
+
+        /// <summary>
+        /// Reads the ids of up to <see cref="DownloadCount"/> objects from the pack indexes in <paramref name="gitObjectsRoot"/>.
+        /// </summary>
+        public static string[] ReadObjectIds(string gitObjectsRoot)
+        {
+            List<string> objectIds = new List<string>();
+            foreach (string idxPath in Directory.GetFiles(Path.Combine(gitObjectsRoot, "pack"), "*.idx"))
+            {
+                using (PackIndexReader reader = new PackIndexReader(idxPath))
+                {
+                    byte[] oids = new byte[Math.Min(reader.TotalObjects, DownloadCount - objectIds.Count) * OidLength];
+                    int count = reader.CopyOids(0, oids);
+                    for (int i = 0; i < count; ++i)
+                    {
+                        objectIds.Add(Convert.ToHexString(oids, i * OidLength, OidLength).ToLowerInvariant());
+                    }
+                }
+
+                if (objectIds.Count >= DownloadCount)
+                {
+                    break;
+                }
+            }
+
+            return objectIds.ToArray();
+        }
+
+        public void DownloadObjectsWithHttp11()
+        {
+            this.DownloadObjects(useHttp2: false);
+        }
+
+        public void DownloadObjectsWithHttp2()
+        {
+            this.DownloadObjects(useHttp2: true);
+        }
+
+        private static double Percentile(double[] sorted, double percentile)
+        {
+            return sorted.Length == 0 ? 0 : sorted[Math.Min(sorted.Length - 1, (int)(sorted.Length * percentile))];
+        }
+
+        private void DownloadObjects(bool useHttp2)
+        {
+            SocketsHttpHandler handler = HttpRequestor.CreateHandler(useHttp2);
+            if (this.objectsEndpoint.IsLoopback)
+            {
+                handler.SslOptions.RemoteCertificateValidationCallback = (sender, certificate, chain, errors) => true;
+            }
+
+            // The same number of requests is in flight in both modes, HttpRequestor limits HTTP/1.1 requests to
+            // one per connection and HTTP/2 requests to the number of streams
+            int concurrency = Environment.ProcessorCount * RequestsPerProcessor;
+            double[] latencies = new double[this.objectIds.Length];
+            long bytesReceived = 0;
+            int failures = 0;
+            int http2Responses = 0;
+            int nextObject = -1;
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            using (HttpClient client = HttpRequestor.CreateHttpClient(handler, TimeSpan.FromMinutes(1), useHttp2))
+            {
+                Task[] workers = Enumerable.Range(0, concurrency).Select(_ => Task.Run(async () =>
+                {
+                    int index;
+                    while ((index = Interlocked.Increment(ref nextObject)) < this.objectIds.Length)
+                    {
+                        Stopwatch requestStopwatch = Stopwatch.StartNew();
+                        try
+                        {
+                            using (HttpResponseMessage response = await client.GetAsync(new Uri(this.objectsEndpoint + "/" + this.objectIds[index])))
+                            {
+                                byte[] body = await response.Content.ReadAsByteArrayAsync();
+                                if (!response.IsSuccessStatusCode)
+                                {
+                                    Interlocked.Increment(ref failures);
+                                }
+
+                                if (response.Version == HttpVersion.Version20)
+                                {
+                                    Interlocked.Increment(ref http2Responses);
+                                }
+
+                                Interlocked.Add(ref bytesReceived, body.Length);
+                            }
+                        }
+                        catch (HttpRequestException)
+                        {
+                            Interlocked.Increment(ref failures);
+                        }
+
+                        latencies[index] = requestStopwatch.Elapsed.TotalMilliseconds;
+                    }
+                })).ToArray();
+
+                Task.WaitAll(workers);
+            }
+
+            stopwatch.Stop();
+            Array.Sort(latencies);
+            if (useHttp2 && http2Responses == 0)
+            {
+                Console.WriteLine($"{this.objectsEndpoint.Host} did not negotiate HTTP/2, this run measured HTTP/1.1");
+            }
+
+            Console.WriteLine(
+                $"Downloaded {this.objectIds.Length - failures:N0} objects ({bytesReceived:N0} bytes, {http2Responses:N0} over HTTP/2, {failures:N0} failed) " +
+                $"with {concurrency} requests in flight: {this.objectIds.Length / stopwatch.Elapsed.TotalSeconds:N0} objects/s, " +
+                $"latency p50 {Percentile(latencies, 0.50):N1} ms, p99 {Percentile(latencies, 0.99):N1} ms");
+        }
+    }
+}
@@ -0,0 +1,209 @@
+﻿using GVFS.Common.Git;
+using GVFS.Common.Tracing;
+using System;
+using System.Buffers.Binary;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Compares object existence lookups against the pack indexes of an enlistment using the managed
+    /// <see cref="MidxReader"/> and <see cref="PackIndexReader"/> with lookups using the native
+    /// GVFS.ObjectLookup library (<see cref="NativeObjectIndexSet"/>).  The indexes are probed the same
+    /// way PackIndexObjectExistenceChecker probes them: the MIDX first and then every idx it does not cover.
+    /// Half of the lookups are objects sampled from the pack indexes and half are not in any pack.
+    /// </summary>
+    internal class PackIndexLookupBenchmark : IDisposable
+    {
+        private const int OidLength = 20;
+        private const int SampledObjectsPerIndex = 50_000;
+
+        private readonly List<MidxReader> midxReaders = new List<MidxReader>();
+        private readonly List<PackIndexReader> packIndexReaders = new List<PackIndexReader>();
+        private readonly NativeObjectIndexSet nativeIndexes;
+        private readonly byte[] lookups;
+        private readonly int lookupCount;
+        private readonly int expectedFound;
+
+        public PackIndexLookupBenchmark(ITracer tracer, params string[] objectRoots)
+        {
+            List<string> indexPaths = new List<string>();
+            List<byte[]> sampledOids = new List<byte[]>();
+            HashSet<string> visitedPackDirs = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+            foreach (string objectRoot in objectRoots)
+            {
+                string packDir = Path.Combine(objectRoot, "pack");
+                if (!Directory.Exists(packDir) || !visitedPackDirs.Add(Path.GetFullPath(packDir)))
+                {
+                    continue;
+                }
+
+                HashSet<string> midxPackStems = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+                string midxPath = Path.Combine(packDir, "multi-pack-index");
+                if (File.Exists(midxPath))
+                {
+                    MidxReader midxReader = new MidxReader(midxPath);
+                    this.midxReaders.Add(midxReader);
+                    midxPackStems = midxReader.GetPackStems();
+
+                    // MIDX files are probed before any of the idx files
+                    indexPaths.Insert(this.midxReaders.Count - 1, midxPath);
+                }
+
+                foreach (string idxPath in Directory.GetFiles(packDir, "*.idx"))
+                {
+                    if (!midxPackStems.Contains(Path.GetFileNameWithoutExtension(idxPath)))
+                    {
+                        this.packIndexReaders.Add(new PackIndexReader(idxPath));
+                        indexPaths.Add(idxPath);
+                    }
+
+                    // Every pack has an idx, whether or not the MIDX covers it, so the idx files are
+                    // where the objects that exist are sampled from
+                    sampledOids.Add(ReadOidSample(idxPath));
+                }
+            }
+
+            if (!NativeObjectIndexSet.TryOpen(tracer, indexPaths, out this.nativeIndexes))
+            {
+                Console.WriteLine("GVFS.ObjectLookup is not available, only the managed readers will be measured");
+            }
+
+            int existingCount = 0;
+            foreach (byte[] sample in sampledOids)
+            {
+                existingCount += sample.Length / OidLength;
+            }
+
+            this.lookupCount = existingCount * 2;
+            this.expectedFound = existingCount;
+            this.lookups = new byte[this.lookupCount * OidLength];
+
+            // Interleave existing and (almost certainly) missing objects
+            Random random = new Random(42);
+            int lookupIndex = 0;
+            foreach (byte[] sample in sampledOids)
+            {
+                for (int i = 0; i < sample.Length; i += OidLength)
+                {
+                    Buffer.BlockCopy(sample, i, this.lookups, lookupIndex * OidLength, OidLength);
+                    random.NextBytes(this.lookups.AsSpan((lookupIndex + 1) * OidLength, OidLength));
+                    lookupIndex += 2;
+                }
+            }
+
+            Console.WriteLine($"Pack index lookups: {this.midxReaders.Count} MIDX, {this.packIndexReaders.Count} idx not covered by a MIDX, {this.lookupCount:N0} lookups");
+        }
+
+        public void LookupManaged()
+        {
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            int found = 0;
+            for (int i = 0; i < this.lookupCount; ++i)
+            {
+                ReadOnlySpan<byte> oid = this.lookups.AsSpan(i * OidLength, OidLength);
+                if (this.ExistsManaged(oid))
+                {
+                    ++found;
+                }
+            }
+
+            this.Report("Managed", stopwatch, found);
+        }
+
+        public void LookupNative()
+        {
+            if (this.nativeIndexes == null)
+            {
+                return;
+            }
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            int found = 0;
+            for (int i = 0; i < this.lookupCount; ++i)
+            {
+                if (this.nativeIndexes.Exists(this.lookups.AsSpan(i * OidLength, OidLength)))
+                {
+                    ++found;
+                }
+            }
+
+            this.Report("Native", stopwatch, found);
+        }
+
+        public void LookupNativeBatched()
+        {
+            if (this.nativeIndexes == null)
+            {
+                return;
+            }
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            byte[] results = new byte[this.lookupCount];
+            int found = this.nativeIndexes.ExistsMany(this.lookups, results);
+            this.Report("Native batched", stopwatch, found);
+        }
+
+        public void Dispose()
+        {
+            this.nativeIndexes?.Dispose();
+            this.midxReaders.ForEach(reader => reader.Dispose());
+            this.packIndexReaders.ForEach(reader => reader.Dispose());
+        }
+
+        private static byte[] ReadOidSample(string idxPath)
+        {
+            // idx v2: signature(4) version(4) fanout(256 * 4) OIDs(count * 20) ...
+            const int FanoutOffset = 8;
+            const int OidTableOffset = FanoutOffset + (256 * 4);
+
+            using (FileStream stream = new FileStream(idxPath, FileMode.Open, FileAccess.Read, FileShare.Read | FileShare.Delete))
+            {
+                byte[] header = new byte[OidTableOffset];
+                stream.ReadExactly(header);
+                int count = (int)BinaryPrimitives.ReadUInt32BigEndian(header.AsSpan(FanoutOffset + (255 * 4)));
+                int sampleCount = Math.Min(count, SampledObjectsPerIndex);
+
+                byte[] sample = new byte[sampleCount * OidLength];
+                for (int i = 0; i < sampleCount; ++i)
+                {
+                    long entry = (long)i * count / sampleCount;
+                    stream.Position = OidTableOffset + (entry * OidLength);
+                    stream.ReadExactly(sample, i * OidLength, OidLength);
+                }
+
+                return sample;
+            }
+        }
+
+        private bool ExistsManaged(ReadOnlySpan<byte> oid)
+        {
+            foreach (MidxReader reader in this.midxReaders)
+            {
+                if (reader.Exists(oid))
+                {
+                    return true;
+                }
+            }
+
+            foreach (PackIndexReader reader in this.packIndexReaders)
+            {
+                if (reader.Exists(oid))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        private void Report(string name, Stopwatch stopwatch, int found)
+        {
+            stopwatch.Stop();
+            double nanosecondsPerLookup = stopwatch.Elapsed.TotalMilliseconds * 1_000_000 / Math.Max(1, this.lookupCount);
+            Console.WriteLine($"{name} pack index lookups: {nanosecondsPerLookup:N1} ns/lookup, found {found:N0} of {this.expectedFound:N0} expected");
+        }
+    }
+}
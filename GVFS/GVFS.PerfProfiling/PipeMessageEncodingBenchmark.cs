@@ -0,0 +1,228 @@
+﻿using GVFS.Common.NamedPipes;
+using GVFS.Common.Tracing;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Text;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Compares the text and binary encodings of the lock messages sent by the git hooks, both on their own
+    /// (encode and decode of a request and its response, with the allocations of each) and end to end over a
+    /// <see cref="NamedPipeServer"/> that replies to every request without doing any work.  The end to end
+    /// measurement connects a new client for each request, as a hook process does, but does not include the
+    /// time to start the hook process.
+    /// </summary>
+    internal class PipeMessageEncodingBenchmark : IDisposable
+    {
+        private const int EncodeIterations = 100000;
+        private const int RoundTripIterations = 2000;
+        private const string ParsedCommand = "git status --serialize=C:\\Repos\\src\\.git\\status.tmp --ignored=matching --untracked-files=complete";
+        private const string GitCommandSessionId = "20260101_120000_00000000-0000-0000-0000-000000000000";
+
+        private readonly string pipeName;
+        private readonly NamedPipeServer server;
+        private readonly NamedPipeMessages.LockData requester;
+        private readonly NamedPipeMessages.LockData holder;
+
+        public PipeMessageEncodingBenchmark()
+        {
+            this.requester = new NamedPipeMessages.LockData(Environment.ProcessId, false, false, ParsedCommand, GitCommandSessionId);
+            this.holder = new NamedPipeMessages.LockData(Environment.ProcessId + 1, false, false, "git rebase --continue", GitCommandSessionId);
+
+            this.pipeName = "GVFS_PerfProfiling_" + Guid.NewGuid().ToString("N");
+            this.server = NamedPipeServer.StartNewServer(this.pipeName, NullTracer.Instance, this.HandleRequest, handleBinaryRequest: this.HandleBinaryRequest);
+        }
+
+        public void EncodeAndDecodeText()
+        {
+            long allocatedBefore = GC.GetAllocatedBytesForCurrentThread();
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            for (int i = 0; i < EncodeIterations; ++i)
+            {
+                // Client: request
+                NamedPipeMessages.LockRequest request = new NamedPipeMessages.LockRequest(this.requester.PID, false, false, ParsedCommand, GitCommandSessionId);
+                byte[] requestBytes = Encoding.UTF8.GetBytes(request.CreateMessage(NamedPipeMessages.AcquireLock.AcquireRequest).ToString());
+
+                // Server: decode the request and encode the response
+                NamedPipeMessages.Message requestMessage = NamedPipeMessages.Message.FromString(Encoding.UTF8.GetString(requestBytes));
+                NamedPipeMessages.LockData requestData = new NamedPipeMessages.LockRequest(requestMessage.Body).RequestData;
+                NamedPipeMessages.AcquireLock.Response response = new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.DenyGitResult, this.holder);
+                byte[] responseBytes = Encoding.UTF8.GetBytes(response.CreateMessage().ToString());
+
+                // Client: decode the response
+                NamedPipeMessages.AcquireLock.Response readResponse = new NamedPipeMessages.AcquireLock.Response(
+                    NamedPipeMessages.Message.FromString(Encoding.UTF8.GetString(responseBytes)));
+                CheckResponse(requestData, readResponse);
+            }
+
+            stopwatch.Stop();
+            ReportEncoding("text", stopwatch.Elapsed, GC.GetAllocatedBytesForCurrentThread() - allocatedBefore);
+        }
+
+        public void EncodeAndDecodeBinary()
+        {
+            NamedPipeMessages.Binary.LockRequestMessage request = new NamedPipeMessages.Binary.LockRequestMessage(NamedPipeMessages.Binary.MessageType.AcquireLockRequest, this.requester);
+            NamedPipeMessages.AcquireLock.Response response = new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.DenyGitResult, this.holder);
+
+            using (BinaryMessageWriter clientWriter = new BinaryMessageWriter())
+            using (BinaryMessageWriter serverWriter = new BinaryMessageWriter())
+            {
+                long allocatedBefore = GC.GetAllocatedBytesForCurrentThread();
+                Stopwatch stopwatch = Stopwatch.StartNew();
+                for (int i = 0; i < EncodeIterations; ++i)
+                {
+                    // Client: request
+                    clientWriter.Reset();
+                    request.WriteBinary(clientWriter);
+                    ReadOnlySpan<byte> requestFrame = clientWriter.GetFrame();
+
+                    // Server: decode the request and encode the response
+                    BinaryMessageReader requestReader = new BinaryMessageReader(requestFrame.Slice(BinaryMessageWriter.FrameHeaderLength));
+                    NamedPipeMessages.Binary.ReadHeader(ref requestReader, NamedPipeMessages.Binary.MessageType.AcquireLockRequest);
+                    NamedPipeMessages.LockData requestData = NamedPipeMessages.Binary.LockRequestMessage.ReadRequestData(ref requestReader);
+                    serverWriter.Reset();
+                    response.WriteBinary(serverWriter);
+
+                    // Client: decode the response
+                    NamedPipeMessages.AcquireLock.Response readResponse = NamedPipeMessages.AcquireLock.Response.FromBinary(
+                        serverWriter.GetFrame().Slice(BinaryMessageWriter.FrameHeaderLength));
+                    CheckResponse(requestData, readResponse);
+                }
+
+                stopwatch.Stop();
+                ReportEncoding("binary", stopwatch.Elapsed, GC.GetAllocatedBytesForCurrentThread() - allocatedBefore);
+            }
+        }
+
+        public void LockRoundTripText()
+        {
+            this.MeasureRoundTrips(
+                "text",
+                pipeClient =>
+                {
+                    NamedPipeMessages.LockRequest request = new NamedPipeMessages.LockRequest(this.requester.PID, false, false, ParsedCommand, GitCommandSessionId);
+                    pipeClient.SendRequest(request.CreateMessage(NamedPipeMessages.AcquireLock.AcquireRequest));
+                    new NamedPipeMessages.AcquireLock.Response(pipeClient.ReadResponse());
+                },
+                pipeClient =>
+                {
+                    NamedPipeMessages.LockRequest request = new NamedPipeMessages.LockRequest(this.requester.PID, false, false, ParsedCommand, string.Empty);
+                    pipeClient.SendRequest(request.CreateMessage(NamedPipeMessages.ReleaseLock.Request));
+                    new NamedPipeMessages.ReleaseLock.Response(pipeClient.ReadResponse());
+                });
+        }
+
+        public void LockRoundTripBinary()
+        {
+            NamedPipeMessages.Binary.LockRequestMessage acquireRequest = new NamedPipeMessages.Binary.LockRequestMessage(NamedPipeMessages.Binary.MessageType.AcquireLockRequest, this.requester);
+            NamedPipeMessages.Binary.LockRequestMessage releaseRequest = new NamedPipeMessages.Binary.LockRequestMessage(NamedPipeMessages.Binary.MessageType.ReleaseLockRequest, this.requester);
+            this.MeasureRoundTrips(
+                "binary",
+                pipeClient =>
+                {
+                    pipeClient.SendBinaryRequest(acquireRequest);
+                    NamedPipeMessages.AcquireLock.Response.FromBinary(pipeClient.ReadResponseFrame().Binary.Span);
+                },
+                pipeClient =>
+                {
+                    pipeClient.SendBinaryRequest(releaseRequest);
+                    NamedPipeMessages.ReleaseLock.Response.FromBinary(pipeClient.ReadResponseFrame().Binary.Span);
+                });
+        }
+
+        public void Dispose()
+        {
+            this.server.Dispose();
+        }
+
+        private static void CheckResponse(NamedPipeMessages.LockData requestData, NamedPipeMessages.AcquireLock.Response response)
+        {
+            if (requestData.ParsedCommand != ParsedCommand || response.ResponseData == null)
+            {
+                throw new InvalidOperationException("Messages were not decoded correctly");
+            }
+        }
+
+        private static void ReportEncoding(string encoding, TimeSpan elapsed, long allocatedBytes)
+        {
+            Console.WriteLine(
+                $"Encoded and decoded {EncodeIterations:N0} AcquireLock requests and responses as {encoding}: " +
+                $"{elapsed.TotalMilliseconds * 1000 / EncodeIterations:N2} us and {allocatedBytes / EncodeIterations:N0} bytes allocated per request");
+        }
+
+        private static double Percentile(List<double> sortedValues, double percentile)
+        {
+            return sortedValues[Math.Min(sortedValues.Count - 1, (int)(sortedValues.Count * percentile))];
+        }
+
+        private void MeasureRoundTrips(string encoding, Action<NamedPipeClient> acquire, Action<NamedPipeClient> release)
+        {
+            List<double> acquireTimes = new List<double>(RoundTripIterations);
+            List<double> releaseTimes = new List<double>(RoundTripIterations);
+            for (int i = 0; i < RoundTripIterations; ++i)
+            {
+                acquireTimes.Add(this.TimeRequest(acquire));
+                releaseTimes.Add(this.TimeRequest(release));
+            }
+
+            foreach (KeyValuePair<string, List<double>> times in new[] { KeyValuePair.Create("AcquireLock", acquireTimes), KeyValuePair.Create("ReleaseLock", releaseTimes) })
+            {
+                times.Value.Sort();
+                Console.WriteLine(
+                    $"{times.Key} ({encoding}) connect and round trip over {RoundTripIterations:N0} requests: " +
+                    $"P50 {Percentile(times.Value, 0.5):N1} us, P90 {Percentile(times.Value, 0.9):N1} us, " +
+                    $"P99 {Percentile(times.Value, 0.99):N1} us, average {times.Value.Average():N1} us");
+            }
+        }
+
+        private double TimeRequest(Action<NamedPipeClient> sendRequest)
+        {
+            // A new connection for each request, as each hook is a new process
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            using (NamedPipeClient pipeClient = new NamedPipeClient(this.pipeName))
+            {
+                if (!pipeClient.Connect())
+                {
+                    throw new InvalidOperationException("Unable to connect to " + this.pipeName);
+                }
+
+                sendRequest(pipeClient);
+            }
+
+            return stopwatch.Elapsed.TotalMilliseconds * 1000;
+        }
+
+        private void HandleRequest(ITracer tracer, string request, NamedPipeServer.Connection connection)
+        {
+            // The request is decoded, although it is not used, so that its cost is included
+            NamedPipeMessages.Message message = NamedPipeMessages.Message.FromString(request);
+            new NamedPipeMessages.LockRequest(message.Body);
+            if (message.Header == NamedPipeMessages.AcquireLock.AcquireRequest)
+            {
+                connection.TrySendResponse(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.AcceptResult).CreateMessage());
+            }
+            else
+            {
+                connection.TrySendResponse(new NamedPipeMessages.ReleaseLock.Response(NamedPipeMessages.ReleaseLock.SuccessResult).CreateMessage());
+            }
+        }
+
+        private void HandleBinaryRequest(ITracer tracer, ReadOnlyMemory<byte> request, NamedPipeServer.Connection connection)
+        {
+            BinaryMessageReader reader = new BinaryMessageReader(request.Span);
+            NamedPipeMessages.Binary.MessageType type = NamedPipeMessages.Binary.ReadHeader(ref reader, out byte _);
+            NamedPipeMessages.Binary.LockRequestMessage.ReadRequestData(ref reader);
+            if (type == NamedPipeMessages.Binary.MessageType.AcquireLockRequest)
+            {
+                connection.TrySendBinaryResponse(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.AcceptResult));
+            }
+            else
+            {
+                connection.TrySendBinaryResponse(new NamedPipeMessages.ReleaseLock.Response(NamedPipeMessages.ReleaseLock.SuccessResult));
+            }
+        }
+    }
+}
@@ -0,0 +1,171 @@
+﻿using GVFS.Common;
+using GVFS.Common.Git;
+using GVFS.Common.NetworkStreams;
+using System;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Measures how long it takes to receive and index the packs of an application/x-gvfs-timestamped-packfiles-indexes
+    /// (GPRE) response, either by running git index-pack once each pack has been written or by indexing the pack
+    /// with <see cref="StreamingPackIndexer"/> while it is written.  The response is replayed from a file so that
+    /// the network is not part of the measurement, either a response recorded from a cache server (the body of a
+    /// GET to gvfs/prefetch) or one created from the prefetch packs already in the enlistment.
+    /// </summary>
+    internal class PrefetchPackIndexBenchmark : IDisposable
+    {
+        private const long MaxSyntheticResponseBytes = 1024L * 1024 * 1024;
+
+        private readonly GVFSEnlistment enlistment;
+        private readonly string responsePath;
+        private readonly bool deleteResponse;
+        private readonly string packsRoot;
+        private int runCount;
+
+        public PrefetchPackIndexBenchmark(GVFSEnlistment enlistment, string recordedResponsePath)
+        {
+            this.enlistment = enlistment;
+            this.packsRoot = Path.Combine(Path.GetTempPath(), "GVFS.PerfProfiling.PrefetchPacks." + Guid.NewGuid().ToString("N"));
+            Directory.CreateDirectory(this.packsRoot);
+
+            if (!string.IsNullOrEmpty(recordedResponsePath))
+            {
+                this.responsePath = recordedResponsePath;
+            }
+            else
+            {
+                this.responsePath = this.packsRoot + ".response";
+                this.deleteResponse = true;
+
+                int packCount = CreateResponseFromPrefetchPacks(enlistment.GitPackRoot, this.responsePath);
+                Console.WriteLine($"Created response with {packCount} prefetch pack(s) ({new FileInfo(this.responsePath).Length:N0} bytes) from {enlistment.GitPackRoot}");
+            }
+        }
+
+        public void IndexPacksWithGit()
+        {
+            this.ReceivePacks(streaming: false);
+        }
+
+        public void IndexPacksWhileStreaming()
+        {
+            this.ReceivePacks(streaming: true);
+        }
+
+        public void Dispose()
+        {
+            Directory.Delete(this.packsRoot, recursive: true);
+            if (this.deleteResponse)
+            {
+                File.Delete(this.responsePath);
+            }
+        }
+
+        private static int CreateResponseFromPrefetchPacks(string packRoot, string path)
+        {
+            // Oldest first, as the server sends them, up to a total size that keeps each run reasonably short
+            string[] packs = Directory.GetFiles(packRoot, GVFSConstants.PrefetchPackPrefix + "*.pack")
+                .OrderBy(pack => pack, StringComparer.OrdinalIgnoreCase)
+                .ToArray();
+
+            long totalBytes = 0;
+            int packCount = 0;
+            while (packCount < packs.Length && (packCount == 0 || totalBytes + new FileInfo(packs[packCount]).Length <= MaxSyntheticResponseBytes))
+            {
+                totalBytes += new FileInfo(packs[packCount]).Length;
+                ++packCount;
+            }
+
+            using (FileStream response = File.Create(path))
+            {
+                response.Write(new byte[] { (byte)'G', (byte)'P', (byte)'R', (byte)'E', (byte)' ', 1 });
+                response.Write(BitConverter.GetBytes((ushort)packCount));
+                for (int i = 0; i < packCount; ++i)
+                {
+                    using (FileStream pack = File.OpenRead(packs[i]))
+                    {
+                        // Timestamp, pack length and index length, no index is sent so that one has to be built
+                        response.Write(BitConverter.GetBytes((long)i));
+                        response.Write(BitConverter.GetBytes(pack.Length));
+                        response.Write(BitConverter.GetBytes(0L));
+                        pack.CopyTo(response);
+                    }
+                }
+            }
+
+            return packCount;
+        }
+
+        private void ReceivePacks(bool streaming)
+        {
+            // Each run writes into a new folder so that no run reads packs written by an earlier one
+            string runRoot = Path.Combine(this.packsRoot, (this.runCount++).ToString());
+            Directory.CreateDirectory(runRoot);
+
+            int packCount = 0;
+            int objectCount = 0;
+            long bytesReceived = 0;
+            TimeSpan timeToIndexAfterDownload = TimeSpan.Zero;
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            using (FileStream response = new FileStream(this.responsePath, FileMode.Open, FileAccess.Read, FileShare.Read, bufferSize: 64 * 1024))
+            {
+                PrefetchPacksDeserializer deserializer = new PrefetchPacksDeserializer(response);
+                foreach (PrefetchPacksDeserializer.PackAndIndex pack in deserializer.EnumeratePacks())
+                {
+                    string packPath = Path.Combine(runRoot, $"{GVFSConstants.PrefetchPackPrefix}-{pack.Timestamp}-{pack.UniqueId}.pack");
+                    string idxPath = Path.ChangeExtension(packPath, ".idx");
+
+                    using (StreamingPackIndexer indexer = streaming ? new StreamingPackIndexer(packPath) : null)
+                    {
+                        using (FileStream packFile = new FileStream(packPath, FileMode.Create, FileAccess.Write, FileShare.Read))
+                        {
+                            Stream source = streaming ? new SideChannelStream(from: pack.PackStream, to: indexer) : pack.PackStream;
+                            StreamUtil.CopyToWithBuffer(source, packFile);
+                            bytesReceived += packFile.Length;
+                        }
+
+                        pack.IndexStream?.CopyTo(Stream.Null);
+
+                        Stopwatch indexStopwatch = Stopwatch.StartNew();
+                        if (streaming)
+                        {
+                            if (!indexer.TryWriteIndex(idxPath, out string error))
+                            {
+                                throw new InvalidDataException($"Failed to index {packPath}: {error}");
+                            }
+
+                            objectCount += indexer.ObjectCount;
+                        }
+                        else
+                        {
+                            GitProcess.Result result = new GitProcess(this.enlistment).IndexPack(packPath, idxPath);
+                            if (result.ExitCodeIsFailure)
+                            {
+                                throw new InvalidDataException($"Failed to index {packPath}: {result.Errors}");
+                            }
+
+                            using (PackIndexReader reader = new PackIndexReader(idxPath))
+                            {
+                                objectCount += reader.TotalObjects;
+                            }
+                        }
+
+                        timeToIndexAfterDownload += indexStopwatch.Elapsed;
+                    }
+
+                    ++packCount;
+                }
+            }
+
+            stopwatch.Stop();
+            Console.WriteLine(
+                $"Received and indexed {packCount} pack(s) with {objectCount:N0} objects ({bytesReceived:N0} bytes) " +
+                $"{(streaming ? "while streaming" : "with git index-pack")}: {bytesReceived / stopwatch.Elapsed.TotalSeconds / (1024 * 1024):N1} MB/s, " +
+                $"{timeToIndexAfterDownload.TotalMilliseconds:N0} ms spent indexing after the packs were received");
+        }
+    }
+}
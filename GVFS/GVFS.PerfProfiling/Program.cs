@@ -17,6 +17,25 @@ private enum TestsToRun
             ValidateIndex = 1 << 0,
             RebuildProjection = 1 << 1,
             ValidateModifiedPaths = 1 << 2,
+            LookupProjectedPaths = 1 << 3,
+            LookupBlobSizes = 1 << 4,
+            LookupPackIndexesManaged = 1 << 5,
+            LookupPackIndexesNative = 1 << 6,
+            LookupPackIndexesNativeBatched = 1 << 7,
+            WriteLooseObjectsSerial = 1 << 8,
+            WriteLooseObjectsParallel = 1 << 9,
+            IndexPrefetchPacksWithGit = 1 << 10,
+            IndexPrefetchPacksWhileStreaming = 1 << 11,
+            EncodePipeMessagesText = 1 << 12,
+            EncodePipeMessagesBinary = 1 << 13,
+            LockRoundTripText = 1 << 14,
+            LockRoundTripBinary = 1 << 15,
+            DownloadObjectsHttp11 = 1 << 16,
+            DownloadObjectsHttp2 = 1 << 17,
+            DownloadLooseObjects = 1 << 18,
+            DownloadObjectBatches = 1 << 19,
+            DownloadPrefetchPacks = 1 << 20,
+            QueryBlobSizes = 1 << 21,
             All = -1,
         }
 
@@ -39,13 +58,78 @@ private static void Main(string[] args)
                 }
             }
 
+            // Optional application/x-gvfs-loose-objects response to replay, a synthetic one is created if not specified
+            string recordedLooseObjectsResponse = args.Length > 2 ? args[2] : null;
+
+            // Optional application/x-gvfs-timestamped-packfiles-indexes response to replay, one is created from the
+            // enlistment's prefetch packs if not specified
+            string recordedPrefetchResponse = args.Length > 3 ? args[3] : null;
+
+            // GVFS protocol server to download objects from: either the URL of a server, or a bare repo to serve with
+            // a local stand-in server.  The download tests are skipped if not specified, and the tests of every download
+            // path need the stand-in.
+            string objectServer = args.Length > 4 ? args[4] : null;
+            bool useStandInServer = !string.IsNullOrEmpty(objectServer) && Directory.Exists(objectServer);
+            if (string.IsNullOrEmpty(objectServer))
+            {
+                testsToRun &= ~(TestsToRun.DownloadObjectsHttp11 | TestsToRun.DownloadObjectsHttp2);
+            }
+
+            if (!useStandInServer)
+            {
+                testsToRun &= ~(TestsToRun.DownloadLooseObjects | TestsToRun.DownloadObjectBatches | TestsToRun.DownloadPrefetchPacks | TestsToRun.QueryBlobSizes);
+            }
+
+            // Optional latency (in ms) added to every response of the stand-in server, and bandwidth (in MB/s) shared by
+            // all of its responses
+            int standInLatencyMs = args.Length > 5 && int.TryParse(args[5], out int latencyMs) ? latencyMs : 0;
+            int standInBandwidthMBps = args.Length > 6 && int.TryParse(args[6], out int bandwidthMBps) ? bandwidthMBps : 0;
+
             ProfilingEnvironment environment = new ProfilingEnvironment(enlistmentRootPath);
+            string gitBinPath = environment.Enlistment.GitBinPath;
+
+            // The blob sizes benchmark builds its own (large) hash file, only create it when that test is run
+            Lazy<BlobSizesLookupBenchmark> blobSizesBenchmark = new Lazy<BlobSizesLookupBenchmark>(() => new BlobSizesLookupBenchmark(BlobSizesLookupBenchmark.DefaultEntryCount));
+            Lazy<PackIndexLookupBenchmark> packIndexBenchmark = new Lazy<PackIndexLookupBenchmark>(
+                () => new PackIndexLookupBenchmark(environment.Context.Tracer, environment.Enlistment.LocalObjectsRoot, environment.Enlistment.GitObjectsRoot));
+            Lazy<LooseObjectDeserializerBenchmark> looseObjectsBenchmark = new Lazy<LooseObjectDeserializerBenchmark>(
+                () => new LooseObjectDeserializerBenchmark(environment.Context.Tracer, gitBinPath, recordedLooseObjectsResponse));
+            Lazy<PrefetchPackIndexBenchmark> prefetchPacksBenchmark = new Lazy<PrefetchPackIndexBenchmark>(
+                () => new PrefetchPackIndexBenchmark(environment.Enlistment, recordedPrefetchResponse));
+            Lazy<PipeMessageEncodingBenchmark> pipeMessagesBenchmark = new Lazy<PipeMessageEncodingBenchmark>(() => new PipeMessageEncodingBenchmark());
+            Lazy<GVFSProtocolStandInServer> standInServer = new Lazy<GVFSProtocolStandInServer>(
+                () => new GVFSProtocolStandInServer(gitBinPath, objectServer, TimeSpan.FromMilliseconds(standInLatencyMs), standInBandwidthMBps * 1024L * 1024));
+            Lazy<ObjectDownloadBenchmark> objectDownloadBenchmark = new Lazy<ObjectDownloadBenchmark>(
+                () => useStandInServer
+                    ? new ObjectDownloadBenchmark(standInServer.Value.HttpsUrl, standInServer.Value.ObjectStore.GetObjectIds("blob", ObjectDownloadBenchmark.DownloadCount))
+                    : new ObjectDownloadBenchmark(objectServer, ObjectDownloadBenchmark.ReadObjectIds(environment.Enlistment.GitObjectsRoot)));
+            Lazy<DownloadPathsBenchmark> downloadPathsBenchmark = new Lazy<DownloadPathsBenchmark>(
+                () => new DownloadPathsBenchmark(standInServer.Value, gitBinPath, environment.Context.Tracer));
 
             Dictionary<TestsToRun, Action> allTests = new Dictionary<TestsToRun, Action>
             {
                 { TestsToRun.ValidateIndex, () => GitIndexProjection.ReadIndex(environment.Context.Tracer, Path.Combine(environment.Enlistment.WorkingDirectoryRoot, GVFSConstants.DotGit.Index)) },
                 { TestsToRun.RebuildProjection, () => environment.FileSystemCallbacks.GitIndexProjectionProfiler.ForceRebuildProjection() },
                 { TestsToRun.ValidateModifiedPaths, () => environment.FileSystemCallbacks.GitIndexProjectionProfiler.ForceAddMissingModifiedPaths(environment.Context.Tracer) },
+                { TestsToRun.LookupProjectedPaths, () => environment.FileSystemCallbacks.GitIndexProjectionProfiler.ForceLookupOfAllProjectedPaths() },
+                { TestsToRun.LookupBlobSizes, () => blobSizesBenchmark.Value.LookupSizes() },
+                { TestsToRun.LookupPackIndexesManaged, () => packIndexBenchmark.Value.LookupManaged() },
+                { TestsToRun.LookupPackIndexesNative, () => packIndexBenchmark.Value.LookupNative() },
+                { TestsToRun.LookupPackIndexesNativeBatched, () => packIndexBenchmark.Value.LookupNativeBatched() },
+                { TestsToRun.WriteLooseObjectsSerial, () => looseObjectsBenchmark.Value.WriteObjectsSerially() },
+                { TestsToRun.WriteLooseObjectsParallel, () => looseObjectsBenchmark.Value.WriteObjectsInParallel() },
+                { TestsToRun.IndexPrefetchPacksWithGit, () => prefetchPacksBenchmark.Value.IndexPacksWithGit() },
+                { TestsToRun.IndexPrefetchPacksWhileStreaming, () => prefetchPacksBenchmark.Value.IndexPacksWhileStreaming() },
+                { TestsToRun.EncodePipeMessagesText, () => pipeMessagesBenchmark.Value.EncodeAndDecodeText() },
+                { TestsToRun.EncodePipeMessagesBinary, () => pipeMessagesBenchmark.Value.EncodeAndDecodeBinary() },
+                { TestsToRun.LockRoundTripText, () => pipeMessagesBenchmark.Value.LockRoundTripText() },
+                { TestsToRun.LockRoundTripBinary, () => pipeMessagesBenchmark.Value.LockRoundTripBinary() },
+                { TestsToRun.DownloadObjectsHttp11, () => objectDownloadBenchmark.Value.DownloadObjectsWithHttp11() },
+                { TestsToRun.DownloadObjectsHttp2, () => objectDownloadBenchmark.Value.DownloadObjectsWithHttp2() },
+                { TestsToRun.DownloadLooseObjects, () => downloadPathsBenchmark.Value.DownloadLooseObjects() },
+                { TestsToRun.DownloadObjectBatches, () => downloadPathsBenchmark.Value.DownloadObjectBatches() },
+                { TestsToRun.DownloadPrefetchPacks, () => downloadPathsBenchmark.Value.DownloadPrefetchPacks() },
+                { TestsToRun.QueryBlobSizes, () => downloadPathsBenchmark.Value.QueryBlobSizes() },
             };
 
             long before = GetMemoryUsage();
@@ -58,6 +142,41 @@ private static void Main(string[] args)
                 }
             }
 
+            if (blobSizesBenchmark.IsValueCreated)
+            {
+                blobSizesBenchmark.Value.Dispose();
+            }
+
+            if (packIndexBenchmark.IsValueCreated)
+            {
+                packIndexBenchmark.Value.Dispose();
+            }
+
+            if (looseObjectsBenchmark.IsValueCreated)
+            {
+                looseObjectsBenchmark.Value.Dispose();
+            }
+
+            if (prefetchPacksBenchmark.IsValueCreated)
+            {
+                prefetchPacksBenchmark.Value.Dispose();
+            }
+
+            if (pipeMessagesBenchmark.IsValueCreated)
+            {
+                pipeMessagesBenchmark.Value.Dispose();
+            }
+
+            if (downloadPathsBenchmark.IsValueCreated)
+            {
+                downloadPathsBenchmark.Value.Dispose();
+            }
+
+            if (standInServer.IsValueCreated)
+            {
+                standInServer.Value.Dispose();
+            }
+
             long after = GetMemoryUsage();
 
             Console.WriteLine($"Memory Usage: {FormatByteCount(after - before)}");
@@ -84,15 +203,20 @@ private static void TimeIt(string name, Action action)
             {
                 long before = GetMemoryUsage();
 
+                // Gen2 collections are counted around the action only, GetMemoryUsage forces its own collections
+                int gen2CollectionsBefore = GC.CollectionCount(2);
                 Stopwatch stopwatch = Stopwatch.StartNew();
                 action();
                 stopwatch.Stop();
+                int gen2Collections = GC.CollectionCount(2) - gen2CollectionsBefore;
 
                 long after = GetMemoryUsage();
 
                 times.Add(stopwatch.Elapsed);
                 Console.WriteLine($"Time: {stopwatch.Elapsed.TotalMilliseconds} ms");
                 Console.WriteLine($"New allocations: {FormatByteCount(after - before)}");
+                Console.WriteLine($"Managed heap size: {FormatByteCount(GC.GetTotalMemory(forceFullCollection: false))}");
+                Console.WriteLine($"Gen2 collections: {gen2Collections}");
             }
 
             Console.WriteLine();
@@ -0,0 +1,58 @@
+﻿using GVFS.Common;
+using GVFS.Common.Git;
+using System;
+using System.IO;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// A repo outside of any enlistment that the benchmarks write objects to.  It is created in the temp folder and
+    /// deleted by <see cref="Delete"/>.
+    /// </summary>
+    internal class ScratchEnlistment : Enlistment
+    {
+        private ScratchEnlistment(string root, string gitBinPath, string repoUrl)
+            : base(root, root, root, repoUrl, gitBinPath, flushFileBuffersForPacks: false, authentication: null)
+        {
+            this.GitObjectsRoot = Path.Combine(root, GVFSConstants.DotGit.Objects.Root);
+            this.LocalObjectsRoot = this.GitObjectsRoot;
+            this.GitPackRoot = Path.Combine(this.GitObjectsRoot, GVFSConstants.DotGit.Objects.Pack.Name);
+        }
+
+        public override string GitObjectsRoot { get; protected set; }
+
+        public override string LocalObjectsRoot { get; protected set; }
+
+        public override string GitPackRoot { get; protected set; }
+
+        /// <param name="repoUrl">The origin that objects are downloaded from, empty if none are downloaded</param>
+        public static ScratchEnlistment Create(string gitBinPath, string repoUrl)
+        {
+            string root = Path.Combine(Path.GetTempPath(), "GVFS.PerfProfiling.Scratch." + Guid.NewGuid().ToString("N"));
+            Directory.CreateDirectory(root);
+
+            ScratchEnlistment enlistment = new ScratchEnlistment(root, gitBinPath, repoUrl);
+            GitProcess.Result result = GitProcess.Init(enlistment);
+            if (result.ExitCodeIsFailure)
+            {
+                throw new InvalidOperationException($"Failed to create a repo in {root}: {result.Errors}");
+            }
+
+            return enlistment;
+        }
+
+        /// <summary>
+        /// Deletes all of the objects in the repo
+        /// </summary>
+        public void ResetObjects()
+        {
+            Directory.Delete(this.GitObjectsRoot, recursive: true);
+            Directory.CreateDirectory(this.GitPackRoot);
+        }
+
+        public void Delete()
+        {
+            Directory.Delete(this.PrimaryEnlistmentRoot, recursive: true);
+        }
+    }
+}
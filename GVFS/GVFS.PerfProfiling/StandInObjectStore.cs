@@ -0,0 +1,382 @@
+﻿using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.IO.Compression;
+using System.Linq;
+using System.Text;
+using System.Threading;
+
+namespace GVFS.PerfProfiling
+{
+    /// <summary>
+    /// Reads the objects that <see cref="GVFSProtocolStandInServer"/> serves from a local bare repo, using a pool of
+    /// long running git cat-file processes for single objects and git pack-objects for packs.  Compressed loose objects
+    /// are cached, up to <see cref="MaxCachedBytes"/>, so that repeated benchmark runs do not measure the compression
+    /// a cache server does not do on every request.
+    /// </summary>
+    internal class StandInObjectStore : IDisposable
+    {
+        private const long MaxCachedBytes = 1024L * 1024 * 1024;
+
+        private readonly string gitBinPath;
+        private readonly string bareRepoPath;
+        private readonly string tempRoot;
+        private readonly ConcurrentBag<CatFileProcess> idleProcesses = new ConcurrentBag<CatFileProcess>();
+        private readonly ConcurrentDictionary<string, byte[]> compressedObjects = new ConcurrentDictionary<string, byte[]>(StringComparer.OrdinalIgnoreCase);
+        private readonly Lazy<PrefetchPack> prefetchPack;
+        private long cachedBytes;
+
+        public StandInObjectStore(string gitBinPath, string bareRepoPath)
+        {
+            if (!Directory.Exists(Path.Combine(bareRepoPath, "objects")))
+            {
+                throw new ArgumentException($"{bareRepoPath} is not a bare repo", nameof(bareRepoPath));
+            }
+
+            this.gitBinPath = gitBinPath;
+            this.bareRepoPath = bareRepoPath;
+            this.tempRoot = Path.Combine(Path.GetTempPath(), "GVFS.PerfProfiling.StandIn." + Guid.NewGuid().ToString("N"));
+            Directory.CreateDirectory(this.tempRoot);
+
+            this.prefetchPack = new Lazy<PrefetchPack>(this.CreatePrefetchPack, LazyThreadSafetyMode.ExecutionAndPublication);
+        }
+
+        /// <summary>
+        /// Returns up to <paramref name="maxCount"/> ids of the objects of <paramref name="objectType"/> in the repo.
+        /// </summary>
+        public string[] GetObjectIds(string objectType, int maxCount)
+        {
+            List<string> objectIds = new List<string>();
+            using (Process git = this.StartGit("cat-file --batch-all-objects --unordered --batch-check=\"%(objecttype) %(objectname)\"", redirectStdin: false))
+            {
+                string line;
+                while (objectIds.Count < maxCount && (line = git.StandardOutput.ReadLine()) != null)
+                {
+                    int space = line.IndexOf(' ');
+                    if (space > 0 && string.Equals(line.Substring(0, space), objectType, StringComparison.Ordinal))
+                    {
+                        objectIds.Add(line.Substring(space + 1));
+                    }
+                }
+
+                if (!git.HasExited)
+                {
+                    git.Kill();
+                }
+
+                git.WaitForExit();
+            }
+
+            return objectIds.ToArray();
+        }
+
+        /// <summary>
+        /// Gets the object in the compressed loose object format, which is what GET gvfs/objects/{id} returns and what
+        /// the application/x-gvfs-loose-objects format contains for each object.
+        /// </summary>
+        public bool TryGetLooseObject(string objectId, out byte[] compressedObject)
+        {
+            if (this.compressedObjects.TryGetValue(objectId, out compressedObject))
+            {
+                return true;
+            }
+
+            using (MemoryStream compressed = new MemoryStream())
+            {
+                bool found = this.UseCatFile(catFile =>
+                {
+                    if (!catFile.TryStartContents(objectId, out string type, out long size))
+                    {
+                        return false;
+                    }
+
+                    using (ZLibStream zlib = new ZLibStream(compressed, CompressionLevel.Fastest, leaveOpen: true))
+                    {
+                        zlib.Write(Encoding.ASCII.GetBytes($"{type} {size}\0"));
+                        catFile.CopyContents(size, zlib);
+                    }
+
+                    return true;
+                });
+
+                if (!found)
+                {
+                    compressedObject = null;
+                    return false;
+                }
+
+                compressedObject = compressed.ToArray();
+            }
+
+            if (Interlocked.Add(ref this.cachedBytes, compressedObject.Length) <= MaxCachedBytes)
+            {
+                this.compressedObjects.TryAdd(objectId, compressedObject);
+            }
+            else
+            {
+                Interlocked.Add(ref this.cachedBytes, -compressedObject.Length);
+            }
+
+            return true;
+        }
+
+        public bool TryGetSize(string objectId, out long size)
+        {
+            long objectSize = 0;
+            bool found = this.UseCatFile(catFile => catFile.TryGetInfo(objectId, out string _, out objectSize));
+            size = objectSize;
+            return found;
+        }
+
+        /// <summary>
+        /// Writes a pack with the requested objects to <paramref name="destination"/>.  A commit is sent with its trees,
+        /// and its ancestors (and their trees) up to <paramref name="commitDepth"/> commits deep, but without blobs.
+        /// </summary>
+        public void WritePack(IEnumerable<string> objectIds, int commitDepth, Stream destination)
+        {
+            List<string> packObjects = new List<string>();
+            foreach (string objectId in objectIds)
+            {
+                string type = null;
+                this.UseCatFile(catFile => catFile.TryGetInfo(objectId, out type, out long _));
+                if (type == "commit")
+                {
+                    using (Process revList = this.StartGit($"rev-list --objects --no-object-names --filter=blob:none --max-count={Math.Max(commitDepth, 1)} {objectId}", redirectStdin: false))
+                    {
+                        string line;
+                        while ((line = revList.StandardOutput.ReadLine()) != null)
+                        {
+                            packObjects.Add(line.Trim());
+                        }
+
+                        revList.WaitForExit();
+                    }
+                }
+                else if (type != null)
+                {
+                    packObjects.Add(objectId);
+                }
+            }
+
+            using (Process packObjectsProcess = this.StartGit("pack-objects --stdout --quiet", redirectStdin: true))
+            {
+                foreach (string objectId in packObjects.Distinct(StringComparer.OrdinalIgnoreCase))
+                {
+                    packObjectsProcess.StandardInput.WriteLine(objectId);
+                }
+
+                packObjectsProcess.StandardInput.Close();
+                packObjectsProcess.StandardOutput.BaseStream.CopyTo(destination);
+                packObjectsProcess.WaitForExit();
+            }
+        }
+
+        /// <summary>
+        /// Gets the packs that a prefetch with <paramref name="lastPackTimestamp"/> should return.  The stand-in has a
+        /// single prefetch pack, with every commit and tree in the repo, that is created on the first prefetch.
+        /// </summary>
+        public IEnumerable<PrefetchPack> GetPrefetchPacks(long lastPackTimestamp)
+        {
+            PrefetchPack pack = this.prefetchPack.Value;
+            if (pack.Timestamp > lastPackTimestamp)
+            {
+                yield return pack;
+            }
+        }
+
+        public void Dispose()
+        {
+            while (this.idleProcesses.TryTake(out CatFileProcess catFile))
+            {
+                catFile.Dispose();
+            }
+
+            Directory.Delete(this.tempRoot, recursive: true);
+        }
+
+        private PrefetchPack CreatePrefetchPack()
+        {
+            string packPrefix = Path.Combine(this.tempRoot, "prefetch");
+            string packHash;
+            using (Process revList = this.StartGit("rev-list --objects --no-object-names --filter=blob:none --all", redirectStdin: false))
+            using (Process packObjects = this.StartGit($"pack-objects --quiet \"{packPrefix}\"", redirectStdin: true))
+            {
+                string line;
+                while ((line = revList.StandardOutput.ReadLine()) != null)
+                {
+                    packObjects.StandardInput.WriteLine(line.Trim());
+                }
+
+                packObjects.StandardInput.Close();
+                packHash = packObjects.StandardOutput.ReadToEnd().Trim();
+                revList.WaitForExit();
+                packObjects.WaitForExit();
+                if (packObjects.ExitCode != 0 || string.IsNullOrEmpty(packHash))
+                {
+                    throw new InvalidOperationException($"Failed to create the prefetch pack for {this.bareRepoPath}, git pack-objects exited with {packObjects.ExitCode}");
+                }
+            }
+
+            return new PrefetchPack(
+                DateTimeOffset.UtcNow.ToUnixTimeSeconds(),
+                $"{packPrefix}-{packHash}.pack",
+                $"{packPrefix}-{packHash}.idx");
+        }
+
+        private bool UseCatFile(Func<CatFileProcess, bool> action)
+        {
+            if (!this.idleProcesses.TryTake(out CatFileProcess catFile))
+            {
+                catFile = new CatFileProcess(this.StartGit("cat-file --batch-command", redirectStdin: true));
+            }
+
+            bool completed = false;
+            try
+            {
+                bool result = action(catFile);
+                completed = true;
+                return result;
+            }
+            finally
+            {
+                // A process that failed part way through an object has output left to read, and cannot be reused
+                if (completed)
+                {
+                    this.idleProcesses.Add(catFile);
+                }
+                else
+                {
+                    catFile.Dispose();
+                }
+            }
+        }
+
+        private Process StartGit(string arguments, bool redirectStdin)
+        {
+            ProcessStartInfo startInfo = new ProcessStartInfo(this.gitBinPath, $"--git-dir=\"{this.bareRepoPath}\" {arguments}")
+            {
+                UseShellExecute = false,
+                CreateNoWindow = true,
+                RedirectStandardInput = redirectStdin,
+                RedirectStandardOutput = true,
+                RedirectStandardError = true,
+            };
+
+            Process process = Process.Start(startInfo);
+
+            // Errors are only read once the process exits, drain them so that git cannot block on a full stderr pipe
+            process.ErrorDataReceived += (sender, args) => { };
+            process.BeginErrorReadLine();
+            return process;
+        }
+
+        public class PrefetchPack
+        {
+            public PrefetchPack(long timestamp, string packPath, string idxPath)
+            {
+                this.Timestamp = timestamp;
+                this.PackPath = packPath;
+                this.IdxPath = idxPath;
+            }
+
+            public long Timestamp { get; }
+            public string PackPath { get; }
+            public string IdxPath { get; }
+        }
+
+        private class CatFileProcess : IDisposable
+        {
+            private readonly Process process;
+            private readonly BufferedStream output;
+
+            public CatFileProcess(Process process)
+            {
+                this.process = process;
+                this.process.StandardInput.AutoFlush = true;
+                this.output = new BufferedStream(process.StandardOutput.BaseStream, 64 * 1024);
+            }
+
+            public bool TryGetInfo(string objectId, out string type, out long size)
+            {
+                this.process.StandardInput.Write($"info {objectId}\n");
+                return this.TryReadHeader(out type, out size);
+            }
+
+            public bool TryStartContents(string objectId, out string type, out long size)
+            {
+                this.process.StandardInput.Write($"contents {objectId}\n");
+                return this.TryReadHeader(out type, out size);
+            }
+
+            /// <summary>
+            /// Copies the contents that follow a successful <see cref="TryStartContents"/>.
+            /// </summary>
+            public void CopyContents(long size, Stream destination)
+            {
+                byte[] buffer = new byte[64 * 1024];
+                long remaining = size;
+                while (remaining > 0)
+                {
+                    int bytesRead = this.output.Read(buffer, 0, (int)Math.Min(buffer.Length, remaining));
+                    if (bytesRead == 0)
+                    {
+                        throw new EndOfStreamException("git cat-file exited before sending the object");
+                    }
+
+                    destination.Write(buffer, 0, bytesRead);
+                    remaining -= bytesRead;
+                }
+
+                // The contents are followed by a newline
+                this.output.ReadByte();
+            }
+
+            public void Dispose()
+            {
+                try
+                {
+                    this.process.StandardInput.Close();
+                    if (!this.process.WaitForExit(1000))
+                    {
+                        this.process.Kill();
+                    }
+                }
+                catch (InvalidOperationException)
+                {
+                }
+
+                this.process.Dispose();
+            }
+
+            private bool TryReadHeader(out string type, out long size)
+            {
+                // "<oid> <type> <size>" or "<oid> missing"
+                StringBuilder line = new StringBuilder();
+                int b;
+                while ((b = this.output.ReadByte()) != '\n')
+                {
+                    if (b == -1)
+                    {
+                        throw new EndOfStreamException("git cat-file exited unexpectedly");
+                    }
+
+                    line.Append((char)b);
+                }
+
+                string[] parts = line.ToString().Split(' ');
+                if (parts.Length != 3)
+                {
+                    type = null;
+                    size = -1;
+                    return false;
+                }
+
+                type = parts[1];
+                size = long.Parse(parts[2]);
+                return true;
+            }
+        }
+    }
+}
@@ -836,23 +836,6 @@ protected override void OnPossibleTombstoneFolderCreated(string relativePath)
             this.FileSystemCallbacks.OnPossibleTombstoneFolderCreated(relativePath);
         }
 
-        private static void StreamCopyBlockTo(Stream input, Stream destination, long numBytes, byte[] buffer)
-        {
-            int read;
-            while (numBytes > 0)
-            {
-                int bytesToRead = Math.Min(buffer.Length, (int)numBytes);
-                read = input.Read(buffer, 0, bytesToRead);
-                if (read <= 0)
-                {
-                    break;
-                }
-
-                destination.Write(buffer, 0, read);
-                numBytes -= read;
-            }
-        }
-
         private static bool ProjFSPatternMatchingWorks()
         {
             const char DOSQm = '>';
@@ -1246,10 +1229,9 @@ private HResult QueryFileNameHandler(string virtualPath)
                             throw new GetFileStreamException(HResult.InternalError);
                         }
 
-                        byte[] buffer = new byte[Math.Min(MaxBlobStreamBufferSize, blobLength)];
                         long remainingData = blobLength;
 
-                        using (IWriteBuffer targetBuffer = this.virtualizationInstance.CreateWriteBuffer((uint)buffer.Length))
+                        using (IWriteBuffer targetBuffer = this.virtualizationInstance.CreateWriteBuffer((uint)Math.Min(MaxBlobStreamBufferSize, blobLength)))
                         {
                             while (remainingData > 0)
                             {
@@ -1259,8 +1241,9 @@ private HResult QueryFileNameHandler(string virtualPath)
 
                                 try
                                 {
-                                    targetBuffer.Stream.Seek(0, SeekOrigin.Begin);
-                                    StreamCopyBlockTo(stream, targetBuffer.Stream, bytesToCopy, buffer);
+                                    // The blob is inflated (or copied) directly into the write buffer. A blob that ends early
+                                    // is truncated, which GitRepo detects and reports once the copy returns.
+                                    BlobContentCopier.ReadBlock(stream, targetBuffer.Pointer, (int)bytesToCopy);
                                 }
                                 catch (IOException e)
                                 {
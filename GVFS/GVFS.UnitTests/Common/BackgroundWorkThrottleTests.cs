@@ -0,0 +1,67 @@
+﻿using GVFS.Common;
+using GVFS.Common.Tracing;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+using System;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.UnitTests.Common
+{
+    [TestFixture]
+    public class BackgroundWorkThrottleTests
+    {
+        private static readonly TimeSpan WaitTimeout = TimeSpan.FromSeconds(30);
+
+        [TestCase]
+        public void BackgroundWorkDoesNotWaitWithoutInteractiveWork()
+        {
+            BackgroundWorkThrottle throttle = new BackgroundWorkThrottle();
+            throttle.WaitForInteractiveWork(WaitTimeout).ShouldBeFalse();
+
+            // Interactive work that has ended does not hold up background work
+            throttle.BeginInteractiveWork().Dispose();
+            throttle.InteractiveWorkCount.ShouldEqual(0);
+            throttle.WaitForInteractiveWork(WaitTimeout).ShouldBeFalse();
+
+            EventMetadata metadata = throttle.GetAndResetHeartBeatMetadata(out bool logToFile);
+            logToFile.ShouldBeFalse();
+            ((long)metadata[nameof(BackgroundWorkThrottle)].ShouldBeOfType<EventMetadata>()["BackgroundWaits"]).ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void BackgroundWorkWaitsForInteractiveWork()
+        {
+            BackgroundWorkThrottle throttle = new BackgroundWorkThrottle();
+            IDisposable first = throttle.BeginInteractiveWork();
+            IDisposable second = throttle.BeginInteractiveWork();
+            throttle.InteractiveWorkCount.ShouldEqual(2);
+
+            Task<bool> backgroundWork = Task.Run(() => throttle.WaitForInteractiveWork(WaitTimeout));
+
+            first.Dispose();
+            first.Dispose();
+            throttle.InteractiveWorkCount.ShouldEqual(1);
+            backgroundWork.Wait(TimeSpan.FromMilliseconds(100)).ShouldBeFalse();
+
+            second.Dispose();
+            backgroundWork.Wait(WaitTimeout).ShouldBeTrue();
+            backgroundWork.Result.ShouldBeTrue();
+
+            EventMetadata metadata = throttle.GetAndResetHeartBeatMetadata(out bool logToFile);
+            logToFile.ShouldBeTrue();
+            ((long)metadata[nameof(BackgroundWorkThrottle)].ShouldBeOfType<EventMetadata>()["BackgroundWaits"]).ShouldEqual(1);
+        }
+
+        [TestCase]
+        public void BackgroundWorkWaitIsBounded()
+        {
+            BackgroundWorkThrottle throttle = new BackgroundWorkThrottle();
+            using (throttle.BeginInteractiveWork())
+            {
+                throttle.WaitForInteractiveWork(TimeSpan.FromMilliseconds(10)).ShouldBeTrue();
+                throttle.InteractiveWorkCount.ShouldEqual(1);
+            }
+        }
+    }
+}
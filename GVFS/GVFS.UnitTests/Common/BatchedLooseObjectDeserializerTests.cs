@@ -0,0 +1,129 @@
+﻿using GVFS.Common;
+using GVFS.Common.NetworkStreams;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace GVFS.UnitTests.Common
+{
+    [TestFixture]
+    public class BatchedLooseObjectDeserializerTests
+    {
+        [TestCase(1)]
+        [TestCase(4)]
+        public void ProcessesEveryObject(int workerCount)
+        {
+            // Includes an object that is too large to be buffered, which is streamed on the reading thread
+            int[] sizes = { 0, 1, 100, 4096, 65536, BatchedLooseObjectDeserializer.MaxBufferedObjectSize + 1, 7, 300000 };
+            Dictionary<string, byte[]> objects = CreateObjects(sizes);
+
+            ConcurrentDictionary<string, byte[]> received = new ConcurrentDictionary<string, byte[]>();
+            using (MemoryStream response = CreateResponse(objects))
+            {
+                BatchedLooseObjectDeserializer deserializer = new BatchedLooseObjectDeserializer(
+                    response,
+                    (objectStream, sha) =>
+                    {
+                        using (MemoryStream contents = new MemoryStream())
+                        {
+                            objectStream.CopyTo(contents);
+                            received.TryAdd(sha, contents.ToArray()).ShouldBeTrue();
+                        }
+                    },
+                    workerCount);
+
+                deserializer.ProcessObjects().ShouldEqual(objects.Count);
+            }
+
+            received.Count.ShouldEqual(objects.Count);
+            foreach (KeyValuePair<string, byte[]> expected in objects)
+            {
+                received[expected.Key].SequenceEqual(expected.Value).ShouldBeTrue(expected.Key);
+            }
+        }
+
+        [TestCase(1)]
+        [TestCase(4)]
+        public void ExceptionFromCallbackIsThrown(int workerCount)
+        {
+            Dictionary<string, byte[]> objects = CreateObjects(Enumerable.Repeat(1000, 50).ToArray());
+            string failingSha = objects.Keys.ElementAt(20);
+
+            using (MemoryStream response = CreateResponse(objects))
+            {
+                BatchedLooseObjectDeserializer deserializer = new BatchedLooseObjectDeserializer(
+                    response,
+                    (objectStream, sha) =>
+                    {
+                        objectStream.CopyTo(Stream.Null);
+                        if (sha == failingSha)
+                        {
+                            throw new RetryableException("Failed to write " + sha);
+                        }
+                    },
+                    workerCount);
+
+                Assert.Throws<RetryableException>(() => deserializer.ProcessObjects());
+            }
+        }
+
+        [TestCase(1)]
+        [TestCase(4)]
+        public void TruncatedResponseIsRetryable(int workerCount)
+        {
+            Dictionary<string, byte[]> objects = CreateObjects(new[] { 100, 200, 300 });
+            byte[] response;
+            using (MemoryStream fullResponse = CreateResponse(objects))
+            {
+                response = fullResponse.ToArray();
+            }
+
+            // Cut the response off part way through the last object
+            using (MemoryStream truncated = new MemoryStream(response, 0, response.Length - 20 - 150))
+            {
+                BatchedLooseObjectDeserializer deserializer = new BatchedLooseObjectDeserializer(
+                    truncated,
+                    (objectStream, sha) => objectStream.CopyTo(Stream.Null),
+                    workerCount);
+
+                Assert.Throws<RetryableException>(() => deserializer.ProcessObjects());
+            }
+        }
+
+        private static Dictionary<string, byte[]> CreateObjects(int[] sizes)
+        {
+            Random random = new Random(17);
+            Dictionary<string, byte[]> objects = new Dictionary<string, byte[]>();
+            foreach (int size in sizes)
+            {
+                byte[] id = new byte[20];
+                random.NextBytes(id);
+                byte[] contents = new byte[size];
+                random.NextBytes(contents);
+                objects.Add(SHA1Util.HexStringFromBytes(id), contents);
+            }
+
+            return objects;
+        }
+
+        private static MemoryStream CreateResponse(Dictionary<string, byte[]> objects)
+        {
+            MemoryStream response = new MemoryStream();
+            response.Write(new byte[] { (byte)'G', (byte)'V', (byte)'F', (byte)'S', (byte)' ', 1 });
+            foreach (KeyValuePair<string, byte[]> entry in objects)
+            {
+                response.Write(Convert.FromHexString(entry.Key));
+                response.Write(BitConverter.GetBytes((long)entry.Value.Length));
+                response.Write(entry.Value);
+            }
+
+            response.Write(new byte[20]);
+            response.Position = 0;
+            return response;
+        }
+    }
+}
@@ -0,0 +1,247 @@
+﻿using GVFS.Common.NamedPipes;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Category;
+using NUnit.Framework;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace GVFS.UnitTests.Common
+{
+    [TestFixture]
+    public class BinaryNamedPipeMessagesTests
+    {
+        [TestCase]
+        public void LockRequestRoundTrips()
+        {
+            NamedPipeMessages.LockData requestData = new NamedPipeMessages.LockData(1234, isElevated: true, checkAvailabilityOnly: false, parsedCommand: "git commit -m 'a | b'", gitCommandSessionId: "session|1");
+            byte[] message = Encode(new NamedPipeMessages.Binary.LockRequestMessage(NamedPipeMessages.Binary.MessageType.AcquireLockRequest, requestData));
+
+            BinaryMessageReader reader = new BinaryMessageReader(message);
+            NamedPipeMessages.Binary.ReadHeader(ref reader, out byte version).ShouldEqual(NamedPipeMessages.Binary.MessageType.AcquireLockRequest);
+            version.ShouldEqual(NamedPipeMessages.Binary.SchemaVersion);
+
+            NamedPipeMessages.LockData readData = NamedPipeMessages.Binary.LockRequestMessage.ReadRequestData(ref reader);
+            readData.PID.ShouldEqual(1234);
+            readData.IsElevated.ShouldBeTrue();
+            readData.CheckAvailabilityOnly.ShouldBeFalse();
+            readData.ParsedCommand.ShouldEqual("git commit -m 'a | b'");
+            readData.GitCommandSessionId.ShouldEqual("session|1");
+            reader.IsAtEnd.ShouldBeTrue();
+        }
+
+        [TestCase]
+        public void AcquireLockResponsesRoundTrip()
+        {
+            NamedPipeMessages.AcquireLock.Response accept = NamedPipeMessages.AcquireLock.Response.FromBinary(
+                Encode(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.AcceptResult)));
+            accept.Result.ShouldBeSameAs(NamedPipeMessages.AcquireLock.AcceptResult);
+            accept.ResponseData.ShouldBeNull();
+            accept.DenyGVFSMessage.ShouldBeNull();
+
+            NamedPipeMessages.LockData holder = new NamedPipeMessages.LockData(42, isElevated: false, checkAvailabilityOnly: false, parsedCommand: "git rebase", gitCommandSessionId: null);
+            NamedPipeMessages.AcquireLock.Response denyGit = NamedPipeMessages.AcquireLock.Response.FromBinary(
+                Encode(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.DenyGitResult, holder)));
+            denyGit.Result.ShouldEqual(NamedPipeMessages.AcquireLock.DenyGitResult);
+            denyGit.ResponseData.PID.ShouldEqual(42);
+            denyGit.ResponseData.ParsedCommand.ShouldEqual("git rebase");
+            denyGit.ResponseData.GitCommandSessionId.ShouldBeNull();
+
+            NamedPipeMessages.AcquireLock.Response denyGVFS = NamedPipeMessages.AcquireLock.Response.FromBinary(
+                Encode(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.DenyGVFSResult, responseData: null, denyGVFSMessage: "Waiting for GVFS to release the lock")));
+            denyGVFS.Result.ShouldEqual(NamedPipeMessages.AcquireLock.DenyGVFSResult);
+            denyGVFS.ResponseData.ShouldBeNull();
+            denyGVFS.DenyGVFSMessage.ShouldEqual("Waiting for GVFS to release the lock");
+        }
+
+        [TestCase]
+        public void ReleaseLockResponseRoundTrips()
+        {
+            List<string> failedToUpdate = new List<string> { "a.txt", "dir/\u00e9.txt" };
+            List<string> failedToDelete = new List<string> { "b.txt" };
+            NamedPipeMessages.ReleaseLock.Response response = NamedPipeMessages.ReleaseLock.Response.FromBinary(
+                Encode(new NamedPipeMessages.ReleaseLock.Response(
+                    NamedPipeMessages.ReleaseLock.FailureResult,
+                    new NamedPipeMessages.ReleaseLock.ReleaseLockData(failedToUpdate, failedToDelete))));
+
+            response.Result.ShouldEqual(NamedPipeMessages.ReleaseLock.FailureResult);
+            response.ResponseData.FailedToUpdateCount.ShouldEqual(2);
+            response.ResponseData.FailedToDeleteCount.ShouldEqual(1);
+            response.ResponseData.FailedToUpdateFileList.ShouldMatchInOrder(failedToUpdate);
+            response.ResponseData.FailedToDeleteFileList.ShouldMatchInOrder(failedToDelete);
+
+            NamedPipeMessages.ReleaseLock.Response success = NamedPipeMessages.ReleaseLock.Response.FromBinary(
+                Encode(new NamedPipeMessages.ReleaseLock.Response(NamedPipeMessages.ReleaseLock.SuccessResult)));
+            success.Result.ShouldBeSameAs(NamedPipeMessages.ReleaseLock.SuccessResult);
+            success.ResponseData.ShouldBeNull();
+        }
+
+        [TestCase]
+        public void GetStatusResponseRoundTrips()
+        {
+            NamedPipeMessages.GetStatus.Response response = NamedPipeMessages.GetStatus.Response.FromBinary(
+                Encode(new NamedPipeMessages.GetStatus.Response
+                {
+                    MountStatus = NamedPipeMessages.GetStatus.Ready,
+                    MountProgress = null,
+                    EnlistmentRoot = "C:\\Repos\\Enlistment\\src",
+                    LocalCacheRoot = "C:\\.gvfsCache",
+                    RepoUrl = "https://example.com/repo",
+                    CacheServer = string.Empty,
+                    BackgroundOperationCount = 300,
+                    LockStatus = "Free",
+                    DiskLayoutVersion = "19.0",
+                }));
+
+            response.MountStatus.ShouldBeSameAs(NamedPipeMessages.GetStatus.Ready);
+            response.MountProgress.ShouldBeNull();
+            response.EnlistmentRoot.ShouldEqual("C:\\Repos\\Enlistment\\src");
+            response.LocalCacheRoot.ShouldEqual("C:\\.gvfsCache");
+            response.RepoUrl.ShouldEqual("https://example.com/repo");
+            response.CacheServer.ShouldEqual(string.Empty);
+            response.BackgroundOperationCount.ShouldEqual(300);
+            response.LockStatus.ShouldEqual("Free");
+            response.DiskLayoutVersion.ShouldEqual("19.0");
+        }
+
+        [TestCase]
+        public void HydrationStatusResponseRoundTrips()
+        {
+            NamedPipeMessages.HydrationStatus.Response status = new NamedPipeMessages.HydrationStatus.Response
+            {
+                PlaceholderFileCount = 10,
+                PlaceholderFolderCount = 2,
+                ModifiedFileCount = 3,
+                ModifiedFolderCount = 1,
+                TotalFileCount = 1000000,
+                TotalFolderCount = 5000,
+            };
+
+            NamedPipeMessages.HydrationStatus.Response.TryReadBinary(Encode(status), out string result, out NamedPipeMessages.HydrationStatus.Response readStatus).ShouldBeTrue();
+            result.ShouldEqual(NamedPipeMessages.HydrationStatus.SuccessResult);
+            readStatus.ToBody().ShouldEqual(status.ToBody());
+
+            byte[] notAvailable = Encode(new NamedPipeMessages.Binary.ResultMessage(NamedPipeMessages.Binary.MessageType.HydrationStatusResponse, NamedPipeMessages.HydrationStatus.NotAvailableResult));
+            NamedPipeMessages.HydrationStatus.Response.TryReadBinary(notAvailable, out result, out readStatus).ShouldBeFalse();
+            result.ShouldEqual(NamedPipeMessages.HydrationStatus.NotAvailableResult);
+            readStatus.ShouldBeNull();
+        }
+
+        [TestCase(0)]
+        [TestCase(1)]
+        [TestCase(-1)]
+        [TestCase(63)]
+        [TestCase(-64)]
+        [TestCase(64)]
+        [TestCase(int.MaxValue)]
+        [TestCase(int.MinValue)]
+        public void VarInt32RoundTrips(int value)
+        {
+            using (BinaryMessageWriter writer = new BinaryMessageWriter())
+            {
+                writer.WriteVarInt32(value);
+                writer.WriteVarUInt32(unchecked((uint)value));
+                writer.Length.ShouldBeAtMost(10);
+
+                BinaryMessageReader reader = new BinaryMessageReader(GetMessage(writer));
+                reader.ReadVarInt32().ShouldEqual(value);
+                reader.ReadVarUInt32().ShouldEqual(unchecked((uint)value));
+                reader.IsAtEnd.ShouldBeTrue();
+            }
+        }
+
+        [TestCase]
+        public void SmallVarIntsUseOneByte()
+        {
+            using (BinaryMessageWriter writer = new BinaryMessageWriter())
+            {
+                writer.WriteVarInt32(-64);
+                writer.WriteVarInt32(63);
+                writer.WriteVarUInt32(127);
+                writer.Length.ShouldEqual(3);
+
+                writer.WriteVarUInt32(128);
+                writer.Length.ShouldEqual(5);
+            }
+        }
+
+        [TestCase]
+        public void FrameHasMarkerAndLength()
+        {
+            using (BinaryMessageWriter writer = new BinaryMessageWriter())
+            {
+                writer.WriteString(new string('x', 1000));
+                byte[] frame = writer.GetFrame().ToArray();
+
+                frame[0].ShouldEqual(BinaryMessageWriter.FrameMarker);
+                BitConverter.ToInt32(frame, 1).ShouldEqual(writer.Length);
+                frame.Length.ShouldEqual(BinaryMessageWriter.FrameHeaderLength + writer.Length);
+
+                // The writer is reused for the next message
+                writer.Reset();
+                writer.WriteByte(7);
+                writer.GetFrame().ToArray().ShouldMatchInOrder(BinaryMessageWriter.FrameMarker, (byte)1, (byte)0, (byte)0, (byte)0, (byte)7);
+            }
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void TruncatedMessagesThrow()
+        {
+            byte[] message = Encode(new NamedPipeMessages.AcquireLock.Response(
+                NamedPipeMessages.AcquireLock.DenyGitResult,
+                new NamedPipeMessages.LockData(1, false, false, "git status", "1")));
+
+            for (int length = 0; length < message.Length; ++length)
+            {
+                byte[] truncated = message.Take(length).ToArray();
+                Assert.Throws<InvalidDataException>(() => NamedPipeMessages.AcquireLock.Response.FromBinary(truncated), "Length " + length);
+            }
+
+            Assert.Throws<InvalidDataException>(() => new BinaryMessageReader(new byte[] { 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 }).ReadVarUInt32());
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void UnexpectedMessageTypeThrows()
+        {
+            byte[] message = Encode(new NamedPipeMessages.ReleaseLock.Response(NamedPipeMessages.ReleaseLock.SuccessResult));
+            Assert.Throws<InvalidDataException>(() => NamedPipeMessages.AcquireLock.Response.FromBinary(message));
+        }
+
+        [TestCase]
+        public void FieldsFromNewerVersionsAreIgnored()
+        {
+            byte[] message;
+            using (BinaryMessageWriter writer = new BinaryMessageWriter())
+            {
+                new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.AcceptResult).WriteBinary(writer);
+                writer.WriteVarUInt32(12345);
+                writer.WriteString("A field added in a later version");
+                message = GetMessage(writer);
+            }
+
+            // Version 2 of the schema
+            message[0] = NamedPipeMessages.Binary.SchemaVersion + 1;
+
+            NamedPipeMessages.AcquireLock.Response response = NamedPipeMessages.AcquireLock.Response.FromBinary(message);
+            response.Result.ShouldEqual(NamedPipeMessages.AcquireLock.AcceptResult);
+            response.ResponseData.ShouldBeNull();
+        }
+
+        private static byte[] Encode(IBinaryNamedPipeMessage message)
+        {
+            using (BinaryMessageWriter writer = new BinaryMessageWriter())
+            {
+                message.WriteBinary(writer);
+                return GetMessage(writer);
+            }
+        }
+
+        private static byte[] GetMessage(BinaryMessageWriter writer)
+        {
+            return writer.GetFrame().Slice(BinaryMessageWriter.FrameHeaderLength).ToArray();
+        }
+    }
+}
@@ -43,5 +43,45 @@ public void TryParseSucceedsForUpperCaseShas()
             Sha1Id.TryParse(sha, out sha1Id, out error).ShouldBeTrue();
             sha1Id.ToString().ShouldEqual(sha);
         }
+
+        [TestCase]
+        public void EqualShasAreEqualAndHashTheSame()
+        {
+            string sha = "ABCDEF7890123456789012345678901234567890";
+            Sha1Id first = new Sha1Id(sha);
+            Sha1Id second = new Sha1Id(sha);
+            Sha1Id different = new Sha1Id("ABCDEF7890123456789012345678901234567891");
+
+            first.Equals(second).ShouldBeTrue();
+            (first == second).ShouldBeTrue();
+            (first != different).ShouldBeTrue();
+            first.Equals((object)different).ShouldBeFalse();
+            first.GetHashCode().ShouldEqual(second.GetHashCode());
+        }
+
+        [TestCase]
+        public void CompareToMatchesOrdinalOrderOfShaStrings()
+        {
+            string[] shas = new string[]
+            {
+                "0000000000000000000000000000000000000001",
+                "00000000000000FF000000000000000000000000",
+                "0100000000000000000000000000000000000000",
+                "ABCDEF7890123456789012345678901234567890",
+                "ABCDEF7890123456789012345678901234567891",
+                "ABCDEF7890123456FF9012345678901234567890",
+                "FF00000000000000000000000000000000000000",
+            };
+
+            for (int i = 0; i < shas.Length; ++i)
+            {
+                for (int j = 0; j < shas.Length; ++j)
+                {
+                    int expected = string.CompareOrdinal(shas[i], shas[j]);
+                    int actual = new Sha1Id(shas[i]).CompareTo(new Sha1Id(shas[j]));
+                    System.Math.Sign(actual).ShouldEqual(System.Math.Sign(expected));
+                }
+            }
+        }
     }
 }
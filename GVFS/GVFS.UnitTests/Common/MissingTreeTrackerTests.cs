@@ -2,6 +2,11 @@
 using GVFS.Tests.Should;
 using GVFS.UnitTests.Mock.Common;
 using NUnit.Framework;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
 
 namespace GVFS.UnitTests.Common
 {
@@ -513,5 +518,264 @@ public void LruEviction_TryGetCommitsUpdatesLru()
             tracker.GetHighestMissingTreeCount(new[] { "commit3" }, out _).ShouldEqual(1);
             tracker.GetHighestMissingTreeCount(new[] { "commit4" }, out _).ShouldEqual(1);
         }
+
+        // -------------------------------------------------------------------------
+        // TryGetPredictedTrees
+        // -------------------------------------------------------------------------
+
+        [TestCase]
+        public void TryGetPredictedTrees_UntrackedTree()
+        {
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 10);
+
+            tracker.TryGetPredictedTrees("tree1", out string[] predicted).ShouldEqual(false);
+            predicted.ShouldBeNull();
+        }
+
+        [TestCase]
+        public void TryGetPredictedTrees_NoPredictionsForSinglePathWalk()
+        {
+            // git log -- path requests one sub-tree of each tree, so the siblings are never needed
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 20);
+            tracker.AddMissingRootTree("root", "commit1");
+
+            string parent = "root";
+            for (int depth = 0; depth < 5; ++depth)
+            {
+                tracker.TryGetPredictedTrees(parent, out _).ShouldEqual(false);
+                string[] subTrees = Enumerable.Range(0, 3).Select(i => $"tree{depth}_{i}").ToArray();
+                tracker.AddMissingSubTrees(parent, subTrees);
+                parent = subTrees[1];
+            }
+        }
+
+        [TestCase]
+        public void TryGetPredictedTrees_PredictsSiblingsAfterTheRequestedTree()
+        {
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 20);
+            tracker.AddMissingRootTree("root", "commit1");
+            tracker.TryGetPredictedTrees("root", out _).ShouldEqual(false);
+            tracker.AddMissingSubTrees("root", new[] { "a", "b", "c", "d", "e" });
+
+            // The first two requests for siblings show that the walk is visiting whole trees
+            tracker.TryGetPredictedTrees("a", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("b", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("c", out string[] predicted).ShouldEqual(true);
+            predicted.ShouldMatchInOrder("d", "e");
+
+            // Trees that have been requested or predicted are not predicted again
+            tracker.TryGetPredictedTrees("e", out _).ShouldEqual(false);
+        }
+
+        [TestCase]
+        public void TryGetPredictedTrees_DoesNotWrapAroundToEarlierSiblings()
+        {
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 20);
+            tracker.AddMissingRootTree("root", "commit1");
+            tracker.AddMissingSubTrees("root", new[] { "a", "b", "c", "d", "e" });
+
+            tracker.TryGetPredictedTrees("c", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("d", out _).ShouldEqual(false);
+
+            // "a" and "b" come before the last sibling, a walk in tree order has already passed them
+            tracker.TryGetPredictedTrees("e", out string[] predicted).ShouldEqual(false);
+            predicted.ShouldBeNull();
+        }
+
+        [TestCase]
+        public void TryGetPredictedTrees_NoPredictionsForTreeMissingFromItsParentsSubTrees()
+        {
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 20);
+            tracker.AddMissingRootTree("root", "commit1");
+            tracker.AddMissingSubTrees("root", new[] { "a", "b", "x" });
+            tracker.AddMissingSubTrees("root", new[] { "a", "b", "c", "d", "e" });
+
+            tracker.TryGetPredictedTrees("a", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("b", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("x", out string[] predicted).ShouldEqual(false);
+            predicted.ShouldBeNull();
+
+            tracker.TryGetPredictedTrees("c", out predicted).ShouldEqual(true);
+            predicted.ShouldMatchInOrder("d", "e");
+        }
+
+        [TestCase]
+        public void TryGetPredictedTrees_RepeatedRequestDoesNotShrinkTheBatch()
+        {
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 200);
+            tracker.AddMissingRootTree("root", "commit1");
+            string[] subTrees = Enumerable.Range(0, 100).Select(i => $"tree{i:D2}").ToArray();
+            tracker.AddMissingSubTrees("root", subTrees);
+
+            tracker.TryGetPredictedTrees("tree00", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("tree01", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("tree02", out string[] predicted).ShouldEqual(true);
+            predicted.Length.ShouldEqual(8);
+
+            // A request for a tree that was not predicted doubles the batch
+            tracker.TryGetPredictedTrees("tree20", out predicted).ShouldEqual(true);
+            predicted.ShouldMatchInOrder(subTrees.Skip(21).Take(16).ToArray());
+
+            // Requesting the same tree again (for example after its download failed) is neither a miss
+            // nor a request for a predicted tree, and so the batch stays the same size
+            tracker.TryGetPredictedTrees("tree20", out predicted).ShouldEqual(true);
+            predicted.ShouldMatchInOrder(subTrees.Skip(37).Take(16).ToArray());
+        }
+
+        [TestCase]
+        public void TryGetPredictedTrees_WalkIsForgottenWhenCommitCompletes()
+        {
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 20);
+            tracker.AddMissingRootTree("root", "commit1");
+            tracker.AddMissingSubTrees("root", new[] { "a", "b", "c", "d" });
+            tracker.TryGetPredictedTrees("a", out _).ShouldEqual(false);
+            tracker.TryGetPredictedTrees("b", out _).ShouldEqual(false);
+
+            tracker.MarkCommitComplete("commit1");
+            tracker.AddMissingRootTree("root", "commit1");
+            tracker.AddMissingSubTrees("root", new[] { "a", "b", "c", "d" });
+
+            tracker.TryGetPredictedTrees("c", out _).ShouldEqual(false);
+        }
+
+        // -------------------------------------------------------------------------
+        // Replay of recorded tree downloads
+        // -------------------------------------------------------------------------
+
+        [TestCase]
+        public void ReplayRecordedTreeDownloads()
+        {
+            List<TraceEvent> trace = ReadTrace(GetDataPath("treeDownloadTrace.txt"));
+
+            ReplayResult withoutPrediction = Replay(trace, predictTrees: false);
+            ReplayResult withPrediction = Replay(trace, predictTrees: true);
+
+            Console.WriteLine($"Without prediction: {withoutPrediction}");
+            Console.WriteLine($"With prediction:    {withPrediction}");
+
+            // Every tree that git asked for must still be downloaded, and no more than one round trip per request
+            withPrediction.TreesDownloaded.ShouldEqual(withoutPrediction.TreesDownloaded);
+            withoutPrediction.RoundTrips.ShouldEqual(trace.Count);
+            withPrediction.RoundTrips.ShouldBeAtMost(withoutPrediction.RoundTrips / 2);
+            withPrediction.SimulatedWallTime.ShouldBeAtMost(withoutPrediction.SimulatedWallTime / 2);
+        }
+
+        private static ReplayResult Replay(List<TraceEvent> trace, bool predictTrees)
+        {
+            // Mirrors InProcessMount: a cold round trip costs far more than the objects in it
+            TimeSpan roundTripTime = TimeSpan.FromMilliseconds(50);
+            TimeSpan perObjectTime = TimeSpan.FromMilliseconds(0.5);
+
+            Dictionary<string, string[]> subTreesByTree = trace
+                .Where(traceEvent => traceEvent.CommitSha == null)
+                .GroupBy(traceEvent => traceEvent.ObjectSha, StringComparer.OrdinalIgnoreCase)
+                .ToDictionary(group => group.Key, group => group.First().SubTreeShas, StringComparer.OrdinalIgnoreCase);
+
+            MissingTreeTracker tracker = CreateTracker(treeCapacity: 4000);
+            HashSet<string> downloaded = new HashSet<string>(StringComparer.OrdinalIgnoreCase);
+            ReplayResult result = new ReplayResult();
+            Stopwatch trackerTime = new Stopwatch();
+
+            foreach (TraceEvent traceEvent in trace)
+            {
+                if (downloaded.Contains(traceEvent.ObjectSha))
+                {
+                    // Downloaded with an earlier request, so git does not ask for it
+                    continue;
+                }
+
+                List<string> batch = new List<string> { traceEvent.ObjectSha };
+                trackerTime.Start();
+                if (traceEvent.CommitSha != null)
+                {
+                    tracker.AddMissingRootTree(traceEvent.ObjectSha, traceEvent.CommitSha);
+                    batch[0] = traceEvent.CommitSha;
+                }
+                else if (predictTrees && tracker.TryGetPredictedTrees(traceEvent.ObjectSha, out string[] predicted))
+                {
+                    batch.AddRange(predicted.Where(treeSha => !downloaded.Contains(treeSha)));
+                }
+
+                trackerTime.Stop();
+
+                result.RoundTrips++;
+                result.SimulatedWallTime += roundTripTime + (perObjectTime * batch.Count);
+                foreach (string sha in batch)
+                {
+                    downloaded.Add(sha);
+                    if (traceEvent.CommitSha == null)
+                    {
+                        result.TreesDownloaded++;
+                    }
+
+                    trackerTime.Start();
+                    if (subTreesByTree.TryGetValue(sha, out string[] subTrees) && tracker.TryGetCommits(sha, out _))
+                    {
+                        tracker.AddMissingSubTrees(sha, subTrees.Where(subTree => !downloaded.Contains(subTree)).ToArray());
+                    }
+
+                    trackerTime.Stop();
+                }
+            }
+
+            result.TrackerTime = trackerTime.Elapsed;
+            return result;
+        }
+
+        private static List<TraceEvent> ReadTrace(string path)
+        {
+            List<TraceEvent> trace = new List<TraceEvent>();
+            foreach (string line in File.ReadAllLines(path))
+            {
+                if (line.Length == 0 || line.StartsWith("#"))
+                {
+                    continue;
+                }
+
+                string[] parts = line.Split(' ');
+                if (parts[0] == "commit")
+                {
+                    trace.Add(new TraceEvent { CommitSha = parts[1], ObjectSha = parts[2], SubTreeShas = new string[0] });
+                }
+                else
+                {
+                    trace.Add(new TraceEvent { ObjectSha = parts[1], SubTreeShas = parts.Skip(2).ToArray() });
+                }
+            }
+
+            return trace;
+        }
+
+        private static string GetDataPath(string fileName)
+        {
+            string workingDirectory = Path.GetDirectoryName(Environment.ProcessPath);
+            return Path.Combine(workingDirectory, "Data", fileName);
+        }
+
+        private class TraceEvent
+        {
+            // Set for a commit download, whose root tree is ObjectSha
+            public string CommitSha { get; set; }
+
+            public string ObjectSha { get; set; }
+
+            public string[] SubTreeShas { get; set; }
+        }
+
+        private class ReplayResult
+        {
+            public int RoundTrips { get; set; }
+
+            public int TreesDownloaded { get; set; }
+
+            public TimeSpan SimulatedWallTime { get; set; }
+
+            public TimeSpan TrackerTime { get; set; }
+
+            public override string ToString()
+            {
+                return $"{this.RoundTrips} round trips, {this.TreesDownloaded} trees, {this.SimulatedWallTime.TotalMilliseconds:N0} ms simulated, {this.TrackerTime.TotalMilliseconds:N1} ms in the tracker";
+            }
+        }
     }
 }
@@ -0,0 +1,167 @@
+﻿using GVFS.Common.NamedPipes;
+using GVFS.Common.Tracing;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Category;
+using NUnit.Framework;
+using System;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.UnitTests.Common
+{
+    [TestFixture]
+    public class NamedPipeHandlerPoolTests
+    {
+        private static readonly TimeSpan WaitTimeout = TimeSpan.FromSeconds(30);
+
+        [TestCase]
+        public void RequestsQueueWhenAllHandlersAreBusy()
+        {
+            using (NamedPipeHandlerPool pool = new NamedPipeHandlerPool(threadCount: 2))
+            using (ManualResetEventSlim releaseHandlers = new ManualResetEventSlim(false))
+            using (CountdownEvent handlersStarted = new CountdownEvent(2))
+            {
+                int runningHandlers = 0;
+                int maxRunningHandlers = 0;
+                Action handler = () =>
+                {
+                    int running = Interlocked.Increment(ref runningHandlers);
+                    InterlockedMax(ref maxRunningHandlers, running);
+                    if (!handlersStarted.IsSet)
+                    {
+                        handlersStarted.Signal();
+                    }
+
+                    releaseHandlers.Wait();
+                    Interlocked.Decrement(ref runningHandlers);
+                };
+
+                Task[] tasks = new Task[5];
+                for (int i = 0; i < tasks.Length; ++i)
+                {
+                    tasks[i] = pool.RunAsync(handler, NamedPipeRequestPriority.Interactive);
+                }
+
+                handlersStarted.Wait(WaitTimeout).ShouldBeTrue();
+                pool.BusyHandlerCount.ShouldEqual(2);
+                pool.QueueDepth.ShouldEqual(3);
+
+                releaseHandlers.Set();
+                Task.WaitAll(tasks, WaitTimeout).ShouldBeTrue();
+                maxRunningHandlers.ShouldEqual(2);
+
+                EventMetadata metrics = pool.GetAndResetMetrics();
+                ((int)metrics["HandlerThreads"]).ShouldEqual(2);
+                ((int)metrics["MaxQueueDepth"]).ShouldBeAtLeast(3);
+                ((long)metrics["RequestsHandled"]).ShouldEqual(5);
+                ((long)metrics["MaxHandlerMs"]).ShouldBeAtLeast((long)metrics["AverageHandlerMs"]);
+
+                EventMetadata interactiveMetrics = metrics["Interactive"].ShouldBeOfType<EventMetadata>();
+                ((long)interactiveMetrics["RequestsHandled"]).ShouldEqual(5);
+                ((long)interactiveMetrics["P99LatencyMs"]).ShouldBeAtLeast((long)interactiveMetrics["P50LatencyMs"]);
+                ((long)metrics["Background"].ShouldBeOfType<EventMetadata>()["RequestsHandled"]).ShouldEqual(0);
+
+                // The metrics are reset
+                metrics = pool.GetAndResetMetrics();
+                ((int)metrics["MaxQueueDepth"]).ShouldEqual(0);
+                ((long)metrics["RequestsHandled"]).ShouldEqual(0);
+            }
+        }
+
+        [TestCase]
+        public void InteractiveRequestsRunWhileBackgroundRequestsWait()
+        {
+            using (NamedPipeHandlerPool pool = new NamedPipeHandlerPool(threadCount: 2))
+            using (ManualResetEventSlim backgroundStarted = new ManualResetEventSlim(false))
+            using (ManualResetEventSlim releaseBackground = new ManualResetEventSlim(false))
+            {
+                pool.MaxBackgroundHandlerCount.ShouldEqual(1);
+
+                Task firstBackground = pool.RunAsync(
+                    () =>
+                    {
+                        backgroundStarted.Set();
+                        releaseBackground.Wait();
+                    },
+                    NamedPipeRequestPriority.Background);
+                backgroundStarted.Wait(WaitTimeout).ShouldBeTrue();
+
+                // The second background request has to wait for the first, even though a thread is free
+                bool secondBackgroundRan = false;
+                Task secondBackground = pool.RunAsync(() => secondBackgroundRan = true, NamedPipeRequestPriority.Background);
+                pool.RunAsync(() => { }, NamedPipeRequestPriority.Interactive).Wait(WaitTimeout).ShouldBeTrue();
+                secondBackgroundRan.ShouldBeFalse();
+                pool.QueueDepth.ShouldEqual(1);
+
+                releaseBackground.Set();
+                Task.WaitAll(new[] { firstBackground, secondBackground }, WaitTimeout).ShouldBeTrue();
+                secondBackgroundRan.ShouldBeTrue();
+
+                EventMetadata metrics = pool.GetAndResetMetrics();
+                ((long)metrics["Interactive"].ShouldBeOfType<EventMetadata>()["RequestsHandled"]).ShouldEqual(1);
+                ((long)metrics["Background"].ShouldBeOfType<EventMetadata>()["RequestsHandled"]).ShouldEqual(2);
+            }
+        }
+
+        [TestCase]
+        public void MaxLatencyIncludesRequestsWhoseSamplesWereReplaced()
+        {
+            using (NamedPipeHandlerPool pool = new NamedPipeHandlerPool(threadCount: 1))
+            {
+                pool.RunAsync(() => Thread.Sleep(100), NamedPipeRequestPriority.Interactive).Wait(WaitTimeout).ShouldBeTrue();
+
+                // More requests than there are latency samples, so the slow request's sample is replaced
+                Task[] tasks = new Task[1100];
+                for (int i = 0; i < tasks.Length; ++i)
+                {
+                    tasks[i] = pool.RunAsync(() => { }, NamedPipeRequestPriority.Interactive);
+                }
+
+                Task.WaitAll(tasks, WaitTimeout).ShouldBeTrue();
+
+                EventMetadata interactiveMetrics = pool.GetAndResetMetrics()["Interactive"].ShouldBeOfType<EventMetadata>();
+                ((long)interactiveMetrics["RequestsHandled"]).ShouldEqual(1101);
+                ((long)interactiveMetrics["MaxLatencyMs"]).ShouldBeAtLeast(100);
+
+                interactiveMetrics = pool.GetAndResetMetrics()["Interactive"].ShouldBeOfType<EventMetadata>();
+                ((long)interactiveMetrics["MaxLatencyMs"]).ShouldEqual(0);
+            }
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void HandlerExceptionFaultsTask()
+        {
+            using (NamedPipeHandlerPool pool = new NamedPipeHandlerPool(threadCount: 1))
+            {
+                Task failed = pool.RunAsync(() => throw new InvalidOperationException("Handler failed"), NamedPipeRequestPriority.Interactive);
+                Assert.Throws<AggregateException>(() => failed.Wait(WaitTimeout));
+                failed.Exception.InnerException.ShouldBeOfType<InvalidOperationException>();
+
+                // The thread that ran the failed handler keeps running handlers
+                pool.RunAsync(() => { }, NamedPipeRequestPriority.Interactive).Wait(WaitTimeout).ShouldBeTrue();
+            }
+        }
+
+        [TestCase]
+        public void RunAfterDisposeIsCanceled()
+        {
+            NamedPipeHandlerPool pool = new NamedPipeHandlerPool(threadCount: 1);
+            pool.Dispose();
+
+            bool handlerRan = false;
+            Task task = pool.RunAsync(() => handlerRan = true, NamedPipeRequestPriority.Background);
+            task.IsCanceled.ShouldBeTrue();
+            handlerRan.ShouldBeFalse();
+        }
+
+        private static void InterlockedMax(ref int location, int value)
+        {
+            int current;
+            while (value > (current = Volatile.Read(ref location))
+                && Interlocked.CompareExchange(ref location, value, current) != current)
+            {
+            }
+        }
+    }
+}
@@ -2,7 +2,9 @@
 using GVFS.Tests.Should;
 using GVFS.UnitTests.Category;
 using NUnit.Framework;
+using System;
 using System.IO;
+using System.Threading;
 
 namespace GVFS.UnitTests.Common
 {
@@ -49,6 +51,123 @@ public void ReadingPartialMessgeThrows()
             Assert.Throws<IOException>(() => this.streamReader.ReadMessage());
         }
 
+        [Test]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void ReadingPartialMessgeAsyncThrows()
+        {
+            byte[] bytes = System.Text.Encoding.ASCII.GetBytes("This is a partial message");
+
+            this.stream.Write(bytes, 0, bytes.Length);
+            this.stream.Seek(0, SeekOrigin.Begin);
+
+            Assert.ThrowsAsync<IOException>(() => this.streamReader.ReadMessageAsync(CancellationToken.None));
+        }
+
+        [Test]
+        public void CanReadMessagesAsync()
+        {
+            string[] messages = new string[]
+            {
+                "This is a new message",
+                string.Empty,
+                new string('T', 1024 * 5),
+                "This is the last message"
+            };
+
+            foreach (string message in messages)
+            {
+                this.streamWriter.WriteMessage(message);
+            }
+
+            this.SetStreamPosition(0);
+
+            // Messages that are read into the buffer with an earlier message are returned by later reads
+            foreach (string message in messages)
+            {
+                this.streamReader.ReadMessageAsync(CancellationToken.None).Result.ShouldEqual(message);
+            }
+
+            this.streamReader.ReadMessageAsync(CancellationToken.None).Result.ShouldBeNull();
+        }
+
+        [Test]
+        public void CanReadTextAndBinaryFrames()
+        {
+            NamedPipeMessages.GetStatus.Response largeStatus = new NamedPipeMessages.GetStatus.Response
+            {
+                MountStatus = NamedPipeMessages.GetStatus.Ready,
+                EnlistmentRoot = new string('E', 1024 * 10),
+                BackgroundOperationCount = 7,
+            };
+
+            // The text message leaves only part of the binary frame's header in the reader's first buffer
+            string text = new string('T', 4096 - 3);
+            this.streamWriter.WriteMessage(text);
+            this.streamWriter.WriteBinaryMessage(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.AcceptResult));
+            this.streamWriter.WriteBinaryMessage(largeStatus);
+            this.streamWriter.WriteMessage("After the binary frames");
+            this.streamWriter.WriteBinaryMessage(NamedPipeMessages.Binary.ResultMessage.GetStatusRequest);
+
+            this.SetStreamPosition(0);
+
+            NamedPipeFrame frame = this.streamReader.ReadFrame();
+            frame.IsBinary.ShouldBeFalse();
+            frame.Text.ShouldEqual(text);
+
+            frame = this.streamReader.ReadFrameAsync(CancellationToken.None).Result;
+            frame.IsBinary.ShouldBeTrue();
+            NamedPipeMessages.AcquireLock.Response.FromBinary(frame.Binary.Span).Result.ShouldEqual(NamedPipeMessages.AcquireLock.AcceptResult);
+
+            frame = this.streamReader.ReadFrame();
+            frame.IsBinary.ShouldBeTrue();
+            NamedPipeMessages.GetStatus.Response status = NamedPipeMessages.GetStatus.Response.FromBinary(frame.Binary.Span);
+            status.EnlistmentRoot.ShouldEqual(largeStatus.EnlistmentRoot);
+            status.BackgroundOperationCount.ShouldEqual(7);
+
+            this.streamReader.ReadMessage().ShouldEqual("After the binary frames");
+
+            frame = this.streamReader.ReadFrame();
+            frame.IsBinary.ShouldBeTrue();
+            BinaryMessageReader reader = new BinaryMessageReader(frame.Binary.Span);
+            NamedPipeMessages.Binary.ReadHeader(ref reader, out byte _).ShouldEqual(NamedPipeMessages.Binary.MessageType.GetStatusRequest);
+
+            this.streamReader.ReadFrame().IsEndOfStream.ShouldBeTrue();
+        }
+
+        [Test]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void ReadingPartialBinaryFrameThrows()
+        {
+            this.streamWriter.WriteBinaryMessage(new NamedPipeMessages.AcquireLock.Response(NamedPipeMessages.AcquireLock.AcceptResult));
+            this.stream.SetLength(this.stream.Length - 1);
+            this.SetStreamPosition(0);
+
+            Assert.Throws<IOException>(() => this.streamReader.ReadFrame());
+        }
+
+        [Test]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void ReadingBinaryFrameAsTextThrows()
+        {
+            this.streamWriter.WriteBinaryMessage(NamedPipeMessages.Binary.ResultMessage.GetStatusRequest);
+            this.SetStreamPosition(0);
+
+            Assert.Throws<IOException>(() => this.streamReader.ReadMessage());
+        }
+
+        [Test]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void ReadingBinaryFrameWithInvalidLengthThrows()
+        {
+            byte[] header = new byte[BinaryMessageWriter.FrameHeaderLength];
+            header[0] = BinaryMessageWriter.FrameMarker;
+            BitConverter.GetBytes(NamedPipeStreamReader.MaxBinaryFrameLength + 1).CopyTo(header, 1);
+            this.stream.Write(header, 0, header.Length);
+            this.SetStreamPosition(0);
+
+            Assert.Throws<IOException>(() => this.streamReader.ReadFrame());
+        }
+
         [Test]
         public void CanSendMessagesWithNewLines()
         {
@@ -35,6 +35,17 @@ public void LockData_FromBody_WithDelimiters()
             lockDataWithPipeAfter.GitCommandSessionId.ShouldEqual("123|321");
         }
 
+        [TestCase("GetStatus", "GetStatus")]
+        [TestCase("PrefetchBlobs|body|with|separators", "PrefetchBlobs")]
+        [TestCase("|body", "")]
+        [TestCase("", "")]
+        [TestCase(null, "")]
+        public void Message_GetHeader_MatchesFromString(string message, string expectedHeader)
+        {
+            Message.GetHeader(message).ToString().ShouldEqual(expectedHeader);
+            (Message.FromString(message).Header ?? string.Empty).ShouldEqual(expectedHeader);
+        }
+
         [TestCase("1|true|true", "Invalid lock message. Expected at least 7 parts, got: 3 from message: '1|true|true'")]
         [TestCase("123|true|true|10|git status", "Invalid lock message. Expected at least 7 parts, got: 5 from message: '123|true|true|10|git status'")]
         [TestCase("blah|true|true|10|git status|9|sessionId", "Invalid lock message. Expected PID, got: blah from message: 'blah|true|true|10|git status|9|sessionId'")]
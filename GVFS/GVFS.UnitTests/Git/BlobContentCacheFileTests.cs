@@ -0,0 +1,167 @@
+using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+using System;
+using System.IO;
+using System.Text;
+
+namespace GVFS.UnitTests.Git
+{
+    [TestFixture]
+    public class BlobContentCacheFileTests
+    {
+        // Blob records are 28 bytes plus the contents, rounded up to a multiple of 8
+        private const int RecordSize = 128;
+        private const int ContentsLength = RecordSize - 28;
+
+        private string tempDir;
+        private string path;
+
+        [SetUp]
+        public void SetUp()
+        {
+            this.tempDir = Path.Combine(Path.GetTempPath(), "BlobContentCacheFileTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            Directory.CreateDirectory(this.tempDir);
+            this.path = Path.Combine(this.tempDir, "BlobContents.dat");
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [TestCase]
+        public void BlobsAreIndexedWhenTheFileIsOpened()
+        {
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Create(this.path, 4 * RecordSize))
+            {
+                cacheFile.TryAdd(CreateSha(1), CreateContents(1)).ShouldBeTrue();
+                cacheFile.TryAdd(CreateSha(2), Encoding.ASCII.GetBytes("contents")).ShouldBeTrue();
+            }
+
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Open(this.path))
+            {
+                cacheFile.Count.ShouldEqual(2);
+                cacheFile.TryGetContents(CreateSha(1), out byte[] contents).ShouldBeTrue();
+                contents.ShouldMatchInOrder(CreateContents(1));
+                cacheFile.TryGetContents(CreateSha(2).ToUpperInvariant(), out contents).ShouldBeTrue();
+                Encoding.ASCII.GetString(contents).ShouldEqual("contents");
+                cacheFile.TryGetContents(CreateSha(3), out contents).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void OldestBlobsAreOverwrittenWhenTheFileIsFull()
+        {
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Create(this.path, 4 * RecordSize))
+            {
+                for (int i = 1; i <= 6; ++i)
+                {
+                    cacheFile.TryAdd(CreateSha(i), CreateContents(i)).ShouldBeTrue();
+                }
+
+                cacheFile.Count.ShouldEqual(4);
+                cacheFile.Contains(CreateSha(1)).ShouldBeFalse();
+                cacheFile.Contains(CreateSha(2)).ShouldBeFalse();
+            }
+
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Open(this.path))
+            {
+                cacheFile.Count.ShouldEqual(4);
+                for (int i = 3; i <= 6; ++i)
+                {
+                    cacheFile.TryGetContents(CreateSha(i), out byte[] contents).ShouldBeTrue();
+                    contents.ShouldMatchInOrder(CreateContents(i));
+                }
+            }
+        }
+
+        [TestCase]
+        public void BlobThatOverwritesPartOfALargerBlobLeavesTheRestSkipped()
+        {
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Create(this.path, 4 * RecordSize))
+            {
+                // Fills the file, so the next blob goes back to the start and overwrites the first half of it
+                cacheFile.TryAdd(CreateSha(1), new byte[(4 * RecordSize) - 28]).ShouldBeTrue();
+                cacheFile.TryAdd(CreateSha(2), CreateContents(2)).ShouldBeTrue();
+                cacheFile.TryAdd(CreateSha(3), CreateContents(3)).ShouldBeTrue();
+                cacheFile.Contains(CreateSha(1)).ShouldBeFalse();
+            }
+
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Open(this.path))
+            {
+                cacheFile.Count.ShouldEqual(2);
+                cacheFile.Contains(CreateSha(2)).ShouldBeTrue();
+                cacheFile.Contains(CreateSha(3)).ShouldBeTrue();
+
+                // The records that follow the skipped part are still found
+                cacheFile.TryAdd(CreateSha(4), CreateContents(4)).ShouldBeTrue();
+                cacheFile.TryAdd(CreateSha(5), CreateContents(5)).ShouldBeTrue();
+                cacheFile.TryAdd(CreateSha(6), CreateContents(6)).ShouldBeTrue();
+                cacheFile.Count.ShouldEqual(4);
+                cacheFile.Contains(CreateSha(2)).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void BlobLargerThanTheFileIsNotAdded()
+        {
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Create(this.path, RecordSize))
+            {
+                cacheFile.TryAdd(CreateSha(1), new byte[RecordSize]).ShouldBeFalse();
+                cacheFile.Count.ShouldEqual(0);
+            }
+        }
+
+        [TestCase]
+        public void RemovedBlobIsNotIndexedWhenTheFileIsOpened()
+        {
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Create(this.path, 4 * RecordSize))
+            {
+                cacheFile.TryAdd(CreateSha(1), CreateContents(1)).ShouldBeTrue();
+                cacheFile.TryAdd(CreateSha(2), CreateContents(2)).ShouldBeTrue();
+                cacheFile.Remove(CreateSha(1));
+                cacheFile.Contains(CreateSha(1)).ShouldBeFalse();
+            }
+
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Open(this.path))
+            {
+                cacheFile.Count.ShouldEqual(1);
+                cacheFile.Contains(CreateSha(2)).ShouldBeTrue();
+            }
+        }
+
+        [TestCase]
+        public void OpenThrowsForAFileThatIsNotABlobContentCacheFile()
+        {
+            File.WriteAllBytes(this.path, new byte[BlobContentCacheFile.HeaderSize + RecordSize]);
+            Assert.Throws<InvalidDataException>(() => BlobContentCacheFile.Open(this.path));
+        }
+
+        [TestCase]
+        public void IsBlobContentsChecksTheSha()
+        {
+            // The SHA of the empty blob
+            const string EmptyBlobSha = "e69de29bb2d1d6434b8b29ae775ad8c2e48c5391";
+            BlobContentCacheFile.IsBlobContents(EmptyBlobSha, Array.Empty<byte>()).ShouldBeTrue();
+            BlobContentCacheFile.IsBlobContents(EmptyBlobSha.ToUpperInvariant(), Array.Empty<byte>()).ShouldBeTrue();
+            BlobContentCacheFile.IsBlobContents(EmptyBlobSha, Encoding.ASCII.GetBytes("contents")).ShouldBeFalse();
+        }
+
+        private static string CreateSha(int i)
+        {
+            return i.ToString("x2").PadLeft(40, '0');
+        }
+
+        private static byte[] CreateContents(int i)
+        {
+            byte[] contents = new byte[ContentsLength];
+            Array.Fill(contents, (byte)i);
+            return contents;
+        }
+    }
+}
@@ -0,0 +1,247 @@
+using GVFS.Common;
+using GVFS.Common.Git;
+using GVFS.Common.Tracing;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+using System;
+using System.IO;
+using System.Security.Cryptography;
+using System.Text;
+
+namespace GVFS.UnitTests.Git
+{
+    [TestFixture]
+    public class BlobContentCacheTests
+    {
+        private const string Sha1 = "1111111111111111111111111111111111111111";
+        private const string Sha2 = "2222222222222222222222222222222222222222";
+        private const string Sha3 = "3333333333333333333333333333333333333333";
+
+        private string tempDir;
+
+        [SetUp]
+        public void SetUp()
+        {
+            this.tempDir = Path.Combine(Path.GetTempPath(), "BlobContentCacheTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            Directory.CreateDirectory(this.tempDir);
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [TestCase]
+        public void CopiedBlobIsServedFromTheCache()
+        {
+            BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024);
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => Assert.Fail("Blob should not be cached yet")).ShouldBeFalse();
+
+            Copy(cache, Sha1, "contents").ShouldEqual("contents");
+            cache.Count.ShouldEqual(1);
+
+            string cachedContents = null;
+            cache.TryCopyBlobContentStream(Sha1.ToUpperInvariant(), (stream, length) => cachedContents = ReadAll(stream, length)).ShouldBeTrue();
+            cachedContents.ShouldEqual("contents");
+        }
+
+        [TestCase]
+        public void BlobIsOnlyCachedWhenItIsMissedASecondTime()
+        {
+            BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024);
+            Action<Stream, long> writeAction = (stream, length) => ReadAll(stream, length);
+            cache.AddWhenCopied(Sha1, writeAction).ShouldBeSameAs(writeAction);
+            cache.AddWhenCopied(Sha2, writeAction).ShouldBeSameAs(writeAction);
+
+            CopyOnce(cache, Sha1, "contents").ShouldEqual("contents");
+            cache.Count.ShouldEqual(1);
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => { }).ShouldBeTrue();
+            cache.TryCopyBlobContentStream(Sha2, (stream, length) => { }).ShouldBeFalse();
+        }
+
+        [TestCase]
+        public void LargeBlobIsNotCached()
+        {
+            BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024, maxBlobSize: 4);
+            Copy(cache, Sha1, "contents").ShouldEqual("contents");
+            cache.Count.ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void BlobIsNotCachedUnlessAllOfItIsRead()
+        {
+            BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024);
+            cache.AddWhenCopied(Sha1, (stream, length) => { });
+            Action<Stream, long> writeAction = cache.AddWhenCopied(Sha1, (stream, length) => stream.Read(new byte[4], 0, 4));
+            using (MemoryStream stream = new MemoryStream(Encoding.ASCII.GetBytes("contents")))
+            {
+                writeAction(stream, stream.Length);
+            }
+
+            cache.Count.ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void BlobIsNotCachedWhenTheStreamIsLongerThanTheBlob()
+        {
+            BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024);
+            cache.AddWhenCopied(Sha1, (stream, length) => { });
+            Action<Stream, long> writeAction = cache.AddWhenCopied(Sha1, (stream, length) => stream.CopyTo(Stream.Null));
+            using (MemoryStream stream = new MemoryStream(Encoding.ASCII.GetBytes("contents")))
+            {
+                writeAction(stream, 4);
+            }
+
+            cache.Count.ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void LeastRecentlyUsedBlobIsEvicted()
+        {
+            // Room for two of the blobs, each of which also takes up the per-entry overhead
+            string contents = new string('x', 1000);
+            BlobContentCache cache = new BlobContentCache(maxCachedBytes: 2600);
+            Copy(cache, Sha1, contents);
+            Copy(cache, Sha2, contents);
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => { }).ShouldBeTrue();
+
+            Copy(cache, Sha3, contents);
+            cache.Count.ShouldEqual(2);
+            cache.CachedBytes.ShouldBeAtMost(2600);
+            cache.TryCopyBlobContentStream(Sha2, (stream, length) => { }).ShouldBeFalse();
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => { }).ShouldBeTrue();
+            cache.TryCopyBlobContentStream(Sha3, (stream, length) => { }).ShouldBeTrue();
+        }
+
+        [TestCase]
+        public void HeartBeatReportsHitRate()
+        {
+            BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024);
+            cache.GetAndResetHeartBeatMetadata(out bool logToFile);
+            logToFile.ShouldBeFalse();
+
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => { }).ShouldBeFalse();
+            Copy(cache, Sha1, "contents");
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => { }).ShouldBeTrue();
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => { }).ShouldBeTrue();
+            cache.TryCopyBlobContentStream(Sha1, (stream, length) => { }).ShouldBeTrue();
+
+            EventMetadata metrics = cache.GetAndResetHeartBeatMetadata(out logToFile)[nameof(BlobContentCache)].ShouldBeOfType<EventMetadata>();
+            logToFile.ShouldBeTrue();
+            ((long)metrics["Hits"]).ShouldEqual(3);
+            ((long)metrics["Misses"]).ShouldEqual(1);
+            ((int)metrics["HitRatePercent"]).ShouldEqual(75);
+            ((int)metrics["Entries"]).ShouldEqual(1);
+
+            metrics = cache.GetAndResetHeartBeatMetadata(out logToFile)[nameof(BlobContentCache)].ShouldBeOfType<EventMetadata>();
+            logToFile.ShouldBeFalse();
+            ((long)metrics["Hits"]).ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void BlobsInTheCacheFileAreCachedAfterARemount()
+        {
+            string path = Path.Combine(this.tempDir, "BlobContents.dat");
+            string sha = GetBlobSha("contents");
+            using (BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024, cacheFile: BlobContentCacheFile.Create(path, 64 * 1024)))
+            {
+                Copy(cache, sha, "contents");
+            }
+
+            using (BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024, cacheFile: BlobContentCacheFile.Open(path)))
+            {
+                cache.Count.ShouldEqual(0);
+
+                string cachedContents = null;
+                cache.TryCopyBlobContentStream(sha, (stream, length) => cachedContents = ReadAll(stream, length)).ShouldBeTrue();
+                cachedContents.ShouldEqual("contents");
+                cache.Count.ShouldEqual(1);
+
+                EventMetadata metrics = cache.GetAndResetHeartBeatMetadata(out _)[nameof(BlobContentCache)].ShouldBeOfType<EventMetadata>();
+                ((long)metrics["Hits"]).ShouldEqual(1);
+                ((long)metrics["FileHits"]).ShouldEqual(1);
+                ((int)metrics["FileEntries"]).ShouldEqual(1);
+            }
+        }
+
+        [TestCase]
+        public void BlobEvictedFromMemoryIsCopiedFromTheCacheFile()
+        {
+            string contents1 = new string('1', 1000);
+            string contents2 = new string('2', 1000);
+            string sha1 = GetBlobSha(contents1);
+            string sha2 = GetBlobSha(contents2);
+            using (BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1300, cacheFile: BlobContentCacheFile.Create(Path.Combine(this.tempDir, "BlobContents.dat"), 64 * 1024)))
+            {
+                Copy(cache, sha1, contents1);
+                Copy(cache, sha2, contents2);
+                cache.Count.ShouldEqual(1);
+
+                string cachedContents = null;
+                cache.TryCopyBlobContentStream(sha1, (stream, length) => cachedContents = ReadAll(stream, length)).ShouldBeTrue();
+                cachedContents.ShouldEqual(contents1);
+                cache.TryCopyBlobContentStream(sha2, (stream, length) => cachedContents = ReadAll(stream, length)).ShouldBeTrue();
+                cachedContents.ShouldEqual(contents2);
+            }
+        }
+
+        [TestCase]
+        public void BlobWhoseContentsInTheCacheFileDoNotMatchItsShaIsRemoved()
+        {
+            string path = Path.Combine(this.tempDir, "BlobContents.dat");
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Create(path, 64 * 1024))
+            {
+                cacheFile.TryAdd(Sha1, Encoding.ASCII.GetBytes("contents")).ShouldBeTrue();
+            }
+
+            using (BlobContentCache cache = new BlobContentCache(maxCachedBytes: 1024 * 1024, cacheFile: BlobContentCacheFile.Open(path)))
+            {
+                cache.TryCopyBlobContentStream(Sha1, (stream, length) => Assert.Fail("Stale blob should not be copied")).ShouldBeFalse();
+                cache.Count.ShouldEqual(0);
+            }
+
+            using (BlobContentCacheFile cacheFile = BlobContentCacheFile.Open(path))
+            {
+                cacheFile.Contains(Sha1).ShouldBeFalse();
+            }
+        }
+
+        private static string GetBlobSha(string contents)
+        {
+            byte[] blob = Encoding.ASCII.GetBytes("blob " + contents.Length + "\0" + contents);
+            return SHA1Util.HexStringFromBytes(SHA1.HashData(blob));
+        }
+
+        /// <summary>
+        /// Copy the blob twice, as a blob is only added to the cache when it is missed a second time
+        /// </summary>
+        private static string Copy(BlobContentCache cache, string sha, string contents)
+        {
+            cache.AddWhenCopied(sha, (stream, length) => { });
+            return CopyOnce(cache, sha, contents);
+        }
+
+        private static string CopyOnce(BlobContentCache cache, string sha, string contents)
+        {
+            string copiedContents = null;
+            Action<Stream, long> writeAction = cache.AddWhenCopied(sha, (stream, length) => copiedContents = ReadAll(stream, length));
+            using (MemoryStream stream = new MemoryStream(Encoding.ASCII.GetBytes(contents)))
+            {
+                writeAction(stream, stream.Length);
+            }
+
+            return copiedContents;
+        }
+
+        private static string ReadAll(Stream stream, long length)
+        {
+            byte[] contents = new byte[length];
+            stream.ReadExactly(contents);
+            return Encoding.ASCII.GetString(contents);
+        }
+    }
+}
@@ -0,0 +1,275 @@
+using GVFS.Common;
+using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using GVFS.UnitTests.Mock.FileSystem;
+using GVFS.UnitTests.Mock.Git;
+using NUnit.Framework;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.IO.Compression;
+using System.Linq;
+using System.Runtime.InteropServices;
+using System.Security.Cryptography;
+using System.Text;
+
+namespace GVFS.UnitTests.Git
+{
+    [TestFixture]
+    public class BlobContentCopierTests
+    {
+        private const string TestEnlistmentRoot = "mock:\\src";
+        private const string TestLocalCacheRoot = "mock:\\.gvfs";
+        private const string TestObjectRoot = "mock:\\.gvfs\\gitObjectCache";
+
+        // Same as WindowsFileSystemVirtualizer.MaxBlobStreamBufferSize
+        private const int WriteBufferSize = 64 * 1024;
+
+        [TestCase]
+        public void ReadBlockFillsTheDestination()
+        {
+            byte[] contents = CreateContents(1000, seed: 1);
+            byte[] destination = new byte[600];
+
+            using (OneByteAtATimeStream stream = new OneByteAtATimeStream(contents))
+            {
+                BlobContentCopier.ReadBlock(stream, destination).ShouldEqual(destination.Length);
+                destination.ShouldMatchInOrder(contents.Take(destination.Length));
+            }
+        }
+
+        [TestCase]
+        public void ReadBlockStopsAtTheEndOfTheStream()
+        {
+            byte[] contents = CreateContents(1000, seed: 2);
+            byte[] destination = new byte[600];
+
+            using (MemoryStream stream = new MemoryStream(contents))
+            {
+                BlobContentCopier.ReadBlock(stream, destination).ShouldEqual(destination.Length);
+                BlobContentCopier.ReadBlock(stream, destination).ShouldEqual(contents.Length - destination.Length);
+                BlobContentCopier.ReadBlock(stream, destination).ShouldEqual(0);
+            }
+        }
+
+        [TestCase]
+        public void LooseObjectIsInflatedIntoUnmanagedMemory()
+        {
+            byte[] contents = CreateContents((2 * WriteBufferSize) + 100, seed: 3);
+            string sha = AddLooseObject(contents, out Dictionary<string, byte[]> looseObjects);
+            GitRepo repo = CreateRepo(looseObjects);
+
+            IntPtr writeBuffer = Marshal.AllocHGlobal(WriteBufferSize);
+            try
+            {
+                using (MemoryStream hydrated = new MemoryStream())
+                {
+                    repo.TryCopyBlobContentStream(
+                        sha,
+                        (stream, length) =>
+                        {
+                            length.ShouldEqual(contents.Length);
+                            CopyDirectly(stream, length, writeBuffer, hydrated);
+                        }).ShouldBeTrue();
+
+                    hydrated.ToArray().ShouldMatchInOrder(contents);
+                }
+            }
+            finally
+            {
+                Marshal.FreeHGlobal(writeBuffer);
+            }
+        }
+
+        [TestCase]
+        public void HydrationBenchmark()
+        {
+            // Mostly small files with a long tail, like the files of a source tree
+            Dictionary<string, byte[]> looseObjects = new Dictionary<string, byte[]>(StringComparer.OrdinalIgnoreCase);
+            List<string> shas = new List<string>();
+            Random random = new Random(4);
+            for (int i = 0; i < 200; ++i)
+            {
+                int size = 1024 + (int)(256 * 1024 * Math.Pow(random.NextDouble(), 3));
+                shas.Add(AddLooseObject(CreateContents(size, seed: i), looseObjects));
+            }
+
+            GitRepo repo = CreateRepo(looseObjects);
+            IntPtr writeBuffer = Marshal.AllocHGlobal(WriteBufferSize);
+            try
+            {
+                HydrationResult throughManagedBuffer;
+                HydrationResult direct;
+                using (UnmanagedMemoryStream writeBufferStream = CreateUnmanagedMemoryStream(writeBuffer))
+                {
+                    throughManagedBuffer = Hydrate(repo, shas, (stream, length) => CopyThroughManagedBuffer(stream, length, writeBufferStream));
+                    direct = Hydrate(repo, shas, (stream, length) => CopyDirectly(stream, length, writeBuffer, copiedChunks: null));
+                }
+
+                Console.WriteLine($"Through a managed buffer: {throughManagedBuffer}");
+                Console.WriteLine($"Directly:                 {direct}");
+
+                direct.BytesHydrated.ShouldEqual(throughManagedBuffer.BytesHydrated);
+                direct.AllocatedBytesPerFile.ShouldBeAtMost(throughManagedBuffer.AllocatedBytesPerFile / 4);
+            }
+            finally
+            {
+                Marshal.FreeHGlobal(writeBuffer);
+            }
+        }
+
+        private static HydrationResult Hydrate(GitRepo repo, List<string> shas, Action<Stream, long> writeAction)
+        {
+            HydrationResult result = new HydrationResult();
+            Action<Stream, long> countingWriteAction = (stream, length) =>
+            {
+                writeAction(stream, length);
+                result.BytesHydrated += length;
+            };
+
+            // One pass to warm up, so that only the steady state is measured
+            foreach (string sha in shas)
+            {
+                repo.TryCopyBlobContentStream(sha, writeAction).ShouldBeTrue();
+            }
+
+            long allocatedBefore = GC.GetAllocatedBytesForCurrentThread();
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            foreach (string sha in shas)
+            {
+                repo.TryCopyBlobContentStream(sha, countingWriteAction).ShouldBeTrue();
+            }
+
+            stopwatch.Stop();
+            result.Elapsed = stopwatch.Elapsed;
+            result.FileCount = shas.Count;
+            result.AllocatedBytesPerFile = (GC.GetAllocatedBytesForCurrentThread() - allocatedBefore) / shas.Count;
+            return result;
+        }
+
+        private static void CopyThroughManagedBuffer(Stream stream, long length, UnmanagedMemoryStream writeBufferStream)
+        {
+            // The copy WindowsFileSystemVirtualizer made before it used BlobContentCopier
+            byte[] buffer = new byte[Math.Min(WriteBufferSize, length)];
+            long remainingData = length;
+            while (remainingData > 0)
+            {
+                long bytesToCopy = Math.Min(remainingData, WriteBufferSize);
+                writeBufferStream.Seek(0, SeekOrigin.Begin);
+
+                long numBytes = bytesToCopy;
+                while (numBytes > 0)
+                {
+                    int read = stream.Read(buffer, 0, (int)Math.Min(buffer.Length, numBytes));
+                    if (read <= 0)
+                    {
+                        break;
+                    }
+
+                    writeBufferStream.Write(buffer, 0, read);
+                    numBytes -= read;
+                }
+
+                remainingData -= bytesToCopy;
+            }
+        }
+
+        private static unsafe void CopyDirectly(Stream stream, long length, IntPtr writeBuffer, Stream copiedChunks)
+        {
+            long remainingData = length;
+            while (remainingData > 0)
+            {
+                int bytesToCopy = (int)Math.Min(remainingData, WriteBufferSize);
+                BlobContentCopier.ReadBlock(stream, writeBuffer, bytesToCopy);
+                copiedChunks?.Write(new ReadOnlySpan<byte>(writeBuffer.ToPointer(), bytesToCopy));
+                remainingData -= bytesToCopy;
+            }
+        }
+
+        private static unsafe UnmanagedMemoryStream CreateUnmanagedMemoryStream(IntPtr writeBuffer)
+        {
+            return new UnmanagedMemoryStream((byte*)writeBuffer.ToPointer(), WriteBufferSize, WriteBufferSize, FileAccess.Write);
+        }
+
+        private static byte[] CreateContents(int size, int seed)
+        {
+            // Text-like contents so that the objects compress about as well as source files do
+            Random random = new Random(seed);
+            byte[] alphabet = Encoding.ASCII.GetBytes("abcdefghijklmnopqrstuvwxyz        {}();\n\n");
+            byte[] contents = new byte[size];
+            for (int i = 0; i < size; ++i)
+            {
+                contents[i] = alphabet[random.Next(alphabet.Length)];
+            }
+
+            return contents;
+        }
+
+        private static string AddLooseObject(byte[] contents, out Dictionary<string, byte[]> looseObjects)
+        {
+            looseObjects = new Dictionary<string, byte[]>(StringComparer.OrdinalIgnoreCase);
+            return AddLooseObject(contents, looseObjects);
+        }
+
+        private static string AddLooseObject(byte[] contents, Dictionary<string, byte[]> looseObjects)
+        {
+            byte[] header = Encoding.ASCII.GetBytes($"blob {contents.Length}\0");
+            string sha = SHA1Util.HexStringFromBytes(SHA1.HashData(header.Concat(contents).ToArray()));
+
+            using (MemoryStream compressed = new MemoryStream())
+            {
+                using (ZLibStream zlib = new ZLibStream(compressed, CompressionLevel.Fastest, leaveOpen: true))
+                {
+                    zlib.Write(header);
+                    zlib.Write(contents);
+                }
+
+                // Keyed by file name, the path of a loose object is <objects root>/<first 2 characters>/<other 38>
+                looseObjects.Add(sha.Substring(2), compressed.ToArray());
+            }
+
+            return sha;
+        }
+
+        private static GitRepo CreateRepo(Dictionary<string, byte[]> looseObjects)
+        {
+            MockFileSystemWithCallbacks fileSystem = new MockFileSystemWithCallbacks();
+            fileSystem.OnFileExists = path => looseObjects.ContainsKey(Path.GetFileName(path));
+            fileSystem.OnOpenFileStream = (path, mode, access) => new MemoryStream(looseObjects[Path.GetFileName(path)], writable: false);
+
+            MockTracer tracer = new MockTracer();
+            GVFSEnlistment enlistment = new GVFSEnlistment(TestEnlistmentRoot, "https://fakeRepoUrl", "fakeGitBinPath", authentication: null);
+            enlistment.InitializeCachePathsFromKey(TestLocalCacheRoot, TestObjectRoot);
+            return new GitRepo(tracer, enlistment, fileSystem, () => new MockLibGit2Repo(tracer));
+        }
+
+        private class HydrationResult
+        {
+            public int FileCount { get; set; }
+            public long BytesHydrated { get; set; }
+            public TimeSpan Elapsed { get; set; }
+            public long AllocatedBytesPerFile { get; set; }
+
+            public override string ToString()
+            {
+                return $"{this.FileCount} files ({this.BytesHydrated:N0} bytes) in {this.Elapsed.TotalMilliseconds:N1} ms, " +
+                    $"{this.BytesHydrated / this.Elapsed.TotalSeconds / (1024 * 1024):N1} MB/s, {this.AllocatedBytesPerFile:N0} bytes allocated per file";
+            }
+        }
+
+        private class OneByteAtATimeStream : MemoryStream
+        {
+            public OneByteAtATimeStream(byte[] contents)
+                : base(contents, writable: false)
+            {
+            }
+
+            public override int Read(Span<byte> buffer)
+            {
+                return base.Read(buffer.Slice(0, Math.Min(1, buffer.Length)));
+            }
+        }
+    }
+}
@@ -408,6 +408,39 @@ public void SucceedsForNormalLookingLooseObjectDownloads()
             }
         }
 
+        [TestCase]
+        public void BlobIsCopiedFromBlobContentCacheWhenHydratedAgain()
+        {
+            MockFileSystemWithCallbacks fileSystem = new MockFileSystemWithCallbacks();
+            fileSystem.OnFileExists = (path) => true;
+            fileSystem.OnOpenFileStream = (path, mode, access) => new MemoryStream(this.validTestObjectFileContents);
+            GVFSGitObjects dut = this.CreateTestableGVFSGitObjects(new MockHttpGitObjects(), fileSystem);
+            dut.BlobContentCache = new BlobContentCache(maxCachedBytes: 1024 * 1024);
+
+            string CopyBlobContent()
+            {
+                string contents = null;
+                dut.TryCopyBlobContentStream(
+                    ValidTestObjectFileSha1,
+                    new CancellationToken(),
+                    GVFSGitObjects.RequestSource.FileStreamCallback,
+                    (stream, length) => contents = new StreamReader(stream).ReadToEnd(),
+                    out GVFSGitObjects.BlobHydrationFailureCategory _)
+                    .ShouldBeTrue();
+                return contents;
+            }
+
+            // A blob is only cached the second time that it is hydrated
+            CopyBlobContent().ShouldEqual("a\n");
+            dut.BlobContentCache.Count.ShouldEqual(0);
+            CopyBlobContent().ShouldEqual("a\n");
+            dut.BlobContentCache.Count.ShouldEqual(1);
+
+            // The loose object is no longer read once its contents are cached
+            fileSystem.OnOpenFileStream = (path, mode, access) => throw new FileNotFoundException();
+            CopyBlobContent().ShouldEqual("a\n");
+        }
+
         [TestCase]
         [Category(CategoryConstants.ExceptionExpected)]
         public void FailsZeroByteLooseObjectsDownloads()
@@ -3,11 +3,16 @@
 using GVFS.Common.Tracing;
 using GVFS.Tests.Should;
 using GVFS.UnitTests.Mock.Common;
+using GVFS.UnitTests.Category;
 using GVFS.UnitTests.Mock.FileSystem;
+using GVFS.UnitTests.Mock.Git;
 using NUnit.Framework;
+using System;
 using System.Collections.Generic;
 using System.IO;
+using System.Linq;
 using System.Security;
+using System.Threading;
 
 namespace GVFS.UnitTests.Git
 {
@@ -124,6 +129,60 @@ public void WriteLooseObject_Success()
             moved.ShouldBeTrue("File was not moved");
         }
 
+        [TestCase]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void TryDownloadObjects_ResumesBrokenLooseObjectsResponseWithTheRemainingObjects()
+        {
+            string[] shas = CreateShas(4);
+            MockTracer tracer = new MockTracer();
+            MockGVFSEnlistment enlistment = new MockGVFSEnlistment();
+            MockBatchHttpGitObjects httpObjects = new MockBatchHttpGitObjects(tracer, enlistment, oid => "Contents of " + oid);
+            MockPhysicalGitObjects gitObjects = new MockPhysicalGitObjects(tracer, null, enlistment, httpObjects);
+
+            // The first response breaks after its first two objects, once they have been written
+            httpObjects.ObjectsBeforeResponseBreaks = attempt => attempt == 1 ? 2 : -1;
+            httpObjects.OnResponseBreaking = () => WaitForWrittenObjects(gitObjects, 2);
+
+            gitObjects.TryDownloadObjects(shas, preferLooseObjects: true).ShouldBeTrue();
+
+            List<List<string>> requests = httpObjects.RequestedObjectIds;
+            requests.Count.ShouldEqual(2);
+            requests[0].ShouldMatchInOrder(shas);
+            requests[1].ShouldMatchInOrder(shas[2], shas[3]);
+            gitObjects.WrittenLooseObjects.OrderBy(sha => sha).ShouldMatchInOrder(shas);
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void TryDownloadObjects_SucceedsWhenLooseObjectsResponseBreaksAfterTheLastObject()
+        {
+            string[] shas = CreateShas(4);
+            MockTracer tracer = new MockTracer();
+            MockGVFSEnlistment enlistment = new MockGVFSEnlistment();
+            MockBatchHttpGitObjects httpObjects = new MockBatchHttpGitObjects(tracer, enlistment, oid => "Contents of " + oid);
+            MockPhysicalGitObjects gitObjects = new MockPhysicalGitObjects(tracer, null, enlistment, httpObjects);
+
+            // Every object is written, and then reading the terminator fails
+            httpObjects.ObjectsBeforeResponseBreaks = attempt => shas.Length;
+            httpObjects.OnResponseBreaking = () => WaitForWrittenObjects(gitObjects, shas.Length);
+
+            gitObjects.TryDownloadObjects(shas, preferLooseObjects: true).ShouldBeTrue();
+
+            httpObjects.RequestedObjectIds.Count.ShouldEqual(1);
+            gitObjects.WrittenLooseObjects.OrderBy(sha => sha).ShouldMatchInOrder(shas);
+        }
+
+        private static string[] CreateShas(int count)
+        {
+            return Enumerable.Range(1, count).Select(i => new string((char)('0' + i), 40)).ToArray();
+        }
+
+        private static void WaitForWrittenObjects(MockPhysicalGitObjects gitObjects, int count)
+        {
+            // The deserializer's workers may still be writing the objects that were read before the break
+            SpinWait.SpinUntil(() => gitObjects.WrittenLooseObjects.Count >= count, TimeSpan.FromSeconds(10)).ShouldBeTrue();
+        }
+
         private Stream OnOpenFileStream(string path, FileMode mode, FileAccess access)
         {
             this.openedPaths.Add(path);
@@ -1,6 +1,28 @@
+using System;
+using System.Collections.Concurrent;
+using System.Linq;
 using System.Net;
+using System.Net.Http;
+using System.Net.Security;
+using System.Net.Sockets;
+using System.Security.Cryptography;
+using System.Security.Cryptography.X509Certificates;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+using GVFS.Common.Git;
 using GVFS.Common.Http;
 using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using GVFS.UnitTests.Mock.Git;
+using Microsoft.AspNetCore.Builder;
+using Microsoft.AspNetCore.Hosting;
+using Microsoft.AspNetCore.Hosting.Server;
+using Microsoft.AspNetCore.Hosting.Server.Features;
+using Microsoft.AspNetCore.Http;
+using Microsoft.AspNetCore.Server.Kestrel.Core;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging;
 using NUnit.Framework;
 
 namespace GVFS.UnitTests.Http
@@ -75,5 +97,271 @@ public void CommonNonAuthStatusesDoNotRejectCredentials()
             HttpRequestor.ShouldRejectCredentials(HttpStatusCode.RequestTimeout, responseBody: null)
                 .ShouldEqual(false, "A 408 must NOT reject credentials");
         }
+
+        [TestCase]
+        public void Http11IsRequiredByDefault()
+        {
+            using (SocketsHttpHandler handler = HttpRequestor.CreateHandler(useHttp2: false))
+            using (HttpClient client = HttpRequestor.CreateHttpClient(handler, TimeSpan.FromSeconds(30), useHttp2: false))
+            {
+                handler.EnableMultipleHttp2Connections.ShouldBeFalse();
+                client.DefaultRequestVersion.ShouldEqual(HttpVersion.Version11);
+                client.DefaultVersionPolicy.ShouldEqual(HttpVersionPolicy.RequestVersionExact);
+            }
+        }
+
+        [TestCase]
+        public void Http2IsUsedWhenTheServerOffersIt()
+        {
+            using (X509Certificate2 certificate = CreateLoopbackCertificate())
+            using (WebApplication server = StartHttp2Server(certificate, maxStreamsPerConnection: 100, context => context.Response.WriteAsync("object"), out Uri serverUri))
+            {
+                SocketsHttpHandler handler = HttpRequestor.CreateHandler(useHttp2: true);
+                handler.SslOptions.RemoteCertificateValidationCallback = (sender, cert, chain, errors) => true;
+                using (HttpClient client = HttpRequestor.CreateHttpClient(handler, TimeSpan.FromSeconds(30), useHttp2: true))
+                using (HttpResponseMessage response = client.GetAsync(new Uri(serverUri, "gvfs/objects/0000000000000000000000000000000000000000")).Result)
+                {
+                    response.StatusCode.ShouldEqual(HttpStatusCode.OK);
+                    response.Version.ShouldEqual(HttpVersion.Version20);
+                    response.Content.ReadAsStringAsync().Result.ShouldEqual("object");
+                }
+
+                server.StopAsync().Wait();
+            }
+        }
+
+        [TestCase]
+        public void Http2RequestsUseMoreConnectionsWhenTheServersStreamLimitIsReached()
+        {
+            const int MaxStreamsPerConnection = 2;
+            const int ConnectionCount = 3;
+            const int RequestCount = ConnectionCount * MaxStreamsPerConnection;
+
+            ConcurrentDictionary<string, int> requestsPerConnection = new ConcurrentDictionary<string, int>();
+            TaskCompletionSource<bool> allRequestsReceived = new TaskCompletionSource<bool>(TaskCreationOptions.RunContinuationsAsynchronously);
+            int receivedCount = 0;
+
+            RequestDelegate handleRequest = async context =>
+            {
+                requestsPerConnection.AddOrUpdate(context.Connection.Id, 1, (id, count) => count + 1);
+                if (Interlocked.Increment(ref receivedCount) == RequestCount)
+                {
+                    allRequestsReceived.TrySetResult(true);
+                }
+
+                // Hold every request until all of them are in flight, so that they need RequestCount streams at once
+                await Task.WhenAny(allRequestsReceived.Task, Task.Delay(TimeSpan.FromSeconds(30)));
+                await context.Response.WriteAsync("object");
+            };
+
+            using (X509Certificate2 certificate = CreateLoopbackCertificate())
+            using (WebApplication server = StartHttp2Server(certificate, MaxStreamsPerConnection, handleRequest, out Uri serverUri))
+            {
+                SocketsHttpHandler handler = HttpRequestor.CreateHandler(useHttp2: true);
+                handler.SslOptions.RemoteCertificateValidationCallback = (sender, cert, chain, errors) => true;
+
+                // CreateHandler allows one connection per processor, which may be fewer than the test needs
+                handler.MaxConnectionsPerServer = Math.Max(handler.MaxConnectionsPerServer, ConnectionCount);
+                using (HttpClient client = HttpRequestor.CreateHttpClient(handler, TimeSpan.FromSeconds(60), useHttp2: true))
+                {
+                    Task<HttpResponseMessage>[] requests = Enumerable.Range(0, RequestCount)
+                        .Select(i => client.GetAsync(new Uri(serverUri, "gvfs/objects/" + i)))
+                        .ToArray();
+
+                    Task.WaitAll(requests, TimeSpan.FromSeconds(60)).ShouldBeTrue("The requests did not complete");
+                    allRequestsReceived.Task.IsCompleted.ShouldBeTrue("Requests waited for a stream instead of using another connection");
+
+                    foreach (Task<HttpResponseMessage> request in requests)
+                    {
+                        using (HttpResponseMessage response = request.Result)
+                        {
+                            response.StatusCode.ShouldEqual(HttpStatusCode.OK);
+                            response.Version.ShouldEqual(HttpVersion.Version20);
+                        }
+                    }
+                }
+
+                server.StopAsync().Wait();
+            }
+
+            requestsPerConnection.Count.ShouldEqual(ConnectionCount);
+            foreach (int connectionRequests in requestsPerConnection.Values)
+            {
+                connectionRequests.ShouldEqual(MaxStreamsPerConnection);
+            }
+        }
+
+        [TestCase]
+        public void Http2StreamLimitIsReadFromConfig()
+        {
+            MockGitProcess gitProcess = new MockGitProcess();
+            gitProcess.SetExpectedCommandResult("config gvfs.max-http2-streams", () => new GitProcess.Result("12", string.Empty, GitProcess.Result.SuccessCode));
+            HttpRequestor.GetRequestLimitFromConfig(new MockTracer(), gitProcess, useHttp2: true).ShouldEqual(12);
+
+            gitProcess.SetExpectedCommandResult("config gvfs.max-http2-streams", () => new GitProcess.Result(string.Empty, string.Empty, GitProcess.Result.GenericFailureCode));
+            HttpRequestor.GetRequestLimitFromConfig(new MockTracer(), gitProcess, useHttp2: true).ShouldEqual(8 * Environment.ProcessorCount);
+
+            gitProcess.SetExpectedCommandResult("config gvfs.max-http2-streams", () => new GitProcess.Result("0", string.Empty, GitProcess.Result.SuccessCode));
+            HttpRequestor.GetRequestLimitFromConfig(new MockTracer(), gitProcess, useHttp2: true).ShouldEqual(8 * Environment.ProcessorCount);
+        }
+
+        [TestCase]
+        public void Http11ConnectionLimitIsReadFromConfig()
+        {
+            MockGitProcess gitProcess = new MockGitProcess();
+            gitProcess.SetExpectedCommandResult("config gvfs.max-http-connections", () => new GitProcess.Result("6", string.Empty, GitProcess.Result.SuccessCode));
+            HttpRequestor.GetRequestLimitFromConfig(new MockTracer(), gitProcess, useHttp2: false).ShouldEqual(6);
+
+            // The HTTP/1.1 limit set in the static constructor is kept
+            gitProcess.SetExpectedCommandResult("config gvfs.max-http-connections", () => new GitProcess.Result(string.Empty, string.Empty, GitProcess.Result.GenericFailureCode));
+            HttpRequestor.GetRequestLimitFromConfig(new MockTracer(), gitProcess, useHttp2: false).ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void Http2FallsBackToHttp11()
+        {
+            SslApplicationProtocol negotiated = SendRequestToTlsServer(
+                useHttp2: true,
+                new[] { SslApplicationProtocol.Http11 },
+                out HttpResponseMessage response);
+
+            negotiated.ShouldEqual(SslApplicationProtocol.Http11);
+            using (response)
+            {
+                response.StatusCode.ShouldEqual(HttpStatusCode.OK);
+                response.Version.ShouldEqual(HttpVersion.Version11);
+            }
+        }
+
+        [TestCase]
+        public void Http2IsNotOfferedByDefault()
+        {
+            SslApplicationProtocol negotiated = SendRequestToTlsServer(
+                useHttp2: false,
+                new[] { SslApplicationProtocol.Http2, SslApplicationProtocol.Http11 },
+                out HttpResponseMessage response);
+
+            // HTTP/1.1 is sent without offering any application protocol
+            negotiated.ShouldNotEqual(SslApplicationProtocol.Http2);
+            using (response)
+            {
+                response.Version.ShouldEqual(HttpVersion.Version11);
+            }
+        }
+
+        /// <summary>
+        /// Sends a GET to a loopback TLS server that offers <paramref name="serverProtocols"/>, and that
+        /// replies with a 200 over HTTP/1.1.
+        /// </summary>
+        /// <returns>The application protocol negotiated in the TLS handshake</returns>
+        private static SslApplicationProtocol SendRequestToTlsServer(
+            bool useHttp2,
+            SslApplicationProtocol[] serverProtocols,
+            out HttpResponseMessage response)
+        {
+            using (X509Certificate2 certificate = CreateLoopbackCertificate())
+            {
+                TcpListener listener = new TcpListener(IPAddress.Loopback, 0);
+                listener.Start();
+                try
+                {
+                    Task<SslApplicationProtocol> serverTask = Task.Run(() => AcceptOneRequest(listener, certificate, serverProtocols));
+
+                    SocketsHttpHandler handler = HttpRequestor.CreateHandler(useHttp2);
+                    handler.SslOptions.RemoteCertificateValidationCallback = (sender, cert, chain, errors) => true;
+                    using (HttpClient client = HttpRequestor.CreateHttpClient(handler, TimeSpan.FromSeconds(30), useHttp2))
+                    {
+                        int port = ((IPEndPoint)listener.LocalEndpoint).Port;
+                        response = client.GetAsync($"https://localhost:{port}/gvfs/objects/0000000000000000000000000000000000000000").Result;
+                    }
+
+                    serverTask.Wait(TimeSpan.FromSeconds(30)).ShouldBeTrue("The server did not accept a connection");
+                    return serverTask.Result;
+                }
+                finally
+                {
+                    listener.Stop();
+                }
+            }
+        }
+
+        private static SslApplicationProtocol AcceptOneRequest(TcpListener listener, X509Certificate2 certificate, SslApplicationProtocol[] serverProtocols)
+        {
+            using (TcpClient connection = listener.AcceptTcpClient())
+            using (SslStream stream = new SslStream(connection.GetStream()))
+            {
+                stream.AuthenticateAsServer(new SslServerAuthenticationOptions
+                {
+                    ServerCertificate = certificate,
+                    ApplicationProtocols = serverProtocols.ToList(),
+                });
+
+                // Read the request headers, and reply without a body
+                byte[] buffer = new byte[4096];
+                StringBuilder request = new StringBuilder();
+                while (!request.ToString().Contains("\r\n\r\n"))
+                {
+                    int bytesRead = stream.Read(buffer, 0, buffer.Length);
+                    if (bytesRead == 0)
+                    {
+                        break;
+                    }
+
+                    request.Append(Encoding.ASCII.GetString(buffer, 0, bytesRead));
+                }
+
+                byte[] response = Encoding.ASCII.GetBytes("HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                stream.Write(response, 0, response.Length);
+                return stream.NegotiatedApplicationProtocol;
+            }
+        }
+
+        /// <summary>
+        /// Starts a loopback server that serves HTTP/2 over TLS, and that allows at most
+        /// <paramref name="maxStreamsPerConnection"/> concurrent requests on each connection.
+        /// </summary>
+        private static WebApplication StartHttp2Server(
+            X509Certificate2 certificate,
+            int maxStreamsPerConnection,
+            RequestDelegate handleRequest,
+            out Uri serverUri)
+        {
+            WebApplicationBuilder builder = WebApplication.CreateSlimBuilder();
+            builder.Logging.ClearProviders();
+            builder.WebHost.ConfigureKestrel(options =>
+            {
+                options.Limits.Http2.MaxStreamsPerConnection = maxStreamsPerConnection;
+                options.Listen(IPAddress.Loopback, 0, listenOptions =>
+                {
+                    listenOptions.Protocols = HttpProtocols.Http2;
+                    listenOptions.UseHttps(certificate);
+                });
+            });
+
+            WebApplication server = builder.Build();
+            server.Run(handleRequest);
+            server.StartAsync().Wait();
+
+            string address = server.Services.GetRequiredService<IServer>().Features.Get<IServerAddressesFeature>().Addresses.Single();
+            serverUri = new Uri(address + "/");
+            return server;
+        }
+
+        private static X509Certificate2 CreateLoopbackCertificate()
+        {
+            using (RSA key = RSA.Create(2048))
+            {
+                CertificateRequest request = new CertificateRequest("CN=localhost", key, HashAlgorithmName.SHA256, RSASignaturePadding.Pkcs1);
+                SubjectAlternativeNameBuilder subjectAlternativeNames = new SubjectAlternativeNameBuilder();
+                subjectAlternativeNames.AddDnsName("localhost");
+                request.CertificateExtensions.Add(subjectAlternativeNames.Build());
+
+                using (X509Certificate2 certificate = request.CreateSelfSigned(DateTimeOffset.UtcNow.AddDays(-1), DateTimeOffset.UtcNow.AddDays(1)))
+                {
+                    // SslStream on Windows needs a certificate whose key is not ephemeral
+                    return X509CertificateLoader.LoadPkcs12(certificate.Export(X509ContentType.Pfx), password: null);
+                }
+            }
+        }
     }
 }
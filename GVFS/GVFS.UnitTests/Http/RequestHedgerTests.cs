@@ -0,0 +1,219 @@
+﻿using GVFS.Common;
+using GVFS.Common.Http;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using NUnit.Framework;
+using System;
+using System.IO;
+using System.Net;
+using System.Threading;
+
+namespace GVFS.UnitTests.Http
+{
+    [TestFixture]
+    public class RequestHedgerTests
+    {
+        private static readonly TimeSpan SlowResponse = TimeSpan.FromSeconds(10);
+
+        [TestCase]
+        public void RequestsAreNotHedgedUntilThereAreEnoughSamples()
+        {
+            RequestHedger hedger = new RequestHedger(new MockTracer());
+            for (int i = 0; i < RequestHedger.MinLatencySamples - 1; ++i)
+            {
+                SendFast(hedger);
+            }
+
+            hedger.HedgeDelay.ShouldEqual(Timeout.InfiniteTimeSpan);
+
+            SendFast(hedger);
+            hedger.HedgeDelay.ShouldNotEqual(Timeout.InfiniteTimeSpan);
+            hedger.HedgeCount.ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void SlowRequestUsesTheHedgedResponse()
+        {
+            RequestHedger hedger = CreateWarmHedger();
+
+            bool primaryCancelled = false;
+            bool hedgeDisposed = false;
+            ManualResetEventSlim primaryDisposed = new ManualResetEventSlim();
+            using (GitEndPointResponseData response = hedger.Send(
+                requestId: 1,
+                sendPrimary: token =>
+                {
+                    primaryCancelled = token.WaitHandle.WaitOne(SlowResponse);
+                    return CreateResponse(HttpStatusCode.OK, () => primaryDisposed.Set());
+                },
+                sendHedge: token => CreateResponse(HttpStatusCode.OK, () => hedgeDisposed = true),
+                canHedge: () => true,
+                cancellationToken: CancellationToken.None))
+            {
+                response.HasErrors.ShouldBeFalse();
+                hedgeDisposed.ShouldBeFalse();
+            }
+
+            hedgeDisposed.ShouldBeTrue();
+            hedger.HedgeCount.ShouldEqual(1);
+            hedger.HedgeWinCount.ShouldEqual(1);
+
+            // The slow request is cancelled, and its response disposed when it returns
+            primaryDisposed.Wait(SlowResponse).ShouldBeTrue();
+            primaryCancelled.ShouldBeTrue();
+        }
+
+        [TestCase]
+        public void FailedHedgeDoesNotReplaceTheSlowResponse()
+        {
+            RequestHedger hedger = CreateWarmHedger();
+
+            using (GitEndPointResponseData response = hedger.Send(
+                requestId: 1,
+                sendPrimary: token =>
+                {
+                    Thread.Sleep(200);
+                    return CreateResponse(HttpStatusCode.OK);
+                },
+                sendHedge: token => CreateResponse(HttpStatusCode.ServiceUnavailable),
+                canHedge: () => true,
+                cancellationToken: CancellationToken.None))
+            {
+                response.HasErrors.ShouldBeFalse();
+            }
+
+            hedger.HedgeCount.ShouldEqual(1);
+            hedger.HedgeWinCount.ShouldEqual(0);
+        }
+
+        [TestCase]
+        public void PrimaryResponseIsReturnedWhenBothFail()
+        {
+            RequestHedger hedger = CreateWarmHedger();
+
+            using (GitEndPointResponseData response = hedger.Send(
+                requestId: 1,
+                sendPrimary: token =>
+                {
+                    Thread.Sleep(200);
+                    return CreateResponse(HttpStatusCode.InternalServerError);
+                },
+                sendHedge: token => CreateResponse(HttpStatusCode.ServiceUnavailable),
+                canHedge: () => true,
+                cancellationToken: CancellationToken.None))
+            {
+                response.StatusCode.ShouldEqual(HttpStatusCode.InternalServerError);
+            }
+        }
+
+        [TestCase]
+        public void PrimaryIsSentOnTheCallersThread()
+        {
+            RequestHedger hedger = CreateWarmHedger();
+            int callerThreadId = Environment.CurrentManagedThreadId;
+
+            for (int i = 0; i < 2; ++i)
+            {
+                int primaryThreadId = -1;
+                using (GitEndPointResponseData response = hedger.Send(
+                    requestId: 1,
+                    sendPrimary: token =>
+                    {
+                        primaryThreadId = Environment.CurrentManagedThreadId;
+                        token.WaitHandle.WaitOne(TimeSpan.FromMilliseconds(200));
+                        return CreateResponse(HttpStatusCode.OK);
+                    },
+                    sendHedge: token => CreateResponse(HttpStatusCode.OK),
+                    canHedge: () => true,
+                    cancellationToken: CancellationToken.None))
+                {
+                    response.HasErrors.ShouldBeFalse();
+                }
+
+                // Both with and without a hedge (the budget only allows one)
+                primaryThreadId.ShouldEqual(callerThreadId);
+            }
+
+            hedger.HedgeCount.ShouldEqual(1);
+        }
+
+        [TestCase]
+        public void HedgesAreLimitedToAFractionOfRequests()
+        {
+            // Warming up adds MinLatencySamples * MaxHedgedFraction (1.6) to the budget, enough for one hedge
+            RequestHedger hedger = CreateWarmHedger();
+
+            for (int i = 0; i < 5; ++i)
+            {
+                SendSlow(hedger, canHedge: true).Dispose();
+            }
+
+            hedger.HedgeCount.ShouldEqual(1);
+        }
+
+        [TestCase]
+        public void NoHedgeWhenItCannotBeSent()
+        {
+            RequestHedger hedger = CreateWarmHedger();
+            SendSlow(hedger, canHedge: false).Dispose();
+            hedger.HedgeCount.ShouldEqual(0);
+        }
+
+        private static RequestHedger CreateWarmHedger()
+        {
+            RequestHedger hedger = new RequestHedger(new MockTracer());
+            for (int i = 0; i < RequestHedger.MinLatencySamples; ++i)
+            {
+                SendFast(hedger);
+            }
+
+            return hedger;
+        }
+
+        private static void SendFast(RequestHedger hedger)
+        {
+            using (hedger.Send(
+                requestId: 1,
+                sendPrimary: token => CreateResponse(HttpStatusCode.OK),
+                sendHedge: token => throw new InvalidOperationException("Fast requests should not be hedged"),
+                canHedge: () => true,
+                cancellationToken: CancellationToken.None))
+            {
+            }
+        }
+
+        private static GitEndPointResponseData SendSlow(RequestHedger hedger, bool canHedge)
+        {
+            return hedger.Send(
+                requestId: 1,
+                sendPrimary: token =>
+                {
+                    token.WaitHandle.WaitOne(TimeSpan.FromMilliseconds(200));
+                    return CreateResponse(HttpStatusCode.OK);
+                },
+                sendHedge: token => CreateResponse(HttpStatusCode.OK),
+                canHedge: () => canHedge,
+                cancellationToken: CancellationToken.None);
+        }
+
+        private static GitEndPointResponseData CreateResponse(HttpStatusCode statusCode, Action onResponseDisposed = null)
+        {
+            if (statusCode == HttpStatusCode.OK)
+            {
+                return new GitEndPointResponseData(
+                    statusCode,
+                    GVFSConstants.MediaTypes.LooseObjectMediaType,
+                    new MemoryStream(),
+                    message: null,
+                    onResponseDisposed: onResponseDisposed);
+            }
+
+            return new GitEndPointResponseData(
+                statusCode,
+                new GitObjectsHttpException(statusCode, "error"),
+                shouldRetry: true,
+                message: null,
+                onResponseDisposed: onResponseDisposed);
+        }
+    }
+}
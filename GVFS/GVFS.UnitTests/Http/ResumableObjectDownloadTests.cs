@@ -0,0 +1,42 @@
+﻿using GVFS.Common.Http;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+
+namespace GVFS.UnitTests.Http
+{
+    [TestFixture]
+    public class ResumableObjectDownloadTests
+    {
+        private const string Object1 = "1111111111111111111111111111111111111111";
+        private const string Object2 = "2222222222222222222222222222222222222222";
+        private const string Object3 = "3333333333333333333333333333333333333333";
+
+        [TestCase]
+        public void RemainingObjectsKeepTheRequestOrder()
+        {
+            ResumableObjectDownload download = new ResumableObjectDownload(new[] { Object3, Object1, Object2, Object1 });
+            download.ObjectCount.ShouldEqual(3);
+            download.GetRemainingObjectIds().ShouldMatchInOrder(Object3, Object1, Object2);
+
+            download.MarkPersisted(Object1.ToUpperInvariant());
+            download.GetRemainingObjectIds().ShouldMatchInOrder(Object3, Object2);
+            download.PersistedCount.ShouldEqual(1);
+            download.IsComplete.ShouldBeFalse();
+        }
+
+        [TestCase]
+        public void CompleteOnceEveryRequestedObjectIsPersisted()
+        {
+            ResumableObjectDownload download = new ResumableObjectDownload(new[] { Object1, Object2 });
+
+            // An object that was not requested does not count toward the batch
+            download.MarkPersisted(Object3);
+            download.MarkPersisted(Object1);
+            download.IsComplete.ShouldBeFalse();
+
+            download.MarkPersisted(Object2);
+            download.IsComplete.ShouldBeTrue();
+            download.GetRemainingObjectIds().ShouldBeEmpty();
+        }
+    }
+}
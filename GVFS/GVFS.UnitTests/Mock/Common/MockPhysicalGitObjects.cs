@@ -5,6 +5,7 @@
 using GVFS.Common.Tracing;
 
 using System;
+using System.Collections.Concurrent;
 using System.IO;
 
 namespace GVFS.UnitTests.Mock.Common
@@ -16,12 +17,19 @@ public MockPhysicalGitObjects(ITracer tracer, PhysicalFileSystem fileSystem, Enl
         {
         }
 
+        /// <summary>
+        /// The loose objects that have been written, in the order they were written
+        /// </summary>
+        public ConcurrentQueue<string> WrittenLooseObjects { get; } = new ConcurrentQueue<string>();
+
         public override string WriteLooseObject(Stream responseStream, string sha, bool overwriteExisting, byte[] sharedBuf = null)
         {
             using (StreamReader reader = new StreamReader(responseStream))
             {
                 // Return "file contents" as "file name". Weird, but proves we got the right thing.
-                return reader.ReadToEnd();
+                string contents = reader.ReadToEnd();
+                this.WrittenLooseObjects.Enqueue(sha);
+                return contents;
             }
         }
 
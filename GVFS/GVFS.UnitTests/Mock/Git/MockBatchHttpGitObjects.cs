@@ -6,6 +6,7 @@
 using System;
 using System.Collections.Generic;
 using System.IO;
+using System.Linq;
 using System.Net;
 using System.Text;
 using System.Threading;
@@ -15,6 +16,7 @@ namespace GVFS.UnitTests.Mock.Git
     public class MockBatchHttpGitObjects : GitObjectsHttpRequestor
     {
         private Func<string, string> objectResolver;
+        private List<List<string>> requestedObjectIds = new List<List<string>>();
 
         public MockBatchHttpGitObjects(ITracer tracer, Enlistment enlistment, Func<string, string> objectResolver)
             : base(tracer, enlistment, new MockCacheServerInfo(), new RetryConfig())
@@ -22,6 +24,32 @@ public MockBatchHttpGitObjects(ITracer tracer, Enlistment enlistment, Func<strin
             this.objectResolver = objectResolver;
         }
 
+        /// <summary>
+        /// Called with the attempt number (starting at 1), returns how many objects the response for that attempt
+        /// contains before it breaks (the next read throws an IOException), or -1 for a complete response.  A response
+        /// that breaks after all of its objects breaks before its terminator.
+        /// </summary>
+        public Func<int, int> ObjectsBeforeResponseBreaks { get; set; }
+
+        /// <summary>
+        /// Called on the thread reading a response just before the read that breaks it
+        /// </summary>
+        public Action OnResponseBreaking { get; set; }
+
+        /// <summary>
+        /// The object ids requested by each attempt, in the order they were requested
+        /// </summary>
+        public List<List<string>> RequestedObjectIds
+        {
+            get
+            {
+                lock (this.requestedObjectIds)
+                {
+                    return this.requestedObjectIds.ToList();
+                }
+            }
+        }
+
         public override List<GitObjectSize> QueryForFileSizes(IEnumerable<string> objectIds, CancellationToken cancellationToken)
         {
             throw new NotImplementedException();
@@ -38,7 +66,7 @@ public override GitRefs QueryInfoRefs(string branch)
             Action<RetryWrapper<GitObjectTaskResult>.ErrorEventArgs> onFailure,
             bool preferBatchedLooseObjects)
         {
-            return this.TryDownloadObjects(objectIdGenerator(), onSuccess, onFailure, preferBatchedLooseObjects);
+            return this.StreamObjects(objectIdGenerator, onSuccess, onFailure);
         }
 
         public override RetryWrapper<GitObjectTaskResult>.InvocationResult TryDownloadObjects(
@@ -47,11 +75,11 @@ public override GitRefs QueryInfoRefs(string branch)
             Action<RetryWrapper<GitObjectTaskResult>.ErrorEventArgs> onFailure,
             bool preferBatchedLooseObjects)
         {
-            return this.StreamObjects(objectIds, onSuccess, onFailure);
+            return this.StreamObjects(() => objectIds, onSuccess, onFailure);
         }
 
         private RetryWrapper<GitObjectTaskResult>.InvocationResult StreamObjects(
-            IEnumerable<string> objectIds,
+            Func<IEnumerable<string>> objectIdGenerator,
             Func<int, GitEndPointResponseData, RetryWrapper<GitObjectTaskResult>.CallbackResult> onSuccess,
             Action<RetryWrapper<GitObjectTaskResult>.ErrorEventArgs> onFailure)
         {
@@ -64,6 +92,16 @@ public override GitRefs QueryInfoRefs(string branch)
                     {
                         writer.Write(new byte[] { (byte)'G', (byte)'V', (byte)'F', (byte)'S', (byte)' ', 1 });
 
+                        // Like the real requestor, ask for the objects again on every attempt
+                        List<string> objectIds = objectIdGenerator().ToList();
+                        lock (this.requestedObjectIds)
+                        {
+                            this.requestedObjectIds.Add(objectIds);
+                        }
+
+                        int objectsBeforeBreak = this.ObjectsBeforeResponseBreaks?.Invoke(i + 1) ?? -1;
+                        long breakPosition = objectsBeforeBreak == 0 ? mem.Position : -1;
+                        int objectCount = 0;
                         foreach (string objectId in objectIds)
                         {
                             string contents = this.objectResolver(objectId);
@@ -79,6 +117,12 @@ public override GitRefs QueryInfoRefs(string branch)
                                 writer.Write(new byte[20]);
                                 writer.Write(0L);
                             }
+
+                            if (++objectCount == objectsBeforeBreak)
+                            {
+                                writer.Flush();
+                                breakPosition = mem.Position;
+                            }
                         }
 
                         writer.Write(new byte[20]);
@@ -88,12 +132,12 @@ public override GitRefs QueryInfoRefs(string branch)
                         using (GitEndPointResponseData response = new GitEndPointResponseData(
                             HttpStatusCode.OK,
                             GVFSConstants.MediaTypes.CustomLooseObjectsMediaType,
-                            mem,
+                            breakPosition >= 0 ? new BreakingStream(mem, breakPosition, this.OnResponseBreaking) : mem,
                             message: null,
                             onResponseDisposed: null))
                         {
-                            RetryWrapper<GitObjectTaskResult>.CallbackResult result = onSuccess(1, response);
-                            return new RetryWrapper<GitObjectTaskResult>.InvocationResult(1, true, result.Result);
+                            RetryWrapper<GitObjectTaskResult>.CallbackResult result = onSuccess(i + 1, response);
+                            return new RetryWrapper<GitObjectTaskResult>.InvocationResult(i + 1, true, result.Result);
                         }
                     }
                 }
@@ -118,5 +162,51 @@ private byte[] SHA1BytesFromString(string s)
 
             return output;
         }
+
+        /// <summary>
+        /// Stream that throws an IOException, like a connection that was reset, when it is read past breakPosition
+        /// </summary>
+        private class BreakingStream : Stream
+        {
+            private readonly Stream inner;
+            private readonly long breakPosition;
+            private readonly Action onBreaking;
+
+            public BreakingStream(Stream inner, long breakPosition, Action onBreaking)
+            {
+                this.inner = inner;
+                this.breakPosition = breakPosition;
+                this.onBreaking = onBreaking;
+            }
+
+            public override bool CanRead => true;
+            public override bool CanSeek => false;
+            public override bool CanWrite => false;
+            public override long Length => throw new NotSupportedException();
+            public override long Position
+            {
+                get => this.inner.Position;
+                set => throw new NotSupportedException();
+            }
+
+            public override int Read(byte[] buffer, int offset, int count)
+            {
+                if (count > 0 && this.inner.Position >= this.breakPosition)
+                {
+                    this.onBreaking?.Invoke();
+                    throw new IOException("The response ended prematurely");
+                }
+
+                return this.inner.Read(buffer, offset, (int)Math.Min(count, this.breakPosition - this.inner.Position));
+            }
+
+            public override void Flush()
+            {
+            }
+
+            public override long Seek(long offset, SeekOrigin origin) => throw new NotSupportedException();
+            public override void SetLength(long value) => throw new NotSupportedException();
+            public override void Write(byte[] buffer, int offset, int count) => throw new NotSupportedException();
+        }
     }
 }
@@ -90,6 +90,12 @@ public override bool TryGetBlobLength(string blobSha, out long size)
             return false;
         }
 
+        public override int TryGetPackedBlobLengths(ReadOnlySpan<Sha1Id> blobShas, Span<long> sizes)
+        {
+            sizes.Slice(0, blobShas.Length).Fill(-1);
+            return 0;
+        }
+
         private MockGitObject GetTree(string treeSha)
         {
             this.objects.ContainsKey(treeSha).ShouldEqual(true);
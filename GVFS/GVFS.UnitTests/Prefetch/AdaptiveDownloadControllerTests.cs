@@ -0,0 +1,172 @@
+using GVFS.Common.Prefetch.Pipeline;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using NUnit.Framework;
+using System;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace GVFS.UnitTests.Prefetch
+{
+    [TestFixture]
+    public class AdaptiveDownloadControllerTests
+    {
+        private const string CacheServerUrl = "https://cache.example.com";
+        private const int InitialBatchSize = 400;
+        private const int MaxParallel = 4;
+
+        private static readonly TimeSpan TargetLatency = TimeSpan.FromSeconds(10);
+
+        [TestCase]
+        public void StartsWithTheConfiguredLimits()
+        {
+            AdaptiveDownloadController controller = CreateController();
+            controller.BatchSize.ShouldEqual(InitialBatchSize);
+            controller.Parallelism.ShouldEqual(MaxParallel);
+        }
+
+        [TestCase]
+        public void FailuresFromTheSameOutageHalveTheLimitsOnce()
+        {
+            MockTracer tracer = new MockTracer();
+            AdaptiveDownloadController controller = CreateController();
+
+            AdaptiveDownloadController.DownloadSlot first = controller.AcquireDownloadSlot();
+            AdaptiveDownloadController.DownloadSlot second = controller.AcquireDownloadSlot();
+            controller.RecordBatch(tracer, first, InitialBatchSize, TimeSpan.FromSeconds(1), attempts: 3, succeeded: false);
+            controller.RecordBatch(tracer, second, InitialBatchSize, TimeSpan.FromSeconds(1), attempts: 3, succeeded: false);
+            first.Dispose();
+            second.Dispose();
+
+            controller.BatchSize.ShouldEqual(InitialBatchSize / 2);
+            controller.Parallelism.ShouldEqual(MaxParallel / 2);
+            tracer.RelatedEventNames.Count.ShouldEqual(1);
+            tracer.RelatedEventNames[0].ShouldEqual("AdaptiveDownloadAdjusted");
+
+            // A batch that starts after the decrease can decrease the limits again
+            RecordBatch(controller, tracer, InitialBatchSize, TimeSpan.FromSeconds(1), attempts: 2, succeeded: true);
+            controller.BatchSize.ShouldEqual(InitialBatchSize / 4);
+            controller.Parallelism.ShouldEqual(MaxParallel / 4);
+        }
+
+        [TestCase]
+        public void SlowBatchesShrinkTheBatchSize()
+        {
+            MockTracer tracer = new MockTracer();
+            AdaptiveDownloadController controller = CreateController();
+
+            RecordBatch(controller, tracer, InitialBatchSize, TargetLatency + TimeSpan.FromSeconds(1), attempts: 1, succeeded: true);
+            controller.BatchSize.ShouldEqual(InitialBatchSize / 2);
+            controller.Parallelism.ShouldEqual(MaxParallel);
+        }
+
+        [TestCase]
+        public void ParallelismRecoversAtAFlatRatePerBatch()
+        {
+            MockTracer tracer = new MockTracer();
+            AdaptiveDownloadController controller = CreateController();
+            RecordBatch(controller, tracer, InitialBatchSize, TimeSpan.FromSeconds(1), attempts: 1, succeeded: false);
+            controller.Parallelism.ShouldEqual(MaxParallel / 2);
+
+            // Each batch downloads at the same rate as before the outage, every window probes one more batch in flight
+            for (int i = 0; i < MaxParallel; ++i)
+            {
+                RecordWindow(controller, tracer, objectsPerBatch: 100, elapsed: TimeSpan.FromSeconds(1));
+            }
+
+            controller.Parallelism.ShouldEqual(MaxParallel);
+            controller.BatchSize.ShouldBeAtLeast(InitialBatchSize);
+        }
+
+        [TestCase]
+        public void ParallelismBacksOffWhenThroughputDrops()
+        {
+            MockTracer tracer = new MockTracer();
+            AdaptiveDownloadController controller = CreateController();
+            RecordBatch(controller, tracer, InitialBatchSize, TimeSpan.FromSeconds(1), attempts: 1, succeeded: false);
+            controller.Parallelism.ShouldEqual(2);
+            int batchSize = controller.BatchSize;
+
+            // 100 objects/s with 2 batches in flight
+            RecordWindow(controller, tracer, objectsPerBatch: 100, elapsed: TimeSpan.FromSeconds(1));
+            controller.BatchSize.ShouldBeAtLeast(batchSize + 1);
+            controller.Parallelism.ShouldEqual(3);
+
+            // A third batch in flight did not slow each batch down
+            RecordWindow(controller, tracer, objectsPerBatch: 100, elapsed: TimeSpan.FromSeconds(1));
+            controller.Parallelism.ShouldEqual(4);
+
+            // A fourth batch in flight halved the rate of each batch, which means less throughput
+            batchSize = controller.BatchSize;
+            RecordWindow(controller, tracer, objectsPerBatch: 50, elapsed: TimeSpan.FromSeconds(1));
+            controller.Parallelism.ShouldEqual(3);
+            controller.BatchSize.ShouldEqual(batchSize);
+        }
+
+        [TestCase]
+        public void LimitsStayWithinTheirBounds()
+        {
+            MockTracer tracer = new MockTracer();
+            AdaptiveDownloadController controller = CreateController();
+
+            for (int i = 0; i < 20; ++i)
+            {
+                RecordBatch(controller, tracer, InitialBatchSize, TimeSpan.FromSeconds(1), attempts: 1, succeeded: false);
+            }
+
+            controller.BatchSize.ShouldEqual(AdaptiveDownloadController.MinBatchSize);
+            controller.Parallelism.ShouldEqual(1);
+
+            for (int i = 0; i < 100; ++i)
+            {
+                RecordWindow(controller, tracer, objectsPerBatch: 100, elapsed: TimeSpan.FromSeconds(1));
+            }
+
+            controller.BatchSize.ShouldEqual(InitialBatchSize * AdaptiveDownloadController.MaxBatchSizeMultiplier);
+            controller.Parallelism.ShouldEqual(MaxParallel);
+        }
+
+        [TestCase]
+        public void NoMoreThanParallelismBatchesAreInFlight()
+        {
+            MockTracer tracer = new MockTracer();
+            AdaptiveDownloadController controller = CreateController();
+            RecordBatch(controller, tracer, InitialBatchSize, TimeSpan.FromSeconds(1), attempts: 1, succeeded: false);
+            controller.Parallelism.ShouldEqual(2);
+
+            AdaptiveDownloadController.DownloadSlot first = controller.AcquireDownloadSlot();
+            AdaptiveDownloadController.DownloadSlot second = controller.AcquireDownloadSlot();
+
+            Task<AdaptiveDownloadController.DownloadSlot> third = Task.Run(() => controller.AcquireDownloadSlot());
+            third.Wait(TimeSpan.FromMilliseconds(100)).ShouldBeFalse();
+
+            first.Dispose();
+            third.Wait(TimeSpan.FromSeconds(5)).ShouldBeTrue();
+
+            second.Dispose();
+            third.Result.Dispose();
+        }
+
+        private static AdaptiveDownloadController CreateController()
+        {
+            return new AdaptiveDownloadController(CacheServerUrl, InitialBatchSize, MaxParallel, TargetLatency);
+        }
+
+        private static void RecordBatch(AdaptiveDownloadController controller, MockTracer tracer, int objectCount, TimeSpan elapsed, int attempts, bool succeeded)
+        {
+            using (AdaptiveDownloadController.DownloadSlot slot = controller.AcquireDownloadSlot())
+            {
+                controller.RecordBatch(tracer, slot, objectCount, elapsed, attempts, succeeded);
+            }
+        }
+
+        private static void RecordWindow(AdaptiveDownloadController controller, MockTracer tracer, int objectsPerBatch, TimeSpan elapsed)
+        {
+            int batchCount = controller.Parallelism;
+            for (int i = 0; i < batchCount; ++i)
+            {
+                RecordBatch(controller, tracer, objectsPerBatch, elapsed, attempts: 1, succeeded: true);
+            }
+        }
+    }
+}
@@ -6,7 +6,10 @@
 using NUnit.Framework;
 using System;
 using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Linq;
 using System.Threading;
+using System.Threading.Tasks;
 
 namespace GVFS.UnitTests.Prefetch
 {
@@ -116,5 +119,124 @@ public void DoesNotExitEarlyIfInputTakesLongerThanChunkSizeToGetFirstBlob()
             dut.WaitForCompletion();
             objCount.ShouldEqual(1);
         }
+
+        [TestCase]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void BrokenLooseObjectsResponseIsResumedWithTheRemainingObjects()
+        {
+            string[] shas = CreateShas(4);
+            MockTracer tracer = new MockTracer();
+            MockGVFSEnlistment enlistment = new MockGVFSEnlistment();
+            MockBatchHttpGitObjects httpObjects = new MockBatchHttpGitObjects(tracer, enlistment, oid => "Contents of " + oid);
+            MockPhysicalGitObjects gitObjects = new MockPhysicalGitObjects(tracer, null, enlistment, httpObjects);
+
+            // The first response breaks after its first two objects, once they have been written
+            httpObjects.ObjectsBeforeResponseBreaks = attempt => attempt == 1 ? 2 : -1;
+            httpObjects.OnResponseBreaking = () => WaitForWrittenObjects(gitObjects, 2);
+
+            BlockingCollection<string> output = DownloadObjects(shas, tracer, enlistment, httpObjects, gitObjects);
+
+            List<List<string>> requests = httpObjects.RequestedObjectIds;
+            requests.Count.ShouldEqual(2);
+            requests[0].ShouldMatchInOrder(shas);
+            requests[1].ShouldMatchInOrder(shas[2], shas[3]);
+            gitObjects.WrittenLooseObjects.OrderBy(sha => sha).ShouldMatchInOrder(shas);
+            output.OrderBy(sha => sha).ShouldMatchInOrder(shas);
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.ExceptionExpected)]
+        public void LooseObjectsResponseThatBreaksAfterTheLastObjectIsNotRetried()
+        {
+            string[] shas = CreateShas(4);
+            MockTracer tracer = new MockTracer();
+            MockGVFSEnlistment enlistment = new MockGVFSEnlistment();
+            MockBatchHttpGitObjects httpObjects = new MockBatchHttpGitObjects(tracer, enlistment, oid => "Contents of " + oid);
+            MockPhysicalGitObjects gitObjects = new MockPhysicalGitObjects(tracer, null, enlistment, httpObjects);
+
+            // Every object is written, and then reading the terminator fails
+            httpObjects.ObjectsBeforeResponseBreaks = attempt => shas.Length;
+            httpObjects.OnResponseBreaking = () => WaitForWrittenObjects(gitObjects, shas.Length);
+
+            BlockingCollection<string> output = DownloadObjects(shas, tracer, enlistment, httpObjects, gitObjects);
+
+            httpObjects.RequestedObjectIds.Count.ShouldEqual(1);
+            gitObjects.WrittenLooseObjects.OrderBy(sha => sha).ShouldMatchInOrder(shas);
+            output.OrderBy(sha => sha).ShouldMatchInOrder(shas);
+        }
+
+        [TestCase]
+        public void DownloadSlotIsNotAcquiredUntilThereIsABatch()
+        {
+            MockTracer tracer = new MockTracer();
+            MockGVFSEnlistment enlistment = new MockGVFSEnlistment();
+            MockBatchHttpGitObjects httpObjects = new MockBatchHttpGitObjects(tracer, enlistment, oid => "Contents of " + oid);
+            AdaptiveDownloadController controller = new AdaptiveDownloadController("https://cache", ChunkSize, maxParallel: 1, targetBatchLatency: Timeout.InfiniteTimeSpan);
+
+            BlockingCollection<string> input = new BlockingCollection<string>();
+            input.CompleteAdding();
+
+            BatchObjectDownloadStage dut = new BatchObjectDownloadStage(
+                MaxParallel,
+                ChunkSize,
+                input,
+                new BlockingCollection<string>(),
+                tracer,
+                enlistment,
+                httpObjects,
+                new MockPhysicalGitObjects(tracer, null, enlistment, httpObjects));
+            dut.DownloadController = controller;
+
+            // Every slot is in use, and so the stage can only finish if it does not wait for one when there is nothing to download
+            using (controller.AcquireDownloadSlot())
+            {
+                dut.Start();
+                Task.Run(() => dut.WaitForCompletion()).Wait(TimeSpan.FromSeconds(10)).ShouldBeTrue();
+            }
+
+            httpObjects.RequestedObjectIds.Count.ShouldEqual(0);
+        }
+
+        private static string[] CreateShas(int count)
+        {
+            return Enumerable.Range(1, count).Select(i => new string((char)('0' + i), 40)).ToArray();
+        }
+
+        private static void WaitForWrittenObjects(MockPhysicalGitObjects gitObjects, int count)
+        {
+            // The deserializer's workers may still be writing the objects that were read before the break
+            SpinWait.SpinUntil(() => gitObjects.WrittenLooseObjects.Count >= count, TimeSpan.FromSeconds(10)).ShouldBeTrue();
+        }
+
+        private static BlockingCollection<string> DownloadObjects(
+            string[] shas,
+            MockTracer tracer,
+            MockGVFSEnlistment enlistment,
+            MockBatchHttpGitObjects httpObjects,
+            MockPhysicalGitObjects gitObjects)
+        {
+            BlockingCollection<string> input = new BlockingCollection<string>();
+            foreach (string sha in shas)
+            {
+                input.Add(sha);
+            }
+
+            input.CompleteAdding();
+
+            BlockingCollection<string> output = new BlockingCollection<string>();
+            BatchObjectDownloadStage dut = new BatchObjectDownloadStage(
+                MaxParallel,
+                shas.Length,
+                input,
+                output,
+                tracer,
+                enlistment,
+                httpObjects,
+                gitObjects);
+
+            dut.Start();
+            dut.WaitForCompletion();
+            return output;
+        }
     }
 }
\ No newline at end of file
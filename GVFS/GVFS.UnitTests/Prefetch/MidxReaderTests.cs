@@ -142,7 +142,7 @@ public void HandlesAllFanoutBuckets()
         /// Writes a synthetic MIDX v1 file.
         /// Format: Header(12) + ChunkTOC(numChunks*12 + 12 terminator) + PNAM + OIDF + OIDL + OOFF
         /// </summary>
-        internal static string WriteMidxFile(string dir, string[] sortedOidHexes, string[] packNames)
+        internal static string WriteMidxFile(string dir, string[] sortedOidHexes, string[] packNames, uint[] packIds = null, uint[] offsets = null)
         {
             int numObjects = sortedOidHexes.Length;
             int numPacks = packNames.Length;
@@ -183,8 +183,16 @@ internal static string WriteMidxFile(string dir, string[] sortedOidHexes, string
                 Array.Copy(oid, 0, oidlBytes, i * 20, 20);
             }
 
-            // OOFF: dummy 8-byte entries per object (pack-id:4 + offset:4)
+            // OOFF: 8-byte entries per object (pack-id:4 + offset:4), dummy unless provided
             byte[] ooffBytes = new byte[numObjects * 8];
+            if (packIds != null && offsets != null)
+            {
+                for (int i = 0; i < numObjects; i++)
+                {
+                    WriteBE32(ooffBytes, i * 8, packIds[i]);
+                    WriteBE32(ooffBytes, (i * 8) + 4, offsets[i]);
+                }
+            }
 
             // Chunk layout: 3 chunks (PNAM, OIDF, OIDL) + OOFF for terminator boundary
             int numChunks = 4; // PNAM, OIDF, OIDL, OOFF
@@ -266,6 +274,14 @@ private static void WriteBE32(BinaryWriter bw, uint value)
             bw.Write((byte)value);
         }
 
+        private static void WriteBE32(byte[] buffer, int index, uint value)
+        {
+            buffer[index] = (byte)(value >> 24);
+            buffer[index + 1] = (byte)(value >> 16);
+            buffer[index + 2] = (byte)(value >> 8);
+            buffer[index + 3] = (byte)value;
+        }
+
         private static void WriteBE64(BinaryWriter bw, long value)
         {
             bw.Write((byte)(value >> 56));
@@ -0,0 +1,121 @@
+using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using NUnit.Framework;
+using System;
+using System.IO;
+using System.Linq;
+
+namespace GVFS.UnitTests.Prefetch
+{
+    [TestFixture]
+    public class NativeObjectIndexSetTests
+    {
+        private string tempDir;
+
+        [SetUp]
+        public void SetUp()
+        {
+            if (!NativeObjectIndexSet.IsAvailable)
+            {
+                Assert.Ignore("GVFS.ObjectLookup.dll not found — build the native projects first.");
+            }
+
+            this.tempDir = Path.Combine(Path.GetTempPath(), "NativeObjectIndexSetTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            Directory.CreateDirectory(this.tempDir);
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (this.tempDir != null && Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [Test]
+        public void FindsObjectsInMidxAndIdx()
+        {
+            string[] oids = MidxReaderTests.GenerateSortedOids(2000);
+            string[] midxOids = oids.Where((oid, i) => i % 2 == 0).ToArray();
+            string[] idxOids = oids.Where((oid, i) => i % 2 == 1).ToArray();
+            string midxPath = MidxReaderTests.WriteMidxFile(this.tempDir, midxOids, new[] { "pack-inmidx" });
+            string idxPath = PackIndexReaderTests.WritePackIndexV2(this.tempDir, "pack-supplemental", idxOids);
+
+            NativeObjectIndexSet indexSet;
+            NativeObjectIndexSet.TryOpen(new MockTracer(), new[] { midxPath, idxPath }, out indexSet).ShouldBeTrue();
+            using (indexSet)
+            {
+                indexSet.IndexCount.ShouldEqual(2);
+                foreach (string oid in oids)
+                {
+                    indexSet.Exists(oid).ShouldBeTrue(oid);
+                    indexSet.Exists(oid.ToUpperInvariant()).ShouldBeTrue(oid);
+                }
+
+                indexSet.Exists("0000000000000000000000000000000000000000").ShouldBeFalse();
+                indexSet.Exists("ffffffffffffffffffffffffffffffffffffffff").ShouldBeFalse();
+                indexSet.Exists((string)null).ShouldBeFalse();
+                indexSet.Exists("abc").ShouldBeFalse();
+            }
+        }
+
+        [Test]
+        public void BatchedLookupMatchesSingleLookups()
+        {
+            string[] oids = MidxReaderTests.GenerateSortedOids(1000);
+            string midxPath = MidxReaderTests.WriteMidxFile(this.tempDir, oids.Take(500).ToArray(), new[] { "pack-inmidx" });
+
+            // Every other lookup is an object that is not in the MIDX
+            byte[] lookups = new byte[oids.Length * 20];
+            for (int i = 0; i < oids.Length; i++)
+            {
+                string oid = i % 2 == 0 ? oids[i / 2] : oids[500 + (i / 2)];
+                MidxReader.HexToBytes(oid, lookups.AsSpan(i * 20, 20));
+            }
+
+            NativeObjectIndexSet indexSet;
+            NativeObjectIndexSet.TryOpen(new MockTracer(), new[] { midxPath }, out indexSet).ShouldBeTrue();
+            using (indexSet)
+            {
+                byte[] results = new byte[oids.Length];
+                indexSet.ExistsMany(lookups, results).ShouldEqual(500);
+                for (int i = 0; i < oids.Length; i++)
+                {
+                    results[i].ShouldEqual(i % 2 == 0 ? (byte)1 : (byte)0);
+                    indexSet.Exists(lookups.AsSpan(i * 20, 20)).ShouldEqual(i % 2 == 0);
+                }
+            }
+        }
+
+        [Test]
+        public void HandlesEmptyMidx()
+        {
+            string midxPath = MidxReaderTests.WriteMidxFile(this.tempDir, Array.Empty<string>(), new[] { "pack-empty" });
+
+            NativeObjectIndexSet indexSet;
+            NativeObjectIndexSet.TryOpen(new MockTracer(), new[] { midxPath }, out indexSet).ShouldBeTrue();
+            using (indexSet)
+            {
+                indexSet.Exists("0000000000000000000000000000000000000000").ShouldBeFalse();
+            }
+        }
+
+        [Test]
+        public void FailsToOpenInvalidOrMissingFiles()
+        {
+            string[] oids = MidxReaderTests.GenerateSortedOids(10);
+            string idxPath = PackIndexReaderTests.WritePackIndexV2(this.tempDir, "pack-valid", oids);
+            string invalidPath = Path.Combine(this.tempDir, "pack-invalid.idx");
+            File.WriteAllBytes(invalidPath, new byte[2048]);
+
+            NativeObjectIndexSet indexSet;
+            NativeObjectIndexSet.TryOpen(new MockTracer(), new[] { idxPath, invalidPath }, out indexSet).ShouldBeFalse();
+            indexSet.ShouldBeNull();
+
+            NativeObjectIndexSet.TryOpen(new MockTracer(), new[] { Path.Combine(this.tempDir, "missing.idx") }, out indexSet).ShouldBeFalse();
+            indexSet.ShouldBeNull();
+        }
+    }
+}
@@ -0,0 +1,129 @@
+using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+using System;
+using System.IO;
+using System.Linq;
+
+namespace GVFS.UnitTests.Prefetch
+{
+    [TestFixture]
+    public class ObjectExistenceFilterTests
+    {
+        private string tempDir;
+        private string objectsRoot;
+        private string packDir;
+
+        [SetUp]
+        public void SetUp()
+        {
+            this.tempDir = Path.Combine(Path.GetTempPath(), "ObjectExistenceFilterTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            this.objectsRoot = Path.Combine(this.tempDir, "objects");
+            this.packDir = Path.Combine(this.objectsRoot, "pack");
+            Directory.CreateDirectory(this.packDir);
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [TestCase]
+        public void ContainsEveryAddedObject()
+        {
+            const int ObjectCount = 20000;
+            Random random = new Random(7);
+            byte[] added = new byte[ObjectCount * 20];
+            random.NextBytes(added);
+
+            ObjectExistenceFilter filter = new ObjectExistenceFilter(ObjectCount);
+            filter.AddObjects(added, ObjectCount);
+            filter.EntryCount.ShouldEqual(ObjectCount);
+
+            for (int i = 0; i < ObjectCount; i++)
+            {
+                filter.MightContain(added.AsSpan(i * 20, 20)).ShouldBeTrue();
+            }
+
+            int falsePositives = 0;
+            byte[] missing = new byte[20];
+            for (int i = 0; i < ObjectCount; i++)
+            {
+                random.NextBytes(missing);
+                if (filter.MightContain(missing))
+                {
+                    ++falsePositives;
+                }
+            }
+
+            // Roughly 1% is expected
+            falsePositives.ShouldBeAtMost(ObjectCount / 33);
+        }
+
+        [TestCase]
+        public void AddsObjectsFromIndexes()
+        {
+            string[] midxOids = MidxReaderTests.GenerateSortedOids(500);
+            string[] idxOids = MidxReaderTests.GenerateSortedOids(1000).Skip(500).ToArray();
+            string midxPath = MidxReaderTests.WriteMidxFile(this.packDir, midxOids, new[] { "pack-midx" });
+            string idxPath = PackIndexReaderTests.WritePackIndexV2(this.packDir, "pack-supplemental", idxOids);
+
+            ObjectExistenceFilter filter = new ObjectExistenceFilter(1000);
+            using (MidxReader reader = new MidxReader(midxPath))
+            {
+                filter.AddObjects(reader);
+            }
+
+            filter.AddPackIndex(idxPath);
+            filter.EntryCount.ShouldEqual(1000);
+
+            foreach (string oid in midxOids.Concat(idxOids))
+            {
+                filter.MightContain(Convert.FromHexString(oid)).ShouldBeTrue(oid);
+            }
+        }
+
+        [TestCase]
+        public void ReadsLooseObjectIdsAndSkipsOtherFiles()
+        {
+            string[] looseOids = MidxReaderTests.GenerateSortedOids(300);
+            foreach (string oid in looseOids)
+            {
+                string looseDir = Path.Combine(this.objectsRoot, oid.Substring(0, 2));
+                Directory.CreateDirectory(looseDir);
+                File.WriteAllBytes(Path.Combine(looseDir, oid.Substring(2)), new byte[] { 0x78, 0x01 });
+            }
+
+            string tempDirectory = Path.Combine(this.objectsRoot, looseOids[0].Substring(0, 2));
+            File.WriteAllBytes(Path.Combine(tempDirectory, "tmp_obj_123456"), new byte[1]);
+            File.WriteAllBytes(Path.Combine(tempDirectory, new string('z', 38)), new byte[1]);
+            File.WriteAllBytes(Path.Combine(this.packDir, looseOids[1].Substring(2)), new byte[1]);
+
+            byte[] oids = ObjectExistenceFilter.ReadLooseObjectIds(this.objectsRoot, out int count);
+            count.ShouldEqual(looseOids.Length);
+
+            string[] read = Enumerable.Range(0, count)
+                .Select(i => Convert.ToHexString(oids, i * 20, 20).ToLowerInvariant())
+                .OrderBy(oid => oid, StringComparer.Ordinal)
+                .ToArray();
+            read.ShouldMatchInOrder(looseOids);
+        }
+
+        [TestCase]
+        public void TryAddRejectsInvalidShas()
+        {
+            ObjectExistenceFilter filter = new ObjectExistenceFilter(10);
+            filter.TryAdd(null).ShouldBeFalse();
+            filter.TryAdd("abc").ShouldBeFalse();
+            filter.TryAdd(new string('g', 40)).ShouldBeFalse();
+            filter.EntryCount.ShouldEqual(0);
+
+            filter.TryAdd("AABBCCDDEE112233445566778899001122334455").ShouldBeTrue();
+            filter.MightContain(Convert.FromHexString("aabbccddee112233445566778899001122334455")).ShouldBeTrue();
+        }
+    }
+}
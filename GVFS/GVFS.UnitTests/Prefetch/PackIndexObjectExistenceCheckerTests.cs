@@ -107,6 +107,51 @@ public void FindsLooseObject()
             }
         }
 
+        [Test]
+        public void LooseObjectWrittenAfterCreationIsFoundOnceAddedToFilter()
+        {
+            string sha = "aabbccddee112233445566778899001122334455";
+            using (PackIndexObjectExistenceChecker checker = new PackIndexObjectExistenceChecker(
+                MockTracerProvider.CreateMockTracer(),
+                this.objectsRoot))
+            {
+                string looseDir = Path.Combine(this.objectsRoot, sha.Substring(0, 2));
+                Directory.CreateDirectory(looseDir);
+                File.WriteAllBytes(Path.Combine(looseDir, sha.Substring(2)), new byte[] { 0x78, 0x01 });
+
+                // Not in the loose object snapshot, so the filter answers without checking the file
+                checker.ObjectExists(sha).ShouldBeFalse();
+
+                checker.ExistenceFilter.TryAdd(sha).ShouldBeTrue();
+                checker.ObjectExists(sha).ShouldBeTrue();
+            }
+        }
+
+        [Test]
+        public void FindsObjectsInPacksAddedAfterRefresh()
+        {
+            string[] oids = MidxReaderTests.GenerateSortedOids(100);
+            string[] midxOids = oids.Where((oid, i) => i % 2 == 0).ToArray();
+            string[] laterOids = oids.Where((oid, i) => i % 2 == 1).ToArray();
+            MidxReaderTests.WriteMidxFile(this.packDir, midxOids, new[] { "pack-inmidx" });
+
+            using (PackIndexObjectExistenceChecker checker = new PackIndexObjectExistenceChecker(
+                MockTracerProvider.CreateMockTracer(),
+                this.objectsRoot))
+            {
+                checker.ObjectExists(laterOids[0]).ShouldBeFalse();
+
+                PackIndexReaderTests.WritePackIndexV2(this.packDir, "pack-later", laterOids);
+                checker.Refresh();
+
+                checker.ObjectExists(midxOids[0]).ShouldBeTrue("MIDX object should still be found");
+                foreach (string oid in laterOids)
+                {
+                    checker.ObjectExists(oid).ShouldBeTrue("Object in pack added after creation should be found");
+                }
+            }
+        }
+
         [Test]
         public void ReturnsFalseForMissingObject()
         {
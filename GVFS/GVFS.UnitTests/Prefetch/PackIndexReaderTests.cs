@@ -86,7 +86,7 @@ public void ThrowsOnInvalidMagic()
         /// Writes a synthetic pack index v2 file.
         /// Format: Magic(4) + Version(4) + Fanout(256*4) + OIDs(N*20) + CRC32(N*4) + Offsets(N*4) + PackSHA(20) + IdxSHA(20)
         /// </summary>
-        internal static string WritePackIndexV2(string dir, string packStem, string[] sortedOidHexes)
+        internal static string WritePackIndexV2(string dir, string packStem, string[] sortedOidHexes, uint[] offsets = null)
         {
             int numObjects = sortedOidHexes.Length;
 
@@ -132,8 +132,18 @@ internal static string WritePackIndexV2(string dir, string packStem, string[] so
                 // CRC32 table (dummy)
                 bw.Write(new byte[numObjects * 4]);
 
-                // Offset table (dummy)
-                bw.Write(new byte[numObjects * 4]);
+                // Offset table (dummy unless offsets are provided)
+                if (offsets != null)
+                {
+                    foreach (uint offset in offsets)
+                    {
+                        WriteBE32(bw, offset);
+                    }
+                }
+                else
+                {
+                    bw.Write(new byte[numObjects * 4]);
+                }
 
                 // Pack SHA + Idx SHA (dummy)
                 bw.Write(new byte[40]);
@@ -0,0 +1,282 @@
+﻿using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using NUnit.Framework;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.Compression;
+using System.Linq;
+
+namespace GVFS.UnitTests.Prefetch
+{
+    [TestFixture]
+    public class PackObjectSizeReaderTests
+    {
+        private const string PackStem = "pack-sizes";
+
+        private const string BlobSha = "1111111111111111111111111111111111111111";
+        private const string OfsDeltaBlobSha = "2222222222222222222222222222222222222222";
+        private const string RefDeltaBlobSha = "3333333333333333333333333333333333333333";
+        private const string TreeSha = "4444444444444444444444444444444444444444";
+        private const string OfsDeltaTreeSha = "5555555555555555555555555555555555555555";
+        private const string MissingSha = "6666666666666666666666666666666666666666";
+
+        private const int BlobSize = 1100;
+        private const int OfsDeltaBlobSize = 2000;
+        private const int RefDeltaBlobSize = 300000;
+
+        private string tempDir;
+        private string objectsRoot;
+        private string packDir;
+
+        [SetUp]
+        public void SetUp()
+        {
+            this.tempDir = Path.Combine(Path.GetTempPath(), "PackObjectSizeReaderTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            this.objectsRoot = Path.Combine(this.tempDir, "objects");
+            this.packDir = Path.Combine(this.objectsRoot, "pack");
+            Directory.CreateDirectory(this.packDir);
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [TestCase(false)]
+        [TestCase(true)]
+        public void ReadsSizesOfPackedBlobs(bool useMidx)
+        {
+            this.WritePackAndIndex(useMidx);
+
+            using (PackObjectSizeReader reader = new PackObjectSizeReader(new MockTracer(), this.objectsRoot))
+            {
+                reader.IndexCount.ShouldEqual(1);
+
+                reader.TryGetBlobSize(new Sha1Id(BlobSha), out long size).ShouldBeTrue();
+                size.ShouldEqual(BlobSize);
+
+                reader.TryGetBlobSize(new Sha1Id(OfsDeltaBlobSha), out size).ShouldBeTrue();
+                size.ShouldEqual(OfsDeltaBlobSize);
+
+                reader.TryGetBlobSize(new Sha1Id(RefDeltaBlobSha), out size).ShouldBeTrue();
+                size.ShouldEqual(RefDeltaBlobSize);
+            }
+        }
+
+        [TestCase(false)]
+        [TestCase(true)]
+        public void DoesNotReturnSizesOfTreesOrMissingObjects(bool useMidx)
+        {
+            this.WritePackAndIndex(useMidx);
+
+            using (PackObjectSizeReader reader = new PackObjectSizeReader(new MockTracer(), this.objectsRoot))
+            {
+                reader.TryGetBlobSize(new Sha1Id(TreeSha), out long size).ShouldBeFalse();
+                size.ShouldEqual(-1);
+
+                reader.TryGetBlobSize(new Sha1Id(OfsDeltaTreeSha), out size).ShouldBeFalse();
+                size.ShouldEqual(-1);
+
+                reader.TryGetBlobSize(new Sha1Id(MissingSha), out size).ShouldBeFalse();
+                size.ShouldEqual(-1);
+            }
+        }
+
+        [TestCase]
+        public void NoIndexesWhenThereAreNoPacks()
+        {
+            using (PackObjectSizeReader reader = new PackObjectSizeReader(new MockTracer(), this.objectsRoot, Path.Combine(this.tempDir, "missing")))
+            {
+                reader.IndexCount.ShouldEqual(0);
+                reader.TryGetBlobSize(new Sha1Id(BlobSha), out long _).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void IndexCacheKeepsIndexesOpenWhileReadersUseThem()
+        {
+            this.WritePackAndIndex(useMidx: true);
+
+            PackObjectSizeReader.IndexCache indexCache = new PackObjectSizeReader.IndexCache(new MockTracer(), this.objectsRoot);
+            using (PackObjectSizeReader reader = indexCache.CreateReader())
+            {
+                using (PackObjectSizeReader firstBatch = indexCache.CreateReader())
+                {
+                    firstBatch.TryGetBlobSize(new Sha1Id(BlobSha), out long _).ShouldBeTrue();
+                }
+
+                // Neither disposing another reader of the same indexes nor the cache closes them
+                indexCache.Dispose();
+                reader.IndexCount.ShouldEqual(1);
+                reader.TryGetBlobSize(new Sha1Id(OfsDeltaBlobSha), out long size).ShouldBeTrue();
+                size.ShouldEqual(OfsDeltaBlobSize);
+            }
+        }
+
+        [TestCase]
+        public void IndexCacheReloadsWhenPacksAreAdded()
+        {
+            using (PackObjectSizeReader.IndexCache indexCache = new PackObjectSizeReader.IndexCache(new MockTracer(), this.objectsRoot))
+            using (PackObjectSizeReader beforeAdd = indexCache.CreateReader())
+            {
+                beforeAdd.IndexCount.ShouldEqual(0);
+
+                this.WritePackAndIndex(useMidx: false);
+
+                using (PackObjectSizeReader afterAdd = indexCache.CreateReader())
+                {
+                    afterAdd.IndexCount.ShouldEqual(1);
+                    afterAdd.TryGetBlobSize(new Sha1Id(BlobSha), out long size).ShouldBeTrue();
+                    size.ShouldEqual(BlobSize);
+                }
+
+                // Readers created before the reload keep using the indexes they were created with
+                beforeAdd.TryGetBlobSize(new Sha1Id(BlobSha), out long _).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void DeltaSizesAreDecoded()
+        {
+            byte[] buffer = EncodeDeltaSize(0).Concat(EncodeDeltaSize(127)).Concat(EncodeDeltaSize(128)).Concat(EncodeDeltaSize(uint.MaxValue + 1L)).ToArray();
+            int position = 0;
+
+            PackObjectSizeReader.TryReadDeltaSize(buffer, ref position, out long size).ShouldBeTrue();
+            size.ShouldEqual(0);
+            PackObjectSizeReader.TryReadDeltaSize(buffer, ref position, out size).ShouldBeTrue();
+            size.ShouldEqual(127);
+            PackObjectSizeReader.TryReadDeltaSize(buffer, ref position, out size).ShouldBeTrue();
+            size.ShouldEqual(128);
+            PackObjectSizeReader.TryReadDeltaSize(buffer, ref position, out size).ShouldBeTrue();
+            size.ShouldEqual(uint.MaxValue + 1L);
+            position.ShouldEqual(buffer.Length);
+
+            // Truncated varint
+            position = 0;
+            PackObjectSizeReader.TryReadDeltaSize(new byte[] { 0x80 }, ref position, out size).ShouldBeFalse();
+        }
+
+        internal static byte[] EncodeEntryHeader(int type, long size)
+        {
+            List<byte> header = new List<byte>();
+            byte b = (byte)((type << 4) | (int)(size & 0xF));
+            size >>= 4;
+            while (size != 0)
+            {
+                header.Add((byte)(b | 0x80));
+                b = (byte)(size & 0x7F);
+                size >>= 7;
+            }
+
+            header.Add(b);
+            return header.ToArray();
+        }
+
+        internal static byte[] EncodeOfsDeltaDistance(long distance)
+        {
+            // Same encoding as git's pack-objects: most significant group first, with 1
+            // subtracted from each group but the last
+            List<byte> encoded = new List<byte>();
+            encoded.Add((byte)(distance & 0x7F));
+            while ((distance >>= 7) != 0)
+            {
+                --distance;
+                encoded.Insert(0, (byte)(0x80 | (distance & 0x7F)));
+            }
+
+            return encoded.ToArray();
+        }
+
+        internal static byte[] EncodeDeltaSize(long size)
+        {
+            List<byte> encoded = new List<byte>();
+            do
+            {
+                byte b = (byte)(size & 0x7F);
+                size >>= 7;
+                encoded.Add(size != 0 ? (byte)(b | 0x80) : b);
+            }
+            while (size != 0);
+
+            return encoded.ToArray();
+        }
+
+        internal static byte[] Deflate(byte[] data)
+        {
+            using (MemoryStream output = new MemoryStream())
+            {
+                using (ZLibStream zlib = new ZLibStream(output, CompressionLevel.Optimal))
+                {
+                    zlib.Write(data, 0, data.Length);
+                }
+
+                return output.ToArray();
+            }
+        }
+
+        private static byte[] CreateDelta(long baseSize, long resultSize)
+        {
+            // Only the sizes at the start of the delta are read, the instructions that follow are never applied
+            List<byte> delta = new List<byte>();
+            delta.AddRange(EncodeDeltaSize(baseSize));
+            delta.AddRange(EncodeDeltaSize(resultSize));
+            delta.AddRange(new byte[] { 0x90, 0x10 });
+            return delta.ToArray();
+        }
+
+        private static byte[] HexToBytes(string hex)
+        {
+            return Enumerable.Range(0, hex.Length / 2).Select(i => Convert.ToByte(hex.Substring(i * 2, 2), 16)).ToArray();
+        }
+
+        private void WritePackAndIndex(bool useMidx)
+        {
+            Dictionary<string, uint> offsets = new Dictionary<string, uint>();
+            using (FileStream pack = File.Create(Path.Combine(this.packDir, PackStem + ".pack")))
+            {
+                // Header: PACK, version 2, object count
+                pack.Write(new byte[] { (byte)'P', (byte)'A', (byte)'C', (byte)'K', 0, 0, 0, 2, 0, 0, 0, 5 });
+
+                offsets[BlobSha] = (uint)pack.Position;
+                pack.Write(EncodeEntryHeader(3, BlobSize));
+                pack.Write(Deflate(new byte[BlobSize]));
+
+                offsets[OfsDeltaBlobSha] = (uint)pack.Position;
+                pack.Write(EncodeEntryHeader(6, 4));
+                pack.Write(EncodeOfsDeltaDistance(offsets[OfsDeltaBlobSha] - offsets[BlobSha]));
+                pack.Write(Deflate(CreateDelta(BlobSize, OfsDeltaBlobSize)));
+
+                // A chain of REF_DELTA -> OFS_DELTA -> blob
+                offsets[RefDeltaBlobSha] = (uint)pack.Position;
+                pack.Write(EncodeEntryHeader(7, 6));
+                pack.Write(HexToBytes(OfsDeltaBlobSha));
+                pack.Write(Deflate(CreateDelta(OfsDeltaBlobSize, RefDeltaBlobSize)));
+
+                offsets[TreeSha] = (uint)pack.Position;
+                pack.Write(EncodeEntryHeader(2, 50));
+                pack.Write(Deflate(new byte[50]));
+
+                offsets[OfsDeltaTreeSha] = (uint)pack.Position;
+                pack.Write(EncodeEntryHeader(6, 4));
+                pack.Write(EncodeOfsDeltaDistance(offsets[OfsDeltaTreeSha] - offsets[TreeSha]));
+                pack.Write(Deflate(CreateDelta(50, 60)));
+            }
+
+            string[] sortedOids = offsets.Keys.Select(sha => sha.ToLowerInvariant()).OrderBy(sha => sha, StringComparer.Ordinal).ToArray();
+            uint[] sortedOffsets = sortedOids.Select(sha => offsets[sha.ToUpperInvariant()]).ToArray();
+
+            PackIndexReaderTests.WritePackIndexV2(this.packDir, PackStem, sortedOids, sortedOffsets);
+            if (useMidx)
+            {
+                // The idx is covered by the MIDX and so it should not be loaded separately
+                MidxReaderTests.WriteMidxFile(this.packDir, sortedOids, new[] { PackStem }, new uint[sortedOids.Length], sortedOffsets);
+            }
+        }
+    }
+}
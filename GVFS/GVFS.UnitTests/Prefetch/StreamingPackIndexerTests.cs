@@ -0,0 +1,210 @@
+using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Security.Cryptography;
+using System.Text;
+
+namespace GVFS.UnitTests.Prefetch
+{
+    [TestFixture]
+    public class StreamingPackIndexerTests
+    {
+        private string tempDir;
+
+        [SetUp]
+        public void SetUp()
+        {
+            this.tempDir = Path.Combine(Path.GetTempPath(), "StreamingPackIndexerTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            Directory.CreateDirectory(this.tempDir);
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [TestCase(1)]
+        [TestCase(7)]
+        [TestCase(4096)]
+        public void IndexesEveryObjectInThePack(int writeSize)
+        {
+            byte[] pack = CreatePack(out Dictionary<string, long> offsets, includeMissingBase: false);
+            string idxPath = this.IndexPack(pack, writeSize, out StreamingPackIndexer indexer);
+
+            using (indexer)
+            {
+                indexer.IsComplete.ShouldBeTrue();
+                indexer.ObjectCount.ShouldEqual(offsets.Count);
+                indexer.DeltaCount.ShouldEqual(3);
+                indexer.TryWriteIndex(idxPath, out string error).ShouldBeTrue(error);
+            }
+
+            using (PackIndexReader reader = new PackIndexReader(idxPath))
+            {
+                reader.TotalObjects.ShouldEqual(offsets.Count);
+                foreach (KeyValuePair<string, long> expected in offsets)
+                {
+                    reader.TryGetOffset(Convert.FromHexString(expected.Key), out long offset).ShouldBeTrue(expected.Key);
+                    offset.ShouldEqual(expected.Value);
+                }
+            }
+        }
+
+        [TestCase]
+        public void PackWithBadChecksumIsNotIndexed()
+        {
+            byte[] pack = CreatePack(out Dictionary<string, long> _, includeMissingBase: false);
+            pack[pack.Length - 1] ^= 0xFF;
+            string idxPath = this.IndexPack(pack, 4096, out StreamingPackIndexer indexer);
+
+            using (indexer)
+            {
+                indexer.IsComplete.ShouldBeFalse();
+                indexer.TryWriteIndex(idxPath, out string error).ShouldBeFalse();
+                error.ShouldContain("checksum");
+                File.Exists(idxPath).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void TruncatedPackIsNotIndexed()
+        {
+            byte[] pack = CreatePack(out Dictionary<string, long> _, includeMissingBase: false);
+            string idxPath = this.IndexPack(pack.Take(pack.Length / 2).ToArray(), 4096, out StreamingPackIndexer indexer);
+
+            using (indexer)
+            {
+                indexer.IsComplete.ShouldBeFalse();
+                indexer.TryWriteIndex(idxPath, out string _).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void PackWithMissingDeltaBaseIsNotIndexed()
+        {
+            // A thin pack, which has deltas against objects that are not in the pack, cannot be indexed on its own
+            byte[] pack = CreatePack(out Dictionary<string, long> _, includeMissingBase: true);
+            string idxPath = this.IndexPack(pack, 4096, out StreamingPackIndexer indexer);
+
+            using (indexer)
+            {
+                indexer.IsComplete.ShouldBeTrue();
+                indexer.TryWriteIndex(idxPath, out string error).ShouldBeFalse();
+                error.ShouldContain("not in the pack");
+            }
+        }
+
+        private static byte[] CreatePack(out Dictionary<string, long> offsets, bool includeMissingBase)
+        {
+            byte[] blob = Encoding.ASCII.GetBytes(string.Concat(Enumerable.Range(0, 200).Select(i => $"line {i}\n")));
+            byte[] tree = new byte[40];
+
+            // OFS_DELTA: keep the first 1000 bytes of the blob and append some text
+            byte[] appended = Encoding.ASCII.GetBytes("appended text");
+            byte[] ofsDeltaResult = blob.Take(1000).Concat(appended).ToArray();
+            byte[] ofsDelta = CreateDelta(blob.Length, ofsDeltaResult.Length, CopyInstruction(0, 1000), InsertInstruction(appended));
+
+            // REF_DELTA on the OFS_DELTA: copy the last 100 bytes, which requires the OFS_DELTA to be resolved first
+            byte[] refDeltaResult = ofsDeltaResult.Skip(ofsDeltaResult.Length - 100).ToArray();
+            byte[] refDelta = CreateDelta(ofsDeltaResult.Length, refDeltaResult.Length, CopyInstruction(ofsDeltaResult.Length - 100, 100));
+
+            // A tree delta, to check that the resolved object uses the type of its base
+            byte[] treeDeltaResult = tree.Concat(appended).ToArray();
+            byte[] treeDelta = CreateDelta(tree.Length, treeDeltaResult.Length, CopyInstruction(0, tree.Length), InsertInstruction(appended));
+
+            string blobSha = ComputeObjectId("blob", blob);
+            string ofsDeltaSha = ComputeObjectId("blob", ofsDeltaResult);
+            string refDeltaSha = ComputeObjectId("blob", refDeltaResult);
+            string treeSha = ComputeObjectId("tree", tree);
+            string treeDeltaSha = ComputeObjectId("tree", treeDeltaResult);
+
+            offsets = new Dictionary<string, long>();
+            using (MemoryStream pack = new MemoryStream())
+            {
+                int objectCount = includeMissingBase ? 6 : 5;
+                pack.Write(new byte[] { (byte)'P', (byte)'A', (byte)'C', (byte)'K', 0, 0, 0, 2, 0, 0, 0, (byte)objectCount });
+
+                // The REF_DELTA comes before its base to check that deltas are not resolved in pack order
+                offsets[refDeltaSha] = pack.Position;
+                pack.Write(PackObjectSizeReaderTests.EncodeEntryHeader(7, refDelta.Length));
+                pack.Write(Convert.FromHexString(ofsDeltaSha));
+                pack.Write(PackObjectSizeReaderTests.Deflate(refDelta));
+
+                offsets[blobSha] = pack.Position;
+                pack.Write(PackObjectSizeReaderTests.EncodeEntryHeader(3, blob.Length));
+                pack.Write(PackObjectSizeReaderTests.Deflate(blob));
+
+                offsets[ofsDeltaSha] = pack.Position;
+                pack.Write(PackObjectSizeReaderTests.EncodeEntryHeader(6, ofsDelta.Length));
+                pack.Write(PackObjectSizeReaderTests.EncodeOfsDeltaDistance(offsets[ofsDeltaSha] - offsets[blobSha]));
+                pack.Write(PackObjectSizeReaderTests.Deflate(ofsDelta));
+
+                offsets[treeSha] = pack.Position;
+                pack.Write(PackObjectSizeReaderTests.EncodeEntryHeader(2, tree.Length));
+                pack.Write(PackObjectSizeReaderTests.Deflate(tree));
+
+                offsets[treeDeltaSha] = pack.Position;
+                pack.Write(PackObjectSizeReaderTests.EncodeEntryHeader(6, treeDelta.Length));
+                pack.Write(PackObjectSizeReaderTests.EncodeOfsDeltaDistance(offsets[treeDeltaSha] - offsets[treeSha]));
+                pack.Write(PackObjectSizeReaderTests.Deflate(treeDelta));
+
+                if (includeMissingBase)
+                {
+                    pack.Write(PackObjectSizeReaderTests.EncodeEntryHeader(7, refDelta.Length));
+                    pack.Write(new byte[20]);
+                    pack.Write(PackObjectSizeReaderTests.Deflate(refDelta));
+                }
+
+                pack.Write(SHA1.HashData(pack.ToArray()));
+                return pack.ToArray();
+            }
+        }
+
+        private static byte[] CreateDelta(long baseSize, long resultSize, params byte[][] instructions)
+        {
+            return PackObjectSizeReaderTests.EncodeDeltaSize(baseSize)
+                .Concat(PackObjectSizeReaderTests.EncodeDeltaSize(resultSize))
+                .Concat(instructions.SelectMany(instruction => instruction))
+                .ToArray();
+        }
+
+        private static byte[] CopyInstruction(int offset, int size)
+        {
+            // Always write two offset and two size bytes, zero bytes could be omitted but do not have to be
+            return new byte[] { 0x80 | 0x01 | 0x02 | 0x10 | 0x20, (byte)offset, (byte)(offset >> 8), (byte)size, (byte)(size >> 8) };
+        }
+
+        private static byte[] InsertInstruction(byte[] data)
+        {
+            return new byte[] { (byte)data.Length }.Concat(data).ToArray();
+        }
+
+        private static string ComputeObjectId(string type, byte[] content)
+        {
+            byte[] header = Encoding.ASCII.GetBytes($"{type} {content.Length}\0");
+            return Convert.ToHexString(SHA1.HashData(header.Concat(content).ToArray())).ToLowerInvariant();
+        }
+
+        private string IndexPack(byte[] pack, int writeSize, out StreamingPackIndexer indexer)
+        {
+            string packPath = Path.Combine(this.tempDir, "pack-streamed.pack");
+            File.WriteAllBytes(packPath, pack);
+
+            indexer = new StreamingPackIndexer(packPath);
+            for (int offset = 0; offset < pack.Length; offset += writeSize)
+            {
+                indexer.Write(pack, offset, Math.Min(writeSize, pack.Length - offset));
+            }
+
+            return Path.ChangeExtension(packPath, ".idx");
+        }
+    }
+}
@@ -0,0 +1,213 @@
+﻿using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using GVFS.Virtualization.BlobSize;
+using NUnit.Framework;
+using System;
+using System.IO;
+
+namespace GVFS.UnitTests.Virtualization.BlobSize
+{
+    [TestFixture]
+    public class BlobSizesHashFileTests
+    {
+        private string tempDir;
+
+        [SetUp]
+        public void SetUp()
+        {
+            this.tempDir = Path.Combine(Path.GetTempPath(), "BlobSizesHashFileTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            Directory.CreateDirectory(this.tempDir);
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [TestCase]
+        public void AddedSizesCanBeFound()
+        {
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            {
+                for (int i = 1; i <= 1000; ++i)
+                {
+                    hashFile.TryAdd(CreateSha(i), i * 10).ShouldBeTrue();
+                }
+
+                hashFile.Count.ShouldEqual(1000);
+                for (int i = 1; i <= 1000; ++i)
+                {
+                    hashFile.TryGetSize(CreateSha(i), out long size).ShouldBeTrue();
+                    size.ShouldEqual(i * 10);
+                }
+            }
+        }
+
+        [TestCase]
+        public void MissingShaIsNotFound()
+        {
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            {
+                hashFile.TryAdd(CreateSha(1), 10).ShouldBeTrue();
+                hashFile.TryGetSize(CreateSha(2), out long size).ShouldBeFalse();
+                size.ShouldEqual(-1);
+            }
+        }
+
+        [TestCase]
+        public void BatchLookupFindsAddedSizes()
+        {
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            {
+                for (int i = 1; i <= 100; ++i)
+                {
+                    hashFile.TryAdd(CreateSha(i), i * 10).ShouldBeTrue();
+                }
+
+                // Look up the odd seeds from 1 to 199 (only the first 50 were added), and enough of them to
+                // span several prefetch batches
+                Sha1Id[] shas = new Sha1Id[100];
+                long[] sizes = new long[shas.Length];
+                for (int i = 0; i < shas.Length; ++i)
+                {
+                    shas[i] = CreateSha((i * 2) + 1);
+                }
+
+                hashFile.TryGetSizes(shas, sizes).ShouldEqual(50);
+                for (int i = 0; i < shas.Length; ++i)
+                {
+                    int seed = (i * 2) + 1;
+                    sizes[i].ShouldEqual(seed <= 100 ? seed * 10 : -1);
+                }
+            }
+        }
+
+        [TestCase]
+        public void ShasThatDifferAfterFirstEightBytesAreDistinct()
+        {
+            Sha1Id first = new Sha1Id("1111111111111111AAAAAAAAAAAAAAAAAAAAAAAA");
+            Sha1Id second = new Sha1Id("1111111111111111AAAAAAAAAAAAAAAABBBBBBBB");
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            {
+                hashFile.TryAdd(first, 1).ShouldBeTrue();
+                hashFile.TryAdd(second, 2).ShouldBeTrue();
+                hashFile.TryGetSize(first, out long firstSize).ShouldBeTrue();
+                hashFile.TryGetSize(second, out long secondSize).ShouldBeTrue();
+                firstSize.ShouldEqual(1);
+                secondSize.ShouldEqual(2);
+            }
+        }
+
+        [TestCase]
+        public void AddingExistingShaKeepsFirstSize()
+        {
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            {
+                hashFile.TryAdd(CreateSha(1), 10).ShouldBeTrue();
+                hashFile.TryAdd(CreateSha(1), 20).ShouldBeTrue();
+                hashFile.Count.ShouldEqual(1);
+                hashFile.TryGetSize(CreateSha(1), out long size).ShouldBeTrue();
+                size.ShouldEqual(10);
+            }
+        }
+
+        [TestCase]
+        public void ShaStartingWithZerosIsNotStored()
+        {
+            Sha1Id sha = new Sha1Id("0000000000000000AAAAAAAAAAAAAAAAAAAAAAAA");
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            {
+                hashFile.TryAdd(sha, 10).ShouldBeFalse();
+                hashFile.TryGetSize(sha, out long _).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void FullHashFileRejectsNewShas()
+        {
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            {
+                long maxCount = (BlobSizesHashFile.MinimumSlotCount * BlobSizesHashFile.MaxLoadPercent) / 100;
+                for (int i = 1; i <= maxCount; ++i)
+                {
+                    hashFile.TryAdd(CreateSha(i), i).ShouldBeTrue();
+                }
+
+                hashFile.IsFull.ShouldBeTrue();
+                hashFile.TryAdd(CreateSha((int)maxCount + 1), 1).ShouldBeFalse();
+            }
+        }
+
+        [TestCase]
+        public void SizesArePersisted()
+        {
+            string path = this.GetPath();
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(path, BlobSizesHashFile.MinimumSlotCount))
+            {
+                hashFile.TryAdd(CreateSha(1), 10).ShouldBeTrue();
+                hashFile.Flush();
+            }
+
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Open(path))
+            {
+                hashFile.Count.ShouldEqual(1);
+                hashFile.SlotCount.ShouldEqual(BlobSizesHashFile.MinimumSlotCount);
+                hashFile.TryGetSize(CreateSha(1), out long size).ShouldBeTrue();
+                size.ShouldEqual(10);
+            }
+        }
+
+        [TestCase]
+        public void CopyToLargerHashFile()
+        {
+            using (BlobSizesHashFile hashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount))
+            using (BlobSizesHashFile largerHashFile = BlobSizesHashFile.Create(this.GetPath(), BlobSizesHashFile.MinimumSlotCount * 2))
+            {
+                for (int i = 1; i <= 1000; ++i)
+                {
+                    hashFile.TryAdd(CreateSha(i), i).ShouldBeTrue();
+                }
+
+                hashFile.CopyTo(largerHashFile).ShouldEqual(0);
+                largerHashFile.Count.ShouldEqual(1000);
+                for (int i = 1; i <= 1000; ++i)
+                {
+                    largerHashFile.TryGetSize(CreateSha(i), out long size).ShouldBeTrue();
+                    size.ShouldEqual(i);
+                }
+            }
+        }
+
+        [TestCase]
+        public void OpenThrowsForInvalidFile()
+        {
+            string path = this.GetPath();
+            File.WriteAllBytes(path, new byte[BlobSizesHashFile.HeaderSize + BlobSizesHashFile.SlotSize]);
+            Assert.Throws<InvalidDataException>(() => BlobSizesHashFile.Open(path));
+        }
+
+        [TestCase]
+        public void SlotCountForEntriesIsAtMostHalfFull()
+        {
+            BlobSizesHashFile.GetSlotCountForEntries(0).ShouldEqual(BlobSizesHashFile.MinimumSlotCount);
+            BlobSizesHashFile.GetSlotCountForEntries(BlobSizesHashFile.MinimumSlotCount).ShouldEqual(BlobSizesHashFile.MinimumSlotCount * 2);
+            BlobSizesHashFile.GetSlotCountForEntries((BlobSizesHashFile.MinimumSlotCount * 2) + 1).ShouldEqual(BlobSizesHashFile.MinimumSlotCount * 8);
+        }
+
+        private static Sha1Id CreateSha(int seed)
+        {
+            // Spread the seed across the SHA so that the first 8 bytes are never zero
+            ulong value = ((ulong)seed * 0x9E3779B97F4A7C15) | 1;
+            return new Sha1Id(value, value ^ 0xFFFF, (uint)seed);
+        }
+
+        private string GetPath()
+        {
+            return Path.Combine(this.tempDir, Guid.NewGuid().ToString("N") + MemoryMappedBlobSizes.HashFileExtension);
+        }
+    }
+}
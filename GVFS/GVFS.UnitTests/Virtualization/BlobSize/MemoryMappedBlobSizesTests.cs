@@ -0,0 +1,154 @@
+﻿using GVFS.Common.FileSystem;
+using GVFS.Common.Git;
+using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using GVFS.Virtualization.BlobSize;
+using NUnit.Framework;
+using System;
+using System.IO;
+
+namespace GVFS.UnitTests.Virtualization.BlobSize
+{
+    [TestFixture]
+    public class MemoryMappedBlobSizesTests
+    {
+        private string tempDir;
+        private string sharedBlobSizesRoot;
+
+        [SetUp]
+        public void SetUp()
+        {
+            this.tempDir = Path.Combine(Path.GetTempPath(), "MemoryMappedBlobSizesTests_" + Guid.NewGuid().ToString("N").Substring(0, 8));
+            this.sharedBlobSizesRoot = Path.Combine(this.tempDir, "blobSizes");
+            Directory.CreateDirectory(this.sharedBlobSizesRoot);
+        }
+
+        [TearDown]
+        public void TearDown()
+        {
+            if (Directory.Exists(this.tempDir))
+            {
+                Directory.Delete(this.tempDir, recursive: true);
+            }
+        }
+
+        [TestCase]
+        public void EnlistmentsSharingACacheHaveTheirOwnHashFiles()
+        {
+            string enlistment1Root = Path.Combine(this.tempDir, "enlistment1");
+            string enlistment2Root = Path.Combine(this.tempDir, "enlistment2");
+            MemoryMappedBlobSizes blobSizes1 = this.CreateBlobSizes(enlistment1Root);
+            MemoryMappedBlobSizes blobSizes2 = this.CreateBlobSizes(enlistment2Root);
+            try
+            {
+                // Both mounts are running at the same time
+                blobSizes1.Initialize();
+                blobSizes2.Initialize();
+
+                blobSizes1.AddSize(CreateSha(1), 10);
+                blobSizes2.AddSize(CreateSha(2), 20);
+                blobSizes1.Shutdown();
+                blobSizes2.Shutdown();
+
+                TryGetSize(blobSizes1, CreateSha(1)).ShouldEqual(10);
+                TryGetSize(blobSizes2, CreateSha(2)).ShouldEqual(20);
+            }
+            finally
+            {
+                blobSizes1.Dispose();
+                blobSizes2.Dispose();
+            }
+
+            Directory.GetFiles(this.sharedBlobSizesRoot, MemoryMappedBlobSizes.HashFilePrefix + "*").ShouldBeEmpty();
+            Directory.GetFiles(enlistment1Root, MemoryMappedBlobSizes.HashFilePrefix + "*").Length.ShouldEqual(1);
+            Directory.GetFiles(enlistment2Root, MemoryMappedBlobSizes.HashFilePrefix + "*").Length.ShouldEqual(1);
+
+            // The next mount of the enlistment opens the same hash file rather than creating a new generation
+            MemoryMappedBlobSizes remountedBlobSizes = this.CreateBlobSizes(enlistment1Root);
+            try
+            {
+                remountedBlobSizes.Initialize();
+                TryGetSize(remountedBlobSizes, CreateSha(1)).ShouldEqual(10);
+                remountedBlobSizes.Shutdown();
+            }
+            finally
+            {
+                remountedBlobSizes.Dispose();
+            }
+
+            Directory.GetFiles(enlistment1Root, MemoryMappedBlobSizes.HashFilePrefix + "*").Length.ShouldEqual(1);
+        }
+
+        [TestCase]
+        public void LookupsAfterDisposeAreNotFound()
+        {
+            MemoryMappedBlobSizes blobSizes = this.CreateBlobSizes(Path.Combine(this.tempDir, "enlistment"));
+            blobSizes.Initialize();
+            blobSizes.AddSize(CreateSha(1), 10);
+            blobSizes.Shutdown();
+
+            BlobSizes.BlobSizesConnection connection = blobSizes.CreateConnection();
+            connection.TryGetSize(CreateSha(1), out long size).ShouldBeTrue();
+            blobSizes.Dispose();
+
+            connection.TryGetSize(CreateSha(1), out size).ShouldBeFalse();
+            size.ShouldEqual(-1);
+
+            long[] sizes = new long[] { 0 };
+            connection.TryGetSizes(new Sha1Id[] { CreateSha(1) }, sizes).ShouldEqual(0);
+            sizes[0].ShouldEqual(-1);
+        }
+
+        [TestCase]
+        public void DisposeWithoutShutdownStopsTheWriterThread()
+        {
+            string enlistmentRoot = Path.Combine(this.tempDir, "enlistment");
+            MemoryMappedBlobSizes blobSizes = this.CreateBlobSizes(enlistmentRoot);
+            blobSizes.Initialize();
+            blobSizes.AddSize(CreateSha(1), 10);
+
+            // The writer thread adds the queued size before it exits, and so before the hash file is unmapped
+            blobSizes.Dispose();
+
+            MemoryMappedBlobSizes remountedBlobSizes = this.CreateBlobSizes(enlistmentRoot);
+            try
+            {
+                remountedBlobSizes.Initialize();
+                TryGetSize(remountedBlobSizes, CreateSha(1)).ShouldEqual(10);
+                remountedBlobSizes.Shutdown();
+            }
+            finally
+            {
+                remountedBlobSizes.Dispose();
+            }
+        }
+
+        private static long TryGetSize(MemoryMappedBlobSizes blobSizes, Sha1Id sha)
+        {
+            blobSizes.CreateConnection().TryGetSize(sha, out long size);
+            return size;
+        }
+
+        private static Sha1Id CreateSha(int seed)
+        {
+            ulong value = ((ulong)seed * 0x9E3779B97F4A7C15) | 1;
+            return new Sha1Id(value, value ^ 0xFFFF, (uint)seed);
+        }
+
+        private MemoryMappedBlobSizes CreateBlobSizes(string enlistmentHashFileRoot)
+        {
+            return new MemoryMappedBlobSizes(this.sharedBlobSizesRoot, enlistmentHashFileRoot, new MovingFileSystem(), new MockTracer());
+        }
+
+        /// <summary>
+        /// PhysicalFileSystem that does not need the platform (MockPlatform does not support moving files)
+        /// </summary>
+        private class MovingFileSystem : PhysicalFileSystem
+        {
+            public override void MoveAndOverwriteFile(string sourceFileName, string destinationFilename)
+            {
+                File.Move(sourceFileName, destinationFilename, overwrite: true);
+            }
+        }
+    }
+}
@@ -1,6 +1,7 @@
 ﻿using GVFS.Tests.Should;
 using GVFS.UnitTests.Mock.Common;
 using NUnit.Framework;
+using System;
 using System.Text;
 using static GVFS.Virtualization.Projection.GitIndexProjection;
 
@@ -370,6 +371,75 @@ public unsafe void NonASCIICharacters_Compare()
                 });
         }
 
+        [TestCase]
+        public unsafe void GetCaseInsensitiveHashCode_MatchesForDifferentCase()
+        {
+            UseASCIIBytePointer(
+                "FOlderonefile.txtfolder",
+                bufferPtr =>
+                {
+                    LazyUTF8String firstFolder = LazyUTF8String.FromByteArray(bufferPtr + 0, 6);
+                    LazyUTF8String secondFolder = LazyUTF8String.FromByteArray(bufferPtr + 17, 6);
+                    LazyUTF8String file = LazyUTF8String.FromByteArray(bufferPtr + 9, 8);
+                    firstFolder.GetCaseInsensitiveHashCode().ShouldEqual(secondFolder.GetCaseInsensitiveHashCode());
+                    firstFolder.GetCaseInsensitiveHashCode().ShouldNotEqual(file.GetCaseInsensitiveHashCode());
+                });
+        }
+
+        [TestCase]
+        public unsafe void GetCaseInsensitiveHashCode_MatchesForPooledAndStringValues()
+        {
+            UseASCIIBytePointer(
+                "folderonefile.txt",
+                bufferPtr =>
+                {
+                    LazyUTF8String pooledString = LazyUTF8String.FromByteArray(bufferPtr + 9, 8);
+                    int pooledHash = pooledString.GetCaseInsensitiveHashCode();
+                    new LazyUTF8String("FILE.txt").GetCaseInsensitiveHashCode().ShouldEqual(pooledHash);
+
+                    // GetString caches the .NET string and subsequent hashes are computed from it
+                    pooledString.GetString();
+                    pooledString.GetCaseInsensitiveHashCode().ShouldEqual(pooledHash);
+                });
+        }
+
+        [TestCase]
+        public unsafe void GetCaseInsensitiveHashCode_MatchesSpanHash()
+        {
+            UseASCIIBytePointer(
+                "folderonefile.txt",
+                bufferPtr =>
+                {
+                    LazyUTF8String file = LazyUTF8String.FromByteArray(bufferPtr + 9, 8);
+                    LazyUTF8String.GetCaseInsensitiveHashCode("File.TXT".AsSpan()).ShouldEqual(file.GetCaseInsensitiveHashCode());
+                });
+        }
+
+        [TestCase]
+        public unsafe void CompareToSpan_MatchesCompare()
+        {
+            string[] names = new string[] { "folder", "Folder", "fold", "folders", "_folder", "zfolder", "ريلٌ" };
+            foreach (string first in names)
+            {
+                UseUTF8BytePointer(
+                    first,
+                    bufferPtr =>
+                    {
+                        // Compare against string.Compare rather than LazyUTF8String.Compare because the latter would
+                        // convert firstString to a .NET string and the pooled byte comparison would not be tested
+                        LazyUTF8String firstString = LazyUTF8String.FromByteArray(bufferPtr, Encoding.UTF8.GetByteCount(first));
+                        foreach (string second in names)
+                        {
+                            int expected = Math.Sign(string.Compare(first, second, StringComparison.Ordinal));
+                            Math.Sign(firstString.Compare(second.AsSpan(), caseSensitive: true)).ShouldEqual(expected, $"{first} vs {second}");
+
+                            expected = Math.Sign(string.Compare(first, second, StringComparison.OrdinalIgnoreCase));
+                            Math.Sign(firstString.Compare(second.AsSpan(), caseSensitive: false)).ShouldEqual(expected, $"{first} vs {second} ignoring case");
+                        }
+                    });
+            }
+        }
+
         [TestCase]
         public void MinimumPoolSize()
         {
@@ -0,0 +1,162 @@
+﻿using GVFS.Common.Database;
+using GVFS.Tests.Should;
+using NUnit.Framework;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using static GVFS.Virtualization.Projection.GitIndexProjection;
+
+namespace GVFS.UnitTests.Virtualization.Git
+{
+    [TestFixture]
+    public class PlaceholderUpdateWorkQueueTests
+    {
+        private const int ThreadCount = 4;
+
+        [TestCase]
+        public void EmptyPlaceholderListHasNoWorkItems()
+        {
+            PlaceholderUpdateWorkQueue workQueue = new PlaceholderUpdateWorkQueue(new List<IPlaceholderData>(), ThreadCount, StringComparer.OrdinalIgnoreCase);
+            workQueue.WorkItemCount.ShouldEqual(0);
+            workQueue.TryGetNextWorkItem(out int _, out int _).ShouldBeFalse();
+        }
+
+        [TestCase]
+        public void EveryPlaceholderIsInExactlyOneWorkItem()
+        {
+            List<IPlaceholderData> placeholders = CreatePlaceholders(folderCount: 50, filesPerFolder: 37);
+            PlaceholderUpdateWorkQueue workQueue = new PlaceholderUpdateWorkQueue(placeholders, ThreadCount, StringComparer.OrdinalIgnoreCase);
+            workQueue.FolderCount.ShouldEqual(50);
+
+            List<string> processedPaths = new List<string>();
+            foreach (Tuple<int, int> workItem in GetAllWorkItems(workQueue))
+            {
+                for (int i = workItem.Item1; i < workItem.Item2; ++i)
+                {
+                    processedPaths.Add(workQueue.Placeholders[i].Path);
+                }
+            }
+
+            processedPaths.Count.ShouldEqual(placeholders.Count);
+            processedPaths.Distinct(StringComparer.OrdinalIgnoreCase).Count().ShouldEqual(placeholders.Count);
+        }
+
+        [TestCase]
+        public void FolderIsNotSplitAcrossWorkItems()
+        {
+            List<IPlaceholderData> placeholders = CreatePlaceholders(folderCount: 50, filesPerFolder: 37);
+            PlaceholderUpdateWorkQueue workQueue = new PlaceholderUpdateWorkQueue(placeholders, ThreadCount, StringComparer.OrdinalIgnoreCase);
+
+            Dictionary<string, int> folderWorkItems = new Dictionary<string, int>(StringComparer.OrdinalIgnoreCase);
+            int workItemIndex = 0;
+            foreach (Tuple<int, int> workItem in GetAllWorkItems(workQueue))
+            {
+                for (int i = workItem.Item1; i < workItem.Item2; ++i)
+                {
+                    string folder = Path.GetDirectoryName(workQueue.Placeholders[i].Path);
+                    if (folderWorkItems.TryGetValue(folder, out int existingWorkItem))
+                    {
+                        existingWorkItem.ShouldEqual(workItemIndex, $"{folder} was split across work items");
+                    }
+                    else
+                    {
+                        folderWorkItems.Add(folder, workItemIndex);
+                    }
+                }
+
+                ++workItemIndex;
+            }
+
+            folderWorkItems.Count.ShouldEqual(50);
+        }
+
+        [TestCase]
+        public void FoldersWithDifferentCaseAreGroupedTogether()
+        {
+            List<IPlaceholderData> placeholders = new List<IPlaceholderData>();
+            placeholders.Add(CreatePlaceholder(Path.Combine("Folder", "a.txt")));
+            placeholders.Add(CreatePlaceholder(Path.Combine("other", "b.txt")));
+            placeholders.Add(CreatePlaceholder(Path.Combine("folder", "c.txt")));
+
+            PlaceholderUpdateWorkQueue workQueue = new PlaceholderUpdateWorkQueue(placeholders, ThreadCount, StringComparer.OrdinalIgnoreCase);
+            workQueue.FolderCount.ShouldEqual(2);
+            Path.GetFileName(workQueue.Placeholders[0].Path).ShouldEqual("a.txt");
+            Path.GetFileName(workQueue.Placeholders[1].Path).ShouldEqual("c.txt");
+            Path.GetFileName(workQueue.Placeholders[2].Path).ShouldEqual("b.txt");
+        }
+
+        [TestCase]
+        public void LargeFolderIsSplitIntoMaxSizedWorkItems()
+        {
+            int fileCount = (PlaceholderUpdateWorkQueue.MaxPlaceholdersPerWorkItem * 2) + 1;
+            List<IPlaceholderData> placeholders = CreatePlaceholders(folderCount: 1, filesPerFolder: fileCount);
+            PlaceholderUpdateWorkQueue workQueue = new PlaceholderUpdateWorkQueue(placeholders, threadCount: 1, pathComparer: StringComparer.OrdinalIgnoreCase);
+
+            List<Tuple<int, int>> workItems = GetAllWorkItems(workQueue);
+            workItems.Count.ShouldEqual(3);
+            foreach (Tuple<int, int> workItem in workItems)
+            {
+                (workItem.Item2 - workItem.Item1).ShouldBeAtMost(PlaceholderUpdateWorkQueue.MaxPlaceholdersPerWorkItem);
+            }
+
+            workItems[2].Item2.ShouldEqual(fileCount);
+        }
+
+        [TestCase]
+        public void WorkItemsAreSplitForThreads()
+        {
+            List<IPlaceholderData> placeholders = CreatePlaceholders(folderCount: 200, filesPerFolder: 10);
+            PlaceholderUpdateWorkQueue workQueue = new PlaceholderUpdateWorkQueue(placeholders, ThreadCount, StringComparer.OrdinalIgnoreCase);
+            workQueue.WorkItemCount.ShouldBeAtLeast(ThreadCount);
+        }
+
+        [TestCase]
+        public void ThreadStatsReportUtilization()
+        {
+            PlaceholderUpdateThreadStats stats = new PlaceholderUpdateThreadStats(workItemCount: 10, threadTimesMs: new long[] { 100, 50 }, totalTimeMs: 100);
+            stats.ThreadCount.ShouldEqual(2);
+            stats.WorkItemCount.ShouldEqual(10);
+            stats.MinThreadMs.ShouldEqual(50);
+            stats.MaxThreadMs.ShouldEqual(100);
+            stats.UtilizationPercent.ShouldEqual(75);
+        }
+
+        private static List<Tuple<int, int>> GetAllWorkItems(PlaceholderUpdateWorkQueue workQueue)
+        {
+            List<Tuple<int, int>> workItems = new List<Tuple<int, int>>();
+            while (workQueue.TryGetNextWorkItem(out int start, out int end))
+            {
+                workItems.Add(Tuple.Create(start, end));
+            }
+
+            workItems.Count.ShouldEqual(workQueue.WorkItemCount);
+            return workItems;
+        }
+
+        private static List<IPlaceholderData> CreatePlaceholders(int folderCount, int filesPerFolder)
+        {
+            // Interleave the folders so that the work queue has to group them
+            List<IPlaceholderData> placeholders = new List<IPlaceholderData>();
+            for (int file = 0; file < filesPerFolder; ++file)
+            {
+                for (int folder = 0; folder < folderCount; ++folder)
+                {
+                    placeholders.Add(CreatePlaceholder(Path.Combine("root", $"folder{folder}", $"file{file}.txt")));
+                }
+            }
+
+            return placeholders;
+        }
+
+        private static IPlaceholderData CreatePlaceholder(string path)
+        {
+            return new PlaceholderTable.PlaceholderData
+            {
+                Path = path,
+                PathType = PlaceholderTable.PlaceholderData.PlaceholderType.File,
+                Sha = "0000000000000000000000000000000000000000",
+            };
+        }
+    }
+}
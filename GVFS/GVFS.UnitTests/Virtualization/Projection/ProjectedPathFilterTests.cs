@@ -0,0 +1,123 @@
+﻿using GVFS.Tests.Should;
+using GVFS.UnitTests.Mock.Common;
+using NUnit.Framework;
+using System.IO;
+using System.Text;
+using static GVFS.Virtualization.Projection.GitIndexProjection;
+
+namespace GVFS.UnitTests.Virtualization.Git
+{
+    [TestFixture]
+    public class ProjectedPathFilterTests
+    {
+        private const int DefaultIndexEntryCount = 100;
+        private static readonly string Separator = Path.DirectorySeparatorChar.ToString();
+
+        [OneTimeSetUp]
+        public void Setup()
+        {
+            LazyUTF8String.InitializePools(new MockTracer(), DefaultIndexEntryCount);
+            SortedFolderEntries.InitializePools(new MockTracer(), DefaultIndexEntryCount);
+        }
+
+        [SetUp]
+        public void TestSetup()
+        {
+            LazyUTF8String.ResetPool(new MockTracer(), DefaultIndexEntryCount);
+            SortedFolderEntries.ResetPool(new MockTracer(), DefaultIndexEntryCount);
+        }
+
+        [TestCase]
+        public void FilterContainsEveryPathInTree()
+        {
+            ProjectedPathFilter filter = ProjectedPathFilter.Build(SetupTree());
+            filter.EntryCount.ShouldEqual(5);
+
+            MightContain(filter, string.Empty, "readme.md").ShouldBeTrue();
+            MightContain(filter, string.Empty, "src").ShouldBeTrue();
+            MightContain(filter, "src", "main.cpp").ShouldBeTrue();
+            MightContain(filter, "src", "lib").ShouldBeTrue();
+            MightContain(filter, "src" + Separator + "lib", "lib.cpp").ShouldBeTrue();
+        }
+
+        [TestCase]
+        public void FilterContainsPathsWithDifferentCase()
+        {
+            ProjectedPathFilter filter = ProjectedPathFilter.Build(SetupTree());
+            MightContain(filter, "SRC", "Main.cpp").ShouldBeTrue();
+            MightContain(filter, "Src" + Separator + "LIB", "lib.CPP").ShouldBeTrue();
+        }
+
+        [TestCase]
+        public void EmptyPathComponentsAreIgnored()
+        {
+            ulong expectedHash = ProjectedPathFilter.ComputePathHash("src" + Separator + "lib", "lib.cpp");
+            ProjectedPathFilter.ComputePathHash(Separator + "src" + Separator + "lib", "lib.cpp").ShouldEqual(expectedHash);
+            ProjectedPathFilter.ComputePathHash("src" + Separator + Separator + "lib", "lib.cpp").ShouldEqual(expectedHash);
+            ProjectedPathFilter.ComputePathHash("src" + Separator + "lib" + Separator, "lib.cpp").ShouldEqual(expectedHash);
+        }
+
+        [TestCase]
+        public void PathHashDependsOnParentFolder()
+        {
+            ProjectedPathFilter.ComputePathHash("src", "main.cpp").ShouldNotEqual(ProjectedPathFilter.ComputePathHash("lib", "main.cpp"));
+            ProjectedPathFilter.ComputePathHash("src", "main.cpp").ShouldNotEqual(ProjectedPathFilter.ComputePathHash(string.Empty, "main.cpp"));
+        }
+
+        [TestCase]
+        public void FilterRejectsMostMissingPaths()
+        {
+            const int PathCount = 10000;
+            ProjectedPathFilter filter = new ProjectedPathFilter(PathCount);
+            for (int i = 0; i < PathCount; ++i)
+            {
+                filter.Add(ProjectedPathFilter.ComputePathHash("folder", $"file{i}.txt"));
+            }
+
+            filter.EntryCount.ShouldEqual(PathCount);
+
+            int falsePositives = 0;
+            for (int i = 0; i < PathCount; ++i)
+            {
+                MightContain(filter, "folder", $"file{i}.txt").ShouldBeTrue();
+                if (MightContain(filter, "folder", $"missing{i}.txt"))
+                {
+                    ++falsePositives;
+                }
+            }
+
+            // The expected false positive rate is about 1%, allow some slack so the test is not sensitive to the hash
+            falsePositives.ShouldBeAtMost(PathCount / 20);
+        }
+
+        private static bool MightContain(ProjectedPathFilter filter, string parentPath, string childName)
+        {
+            return filter.MightContain(ProjectedPathFilter.ComputePathHash(parentPath, childName));
+        }
+
+        private static FolderData SetupTree()
+        {
+            FolderData root = new FolderData();
+            root.ResetData(ConstructLazyUTF8String("<root>"), isIncluded: true);
+            root.AddChildFile(ConstructLazyUTF8String("readme.md"), new byte[20]);
+
+            LazyUTF8String[] libPath = new[] { ConstructLazyUTF8String("src"), ConstructLazyUTF8String("lib") };
+            FolderData src = root.ChildEntries.GetOrAddFolder(libPath, partIndex: 0, parentIsIncluded: true, rootSparseFolderData: new SparseFolderData());
+            src.AddChildFile(ConstructLazyUTF8String("main.cpp"), new byte[20]);
+
+            FolderData lib = src.ChildEntries.GetOrAddFolder(libPath, partIndex: 1, parentIsIncluded: true, rootSparseFolderData: new SparseFolderData());
+            lib.AddChildFile(ConstructLazyUTF8String("lib.cpp"), new byte[20]);
+
+            return root;
+        }
+
+        private static unsafe LazyUTF8String ConstructLazyUTF8String(string name)
+        {
+            byte[] buffer = Encoding.ASCII.GetBytes(name);
+            fixed (byte* bufferPtr = buffer)
+            {
+                return LazyUTF8String.FromByteArray(bufferPtr, name.Length);
+            }
+        }
+    }
+}
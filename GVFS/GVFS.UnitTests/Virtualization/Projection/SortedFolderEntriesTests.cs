@@ -247,6 +247,125 @@ public void Clear()
             sfe.Count.ShouldEqual(0);
         }
 
+        [TestCase]
+        public void LargeFolderEntriesFoundUsingHashIndex()
+        {
+            SortedFolderEntries sfe = new SortedFolderEntries();
+            string[] names = GetLargeFolderNames();
+            AddFiles(sfe, names);
+            sfe.Count.ShouldEqual(names.Length);
+            SortedFolderEntries.HashIndexedFolderCount().ShouldEqual(1);
+
+            for (int i = 0; i < names.Length; i++)
+            {
+                sfe.TryGetValue(ConstructLazyUTF8String(names[i]), out FolderEntryData folderEntryData).ShouldBeTrue();
+                folderEntryData.Name.GetString().ShouldEqual(names[i]);
+            }
+
+            sfe.TryGetValue(ConstructLazyUTF8String("missing"), out FolderEntryData missingEntry).ShouldBeFalse();
+            missingEntry.ShouldBeNull();
+        }
+
+        [TestCase]
+        public void LargeFolderOutOfOrderInsertionsStaySorted()
+        {
+            SortedFolderEntries sfe = new SortedFolderEntries();
+            string[] names = GetLargeFolderNames();
+            for (int i = names.Length - 1; i >= 0; i--)
+            {
+                if (i % 2 == 0)
+                {
+                    AddFiles(sfe, names[i]);
+                }
+                else
+                {
+                    AddFolders(sfe, names[i]);
+                }
+            }
+
+            for (int i = 0; i < names.Length; i++)
+            {
+                sfe[i].Name.GetString().ShouldEqual(names[i]);
+                sfe[i].IsFolder.ShouldEqual(i % 2 != 0);
+            }
+
+            // GetOrAddFolder should return the existing folder rather than adding a new one
+            LazyUTF8String existingFolderName = ConstructLazyUTF8String(names[1]);
+            FolderData existingFolder = sfe.GetOrAddFolder(new[] { existingFolderName }, partIndex: 0, parentIsIncluded: true, rootSparseFolderData: new SparseFolderData());
+            existingFolder.Name.GetString().ShouldEqual(names[1]);
+            sfe.Count.ShouldEqual(names.Length);
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.CaseInsensitiveFileSystemOnly)]
+        public void LargeFolderEntryFoundDifferentCase()
+        {
+            SortedFolderEntries sfe = new SortedFolderEntries();
+            AddFiles(sfe, GetLargeFolderNames());
+            sfe.TryGetValue(ConstructLazyUTF8String("FILE00042.TXT"), out FolderEntryData folderEntryData).ShouldBeTrue();
+            folderEntryData.Name.GetString().ShouldEqual("file00042.txt");
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.CaseSensitiveFileSystemOnly)]
+        public void LargeFolderEntryNotFoundDifferentCase()
+        {
+            SortedFolderEntries sfe = new SortedFolderEntries();
+            AddFiles(sfe, GetLargeFolderNames());
+            sfe.TryGetValue(ConstructLazyUTF8String("FILE00042.TXT"), out FolderEntryData folderEntryData).ShouldBeFalse();
+            folderEntryData.ShouldBeNull();
+        }
+
+        [TestCase]
+        public void SpanLookupFindsEntries()
+        {
+            SortedFolderEntries sfe = SetupDefaultEntries();
+            foreach (string name in defaultFiles)
+            {
+                sfe.TryGetValue(name.AsSpan(), out FolderEntryData folderEntryData).ShouldBeTrue();
+                folderEntryData.Name.GetString().ShouldEqual(name);
+            }
+
+            sfe.TryGetValue("Anything".AsSpan(), out FolderEntryData missingEntry).ShouldBeFalse();
+            missingEntry.ShouldBeNull();
+        }
+
+        [TestCase]
+        public void SpanLookupFindsEntriesInLargeFolder()
+        {
+            SortedFolderEntries sfe = new SortedFolderEntries();
+            string[] names = GetLargeFolderNames();
+            AddFiles(sfe, names);
+            foreach (string name in names)
+            {
+                sfe.TryGetValue(name.AsSpan(), out FolderEntryData folderEntryData).ShouldBeTrue();
+                folderEntryData.Name.GetString().ShouldEqual(name);
+            }
+
+            sfe.TryGetValue("missing".AsSpan(), out FolderEntryData missingEntry).ShouldBeFalse();
+            missingEntry.ShouldBeNull();
+        }
+
+        [TestCase]
+        [Category(CategoryConstants.CaseInsensitiveFileSystemOnly)]
+        public void SpanLookupFindsEntryDifferentCase()
+        {
+            SortedFolderEntries sfe = SetupDefaultEntries();
+            sfe.TryGetValue("FOLDER".AsSpan(), out FolderEntryData folderEntryData).ShouldBeTrue();
+            folderEntryData.Name.GetString().ShouldEqual("folder");
+        }
+
+        [TestCase]
+        public void ClearRemovesHashIndex()
+        {
+            SortedFolderEntries sfe = new SortedFolderEntries();
+            string[] names = GetLargeFolderNames();
+            AddFiles(sfe, names);
+            sfe.Clear();
+            sfe.TryGetValue(ConstructLazyUTF8String(names[0]), out FolderEntryData folderEntryData).ShouldBeFalse();
+            folderEntryData.ShouldBeNull();
+        }
+
         [TestCase]
         public void SmallEntries()
         {
@@ -286,6 +405,17 @@ private static SortedFolderEntries SetupDefaultEntries()
             return sfe;
         }
 
+        private static string[] GetLargeFolderNames()
+        {
+            string[] names = new string[SortedFolderEntries.HashIndexThreshold * 2];
+            for (int i = 0; i < names.Length; i++)
+            {
+                names[i] = $"file{i:D5}.txt";
+            }
+
+            return names;
+        }
+
         private static int GetDefaultEntriesLength()
         {
             int length = defaultFiles.Length + defaultFolders.Length;
@@ -91,7 +91,7 @@ public virtual void Flush()
             this.wakeUpFlushThread.Set();
         }
 
-        public void Dispose()
+        public virtual void Dispose()
         {
             if (this.wakeUpFlushThread != null)
             {
@@ -258,6 +258,10 @@ private EventMetadata CreateEventMetadata(Exception e = null)
 
         public class BlobSizesConnection : IDisposable
         {
+            // Number of SHAs looked up by each query in TryGetSizes.  SQLite supports up to 999 parameters
+            // in older versions, and larger batches do not reduce the cost of the B-tree lookups any further.
+            internal const int BatchQueryShaCount = 256;
+
             private string connectionString;
 
             // Keep connection and command alive for the duration of BlobSizesConnection so that
@@ -268,9 +272,17 @@ public class BlobSizesConnection : IDisposable
 
             private byte[] shaBuffer;
 
+            // Created on the first call to TryGetSizes, BlobSizesConnections are thread-specific
+            // and so these can be reused for every batch
+            private SqliteCommand batchQuerySizesCommand;
+            private SqliteParameter[] batchShaParams;
+            private byte[][] batchShaBuffers;
+            private Sha1Id[] sortedShas;
+            private int[] sortedShaIndices;
+
             public BlobSizesConnection(BlobSizes blobSizes)
             {
-                // For unit testing
+                // For unit testing, and for BlobSizes that do not store the sizes in SQLite
                 this.BlobSizesDatabase = blobSizes;
             }
 
@@ -352,8 +364,109 @@ public virtual bool TryGetSize(Sha1Id sha, out long length)
                 return false;
             }
 
+            /// <summary>
+            /// Get the sizes of a batch of blobs
+            /// </summary>
+            /// <param name="shas">SHAs to look up, can contain duplicates</param>
+            /// <param name="sizes">
+            /// Receives the size of each SHA in shas (at the same index), or -1 if the size is not known.
+            /// Must be at least as long as shas.
+            /// </param>
+            /// <returns>The number of SHAs whose size was found</returns>
+            /// <remarks>
+            /// The SHAs are sorted and looked up BatchQueryShaCount at a time, which walks the primary key
+            /// index in order and returns the rows in the same order so that they can be merged back into
+            /// sizes without a dictionary.
+            /// </remarks>
+            public virtual int TryGetSizes(ReadOnlySpan<Sha1Id> shas, Span<long> sizes)
+            {
+                if (sizes.Length < shas.Length)
+                {
+                    throw new ArgumentException($"Must be at least as long as {nameof(shas)}", nameof(sizes));
+                }
+
+                int foundCount = 0;
+                if (this.connection == null)
+                {
+                    // BlobSizes that are not stored in SQLite only need to provide TryGetSize
+                    for (int i = 0; i < shas.Length; ++i)
+                    {
+                        if (this.TryGetSize(shas[i], out sizes[i]))
+                        {
+                            ++foundCount;
+                        }
+                        else
+                        {
+                            sizes[i] = -1;
+                        }
+                    }
+
+                    return foundCount;
+                }
+
+                sizes.Slice(0, shas.Length).Fill(-1);
+                if (shas.Length == 0)
+                {
+                    return 0;
+                }
+
+                try
+                {
+                    this.SortForBatchQuery(shas);
+
+                    for (int batchStart = 0; batchStart < shas.Length; batchStart += BatchQueryShaCount)
+                    {
+                        int batchEnd = Math.Min(batchStart + BatchQueryShaCount, shas.Length);
+
+                        // The same prepared statement is used for every batch, pad out a short
+                        // final batch by repeating its last SHA
+                        for (int i = 0; i < BatchQueryShaCount; ++i)
+                        {
+                            this.sortedShas[Math.Min(batchStart + i, batchEnd - 1)].ToBuffer(this.batchShaBuffers[i]);
+                            this.batchShaParams[i].Value = this.batchShaBuffers[i];
+                        }
+
+                        int mergeIndex = batchStart;
+                        using (SqliteDataReader reader = this.batchQuerySizesCommand.ExecuteReader())
+                        {
+                            while (reader.Read() && mergeIndex < batchEnd)
+                            {
+                                reader.GetBytes(0, 0, this.shaBuffer, 0, this.shaBuffer.Length);
+                                Sha1Id.ShaBufferToParts(this.shaBuffer, out ulong shaBytes1Through8, out ulong shaBytes9Through16, out uint shaBytes17Through20);
+                                Sha1Id rowSha = new Sha1Id(shaBytes1Through8, shaBytes9Through16, shaBytes17Through20);
+                                long rowSize = reader.GetInt64(1);
+
+                                while (mergeIndex < batchEnd && this.sortedShas[mergeIndex].CompareTo(rowSha) < 0)
+                                {
+                                    ++mergeIndex;
+                                }
+
+                                while (mergeIndex < batchEnd && this.sortedShas[mergeIndex] == rowSha)
+                                {
+                                    sizes[this.sortedShaIndices[mergeIndex]] = rowSize;
+                                    ++foundCount;
+                                    ++mergeIndex;
+                                }
+                            }
+                        }
+                    }
+                }
+                catch (Exception e)
+                {
+                    throw new BlobSizesException(e);
+                }
+
+                return foundCount;
+            }
+
             public void Dispose()
             {
+                if (this.batchQuerySizesCommand != null)
+                {
+                    this.batchQuerySizesCommand.Dispose();
+                    this.batchQuerySizesCommand = null;
+                }
+
                 if (this.querySizeCommand != null)
                 {
                     this.querySizeCommand.Dispose();
@@ -366,6 +479,43 @@ public void Dispose()
                     this.connection = null;
                 }
             }
+
+            private void SortForBatchQuery(ReadOnlySpan<Sha1Id> shas)
+            {
+                if (this.batchQuerySizesCommand == null)
+                {
+                    this.batchQuerySizesCommand = this.connection.CreateCommand();
+                    this.batchShaParams = new SqliteParameter[BatchQueryShaCount];
+                    this.batchShaBuffers = new byte[BatchQueryShaCount][];
+
+                    string[] parameterNames = new string[BatchQueryShaCount];
+                    for (int i = 0; i < BatchQueryShaCount; ++i)
+                    {
+                        parameterNames[i] = "@sha" + i;
+                        this.batchShaBuffers[i] = new byte[20];
+                        this.batchShaParams[i] = this.batchQuerySizesCommand.CreateParameter();
+                        this.batchShaParams[i].ParameterName = parameterNames[i];
+                        this.batchQuerySizesCommand.Parameters.Add(this.batchShaParams[i]);
+                    }
+
+                    this.batchQuerySizesCommand.CommandText = $"SELECT sha, size FROM BlobSizes WHERE sha IN ({string.Join(", ", parameterNames)}) ORDER BY sha;";
+                    this.batchQuerySizesCommand.Prepare();
+                }
+
+                if (this.sortedShas == null || this.sortedShas.Length < shas.Length)
+                {
+                    this.sortedShas = new Sha1Id[shas.Length];
+                    this.sortedShaIndices = new int[shas.Length];
+                }
+
+                shas.CopyTo(this.sortedShas);
+                for (int i = 0; i < shas.Length; ++i)
+                {
+                    this.sortedShaIndices[i] = i;
+                }
+
+                Array.Sort(this.sortedShas, this.sortedShaIndices, 0, shas.Length);
+            }
         }
 
         private class BlobSize
@@ -0,0 +1,363 @@
+﻿using GVFS.Common.Git;
+using System;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Runtime.Intrinsics.X86;
+using System.Threading;
+
+namespace GVFS.Virtualization.BlobSize
+{
+    /// <summary>
+    /// Fixed size, memory mapped, open-addressing (linear probing) hash table of blob SHA to blob size.
+    /// </summary>
+    /// <remarks>
+    /// File layout:
+    ///
+    ///   Header (64 bytes): signature, version, slot count, entry count
+    ///   Slots (32 bytes each): SHA (20 bytes), padding (4 bytes), size (8 bytes)
+    ///
+    /// Slots are padded to 32 bytes so that a slot never spans a cache line and the first 8 bytes of the SHA
+    /// can be written atomically.  An empty slot has zeros for the first 8 bytes of the SHA, and so a SHA whose
+    /// first 8 bytes are all zero cannot be stored (it is treated as not found).
+    ///
+    /// The table supports any number of concurrent readers and a single writer without locking.  The writer
+    /// fills in the rest of the slot before publishing the first 8 bytes of the SHA, and readers read the
+    /// first 8 bytes before the rest of the slot.  Entries are never removed, so a reader can only miss an
+    /// entry that is being added concurrently.
+    ///
+    /// The table does not grow in place, when it is full the owner copies the entries to a larger table
+    /// (see <see cref="MemoryMappedBlobSizes"/>).
+    /// </remarks>
+    public unsafe class BlobSizesHashFile : IDisposable
+    {
+        public const int HeaderSize = 64;
+        public const int SlotSize = 32;
+        public const long MinimumSlotCount = 1 << 16;
+
+        // Once the table is 70% full probe sequences start to get long, and the table should be copied to a larger one
+        public const int MaxLoadPercent = 70;
+
+        // Number of lookups whose slots are prefetched together in TryGetSizes.  Each lookup is almost always
+        // a cache miss (and for a cold file a page fault), and prefetching lets those misses overlap.
+        private const int PrefetchBatchSize = 16;
+
+        private const uint Signature = 0x53425647; // "GVBS"
+        private const uint CurrentVersion = 1;
+
+        private const int SignatureOffset = 0;
+        private const int VersionOffset = 4;
+        private const int SlotCountOffset = 8;
+        private const int EntryCountOffset = 16;
+
+        private const int ShaBytes9Through16Offset = 8;
+        private const int ShaBytes17Through20Offset = 16;
+        private const int SizeOffset = 24;
+
+        private MemoryMappedFile mappedFile;
+        private MemoryMappedViewAccessor view;
+        private byte* headerPtr;
+        private byte* slotsPtr;
+        private long slotMask;
+        private long maxEntryCount;
+
+        private BlobSizesHashFile(string path, MemoryMappedFile mappedFile, MemoryMappedViewAccessor view)
+        {
+            this.Path = path;
+            this.mappedFile = mappedFile;
+            this.view = view;
+
+            byte* ptr = null;
+            this.view.SafeMemoryMappedViewHandle.AcquirePointer(ref ptr);
+            this.headerPtr = ptr + this.view.PointerOffset;
+            this.slotsPtr = this.headerPtr + HeaderSize;
+        }
+
+        public string Path { get; }
+
+        public long SlotCount { get; private set; }
+
+        public long Count
+        {
+            get { return Volatile.Read(ref *(long*)(this.headerPtr + EntryCountOffset)); }
+        }
+
+        public bool IsFull
+        {
+            get { return this.Count >= this.maxEntryCount; }
+        }
+
+        /// <summary>
+        /// Get the number of slots (a power of 2) for a table that will hold entryCount
+        /// entries and still be at most half full
+        /// </summary>
+        public static long GetSlotCountForEntries(long entryCount)
+        {
+            long slotCount = MinimumSlotCount;
+            while (slotCount < entryCount * 2)
+            {
+                slotCount <<= 1;
+            }
+
+            return slotCount;
+        }
+
+        public static BlobSizesHashFile Create(string path, long slotCount)
+        {
+            if (slotCount < MinimumSlotCount || (slotCount & (slotCount - 1)) != 0)
+            {
+                throw new ArgumentException($"Must be a power of 2 that is at least {MinimumSlotCount}", nameof(slotCount));
+            }
+
+            using (FileStream stream = new FileStream(path, FileMode.CreateNew, FileAccess.ReadWrite, FileShare.Read))
+            {
+                stream.SetLength(HeaderSize + (slotCount * SlotSize));
+            }
+
+            BlobSizesHashFile hashFile = OpenMapping(path);
+            *(uint*)(hashFile.headerPtr + SignatureOffset) = Signature;
+            *(uint*)(hashFile.headerPtr + VersionOffset) = CurrentVersion;
+            *(long*)(hashFile.headerPtr + SlotCountOffset) = slotCount;
+            *(long*)(hashFile.headerPtr + EntryCountOffset) = 0;
+            hashFile.SetSlotCount(slotCount);
+            hashFile.Flush();
+
+            return hashFile;
+        }
+
+        /// <summary>
+        /// Open an existing hash file
+        /// </summary>
+        /// <exception cref="InvalidDataException">Thrown when the file is not a valid hash file</exception>
+        public static BlobSizesHashFile Open(string path)
+        {
+            BlobSizesHashFile hashFile = OpenMapping(path);
+            try
+            {
+                uint signature = *(uint*)(hashFile.headerPtr + SignatureOffset);
+                uint version = *(uint*)(hashFile.headerPtr + VersionOffset);
+                long slotCount = *(long*)(hashFile.headerPtr + SlotCountOffset);
+
+                if (signature != Signature)
+                {
+                    throw new InvalidDataException($"Invalid signature {signature:X8}");
+                }
+
+                if (version != CurrentVersion)
+                {
+                    throw new InvalidDataException($"Unsupported version {version}");
+                }
+
+                if (slotCount < MinimumSlotCount ||
+                    (slotCount & (slotCount - 1)) != 0 ||
+                    hashFile.view.Capacity < HeaderSize + (slotCount * SlotSize))
+                {
+                    throw new InvalidDataException($"Invalid slot count {slotCount} for file of size {hashFile.view.Capacity}");
+                }
+
+                hashFile.SetSlotCount(slotCount);
+                return hashFile;
+            }
+            catch
+            {
+                hashFile.Dispose();
+                throw;
+            }
+        }
+
+        public bool TryGetSize(Sha1Id sha, out long size)
+        {
+            ulong* shaParts = (ulong*)&sha;
+            ulong shaBytes1Through8 = shaParts[0];
+            if (shaBytes1Through8 != 0)
+            {
+                ulong shaBytes9Through16 = shaParts[1];
+                uint shaBytes17Through20 = *(uint*)(shaParts + 2);
+
+                long slot = (long)shaBytes1Through8 & this.slotMask;
+                for (long probes = 0; probes < this.SlotCount; ++probes)
+                {
+                    byte* slotPtr = this.slotsPtr + (slot * SlotSize);
+                    ulong slotShaBytes1Through8 = Volatile.Read(ref *(ulong*)slotPtr);
+                    if (slotShaBytes1Through8 == 0)
+                    {
+                        break;
+                    }
+
+                    if (slotShaBytes1Through8 == shaBytes1Through8 &&
+                        *(ulong*)(slotPtr + ShaBytes9Through16Offset) == shaBytes9Through16 &&
+                        *(uint*)(slotPtr + ShaBytes17Through20Offset) == shaBytes17Through20)
+                    {
+                        size = *(long*)(slotPtr + SizeOffset);
+                        return true;
+                    }
+
+                    slot = (slot + 1) & this.slotMask;
+                }
+            }
+
+            size = -1;
+            return false;
+        }
+
+        /// <summary>
+        /// Get the sizes of a batch of SHAs, sizes[i] is set to -1 when shas[i] is not found
+        /// </summary>
+        /// <returns>The number of SHAs that were found</returns>
+        public int TryGetSizes(ReadOnlySpan<Sha1Id> shas, Span<long> sizes)
+        {
+            int foundCount = 0;
+            for (int batchStart = 0; batchStart < shas.Length; batchStart += PrefetchBatchSize)
+            {
+                int batchEnd = Math.Min(batchStart + PrefetchBatchSize, shas.Length);
+                if (Sse.IsSupported)
+                {
+                    for (int i = batchStart; i < batchEnd; ++i)
+                    {
+                        Sha1Id sha = shas[i];
+                        ulong shaBytes1Through8 = *(ulong*)&sha;
+                        Sse.Prefetch0(this.slotsPtr + (((long)shaBytes1Through8 & this.slotMask) * SlotSize));
+                    }
+                }
+
+                for (int i = batchStart; i < batchEnd; ++i)
+                {
+                    if (this.TryGetSize(shas[i], out sizes[i]))
+                    {
+                        ++foundCount;
+                    }
+                }
+            }
+
+            return foundCount;
+        }
+
+        /// <summary>
+        /// Add a size to the table.  Must only be called from a single thread at a time.
+        /// </summary>
+        /// <returns>
+        /// True if the size was added or the SHA was already in the table, false if the table is full
+        /// or the SHA cannot be stored
+        /// </returns>
+        public bool TryAdd(Sha1Id sha, long size)
+        {
+            ulong* shaParts = (ulong*)&sha;
+            ulong shaBytes1Through8 = shaParts[0];
+            if (shaBytes1Through8 == 0 || this.IsFull)
+            {
+                return false;
+            }
+
+            ulong shaBytes9Through16 = shaParts[1];
+            uint shaBytes17Through20 = *(uint*)(shaParts + 2);
+
+            long slot = (long)shaBytes1Through8 & this.slotMask;
+            while (true)
+            {
+                byte* slotPtr = this.slotsPtr + (slot * SlotSize);
+                ulong slotShaBytes1Through8 = *(ulong*)slotPtr;
+                if (slotShaBytes1Through8 == 0)
+                {
+                    *(ulong*)(slotPtr + ShaBytes9Through16Offset) = shaBytes9Through16;
+                    *(uint*)(slotPtr + ShaBytes17Through20Offset) = shaBytes17Through20;
+                    *(long*)(slotPtr + SizeOffset) = size;
+
+                    // Publish the entry to readers
+                    Volatile.Write(ref *(ulong*)slotPtr, shaBytes1Through8);
+                    Volatile.Write(ref *(long*)(this.headerPtr + EntryCountOffset), this.Count + 1);
+                    return true;
+                }
+
+                if (slotShaBytes1Through8 == shaBytes1Through8 &&
+                    *(ulong*)(slotPtr + ShaBytes9Through16Offset) == shaBytes9Through16 &&
+                    *(uint*)(slotPtr + ShaBytes17Through20Offset) == shaBytes17Through20)
+                {
+                    return true;
+                }
+
+                slot = (slot + 1) & this.slotMask;
+            }
+        }
+
+        /// <summary>
+        /// Add all of the entries in this table to destination
+        /// </summary>
+        /// <returns>The number of entries that could not be added because destination is full</returns>
+        public long CopyTo(BlobSizesHashFile destination)
+        {
+            long failedCount = 0;
+            for (long slot = 0; slot < this.SlotCount; ++slot)
+            {
+                byte* slotPtr = this.slotsPtr + (slot * SlotSize);
+                ulong shaBytes1Through8 = Volatile.Read(ref *(ulong*)slotPtr);
+                if (shaBytes1Through8 != 0)
+                {
+                    Sha1Id sha = new Sha1Id(
+                        shaBytes1Through8,
+                        *(ulong*)(slotPtr + ShaBytes9Through16Offset),
+                        *(uint*)(slotPtr + ShaBytes17Through20Offset));
+
+                    if (!destination.TryAdd(sha, *(long*)(slotPtr + SizeOffset)))
+                    {
+                        ++failedCount;
+                    }
+                }
+            }
+
+            return failedCount;
+        }
+
+        public void Flush()
+        {
+            this.view.Flush();
+        }
+
+        public void Dispose()
+        {
+            if (this.view != null)
+            {
+                this.view.SafeMemoryMappedViewHandle.ReleasePointer();
+                this.headerPtr = null;
+                this.slotsPtr = null;
+
+                this.view.Dispose();
+                this.view = null;
+            }
+
+            if (this.mappedFile != null)
+            {
+                this.mappedFile.Dispose();
+                this.mappedFile = null;
+            }
+        }
+
+        private static BlobSizesHashFile OpenMapping(string path)
+        {
+            MemoryMappedFile mappedFile = null;
+            MemoryMappedViewAccessor view = null;
+            try
+            {
+                mappedFile = MemoryMappedFile.CreateFromFile(path, FileMode.Open, mapName: null, capacity: 0, access: MemoryMappedFileAccess.ReadWrite);
+                view = mappedFile.CreateViewAccessor(offset: 0, size: 0, access: MemoryMappedFileAccess.ReadWrite);
+                if (view.Capacity < HeaderSize)
+                {
+                    throw new InvalidDataException($"File is too small ({view.Capacity} bytes)");
+                }
+
+                return new BlobSizesHashFile(path, mappedFile, view);
+            }
+            catch
+            {
+                view?.Dispose();
+                mappedFile?.Dispose();
+                throw;
+            }
+        }
+
+        private void SetSlotCount(long slotCount)
+        {
+            this.SlotCount = slotCount;
+            this.slotMask = slotCount - 1;
+            this.maxEntryCount = (slotCount * MaxLoadPercent) / 100;
+        }
+    }
+}
@@ -0,0 +1,497 @@
+﻿using GVFS.Common.Database;
+using GVFS.Common.FileSystem;
+using GVFS.Common.Git;
+using GVFS.Common.Tracing;
+using Microsoft.Data.Sqlite;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Threading;
+
+namespace GVFS.Virtualization.BlobSize
+{
+    /// <summary>
+    /// BlobSizes that stores the sizes in a memory mapped <see cref="BlobSizesHashFile"/> rather than in SQLite.
+    /// Lookups read the mapped file directly (without any locking or SQL queries), and sizes are added to the
+    /// file by a single writer thread.
+    /// </summary>
+    /// <remarks>
+    /// The hash file has a single writer, and so unlike BlobSizes.sql (which is in the shared cache and used
+    /// by every enlistment on it) the hash files are kept in a folder of the enlistment.  Only one mount can
+    /// run for an enlistment at a time, and so the hash files are never opened by two processes.
+    ///
+    /// Each time the hash file fills up the writer thread copies the sizes to a new hash file with twice as many
+    /// slots (the next "generation") and switches the readers to it.  The older generations are kept mapped until
+    /// the BlobSizes is disposed, because readers may still be using them, and are deleted the next time
+    /// the BlobSizes is initialized.
+    ///
+    /// When there is no hash file yet, the sizes in the shared BlobSizes.sql are copied into a new hash file.
+    /// BlobSizes.sql is only read, so that other enlistments can keep using it and switching back to the SQLite
+    /// BlobSizes does not lose any sizes collected before the switch.
+    ///
+    /// The writer thread does not flush the hash file after each batch of sizes (the OS writes the dirty pages
+    /// back on its own, and the sizes are only a cache), only every <see cref="FlushIntervalMS"/> and at shutdown.
+    /// </remarks>
+    public class MemoryMappedBlobSizes : BlobSizes
+    {
+        public const string HashFilePrefix = "BlobSizes.";
+        public const string HashFileExtension = ".dat";
+
+        private const string EtwArea = nameof(MemoryMappedBlobSizes);
+        private const string TempFileExtension = ".tmp";
+        private const int FlushIntervalMS = 60 * 1000;
+
+        private readonly string blobSizesRoot;
+        private readonly string hashFileRoot;
+        private readonly PhysicalFileSystem fileSystem;
+        private readonly ITracer tracer;
+
+        private volatile BlobSizesHashFile currentHashFile;
+        private List<BlobSizesHashFile> retiredHashFiles;
+        private int generation;
+
+        // Lookups in progress, Dispose waits for them to finish before it unmaps the hash files
+        private int activeReaderCount;
+        private int isDisposed;
+
+        private Thread writerThread;
+        private AutoResetEvent wakeUpWriterThread;
+        private bool isStopping;
+        private ConcurrentQueue<KeyValuePair<Sha1Id, long>> queuedSizes;
+
+        /// <param name="blobSizesRoot">Folder of the shared BlobSizes.sql, which is copied into the first hash file</param>
+        /// <param name="hashFileRoot">Folder of the enlistment that holds the hash files</param>
+        public MemoryMappedBlobSizes(string blobSizesRoot, string hashFileRoot, PhysicalFileSystem fileSystem, ITracer tracer)
+            : base(blobSizesRoot, fileSystem, tracer)
+        {
+            this.blobSizesRoot = blobSizesRoot;
+            this.hashFileRoot = hashFileRoot;
+            this.fileSystem = fileSystem;
+            this.tracer = tracer;
+            this.retiredHashFiles = new List<BlobSizesHashFile>();
+            this.wakeUpWriterThread = new AutoResetEvent(false);
+            this.queuedSizes = new ConcurrentQueue<KeyValuePair<Sha1Id, long>>();
+        }
+
+        public override BlobSizesConnection CreateConnection()
+        {
+            return new MemoryMappedBlobSizesConnection(this);
+        }
+
+        public override void Initialize()
+        {
+            this.fileSystem.CreateDirectory(this.hashFileRoot);
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            EventMetadata metadata = this.CreateEventMetadata();
+
+            List<KeyValuePair<int, string>> hashFiles = this.GetHashFiles();
+            BlobSizesHashFile hashFile = null;
+            if (hashFiles.Count > 0)
+            {
+                KeyValuePair<int, string> latestHashFile = hashFiles[hashFiles.Count - 1];
+                try
+                {
+                    hashFile = BlobSizesHashFile.Open(latestHashFile.Value);
+                    this.generation = latestHashFile.Key;
+                }
+                catch (Exception e) when (e is InvalidDataException || e is IOException || e is ArgumentException)
+                {
+                    EventMetadata corruptMetadata = this.CreateEventMetadata(e);
+                    corruptMetadata.Add("path", latestHashFile.Value);
+                    this.tracer.RelatedWarning(corruptMetadata, $"{nameof(MemoryMappedBlobSizes)}.{nameof(this.Initialize)}: hash file corrupt, deleting and recreating");
+                    this.generation = latestHashFile.Key;
+                }
+            }
+
+            // Nothing maps the older generations anymore (they were only kept for readers of the previous mount
+            // of this enlistment)
+            foreach (KeyValuePair<int, string> oldHashFile in hashFiles)
+            {
+                if (hashFile == null || oldHashFile.Value != hashFile.Path)
+                {
+                    this.fileSystem.TryDeleteFile(oldHashFile.Value);
+                }
+            }
+
+            if (hashFile == null)
+            {
+                hashFile = this.CreateHashFileFromDatabase(metadata);
+            }
+            else if (hashFile.Count * 2 > hashFile.SlotCount)
+            {
+                // Compact before starting so that the table does not need to grow while the mount is running
+                BlobSizesHashFile largerHashFile = this.CopyToNewHashFile(hashFile);
+                string oldPath = hashFile.Path;
+                hashFile.Dispose();
+                this.fileSystem.TryDeleteFile(oldPath);
+                hashFile = largerHashFile;
+                metadata.Add("Compacted", true);
+            }
+
+            this.currentHashFile = hashFile;
+
+            metadata.Add("Generation", this.generation);
+            metadata.Add("SlotCount", hashFile.SlotCount);
+            metadata.Add("Count", hashFile.Count);
+            metadata.Add("ElapsedMS", stopwatch.ElapsedMilliseconds);
+            this.tracer.RelatedEvent(EventLevel.Informational, $"{nameof(MemoryMappedBlobSizes)}_{nameof(this.Initialize)}", metadata);
+
+            this.writerThread = new Thread(this.WriterThreadMain);
+            this.writerThread.IsBackground = true;
+            this.writerThread.Start();
+        }
+
+        public override void Shutdown()
+        {
+            this.isStopping = true;
+            this.wakeUpWriterThread.Set();
+            this.writerThread.Join();
+            this.currentHashFile.Flush();
+        }
+
+        public override void AddSize(Sha1Id sha, long size)
+        {
+            this.queuedSizes.Enqueue(new KeyValuePair<Sha1Id, long>(sha, size));
+        }
+
+        public override void Flush()
+        {
+            this.wakeUpWriterThread.Set();
+        }
+
+        public override void Dispose()
+        {
+            // When Shutdown was not called the writer thread is still running, and it must not add sizes to
+            // the hash files once they are unmapped
+            if (this.writerThread != null)
+            {
+                this.isStopping = true;
+                this.wakeUpWriterThread.Set();
+                this.writerThread.Join();
+                this.writerThread = null;
+            }
+
+            // Stop new lookups, and wait for the ones in progress before unmapping the hash files
+            Interlocked.Exchange(ref this.isDisposed, 1);
+            SpinWait spinWait = new SpinWait();
+            while (Volatile.Read(ref this.activeReaderCount) > 0)
+            {
+                spinWait.SpinOnce();
+            }
+
+            if (this.currentHashFile != null)
+            {
+                this.currentHashFile.Dispose();
+                this.currentHashFile = null;
+            }
+
+            foreach (BlobSizesHashFile retiredHashFile in this.retiredHashFiles)
+            {
+                retiredHashFile.Dispose();
+            }
+
+            this.retiredHashFiles.Clear();
+
+            if (this.wakeUpWriterThread != null)
+            {
+                this.wakeUpWriterThread.Dispose();
+                this.wakeUpWriterThread = null;
+            }
+
+            base.Dispose();
+        }
+
+        private static bool TryParseGeneration(string fileName, out int generation)
+        {
+            generation = 0;
+            if (!fileName.StartsWith(HashFilePrefix, StringComparison.OrdinalIgnoreCase) ||
+                !fileName.EndsWith(HashFileExtension, StringComparison.OrdinalIgnoreCase))
+            {
+                return false;
+            }
+
+            string generationString = fileName.Substring(HashFilePrefix.Length, fileName.Length - HashFilePrefix.Length - HashFileExtension.Length);
+            return int.TryParse(generationString, out generation) && generation >= 0;
+        }
+
+        private string GetHashFilePath(int generation)
+        {
+            return Path.Combine(this.hashFileRoot, HashFilePrefix + generation + HashFileExtension);
+        }
+
+        /// <summary>
+        /// Get the hash files in the enlistment's hash file folder, ordered by generation (and delete any temp files
+        /// left by a mount that exited while creating a hash file)
+        /// </summary>
+        private List<KeyValuePair<int, string>> GetHashFiles()
+        {
+            List<KeyValuePair<int, string>> hashFiles = new List<KeyValuePair<int, string>>();
+            foreach (string path in this.fileSystem.GetFiles(this.hashFileRoot, HashFilePrefix + "*"))
+            {
+                if (path.EndsWith(TempFileExtension, StringComparison.OrdinalIgnoreCase))
+                {
+                    this.fileSystem.TryDeleteFile(path);
+                }
+                else if (TryParseGeneration(Path.GetFileName(path), out int generation))
+                {
+                    hashFiles.Add(new KeyValuePair<int, string>(generation, path));
+                }
+            }
+
+            hashFiles.Sort((x, y) => x.Key.CompareTo(y.Key));
+            return hashFiles;
+        }
+
+        /// <summary>
+        /// Create the next generation hash file, fill it, and then open it.  The file is filled under a
+        /// temporary name so that a partially filled hash file is never opened.
+        /// </summary>
+        private BlobSizesHashFile CreateNextHashFile(long slotCount, Action<BlobSizesHashFile> fillHashFile)
+        {
+            ++this.generation;
+            string path = this.GetHashFilePath(this.generation);
+            string tempPath = path + TempFileExtension;
+            this.fileSystem.TryDeleteFile(tempPath);
+
+            using (BlobSizesHashFile newHashFile = BlobSizesHashFile.Create(tempPath, slotCount))
+            {
+                fillHashFile(newHashFile);
+                newHashFile.Flush();
+            }
+
+            this.fileSystem.MoveAndOverwriteFile(tempPath, path);
+            return BlobSizesHashFile.Open(path);
+        }
+
+        private BlobSizesHashFile CopyToNewHashFile(BlobSizesHashFile hashFile)
+        {
+            return this.CreateNextHashFile(
+                BlobSizesHashFile.GetSlotCountForEntries(hashFile.Count),
+                newHashFile => hashFile.CopyTo(newHashFile));
+        }
+
+        private BlobSizesHashFile CreateHashFileFromDatabase(EventMetadata metadata)
+        {
+            string databasePath = Path.Combine(this.blobSizesRoot, DatabaseName);
+            if (!this.fileSystem.FileExists(databasePath))
+            {
+                return this.CreateNextHashFile(BlobSizesHashFile.MinimumSlotCount, newHashFile => { });
+            }
+
+            long migratedCount = 0;
+            long databaseCount = 0;
+            BlobSizesHashFile hashFile = null;
+            try
+            {
+                using (SqliteConnection connection = new SqliteConnection(SqliteDatabase.CreateConnectionString(databasePath)))
+                {
+                    connection.Open();
+
+                    using (SqliteCommand countCommand = connection.CreateCommand())
+                    {
+                        countCommand.CommandText = "SELECT COUNT(*) FROM BlobSizes;";
+                        databaseCount = Convert.ToInt64(countCommand.ExecuteScalar());
+                    }
+
+                    hashFile = this.CreateNextHashFile(
+                        BlobSizesHashFile.GetSlotCountForEntries(databaseCount),
+                        newHashFile =>
+                        {
+                            using (SqliteCommand selectCommand = connection.CreateCommand())
+                            {
+                                selectCommand.CommandText = "SELECT sha, size FROM BlobSizes;";
+                                using (SqliteDataReader reader = selectCommand.ExecuteReader())
+                                {
+                                    while (reader.Read())
+                                    {
+                                        byte[] shaBuffer = reader.GetFieldValue<byte[]>(0);
+                                        if (shaBuffer.Length == 20)
+                                        {
+                                            Sha1Id.ShaBufferToParts(shaBuffer, out ulong shaBytes1Through8, out ulong shaBytes9Through16, out uint shaBytes17Through20);
+                                            if (newHashFile.TryAdd(new Sha1Id(shaBytes1Through8, shaBytes9Through16, shaBytes17Through20), reader.GetInt64(1)))
+                                            {
+                                                ++migratedCount;
+                                            }
+                                        }
+                                    }
+                                }
+                            }
+                        });
+                }
+            }
+            catch (SqliteException e)
+            {
+                // The sizes are only a cache, start with an empty hash file rather than failing the mount
+                EventMetadata errorMetadata = this.CreateEventMetadata(e);
+                errorMetadata.Add("SqliteErrorCode", e.SqliteErrorCode);
+                this.tracer.RelatedWarning(errorMetadata, $"{nameof(MemoryMappedBlobSizes)}.{nameof(this.CreateHashFileFromDatabase)}: failed to read {DatabaseName}");
+
+                hashFile?.Dispose();
+                hashFile = this.CreateNextHashFile(BlobSizesHashFile.MinimumSlotCount, newHashFile => { });
+                migratedCount = 0;
+            }
+
+            metadata.Add("DatabaseCount", databaseCount);
+            metadata.Add("MigratedCount", migratedCount);
+            return hashFile;
+        }
+
+        private void WriterThreadMain()
+        {
+            try
+            {
+                Stopwatch timeSinceFlush = Stopwatch.StartNew();
+                bool hasUnflushedSizes = false;
+                while (true)
+                {
+                    this.wakeUpWriterThread.WaitOne(FlushIntervalMS);
+
+                    KeyValuePair<Sha1Id, long> blobSize;
+                    while (this.queuedSizes.TryDequeue(out blobSize))
+                    {
+                        if (!this.currentHashFile.TryAdd(blobSize.Key, blobSize.Value) && this.currentHashFile.IsFull)
+                        {
+                            this.GrowHashFile();
+                            this.currentHashFile.TryAdd(blobSize.Key, blobSize.Value);
+                        }
+
+                        hasUnflushedSizes = true;
+                    }
+
+                    // Shutdown flushes the hash file once the writer thread has exited
+                    if (hasUnflushedSizes && !this.isStopping && timeSinceFlush.ElapsedMilliseconds >= FlushIntervalMS)
+                    {
+                        this.currentHashFile.Flush();
+                        hasUnflushedSizes = false;
+                        timeSinceFlush.Restart();
+                    }
+
+                    if (this.isStopping)
+                    {
+                        return;
+                    }
+                }
+            }
+            catch (Exception e)
+            {
+                this.LogErrorAndExit($"{nameof(this.WriterThreadMain)} caught unhandled exception, exiting process", e);
+            }
+        }
+
+        private void GrowHashFile()
+        {
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            BlobSizesHashFile fullHashFile = this.currentHashFile;
+            BlobSizesHashFile newHashFile = this.CopyToNewHashFile(fullHashFile);
+
+            // Readers may still be using the full hash file, it is disposed along with this BlobSizes
+            this.currentHashFile = newHashFile;
+            this.retiredHashFiles.Add(fullHashFile);
+
+            EventMetadata metadata = this.CreateEventMetadata();
+            metadata.Add("Generation", this.generation);
+            metadata.Add("OldSlotCount", fullHashFile.SlotCount);
+            metadata.Add("SlotCount", newHashFile.SlotCount);
+            metadata.Add("Count", newHashFile.Count);
+            metadata.Add("ElapsedMS", stopwatch.ElapsedMilliseconds);
+            this.tracer.RelatedEvent(EventLevel.Informational, $"{nameof(MemoryMappedBlobSizes)}_{nameof(this.GrowHashFile)}", metadata);
+        }
+
+        private void LogErrorAndExit(string message, Exception e)
+        {
+            EventMetadata metadata = this.CreateEventMetadata(e);
+            this.tracer.RelatedError(metadata, message);
+            Environment.Exit(1);
+        }
+
+        private EventMetadata CreateEventMetadata(Exception e = null)
+        {
+            EventMetadata metadata = new EventMetadata();
+            metadata.Add("Area", EtwArea);
+            if (e != null)
+            {
+                metadata.Add("Exception", e.ToString());
+            }
+
+            return metadata;
+        }
+
+        /// <summary>
+        /// Get the current hash file for a lookup, <see cref="EndRead"/> must be called when the lookup is done
+        /// </summary>
+        /// <returns>The current hash file, or null if the BlobSizes has been disposed</returns>
+        private BlobSizesHashFile BeginRead()
+        {
+            Interlocked.Increment(ref this.activeReaderCount);
+            if (Volatile.Read(ref this.isDisposed) != 0)
+            {
+                Interlocked.Decrement(ref this.activeReaderCount);
+                return null;
+            }
+
+            return this.currentHashFile;
+        }
+
+        private void EndRead()
+        {
+            Interlocked.Decrement(ref this.activeReaderCount);
+        }
+
+        public class MemoryMappedBlobSizesConnection : BlobSizesConnection
+        {
+            private MemoryMappedBlobSizes blobSizes;
+
+            public MemoryMappedBlobSizesConnection(MemoryMappedBlobSizes blobSizes)
+                : base(blobSizes)
+            {
+                this.blobSizes = blobSizes;
+            }
+
+            public override bool TryGetSize(Sha1Id sha, out long length)
+            {
+                BlobSizesHashFile hashFile = this.blobSizes.BeginRead();
+                if (hashFile == null)
+                {
+                    length = -1;
+                    return false;
+                }
+
+                try
+                {
+                    return hashFile.TryGetSize(sha, out length);
+                }
+                finally
+                {
+                    this.blobSizes.EndRead();
+                }
+            }
+
+            public override int TryGetSizes(ReadOnlySpan<Sha1Id> shas, Span<long> sizes)
+            {
+                if (sizes.Length < shas.Length)
+                {
+                    throw new ArgumentException($"Must be at least as long as {nameof(shas)}", nameof(sizes));
+                }
+
+                BlobSizesHashFile hashFile = this.blobSizes.BeginRead();
+                if (hashFile == null)
+                {
+                    sizes.Slice(0, shas.Length).Fill(-1);
+                    return 0;
+                }
+
+                try
+                {
+                    return hashFile.TryGetSizes(shas, sizes);
+                }
+                finally
+                {
+                    this.blobSizes.EndRead();
+                }
+            }
+        }
+    }
+}
@@ -97,7 +97,7 @@ public string HashedChildrenNamesSha()
                 ITracer tracer,
                 GVFSGitObjects gitObjects,
                 BlobSizes.BlobSizesConnection blobSizesConnection,
-                Dictionary<string, long> availableSizes,
+                Dictionary<Sha1Id, long> availableSizes,
                 CancellationToken cancellationToken)
             {
                 if (this.ChildrenHaveSizes)
@@ -129,13 +129,14 @@ public string HashedChildrenNamesSha()
             }
 
             /// <summary>
-            /// Populates the sizes of child entries in the folder using locally available data
+            /// Populates the sizes of child entries in the folder using locally available data.  The sizes that are
+            /// not in availableSizes are looked up with a single batch for the whole folder.
             /// </summary>
             private void PopulateSizesLocally(
                 ITracer tracer,
                 GVFSGitObjects gitObjects,
                 BlobSizes.BlobSizesConnection blobSizesConnection,
-                Dictionary<string, long> availableSizes,
+                Dictionary<Sha1Id, long> availableSizes,
                 out HashSet<string> missingShas,
                 out List<FileMissingSize> childrenMissingSizes)
             {
@@ -148,15 +149,48 @@ public string HashedChildrenNamesSha()
 
                 missingShas = new HashSet<string>();
                 childrenMissingSizes = new List<FileMissingSize>();
+
+                List<FileData> childrenToLookUp = new List<FileData>();
                 for (int i = 0; i < this.ChildEntries.Count; i++)
                 {
                     FileData childEntry = this.ChildEntries[i] as FileData;
                     if (childEntry != null)
                     {
-                        string sha;
-                        if (!childEntry.TryPopulateSizeLocally(tracer, gitObjects, blobSizesConnection, availableSizes, out sha))
+                        long blobLength;
+                        if (availableSizes != null && availableSizes.TryGetValue(childEntry.Sha, out blobLength))
+                        {
+                            childEntry.Size = blobLength;
+                        }
+                        else
+                        {
+                            childrenToLookUp.Add(childEntry);
+                        }
+                    }
+                }
+
+                if (childrenToLookUp.Count > 0)
+                {
+                    Sha1Id[] shas = new Sha1Id[childrenToLookUp.Count];
+                    long[] sizes = new long[childrenToLookUp.Count];
+                    for (int i = 0; i < shas.Length; i++)
+                    {
+                        shas[i] = childrenToLookUp[i].Sha;
+                    }
+
+                    TryGetBlobSizesLocally(tracer, gitObjects, blobSizesConnection, shas, sizes);
+
+                    for (int i = 0; i < shas.Length; i++)
+                    {
+                        if (sizes[i] >= 0)
+                        {
+                            childrenToLookUp[i].Size = sizes[i];
+                        }
+                        else
                         {
-                            childrenMissingSizes.Add(new FileMissingSize(childEntry, sha));
+                            // The SHA is only converted to a string when the size cannot be found locally,
+                            // to avoid allocating a string for every file whose size is populated
+                            string sha = shas[i].ToString();
+                            childrenMissingSizes.Add(new FileMissingSize(childrenToLookUp[i], sha));
                             missingShas.Add(sha);
                         }
                     }
@@ -0,0 +1,140 @@
+﻿using System;
+
+namespace GVFS.Virtualization.Projection
+{
+    public partial class GitIndexProjection
+    {
+        /// <summary>
+        /// Open-addressing (linear probing) hash index over the entries of a SortedFolderEntries.
+        /// The index is keyed on the case-folded hash of the entry name so that it can be used for both
+        /// case-sensitive and case-insensitive lookups, and it stores references to the entries (rather
+        /// than indices into the sorted list) so that out of order insertions do not invalidate it.
+        /// </summary>
+        /// <remarks>
+        /// Like SortedFolderEntries this class is only modified while the projection is being built
+        /// (under the projection write lock) and is safe for concurrent readers after that.
+        /// </remarks>
+        internal class FolderEntryHashIndex
+        {
+            // Grow when the table is more than 75% full to keep probe sequences short
+            private const int MaxLoadNumerator = 3;
+            private const int MaxLoadDenominator = 4;
+
+            private FolderEntryData[] slotEntries;
+            private int[] slotHashes;
+            private int mask;
+            private int count;
+
+            public FolderEntryHashIndex(int capacity)
+            {
+                this.AllocateSlots(GetSlotCountForCapacity(capacity));
+            }
+
+            public int Count
+            {
+                get { return this.count; }
+            }
+
+            public void Add(FolderEntryData entry)
+            {
+                if ((this.count + 1) * MaxLoadDenominator > this.slotEntries.Length * MaxLoadNumerator)
+                {
+                    this.Grow();
+                }
+
+                this.InsertIntoSlots(entry, entry.Name.GetCaseInsensitiveHashCode());
+                ++this.count;
+            }
+
+            public bool TryGetValue(LazyUTF8String name, bool caseSensitive, out FolderEntryData value)
+            {
+                int hash = name.GetCaseInsensitiveHashCode();
+                int slot = hash & this.mask;
+
+                FolderEntryData entry = this.slotEntries[slot];
+                while (entry != null)
+                {
+                    if (this.slotHashes[slot] == hash && entry.Name.Compare(name, caseSensitive) == 0)
+                    {
+                        value = entry;
+                        return true;
+                    }
+
+                    slot = (slot + 1) & this.mask;
+                    entry = this.slotEntries[slot];
+                }
+
+                value = null;
+                return false;
+            }
+
+            public bool TryGetValue(ReadOnlySpan<char> name, bool caseSensitive, out FolderEntryData value)
+            {
+                int hash = LazyUTF8String.GetCaseInsensitiveHashCode(name);
+                int slot = hash & this.mask;
+
+                FolderEntryData entry = this.slotEntries[slot];
+                while (entry != null)
+                {
+                    if (this.slotHashes[slot] == hash && entry.Name.Compare(name, caseSensitive) == 0)
+                    {
+                        value = entry;
+                        return true;
+                    }
+
+                    slot = (slot + 1) & this.mask;
+                    entry = this.slotEntries[slot];
+                }
+
+                value = null;
+                return false;
+            }
+
+            private static int GetSlotCountForCapacity(int capacity)
+            {
+                int minSlots = Math.Max(16, (capacity * MaxLoadDenominator / MaxLoadNumerator) + 1);
+                int slotCount = 16;
+                while (slotCount < minSlots)
+                {
+                    slotCount <<= 1;
+                }
+
+                return slotCount;
+            }
+
+            private void AllocateSlots(int slotCount)
+            {
+                this.slotEntries = new FolderEntryData[slotCount];
+                this.slotHashes = new int[slotCount];
+                this.mask = slotCount - 1;
+            }
+
+            private void Grow()
+            {
+                FolderEntryData[] oldEntries = this.slotEntries;
+                int[] oldHashes = this.slotHashes;
+
+                this.AllocateSlots(oldEntries.Length * 2);
+                for (int i = 0; i < oldEntries.Length; ++i)
+                {
+                    if (oldEntries[i] != null)
+                    {
+                        this.InsertIntoSlots(oldEntries[i], oldHashes[i]);
+                    }
+                }
+            }
+
+            private void InsertIntoSlots(FolderEntryData entry, int hash)
+            {
+                int slot = hash & this.mask;
+                while (this.slotEntries[slot] != null)
+                {
+                    slot = (slot + 1) & this.mask;
+                }
+
+                this.slotHashes[slot] = hash;
+                this.slotEntries[slot] = entry;
+            }
+        }
+    }
+}
@@ -9,6 +9,9 @@ public partial class GitIndexProjection
     {
         internal class LazyUTF8String
         {
+            private const uint FnvOffsetBasis = 2166136261;
+            private const uint FnvPrime = 16777619;
+
             private static ObjectPool<LazyUTF8String> stringPool;
             private static BytePool bytePool;
 
@@ -205,6 +208,118 @@ public unsafe int Compare(LazyUTF8String other, bool caseSensitive)
                 return this.length - other.length;
             }
 
+            /// <summary>
+            /// Computes a case-folded FNV-1a hash of the string.  Strings that are equal using either a case-sensitive
+            /// or case-insensitive comparison will always produce the same hash, regardless of whether they are stored
+            /// as pooled ASCII bytes or as a .NET String.
+            /// </summary>
+            public unsafe int GetCaseInsensitiveHashCode()
+            {
+                if (this.utf16string != null)
+                {
+                    return GetCaseInsensitiveHashCode(this.utf16string);
+                }
+
+                uint hash = FnvOffsetBasis;
+                byte* ptr = bytePool.RawPointer + this.startIndex;
+                for (int i = 0; i < this.length; ++i)
+                {
+                    byte c = *ptr;
+
+                    //// if (c.IsLower())
+                    if ((byte)(c - 'a') <= 'z' - 'a')
+                    {
+                        c -= 'a' - 'A';
+                    }
+
+                    hash = (hash ^ c) * FnvPrime;
+                    ++ptr;
+                }
+
+                return (int)hash;
+            }
+
+            /// <summary>
+            /// Computes the same hash as the instance GetCaseInsensitiveHashCode for a name that
+            /// has not been added to the pool (e.g. a path component passed to a callback).
+            /// </summary>
+            public static int GetCaseInsensitiveHashCode(ReadOnlySpan<char> value)
+            {
+                uint hash = FnvOffsetBasis;
+                for (int i = 0; i < value.Length; ++i)
+                {
+                    char c = value[i];
+                    if (c <= 127)
+                    {
+                        //// if (c.IsLower())
+                        if ((uint)(c - 'a') <= 'z' - 'a')
+                        {
+                            c = (char)(c - ('a' - 'A'));
+                        }
+                    }
+                    else
+                    {
+                        c = char.ToUpperInvariant(c);
+                    }
+
+                    hash = (hash ^ c) * FnvPrime;
+                }
+
+                return (int)hash;
+            }
+
+            /// <summary>
+            /// Compares this string to a span of characters without creating a .NET String for either of them
+            /// when both are ASCII.  The result has the same sign as Compare would have if other were
+            /// a LazyUTF8String with the same value.
+            /// </summary>
+            public unsafe int Compare(ReadOnlySpan<char> other, bool caseSensitive)
+            {
+                StringComparison comparison = caseSensitive ? StringComparison.Ordinal : StringComparison.OrdinalIgnoreCase;
+                if (this.utf16string != null)
+                {
+                    return this.utf16string.AsSpan().CompareTo(other, comparison);
+                }
+
+                int minLength = this.length <= other.Length ? this.length : other.Length;
+                byte* thisPtr = bytePool.RawPointer + this.startIndex;
+                for (int count = 0; count < minLength; ++count, ++thisPtr)
+                {
+                    char otherC = other[count];
+                    if (otherC > 127)
+                    {
+                        // Extended characters are not handled below, fall back to the .NET implementation
+                        return this.GetString().AsSpan().CompareTo(other, comparison);
+                    }
+
+                    int thisC = *thisPtr;
+                    if (thisC != otherC)
+                    {
+                        if (!caseSensitive)
+                        {
+                            //// if (thisC.IsLower())
+                            if ((uint)(thisC - 'a') <= 'z' - 'a')
+                            {
+                                thisC -= 'a' - 'A';
+                            }
+
+                            //// if (otherC.IsLower())
+                            if ((uint)(otherC - 'a') <= 'z' - 'a')
+                            {
+                                otherC = (char)(otherC - ('a' - 'A'));
+                            }
+                        }
+
+                        if (thisC != otherC)
+                        {
+                            return thisC - otherC;
+                        }
+                    }
+                }
+
+                return this.length - other.Length;
+            }
+
             public unsafe int CaseInsensitiveCompare(LazyUTF8String other)
             {
                 return this.Compare(other, caseSensitive: false);
@@ -0,0 +1,45 @@
+﻿using System;
+
+namespace GVFS.Virtualization.Projection
+{
+    public partial class GitIndexProjection
+    {
+        /// <summary>
+        /// Summary of how the file placeholder updates were spread across the update threads, recorded
+        /// in the UpdatePlaceholders stats of the GVFS lock release telemetry
+        /// </summary>
+        internal class PlaceholderUpdateThreadStats
+        {
+            public PlaceholderUpdateThreadStats(int workItemCount, long[] threadTimesMs, long totalTimeMs)
+            {
+                this.WorkItemCount = workItemCount;
+                this.ThreadCount = threadTimesMs.Length;
+
+                long minThreadMs = long.MaxValue;
+                long maxThreadMs = 0;
+                long sumThreadMs = 0;
+                foreach (long threadMs in threadTimesMs)
+                {
+                    minThreadMs = Math.Min(minThreadMs, threadMs);
+                    maxThreadMs = Math.Max(maxThreadMs, threadMs);
+                    sumThreadMs += threadMs;
+                }
+
+                this.MinThreadMs = threadTimesMs.Length > 0 ? minThreadMs : 0;
+                this.MaxThreadMs = maxThreadMs;
+
+                // Percentage of the available thread time (number of threads * total time) that the threads
+                // spent working, threads that run out of work early lower the utilization
+                this.UtilizationPercent = totalTimeMs > 0 && threadTimesMs.Length > 0
+                    ? (int)Math.Min(100, (sumThreadMs * 100) / (totalTimeMs * threadTimesMs.Length))
+                    : 100;
+            }
+
+            public int ThreadCount { get; }
+            public int WorkItemCount { get; }
+            public long MinThreadMs { get; }
+            public long MaxThreadMs { get; }
+            public int UtilizationPercent { get; }
+        }
+    }
+}
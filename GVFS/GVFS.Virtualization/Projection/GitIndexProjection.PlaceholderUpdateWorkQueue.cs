@@ -0,0 +1,173 @@
+﻿using GVFS.Common.Database;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+
+namespace GVFS.Virtualization.Projection
+{
+    public partial class GitIndexProjection
+    {
+        /// <summary>
+        /// Splits the file placeholders to update into work items that are handed out to the placeholder update threads
+        /// on demand.  Placeholders are grouped by parent folder so that all of the updates for a folder are done by a
+        /// single thread (and the file system only has to lock each directory from one thread), and because threads pull
+        /// work items as they finish the previous one a few expensive folders no longer leave the other threads idle.
+        /// </summary>
+        /// <remarks>
+        /// Folders with more than MaxPlaceholdersPerWorkItem placeholders are split across work items, otherwise a single
+        /// large folder (e.g. after a checkout that touches every file in it) would be processed by one thread.
+        /// </remarks>
+        internal class PlaceholderUpdateWorkQueue
+        {
+            // Matches the number of SHAs BatchPopulateMissingSizesFromRemote sends in a single request
+            internal const int MaxPlaceholdersPerWorkItem = 2000;
+
+            // Number of work items to aim for per thread, more work items give better balancing at the cost of
+            // more (smaller) size requests when sizes need to be downloaded
+            internal const int TargetWorkItemsPerThread = 8;
+
+            private readonly int[] workItemBoundaries;
+            private int nextWorkItem = -1;
+
+            public PlaceholderUpdateWorkQueue(List<IPlaceholderData> placeholders, int threadCount, StringComparer pathComparer)
+            {
+                List<string> folderNames = new List<string>();
+                List<int> folderCounts = new List<int>();
+                int[] placeholderFolderIndexes = new int[placeholders.Count];
+
+                Dictionary<string, int> folderIndexes = new Dictionary<string, int>(pathComparer);
+                Dictionary<string, int>.AlternateLookup<ReadOnlySpan<char>> folderIndexesLookup = folderIndexes.GetAlternateLookup<ReadOnlySpan<char>>();
+                for (int i = 0; i < placeholders.Count; ++i)
+                {
+                    ReadOnlySpan<char> parentFolder = GetParentFolder(placeholders[i].Path);
+                    if (!folderIndexesLookup.TryGetValue(parentFolder, out int folderIndex))
+                    {
+                        folderIndex = folderNames.Count;
+                        string folderName = parentFolder.ToString();
+                        folderNames.Add(folderName);
+                        folderCounts.Add(0);
+                        folderIndexes.Add(folderName, folderIndex);
+                    }
+
+                    placeholderFolderIndexes[i] = folderIndex;
+                    ++folderCounts[folderIndex];
+                }
+
+                // Process the folders in path order so that folders that are near each other on disk are
+                // handed out together
+                string[] sortedFolderNames = folderNames.ToArray();
+                int[] sortedFolderIndexes = new int[sortedFolderNames.Length];
+                for (int i = 0; i < sortedFolderIndexes.Length; ++i)
+                {
+                    sortedFolderIndexes[i] = i;
+                }
+
+                Array.Sort(sortedFolderNames, sortedFolderIndexes, pathComparer);
+
+                int[] folderStarts = new int[folderNames.Count];
+                int position = 0;
+                for (int i = 0; i < sortedFolderIndexes.Length; ++i)
+                {
+                    folderStarts[sortedFolderIndexes[i]] = position;
+                    position += folderCounts[sortedFolderIndexes[i]];
+                }
+
+                IPlaceholderData[] orderedPlaceholders = new IPlaceholderData[placeholders.Count];
+                for (int i = 0; i < placeholders.Count; ++i)
+                {
+                    orderedPlaceholders[folderStarts[placeholderFolderIndexes[i]]++] = placeholders[i];
+                }
+
+                this.Placeholders = new List<IPlaceholderData>(orderedPlaceholders);
+                this.FolderCount = folderNames.Count;
+
+                int targetWorkItemSize = placeholders.Count / (Math.Max(threadCount, 1) * TargetWorkItemsPerThread);
+                targetWorkItemSize = Math.Min(Math.Max(targetWorkItemSize, 1), MaxPlaceholdersPerWorkItem);
+                this.workItemBoundaries = GetWorkItemBoundaries(sortedFolderIndexes, folderCounts, targetWorkItemSize);
+            }
+
+            /// <summary>
+            /// The placeholders grouped by parent folder, work item start and end values are indexes into this list
+            /// </summary>
+            public List<IPlaceholderData> Placeholders { get; }
+
+            public int FolderCount { get; }
+
+            public int WorkItemCount
+            {
+                get { return this.workItemBoundaries.Length - 1; }
+            }
+
+            /// <summary>
+            /// Get the next work item to process, safe to call from multiple threads
+            /// </summary>
+            /// <param name="start">Index in Placeholders of the first placeholder in the work item</param>
+            /// <param name="end">Index in Placeholders after the last placeholder in the work item</param>
+            /// <returns>True if a work item was returned, false if all of the work items have been handed out</returns>
+            public bool TryGetNextWorkItem(out int start, out int end)
+            {
+                int workItem = Interlocked.Increment(ref this.nextWorkItem);
+                if (workItem >= this.WorkItemCount)
+                {
+                    start = 0;
+                    end = 0;
+                    return false;
+                }
+
+                start = this.workItemBoundaries[workItem];
+                end = this.workItemBoundaries[workItem + 1];
+                return true;
+            }
+
+            private static ReadOnlySpan<char> GetParentFolder(string path)
+            {
+                int separatorIndex = path.LastIndexOf(Path.DirectorySeparatorChar);
+                return separatorIndex < 0 ? ReadOnlySpan<char>.Empty : path.AsSpan(0, separatorIndex);
+            }
+
+            private static int[] GetWorkItemBoundaries(int[] sortedFolderIndexes, List<int> folderCounts, int targetWorkItemSize)
+            {
+                List<int> boundaries = new List<int>();
+                boundaries.Add(0);
+
+                int position = 0;
+                int currentWorkItemSize = 0;
+                for (int i = 0; i < sortedFolderIndexes.Length; ++i)
+                {
+                    int remaining = folderCounts[sortedFolderIndexes[i]];
+
+                    // Small folders are combined into a single work item, but never split a folder across
+                    // work items unless it is too large to fit in one by itself
+                    if (currentWorkItemSize > 0 && currentWorkItemSize + remaining > MaxPlaceholdersPerWorkItem)
+                    {
+                        boundaries.Add(position);
+                        currentWorkItemSize = 0;
+                    }
+
+                    while (remaining > MaxPlaceholdersPerWorkItem)
+                    {
+                        position += MaxPlaceholdersPerWorkItem;
+                        remaining -= MaxPlaceholdersPerWorkItem;
+                        boundaries.Add(position);
+                    }
+
+                    position += remaining;
+                    currentWorkItemSize += remaining;
+                    if (currentWorkItemSize >= targetWorkItemSize)
+                    {
+                        boundaries.Add(position);
+                        currentWorkItemSize = 0;
+                    }
+                }
+
+                if (currentWorkItemSize > 0)
+                {
+                    boundaries.Add(position);
+                }
+
+                return boundaries.ToArray();
+            }
+        }
+    }
+}
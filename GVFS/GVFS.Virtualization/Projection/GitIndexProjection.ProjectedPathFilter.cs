@@ -0,0 +1,189 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace GVFS.Virtualization.Projection
+{
+    public partial class GitIndexProjection
+    {
+        /// <summary>
+        /// Bloom filter over the paths of every entry in the projection tree.  The filter is used to answer
+        /// "is this path projected?" for paths that are definitely not in the projection (e.g. paths probed by
+        /// build tools) without walking the tree.  A positive answer from the filter only means that the path
+        /// might be projected, and the caller must still walk the tree.
+        /// </summary>
+        /// <remarks>
+        /// Paths are hashed one component at a time using the case-folded component hash from LazyUTF8String,
+        /// so the same filter works for case-sensitive and case-insensitive file systems, and empty path components
+        /// are skipped the same way that TryGetFolderEntryDataFromTree skips them.
+        ///
+        /// The filter contains every folder and file in the tree (including folders that are not included in the
+        /// sparse set) so that it does not need to be updated when a folder is added to the sparse set.
+        /// The filter is built after the projection is parsed (while holding the projection write lock) and is
+        /// read-only after that.
+        /// </remarks>
+        internal class ProjectedPathFilter
+        {
+            // 10 bits per entry and 7 probes gives a false positive rate of roughly 1%
+            internal const int BitsPerEntry = 10;
+            internal const int ProbeCount = 7;
+
+            private const ulong FnvOffsetBasis64 = 14695981039346656037;
+            private const ulong FnvPrime64 = 1099511628211;
+
+            private readonly ulong[] bits;
+            private readonly ulong bitCount;
+
+            public ProjectedPathFilter(int entryCount)
+            {
+                long requestedBits = Math.Max(64L, (long)entryCount * BitsPerEntry);
+                this.bits = new ulong[(requestedBits + 63) / 64];
+                this.bitCount = (ulong)this.bits.Length * 64;
+            }
+
+            public int EntryCount { get; private set; }
+
+            public int SizeInBytes
+            {
+                get { return this.bits.Length * sizeof(ulong); }
+            }
+
+            /// <summary>
+            /// Builds a filter containing the path of every folder and file below root.
+            /// </summary>
+            public static ProjectedPathFilter Build(FolderData root)
+            {
+                ProjectedPathFilter filter = new ProjectedPathFilter(CountEntries(root));
+
+                Stack<KeyValuePair<FolderData, ulong>> stack = new Stack<KeyValuePair<FolderData, ulong>>();
+                stack.Push(new KeyValuePair<FolderData, ulong>(root, FnvOffsetBasis64));
+                while (stack.Count > 0)
+                {
+                    KeyValuePair<FolderData, ulong> current = stack.Pop();
+                    SortedFolderEntries childEntries = current.Key.ChildEntries;
+                    for (int i = 0; i < childEntries.Count; i++)
+                    {
+                        FolderEntryData childEntry = childEntries[i];
+                        ulong childPathHash = AppendComponent(current.Value, childEntry.Name.GetCaseInsensitiveHashCode());
+                        filter.Add(childPathHash);
+
+                        if (childEntry.IsFolder)
+                        {
+                            stack.Push(new KeyValuePair<FolderData, ulong>((FolderData)childEntry, childPathHash));
+                        }
+                    }
+                }
+
+                return filter;
+            }
+
+            /// <summary>
+            /// Computes the hash used by the filter for the path parentPath\childName
+            /// </summary>
+            /// <remarks>
+            /// Takes the parent path and child name separately so that the results of GetChildNameAndParentKey can be
+            /// used without having to allocate the full path
+            /// </remarks>
+            public static ulong ComputePathHash(ReadOnlySpan<char> parentPath, ReadOnlySpan<char> childName)
+            {
+                ulong pathHash = FnvOffsetBasis64;
+                while (parentPath.Length > 0)
+                {
+                    ReadOnlySpan<char> pathPart;
+                    int separatorIndex = parentPath.IndexOf(Path.DirectorySeparatorChar);
+                    if (separatorIndex < 0)
+                    {
+                        pathPart = parentPath;
+                        parentPath = ReadOnlySpan<char>.Empty;
+                    }
+                    else
+                    {
+                        pathPart = parentPath.Slice(0, separatorIndex);
+                        parentPath = parentPath.Slice(separatorIndex + 1);
+                    }
+
+                    if (!pathPart.IsEmpty)
+                    {
+                        pathHash = AppendComponent(pathHash, LazyUTF8String.GetCaseInsensitiveHashCode(pathPart));
+                    }
+                }
+
+                return AppendComponent(pathHash, LazyUTF8String.GetCaseInsensitiveHashCode(childName));
+            }
+
+            public void Add(ulong pathHash)
+            {
+                ulong mixedHash = Mix(pathHash);
+                ulong hash1 = mixedHash & 0xFFFFFFFF;
+                ulong hash2 = (mixedHash >> 32) | 1;
+                for (int i = 0; i < ProbeCount; i++)
+                {
+                    ulong bit = (hash1 + ((ulong)i * hash2)) % this.bitCount;
+                    this.bits[bit >> 6] |= 1UL << (int)(bit & 63);
+                }
+
+                ++this.EntryCount;
+            }
+
+            /// <summary>
+            /// Returns false if the path is definitely not in the filter, and true if it might be
+            /// </summary>
+            public bool MightContain(ulong pathHash)
+            {
+                ulong mixedHash = Mix(pathHash);
+                ulong hash1 = mixedHash & 0xFFFFFFFF;
+                ulong hash2 = (mixedHash >> 32) | 1;
+                for (int i = 0; i < ProbeCount; i++)
+                {
+                    ulong bit = (hash1 + ((ulong)i * hash2)) % this.bitCount;
+                    if ((this.bits[bit >> 6] & (1UL << (int)(bit & 63))) == 0)
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            private static ulong AppendComponent(ulong pathHash, int componentHash)
+            {
+                return (pathHash ^ (uint)componentHash) * FnvPrime64;
+            }
+
+            /// <summary>
+            /// Finalizer from MurmurHash3, FNV leaves the high bits of short inputs poorly mixed and
+            /// the filter takes its second probe hash from the high bits
+            /// </summary>
+            private static ulong Mix(ulong hash)
+            {
+                hash ^= hash >> 33;
+                hash *= 0xff51afd7ed558ccd;
+                hash ^= hash >> 33;
+                hash *= 0xc4ceb9fe1a85ec53;
+                hash ^= hash >> 33;
+                return hash;
+            }
+
+            private static int CountEntries(FolderData root)
+            {
+                int count = 0;
+                Stack<FolderData> stack = new Stack<FolderData>();
+                stack.Push(root);
+                while (stack.Count > 0)
+                {
+                    FolderData current = stack.Pop();
+                    count += current.ChildEntries.Count;
+                    for (int i = 0; i < current.ChildEntries.Count; i++)
+                    {
+                        if (current.ChildEntries[i].IsFolder)
+                        {
+                            stack.Push((FolderData)current.ChildEntries[i]);
+                        }
+                    }
+                }
+
+                return count;
+            }
+        }
+    }
+}
@@ -10,13 +10,21 @@ public partial class GitIndexProjection
         /// <summary>
         /// This class stores the list of FolderEntryData objects for a FolderData ChildEntries in sorted order.
         /// The entries can be either FolderData objects or FileData objects in the sortedEntries list.
+        /// Once a folder has more than HashIndexThreshold entries a FolderEntryHashIndex is attached so that
+        /// lookups by name in large folders do not have to binary search the sortedEntries list.
         /// </summary>
         internal class SortedFolderEntries
         {
+            // Folders smaller than this are searched with a binary search, which is cheaper than
+            // hashing the name and does not require any additional memory
+            internal const int HashIndexThreshold = 512;
+
             private static ObjectPool<FolderData> folderPool;
             private static ObjectPool<FileData> filePool;
+            private static int hashIndexedFolderCount;
 
             private List<FolderEntryData> sortedEntries;
+            private FolderEntryHashIndex hashIndex;
 
             public SortedFolderEntries()
             {
@@ -51,12 +59,15 @@ public static void InitializePools(ITracer tracer, uint indexEntryCount)
 
             public static void ResetPool(ITracer tracer, uint indexEntryCount)
             {
+                hashIndexedFolderCount = 0;
                 folderPool = new ObjectPool<FolderData>(tracer, Convert.ToInt32(indexEntryCount * PoolAllocationMultipliers.FolderDataPool), () => new FolderData());
                 filePool = new ObjectPool<FileData>(tracer, Convert.ToInt32(indexEntryCount * PoolAllocationMultipliers.FileDataPool), () => new FileData());
             }
 
             public static void FreePool()
             {
+                hashIndexedFolderCount = 0;
+
                 if (folderPool != null)
                 {
                     folderPool.FreeAll();
@@ -84,9 +95,15 @@ public static int FilePoolSize()
                 return filePool.Size;
             }
 
+            public static int HashIndexedFolderCount()
+            {
+                return hashIndexedFolderCount;
+            }
+
             public void Clear()
             {
                 this.sortedEntries.Clear();
+                this.hashIndex = null;
             }
 
             public FileData AddFile(LazyUTF8String name, byte[] shaBytes)
@@ -101,6 +118,13 @@ public FileData AddFile(LazyUTF8String name, byte[] shaBytes)
                 bool parentIsIncluded,
                 SparseFolderData rootSparseFolderData)
             {
+                FolderEntryData existingEntry;
+                if (this.hashIndex != null &&
+                    this.hashIndex.TryGetValue(pathParts[partIndex], GVFSPlatform.Instance.Constants.CaseSensitiveFileSystem, out existingEntry))
+                {
+                    return (FolderData)existingEntry;
+                }
+
                 int index = this.GetSortedEntriesIndexOfName(pathParts[partIndex]);
                 if (index >= 0)
                 {
@@ -144,6 +168,11 @@ public FileData AddFile(LazyUTF8String name, byte[] shaBytes)
 
             public bool TryGetValue(LazyUTF8String name, out FolderEntryData value)
             {
+                if (this.hashIndex != null)
+                {
+                    return this.hashIndex.TryGetValue(name, GVFSPlatform.Instance.Constants.CaseSensitiveFileSystem, out value);
+                }
+
                 int index = this.GetSortedEntriesIndexOfName(name);
                 if (index >= 0)
                 {
@@ -155,6 +184,44 @@ public bool TryGetValue(LazyUTF8String name, out FolderEntryData value)
                 return false;
             }
 
+            /// <summary>
+            /// Get the entry for a name that is not in the LazyUTF8String pool, such as a component of a
+            /// path passed in by the file system.  This overload does not allocate.
+            /// </summary>
+            public bool TryGetValue(ReadOnlySpan<char> name, out FolderEntryData value)
+            {
+                bool caseSensitive = GVFSPlatform.Instance.Constants.CaseSensitiveFileSystem;
+                if (this.hashIndex != null)
+                {
+                    return this.hashIndex.TryGetValue(name, caseSensitive, out value);
+                }
+
+                int left = 0;
+                int right = this.sortedEntries.Count - 1;
+                while (left <= right)
+                {
+                    int middle = left + ((right - left) / 2);
+                    int comparison = this.sortedEntries[middle].Name.Compare(name, caseSensitive);
+                    if (comparison == 0)
+                    {
+                        value = this.sortedEntries[middle];
+                        return true;
+                    }
+
+                    if (comparison < 0)
+                    {
+                        left = middle + 1;
+                    }
+                    else
+                    {
+                        right = middle - 1;
+                    }
+                }
+
+                value = null;
+                return false;
+            }
+
             private int GetInsertionIndex(LazyUTF8String name)
             {
                 int insertionIndex = 0;
@@ -179,6 +246,7 @@ private FolderData InsertFolder(LazyUTF8String name, int insertionIndex, bool is
                 FolderData data = folderPool.GetNew();
                 data.ResetData(name, isIncluded);
                 this.sortedEntries.Insert(insertionIndex, data);
+                this.AddToHashIndex(data);
                 return data;
             }
 
@@ -187,9 +255,28 @@ private FileData InsertFile(LazyUTF8String name, byte[] shaBytes, int insertionI
                 FileData data = filePool.GetNew();
                 data.ResetData(name, shaBytes);
                 this.sortedEntries.Insert(insertionIndex, data);
+                this.AddToHashIndex(data);
                 return data;
             }
 
+            private void AddToHashIndex(FolderEntryData data)
+            {
+                if (this.hashIndex != null)
+                {
+                    this.hashIndex.Add(data);
+                }
+                else if (this.sortedEntries.Count > HashIndexThreshold)
+                {
+                    this.hashIndex = new FolderEntryHashIndex(this.sortedEntries.Count * 2);
+                    for (int i = 0; i < this.sortedEntries.Count; ++i)
+                    {
+                        this.hashIndex.Add(this.sortedEntries[i]);
+                    }
+
+                    ++hashIndexedFolderCount;
+                }
+            }
+
             /// <summary>
             /// Get the index of the name in the sorted folder entries list
             /// </summary>
@@ -8,7 +8,6 @@
 using GVFS.Virtualization.BlobSize;
 using GVFS.Virtualization.FileSystem;
 using System;
-using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.ComponentModel;
 using System.Diagnostics;
@@ -45,11 +44,15 @@ public partial class GitIndexProjection : IDisposable, IProfilerOnlyIndexProject
         private FileSystemVirtualizer fileSystemVirtualizer;
         private ModifiedPathsDatabase modifiedPaths;
 
+        // Folder paths are resolved by walking rootFolderData one path component at a time (see TryGetIncludedFolderData).
+        // The tree is only modified while holding the projection write lock, so readers do not need any additional locking.
         private FolderData rootFolderData = new FolderData();
         private GitIndexParser indexParser;
 
-        // Cache of folder paths (in Windows format) to folder data
-        private ConcurrentDictionary<string, FolderData> projectionFolderCache = new ConcurrentDictionary<string, FolderData>(GVFSPlatform.Instance.Constants.PathComparer);
+        // Bloom filter over every path in rootFolderData, used to reject paths that are not projected without walking
+        // the tree.  Rebuilt (under the projection write lock) each time the projection is built, and null while the
+        // projection is being built or when the projection was built by BuildProjectionFromPath.
+        private ProjectedPathFilter projectedPathFilter;
 
         // nonDefaultFileTypesAndModes is only populated when the platform supports file mode
         // On platforms that support file modes, file paths that are not in nonDefaultFileTypesAndModes are regular files with mode 644
@@ -174,6 +177,43 @@ void IProfilerOnlyIndexProjection.ForceAddMissingModifiedPaths(ITracer tracer)
             }
         }
 
+        /// <summary>
+        /// Look up every path in the projection using the same code path as the file system callbacks.
+        /// This method should only be used to measure projection lookup performance.
+        /// </summary>
+        /// <returns>The number of paths that were found in the projection</returns>
+        int IProfilerOnlyIndexProjection.ForceLookupOfAllProjectedPaths()
+        {
+            List<string> projectedPaths = new List<string>();
+            Stack<KeyValuePair<string, FolderData>> folders = new Stack<KeyValuePair<string, FolderData>>();
+            folders.Push(new KeyValuePair<string, FolderData>(string.Empty, this.rootFolderData));
+            while (folders.Count > 0)
+            {
+                KeyValuePair<string, FolderData> folder = folders.Pop();
+                for (int i = 0; i < folder.Value.ChildEntries.Count; i++)
+                {
+                    FolderEntryData childEntry = folder.Value.ChildEntries[i];
+                    string childPath = folder.Key.Length == 0 ? childEntry.Name.GetString() : folder.Key + Path.DirectorySeparatorChar + childEntry.Name.GetString();
+                    projectedPaths.Add(childPath);
+                    if (childEntry.IsFolder)
+                    {
+                        folders.Push(new KeyValuePair<string, FolderData>(childPath, (FolderData)childEntry));
+                    }
+                }
+            }
+
+            int foundCount = 0;
+            foreach (string path in projectedPaths)
+            {
+                if (this.IsPathProjected(path, out string _, out bool _))
+                {
+                    ++foundCount;
+                }
+            }
+
+            return foundCount;
+        }
+
         public void BuildProjectionFromPath(ITracer tracer, string indexPath)
         {
             using (FileStream indexStream = new FileStream(indexPath, FileMode.Open, FileAccess.ReadWrite, FileShare.Read, IndexFileStreamBufferSize))
@@ -431,7 +471,7 @@ public virtual bool TryGetProjectedItemsFromMemory(string folderPath, out List<P
             try
             {
                 FolderData folderData;
-                if (this.TryGetOrAddFolderDataFromCache(folderPath, out folderData))
+                if (this.TryGetIncludedFolderData(folderPath, out folderData))
                 {
                     if (folderData.ChildrenHaveSizes)
                     {
@@ -493,7 +533,7 @@ public virtual void GetFileTypeAndMode(string filePath, out FileType fileType, o
             try
             {
                 FolderData folderData;
-                if (this.TryGetOrAddFolderDataFromCache(folderPath, out folderData))
+                if (this.TryGetIncludedFolderData(folderPath, out folderData))
                 {
                     if (blobSizesConnection != null)
                     {
@@ -518,8 +558,8 @@ public virtual void GetFileTypeAndMode(string filePath, out FileType fileType, o
 
         public virtual PathSparseState GetFolderPathSparseState(string virtualPath)
         {
-            // Have to use a call that will get excluded entries in order to return the Excluded state
-            // Excluded folders are not in the cache and GetProjectedFolderEntryData will not return them
+            // Walk the tree with TryGetFolderDataFromTreeUsingPath, which finds excluded folders as well, in order
+            // to return the Excluded state (GetProjectedFolderEntryData does not return excluded folders)
             if (this.TryGetFolderDataFromTreeUsingPath(virtualPath, out FolderData folderData))
             {
                 return folderData.IsIncluded ? PathSparseState.Included : PathSparseState.Excluded;
@@ -532,8 +572,8 @@ public virtual bool TryAddSparseFolder(string virtualPath)
         {
             try
             {
-                // Have to use a call that will get excluded entries in order to return the Excluded state
-                // Excluded folders are not in the cache and GetProjectedFolderEntryData will not return them
+                // Walk the tree with TryGetFolderDataFromTreeUsingPath, which finds excluded folders as well
+                // (GetProjectedFolderEntryData does not return excluded folders)
                 if (this.TryGetFolderDataFromTreeUsingPath(virtualPath, out FolderData folderData) &&
                     !folderData.IsIncluded)
                 {
@@ -763,6 +803,121 @@ private static EventMetadata CreateEventMetadata(Exception e = null)
             return metadata;
         }
 
+        /// <summary>
+        /// Looks up the sizes of a batch of blobs in the BlobSizes database, and then in the local object store
+        /// for the blobs that are not in the database.  Sizes found in the local object store are added to the
+        /// database.
+        /// </summary>
+        /// <param name="sizes">Receives the size of each blob in shas, or -1 if the size is not available locally</param>
+        /// <returns>The number of blobs whose size was found</returns>
+        private static int TryGetBlobSizesLocally(
+            ITracer tracer,
+            GVFSGitObjects gitObjects,
+            BlobSizes.BlobSizesConnection blobSizesConnection,
+            Sha1Id[] shas,
+            long[] sizes)
+        {
+            int foundCount;
+            try
+            {
+                foundCount = blobSizesConnection.TryGetSizes(shas, sizes);
+            }
+            catch (BlobSizesException e)
+            {
+                EventMetadata metadata = CreateEventMetadata(e);
+                metadata.Add("ShaCount", shas.Length);
+                tracer.RelatedWarning(metadata, $"{nameof(TryGetBlobSizesLocally)}: Exception while trying to get file sizes", Keywords.Telemetry);
+
+                Array.Fill(sizes, -1);
+                foundCount = 0;
+            }
+
+            if (foundCount == shas.Length)
+            {
+                return foundCount;
+            }
+
+            int[] missingIndices = new int[shas.Length - foundCount];
+            Sha1Id[] missingShas = new Sha1Id[missingIndices.Length];
+            int missingCount = 0;
+            for (int i = 0; i < shas.Length; ++i)
+            {
+                if (sizes[i] < 0)
+                {
+                    missingIndices[missingCount] = i;
+                    missingShas[missingCount] = shas[i];
+                    ++missingCount;
+                }
+            }
+
+            long[] localSizes = new long[missingCount];
+            if (gitObjects.TryGetBlobSizesLocally(missingShas, localSizes) > 0)
+            {
+                for (int i = 0; i < missingCount; ++i)
+                {
+                    if (localSizes[i] >= 0)
+                    {
+                        sizes[missingIndices[i]] = localSizes[i];
+                        ++foundCount;
+
+                        // There is no flush for this value because it's already local, so there's little loss if it doesn't get persisted
+                        // But it's faster to wait for some remote call to batch this value into a different flush
+                        blobSizesConnection.BlobSizesDatabase.AddSize(missingShas[i], localSizes[i]);
+                    }
+                }
+            }
+
+            return foundCount;
+        }
+
+        /// <summary>
+        /// Sets the size of a single file from availableSizes, the BlobSizes database or the local object store.
+        /// Unlike <see cref="TryGetBlobSizesLocally"/> this looks up only the one SHA, and checks its loose object
+        /// before the packs.
+        /// </summary>
+        /// <returns>True if the size of the file was found locally</returns>
+        private static bool TryPopulateSizeLocally(
+            ITracer tracer,
+            GVFSGitObjects gitObjects,
+            BlobSizes.BlobSizesConnection blobSizesConnection,
+            Dictionary<Sha1Id, long> availableSizes,
+            FileData fileData)
+        {
+            Sha1Id sha = fileData.Sha;
+            if (availableSizes != null && availableSizes.TryGetValue(sha, out long blobLength))
+            {
+                fileData.Size = blobLength;
+                return true;
+            }
+
+            try
+            {
+                if (blobSizesConnection.TryGetSize(sha, out blobLength))
+                {
+                    fileData.Size = blobLength;
+                    return true;
+                }
+            }
+            catch (BlobSizesException e)
+            {
+                EventMetadata metadata = CreateEventMetadata(e);
+                metadata.Add("missingSha", sha.ToString());
+                tracer.RelatedWarning(metadata, $"{nameof(TryPopulateSizeLocally)}: Exception while trying to get file size", Keywords.Telemetry);
+            }
+
+            if (gitObjects.TryGetBlobSizeLocally(sha.ToString(), out blobLength))
+            {
+                fileData.Size = blobLength;
+
+                // There is no flush for this value because it's already local, so there's little loss if it doesn't get persisted
+                // But it's faster to wait for some remote call to batch this value into a different flush
+                blobSizesConnection.BlobSizesDatabase.AddSize(sha, blobLength);
+                return true;
+            }
+
+            return false;
+        }
+
         private static List<ProjectedFileInfo> ConvertToProjectedFileInfos(SortedFolderEntries sortedFolderEntries)
         {
             List<ProjectedFileInfo> childItems = new List<ProjectedFileInfo>(sortedFolderEntries.Count);
@@ -833,8 +988,8 @@ private void ClearProjectionCaches()
         {
             SortedFolderEntries.FreePool();
             LazyUTF8String.FreePool();
-            this.projectionFolderCache.Clear();
             this.nonDefaultFileTypesAndModes.Clear();
+            this.projectedPathFilter = null;
             this.RefreshSparseFolders();
             this.rootFolderData.ResetData(new LazyUTF8String("<root>"), isIncluded: true);
         }
@@ -981,7 +1136,7 @@ private FolderData AddFileToTree(GitIndexEntry indexEntry)
         private FolderEntryData GetProjectedFolderEntryData(
             CancellationToken cancellationToken,
             BlobSizes.BlobSizesConnection blobSizesConnection,
-            Dictionary<string, long> availableSizes,
+            Dictionary<Sha1Id, long> availableSizes,
             string childName,
             string parentKey,
             out string gitCasedChildName)
@@ -990,18 +1145,18 @@ private FolderData AddFileToTree(GitIndexEntry indexEntry)
             try
             {
                 FolderData parentFolderData;
-                if (this.TryGetOrAddFolderDataFromCache(parentKey, out parentFolderData))
+                if (this.IsPathInProjectedPathFilter(parentKey, childName) &&
+                    this.TryGetIncludedFolderData(parentKey, out parentFolderData))
                 {
-                    LazyUTF8String child = new LazyUTF8String(childName);
                     FolderEntryData childData;
-                    if (parentFolderData.ChildEntries.TryGetValue(child, out childData) && (!childData.IsFolder || ((FolderData)childData).IsIncluded))
+                    if (parentFolderData.ChildEntries.TryGetValue(childName.AsSpan(), out childData) && (!childData.IsFolder || ((FolderData)childData).IsIncluded))
                     {
                         gitCasedChildName = childData.Name.GetString();
 
                         if (blobSizesConnection != null && !childData.IsFolder)
                         {
                             FileData fileData = (FileData)childData;
-                            if (!fileData.IsSizeSet() && !fileData.TryPopulateSizeLocally(this.context.Tracer, this.gitObjects, blobSizesConnection, availableSizes, out string _))
+                            if (!fileData.IsSizeSet() && !TryPopulateSizeLocally(this.context.Tracer, this.gitObjects, blobSizesConnection, availableSizes, fileData))
                             {
                                 Stopwatch queryTime = Stopwatch.StartNew();
                                 parentFolderData.PopulateSizes(this.context.Tracer, this.gitObjects, blobSizesConnection, availableSizes, cancellationToken);
@@ -1051,25 +1206,33 @@ private FolderData AddFileToTree(GitIndexEntry indexEntry)
         }
 
         /// <summary>
-        /// Try to get the FolderData for the specified folder path from the projectionFolderCache
-        /// cache.  If the  folder is not already in projectionFolderCache, search for it in the tree and
-        /// then add it to projectionData
+        /// Check the projected path filter for parentKey\childName
         /// </summary>
-        /// <returns>True if the folder could be found, and false otherwise</returns>
-        private bool TryGetOrAddFolderDataFromCache(
-            string folderPath,
+        /// <returns>
+        /// False if the path is definitely not in the projection, and true if the path might be in the projection
+        /// (or if there is no filter)
+        /// </returns>
+        /// <remarks>Caller must hold the projection read (or write) lock</remarks>
+        private bool IsPathInProjectedPathFilter(string parentKey, string childName)
+        {
+            ProjectedPathFilter filter = this.projectedPathFilter;
+            return filter == null || filter.MightContain(ProjectedPathFilter.ComputePathHash(parentKey, childName));
+        }
+
+        /// <summary>
+        /// Try to get the FolderData for the specified folder path, only returning folders
+        /// that are included in the projection
+        /// </summary>
+        /// <returns>True if the folder could be found and is included, and false otherwise</returns>
+        private bool TryGetIncludedFolderData(
+            ReadOnlySpan<char> folderPath,
             out FolderData folderData)
         {
-            if (!this.projectionFolderCache.TryGetValue(folderPath, out folderData))
+            if (!this.TryGetFolderDataFromTreeUsingPath(folderPath, out folderData) ||
+                !folderData.IsIncluded)
             {
-                if (!this.TryGetFolderDataFromTreeUsingPath(folderPath, out folderData) ||
-                    !folderData.IsIncluded)
-                {
-                    folderData = null;
-                    return false;
-                }
-
-                this.projectionFolderCache.TryAdd(folderPath, folderData);
+                folderData = null;
+                return false;
             }
 
             return true;
@@ -1081,16 +1244,12 @@ private FolderData AddFileToTree(GitIndexEntry indexEntry)
         /// <param name="folderPath">The path to the folder to lookup</param>
         /// <param name="folderData">out paramenter - the FolderData to return if found</param>
         /// <returns>true if the FolderData was found and set in the out parameter otherwise false</returns>
-        private bool TryGetFolderDataFromTreeUsingPath(string folderPath, out FolderData folderData)
+        private bool TryGetFolderDataFromTreeUsingPath(ReadOnlySpan<char> folderPath, out FolderData folderData)
         {
             folderData = null;
-            LazyUTF8String[] pathParts = folderPath
-                .Split(new char[] { Path.DirectorySeparatorChar }, StringSplitOptions.RemoveEmptyEntries)
-                .Select(x => new LazyUTF8String(x))
-                .ToArray();
 
             FolderEntryData data;
-            if (!this.TryGetFolderEntryDataFromTree(pathParts, folderEntryData: out data))
+            if (!this.TryGetFolderEntryDataFromTree(folderPath, folderEntryData: out data))
             {
                 return false;
             }
@@ -1103,7 +1262,7 @@ private bool TryGetFolderDataFromTreeUsingPath(string folderPath, out FolderData
             else
             {
                 EventMetadata metadata = CreateEventMetadata();
-                metadata.Add("folderPath", folderPath);
+                metadata.Add("folderPath", folderPath.ToString());
                 metadata.Add(TracingConstants.MessageKey.InfoMessage, "Found file at path");
                 this.context.Tracer.RelatedEvent(
                     EventLevel.Informational,
@@ -1115,25 +1274,45 @@ private bool TryGetFolderDataFromTreeUsingPath(string folderPath, out FolderData
         }
 
         /// <summary>
-        /// Finds the FolderEntryData for the path provided will find the FolderEntryData specified in pathParts.
+        /// Finds the FolderEntryData for the path provided by walking the tree one path component at a time.
         /// </summary>
-        /// <param name="pathParts">Path</param>
-        /// <param name="folderEntryData">Out: FolderEntryData for pathParts</param>
+        /// <param name="path">Path (using Path.DirectorySeparatorChar), empty path components are ignored</param>
+        /// <param name="folderEntryData">Out: FolderEntryData for path</param>
         /// <returns>True if the specified path could be found in the tree, and false otherwise</returns>
-        private bool TryGetFolderEntryDataFromTree(LazyUTF8String[] pathParts, out FolderEntryData folderEntryData)
+        /// <remarks>
+        /// The path components are compared in place so that no strings are allocated for the lookup
+        /// </remarks>
+        private bool TryGetFolderEntryDataFromTree(ReadOnlySpan<char> path, out FolderEntryData folderEntryData)
         {
             folderEntryData = null;
-            int depth = pathParts.Length;
             FolderEntryData currentEntry = this.rootFolderData;
-            for (int pathIndex = 0; pathIndex < depth; ++pathIndex)
+            while (path.Length > 0)
             {
+                ReadOnlySpan<char> pathPart;
+                int separatorIndex = path.IndexOf(Path.DirectorySeparatorChar);
+                if (separatorIndex < 0)
+                {
+                    pathPart = path;
+                    path = ReadOnlySpan<char>.Empty;
+                }
+                else
+                {
+                    pathPart = path.Slice(0, separatorIndex);
+                    path = path.Slice(separatorIndex + 1);
+                }
+
+                if (pathPart.IsEmpty)
+                {
+                    continue;
+                }
+
                 if (!currentEntry.IsFolder)
                 {
                     return false;
                 }
 
                 FolderData folderData = (FolderData)currentEntry;
-                if (!folderData.ChildEntries.TryGetValue(pathParts[pathIndex], out currentEntry))
+                if (!folderData.ChildEntries.TryGetValue(pathPart, out currentEntry))
                 {
                     return false;
                 }
@@ -1282,7 +1461,7 @@ private void UpdatePlaceholders()
                 folderPlaceholdersToKeep.Add(string.Empty);
 
                 stopwatch.Restart();
-                this.MultiThreadedPlaceholderUpdatesAndDeletes(placeholderFilesListCopy, folderPlaceholdersToKeep);
+                PlaceholderUpdateThreadStats filePlaceholderThreadStats = this.MultiThreadedPlaceholderUpdatesAndDeletes(placeholderFilesListCopy, folderPlaceholdersToKeep);
                 stopwatch.Stop();
 
                 long millisecondsUpdatingFilePlaceholders = stopwatch.ElapsedMilliseconds;
@@ -1409,11 +1588,22 @@ private void UpdatePlaceholders()
                     deleteFolderPlaceholderAttempted,
                     folderPlaceholdersDeleted,
                     folderPlaceholdersPathNotFound,
-                    folderPlaceholdersShaUpdate);
+                    folderPlaceholdersShaUpdate,
+                    filePlaceholderThreadStats.ThreadCount,
+                    filePlaceholderThreadStats.WorkItemCount,
+                    filePlaceholderThreadStats.MinThreadMs,
+                    filePlaceholderThreadStats.MaxThreadMs,
+                    filePlaceholderThreadStats.UtilizationPercent);
             }
         }
 
-        private void MultiThreadedPlaceholderUpdatesAndDeletes(
+        /// <summary>
+        /// Update (or delete) the file placeholders in placeholderList using multiple threads.  The placeholders are grouped
+        /// by folder into work items (see <see cref="PlaceholderUpdateWorkQueue"/>) and each thread takes the next work item
+        /// when it finishes its current one, so a few expensive folders do not leave the remaining threads idle.
+        /// </summary>
+        /// <returns>Statistics on how evenly the work was spread across the threads</returns>
+        private PlaceholderUpdateThreadStats MultiThreadedPlaceholderUpdatesAndDeletes(
             List<IPlaceholderData> placeholderList,
             ConcurrentHashSet<string> folderPlaceholdersToKeep)
         {
@@ -1422,23 +1612,26 @@ private void UpdatePlaceholders()
             numThreads = Math.Min(numThreads, placeholderList.Count / minItemsPerThread);
             numThreads = Math.Max(numThreads, 1);
 
+            Stopwatch totalTime = Stopwatch.StartNew();
+            PlaceholderUpdateWorkQueue workQueue = new PlaceholderUpdateWorkQueue(placeholderList, numThreads, GVFSPlatform.Instance.Constants.PathComparer);
+            long[] threadTimesMs = new long[numThreads];
+
             if (numThreads > 1)
             {
                 Thread[] processThreads = new Thread[numThreads];
-                int itemsPerThread = placeholderList.Count / numThreads;
 
                 for (int i = 0; i < numThreads; i++)
                 {
-                    int start = i * itemsPerThread;
-                    int end = (i + 1) == numThreads ? placeholderList.Count : (i + 1) * itemsPerThread;
-
+                    int threadIndex = i;
                     processThreads[i] = new Thread(
                         () =>
                         {
                             // We have a top-level try\catch for any unhandled exceptions thrown in the newly created thread
                             try
                             {
-                                this.UpdateAndDeletePlaceholdersThreadCallback(placeholderList, start, end, folderPlaceholdersToKeep);
+                                Stopwatch threadTime = Stopwatch.StartNew();
+                                this.UpdateAndDeletePlaceholdersThreadCallback(workQueue, folderPlaceholdersToKeep);
+                                threadTimesMs[threadIndex] = threadTime.ElapsedMilliseconds;
                             }
                             catch (Exception e)
                             {
@@ -1456,43 +1649,54 @@ private void UpdatePlaceholders()
             }
             else
             {
-                this.UpdateAndDeletePlaceholdersThreadCallback(placeholderList, 0, placeholderList.Count, folderPlaceholdersToKeep);
+                Stopwatch threadTime = Stopwatch.StartNew();
+                this.UpdateAndDeletePlaceholdersThreadCallback(workQueue, folderPlaceholdersToKeep);
+                threadTimesMs[0] = threadTime.ElapsedMilliseconds;
             }
+
+            return new PlaceholderUpdateThreadStats(workQueue.WorkItemCount, threadTimesMs, totalTime.ElapsedMilliseconds);
         }
 
         private void UpdateAndDeletePlaceholdersThreadCallback(
-            List<IPlaceholderData> placeholderList,
-            int start,
-            int end,
+            PlaceholderUpdateWorkQueue workQueue,
             ConcurrentHashSet<string> folderPlaceholdersToKeep)
         {
+            List<IPlaceholderData> placeholderList = workQueue.Placeholders;
+            int start;
+            int end;
             if (GVFSPlatform.Instance.KernelDriver.EmptyPlaceholdersRequireFileSize)
             {
                 using (BlobSizes.BlobSizesConnection blobSizesConnection = this.blobSizes.CreateConnection())
                 {
-                    Dictionary<string, long> availableSizes = new Dictionary<string, long>();
+                    Dictionary<Sha1Id, long> availableSizes = new Dictionary<Sha1Id, long>();
 
-                    this.BatchPopulateMissingSizesFromRemote(blobSizesConnection, placeholderList, start, end, availableSizes);
+                    while (workQueue.TryGetNextWorkItem(out start, out end))
+                    {
+                        this.BatchPopulateMissingSizesFromRemote(blobSizesConnection, placeholderList, start, end, availableSizes);
 
-                    for (int j = start; j < end; ++j)
-                    {
-                        this.UpdateOrDeleteFilePlaceholder(
-                            blobSizesConnection,
-                            placeholderList[j],
-                            folderPlaceholdersToKeep,
-                            availableSizes);
+                        for (int j = start; j < end; ++j)
+                        {
+                            this.UpdateOrDeleteFilePlaceholder(
+                                blobSizesConnection,
+                                placeholderList[j],
+                                folderPlaceholdersToKeep,
+                                availableSizes);
+                        }
                     }
                 }
             }
             else
             {
-                for (int j = start; j < end; ++j)
+                while (workQueue.TryGetNextWorkItem(out start, out end))
                 {
-                    this.UpdateOrDeleteFilePlaceholder(
-                        blobSizesConnection: null,
-                        placeholder: placeholderList[j],
-                        folderPlaceholdersToKeep: folderPlaceholdersToKeep,
-                        availableSizes: null);
+                    for (int j = start; j < end; ++j)
+                    {
+                        this.UpdateOrDeleteFilePlaceholder(
+                            blobSizesConnection: null,
+                            placeholder: placeholderList[j],
+                            folderPlaceholdersToKeep: folderPlaceholdersToKeep,
+                            availableSizes: null);
+                    }
                 }
             }
         }
@@ -1502,16 +1706,16 @@ private void UpdatePlaceholders()
             List<IPlaceholderData> placeholderList,
             int start,
             int end,
-            Dictionary<string, long> availableSizes)
+            Dictionary<Sha1Id, long> availableSizes)
         {
             int maxObjectsInHTTPRequest = 2000;
 
             for (int index = start; index < end; index += maxObjectsInHTTPRequest)
             {
                 int count = Math.Min(maxObjectsInHTTPRequest, end - index);
-                IEnumerable<string> nextBatch = this.GetShasWithoutSizeAndNeedingUpdate(blobSizesConnection, availableSizes, placeholderList, index, index + count);
+                List<string> nextBatch = this.GetShasWithoutSizeAndNeedingUpdate(blobSizesConnection, availableSizes, placeholderList, index, index + count);
 
-                if (nextBatch.Any())
+                if (nextBatch.Count > 0)
                 {
                     Stopwatch queryTime = Stopwatch.StartNew();
                     List<GitObjectsHttpRequestor.GitObjectSize> fileSizes = this.gitObjects.GetFileSizes(nextBatch, CancellationToken.None);
@@ -1519,24 +1723,28 @@ private void UpdatePlaceholders()
 
                     foreach (GitObjectsHttpRequestor.GitObjectSize downloadedSize in fileSizes)
                     {
-                        string downloadedSizeId = downloadedSize.Id.ToUpper();
-                        Sha1Id sha1Id = new Sha1Id(downloadedSizeId);
+                        Sha1Id sha1Id = new Sha1Id(downloadedSize.Id.ToUpper());
                         blobSizesConnection.BlobSizesDatabase.AddSize(sha1Id, downloadedSize.Size);
-                        availableSizes[downloadedSizeId] = downloadedSize.Size;
+                        availableSizes[sha1Id] = downloadedSize.Size;
                     }
                 }
             }
         }
 
-        private IEnumerable<string> GetShasWithoutSizeAndNeedingUpdate(BlobSizes.BlobSizesConnection blobSizesConnection, Dictionary<string, long> availableSizes, List<IPlaceholderData> placeholders, int start, int end)
+        /// <summary>
+        /// Finds the placeholders in [start, end) whose projected SHA has changed, adds the sizes of the new SHAs that
+        /// are available locally to availableSizes, and returns the SHAs whose size must be downloaded.  The local
+        /// sizes are looked up as a single batch rather than one SHA at a time.
+        /// </summary>
+        private List<string> GetShasWithoutSizeAndNeedingUpdate(BlobSizes.BlobSizesConnection blobSizesConnection, Dictionary<Sha1Id, long> availableSizes, List<IPlaceholderData> placeholders, int start, int end)
         {
+            HashSet<Sha1Id> shasToLookUp = new HashSet<Sha1Id>();
             for (int index = start; index < end; index++)
             {
                 string projectedSha = this.GetNewProjectedShaForPlaceholder(placeholders[index].Path);
 
                 if (!string.IsNullOrEmpty(projectedSha))
                 {
-                    long blobSize = 0;
                     string shaOnDisk = placeholders[index].Sha;
 
                     if (shaOnDisk.Equals(projectedSha))
@@ -1544,21 +1752,38 @@ private IEnumerable<string> GetShasWithoutSizeAndNeedingUpdate(BlobSizes.BlobSiz
                         continue;
                     }
 
-                    if (blobSizesConnection.TryGetSize(new Sha1Id(projectedSha), out blobSize))
+                    Sha1Id projectedShaId = new Sha1Id(projectedSha);
+                    if (!availableSizes.ContainsKey(projectedShaId))
                     {
-                        availableSizes[projectedSha] = blobSize;
-                        continue;
+                        shasToLookUp.Add(projectedShaId);
                     }
+                }
+            }
 
-                    if (this.gitObjects.TryGetBlobSizeLocally(projectedSha, out blobSize))
-                    {
-                        availableSizes[projectedSha] = blobSize;
-                        continue;
-                    }
+            List<string> shasWithoutSize = new List<string>();
+            if (shasToLookUp.Count == 0)
+            {
+                return shasWithoutSize;
+            }
 
-                    yield return projectedSha;
+            Sha1Id[] shas = new Sha1Id[shasToLookUp.Count];
+            shasToLookUp.CopyTo(shas);
+            long[] sizes = new long[shas.Length];
+            TryGetBlobSizesLocally(this.context.Tracer, this.gitObjects, blobSizesConnection, shas, sizes);
+
+            for (int i = 0; i < shas.Length; ++i)
+            {
+                if (sizes[i] >= 0)
+                {
+                    availableSizes[shas[i]] = sizes[i];
+                }
+                else
+                {
+                    shasWithoutSize.Add(shas[i].ToString());
                 }
             }
+
+            return shasWithoutSize;
         }
 
         private string GetNewProjectedShaForPlaceholder(string path)
@@ -1580,7 +1805,7 @@ private string GetNewProjectedShaForPlaceholder(string path)
             string relativeFolderPath,
             HashSet<string> existingPlaceholders)
         {
-            bool foundFolder = this.TryGetOrAddFolderDataFromCache(relativeFolderPath, out FolderData folderData);
+            bool foundFolder = this.TryGetIncludedFolderData(relativeFolderPath, out FolderData folderData);
             if (!foundFolder)
             {
                 // Folder is no longer in the projection
@@ -1703,7 +1928,7 @@ private FSResult RemoveFolderPlaceholderIfEmpty(IPlaceholderData placeholder)
             BlobSizes.BlobSizesConnection blobSizesConnection,
             IPlaceholderData placeholder,
             ConcurrentHashSet<string> folderPlaceholdersToKeep,
-            Dictionary<string, long> availableSizes)
+            Dictionary<Sha1Id, long> availableSizes)
         {
             string childName;
             string parentKey;
@@ -1952,11 +2177,19 @@ private void BuildProjection()
                 SortedFolderEntries.ShrinkPool();
                 LazyUTF8String.ShrinkPool();
 
+                Stopwatch filterStopwatch = Stopwatch.StartNew();
+                this.projectedPathFilter = ProjectedPathFilter.Build(this.rootFolderData);
+                filterStopwatch.Stop();
+
                 EventMetadata poolMetadata = CreateEventMetadata();
                 poolMetadata.Add($"{nameof(SortedFolderEntries)}_{nameof(SortedFolderEntries.FolderPoolSize)}", SortedFolderEntries.FolderPoolSize());
                 poolMetadata.Add($"{nameof(SortedFolderEntries)}_{nameof(SortedFolderEntries.FilePoolSize)}", SortedFolderEntries.FilePoolSize());
+                poolMetadata.Add($"{nameof(SortedFolderEntries)}_{nameof(SortedFolderEntries.HashIndexedFolderCount)}", SortedFolderEntries.HashIndexedFolderCount());
                 poolMetadata.Add($"{nameof(LazyUTF8String)}_{nameof(LazyUTF8String.StringPoolSize)}", LazyUTF8String.StringPoolSize());
                 poolMetadata.Add($"{nameof(LazyUTF8String)}_{nameof(LazyUTF8String.BytePoolSize)}", LazyUTF8String.BytePoolSize());
+                poolMetadata.Add($"{nameof(ProjectedPathFilter)}_{nameof(ProjectedPathFilter.EntryCount)}", this.projectedPathFilter.EntryCount);
+                poolMetadata.Add($"{nameof(ProjectedPathFilter)}_{nameof(ProjectedPathFilter.SizeInBytes)}", this.projectedPathFilter.SizeInBytes);
+                poolMetadata.Add($"{nameof(ProjectedPathFilter)}_BuildMilliseconds", filterStopwatch.ElapsedMilliseconds);
                 TimeSpan duration = tracer.Stop(poolMetadata);
                 this.context.Repository.GVFSLock.Stats.RecordParseGitIndex((long)duration.TotalMilliseconds);
             }
@@ -11,5 +11,6 @@ public interface IProfilerOnlyIndexProjection
     {
         void ForceRebuildProjection();
         void ForceAddMissingModifiedPaths(ITracer tracer);
+        int ForceLookupOfAllProjectedPaths();
     }
 }
@@ -145,6 +145,7 @@ CALL "%VCVARS_BAT%" %ARCH% || GOTO ERROR
 FOR %%P IN (
     "%VFS_SRCDIR%\GVFS\GitHooksLoader\GitHooksLoader.vcxproj"
     "%VFS_SRCDIR%\GVFS\GVFS.NativeTests\GVFS.NativeTests.vcxproj"
+    "%VFS_SRCDIR%\GVFS\GVFS.ObjectLookup\GVFS.ObjectLookup.vcxproj"
     "%VFS_SRCDIR%\GVFS\GVFS.PostIndexChangedHook\GVFS.PostIndexChangedHook.vcxproj"
     "%VFS_SRCDIR%\GVFS\GVFS.ReadObjectHook\GVFS.ReadObjectHook.vcxproj"
     "%VFS_SRCDIR%\GVFS\GVFS.VirtualFileSystemHook\GVFS.VirtualFileSystemHook.vcxproj"